@@ -0,0 +1,22 @@
+export CC = gcc
+export CXX = g++
+export AR = ar
+export AR_FLAGS = rv
+export LD = gcc
+export LDOUT = -o 
+export RANLIB = ranlib
+
+export OBJEXT := .o
+export LIBEXT := .a
+export LIBEXT2 := 
+
+export CC_OUT := -c -o 
+export CC_INC := -I
+export CC_DEF := -D
+export CC_OPTIMIZE := -O2
+export CC_LIB := -l
+
+export CC_SOURCES :=
+export CC_CFLAGS := -Wall
+export CC_LDFLAGS :=
+
@@ -131,6 +131,49 @@
 #   define PJ_DNS_RESOLVER_INVALID_TTL              60
 #endif
 
+/**
+ * The life-time of failed DNS queries (i.e: queries which got no response
+ * from any nameservers) in the resolver response cache. Subsequent queries
+ * for the same resource within this period will fail immediately with
+ * PJ_ETIMEDOUT instead of waiting for all retransmissions again. This can
+ * be changed at run-time with \a cache_fail_ttl field of #pj_dns_settings.
+ *
+ * Default: 0 (failed queries are not cached).
+ *
+ * @see PJ_DNS_RESOLVER_INVALID_TTL
+ */
+#ifndef PJ_DNS_RESOLVER_FAIL_TTL
+#   define PJ_DNS_RESOLVER_FAIL_TTL                 0
+#endif
+
+/**
+ * Prefetch threshold, in percent of the original TTL of a cached response.
+ * When a cached response is used while its remaining life-time is below
+ * this percentage of its TTL, the resolver re-queries the record in the
+ * background so the entry is refreshed before it expires, and subsequent
+ * queries never have to wait for the nameserver. Only records which have
+ * been used at least PJ_DNS_RESOLVER_PREFETCH_MIN_HITS times are
+ * prefetched. This can be changed at run-time with \a prefetch_pct field
+ * of #pj_dns_settings. A value of 10 is a good start.
+ *
+ * Default: 0 (prefetch is disabled).
+ */
+#ifndef PJ_DNS_RESOLVER_PREFETCH_PCT
+#   define PJ_DNS_RESOLVER_PREFETCH_PCT             0
+#endif
+
+/**
+ * Minimum number of times a cached response must have been used during its
+ * life-time before it is considered popular enough to be prefetched.
+ *
+ * Default: 2
+ *
+ * @see PJ_DNS_RESOLVER_PREFETCH_PCT
+ */
+#ifndef PJ_DNS_RESOLVER_PREFETCH_MIN_HITS
+#   define PJ_DNS_RESOLVER_PREFETCH_MIN_HITS        2
+#endif
+
 /**
  * The interval on which nameservers which are known to be good to be 
  * probed again to determine whether they are still good. Note that
@@ -265,6 +308,25 @@
 #   define PJ_HTTP_DEFAULT_TIMEOUT         (60000)
 #endif
 
+/**
+ * Default maximum number of simultaneous connections to the same server
+ * in a HTTP connection pool (see #pj_http_conn_pool_param). Requests in
+ * excess of this limit wait until a connection becomes available.
+ * Default: 4
+ */
+#ifndef PJ_HTTP_MAX_CONN_PER_HOST
+#   define PJ_HTTP_MAX_CONN_PER_HOST       4
+#endif
+
+/**
+ * Default time an idle connection is kept in a HTTP connection pool
+ * before it is closed, in ms.
+ * Default: 30000ms
+ */
+#ifndef PJ_HTTP_IDLE_TIMEOUT
+#   define PJ_HTTP_IDLE_TIMEOUT            (30000)
+#endif
+
 /* **************************************************************************
  * CLI configuration
  */
@@ -190,6 +190,11 @@
  * doesn't match the query.
  */
 #define PJLIB_UTIL_EDNSINANSWER     (PJLIB_UTIL_ERRNO_START+48) /* 320048 */
+/**
+ * @hideinitializer
+ * Invalid DNS cache snapshot file (see #pj_dns_resolver_load_cache()).
+ */
+#define PJLIB_UTIL_EDNSINCACHE      (PJLIB_UTIL_ERRNO_START+49) /* 320049 */
 
 
 /* DNS ERRORS MAPPED FROM RCODE: */
@@ -34,6 +34,19 @@ PJ_BEGIN_DECL
  * This contains a simple HTTP client implementation.
  * Some known limitations: 
  * - Does not support chunked Transfer-Encoding.
+ *
+ * By default each request opens its own connection to the server and
+ * closes it when the request completes. HTTP/1.1 requests may instead
+ * be given a connection pool (#pj_http_conn_pool) in \a conn_pool field
+ * of #pj_http_req_param, so that connections to the same server are kept
+ * alive and reused by subsequent requests. Requests are never pipelined:
+ * a connection carries one request at a time, and it is only reused once
+ * the response has been completely received, its length was given by
+ * Content-Length, and the server did not ask to close the connection.
+ * If the server closes a reused connection before responding, requests
+ * with idempotent methods (GET, HEAD, PUT, DELETE and OPTIONS) are sent
+ * again once on a new connection, while other requests complete with
+ * the error.
  */
 
 /**
@@ -41,6 +54,12 @@ PJ_BEGIN_DECL
  */
 typedef struct pj_http_req pj_http_req;
 
+/**
+ * This opaque structure describes the HTTP connection pool, which keeps
+ * connections to HTTP servers alive so they can be reused by requests.
+ */
+typedef struct pj_http_conn_pool pj_http_conn_pool;
+
 /**
  * Defines the maximum number of elements in a pj_http_headers
  * structure.
@@ -217,8 +236,58 @@ typedef struct pj_http_req_param
      */
     pj_uint16_t         max_retries;
 
+    /**
+     * Optional connection pool to get the connection from. When this is
+     * set and the HTTP version is "1.1", the request reuses an idle
+     * connection to the same server if there is one, and the connection
+     * is kept alive in the pool after the request completes. The pool
+     * must remain valid until the request is destroyed.
+     *
+     * Default is NULL (each request uses its own connection).
+     */
+    pj_http_conn_pool  *conn_pool;
+
 } pj_http_req_param;
 
+/**
+ * Parameters of HTTP connection pool. Application must initialize this
+ * structure with #pj_http_conn_pool_param_default().
+ */
+typedef struct pj_http_conn_pool_param
+{
+    /**
+     * Maximum number of simultaneous connections to the same server.
+     * Requests in excess of this limit are queued until one of the
+     * connections becomes available.
+     *
+     * Default is PJ_HTTP_MAX_CONN_PER_HOST.
+     */
+    unsigned            max_conn_per_host;
+
+    /**
+     * Time to keep an idle connection open, in milliseconds. Connections
+     * closed by the server are removed from the pool as soon as this is
+     * detected.
+     *
+     * Default is PJ_HTTP_IDLE_TIMEOUT.
+     */
+    unsigned            idle_timeout;
+
+} pj_http_conn_pool_param;
+
+/**
+ * HTTP connection pool statistics.
+ */
+typedef struct pj_http_conn_pool_stat
+{
+    unsigned    conn_cnt;       /**< Number of open connections.        */
+    unsigned    idle_cnt;       /**< Number of idle connections.        */
+    unsigned    wait_cnt;       /**< Requests waiting for a connection. */
+    unsigned    created;        /**< Total connections created.         */
+    unsigned    reused;         /**< Total requests which reused an
+                                     existing connection.               */
+} pj_http_conn_pool_stat;
+
 /**
  * HTTP authentication challenge, parsed from WWW-Authenticate header.
  */
@@ -483,6 +552,55 @@ PJ_DECL(pj_bool_t) pj_http_req_is_running(const pj_http_req *http_req);
  */
 PJ_DECL(void *) pj_http_req_get_user_data(pj_http_req *http_req);
 
+/**
+ * Initialize the connection pool parameters with the default values.
+ *
+ * @param param         The parameter to be initialized.
+ */
+PJ_DECL(void) pj_http_conn_pool_param_default(pj_http_conn_pool_param *param);
+
+/**
+ * Create HTTP connection pool.
+ *
+ * @param pool          Pool to use. The connection pool will use the pool's
+ *                      factory to allocate its own memory pools.
+ * @param timer         The timer to use for idle timeouts.
+ * @param ioqueue       The ioqueue to register the connections to.
+ * @param param         Optional parameters. When this parameter is not
+ *                      specifed (NULL), the default values will be used.
+ * @param p_cpool       Pointer to receive the connection pool instance.
+ *
+ * @return              PJ_SUCCESS if the operation has been successful,
+ *                      or the appropriate error code on failure.
+ */
+PJ_DECL(pj_status_t) pj_http_conn_pool_create(pj_pool_t *pool,
+                                        pj_timer_heap_t *timer,
+                                        pj_ioqueue_t *ioqueue,
+                                        const pj_http_conn_pool_param *param,
+                                        pj_http_conn_pool **p_cpool);
+
+/**
+ * Get the statistics of the connection pool.
+ *
+ * @param cpool         The connection pool.
+ * @param stat          Structure to receive the statistics.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_http_conn_pool_get_stat(pj_http_conn_pool *cpool,
+                                                pj_http_conn_pool_stat *stat);
+
+/**
+ * Destroy the connection pool and close its idle connections. All
+ * requests using the pool must have completed.
+ *
+ * @param cpool         The connection pool.
+ *
+ * @return              PJ_SUCCESS on success, or PJ_EBUSY if some requests
+ *                      are still using the pool.
+ */
+PJ_DECL(pj_status_t) pj_http_conn_pool_destroy(pj_http_conn_pool *cpool);
+
 /**
  * @}
  */
@@ -109,6 +109,75 @@ typedef pj_status_t (*pj_json_writer)(const char *s,
                                       unsigned size,
                                       void *user_data);
 
+/**
+ * Type of function callback to read JSON document in the pull parser
+ * (see pj_json_pull_create()).
+ *
+ * @param buf           Buffer to be filled with the next part of the
+ *                      document.
+ * @param size          On input, it contains the size of the buffer. On
+ *                      output, it must be set to the number of bytes
+ *                      read. Zero indicates the end of the document.
+ * @param user_data     User data that was specified to
+ *                      pj_json_pull_create().
+ *
+ * @return              If the callback returns non-PJ_SUCCESS, parsing
+ *                      will stop and this error will be returned to caller.
+ */
+typedef pj_status_t (*pj_json_reader)(char *buf,
+                                      unsigned *size,
+                                      void *user_data);
+
+/**
+ * Type of token returned by the pull parser.
+ */
+typedef enum pj_json_token_type
+{
+    PJ_JSON_TOKEN_NULL,         /**< Null value.                        */
+    PJ_JSON_TOKEN_BOOL,         /**< Boolean value.                     */
+    PJ_JSON_TOKEN_NUMBER,       /**< Number value.                      */
+    PJ_JSON_TOKEN_STRING,       /**< String value.                      */
+    PJ_JSON_TOKEN_ARRAY_START,  /**< Start of an array.                 */
+    PJ_JSON_TOKEN_ARRAY_END,    /**< End of an array.                   */
+    PJ_JSON_TOKEN_OBJ_START,    /**< Start of an object.                */
+    PJ_JSON_TOKEN_OBJ_END,      /**< End of an object.                  */
+    PJ_JSON_TOKEN_EOF           /**< End of the document.               */
+} pj_json_token_type;
+
+/**
+ * Token returned by the pull parser. The strings point to the parser's
+ * buffer and are only valid until the next call to the parser.
+ */
+typedef struct pj_json_token
+{
+    pj_json_token_type  type;           /**< Token type.                */
+    pj_str_t            name;           /**< Member name, if the value
+                                             is inside an object.       */
+    unsigned            depth;          /**< Number of enclosing arrays
+                                             and objects.               */
+    union
+    {
+        pj_bool_t       is_true;        /**< Boolean value.             */
+        float           num;            /**< Number value.              */
+        pj_str_t        str;            /**< String value.              */
+    } value;                            /**< Token value.               */
+} pj_json_token;
+
+/**
+ * Opaque structure for JSON pull parser, which reads a JSON document
+ * incrementally and returns it token by token. Only the token being
+ * parsed needs to fit in the parser's buffer, so documents of any size
+ * can be read with a constant amount of memory.
+ */
+typedef struct pj_json_pull_parser pj_json_pull_parser;
+
+/**
+ * Opaque structure for JSON stream writer, which writes a JSON document
+ * incrementally without building the elements first. The output is
+ * buffered and passed to the writer callback in large chunks.
+ */
+typedef struct pj_json_stream pj_json_stream;
+
 /**
  * Initialize null element.
  *
@@ -218,6 +287,201 @@ PJ_DECL(pj_status_t)   pj_json_writef(const pj_json_elem *elem,
                                       pj_json_writer writer,
                                       void *user_data);
 
+/**
+ * Create a pull parser to read a JSON document using the specified
+ * callback.
+ *
+ * @param pool          The pool to allocate the parser and its buffer.
+ * @param reader        Callback to read the document.
+ * @param user_data     Arbitrary user data to be given to the callback.
+ * @param buf_size      Initial size of the buffer. The buffer is enlarged
+ *                      when a single token does not fit in it.
+ * @param p_parser      Pointer to receive the parser.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_pull_create(pj_pool_t *pool,
+                                         pj_json_reader reader,
+                                         void *user_data,
+                                         unsigned buf_size,
+                                         pj_json_pull_parser **p_parser);
+
+/**
+ * Read the next token from the document. PJ_JSON_TOKEN_EOF is returned
+ * after the root value has been completely read.
+ *
+ * @param parser        The parser.
+ * @param token         Structure to receive the token.
+ *
+ * @return              PJ_SUCCESS on success, PJLIB_UTIL_EINJSON on
+ *                      syntax error, or other error returned by the
+ *                      reader callback. Once an error has occurred, the
+ *                      same error is returned by subsequent calls.
+ */
+PJ_DECL(pj_status_t) pj_json_pull_next(pj_json_pull_parser *parser,
+                                       pj_json_token *token);
+
+/**
+ * Skip the rest of the array or object currently being read, including
+ * its end token. This is typically called after receiving
+ * PJ_JSON_TOKEN_ARRAY_START or PJ_JSON_TOKEN_OBJ_START to skip the value.
+ *
+ * @param parser        The parser.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_pull_skip(pj_json_pull_parser *parser);
+
+/**
+ * Read the value of the specified token as element. If the token starts
+ * an array or object, the whole array or object will be read from the
+ * parser. The strings are copied to the pool.
+ *
+ * @param parser        The parser.
+ * @param pool          The pool to allocate the elements.
+ * @param token         The token that was last returned by the parser.
+ * @param p_elem        Pointer to receive the element.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_pull_read_elem(pj_json_pull_parser *parser,
+                                            pj_pool_t *pool,
+                                            const pj_json_token *token,
+                                            pj_json_elem **p_elem);
+
+/**
+ * Get the location of the parsing error.
+ *
+ * @param parser        The parser.
+ * @param err_info      Structure to be filled with the error info.
+ */
+PJ_DECL(void) pj_json_pull_get_err_info(const pj_json_pull_parser *parser,
+                                        pj_json_err_info *err_info);
+
+/**
+ * Create a stream writer. The document is written with the same format
+ * as pj_json_writef().
+ *
+ * @param pool          The pool to allocate the writer and its buffer.
+ * @param writer        Callback to write the document chunks.
+ * @param user_data     Arbitrary user data to be given to the callback.
+ * @param buf_size      Size of the output buffer.
+ * @param p_stream      Pointer to receive the writer.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_create(pj_pool_t *pool,
+                                           pj_json_writer writer,
+                                           void *user_data,
+                                           unsigned buf_size,
+                                           pj_json_stream **p_stream);
+
+/**
+ * Start writing an object. Members are written with the other
+ * pj_json_stream_*() functions, and the object is closed with
+ * pj_json_stream_end().
+ *
+ * @param stream        The writer.
+ * @param name          Name of the object, or NULL.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_begin_obj(pj_json_stream *stream,
+                                              const pj_str_t *name);
+
+/**
+ * Start writing an array. Elements are written with the other
+ * pj_json_stream_*() functions, and the array is closed with
+ * pj_json_stream_end().
+ *
+ * @param stream        The writer.
+ * @param name          Name of the array, or NULL.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_begin_array(pj_json_stream *stream,
+                                                const pj_str_t *name);
+
+/**
+ * Close the array or object that was last started.
+ *
+ * @param stream        The writer.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_end(pj_json_stream *stream);
+
+/**
+ * Write null value.
+ *
+ * @param stream        The writer.
+ * @param name          Name of the value, or NULL.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_add_null(pj_json_stream *stream,
+                                             const pj_str_t *name);
+
+/**
+ * Write boolean value.
+ *
+ * @param stream        The writer.
+ * @param name          Name of the value, or NULL.
+ * @param val           The value.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_add_bool(pj_json_stream *stream,
+                                             const pj_str_t *name,
+                                             pj_bool_t val);
+
+/**
+ * Write number value.
+ *
+ * @param stream        The writer.
+ * @param name          Name of the value, or NULL.
+ * @param val           The value.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_add_number(pj_json_stream *stream,
+                                               const pj_str_t *name,
+                                               float val);
+
+/**
+ * Write string value.
+ *
+ * @param stream        The writer.
+ * @param name          Name of the value, or NULL.
+ * @param val           The value.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_add_string(pj_json_stream *stream,
+                                               const pj_str_t *name,
+                                               const pj_str_t *val);
+
+/**
+ * Write the element, including its children if it is an array or object.
+ *
+ * @param stream        The writer.
+ * @param elem          The element.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_add_elem(pj_json_stream *stream,
+                                             const pj_json_elem *elem);
+
+/**
+ * Pass the buffered output to the writer callback. This must be called
+ * after the document has been written.
+ *
+ * @param stream        The writer.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_stream_flush(pj_json_stream *stream);
+
 /**
  * @}
  */
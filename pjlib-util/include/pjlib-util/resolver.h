@@ -68,6 +68,27 @@ PJ_BEGIN_DECL
  * Response caching can be  disabled by setting the maximum TTL value of the 
  * resolver to zero.
  *
+ * Error responses and responses without answer are cached too (negative
+ * caching) for \a cache_neg_ttl seconds, and queries which got no response
+ * at all can be cached for \a cache_fail_ttl seconds (see #pj_dns_settings).
+ *
+ * \subsection PJ_DNS_RESOLVER_FEATURES_PREFETCH Cache Prefetch
+ *
+ * When \a prefetch_pct setting is non-zero, popular cached responses are
+ * re-queried in the background shortly before they expire, so that queries
+ * to hot names are always answered from the cache. The cache hit, miss,
+ * and prefetch counters can be retrieved with #pj_dns_resolver_get_stat().
+ *
+ * \subsection PJ_DNS_RESOLVER_FEATURES_SNAPSHOT Cache Snapshot
+ *
+ * The content of the response cache can be saved to a file with
+ * #pj_dns_resolver_save_cache() (for example when the application is
+ * shutting down), and loaded back with #pj_dns_resolver_load_cache() right
+ * after the resolver is created, so that a restarted application does not
+ * have to query the nameservers again for records which are still valid.
+ * The remaining TTL of each record is preserved, taking into account the
+ * time elapsed since the snapshot was saved.
+ *
  * \subsection PJ_DNS_RESOLVER_FEATURES_PARALLEL Parallel and Backup Name Servers
  *
  * When the resolver is configured with multiple nameservers, initially the
@@ -195,9 +216,42 @@ typedef struct pj_dns_settings
                                      value is zero, caching is disabled.    */
     unsigned    good_ns_ttl;    /**< See #PJ_DNS_RESOLVER_GOOD_NS_TTL       */
     unsigned    bad_ns_ttl;     /**< See #PJ_DNS_RESOLVER_BAD_NS_TTL        */
+    unsigned    cache_neg_ttl;  /**< TTL for negative responses, see
+                                     #PJ_DNS_RESOLVER_INVALID_TTL           */
+    unsigned    cache_fail_ttl; /**< See #PJ_DNS_RESOLVER_FAIL_TTL          */
+    unsigned    prefetch_pct;   /**< See #PJ_DNS_RESOLVER_PREFETCH_PCT      */
+    unsigned    prefetch_min_hits;/**< See
+                                     #PJ_DNS_RESOLVER_PREFETCH_MIN_HITS     */
 } pj_dns_settings;
 
 
+/**
+ * This structure describes the resolver cache statistics, see
+ * #pj_dns_resolver_get_stat().
+ */
+typedef struct pj_dns_resolver_stat
+{
+    /** Number of queries answered from the cache without waiting for any
+     *  nameserver, including the ones answered by negative entries. */
+    unsigned    cache_hit;
+
+    /** Number of queries answered by negative cache entries (error
+     *  responses, responses without answer, or failed queries). */
+    unsigned    cache_neg_hit;
+
+    /** Number of queries which had to wait for a nameserver response,
+     *  including the ones merged into an already pending query. */
+    unsigned    cache_miss;
+
+    /** Number of background prefetch queries sent. */
+    unsigned    prefetch_cnt;
+
+    /** Number of cache entries refreshed by prefetch queries. */
+    unsigned    prefetch_ok;
+
+} pj_dns_resolver_stat;
+
+
 /**
  * This structure represents DNS A record, as the result of parsing
  * DNS response packet using #pj_dns_parse_a_response().
@@ -494,6 +548,71 @@ PJ_DECL(pj_status_t) pj_dns_resolver_add_entry(pj_dns_resolver *resolver,
 PJ_DECL(unsigned) pj_dns_resolver_get_cached_count(pj_dns_resolver *resolver);
 
 
+/**
+ * Get the resolver cache statistics.
+ *
+ * @param resolver  The resolver instance.
+ * @param stat      Structure to receive the statistics.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_resolver_get_stat(pj_dns_resolver *resolver,
+                                              pj_dns_resolver_stat *stat);
+
+
+/**
+ * Reset the resolver cache statistics.
+ *
+ * @param resolver  The resolver instance.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_resolver_reset_stat(pj_dns_resolver *resolver);
+
+
+/**
+ * Save the response cache of the resolver to a file, so that it can be
+ * loaded later with #pj_dns_resolver_load_cache(), typically by a new
+ * resolver instance after the application restarts. Only successful
+ * responses which have not expired are saved; negative responses and
+ * entries added with no expiration (see #pj_dns_resolver_add_entry())
+ * are not. The file is overwritten if it exists.
+ *
+ * @param resolver  The resolver instance.
+ * @param filename  The file name.
+ * @param p_count   Optional pointer to receive the number of responses
+ *                  saved to the file.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_resolver_save_cache(pj_dns_resolver *resolver,
+                                                const char *filename,
+                                                unsigned *p_count);
+
+
+/**
+ * Load the responses saved with #pj_dns_resolver_save_cache() into the
+ * response cache of the resolver. This is normally called right after
+ * the resolver is created, before any queries are made. The responses
+ * expire at the same time as they would have in the resolver which saved
+ * them, and responses which have expired in the meantime are skipped.
+ * Responses already in the cache are kept.
+ *
+ * @param resolver  The resolver instance.
+ * @param filename  The file name.
+ * @param p_count   Optional pointer to receive the number of responses
+ *                  loaded into the cache.
+ *
+ * @return          PJ_SUCCESS on success, PJLIB_UTIL_EDNSINCACHE if the
+ *                  file is not a valid cache snapshot, or the appropriate
+ *                  error code. Responses read before an error is found in
+ *                  the file are kept in the cache.
+ */
+PJ_DECL(pj_status_t) pj_dns_resolver_load_cache(pj_dns_resolver *resolver,
+                                                const char *filename,
+                                                unsigned *p_count);
+
+
 /**
  * Dump resolver state to the log.
  *
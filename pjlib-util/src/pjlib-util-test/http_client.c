@@ -920,6 +920,292 @@ int http_client_test_delete()
     return PJ_SUCCESS;
 }
 
+/*
+ * Keep-alive server: serves any number of requests on each connection,
+ * replying with HTTP/1.1 and Content-Length. If max_req is set, the
+ * server closes the connection after that many requests without telling
+ * the client, like a server closing an idle connection. If drop_after
+ * is set, the server closes the connection without responding when it
+ * receives a request after that many requests.
+ */
+static struct ka_server_t
+{
+    pj_sock_t        sock;
+    pj_uint16_t      port;
+    pj_thread_t     *thread;
+    unsigned         max_req;
+    unsigned         drop_after;
+    unsigned         data_size;
+    unsigned         accepted;
+} g_ka_server;
+
+static pj_status_t ka_status;
+static pj_size_t ka_size;
+
+static int ka_server_thread(void *p)
+{
+    struct ka_server_t *srv = (struct ka_server_t*)p;
+    char *pkt = (char*)pj_pool_alloc(pool, 2048);
+    char *resp = (char*)pj_pool_alloc(pool, srv->data_size + 80);
+    pj_ssize_t resp_len;
+
+    /* Send the whole response at once, otherwise Nagle's algorithm
+     * delays the body until the header is acknowledged.
+     */
+    resp_len = pj_ansi_snprintf(resp, 80, "HTTP/1.1 200 OK\r\n"
+                                "Content-Length: %u\r\n\r\n",
+                                srv->data_size);
+    pj_create_random_string(resp + resp_len, srv->data_size);
+    resp_len += srv->data_size;
+
+    while (!thread_quit) {
+        pj_sock_t newsock = PJ_INVALID_SOCKET;
+        pj_fd_set_t rset;
+        pj_time_val timeout = {0, 100};
+        unsigned served = 0;
+        int rc;
+
+        PJ_FD_ZERO(&rset);
+        PJ_FD_SET(srv->sock, &rset);
+        rc = pj_sock_select((int)srv->sock+1, &rset, NULL, NULL, &timeout);
+        if (rc != 1)
+            continue;
+        if (pj_sock_accept(srv->sock, &newsock, NULL, NULL) != PJ_SUCCESS)
+            continue;
+        ++srv->accepted;
+
+        while (!thread_quit) {
+            pj_ssize_t pkt_len;
+            char *req;
+
+            PJ_FD_ZERO(&rset);
+            PJ_FD_SET(newsock, &rset);
+            rc = pj_sock_select((int)newsock+1, &rset, NULL, NULL, &timeout);
+            if (rc != 1)
+                continue;
+
+            pkt_len = 2047;
+            rc = pj_sock_recv(newsock, pkt, &pkt_len, 0);
+            if (rc != PJ_SUCCESS || pkt_len <= 0)
+                break;
+            pkt[pkt_len] = '\0';
+
+            /* Reply to each request in the packet */
+            for (req = pj_ansi_strstr(pkt, "\r\n\r\n"); req && !thread_quit;
+                 req = pj_ansi_strstr(req + 4, "\r\n\r\n"))
+            {
+                pj_ssize_t len = resp_len;
+
+                if (srv->drop_after && served >= srv->drop_after)
+                    break;
+                if (pj_sock_send(newsock, resp, &len, 0) != PJ_SUCCESS)
+                    break;
+                ++served;
+            }
+
+            if ((srv->max_req && served >= srv->max_req) ||
+                (srv->drop_after && served >= srv->drop_after && req))
+            {
+                break;
+            }
+        }
+
+        pj_sock_close(newsock);
+    }
+
+    return 0;
+}
+
+static void ka_on_complete(pj_http_req *hreq, pj_status_t status,
+                           const pj_http_resp *resp)
+{
+    PJ_UNUSED_ARG(hreq);
+
+    ka_status = status;
+    ka_size = (status == PJ_SUCCESS ? resp->size : 0);
+}
+
+/* Send requests one after another, optionally using connection pool */
+static int ka_run_requests(const pj_str_t *url, pj_http_conn_pool *cpool,
+                           const char *method, unsigned count,
+                           pj_uint32_t *usec)
+{
+    pj_http_req_callback hcb;
+    pj_timestamp t1, t2;
+    unsigned i;
+
+    pj_bzero(&hcb, sizeof(hcb));
+    hcb.on_complete = &ka_on_complete;
+
+    pj_get_timestamp(&t1);
+    for (i = 0; i < count; ++i) {
+        pj_http_req_param param;
+        pj_http_req *hreq;
+
+        pj_http_req_param_default(&param);
+        pj_strset2(&param.version, (char*)"1.1");
+        pj_strset2(&param.method, (char*)method);
+        param.conn_pool = cpool;
+
+        if (pj_http_req_create(pool, url, timer_heap, ioqueue,
+                               &param, &hcb, &hreq))
+            return -110;
+
+        ka_status = PJ_EPENDING;
+        if (pj_http_req_start(hreq))
+            return -111;
+
+        while (pj_http_req_is_running(hreq)) {
+            pj_time_val delay = {0, 10};
+            pj_ioqueue_poll(ioqueue, &delay);
+            pj_timer_heap_poll(timer_heap, NULL);
+        }
+        pj_http_req_destroy(hreq);
+
+        if (ka_status != PJ_SUCCESS) {
+            PJ_PERROR(3, (THIS_FILE, ka_status, "Request %d failed", i));
+            return -112;
+        }
+        if (ka_size != g_ka_server.data_size)
+            return -113;
+    }
+    pj_get_timestamp(&t2);
+
+    *usec = pj_elapsed_usec(&t1, &t2);
+    return 0;
+}
+
+/*
+ * Keep-alive connection pool: compare sequential requests with and
+ * without the pool, and check that a connection closed by the server
+ * is replaced transparently.
+ */
+int http_client_test_keep_alive()
+{
+    /* Closed sockets stay registered to the ioqueue for a while, so
+     * keep this well below the ioqueue capacity.
+     */
+    enum { COUNT = 32 };
+    pj_str_t url;
+    char urlbuf[80];
+    pj_http_conn_pool *cpool;
+    pj_http_conn_pool_stat stat;
+    pj_sockaddr_in addr2;
+    int addr_len = sizeof(addr2);
+    pj_uint32_t usec_plain, usec_pool;
+    unsigned conn_plain, conn_pool;
+    int rc;
+
+    pool = pj_pool_create(mem, NULL, 8192, 4096, NULL);
+    if (pj_timer_heap_create(pool, 16, &timer_heap))
+        return -100;
+    if (pj_ioqueue_create(pool, PJ_IOQUEUE_MAX_HANDLES, &ioqueue))
+        return -101;
+
+    thread_quit = PJ_FALSE;
+    pj_bzero(&g_ka_server, sizeof(g_ka_server));
+    g_ka_server.data_size = 512;
+
+    if (pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, &g_ka_server.sock))
+        return -102;
+    pj_sockaddr_in_init(&addr, NULL, 0);
+    if (pj_sock_bind(g_ka_server.sock, &addr, sizeof(addr)))
+        return -103;
+    if (pj_sock_getsockname(g_ka_server.sock, &addr2, &addr_len))
+        return -104;
+    g_ka_server.port = pj_sockaddr_in_get_port(&addr2);
+    pj_ansi_snprintf(urlbuf, sizeof(urlbuf),
+                     "http://127.0.0.1:%d/test/keepalive.txt",
+                     g_ka_server.port);
+    url = pj_str(urlbuf);
+    if (pj_sock_listen(g_ka_server.sock, 8))
+        return -105;
+    if (pj_thread_create(pool, NULL, &ka_server_thread, &g_ka_server,
+                         0, 0, &g_ka_server.thread))
+        return -106;
+
+    /* Without connection pool, each request uses its own connection */
+    rc = ka_run_requests(&url, NULL, "GET", COUNT, &usec_plain);
+    if (rc)
+        goto on_return;
+    conn_plain = g_ka_server.accepted;
+
+    /* With connection pool, all requests share one connection */
+    if (pj_http_conn_pool_create(pool, timer_heap, ioqueue, NULL, &cpool)) {
+        rc = -120;
+        goto on_return;
+    }
+    rc = ka_run_requests(&url, cpool, "GET", COUNT, &usec_pool);
+    if (rc)
+        goto on_destroy;
+    conn_pool = g_ka_server.accepted - conn_plain;
+
+    pj_http_conn_pool_get_stat(cpool, &stat);
+    PJ_LOG(3, (THIS_FILE, "...%d requests: %u usec with %u connections "
+               "without pool, %u usec with %u connection(s) with pool",
+               COUNT, usec_plain, conn_plain, usec_pool, conn_pool));
+    if (conn_plain != COUNT || conn_pool != 1 || stat.created != 1 ||
+        stat.reused != COUNT - 1 || stat.idle_cnt != 1)
+    {
+        PJ_LOG(3, (THIS_FILE, "...error: created=%u reused=%u idle=%u",
+                   stat.created, stat.reused, stat.idle_cnt));
+        rc = -121;
+        goto on_destroy;
+    }
+
+    /* Server closes connections behind our back, requests must still
+     * succeed on new connections.
+     */
+    g_ka_server.max_req = 4;
+    rc = ka_run_requests(&url, cpool, "GET", COUNT, &usec_pool);
+    if (rc)
+        goto on_destroy;
+    pj_http_conn_pool_get_stat(cpool, &stat);
+    if (stat.created < 2 || stat.conn_cnt > 1) {
+        rc = -122;
+        goto on_destroy;
+    }
+
+    /* Server drops a request on a reused connection. GET is sent again on
+     * a new connection, POST must fail since the server may have
+     * processed it.
+     */
+    g_ka_server.max_req = 0;
+    g_ka_server.drop_after = 1;
+    rc = ka_run_requests(&url, cpool, "GET", 2, &usec_pool);
+    if (rc)
+        goto on_destroy;
+    pj_http_conn_pool_get_stat(cpool, &stat);
+    conn_pool = stat.created;
+
+    rc = ka_run_requests(&url, cpool, "POST", 1, &usec_pool);
+    if (rc != -112 || ka_status == PJ_SUCCESS) {
+        rc = -124;
+        goto on_destroy;
+    }
+    rc = 0;
+    pj_http_conn_pool_get_stat(cpool, &stat);
+    if (stat.created != conn_pool) {
+        rc = -125;
+        goto on_destroy;
+    }
+
+on_destroy:
+    if (pj_http_conn_pool_destroy(cpool) != PJ_SUCCESS && rc == 0)
+        rc = -123;
+
+on_return:
+    thread_quit = PJ_TRUE;
+    pj_thread_join(g_ka_server.thread);
+    pj_sock_close(g_ka_server.sock);
+
+    pj_ioqueue_destroy(ioqueue);
+    pj_timer_heap_destroy(timer_heap);
+    pj_pool_release(pool);
+
+    return rc;
+}
+
 int http_client_test()
 {
     int rc;
@@ -954,6 +1240,11 @@ int http_client_test()
     if (rc)
         return rc;
 
+    PJ_LOG(3, (THIS_FILE, "..Testing keep-alive connection pool"));
+    rc = http_client_test_keep_alive();
+    if (rc)
+        return rc;
+
     return PJ_SUCCESS;
 }
 
@@ -21,8 +21,11 @@
 
 #if INCLUDE_JSON_TEST
 
+#include <pjlib-util/errno.h>
 #include <pjlib-util/json.h>
+#include <pj/errno.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/string.h>
 
 static char json_doc1[] =
@@ -86,6 +89,345 @@ on_error:
     return 10;
 }
 
+/* Reader which returns the document in small chunks */
+struct chunk_reader
+{
+    const char  *pos;
+    const char  *end;
+    unsigned     chunk;
+};
+
+static pj_status_t chunk_read(char *buf, unsigned *size, void *user_data)
+{
+    struct chunk_reader *rd = (struct chunk_reader*)user_data;
+    unsigned len = (unsigned)(rd->end - rd->pos);
+
+    if (len > rd->chunk) len = rd->chunk;
+    if (len > *size) len = *size;
+    pj_memcpy(buf, rd->pos, len);
+    rd->pos += len;
+    *size = len;
+
+    return PJ_SUCCESS;
+}
+
+/* Writer which appends to string buffer */
+struct str_writer
+{
+    char        *buf;
+    unsigned     size;
+    unsigned     len;
+    unsigned     calls;
+};
+
+static pj_status_t str_write(const char *s, unsigned size, void *user_data)
+{
+    struct str_writer *wr = (struct str_writer*)user_data;
+
+    if (wr->len + size >= wr->size)
+        return PJ_ETOOBIG;
+    pj_memcpy(wr->buf + wr->len, s, size);
+    wr->len += size;
+    wr->buf[wr->len] = '\0';
+    ++wr->calls;
+
+    return PJ_SUCCESS;
+}
+
+/* Pull parser and stream writer must give the same result as the DOM
+ * parser and writer.
+ */
+static int json_verify_stream()
+{
+    pj_pool_t *pool;
+    pj_json_elem *elem;
+    pj_json_pull_parser *parser;
+    pj_json_stream *js;
+    pj_json_token tok;
+    struct chunk_reader rd;
+    struct str_writer wr;
+    pj_json_err_info err;
+    char *expected;
+    unsigned size;
+    pj_str_t name, val;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "json", 1000, 1000, NULL);
+
+    /* Expected output from the DOM parser and writer */
+    size = (unsigned)strlen(json_doc1);
+    elem = pj_json_parse(pool, json_doc1, &size, &err);
+    if (!elem) {
+        rc = 100;
+        goto on_return;
+    }
+    size = (unsigned)strlen(json_doc1) * 2;
+    expected = pj_pool_alloc(pool, size);
+    if (pj_json_write(elem, expected, &size)) {
+        rc = 101;
+        goto on_return;
+    }
+
+    /* Pull parse with tiny chunks and buffer to exercise buffer refill
+     * and growth.
+     */
+    rd.pos = json_doc1;
+    rd.end = json_doc1 + strlen(json_doc1);
+    rd.chunk = 7;
+    if (pj_json_pull_create(pool, &chunk_read, &rd, 8, &parser)) {
+        rc = 102;
+        goto on_return;
+    }
+    if (pj_json_pull_next(parser, &tok) ||
+        tok.type != PJ_JSON_TOKEN_OBJ_START)
+    {
+        rc = 103;
+        goto on_return;
+    }
+    if (pj_json_pull_read_elem(parser, pool, &tok, &elem)) {
+        rc = 104;
+        goto on_return;
+    }
+    if (pj_json_pull_next(parser, &tok) || tok.type != PJ_JSON_TOKEN_EOF) {
+        rc = 105;
+        goto on_return;
+    }
+
+    /* Write with stream writer using small buffer */
+    wr.size = size * 2;
+    wr.buf = pj_pool_alloc(pool, wr.size);
+    wr.len = wr.calls = 0;
+    if (pj_json_stream_create(pool, &str_write, &wr, 16, &js) ||
+        pj_json_stream_add_elem(js, elem) ||
+        pj_json_stream_flush(js))
+    {
+        rc = 106;
+        goto on_return;
+    }
+    if (wr.len != size || pj_memcmp(wr.buf, expected, size)) {
+        PJ_LOG(1, (THIS_FILE, "  Error: stream output differs:\n%s",
+                   wr.buf));
+        rc = 107;
+        goto on_return;
+    }
+
+    /* Write the same document with the element-less API */
+    wr.len = wr.calls = 0;
+    pj_json_stream_create(pool, &str_write, &wr, 1024, &js);
+    pj_json_stream_begin_obj(js, NULL);
+    pj_json_stream_begin_obj(js, pj_cstr(&name, "Object"));
+    pj_json_stream_add_number(js, pj_cstr(&name, "Integer"), 800);
+    pj_json_stream_add_number(js, pj_cstr(&name, "Negative"), -12);
+    pj_json_stream_add_number(js, pj_cstr(&name, "Float"), -7.2f);
+    pj_json_stream_add_string(js, pj_cstr(&name, "String"),
+                              pj_cstr(&val, "A\tString with tab"));
+    pj_json_stream_begin_obj(js, pj_cstr(&name, "Object2"));
+    pj_json_stream_add_bool(js, pj_cstr(&name, "True"), PJ_TRUE);
+    pj_json_stream_add_bool(js, pj_cstr(&name, "False"), PJ_FALSE);
+    pj_json_stream_add_null(js, pj_cstr(&name, "Null"));
+    pj_json_stream_end(js);
+    pj_json_stream_begin_array(js, pj_cstr(&name, "Array1"));
+    pj_json_stream_add_number(js, NULL, 116);
+    pj_json_stream_add_bool(js, NULL, PJ_FALSE);
+    pj_json_stream_add_string(js, NULL, pj_cstr(&val, "string"));
+    pj_json_stream_begin_obj(js, NULL);
+    pj_json_stream_end(js);
+    pj_json_stream_end(js);
+    pj_json_stream_begin_array(js, pj_cstr(&name, "Array2"));
+    pj_json_stream_begin_obj(js, NULL);
+    pj_json_stream_add_number(js, pj_cstr(&name, "Float"), 123);
+    pj_json_stream_end(js);
+    pj_json_stream_begin_obj(js, NULL);
+    pj_json_stream_add_number(js, pj_cstr(&name, "Float"), 123);
+    pj_json_stream_end(js);
+    pj_json_stream_end(js);
+    pj_json_stream_end(js);
+    pj_json_stream_add_number(js, pj_cstr(&name, "Integer"), 800);
+    pj_json_stream_begin_array(js, pj_cstr(&name, "Array1"));
+    pj_json_stream_add_number(js, NULL, 116);
+    pj_json_stream_add_bool(js, NULL, PJ_FALSE);
+    pj_json_stream_add_string(js, NULL, pj_cstr(&val, "string"));
+    pj_json_stream_end(js);
+    pj_json_stream_end(js);
+    if (pj_json_stream_flush(js)) {
+        rc = 108;
+        goto on_return;
+    }
+    if (wr.calls != 1 || wr.len != size || pj_memcmp(wr.buf, expected, size)) {
+        PJ_LOG(1, (THIS_FILE, "  Error: stream output differs:\n%s",
+                   wr.buf));
+        rc = 109;
+        goto on_return;
+    }
+
+    /* Syntax error */
+    rd.pos = "{\n  \"a\" 1 }";
+    rd.end = rd.pos + strlen(rd.pos);
+    pj_json_pull_create(pool, &chunk_read, &rd, 64, &parser);
+    if (pj_json_pull_next(parser, &tok) != PJ_SUCCESS ||
+        pj_json_pull_next(parser, &tok) != PJLIB_UTIL_EINJSON ||
+        pj_json_pull_next(parser, &tok) != PJLIB_UTIL_EINJSON)
+    {
+        rc = 110;
+        goto on_return;
+    }
+    pj_json_pull_get_err_info(parser, &err);
+    if (err.line != 2 || err.col != 7 || err.err_char != '1') {
+        PJ_LOG(1, (THIS_FILE, "  Error: wrong error location %d:%d '%c'",
+                   err.line, err.col, err.err_char));
+        rc = 111;
+        goto on_return;
+    }
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+#if WITH_BENCHMARK
+/* Reader which generates a large list of buddies */
+struct gen_reader
+{
+    unsigned     idx;
+    unsigned     count;
+    char         buf[128];
+    unsigned     len;
+    unsigned     pos;
+};
+
+static pj_status_t gen_read(char *buf, unsigned *size, void *user_data)
+{
+    struct gen_reader *rd = (struct gen_reader*)user_data;
+    unsigned total = 0;
+
+    while (total < *size) {
+        unsigned len;
+
+        if (rd->pos == rd->len) {
+            if (rd->idx > rd->count)
+                break;
+            if (rd->idx == rd->count) {
+                rd->len = pj_ansi_snprintf(rd->buf, sizeof(rd->buf),
+                                           "]}");
+            } else {
+                rd->len = pj_ansi_snprintf(rd->buf, sizeof(rd->buf),
+                                           "%s{\"uri\": \"sip:buddy%u@"
+                                           "example.com\", \"subscribe\":"
+                                           " true, \"id\": %u}",
+                                           (rd->idx ? ",\n" :
+                                                      "{\"buddies\": [\n"),
+                                           rd->idx, rd->idx);
+            }
+            rd->pos = 0;
+            ++rd->idx;
+        }
+
+        len = rd->len - rd->pos;
+        if (len > *size - total)
+            len = *size - total;
+        pj_memcpy(buf + total, rd->buf + rd->pos, len);
+        rd->pos += len;
+        total += len;
+    }
+
+    *size = total;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t null_write(const char *s, unsigned size, void *user_data)
+{
+    PJ_UNUSED_ARG(s);
+    *(pj_size_t*)user_data += size;
+    return PJ_SUCCESS;
+}
+
+/* Compare memory and time to load large document with the DOM parser and
+ * with the pull parser.
+ */
+static int json_stream_benchmark()
+{
+    enum { COUNT = 20000 };
+    pj_pool_t *pool;
+    pj_json_pull_parser *parser;
+    pj_json_stream *js;
+    pj_json_token tok;
+    pj_json_elem *root;
+    struct gen_reader rd;
+    pj_timestamp t1, t2;
+    char *doc;
+    unsigned size, doc_size, count = 0;
+    pj_size_t dom_mem, written = 0;
+    pj_str_t name;
+    int rc = 0;
+
+    /* Generate the whole document for the DOM parser */
+    pj_bzero(&rd, sizeof(rd));
+    rd.count = COUNT;
+    pool = pj_pool_create(mem, "jsonbench", 4000, 4000, NULL);
+    doc_size = COUNT * 100;
+    doc = pj_pool_alloc(pool, doc_size);
+    size = doc_size - 1;
+    gen_read(doc, &size, &rd);
+    doc[size] = '\0';
+
+    pj_get_timestamp(&t1);
+    root = pj_json_parse(pool, doc, &size, NULL);
+    pj_get_timestamp(&t2);
+    dom_mem = pj_pool_get_used_size(pool);
+    pj_pool_release(pool);
+    if (!root)
+        return 200;
+    PJ_LOG(3, (THIS_FILE, "   DOM parser : %u usec, %lu KB of pool",
+               pj_elapsed_usec(&t1, &t2), (unsigned long)(dom_mem / 1024)));
+
+    /* Pull parse the generated document, writing it back with the stream
+     * writer.
+     */
+    pj_bzero(&rd, sizeof(rd));
+    rd.count = COUNT;
+    pool = pj_pool_create(mem, "jsonbench", 4000, 4000, NULL);
+    pj_json_pull_create(pool, &gen_read, &rd, 1024, &parser);
+    pj_json_stream_create(pool, &null_write, &written, 1024, &js);
+
+    pj_get_timestamp(&t1);
+    pj_json_stream_begin_obj(js, NULL);
+    pj_json_stream_begin_array(js, pj_cstr(&name, "buddies"));
+    while (pj_json_pull_next(parser, &tok) == PJ_SUCCESS &&
+           tok.type != PJ_JSON_TOKEN_EOF)
+    {
+        if (tok.type == PJ_JSON_TOKEN_OBJ_START && tok.depth == 2) {
+            ++count;
+            pj_json_stream_begin_obj(js, NULL);
+        } else if (tok.type == PJ_JSON_TOKEN_OBJ_END && tok.depth == 2) {
+            pj_json_stream_end(js);
+        } else if (tok.type == PJ_JSON_TOKEN_STRING) {
+            pj_json_stream_add_string(js, &tok.name, &tok.value.str);
+        } else if (tok.type == PJ_JSON_TOKEN_BOOL) {
+            pj_json_stream_add_bool(js, &tok.name, tok.value.is_true);
+        } else if (tok.type == PJ_JSON_TOKEN_NUMBER) {
+            pj_json_stream_add_number(js, &tok.name, tok.value.num);
+        }
+    }
+    pj_json_stream_end(js);
+    pj_json_stream_end(js);
+    pj_json_stream_flush(js);
+    pj_get_timestamp(&t2);
+
+    PJ_LOG(3, (THIS_FILE, "   Pull parser: %u usec, %lu KB of pool "
+               "(%u entries, %lu bytes rewritten)",
+               pj_elapsed_usec(&t1, &t2),
+               (unsigned long)(pj_pool_get_used_size(pool) / 1024),
+               count, (unsigned long)written));
+
+    if (tok.type != PJ_JSON_TOKEN_EOF || count != COUNT)
+        rc = 201;
+    else if (pj_pool_get_used_size(pool) > 8000)
+        rc = 202;
+
+    pj_pool_release(pool);
+    return rc;
+}
+#endif  /* WITH_BENCHMARK */
 
 int json_test(void)
 {
@@ -95,6 +437,16 @@ int json_test(void)
     if (rc)
         return rc;
 
+    rc = json_verify_stream();
+    if (rc)
+        return rc;
+
+#if WITH_BENCHMARK
+    rc = json_stream_benchmark();
+    if (rc)
+        return rc;
+#endif
+
     return 0;
 }
 
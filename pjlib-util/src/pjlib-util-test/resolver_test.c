@@ -1890,6 +1890,320 @@ static int srv_resolver_many_test(void)
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+/* Cache prefetch and negative caching test */
+#define IP_ADDR4    0x04040404
+#define TTL4        2
+
+static void cache_cb(void *user_data,
+                     pj_status_t status,
+                     pj_dns_parsed_packet *resp)
+{
+    pj_status_t *p_status = (pj_status_t*)user_data;
+
+    PJ_UNUSED_ARG(resp);
+
+    *p_status = status;
+    pj_sem_post(sem);
+}
+
+static pj_status_t cache_query2(pj_dns_resolver *res, const char *name,
+                                int type)
+{
+    pj_str_t n = pj_str((char*)name);
+    pj_status_t cb_status = PJ_EPENDING;
+    pj_status_t status;
+
+    status = pj_dns_resolver_start_query(res, &n, type, 0,
+                                         &cache_cb, &cb_status, NULL);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_sem_wait(sem);
+
+    /* The callback is called before the response is saved to the cache */
+    pj_thread_sleep(50);
+    return cb_status;
+}
+
+static pj_status_t cache_query(const char *name)
+{
+    return cache_query2(resolver, name, PJ_DNS_TYPE_A);
+}
+
+static int cache_test(void)
+{
+    pj_str_t name = pj_str("hot.domain");
+    pj_dns_settings old_set, st;
+    pj_dns_resolver_stat stat;
+    pj_dns_parsed_packet *r;
+    int i, rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  cache prefetch and negative cache test"));
+
+    pj_dns_resolver_get_settings(resolver, &old_set);
+    pj_memcpy(&st, &old_set, sizeof(st));
+    st.qretr_delay = 100;
+    st.qretr_count = 2;
+    st.cache_neg_ttl = 5;
+    st.cache_fail_ttl = 5;
+    st.prefetch_pct = 50;
+    st.prefetch_min_hits = 2;
+    pj_dns_resolver_set_settings(resolver, &st);
+    pj_dns_resolver_reset_stat(resolver);
+
+    for (i=0; i<2; ++i) {
+        g_server[i].action = ACTION_REPLY;
+        r = &g_server[i].resp;
+        pj_bzero(r, sizeof(*r));
+        r->hdr.flags = PJ_DNS_SET_QR(1);
+        r->hdr.qdcount = 1;
+        r->hdr.anscount = 1;
+        r->q = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_query);
+        r->q[0].type = PJ_DNS_TYPE_A;
+        r->q[0].dnsclass = 1;
+        r->q[0].name = name;
+        r->ans = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_rr);
+        r->ans[0].type = PJ_DNS_TYPE_A;
+        r->ans[0].dnsclass = 1;
+        r->ans[0].name = name;
+        r->ans[0].ttl = TTL4;
+        r->ans[0].rdata.a.ip_addr.s_addr = IP_ADDR4;
+    }
+
+    /* First query goes to the nameserver, the next ones are answered from
+     * the cache. The third one is made when less than half of the TTL is
+     * remaining, so it triggers the prefetch.
+     */
+    if (cache_query(name.ptr) != PJ_SUCCESS ||
+        cache_query(name.ptr) != PJ_SUCCESS)
+    {
+        rc = -3000;
+        goto on_return;
+    }
+    pj_thread_sleep(TTL4 * 1000 * 3 / 4);
+    if (cache_query(name.ptr) != PJ_SUCCESS) {
+        rc = -3010;
+        goto on_return;
+    }
+
+    /* Wait until the original entry would have expired, the query must
+     * still be answered from the (refreshed) cache.
+     */
+    pj_thread_sleep(TTL4 * 1000 * 3 / 4);
+    if (cache_query(name.ptr) != PJ_SUCCESS) {
+        rc = -3020;
+        goto on_return;
+    }
+
+    pj_dns_resolver_get_stat(resolver, &stat);
+    PJ_LOG(3,(THIS_FILE, "   hit=%u miss=%u prefetch=%u refreshed=%u",
+              stat.cache_hit, stat.cache_miss, stat.prefetch_cnt,
+              stat.prefetch_ok));
+    if (stat.cache_miss != 1 || stat.cache_hit != 3 ||
+        stat.prefetch_cnt != 1 || stat.prefetch_ok != 1)
+    {
+        rc = -3030;
+        goto on_return;
+    }
+
+    /* Negative response is cached for cache_neg_ttl */
+    g_server[0].action = PJ_DNS_RCODE_NXDOMAIN;
+    g_server[1].action = PJ_DNS_RCODE_NXDOMAIN;
+    for (i=0; i<2; ++i) {
+        if (cache_query("nx.domain") !=
+            PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_NXDOMAIN))
+        {
+            rc = -3040;
+            goto on_return;
+        }
+    }
+
+    /* Failed query is cached for cache_fail_ttl */
+    g_server[0].action = ACTION_IGNORE;
+    g_server[1].action = ACTION_IGNORE;
+    for (i=0; i<2; ++i) {
+        if (cache_query("dead.domain") != PJ_ETIMEDOUT) {
+            rc = -3050;
+            goto on_return;
+        }
+    }
+
+    pj_dns_resolver_get_stat(resolver, &stat);
+    if (stat.cache_miss != 3 || stat.cache_neg_hit != 2) {
+        rc = -3060;
+        goto on_return;
+    }
+
+on_return:
+    if (rc != 0)
+        PJ_LOG(3,(THIS_FILE, "   error %d", rc));
+    pj_dns_resolver_set_settings(resolver, &old_set);
+    return rc;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+/* Cache snapshot test, using pj_dns_server as the nameserver */
+#define SNAP_PORT   5555
+#define SNAP_FILE   "dns_cache.tmp"
+
+static int cache_snapshot_test(void)
+{
+    pj_str_t srv_name = pj_str("_sip._udp.snap.domain");
+    pj_str_t a_name = pj_str("snap.domain");
+    pj_str_t short_name = pj_str("short.domain");
+    pj_str_t ns = pj_str("127.0.0.1");
+    pj_uint16_t ns_port = SNAP_PORT;
+    pj_dns_server *srv = NULL;
+    pj_dns_resolver *res1 = NULL, *res2 = NULL;
+    pj_dns_parsed_rr rr[4];
+    pj_dns_resolver_stat stat;
+    pj_in_addr ip4;
+    pj_in6_addr ip6;
+    pj_oshandle_t fd;
+    pj_ssize_t len;
+    unsigned count;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  cache snapshot test"));
+
+    if (pj_dns_server_create(mem, ioqueue, pj_AF_INET(), SNAP_PORT, 0,
+                             &srv) != PJ_SUCCESS)
+    {
+        return -3100;
+    }
+
+    ip4.s_addr = 0x05050505;
+    pj_bzero(&ip6, sizeof(ip6));
+    ip6.s6_addr[15] = 5;
+    pj_dns_init_srv_rr(&rr[0], &srv_name, PJ_DNS_CLASS_IN, 60, 1, 1, 5060,
+                       &a_name);
+    pj_dns_init_a_rr(&rr[1], &a_name, PJ_DNS_CLASS_IN, 60, &ip4);
+    pj_dns_init_aaaa_rr(&rr[2], &a_name, PJ_DNS_CLASS_IN, 60, &ip6);
+    pj_dns_init_a_rr(&rr[3], &short_name, PJ_DNS_CLASS_IN, 2, &ip4);
+    if (pj_dns_server_add_rec(srv, 4, rr) != PJ_SUCCESS) {
+        rc = -3110;
+        goto on_return;
+    }
+
+    /* Fill the cache of the first resolver and save it */
+    if (pj_dns_resolver_create(mem, NULL, 0, timer_heap, ioqueue,
+                               &res1) != PJ_SUCCESS ||
+        pj_dns_resolver_set_ns(res1, 1, &ns, &ns_port) != PJ_SUCCESS)
+    {
+        rc = -3120;
+        goto on_return;
+    }
+
+    if (cache_query2(res1, srv_name.ptr, PJ_DNS_TYPE_SRV) != PJ_SUCCESS ||
+        cache_query2(res1, a_name.ptr, PJ_DNS_TYPE_A) != PJ_SUCCESS ||
+        cache_query2(res1, a_name.ptr, PJ_DNS_TYPE_AAAA) != PJ_SUCCESS ||
+        cache_query2(res1, short_name.ptr, PJ_DNS_TYPE_A) != PJ_SUCCESS)
+    {
+        rc = -3130;
+        goto on_return;
+    }
+
+    if (pj_dns_resolver_save_cache(res1, SNAP_FILE, &count) != PJ_SUCCESS ||
+        count != 4 || !pj_file_exists(SNAP_FILE) ||
+        pj_file_exists(SNAP_FILE ".tmp"))
+    {
+        rc = -3140;
+        goto on_return;
+    }
+
+    /* Let the short record expire */
+    pj_thread_sleep(2500);
+
+    /* The second resolver has no nameserver, so the queries can only be
+     * answered from the loaded cache.
+     */
+    if (pj_dns_resolver_create(mem, NULL, 0, timer_heap, ioqueue,
+                               &res2) != PJ_SUCCESS)
+    {
+        rc = -3150;
+        goto on_return;
+    }
+
+    if (pj_dns_resolver_load_cache(res2, SNAP_FILE, &count) != PJ_SUCCESS ||
+        count != 3 || pj_dns_resolver_get_cached_count(res2) != 3)
+    {
+        rc = -3160;
+        goto on_return;
+    }
+
+    if (cache_query2(res2, srv_name.ptr, PJ_DNS_TYPE_SRV) != PJ_SUCCESS ||
+        cache_query2(res2, a_name.ptr, PJ_DNS_TYPE_A) != PJ_SUCCESS ||
+        cache_query2(res2, a_name.ptr, PJ_DNS_TYPE_AAAA) != PJ_SUCCESS)
+    {
+        rc = -3170;
+        goto on_return;
+    }
+
+    pj_dns_resolver_get_stat(res2, &stat);
+    if (stat.cache_hit != 3 || stat.cache_miss != 0) {
+        rc = -3180;
+        goto on_return;
+    }
+
+    /* Invalid file */
+    if (pj_dns_resolver_load_cache(res2, "no-such-file.tmp",
+                                   NULL) != PJ_ENOTFOUND)
+    {
+        rc = -3190;
+        goto on_return;
+    }
+
+    if (pj_file_open(pool, SNAP_FILE, PJ_O_WRONLY, &fd) != PJ_SUCCESS) {
+        rc = -3200;
+        goto on_return;
+    }
+    len = 16;
+    pj_file_write(fd, "this is garbage!", &len);
+    pj_file_close(fd);
+
+    if (pj_dns_resolver_load_cache(res2, SNAP_FILE,
+                                   NULL) != PJLIB_UTIL_EDNSINCACHE)
+    {
+        rc = -3210;
+        goto on_return;
+    }
+
+    /* Answer count larger than what the file can hold */
+    if (pj_file_open(pool, SNAP_FILE, PJ_O_WRONLY, &fd) != PJ_SUCCESS) {
+        rc = -3220;
+        goto on_return;
+    }
+    len = 35;
+    pj_file_write(fd, "PJDC\0\1\0\0\0\0\0\0"          /* header       */
+                      "\0\1\0\1a\0\0\0\x3c\0\0\xff\xff"  /* 65535 answers */
+                      "\0\0\0\1\0\1\0\0\0\x3c",          /* one answer   */
+                  &len);
+    pj_file_close(fd);
+
+    if (pj_dns_resolver_load_cache(res2, SNAP_FILE, &count) !=
+            PJLIB_UTIL_EDNSINCACHE || count != 0)
+    {
+        rc = -3230;
+        goto on_return;
+    }
+
+on_return:
+    if (rc != 0)
+        PJ_LOG(3,(THIS_FILE, "   error %d", rc));
+    if (res2)
+        pj_dns_resolver_destroy(res2, PJ_FALSE);
+    if (res1)
+        pj_dns_resolver_destroy(res1, PJ_FALSE);
+    if (srv)
+        pj_dns_server_destroy(srv);
+    if (pj_file_exists(SNAP_FILE))
+        pj_file_delete(SNAP_FILE);
+    return rc;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////
 
 
@@ -1929,6 +2243,14 @@ int resolver_test(void)
     if (rc != 0)
         goto on_error;
 
+    rc = cache_test();
+    if (rc != 0)
+        goto on_error;
+
+    rc = cache_snapshot_test();
+    if (rc != 0)
+        goto on_error;
+
     destroy();
 
 
@@ -22,6 +22,8 @@
 #include <pj/ctype.h>
 #include <pj/errno.h>
 #include <pj/except.h>
+#include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/timer.h>
@@ -106,6 +108,56 @@ enum auth_state
     AUTH_DONE           /* Done retrying the request with auth. */
 };
 
+/* Node to queue a request waiting for a pooled connection */
+struct http_waiter
+{
+    PJ_DECL_LIST_MEMBER(struct http_waiter);
+    pj_http_req            *hreq;
+};
+
+/* A connection in the connection pool */
+struct http_conn
+{
+    PJ_DECL_LIST_MEMBER(struct http_conn);
+    pj_http_conn_pool       *cpool;     /* The connection pool */
+    struct http_host        *host;      /* The server of this connection */
+    pj_pool_t               *pool;      /* Pool for this connection */
+    pj_activesock_t         *asock;     /* Active socket */
+    void                    *rbuf;      /* Read buffer */
+    pj_http_req             *hreq;      /* Current request, NULL if idle */
+    pj_timer_entry           idle_timer;/* Idle timer */
+    pj_bool_t                connected; /* Whether connection is set up */
+    pj_bool_t                reading;   /* Whether reading is started */
+    pj_bool_t                idle;      /* Whether in host's idle list */
+    pj_bool_t                no_reuse;  /* Must not be kept alive */
+    pj_bool_t                closing;   /* Connection has been closed */
+    unsigned                 cb_depth;  /* Callback nesting depth */
+};
+
+/* Connections to a server in the connection pool */
+struct http_host
+{
+    PJ_DECL_LIST_MEMBER(struct http_host);
+    pj_sockaddr              addr;      /* Server address */
+    unsigned                 conn_cnt;  /* Open connections */
+    struct conn_head
+    {
+        PJ_DECL_LIST_MEMBER(struct http_conn);
+    }                        idle;      /* Idle connections */
+    struct http_waiter       waiters;   /* Requests waiting for connection */
+};
+
+struct pj_http_conn_pool
+{
+    pj_pool_t               *pool;      /* Pool to allocate memory from */
+    pj_timer_heap_t         *timer;     /* Timer for idle timeouts */
+    pj_ioqueue_t            *ioqueue;   /* Ioqueue to use */
+    pj_lock_t               *lock;      /* Lock to protect the lists */
+    pj_http_conn_pool_param  param;     /* Settings */
+    struct http_host         hosts;     /* List of servers */
+    pj_http_conn_pool_stat   stat;      /* Statistics (created, reused) */
+};
+
 struct pj_http_req
 {
     pj_str_t                url;        /* Request URL */
@@ -125,6 +177,12 @@ struct pj_http_req
     pj_bool_t               resolved;   /* Whether URL's host is resolved */
     pj_http_resp            response;   /* HTTP response */
     pj_ioqueue_op_key_t     op_key;
+    struct http_conn        *conn;      /* Pooled connection, if any */
+    struct http_waiter      wait_node;  /* Node to wait for connection */
+    pj_bool_t               waiting;    /* Whether waiting for connection */
+    pj_bool_t               conn_reused;/* Whether conn has been reused */
+    pj_bool_t               conn_retried;/* Whether retried on new conn */
+    pj_bool_t               keep_conn;  /* Keep conn alive after request */
     struct tcp_state
     {
         /* Total data sent so far if the data is sent in segments (i.e.
@@ -159,6 +217,12 @@ static void restart_req_with_auth(pj_http_req *hreq);
 /* Parse authentication challenge */
 static pj_status_t parse_auth_chal(pj_pool_t *pool, pj_str_t *input,
                                    pj_http_auth_chal *chal);
+/* Get a connection from the connection pool for the request */
+static pj_status_t conn_acquire(pj_http_req *hreq, pj_bool_t force_new);
+/* Return the request's connection to the connection pool */
+static void conn_release(struct http_conn *conn, pj_bool_t keep);
+/* Retry the request on a new connection, if allowed */
+static pj_bool_t conn_retry_req(pj_http_req *hreq);
 
 static pj_uint16_t get_http_default_port(const pj_str_t *protocol)
 {
@@ -195,12 +259,31 @@ static void on_syntax_error(pj_scanner *scanner)
     PJ_THROW(PJ_EINVAL);  // syntax error
 }
 
-/* Callback when connection is established to the server */
-static pj_bool_t http_on_connect(pj_activesock_t *asock,
-                                 pj_status_t status)
+/* Check whether the server allows the connection to be kept alive after
+ * the response.
+ */
+static pj_bool_t resp_keep_alive(const pj_http_resp *resp)
 {
-    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
+    const pj_str_t STR_CONNECTION = { "Connection", 10 };
+    pj_bool_t keep_alive;
+    unsigned i;
+
+    keep_alive = !pj_stricmp2(&resp->version, "HTTP/" HTTP_1_1);
+    for (i = 0; i < resp->headers.count; i++) {
+        if (!pj_stricmp(&resp->headers.header[i].name, &STR_CONNECTION)) {
+            if (!pj_stricmp2(&resp->headers.header[i].value, "close"))
+                keep_alive = PJ_FALSE;
+            else if (!pj_stricmp2(&resp->headers.header[i].value,
+                                  "keep-alive"))
+                keep_alive = PJ_TRUE;
+        }
+    }
+    return keep_alive;
+}
 
+/* Handle connection established to the server */
+static pj_bool_t req_on_connect(pj_http_req *hreq, pj_status_t status)
+{
     if (hreq->state == ABORTING || hreq->state == IDLE)
         return PJ_FALSE;
 
@@ -216,12 +299,11 @@ static pj_bool_t http_on_connect(pj_activesock_t *asock,
     return PJ_TRUE;
 }
 
-static pj_bool_t http_on_data_sent(pj_activesock_t *asock,
-                                   pj_ioqueue_op_key_t *op_key,
-                                   pj_ssize_t sent)
+/* Handle data sent to the server */
+static pj_bool_t req_on_data_sent(pj_http_req *hreq,
+                                  pj_ioqueue_op_key_t *op_key,
+                                  pj_ssize_t sent)
 {
-    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
-
     PJ_UNUSED_ARG(op_key);
 
     if (hreq->state == ABORTING || hreq->state == IDLE)
@@ -288,14 +370,13 @@ static pj_bool_t http_on_data_sent(pj_activesock_t *asock,
     return PJ_TRUE;
 }
 
-static pj_bool_t http_on_data_read(pj_activesock_t *asock,
+/* Handle data received from the server */
+static pj_bool_t req_on_data_read(pj_http_req *hreq,
                                   void *data,
                                   pj_size_t size,
                                   pj_status_t status,
                                   pj_size_t *remainder)
 {
-    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
-
     TRACE_((THIS_FILE, "\nData received: %d bytes", size));
 
     if (data == NULL)
@@ -397,9 +478,8 @@ static pj_bool_t http_on_data_read(pj_activesock_t *asock,
             hreq->response.size = 0;
 
             if (rem > 0 || hreq->response.content_length == 0)
-                return http_on_data_read(asock, (rem == 0 ? NULL:
-                                         (char *)data + size - rem),
-                                         rem, PJ_SUCCESS, NULL);
+                return req_on_data_read(hreq, (char *)data + size - rem,
+                                        rem, PJ_SUCCESS, NULL);
         }
 
         return PJ_TRUE;
@@ -454,6 +534,15 @@ static pj_bool_t http_on_data_read(pj_activesock_t *asock,
         hreq->response.content_length) ||
         (status == PJ_EEOF && hreq->response.content_length == -1)) 
     {
+        /* Keep the pooled connection alive only if the response has been
+         * completely received and the server allows it.
+         */
+        hreq->keep_conn = (hreq->conn && status != PJ_EEOF &&
+                           hreq->response.content_length >= 0 &&
+                           (pj_ssize_t)hreq->tcp_state.current_read_size ==
+                           hreq->response.content_length &&
+                           resp_keep_alive(&hreq->response));
+
         /* Finish reading */
         http_req_end_request(hreq);
         hreq->response.size = hreq->tcp_state.current_read_size;
@@ -478,6 +567,124 @@ static pj_bool_t http_on_data_read(pj_activesock_t *asock,
     return PJ_TRUE;
 }
 
+/* Callback when connection is established to the server */
+static pj_bool_t http_on_connect(pj_activesock_t *asock,
+                                 pj_status_t status)
+{
+    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
+    return req_on_connect(hreq, status);
+}
+
+static pj_bool_t http_on_data_sent(pj_activesock_t *asock,
+                                   pj_ioqueue_op_key_t *op_key,
+                                   pj_ssize_t sent)
+{
+    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
+    return req_on_data_sent(hreq, op_key, sent);
+}
+
+static pj_bool_t http_on_data_read(pj_activesock_t *asock,
+                                  void *data,
+                                  pj_size_t size,
+                                  pj_status_t status,
+                                  pj_size_t *remainder)
+{
+    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
+    return req_on_data_read(hreq, data, size, status, remainder);
+}
+
+/* Leave a callback of pooled connection. The connection's pool is only
+ * released here if the connection was closed inside the callback.
+ */
+static pj_bool_t conn_leave(struct http_conn *conn)
+{
+    if (--conn->cb_depth == 0 && conn->closing) {
+        pj_pool_release(conn->pool);
+        return PJ_FALSE;
+    }
+    return !conn->closing;
+}
+
+/* Callbacks of pooled connection */
+static pj_bool_t conn_on_connect(pj_activesock_t *asock,
+                                 pj_status_t status)
+{
+    struct http_conn *conn;
+
+    conn = (struct http_conn*) pj_activesock_get_user_data(asock);
+    ++conn->cb_depth;
+
+    if (status == PJ_SUCCESS)
+        conn->connected = PJ_TRUE;
+    if (conn->hreq)
+        req_on_connect(conn->hreq, status);
+
+    return conn_leave(conn);
+}
+
+static pj_bool_t conn_on_data_sent(pj_activesock_t *asock,
+                                   pj_ioqueue_op_key_t *op_key,
+                                   pj_ssize_t sent)
+{
+    struct http_conn *conn;
+
+    conn = (struct http_conn*) pj_activesock_get_user_data(asock);
+    ++conn->cb_depth;
+
+    if (conn->hreq && !(sent <= 0 && conn_retry_req(conn->hreq)))
+        req_on_data_sent(conn->hreq, op_key, sent);
+
+    return conn_leave(conn);
+}
+
+static pj_bool_t conn_on_data_read(pj_activesock_t *asock,
+                                   void *data,
+                                   pj_size_t size,
+                                   pj_status_t status,
+                                   pj_size_t *remainder)
+{
+    struct http_conn *conn;
+    pj_http_req *hreq;
+
+    conn = (struct http_conn*) pj_activesock_get_user_data(asock);
+    ++conn->cb_depth;
+
+    pj_lock_acquire(conn->cpool->lock);
+    hreq = conn->hreq;
+    if (!hreq && conn->idle) {
+        pj_list_erase(conn);
+        conn->idle = PJ_FALSE;
+    }
+    pj_lock_release(conn->cpool->lock);
+
+    if (!hreq) {
+        /* The server has closed the idle connection (or sent something
+         * unexpected on it).
+         */
+        TRACE_((THIS_FILE, "Idle HTTP connection closed by server"));
+        conn_release(conn, PJ_FALSE);
+    } else if (size == 0 && status != PJ_SUCCESS && status != PJ_EPENDING &&
+               conn_retry_req(hreq))
+    {
+        /* The server has closed the reused connection before responding,
+         * the request has been resent on a new connection.
+         */
+    } else {
+        if (hreq->state >= SENDING_REQUEST && hreq->state <= REQUEST_SENT) {
+            /* Server responds before the request is completely sent.
+             * Don't reuse this connection since the rest of the request
+             * may still be sent after the response.
+             */
+            conn->no_reuse = PJ_TRUE;
+            hreq->state = READING_RESPONSE;
+            hreq->tcp_state.current_read_size = 0;
+        }
+        req_on_data_read(hreq, data, size, status, remainder);
+    }
+
+    return conn_leave(conn);
+}
+
 /* Callback to be called when query has timed out */
 static void on_timeout( pj_timer_heap_t *timer_heap,
                         struct pj_timer_entry *entry)
@@ -1008,13 +1215,475 @@ PJ_DEF(void*) pj_http_req_get_user_data(pj_http_req *http_req)
     return http_req->param.user_data;
 }
 
+/* Bind the request's socket, to a port within the configured source
+ * port range if there is one.
+ */
+static pj_status_t http_sock_bind(pj_http_req *http_req, pj_sock_t sock)
+{
+    pj_status_t status;
+    int retry = 0;
+
+    do
+    {
+        pj_sockaddr_in bound_addr;
+        pj_uint16_t port = 0;
+
+        /* If we are using port restriction.
+         * Get a random port within the range
+         */
+        if (http_req->param.source_port_range_start != 0) {
+            port = (pj_uint16_t)
+                   (http_req->param.source_port_range_start +
+                    (pj_rand() % http_req->param.source_port_range_size));
+        }
+
+        pj_sockaddr_in_init(&bound_addr, NULL, port);
+        status = pj_sock_bind(sock, &bound_addr, sizeof(bound_addr));
+
+    } while (status != PJ_SUCCESS && (retry++ < http_req->param.max_retries));
+
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(1,(THIS_FILE, status,
+                     "Unable to bind to the requested port"));
+    }
+
+    return status;
+}
+
+/*
+ * Connection pool.
+ */
+PJ_DEF(void) pj_http_conn_pool_param_default(pj_http_conn_pool_param *param)
+{
+    pj_assert(param);
+    pj_bzero(param, sizeof(*param));
+    param->max_conn_per_host = PJ_HTTP_MAX_CONN_PER_HOST;
+    param->idle_timeout = PJ_HTTP_IDLE_TIMEOUT;
+}
+
+PJ_DEF(pj_status_t) pj_http_conn_pool_create(pj_pool_t *pool,
+                                        pj_timer_heap_t *timer,
+                                        pj_ioqueue_t *ioqueue,
+                                        const pj_http_conn_pool_param *param,
+                                        pj_http_conn_pool **p_cpool)
+{
+    pj_pool_t *own_pool;
+    pj_http_conn_pool *cpool;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && timer && ioqueue && p_cpool, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!param || param->max_conn_per_host > 0, PJ_EINVAL);
+
+    own_pool = pj_pool_create(pool->factory, "httpcp%p", INITIAL_POOL_SIZE,
+                              POOL_INCREMENT_SIZE, NULL);
+    cpool = PJ_POOL_ZALLOC_T(own_pool, pj_http_conn_pool);
+    cpool->pool = own_pool;
+    cpool->timer = timer;
+    cpool->ioqueue = ioqueue;
+    if (param)
+        pj_memcpy(&cpool->param, param, sizeof(*param));
+    else
+        pj_http_conn_pool_param_default(&cpool->param);
+    pj_list_init(&cpool->hosts);
+
+    status = pj_lock_create_recursive_mutex(own_pool, "httpcp%p",
+                                            &cpool->lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(own_pool);
+        return status;
+    }
+
+    *p_cpool = cpool;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_http_conn_pool_get_stat(pj_http_conn_pool *cpool,
+                                               pj_http_conn_pool_stat *stat)
+{
+    struct http_host *host;
+
+    PJ_ASSERT_RETURN(cpool && stat, PJ_EINVAL);
+
+    pj_lock_acquire(cpool->lock);
+    pj_memcpy(stat, &cpool->stat, sizeof(*stat));
+    stat->conn_cnt = stat->idle_cnt = stat->wait_cnt = 0;
+    for (host = cpool->hosts.next; host != &cpool->hosts;
+         host = host->next)
+    {
+        stat->conn_cnt += host->conn_cnt;
+        stat->idle_cnt += (unsigned)pj_list_size(&host->idle);
+        stat->wait_cnt += (unsigned)pj_list_size(&host->waiters);
+    }
+    pj_lock_release(cpool->lock);
+
+    return PJ_SUCCESS;
+}
+
+/* Find the server's entry, create one if it doesn't exist yet.
+ * Must be called with the pool's lock held.
+ */
+static struct http_host *conn_get_host(pj_http_conn_pool *cpool,
+                                       const pj_sockaddr *addr)
+{
+    struct http_host *host;
+
+    for (host = cpool->hosts.next; host != &cpool->hosts;
+         host = host->next)
+    {
+        if (pj_sockaddr_cmp(&host->addr, addr) == 0)
+            return host;
+    }
+
+    host = PJ_POOL_ZALLOC_T(cpool->pool, struct http_host);
+    pj_sockaddr_cp(&host->addr, addr);
+    pj_list_init(&host->idle);
+    pj_list_init(&host->waiters);
+    pj_list_push_back(&cpool->hosts, host);
+
+    return host;
+}
+
+/* Close the connection. If a request is waiting for a connection to the
+ * same server, a new connection will be created for it.
+ */
+static void conn_close(struct http_conn *conn)
+{
+    pj_http_conn_pool *cpool = conn->cpool;
+    struct http_host *host = conn->host;
+    struct http_waiter *w = NULL;
+    pj_status_t status;
+
+    pj_lock_acquire(cpool->lock);
+    if (conn->closing) {
+        pj_lock_release(cpool->lock);
+        return;
+    }
+    conn->closing = PJ_TRUE;
+    if (conn->idle) {
+        pj_list_erase(conn);
+        conn->idle = PJ_FALSE;
+    }
+    --host->conn_cnt;
+    if (!pj_list_empty(&host->waiters)) {
+        w = host->waiters.next;
+        pj_list_erase(w);
+        w->hreq->waiting = PJ_FALSE;
+    }
+    pj_lock_release(cpool->lock);
+
+    pj_timer_heap_cancel_if_active(cpool->timer, &conn->idle_timer, 0);
+    if (conn->asock) {
+        pj_activesock_close(conn->asock);
+        conn->asock = NULL;
+    }
+    if (conn->cb_depth == 0)
+        pj_pool_release(conn->pool);
+
+    if (w) {
+        status = conn_acquire(w->hreq, PJ_FALSE);
+        if (status != PJ_SUCCESS) {
+            w->hreq->error = status;
+            pj_http_req_cancel(w->hreq, PJ_TRUE);
+        }
+    }
+}
+
+/* Idle connection has timed out */
+static void conn_on_idle_timeout(pj_timer_heap_t *timer_heap,
+                                 struct pj_timer_entry *entry)
+{
+    struct http_conn *conn = (struct http_conn*) entry->user_data;
+    pj_bool_t idle;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    pj_lock_acquire(conn->cpool->lock);
+    idle = conn->idle;
+    if (idle) {
+        pj_list_erase(conn);
+        conn->idle = PJ_FALSE;
+    }
+    pj_lock_release(conn->cpool->lock);
+
+    if (idle)
+        conn_close(conn);
+}
+
+/* Create a new connection for the request */
+static pj_status_t conn_create(pj_http_conn_pool *cpool,
+                               struct http_host *host,
+                               pj_http_req *hreq,
+                               struct http_conn **p_conn)
+{
+    pj_pool_t *pool;
+    struct http_conn *conn;
+    pj_sock_t sock;
+    pj_activesock_cb asock_cb;
+    pj_status_t status;
+
+    pool = pj_pool_create(cpool->pool->factory, "httpc%p", BUF_SIZE + 512,
+                          POOL_INCREMENT_SIZE, NULL);
+    conn = PJ_POOL_ZALLOC_T(pool, struct http_conn);
+    conn->pool = pool;
+    conn->cpool = cpool;
+    conn->host = host;
+    conn->rbuf = pj_pool_alloc(pool, BUF_SIZE);
+    pj_timer_entry_init(&conn->idle_timer, 0, conn, &conn_on_idle_timeout);
+
+    status = pj_sock_socket(hreq->param.addr_family,
+                            pj_SOCK_STREAM() | pj_SOCK_CLOEXEC(),
+                            0, &sock);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    status = http_sock_bind(hreq, sock);
+    if (status != PJ_SUCCESS) {
+        pj_sock_close(sock);
+        goto on_error;
+    }
+
+    pj_bzero(&asock_cb, sizeof(asock_cb));
+    asock_cb.on_data_read = &conn_on_data_read;
+    asock_cb.on_data_sent = &conn_on_data_sent;
+    asock_cb.on_connect_complete = &conn_on_connect;
+
+    status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), NULL,
+                                  cpool->ioqueue, &asock_cb, conn,
+                                  &conn->asock);
+    if (status != PJ_SUCCESS) {
+        pj_sock_close(sock);
+        goto on_error;
+    }
+
+    *p_conn = conn;
+    return PJ_SUCCESS;
+
+on_error:
+    pj_pool_release(pool);
+    return status;
+}
+
+/* Assign the connection to the request and start sending the request,
+ * connecting first if necessary.
+ */
+static pj_status_t conn_attach(struct http_conn *conn, pj_http_req *hreq,
+                               pj_bool_t reused)
+{
+    pj_status_t status;
+
+    conn->hreq = hreq;
+    hreq->conn = conn;
+    hreq->asock = conn->asock;
+    hreq->conn_reused = reused;
+
+    if (!conn->connected) {
+        hreq->state = CONNECTING;
+        status = pj_activesock_start_connect(conn->asock, conn->pool,
+                                             &hreq->addr,
+                                             pj_sockaddr_get_len(&hreq->addr));
+        if (status == PJ_EPENDING)
+            return PJ_SUCCESS;
+        if (status != PJ_SUCCESS)
+            return status;
+        conn->connected = PJ_TRUE;
+    }
+
+    hreq->state = SENDING_REQUEST;
+    return http_req_start_sending(hreq);
+}
+
+static pj_status_t conn_acquire(pj_http_req *hreq, pj_bool_t force_new)
+{
+    pj_http_conn_pool *cpool = hreq->param.conn_pool;
+    struct http_host *host;
+    struct http_conn *conn = NULL;
+    pj_status_t status;
+
+    pj_lock_acquire(cpool->lock);
+
+    host = conn_get_host(cpool, &hreq->addr);
+    if (!force_new && !pj_list_empty(&host->idle)) {
+        /* Reuse the most recently used idle connection */
+        conn = host->idle.next;
+        pj_list_erase(conn);
+        conn->idle = PJ_FALSE;
+        ++cpool->stat.reused;
+        pj_lock_release(cpool->lock);
+
+        pj_timer_heap_cancel_if_active(cpool->timer, &conn->idle_timer, 0);
+        return conn_attach(conn, hreq, PJ_TRUE);
+    }
+
+    if (host->conn_cnt >= cpool->param.max_conn_per_host) {
+        /* Wait until a connection to the server is available */
+        hreq->state = CONNECTING;
+        hreq->wait_node.hreq = hreq;
+        hreq->waiting = PJ_TRUE;
+        pj_list_push_back(&host->waiters, &hreq->wait_node);
+        pj_lock_release(cpool->lock);
+
+        TRACE_((THIS_FILE, "HTTP request waiting for a connection"));
+        return PJ_SUCCESS;
+    }
+
+    ++host->conn_cnt;
+    ++cpool->stat.created;
+    pj_lock_release(cpool->lock);
+
+    status = conn_create(cpool, host, hreq, &conn);
+    if (status != PJ_SUCCESS) {
+        pj_lock_acquire(cpool->lock);
+        --host->conn_cnt;
+        --cpool->stat.created;
+        pj_lock_release(cpool->lock);
+        return status;
+    }
+
+    return conn_attach(conn, hreq, PJ_FALSE);
+}
+
+/* Release the connection from its request. The connection is either given
+ * to a request waiting for it, kept in the idle list, or closed.
+ */
+static void conn_release(struct http_conn *conn, pj_bool_t keep)
+{
+    pj_http_conn_pool *cpool = conn->cpool;
+    struct http_host *host = conn->host;
+    struct http_waiter *w;
+    pj_status_t status;
+
+    conn->hreq = NULL;
+    if (!keep || conn->no_reuse || conn->closing) {
+        conn_close(conn);
+        return;
+    }
+
+    pj_lock_acquire(cpool->lock);
+    if (pj_list_empty(&host->waiters)) {
+        pj_time_val delay;
+
+        delay.sec = 0;
+        delay.msec = cpool->param.idle_timeout;
+        pj_time_val_normalize(&delay);
+
+        conn->idle = PJ_TRUE;
+        pj_list_push_front(&host->idle, conn);
+        pj_timer_heap_schedule(cpool->timer, &conn->idle_timer, &delay);
+        pj_lock_release(cpool->lock);
+        return;
+    }
+
+    w = host->waiters.next;
+    pj_list_erase(w);
+    w->hreq->waiting = PJ_FALSE;
+    ++cpool->stat.reused;
+    pj_lock_release(cpool->lock);
+
+    status = conn_attach(conn, w->hreq, PJ_TRUE);
+    if (status != PJ_SUCCESS) {
+        w->hreq->error = status;
+        pj_http_req_cancel(w->hreq, PJ_TRUE);
+    }
+}
+
+/* Check if the request method is idempotent (RFC 7231 section 4.2.2),
+ * i.e. it is safe to send the request again.
+ */
+static pj_bool_t is_idempotent(const pj_str_t *method)
+{
+    static const char *methods[] = { "GET", "HEAD", "PUT", "DELETE",
+                                     "OPTIONS" };
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(methods); ++i) {
+        if (!pj_strcmp2(method, methods[i]))
+            return PJ_TRUE;
+    }
+    return PJ_FALSE;
+}
+
+/* The server has closed the reused connection or it has failed before
+ * any response was received. The server may close an idle connection at
+ * any time, so retry the request once on a new connection. This is only
+ * done for idempotent methods, since the server may have processed the
+ * request already, and not if the request body was provided by the
+ * application in chunks. Otherwise the error is reported to application.
+ */
+static pj_bool_t conn_retry_req(pj_http_req *hreq)
+{
+    struct http_conn *conn = hreq->conn;
+    pj_status_t status;
+
+    if (!hreq->conn_reused || hreq->conn_retried ||
+        !is_idempotent(&hreq->param.method) ||
+        hreq->param.reqdata.total_size > 0 ||
+        hreq->state < SENDING_REQUEST || hreq->state > READING_RESPONSE)
+    {
+        return PJ_FALSE;
+    }
+
+    TRACE_((THIS_FILE, "Kept-alive HTTP connection lost, retrying request"));
+
+    conn->hreq = NULL;
+    hreq->conn = NULL;
+    hreq->asock = NULL;
+    conn_close(conn);
+
+    hreq->conn_retried = PJ_TRUE;
+    pj_bzero(&hreq->tcp_state, sizeof(hreq->tcp_state));
+    status = conn_acquire(hreq, PJ_TRUE);
+    if (status != PJ_SUCCESS) {
+        hreq->error = status;
+        pj_http_req_cancel(hreq, PJ_TRUE);
+    }
+
+    return PJ_TRUE;
+}
+
+PJ_DEF(pj_status_t) pj_http_conn_pool_destroy(pj_http_conn_pool *cpool)
+{
+    struct http_host *host;
+
+    PJ_ASSERT_RETURN(cpool, PJ_EINVAL);
+
+    pj_lock_acquire(cpool->lock);
+    for (host = cpool->hosts.next; host != &cpool->hosts;
+         host = host->next)
+    {
+        if (host->conn_cnt != (unsigned)pj_list_size(&host->idle) ||
+            !pj_list_empty(&host->waiters))
+        {
+            pj_lock_release(cpool->lock);
+            return PJ_EBUSY;
+        }
+    }
+
+    for (host = cpool->hosts.next; host != &cpool->hosts;
+         host = host->next)
+    {
+        while (!pj_list_empty(&host->idle))
+            conn_close(host->idle.next);
+    }
+    pj_lock_release(cpool->lock);
+
+    pj_lock_destroy(cpool->lock);
+    pj_pool_release(cpool->pool);
+
+    return PJ_SUCCESS;
+}
+
+static pj_bool_t use_conn_pool(const pj_http_req *http_req)
+{
+    return http_req->param.conn_pool &&
+           !pj_strcmp2(&http_req->param.version, HTTP_1_1);
+}
+
 static pj_status_t start_http_req(pj_http_req *http_req,
                                   pj_bool_t notify_on_fail)
 {
     pj_sock_t sock = PJ_INVALID_SOCKET;
     pj_status_t status;
     pj_activesock_cb asock_cb;
-    int retry = 0;
 
     PJ_ASSERT_RETURN(http_req, PJ_EINVAL);
     /* Http request is not idle, a request was initiated before and 
@@ -1026,6 +1695,8 @@ static pj_status_t start_http_req(pj_http_req *http_req,
     http_req->error = 0;
     http_req->response.headers.count = 0;
     pj_bzero(&http_req->tcp_state, sizeof(http_req->tcp_state));
+    http_req->conn_retried = PJ_FALSE;
+    http_req->keep_conn = PJ_FALSE;
 
     if (!http_req->resolved) {
         /* Resolve the Internet address of the host */
@@ -1042,6 +1713,27 @@ static pj_status_t start_http_req(pj_http_req *http_req,
         http_req->resolved = PJ_TRUE;
     }
 
+    if (use_conn_pool(http_req)) {
+        /* Schedule timeout timer for the request, which also covers the
+         * time waiting for a connection.
+         */
+        pj_assert(http_req->timer_entry.id == 0);
+        http_req->timer_entry.id = 1;
+        status = pj_timer_heap_schedule(http_req->timer,
+                                        &http_req->timer_entry,
+                                        &http_req->param.timeout);
+        if (status != PJ_SUCCESS) {
+            http_req->timer_entry.id = 0;
+            goto on_return; // error scheduling timer
+        }
+
+        status = conn_acquire(http_req, PJ_FALSE);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+
+        return PJ_SUCCESS;
+    }
+
     status = pj_sock_socket(http_req->param.addr_family,
                             pj_SOCK_STREAM() | pj_SOCK_CLOEXEC(),
                             0, &sock);
@@ -1052,29 +1744,9 @@ static pj_status_t start_http_req(pj_http_req *http_req,
     asock_cb.on_data_read = &http_on_data_read;
     asock_cb.on_data_sent = &http_on_data_sent;
     asock_cb.on_connect_complete = &http_on_connect;
-        
-    do
-    {
-        pj_sockaddr_in bound_addr;
-        pj_uint16_t port = 0;
-
-        /* If we are using port restriction.
-         * Get a random port within the range
-         */
-        if (http_req->param.source_port_range_start != 0) {
-            port = (pj_uint16_t)
-                   (http_req->param.source_port_range_start +
-                    (pj_rand() % http_req->param.source_port_range_size));
-        }
-
-        pj_sockaddr_in_init(&bound_addr, NULL, port);
-        status = pj_sock_bind(sock, &bound_addr, sizeof(bound_addr));
-
-    } while (status != PJ_SUCCESS && (retry++ < http_req->param.max_retries));
 
+    status = http_sock_bind(http_req, sock);
     if (status != PJ_SUCCESS) {
-        PJ_PERROR(1,(THIS_FILE, status,
-                     "Unable to bind to the requested port"));
         pj_sock_close(sock);
         goto on_return;
     }
@@ -1583,7 +2255,7 @@ static pj_status_t http_req_start_sending(pj_http_req *hreq)
                                 pkt.ptr, &len, 0);
 
     if (status == PJ_SUCCESS) {
-        http_on_data_sent(hreq->asock, &hreq->op_key, len);
+        req_on_data_sent(hreq, &hreq->op_key, len);
     } else if (status != PJ_EPENDING) {
         goto on_return; // error sending data
     }
@@ -1604,6 +2276,24 @@ static pj_status_t http_req_start_reading(pj_http_req *hreq)
     /* Receive the response */
     hreq->state = READING_RESPONSE;
     hreq->tcp_state.current_read_size = 0;
+
+    if (hreq->conn) {
+        /* Pooled connection keeps reading across requests */
+        struct http_conn *conn = hreq->conn;
+
+        if (conn->reading)
+            return PJ_SUCCESS;
+
+        conn->reading = PJ_TRUE;
+        status = pj_activesock_start_read2(conn->asock, conn->pool, BUF_SIZE,
+                                           &conn->rbuf, 0);
+        if (status != PJ_SUCCESS) {
+            http_req_end_request(hreq);
+            return status;
+        }
+        return PJ_SUCCESS;
+    }
+
     pj_assert(hreq->buffer.ptr);
     status = pj_activesock_start_read2(hreq->asock, hreq->pool, BUF_SIZE, 
                                        (void**)&hreq->buffer.ptr, 0);
@@ -1618,7 +2308,25 @@ static pj_status_t http_req_start_reading(pj_http_req *hreq)
 
 static pj_status_t http_req_end_request(pj_http_req *hreq)
 {
-    if (hreq->asock) {
+    if (hreq->waiting) {
+        pj_http_conn_pool *cpool = hreq->param.conn_pool;
+
+        pj_lock_acquire(cpool->lock);
+        if (hreq->waiting) {
+            pj_list_erase(&hreq->wait_node);
+            hreq->waiting = PJ_FALSE;
+        }
+        pj_lock_release(cpool->lock);
+    }
+
+    if (hreq->conn) {
+        struct http_conn *conn = hreq->conn;
+
+        hreq->conn = NULL;
+        hreq->asock = NULL;
+        conn_release(conn, hreq->keep_conn);
+        hreq->keep_conn = PJ_FALSE;
+    } else if (hreq->asock) {
         pj_activesock_close(hreq->asock);
         hreq->asock = NULL;
     }
@@ -124,28 +124,14 @@ static pj_status_t parse_children(struct parse_state *st,
     return PJ_SUCCESS;
 }
 
-/* Return 0 if success or the index of the invalid char in the string */
-static unsigned parse_quoted_string(struct parse_state *st,
-                                    pj_str_t *output)
+/* Unescape the string in ip to op, which may point to the same buffer.
+ * Return 0 if success or the index of the invalid char in the string.
+ */
+static unsigned unescape_string(const char *ip, const char *iend,
+                                char *op, pj_ssize_t *out_len)
 {
-    pj_str_t token;
-    char *op, *ip, *iend;
-
-    pj_scan_get_quote(&st->scanner, '"', '"', &token);
-
-    /* Remove the quote characters */
-    token.ptr++;
-    token.slen-=2;
-
-    if (pj_strchr(&token, '\\') == NULL) {
-        *output = token;
-        return 0;
-    }
-
-    output->ptr = op = pj_pool_alloc(st->pool, token.slen);
-
-    ip = token.ptr;
-    iend = token.ptr + token.slen;
+    const char *istart = ip;
+    char *ostart = op;
 
     while (ip != iend) {
         if (*ip == '\\') {
@@ -189,12 +175,34 @@ static unsigned parse_quoted_string(struct parse_state *st,
         }
     }
 
-    output->slen = op - output->ptr;
+    *out_len = op - ostart;
     return 0;
 
 on_error:
-    output->slen = op - output->ptr;
-    return (unsigned)(ip - token.ptr);
+    *out_len = op - ostart;
+    return (unsigned)(ip - istart);
+}
+
+/* Return 0 if success or the index of the invalid char in the string */
+static unsigned parse_quoted_string(struct parse_state *st,
+                                    pj_str_t *output)
+{
+    pj_str_t token;
+
+    pj_scan_get_quote(&st->scanner, '"', '"', &token);
+
+    /* Remove the quote characters */
+    token.ptr++;
+    token.slen-=2;
+
+    if (pj_strchr(&token, '\\') == NULL) {
+        *output = token;
+        return 0;
+    }
+
+    output->ptr = pj_pool_alloc(st->pool, token.slen);
+    return unescape_string(token.ptr, token.ptr + token.slen, output->ptr,
+                           &output->slen);
 }
 
 static pj_json_elem* parse_elem_throw(struct parse_state *st,
@@ -340,6 +348,433 @@ PJ_DEF(pj_json_elem*) pj_json_parse(pj_pool_t *pool,
     return root;
 }
 
+/*
+ * Pull parser.
+ */
+#ifndef PJ_JSON_MAX_DEPTH
+#  define PJ_JSON_MAX_DEPTH     64
+#endif
+
+struct pj_json_pull_parser
+{
+    pj_pool_t           *pool;          /* Pool to enlarge the buffer   */
+    pj_json_reader       reader;        /* Reader callback              */
+    void                *user_data;     /* Reader's user data           */
+    char                *buf;           /* Input buffer                 */
+    unsigned             buf_size;      /* Size of the buffer           */
+    unsigned             mark;          /* Start of current token       */
+    unsigned             pos;           /* Current read position        */
+    unsigned             end;           /* End of data in the buffer    */
+    unsigned             name_off;      /* Member name of current token */
+    unsigned             name_len;
+    unsigned             val_off;       /* Value of current token       */
+    unsigned             val_len;
+    pj_bool_t            eof;           /* Reader has reached the end   */
+    pj_bool_t            root_done;     /* Root value has been read     */
+    char                 stack[PJ_JSON_MAX_DEPTH]; /* Open brackets     */
+    unsigned             depth;         /* Number of open brackets      */
+    unsigned             line;          /* Current line                 */
+    unsigned             col;           /* Current column               */
+    pj_status_t          status;        /* Sticky error                 */
+    pj_json_err_info     err_info;      /* Error location               */
+};
+
+/* Make sure there is unread data at the current position, reading more
+ * data if necessary. Data before the mark is no longer needed and may be
+ * discarded to make room.
+ */
+static pj_status_t pull_avail(pj_json_pull_parser *p)
+{
+    while (p->pos >= p->end) {
+        unsigned size;
+        pj_status_t status;
+
+        if (p->eof)
+            return PJ_EEOF;
+
+        if (p->mark) {
+            unsigned shift = p->mark;
+
+            pj_memmove(p->buf, p->buf + shift, p->end - shift);
+            p->mark = 0;
+            p->pos -= shift;
+            p->end -= shift;
+            p->name_off -= shift;
+            p->val_off -= shift;
+        }
+
+        if (p->end == p->buf_size) {
+            /* The token doesn't fit in the buffer, enlarge it */
+            char *buf = (char*)pj_pool_alloc(p->pool, p->buf_size * 2);
+            pj_memcpy(buf, p->buf, p->end);
+            p->buf = buf;
+            p->buf_size *= 2;
+        }
+
+        size = p->buf_size - p->end;
+        status = (*p->reader)(p->buf + p->end, &size, p->user_data);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        if (size == 0)
+            p->eof = PJ_TRUE;
+        else
+            p->end += size;
+    }
+
+    return PJ_SUCCESS;
+}
+
+static void pull_advance(pj_json_pull_parser *p)
+{
+    if (p->buf[p->pos] == '\n') {
+        ++p->line;
+        p->col = 1;
+    } else {
+        ++p->col;
+    }
+    ++p->pos;
+}
+
+/* Skip whitespaces, and commas if allowed (like pj_json_parse(), commas
+ * between values are not strictly checked). The skipped data is discarded
+ * unless the member name has been read.
+ */
+static pj_status_t pull_skip_ws(pj_json_pull_parser *p, pj_bool_t comma)
+{
+    pj_status_t status;
+
+    while ((status = pull_avail(p)) == PJ_SUCCESS) {
+        char c = p->buf[p->pos];
+
+        if (!pj_isspace(c) && !(comma && c == ','))
+            break;
+        pull_advance(p);
+        if (!p->name_len)
+            p->mark = p->pos;
+    }
+
+    return status;
+}
+
+/* Read quoted string at the current position into val_off/val_len */
+static pj_status_t pull_string(pj_json_pull_parser *p)
+{
+    pj_ssize_t len;
+    pj_status_t status;
+
+    pull_advance(p);
+    p->val_off = p->pos;
+
+    for (;;) {
+        char c;
+
+        status = pull_avail(p);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        c = p->buf[p->pos];
+        if (c == '"')
+            break;
+
+        pull_advance(p);
+        if (c == '\\') {
+            status = pull_avail(p);
+            if (status != PJ_SUCCESS)
+                return status;
+            pull_advance(p);
+        }
+    }
+
+    p->val_len = p->pos - p->val_off;
+    pull_advance(p);
+
+    if (unescape_string(p->buf + p->val_off, p->buf + p->val_off + p->val_len,
+                        p->buf + p->val_off, &len) != 0)
+    {
+        return PJLIB_UTIL_EINJSON;
+    }
+    p->val_len = (unsigned)len;
+
+    return PJ_SUCCESS;
+}
+
+/* Read number or literal at the current position into val_off/val_len */
+static pj_status_t pull_word(pj_json_pull_parser *p)
+{
+    pj_status_t status;
+
+    p->val_off = p->pos;
+    while ((status = pull_avail(p)) == PJ_SUCCESS) {
+        char c = p->buf[p->pos];
+
+        if (!pj_isalnum(c) && c != '.' && c != '-')
+            break;
+        pull_advance(p);
+    }
+    p->val_len = p->pos - p->val_off;
+
+    if (status == PJ_EEOF && p->val_len)
+        status = PJ_SUCCESS;
+
+    return status;
+}
+
+static pj_status_t pull_next(pj_json_pull_parser *p, pj_json_token *tok)
+{
+    char c;
+    pj_status_t status;
+
+    p->mark = p->pos;
+    p->name_len = p->val_len = 0;
+
+    status = pull_skip_ws(p, p->depth > 0);
+    if (p->depth == 0 && p->root_done) {
+        tok->type = PJ_JSON_TOKEN_EOF;
+        tok->depth = 0;
+        return PJ_SUCCESS;
+    }
+    if (status != PJ_SUCCESS)
+        return status;
+
+    c = p->buf[p->pos];
+    if (p->depth) {
+        char open = p->stack[p->depth-1];
+
+        if ((open == '{' && c == '}') || (open == '[' && c == ']')) {
+            pull_advance(p);
+            if (--p->depth == 0)
+                p->root_done = PJ_TRUE;
+            tok->type = (c == '}') ? PJ_JSON_TOKEN_OBJ_END :
+                                     PJ_JSON_TOKEN_ARRAY_END;
+            tok->depth = p->depth;
+            return PJ_SUCCESS;
+        }
+
+        if (open == '{') {
+            /* Member name */
+            if (c != '"')
+                return PJLIB_UTIL_EINJSON;
+            status = pull_string(p);
+            if (status != PJ_SUCCESS)
+                return status;
+            p->name_off = p->val_off;
+            p->name_len = p->val_len;
+
+            status = pull_skip_ws(p, PJ_FALSE);
+            if (status != PJ_SUCCESS)
+                return status;
+            if (p->buf[p->pos] != ':')
+                return PJLIB_UTIL_EINJSON;
+            pull_advance(p);
+
+            status = pull_skip_ws(p, PJ_FALSE);
+            if (status != PJ_SUCCESS)
+                return status;
+            c = p->buf[p->pos];
+        }
+    }
+
+    tok->depth = p->depth;
+
+    if (c == '{' || c == '[') {
+        if (p->depth == PJ_JSON_MAX_DEPTH)
+            return PJ_ETOOMANY;
+        pull_advance(p);
+        p->stack[p->depth++] = c;
+        tok->type = (c == '{') ? PJ_JSON_TOKEN_OBJ_START :
+                                 PJ_JSON_TOKEN_ARRAY_START;
+    } else if (c == '"') {
+        status = pull_string(p);
+        if (status != PJ_SUCCESS)
+            return status;
+        tok->type = PJ_JSON_TOKEN_STRING;
+    } else {
+        pj_str_t word;
+
+        status = pull_word(p);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        word.ptr = p->buf + p->val_off;
+        word.slen = p->val_len;
+        if (!pj_strcmp2(&word, "true") || !pj_strcmp2(&word, "false")) {
+            tok->type = PJ_JSON_TOKEN_BOOL;
+            tok->value.is_true = (*word.ptr == 't');
+        } else if (!pj_strcmp2(&word, "null")) {
+            tok->type = PJ_JSON_TOKEN_NULL;
+        } else if (pj_isdigit(*word.ptr) || *word.ptr == '.' ||
+                   *word.ptr == '-')
+        {
+            pj_bool_t neg = (*word.ptr == '-');
+
+            if (neg) {
+                word.ptr++;
+                word.slen--;
+            }
+            tok->type = PJ_JSON_TOKEN_NUMBER;
+            tok->value.num = pj_strtof(&word);
+            if (neg) tok->value.num = -tok->value.num;
+        } else {
+            return PJLIB_UTIL_EINJSON;
+        }
+    }
+
+    if (p->depth == 0)
+        p->root_done = PJ_TRUE;
+
+    /* The buffer may have been moved, set the pointers last */
+    if (p->name_len) {
+        tok->name.ptr = p->buf + p->name_off;
+        tok->name.slen = p->name_len;
+    }
+    if (tok->type == PJ_JSON_TOKEN_STRING) {
+        tok->value.str.ptr = p->buf + p->val_off;
+        tok->value.str.slen = p->val_len;
+    }
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_json_pull_create(pj_pool_t *pool,
+                                        pj_json_reader reader,
+                                        void *user_data,
+                                        unsigned buf_size,
+                                        pj_json_pull_parser **p_parser)
+{
+    pj_json_pull_parser *p;
+
+    PJ_ASSERT_RETURN(pool && reader && buf_size && p_parser, PJ_EINVAL);
+
+    p = PJ_POOL_ZALLOC_T(pool, pj_json_pull_parser);
+    p->pool = pool;
+    p->reader = reader;
+    p->user_data = user_data;
+    p->buf = (char*)pj_pool_alloc(pool, buf_size);
+    p->buf_size = buf_size;
+    p->line = p->col = 1;
+
+    *p_parser = p;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_json_pull_next(pj_json_pull_parser *parser,
+                                      pj_json_token *token)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(parser && token, PJ_EINVAL);
+
+    if (parser->status != PJ_SUCCESS)
+        return parser->status;
+
+    pj_bzero(token, sizeof(*token));
+    status = pull_next(parser, token);
+    if (status != PJ_SUCCESS) {
+        if (status == PJ_EEOF)
+            status = PJLIB_UTIL_EINJSON;
+        parser->status = status;
+        parser->err_info.line = parser->line;
+        parser->err_info.col = parser->col;
+        parser->err_info.err_char = (parser->pos < parser->end) ?
+                                    parser->buf[parser->pos] : 0;
+    }
+
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_json_pull_skip(pj_json_pull_parser *parser)
+{
+    unsigned depth;
+
+    PJ_ASSERT_RETURN(parser && parser->depth, PJ_EINVALIDOP);
+
+    depth = parser->depth - 1;
+    for (;;) {
+        pj_json_token tok;
+        pj_status_t status;
+
+        status = pj_json_pull_next(parser, &tok);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        if ((tok.type == PJ_JSON_TOKEN_OBJ_END ||
+             tok.type == PJ_JSON_TOKEN_ARRAY_END) && tok.depth == depth)
+        {
+            return PJ_SUCCESS;
+        }
+    }
+}
+
+PJ_DEF(pj_status_t) pj_json_pull_read_elem(pj_json_pull_parser *parser,
+                                           pj_pool_t *pool,
+                                           const pj_json_token *token,
+                                           pj_json_elem **p_elem)
+{
+    pj_json_elem *elem;
+    pj_str_t name = {NULL, 0}, str = {NULL, 0};
+
+    PJ_ASSERT_RETURN(parser && pool && token && p_elem, PJ_EINVAL);
+
+    elem = PJ_POOL_ALLOC_T(pool, pj_json_elem);
+    pj_strdup(pool, &name, &token->name);
+
+    switch (token->type) {
+    case PJ_JSON_TOKEN_NULL:
+        pj_json_elem_null(elem, &name);
+        break;
+    case PJ_JSON_TOKEN_BOOL:
+        pj_json_elem_bool(elem, &name, token->value.is_true);
+        break;
+    case PJ_JSON_TOKEN_NUMBER:
+        pj_json_elem_number(elem, &name, token->value.num);
+        break;
+    case PJ_JSON_TOKEN_STRING:
+        pj_strdup(pool, &str, &token->value.str);
+        pj_json_elem_string(elem, &name, &str);
+        break;
+    case PJ_JSON_TOKEN_ARRAY_START:
+    case PJ_JSON_TOKEN_OBJ_START:
+        if (token->type == PJ_JSON_TOKEN_ARRAY_START)
+            pj_json_elem_array(elem, &name);
+        else
+            pj_json_elem_obj(elem, &name);
+
+        for (;;) {
+            pj_json_token child_tok;
+            pj_json_elem *child;
+            pj_status_t status;
+
+            status = pj_json_pull_next(parser, &child_tok);
+            if (status != PJ_SUCCESS)
+                return status;
+            if (child_tok.type == PJ_JSON_TOKEN_ARRAY_END ||
+                child_tok.type == PJ_JSON_TOKEN_OBJ_END)
+            {
+                break;
+            }
+
+            status = pj_json_pull_read_elem(parser, pool, &child_tok, &child);
+            if (status != PJ_SUCCESS)
+                return status;
+            pj_json_elem_add(elem, child);
+        }
+        break;
+    default:
+        return PJ_EINVALIDOP;
+    }
+
+    *p_elem = elem;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_json_pull_get_err_info(const pj_json_pull_parser *parser,
+                                       pj_json_err_info *err_info)
+{
+    pj_assert(parser && err_info);
+    pj_memcpy(err_info, &parser->err_info, sizeof(*err_info));
+}
+
 struct buf_writer_data
 {
     char        *pos;
@@ -531,30 +966,41 @@ static pj_status_t write_children(const pj_json_list *list,
     return PJ_SUCCESS;
 }
 
-static pj_status_t elem_write(const pj_json_elem *elem,
+static pj_status_t write_name(const pj_str_t *name,
                               struct write_state *st,
                               unsigned flags)
 {
     pj_status_t status;
 
-    if (elem->name.slen) {
+    if (name->slen) {
         CHECK( st->writer( st->indent_buf, st->indent, st->user_data) );
         if ((flags & NO_NAME)==0) {
             CHECK( st->writer( "\"", 1, st->user_data) );
-            CHECK( write_string_escaped(&elem->name, st) );
+            CHECK( write_string_escaped(name, st) );
             CHECK( st->writer( "\": ", 3, st->user_data) );
-            if (elem->name.slen < PJ_JSON_NAME_MIN_LEN /*&&
+            if (name->slen < PJ_JSON_NAME_MIN_LEN /*&&
                 elem->type != PJ_JSON_VAL_OBJ &&
                 elem->type != PJ_JSON_VAL_ARRAY*/)
             {
                 CHECK( st->writer( st->space,
                                    (unsigned)(PJ_JSON_NAME_MIN_LEN -
-                                              elem->name.slen),
+                                              name->slen),
                                    st->user_data) );
             }
         }
     }
 
+    return PJ_SUCCESS;
+}
+
+static pj_status_t elem_write(const pj_json_elem *elem,
+                              struct write_state *st,
+                              unsigned flags)
+{
+    pj_status_t status;
+
+    CHECK( write_name(&elem->name, st, flags) );
+
     switch (elem->type) {
     case PJ_JSON_VAL_NULL:
         CHECK( st->writer( "null", 4, st->user_data) );
@@ -619,3 +1065,278 @@ PJ_DEF(pj_status_t) pj_json_writef( const pj_json_elem *elem,
     return elem_write(elem, &st, 0);
 }
 
+
+/*
+ * Stream writer.
+ */
+struct stream_level
+{
+    char                 quotes[2];     /* Brackets of this container   */
+    unsigned             count;         /* Number of children written   */
+    pj_bool_t            multiline;     /* Children are on own lines    */
+    pj_bool_t            indent_added;  /* Whether indentation added    */
+};
+
+struct pj_json_stream
+{
+    struct write_state   ws;            /* Formatting state             */
+    pj_json_writer       writer;        /* Application's writer         */
+    void                *user_data;     /* Writer's user data           */
+    char                *buf;           /* Output buffer                */
+    unsigned             buf_size;      /* Size of the buffer           */
+    unsigned             len;           /* Length of buffered output    */
+    struct stream_level  levels[PJ_JSON_MAX_DEPTH]; /* Open containers  */
+    unsigned             depth;         /* Number of open containers    */
+    pj_bool_t            root_done;     /* Root value has been written  */
+    pj_status_t          status;        /* Sticky error                 */
+};
+
+/* Writer callback of the formatting state, buffers the output */
+static pj_status_t stream_buf_write(const char *s,
+                                    unsigned size,
+                                    void *user_data)
+{
+    pj_json_stream *js = (pj_json_stream*)user_data;
+
+    if (js->len + size > js->buf_size) {
+        pj_status_t status = pj_json_stream_flush(js);
+        if (status != PJ_SUCCESS)
+            return status;
+        if (size > js->buf_size)
+            return (*js->writer)(s, size, js->user_data);
+    }
+
+    pj_memcpy(js->buf + js->len, s, size);
+    js->len += size;
+
+    return PJ_SUCCESS;
+}
+
+/* Write the separator before a new value in the current container, the
+ * same way as write_children() does it.
+ */
+static pj_status_t stream_begin_value(pj_json_stream *js,
+                                      const pj_str_t *name,
+                                      unsigned *flags)
+{
+    struct stream_level *lvl;
+    pj_status_t status;
+
+    if (js->status != PJ_SUCCESS)
+        return js->status;
+
+    *flags = 0;
+    if (js->depth == 0)
+        return js->root_done ? PJ_EINVALIDOP : PJ_SUCCESS;
+
+    lvl = &js->levels[js->depth-1];
+    if (lvl->count == 0) {
+        lvl->multiline = (name && name->slen);
+        if (lvl->multiline) {
+            if (js->ws.indent < (int)sizeof(js->ws.indent_buf)) {
+                js->ws.indent += PJ_JSON_INDENT_SIZE;
+                lvl->indent_added = PJ_TRUE;
+            }
+            status = stream_buf_write("\n", 1, js);
+        } else {
+            status = PJ_SUCCESS;
+        }
+    } else {
+        status = lvl->multiline ? stream_buf_write(",\n", 2, js) :
+                                  stream_buf_write(", ", 2, js);
+    }
+
+    ++lvl->count;
+    if (lvl->quotes[0] == '[')
+        *flags = NO_NAME;
+
+    return status;
+}
+
+static pj_status_t stream_end_value(pj_json_stream *js, pj_status_t status)
+{
+    if (status != PJ_SUCCESS)
+        js->status = status;
+    else if (js->depth == 0)
+        js->root_done = PJ_TRUE;
+    return status;
+}
+
+static pj_status_t stream_begin(pj_json_stream *js,
+                                const pj_str_t *name,
+                                const char quotes[2])
+{
+    const pj_str_t no_name = {NULL, 0};
+    struct stream_level *lvl;
+    unsigned flags;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(js, PJ_EINVAL);
+    PJ_ASSERT_RETURN(js->depth < PJ_JSON_MAX_DEPTH, PJ_ETOOMANY);
+
+    status = stream_begin_value(js, name, &flags);
+    if (status == PJ_SUCCESS)
+        status = write_name(name ? name : &no_name, &js->ws, flags);
+    if (status == PJ_SUCCESS)
+        status = stream_buf_write(&quotes[0], 1, js);
+    if (status == PJ_SUCCESS)
+        status = stream_buf_write(" ", 1, js);
+    if (status != PJ_SUCCESS) {
+        js->status = status;
+        return status;
+    }
+
+    lvl = &js->levels[js->depth++];
+    pj_bzero(lvl, sizeof(*lvl));
+    lvl->quotes[0] = quotes[0];
+    lvl->quotes[1] = quotes[1];
+
+    return PJ_SUCCESS;
+}
+
+/* Write scalar value using elem_write() */
+static pj_status_t stream_add_value(pj_json_stream *js, pj_json_elem *el)
+{
+    unsigned flags;
+    pj_status_t status;
+
+    status = stream_begin_value(js, &el->name, &flags);
+    if (status == PJ_SUCCESS)
+        status = elem_write(el, &js->ws, flags);
+
+    return stream_end_value(js, status);
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_create(pj_pool_t *pool,
+                                          pj_json_writer writer,
+                                          void *user_data,
+                                          unsigned buf_size,
+                                          pj_json_stream **p_stream)
+{
+    pj_json_stream *js;
+
+    PJ_ASSERT_RETURN(pool && writer && buf_size && p_stream, PJ_EINVAL);
+
+    js = PJ_POOL_ZALLOC_T(pool, pj_json_stream);
+    js->ws.writer = &stream_buf_write;
+    js->ws.user_data = js;
+    pj_memset(js->ws.indent_buf, ' ', MAX_INDENT);
+    pj_memset(js->ws.space, ' ', PJ_JSON_NAME_MIN_LEN);
+    js->writer = writer;
+    js->user_data = user_data;
+    js->buf = (char*)pj_pool_alloc(pool, buf_size);
+    js->buf_size = buf_size;
+
+    *p_stream = js;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_begin_obj(pj_json_stream *stream,
+                                             const pj_str_t *name)
+{
+    return stream_begin(stream, name, "{}");
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_begin_array(pj_json_stream *stream,
+                                               const pj_str_t *name)
+{
+    return stream_begin(stream, name, "[]");
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_end(pj_json_stream *stream)
+{
+    struct stream_level *lvl;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(stream && stream->depth, PJ_EINVALIDOP);
+
+    if (stream->status != PJ_SUCCESS)
+        return stream->status;
+
+    lvl = &stream->levels[--stream->depth];
+    if (lvl->count && lvl->multiline) {
+        if (lvl->indent_added)
+            stream->ws.indent -= PJ_JSON_INDENT_SIZE;
+        status = stream_buf_write("\n", 1, stream);
+        if (status == PJ_SUCCESS)
+            status = stream_buf_write(stream->ws.indent_buf,
+                                      stream->ws.indent, stream);
+    }
+    if (status == PJ_SUCCESS)
+        status = stream_buf_write(&lvl->quotes[1], 1, stream);
+
+    return stream_end_value(stream, status);
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_add_null(pj_json_stream *stream,
+                                            const pj_str_t *name)
+{
+    pj_json_elem el;
+
+    PJ_ASSERT_RETURN(stream, PJ_EINVAL);
+    pj_json_elem_null(&el, (pj_str_t*)name);
+    return stream_add_value(stream, &el);
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_add_bool(pj_json_stream *stream,
+                                            const pj_str_t *name,
+                                            pj_bool_t val)
+{
+    pj_json_elem el;
+
+    PJ_ASSERT_RETURN(stream, PJ_EINVAL);
+    pj_json_elem_bool(&el, (pj_str_t*)name, val);
+    return stream_add_value(stream, &el);
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_add_number(pj_json_stream *stream,
+                                              const pj_str_t *name,
+                                              float val)
+{
+    pj_json_elem el;
+
+    PJ_ASSERT_RETURN(stream, PJ_EINVAL);
+    pj_json_elem_number(&el, (pj_str_t*)name, val);
+    return stream_add_value(stream, &el);
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_add_string(pj_json_stream *stream,
+                                              const pj_str_t *name,
+                                              const pj_str_t *val)
+{
+    pj_json_elem el;
+
+    PJ_ASSERT_RETURN(stream && val, PJ_EINVAL);
+    pj_json_elem_string(&el, (pj_str_t*)name, (pj_str_t*)val);
+    return stream_add_value(stream, &el);
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_add_elem(pj_json_stream *stream,
+                                            const pj_json_elem *elem)
+{
+    unsigned flags;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(stream && elem, PJ_EINVAL);
+
+    status = stream_begin_value(stream, &elem->name, &flags);
+    if (status == PJ_SUCCESS)
+        status = elem_write(elem, &stream->ws, flags);
+
+    return stream_end_value(stream, status);
+}
+
+PJ_DEF(pj_status_t) pj_json_stream_flush(pj_json_stream *stream)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(stream, PJ_EINVAL);
+
+    if (stream->len == 0)
+        return PJ_SUCCESS;
+
+    status = (*stream->writer)(stream->buf, stream->len, stream->user_data);
+    stream->len = 0;
+
+    return status;
+}
@@ -22,6 +22,8 @@
 #include <pj/assert.h>
 #include <pj/ctype.h>
 #include <pj/except.h>
+#include <pj/file_access.h>
+#include <pj/file_io.h>
 #include <pj/hash.h>
 #include <pj/ioqueue.h>
 #include <pj/log.h>
@@ -142,6 +144,7 @@ struct pj_dns_async_query
     void                *user_data;     /**< Application data.              */
     pj_dns_callback     *cb;            /**< Callback to be called.         */
     struct query_head    child_head;    /**< Child queries list head.       */
+    pj_bool_t            is_prefetch;   /**< Background cache refresh?      */
 };
 
 
@@ -156,6 +159,9 @@ struct cached_res
     struct res_key           key;           /**< Resource key.              */
     pj_hash_entry_buf        hbuf;          /**< Hash buffer                */
     pj_time_val              expiry_time;   /**< Expiration time.           */
+    unsigned                 ttl;           /**< Original TTL, in seconds.  */
+    unsigned                 hit_cnt;       /**< Number of cache hits.      */
+    pj_status_t              status;        /**< Status if pkt is NULL.     */
     pj_dns_parsed_packet    *pkt;           /**< The response packet.       */
     unsigned                 ref_cnt;       /**< Reference counter.         */
 };
@@ -218,6 +224,9 @@ struct pj_dns_resolver
 
     /* Query entries free list */
     struct query_head    query_free_nodes;
+
+    /* Cache statistics */
+    pj_dns_resolver_stat stat;
 };
 
 
@@ -369,6 +378,10 @@ PJ_DEF(void) pj_dns_settings_default(pj_dns_settings *s)
     s->cache_max_ttl = PJ_DNS_RESOLVER_MAX_TTL;
     s->good_ns_ttl = PJ_DNS_RESOLVER_GOOD_NS_TTL;
     s->bad_ns_ttl = PJ_DNS_RESOLVER_BAD_NS_TTL;
+    s->cache_neg_ttl = PJ_DNS_RESOLVER_INVALID_TTL;
+    s->cache_fail_ttl = PJ_DNS_RESOLVER_FAIL_TTL;
+    s->prefetch_pct = PJ_DNS_RESOLVER_PREFETCH_PCT;
+    s->prefetch_min_hits = PJ_DNS_RESOLVER_PREFETCH_MIN_HITS;
 }
 
 
@@ -850,6 +863,96 @@ static void free_entry(pj_dns_resolver *resolver, struct cached_res *cache)
 }
 
 
+/* Assign transaction ID to a new query, transmit it, and register it in
+ * the pending query hash tables.
+ */
+static pj_status_t send_new_query(pj_dns_resolver *resolver,
+                                  pj_dns_async_query *q,
+                                  const struct res_key *key)
+{
+    pj_status_t status;
+
+    /* Save the ID and key */
+    /* TODO: dnsext-forgery-resilient: randomize id for security */
+    q->id = resolver->last_id++;
+    if (resolver->last_id == 0)
+        resolver->last_id = 1;
+    pj_memcpy(&q->key, key, sizeof(struct res_key));
+
+    /* Send the query */
+    status = transmit_query(resolver, q);
+    if (status != PJ_SUCCESS) {
+        pj_list_push_back(&resolver->query_free_nodes, q);
+        return status;
+    }
+
+    /* Add query entry to the hash tables */
+    pj_hash_set_np(resolver->hquerybyid, &q->id, sizeof(q->id), 
+                   0, q->hbufid, q);
+    pj_hash_set_np(resolver->hquerybyres, &q->key, sizeof(q->key),
+                   0, q->hbufkey, q);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Refresh a popular cached response in the background if it is about to
+ * expire. Must be called with the resolver lock held.
+ */
+static void check_prefetch(pj_dns_resolver *resolver,
+                           struct cached_res *cache,
+                           const pj_time_val *now)
+{
+    pj_dns_async_query *q;
+    pj_time_val remaining;
+    pj_status_t status;
+
+    ++cache->hit_cnt;
+
+    /* Only prefetch positive responses which expire */
+    if (resolver->settings.prefetch_pct == 0 || cache->pkt == NULL ||
+        cache->ttl == 0 || cache->pkt->hdr.anscount == 0 ||
+        PJ_DNS_GET_RCODE(cache->pkt->hdr.flags) != 0 ||
+        cache->hit_cnt < resolver->settings.prefetch_min_hits)
+    {
+        return;
+    }
+
+    remaining = cache->expiry_time;
+    PJ_TIME_VAL_SUB(remaining, *now);
+    if (PJ_TIME_VAL_MSEC(remaining) * 100 >
+        (long)cache->ttl * 1000 * resolver->settings.prefetch_pct)
+    {
+        return;
+    }
+
+    /* Don't prefetch if there's pending query on the same resource */
+    if (pj_hash_get(resolver->hquerybyres, &cache->key, sizeof(cache->key),
+                    NULL))
+    {
+        return;
+    }
+
+    q = alloc_qnode(resolver, 0, NULL, NULL);
+    q->is_prefetch = PJ_TRUE;
+
+    status = send_new_query(resolver, q, &cache->key);
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4,(resolver->name.ptr, status,
+                     "Error prefetching DNS %s record for %s",
+                     pj_dns_get_type_name(cache->key.qtype),
+                     cache->key.name));
+        return;
+    }
+
+    ++resolver->stat.prefetch_cnt;
+    PJ_LOG(5,(resolver->name.ptr,
+              "Prefetching DNS %s record for %s, ttl=%ld ms",
+              pj_dns_get_type_name(cache->key.qtype), cache->key.name,
+              PJ_TIME_VAL_MSEC(remaining)));
+}
+
+
 /*
  * Create and start asynchronous DNS query for a single resource.
  */
@@ -906,9 +1009,22 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
                       (int)name->slen, name->ptr,
                       (int)(cache->expiry_time.sec - now.sec)));
 
-            /* Map DNS Rcode in the response into PJLIB status name space */
-            status = PJ_DNS_GET_RCODE(cache->pkt->hdr.flags);
-            status = PJ_STATUS_FROM_DNS_RCODE(status);
+            /* Map DNS Rcode in the response into PJLIB status name space,
+             * or use the saved status for failed query.
+             */
+            if (cache->pkt) {
+                status = PJ_DNS_GET_RCODE(cache->pkt->hdr.flags);
+                status = PJ_STATUS_FROM_DNS_RCODE(status);
+            } else {
+                status = cache->status;
+            }
+
+            ++resolver->stat.cache_hit;
+            if (status != PJ_SUCCESS || cache->pkt->hdr.anscount == 0)
+                ++resolver->stat.cache_neg_hit;
+
+            /* Refresh the entry in the background if it's about to expire */
+            check_prefetch(resolver, cache, &now);
 
             /* Workaround for deadlock problem. Need to increment the cache's
              * ref counter first before releasing mutex, so the cache won't be
@@ -959,6 +1075,9 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
         /* Must continue with creating a query now */
     }
 
+    /* The query will have to wait for nameserver response */
+    ++resolver->stat.cache_miss;
+
     /* Next, check if we have pending query on the same resource */
     q = (pj_dns_async_query *) pj_hash_get(resolver->hquerybyres, &key, 
                                            sizeof(key), NULL);
@@ -982,26 +1101,9 @@ PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
 
     /* There's no pending query to the same key, initiate a new one. */
     q = alloc_qnode(resolver, options, user_data, cb);
-
-    /* Save the ID and key */
-    /* TODO: dnsext-forgery-resilient: randomize id for security */
-    q->id = resolver->last_id++;
-    if (resolver->last_id == 0)
-        resolver->last_id = 1;
-    pj_memcpy(&q->key, &key, sizeof(struct res_key));
-
-    /* Send the query */
-    status = transmit_query(resolver, q);
-    if (status != PJ_SUCCESS) {
-        pj_list_push_back(&resolver->query_free_nodes, q);
+    status = send_new_query(resolver, q, &key);
+    if (status != PJ_SUCCESS)
         goto on_return;
-    }
-
-    /* Add query entry to the hash tables */
-    pj_hash_set_np(resolver->hquerybyid, &q->id, sizeof(q->id), 
-                   0, q->hbufid, q);
-    pj_hash_set_np(resolver->hquerybyres, &q->key, sizeof(q->key),
-                   0, q->hbufkey, q);
 
     p_q = q;
 
@@ -1466,12 +1568,16 @@ static void update_res_cache(pj_dns_resolver *resolver,
 
     /* Calculate expiration time. */
     if (set_expiry) {
-        if (pkt->hdr.anscount == 0 || status != PJ_SUCCESS) {
+        if (pkt == NULL) {
+            /* Query has failed without any response */
+            ttl = resolver->settings.cache_fail_ttl;
+
+        } else if (pkt->hdr.anscount == 0 || status != PJ_SUCCESS) {
             /* If we don't have answers for the name, then give a different
-             * ttl value (note: PJ_DNS_RESOLVER_INVALID_TTL may be zero, 
-             * which means that invalid names won't be kept in the cache)
+             * ttl value (note: the negative TTL may be zero, which means
+             * that invalid names won't be kept in the cache)
              */
-            ttl = PJ_DNS_RESOLVER_INVALID_TTL;
+            ttl = resolver->settings.cache_neg_ttl;
 
         } else {
             /* Otherwise get the minimum TTL from the answers */
@@ -1530,14 +1636,18 @@ static void update_res_cache(pj_dns_resolver *resolver,
      * section since DNS A parser needs the query section to know
      * the name being requested.
      */
-    pj_dns_packet_dup(cache->pool, pkt, 
-                      PJ_DNS_NO_NS | PJ_DNS_NO_AR,
-                      &cache->pkt);
+    if (pkt) {
+        pj_dns_packet_dup(cache->pool, pkt, 
+                          PJ_DNS_NO_NS | PJ_DNS_NO_AR,
+                          &cache->pkt);
+    }
+    cache->status = status;
 
     /* Calculate expiration time */
     if (set_expiry) {
         pj_gettimeofday(&cache->expiry_time);
         cache->expiry_time.sec += ttl;
+        cache->ttl = ttl;
     } else {
         cache->expiry_time.sec = 0x7FFFFFFFL;
         cache->expiry_time.msec = 0;
@@ -1622,6 +1732,12 @@ static void on_timeout( pj_timer_heap_t *timer_heap,
     q->timer_entry.id = 0;
     q->user_data = NULL;
 
+    /* Remember the failure so that subsequent queries fail immediately,
+     * unless it's a background refresh of a still valid entry.
+     */
+    if (!q->is_prefetch && resolver->settings.cache_fail_ttl)
+        update_res_cache(resolver, &q->key, PJ_ETIMEDOUT, PJ_TRUE, NULL);
+
     /* Put child entries into recycle list */
     cq = q->child_head.next;
     while (cq != (void*)&q->child_head) {
@@ -1771,10 +1887,16 @@ static void on_read_complete(pj_ioqueue_key_t *key,
     /* Workaround for deadlock problem in #1108 */
     pj_grp_lock_acquire(resolver->grp_lock);
 
-    /* Truncated responses MUST NOT be saved (cached). */
-    if (PJ_DNS_GET_TC(dns_pkt->hdr.flags) == 0) {
+    /* Truncated responses MUST NOT be saved (cached). Also don't let
+     * failed background refresh replace the still valid entry.
+     */
+    if (PJ_DNS_GET_TC(dns_pkt->hdr.flags) == 0 &&
+        (!q->is_prefetch || status == PJ_SUCCESS))
+    {
         /* Save/update response cache. */
         update_res_cache(resolver, &q->key, status, PJ_TRUE, dns_pkt);
+        if (q->is_prefetch)
+            ++resolver->stat.prefetch_ok;
     }
 
     /* Recycle query objects, starting with the child queries */
@@ -1879,6 +2001,516 @@ PJ_DEF(unsigned) pj_dns_resolver_get_cached_count(pj_dns_resolver *resolver)
 }
 
 
+/*
+ * Get the resolver cache statistics.
+ */
+PJ_DEF(pj_status_t) pj_dns_resolver_get_stat(pj_dns_resolver *resolver,
+                                             pj_dns_resolver_stat *stat)
+{
+    PJ_ASSERT_RETURN(resolver && stat, PJ_EINVAL);
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+    pj_memcpy(stat, &resolver->stat, sizeof(*stat));
+    pj_grp_lock_release(resolver->grp_lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Reset the resolver cache statistics.
+ */
+PJ_DEF(pj_status_t) pj_dns_resolver_reset_stat(pj_dns_resolver *resolver)
+{
+    PJ_ASSERT_RETURN(resolver, PJ_EINVAL);
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+    pj_bzero(&resolver->stat, sizeof(resolver->stat));
+    pj_grp_lock_release(resolver->grp_lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Cache snapshot file. All numbers are in network byte order:
+ *
+ *  header:  "PJDC" magic, 16bit version, 16bit reserved, 32bit time when
+ *           the snapshot was saved (seconds since the epoch).
+ *  entries: 16bit query type, name, 32bit remaining TTL, 16bit packet
+ *           flags, 16bit answer count, followed by the answers. Each
+ *           answer is name, 16bit type, 16bit class, 32bit TTL, and the
+ *           resource data encoded according to the type.
+ *
+ * Names are written as 16bit length followed by the characters.
+ */
+#define CACHE_FILE_MAGIC        "PJDC"
+#define CACHE_FILE_VERSION      1
+
+/* Minimum size of an answer in the file: empty name, type, class, TTL */
+#define CACHE_FILE_MIN_RR_LEN   10
+
+/* Buffered writer for the cache snapshot file */
+struct cache_writer
+{
+    pj_oshandle_t        fd;
+    pj_uint8_t           buf[512];
+    pj_size_t            len;
+    pj_status_t          status;
+};
+
+static void cw_flush(struct cache_writer *w)
+{
+    pj_ssize_t size = (pj_ssize_t)w->len;
+
+    if (w->status == PJ_SUCCESS && size)
+        w->status = pj_file_write(w->fd, w->buf, &size);
+    w->len = 0;
+}
+
+static void cw_put(struct cache_writer *w, const void *data, pj_size_t len)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*)data;
+
+    while (len) {
+        pj_size_t n = sizeof(w->buf) - w->len;
+        if (n > len)
+            n = len;
+        pj_memcpy(w->buf + w->len, p, n);
+        w->len += n;
+        p += n;
+        len -= n;
+        if (w->len == sizeof(w->buf))
+            cw_flush(w);
+    }
+}
+
+static void cw_put16(struct cache_writer *w, pj_uint16_t val)
+{
+    val = pj_htons(val);
+    cw_put(w, &val, 2);
+}
+
+static void cw_put32(struct cache_writer *w, pj_uint32_t val)
+{
+    val = pj_htonl(val);
+    cw_put(w, &val, 4);
+}
+
+static void cw_put_str(struct cache_writer *w, const pj_str_t *str)
+{
+    cw_put16(w, (pj_uint16_t)str->slen);
+    cw_put(w, str->ptr, str->slen);
+}
+
+/* Reader for the cache snapshot file, sets err on truncated input */
+struct cache_reader
+{
+    const pj_uint8_t    *p;
+    const pj_uint8_t    *end;
+    pj_bool_t            err;
+};
+
+static const void *cr_get(struct cache_reader *r, pj_size_t len)
+{
+    const pj_uint8_t *p = r->p;
+
+    if (r->err || (pj_size_t)(r->end - r->p) < len) {
+        r->err = PJ_TRUE;
+        return NULL;
+    }
+    r->p += len;
+    return p;
+}
+
+static pj_uint16_t cr_get16(struct cache_reader *r)
+{
+    pj_uint16_t val;
+    const void *p = cr_get(r, 2);
+
+    if (!p)
+        return 0;
+    pj_memcpy(&val, p, 2);
+    return pj_ntohs(val);
+}
+
+static pj_uint32_t cr_get32(struct cache_reader *r)
+{
+    pj_uint32_t val;
+    const void *p = cr_get(r, 4);
+
+    if (!p)
+        return 0;
+    pj_memcpy(&val, p, 4);
+    return pj_ntohl(val);
+}
+
+static void cr_get_str(struct cache_reader *r, pj_str_t *str)
+{
+    pj_uint16_t len = cr_get16(r);
+
+    str->ptr = (char*)cr_get(r, len);
+    str->slen = str->ptr ? len : 0;
+}
+
+static void write_cached_rr(struct cache_writer *w, const pj_dns_parsed_rr *rr)
+{
+    cw_put_str(w, &rr->name);
+    cw_put16(w, rr->type);
+    cw_put16(w, rr->dnsclass);
+    cw_put32(w, rr->ttl);
+
+    switch (rr->type) {
+    case PJ_DNS_TYPE_A:
+        cw_put(w, &rr->rdata.a.ip_addr, 4);
+        break;
+    case PJ_DNS_TYPE_AAAA:
+        cw_put(w, &rr->rdata.aaaa.ip_addr, 16);
+        break;
+    case PJ_DNS_TYPE_CNAME:
+        cw_put_str(w, &rr->rdata.cname.name);
+        break;
+    case PJ_DNS_TYPE_NS:
+        cw_put_str(w, &rr->rdata.ns.name);
+        break;
+    case PJ_DNS_TYPE_PTR:
+        cw_put_str(w, &rr->rdata.ptr.name);
+        break;
+    case PJ_DNS_TYPE_SRV:
+        cw_put16(w, rr->rdata.srv.prio);
+        cw_put16(w, rr->rdata.srv.weight);
+        cw_put16(w, rr->rdata.srv.port);
+        cw_put_str(w, &rr->rdata.srv.target);
+        break;
+    default:
+        cw_put16(w, (pj_uint16_t)(rr->data ? rr->rdlength : 0));
+        if (rr->data)
+            cw_put(w, rr->data, rr->rdlength);
+        break;
+    }
+}
+
+static void read_cached_rr(struct cache_reader *r, pj_dns_parsed_rr *rr)
+{
+    const void *p;
+
+    cr_get_str(r, &rr->name);
+    if (rr->name.slen >= PJ_MAX_HOSTNAME)
+        r->err = PJ_TRUE;
+    rr->type = cr_get16(r);
+    rr->dnsclass = cr_get16(r);
+    rr->ttl = cr_get32(r);
+
+    switch (rr->type) {
+    case PJ_DNS_TYPE_A:
+        rr->rdlength = 4;
+        if ((p = cr_get(r, 4)) != NULL)
+            pj_memcpy(&rr->rdata.a.ip_addr, p, 4);
+        break;
+    case PJ_DNS_TYPE_AAAA:
+        rr->rdlength = 16;
+        if ((p = cr_get(r, 16)) != NULL)
+            pj_memcpy(&rr->rdata.aaaa.ip_addr, p, 16);
+        break;
+    case PJ_DNS_TYPE_CNAME:
+        cr_get_str(r, &rr->rdata.cname.name);
+        break;
+    case PJ_DNS_TYPE_NS:
+        cr_get_str(r, &rr->rdata.ns.name);
+        break;
+    case PJ_DNS_TYPE_PTR:
+        cr_get_str(r, &rr->rdata.ptr.name);
+        break;
+    case PJ_DNS_TYPE_SRV:
+        rr->rdata.srv.prio = cr_get16(r);
+        rr->rdata.srv.weight = cr_get16(r);
+        rr->rdata.srv.port = cr_get16(r);
+        cr_get_str(r, &rr->rdata.srv.target);
+        break;
+    default:
+        rr->rdlength = cr_get16(r);
+        if (rr->rdlength)
+            rr->data = (void*)cr_get(r, rr->rdlength);
+        break;
+    }
+}
+
+
+/* Response copied out of the cache to be saved */
+struct saved_res
+{
+    pj_uint16_t                  qtype;
+    pj_str_t                     name;
+    pj_uint32_t                  remaining;
+    pj_dns_parsed_packet        *pkt;
+};
+
+/*
+ * Save the response cache to a file.
+ */
+PJ_DEF(pj_status_t) pj_dns_resolver_save_cache(pj_dns_resolver *resolver,
+                                               const char *filename,
+                                               unsigned *p_count)
+{
+    pj_pool_t *pool;
+    struct cache_writer w;
+    struct saved_res *res;
+    pj_hash_iterator_t itbuf, *it;
+    pj_time_val now;
+    char *tmp_filename;
+    pj_size_t len;
+    unsigned i, count = 0;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(resolver && filename, PJ_EINVAL);
+
+    pool = pj_pool_create(resolver->pool->factory, "dnssave", 4000, 4000,
+                          NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    /* Copy the responses out of the cache, so that the file is written
+     * without holding the lock.
+     */
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    pj_gettimeofday(&now);
+    res = (struct saved_res*)
+          pj_pool_calloc(pool, pj_hash_count(resolver->hrescache) + 1,
+                         sizeof(struct saved_res));
+
+    it = pj_hash_first(resolver->hrescache, &itbuf);
+    while (it) {
+        struct cached_res *cache;
+        const pj_dns_parsed_packet *pkt;
+        pj_str_t name;
+
+        cache = (struct cached_res*)pj_hash_this(resolver->hrescache, it);
+        it = pj_hash_next(resolver->hrescache, it);
+
+        /* Only save positive responses which expire in the future */
+        pkt = cache->pkt;
+        if (pkt == NULL || pkt->hdr.anscount == 0 ||
+            PJ_DNS_GET_RCODE(pkt->hdr.flags) != 0 ||
+            cache->expiry_time.sec == 0x7FFFFFFFL ||
+            cache->expiry_time.sec <= now.sec)
+        {
+            continue;
+        }
+
+        res[count].qtype = cache->key.qtype;
+        pj_strdup(pool, &res[count].name, pj_cstr(&name, cache->key.name));
+        res[count].remaining = (pj_uint32_t)(cache->expiry_time.sec -
+                                             now.sec);
+        pj_dns_packet_dup(pool, pkt, PJ_DNS_NO_QD | PJ_DNS_NO_NS |
+                          PJ_DNS_NO_AR, &res[count].pkt);
+        ++count;
+    }
+
+    pj_grp_lock_release(resolver->grp_lock);
+
+    /* Write to a temporary file first and rename it when complete, so that
+     * an existing snapshot is not lost if saving fails halfway.
+     */
+    len = pj_ansi_strlen(filename) + 5;
+    tmp_filename = (char*)pj_pool_alloc(pool, len);
+    pj_ansi_snprintf(tmp_filename, len, "%s.tmp", filename);
+
+    pj_bzero(&w, sizeof(w));
+    status = pj_file_open(pool, tmp_filename, PJ_O_WRONLY, &w.fd);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    cw_put(&w, CACHE_FILE_MAGIC, 4);
+    cw_put16(&w, CACHE_FILE_VERSION);
+    cw_put16(&w, 0);
+    cw_put32(&w, (pj_uint32_t)now.sec);
+
+    for (i=0; i<count; ++i) {
+        const pj_dns_parsed_packet *pkt = res[i].pkt;
+        unsigned j;
+
+        cw_put16(&w, res[i].qtype);
+        cw_put_str(&w, &res[i].name);
+        cw_put32(&w, res[i].remaining);
+        cw_put16(&w, pkt->hdr.flags);
+        cw_put16(&w, pkt->hdr.anscount);
+        for (j=0; j<pkt->hdr.anscount; ++j)
+            write_cached_rr(&w, &pkt->ans[j]);
+    }
+
+    cw_flush(&w);
+    status = w.status;
+    pj_file_close(w.fd);
+
+    if (status == PJ_SUCCESS)
+        status = pj_file_move(tmp_filename, filename);
+    if (status != PJ_SUCCESS)
+        pj_file_delete(tmp_filename);
+
+on_return:
+    pj_pool_release(pool);
+
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4,(resolver->name.ptr, status,
+                     "Error saving DNS cache to %s", filename));
+        return status;
+    }
+
+    PJ_LOG(4,(resolver->name.ptr, "%d DNS cache entries saved to %s",
+              count, filename));
+
+    if (p_count)
+        *p_count = count;
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Load the response cache from a file.
+ */
+PJ_DEF(pj_status_t) pj_dns_resolver_load_cache(pj_dns_resolver *resolver,
+                                               const char *filename,
+                                               unsigned *p_count)
+{
+    pj_pool_t *pool;
+    pj_oshandle_t fd;
+    struct cache_reader r;
+    const void *magic;
+    pj_uint8_t *buf;
+    pj_ssize_t size;
+    pj_off_t file_size;
+    pj_time_val now;
+    long elapsed;
+    unsigned count = 0;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(resolver && filename, PJ_EINVAL);
+
+    if (p_count)
+        *p_count = 0;
+
+    if (!pj_file_exists(filename))
+        return PJ_ENOTFOUND;
+
+    file_size = pj_file_size(filename);
+    if (file_size < 12)
+        return PJLIB_UTIL_EDNSINCACHE;
+
+    pool = pj_pool_create(resolver->pool->factory, "dnsload",
+                          (pj_size_t)file_size + 1000, 1000, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    /* Read the whole file, the entries point to the buffer */
+    buf = (pj_uint8_t*)pj_pool_alloc(pool, (pj_size_t)file_size);
+    status = pj_file_open(pool, filename, PJ_O_RDONLY, &fd);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+    size = (pj_ssize_t)file_size;
+    status = pj_file_read(fd, buf, &size);
+    pj_file_close(fd);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+    r.p = buf;
+    r.end = buf + size;
+    r.err = PJ_FALSE;
+
+    magic = cr_get(&r, 4);
+    if (!magic || pj_memcmp(magic, CACHE_FILE_MAGIC, 4) != 0 ||
+        cr_get16(&r) != CACHE_FILE_VERSION)
+    {
+        pj_pool_release(pool);
+        return PJLIB_UTIL_EDNSINCACHE;
+    }
+    cr_get16(&r);
+
+    /* Time elapsed since the snapshot was taken */
+    pj_gettimeofday(&now);
+    elapsed = (long)(now.sec - (long)cr_get32(&r));
+    if (elapsed < 0)
+        elapsed = 0;
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    while (r.p < r.end && !r.err) {
+        pj_dns_parsed_packet pkt;
+        pj_dns_parsed_query q;
+        struct res_key key;
+        struct cached_res *cache;
+        pj_uint32_t remaining;
+        unsigned i;
+
+        pj_bzero(&pkt, sizeof(pkt));
+        pj_bzero(&q, sizeof(q));
+        q.type = cr_get16(&r);
+        q.dnsclass = PJ_DNS_CLASS_IN;
+        cr_get_str(&r, &q.name);
+        remaining = cr_get32(&r);
+        pkt.hdr.flags = cr_get16(&r);
+        pkt.hdr.qdcount = 1;
+        pkt.hdr.anscount = cr_get16(&r);
+        pkt.q = &q;
+
+        /* The answers must fit in the rest of the file */
+        if (r.err || q.name.slen == 0 || q.name.slen >= PJ_MAX_HOSTNAME ||
+            pkt.hdr.anscount == 0 ||
+            pkt.hdr.anscount > (pj_size_t)(r.end - r.p) /
+                               CACHE_FILE_MIN_RR_LEN)
+        {
+            r.err = PJ_TRUE;
+            break;
+        }
+
+        pkt.ans = (pj_dns_parsed_rr*)
+                  pj_pool_calloc(pool, pkt.hdr.anscount,
+                                 sizeof(pj_dns_parsed_rr));
+        for (i=0; i<pkt.hdr.anscount; ++i)
+            read_cached_rr(&r, &pkt.ans[i]);
+        if (r.err)
+            break;
+
+        /* Skip responses which have expired in the meantime */
+        if (remaining <= (pj_uint32_t)elapsed)
+            continue;
+        remaining -= elapsed;
+
+        /* Don't replace responses that we already have */
+        init_res_key(&key, q.type, &q.name);
+        cache = (struct cached_res*)pj_hash_get(resolver->hrescache, &key,
+                                                sizeof(key), NULL);
+        if (cache && PJ_TIME_VAL_GT(cache->expiry_time, now))
+            continue;
+
+        /* The cache expiry is calculated from the lowest TTL */
+        for (i=0; i<pkt.hdr.anscount; ++i) {
+            if (pkt.ans[i].ttl > remaining)
+                pkt.ans[i].ttl = remaining;
+        }
+
+        update_res_cache(resolver, &key, PJ_SUCCESS, PJ_TRUE, &pkt);
+        ++count;
+    }
+
+    pj_grp_lock_release(resolver->grp_lock);
+    pj_pool_release(pool);
+
+    PJ_LOG(4,(resolver->name.ptr, "%d DNS cache entries loaded from %s",
+              count, filename));
+
+    if (p_count)
+        *p_count = count;
+
+    return r.err ? PJLIB_UTIL_EDNSINCACHE : PJ_SUCCESS;
+}
+
+
 /*
  * Dump resolver state to the log.
  */
@@ -1912,6 +2544,11 @@ PJ_DEF(void) pj_dns_resolver_dump(pj_dns_resolver *resolver,
 
     PJ_LOG(3,(resolver->name.ptr, "  Nb. of cached responses: %u",
               pj_hash_count(resolver->hrescache)));
+    PJ_LOG(3,(resolver->name.ptr, "  Cache hit: %u (negative: %u), "
+              "miss: %u, prefetch: %u (refreshed: %u)",
+              resolver->stat.cache_hit, resolver->stat.cache_neg_hit,
+              resolver->stat.cache_miss, resolver->stat.prefetch_cnt,
+              resolver->stat.prefetch_ok));
     if (detail) {
         pj_hash_iterator_t itbuf, *it;
         it = pj_hash_first(resolver->hrescache, &itbuf);
@@ -1138,6 +1138,62 @@
 #   define PJ_SSL_SOCK_OSSL_USE_THREAD_CB   0
 #endif
 
+/**
+ * Maximum number of OpenSSL contexts (SSL_CTX) kept in the shared context
+ * cache. Secure sockets with identical settings (role, protocol, ciphers,
+ * certificate, key and CA list) will share one reference counted context,
+ * so certificates and keys are loaded once instead of for every socket.
+ * Server session cache and client sessions are kept with the context,
+ * which allows abbreviated handshakes when connections are re-established.
+ * Set to 0 to disable the cache. This is only applicable for OpenSSL
+ * version 1.1.0 or later.
+ *
+ * Default: 16
+ */
+#ifndef PJ_SSL_SOCK_OSSL_CTX_CACHE_SIZE
+#   define PJ_SSL_SOCK_OSSL_CTX_CACHE_SIZE  16
+#endif
+
+/**
+ * Maximum number of client sessions kept in each cached OpenSSL context,
+ * to be resumed when connecting again to the same server. Set to 0 to
+ * disable client session resumption. This setting is only applicable when
+ * PJ_SSL_SOCK_OSSL_CTX_CACHE_SIZE is enabled.
+ *
+ * Default: 16
+ */
+#ifndef PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT
+#   define PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT  16
+#endif
+
+/**
+ * Specify whether OpenSSL server sockets issue session tickets (RFC 5077
+ * for TLSv1.2 and below, and TLSv1.3 tickets), in addition to the session
+ * ID based server session cache.
+ *
+ * Default: 1 (enabled)
+ */
+#ifndef PJ_SSL_SOCK_OSSL_SESSION_TICKETS
+#   define PJ_SSL_SOCK_OSSL_SESSION_TICKETS 1
+#endif
+
+/**
+ * Specify whether OpenSSL backend supports kernel TLS offload (Linux
+ * kTLS), i.e: after the handshake, record encryption and decryption are
+ * handed over to the kernel, see \a enable_ktls in #pj_ssl_sock_param.
+ * This requires OpenSSL version 3.0 or later and Linux kernel headers
+ * providing <linux/tls.h>.
+ *
+ * Default: 1 on Linux, 0 otherwise
+ */
+#ifndef PJ_SSL_SOCK_OSSL_HAS_KTLS
+#   if defined(PJ_LINUX) && PJ_LINUX!=0
+#       define PJ_SSL_SOCK_OSSL_HAS_KTLS    1
+#   else
+#       define PJ_SSL_SOCK_OSSL_HAS_KTLS    0
+#   endif
+#endif
+
 
 /**
  * Disable WSAECONNRESET error for UDP sockets on Win32 platforms. See
@@ -819,6 +819,20 @@ typedef struct pj_ssl_sock_info
      */
     void *native_ssl;
 
+    /**
+     * Describes whether the connection resumed a previous TLS session,
+     * i.e: an abbreviated handshake has been performed. Currently only
+     * available for OpenSSL backend.
+     */
+    pj_bool_t session_reused;
+
+    /**
+     * Describes whether record encryption and decryption of the connection
+     * have been offloaded to the kernel (kTLS), see \a enable_ktls in
+     * #pj_ssl_sock_param.
+     */
+    pj_bool_t ktls;
+
 } pj_ssl_sock_info;
 
 
@@ -1107,6 +1121,20 @@ typedef struct pj_ssl_sock_param
      */
     pj_bool_t enable_renegotiation;
 
+    /**
+     * Specify whether to offload record encryption and decryption to the
+     * kernel (kTLS) once the handshake completes, so the connection is
+     * read and written as a plain TCP socket afterwards. This is only
+     * supported by OpenSSL backend on Linux (see PJ_SSL_SOCK_OSSL_HAS_KTLS)
+     * with TLSv1.2 or TLSv1.3 and AES-GCM or ChaCha20-Poly1305 ciphers.
+     * When the kernel or the negotiated session does not support it, the
+     * connection silently stays in userspace TLS. Note that renegotiation
+     * is not available on an offloaded connection.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t enable_ktls;
+
 } pj_ssl_sock_param;
 
 
@@ -33,6 +33,18 @@
 
 enum { MAX_BIND_RETRY = 100 };
 
+#ifdef SSL_SOCK_IMP_USE_KTLS
+/* Offload record protection of established session to kernel TLS,
+ * returns PJ_ENOTSUP when the session should stay in userspace.
+ */
+static pj_status_t ssl_ktls_start(pj_ssl_sock_t *ssock);
+/* Handle read error on kernel TLS socket, returns PJ_SUCCESS when it was
+ * caused by a non application data record that has been consumed.
+ */
+static pj_status_t ssl_ktls_on_read_error(pj_ssl_sock_t *ssock,
+                                          pj_status_t status);
+#endif
+
 #ifndef SSL_SOCK_IMP_USE_OWN_NETWORK
 static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
                                      void *data,
@@ -253,6 +265,18 @@ static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock,
     ssock->handshake_status = status;
     pj_lock_release(ssock->write_mutex);
 
+#ifdef SSL_SOCK_IMP_USE_KTLS
+    /* Hand the session over to kernel TLS */
+    if (status == PJ_SUCCESS && ssock->param.enable_ktls) {
+        pj_status_t status_ = ssl_ktls_start(ssock);
+        if (status_ != PJ_SUCCESS && status_ != PJ_ENOTSUP) {
+            PJ_PERROR(2,(ssock->pool->obj_name, status_,
+                         "Failed to switch to kernel TLS"));
+            ssock->handshake_status = status = status_;
+        }
+    }
+#endif
+
     /* Cancel handshake timer */
     if (ssock->timer.id == TIMER_HANDSHAKE_TIMEOUT) {
         pj_timer_heap_cancel(ssock->param.timer_heap, &ssock->timer);
@@ -730,12 +754,89 @@ static void ssl_on_destroy(void *arg)
                                         ((pj_int8_t*)(asock_rbuf) + \
                                         ssock->param.read_buffer_size)
 
+#ifdef SSL_SOCK_IMP_USE_KTLS
+/* Data read on kernel TLS socket is already decrypted, just pass it to
+ * the application read buffer. Data that doesn't fit is left in the active
+ * socket read buffer.
+ */
+static pj_bool_t ktls_on_data_read(pj_ssl_sock_t *ssock,
+                                   void *data,
+                                   pj_size_t size,
+                                   pj_status_t status,
+                                   pj_size_t *remainder)
+{
+    pj_size_t consumed = 0;
+
+    if (status != PJ_SUCCESS) {
+        status = ssl_ktls_on_read_error(ssock, status);
+        if (status == PJ_SUCCESS) {
+            /* Control record consumed, continue reading */
+            *remainder = size;
+            return PJ_TRUE;
+        }
+    }
+
+    while (data && ssock->read_started && consumed < size) {
+        read_data_t *buf = *(OFFSET_OF_READ_DATA_PTR(ssock, data));
+        pj_size_t len = PJ_MIN(size - consumed, ssock->read_size - buf->len);
+
+        if (len == 0)
+            break;
+
+        pj_memcpy((pj_int8_t*)buf->data + buf->len,
+                  (pj_int8_t*)data + consumed, len);
+        buf->len += len;
+        consumed += len;
+
+        if (ssock->param.cb.on_data_read) {
+            pj_size_t remainder_ = 0;
+
+            if (!(*ssock->param.cb.on_data_read)(ssock, buf->data, buf->len,
+                                                 PJ_SUCCESS, &remainder_))
+            {
+                /* We've been destroyed */
+                return PJ_FALSE;
+            }
+            buf->len = remainder_;
+        } else {
+            buf->len = 0;
+        }
+    }
+
+    if (status != PJ_SUCCESS) {
+        if (ssock->read_started && ssock->param.cb.on_data_read) {
+            if (!(*ssock->param.cb.on_data_read)(ssock, NULL, 0, status,
+                                                 remainder))
+            {
+                /* We've been destroyed */
+                return PJ_FALSE;
+            }
+        }
+
+        ssl_reset_sock_state(ssock);
+        return PJ_FALSE;
+    }
+
+    if (consumed && consumed < size) {
+        pj_memmove(data, (pj_int8_t*)data + consumed, size - consumed);
+    }
+    *remainder = size - consumed;
+
+    return PJ_TRUE;
+}
+#endif
+
 static pj_bool_t ssock_on_data_read (pj_ssl_sock_t *ssock,
                                      void *data,
                                      pj_size_t size,
                                      pj_status_t status,
                                      pj_size_t *remainder)
 {
+#ifdef SSL_SOCK_IMP_USE_KTLS
+    if (ssock->ktls)
+        return ktls_on_data_read(ssock, data, size, status, remainder);
+#endif
+
     if (status != PJ_SUCCESS)
         goto on_error;
 
@@ -876,10 +977,28 @@ static pj_bool_t ssock_on_data_sent (pj_ssl_sock_t *ssock,
                                      pj_ioqueue_op_key_t *send_key,
                                      pj_ssize_t sent)
 {
-    write_data_t *wdata = (write_data_t*)send_key->user_data;
-    pj_ioqueue_op_key_t *app_key = wdata->app_key;
+    write_data_t *wdata;
+    pj_ioqueue_op_key_t *app_key;
     pj_ssize_t sent_len;
 
+#ifdef SSL_SOCK_IMP_USE_KTLS
+    /* On kernel TLS socket, application data is sent directly using
+     * the application send key, see pj_ssl_sock_send().
+     */
+    if (ssock->ktls) {
+        if (send_key != &ssock->handshake_op_key &&
+            send_key != &ssock->shutdown_op_key &&
+            ssock->param.cb.on_data_sent)
+        {
+            return (*ssock->param.cb.on_data_sent)(ssock, send_key, sent);
+        }
+        return PJ_TRUE;
+    }
+#endif
+
+    wdata = (write_data_t*)send_key->user_data;
+    app_key = wdata->app_key;
+
     sent_len = (sent > 0)? (pj_ssize_t)wdata->plain_data_len : sent;
 
     /* Update write buffer state */
@@ -1592,12 +1711,17 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
     /* Group lock */
     info->grp_lock = ssock->param.grp_lock;
 
+    /* Kernel TLS offload */
+    info->ktls = ssock->ktls;
+
     /* Native SSL object */
 #if defined(PJ_HAS_SSL_SOCK) && PJ_HAS_SSL_SOCK != 0 && \
     (PJ_SSL_SOCK_IMP == PJ_SSL_SOCK_IMP_OPENSSL)
     {
         ossl_sock_t *ossock = (ossl_sock_t *)ssock;
         info->native_ssl = ossock->ossl_ssl;
+        if (ossock->ossl_ssl && info->established)
+            info->session_reused = SSL_session_reused(ossock->ossl_ssl);
     }
 #endif
 
@@ -1867,6 +1991,12 @@ PJ_DEF(pj_status_t) pj_ssl_sock_send (pj_ssl_sock_t *ssock,
     if (ssock->ssl_state != SSL_STATE_ESTABLISHED) 
         return PJ_EINVALIDOP;
 
+#ifdef SSL_SOCK_IMP_USE_KTLS
+    /* Kernel will encrypt the data */
+    if (ssock->ktls)
+        return pj_activesock_send(ssock->asock, send_key, data, size, flags);
+#endif
+
     // Ticket #1573: Don't hold mutex while calling PJLIB socket send().
     //pj_lock_acquire(ssock->write_mutex);
 
@@ -2221,7 +2351,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_renegotiate(pj_ssl_sock_t *ssock)
 
     PJ_ASSERT_RETURN(ssock, PJ_EINVAL);
 
-    if (ssock->ssl_state != SSL_STATE_ESTABLISHED) 
+    if (ssock->ssl_state != SSL_STATE_ESTABLISHED || ssock->ktls)
         return PJ_EINVALIDOP;
 
     status = ssl_renegotiate(ssock);
@@ -116,6 +116,7 @@ struct pj_ssl_sock_t
 
     pj_bool_t             is_closing;
     unsigned long         last_err;
+    pj_bool_t             ktls;     /* records are offloaded to kernel TLS */
 
     pj_sock_t             sock;
     pj_activesock_t      *asock;
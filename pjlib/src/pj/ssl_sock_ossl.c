@@ -19,6 +19,7 @@
 #include <pj/activesock.h>
 #include <pj/compat/socket.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
 #include <pj/errno.h>
 #include <pj/file_access.h>
 #include <pj/list.h>
@@ -64,7 +65,7 @@
 #define SERVER_SUPPORT_SESSION_REUSE 1
 
 /* Specify whether server should disable session tickets. */
-#define SERVER_DISABLE_SESSION_TICKETS 1
+#define SERVER_DISABLE_SESSION_TICKETS (PJ_SSL_SOCK_OSSL_SESSION_TICKETS == 0)
 
 /* Each server application must set its own session id context,
  * which is used to distinguish the contexts and is stored in
@@ -95,6 +96,40 @@
 #      define USING_BORINGSSL 0
 #endif
 
+/* Shared SSL context cache, requires SSL_CTX_up_ref() and
+ * CRYPTO_THREAD_lock_new() which are available since OpenSSL 1.1.0.
+ */
+#if PJ_SSL_SOCK_OSSL_CTX_CACHE_SIZE > 0 && !USING_LIBRESSL && \
+    !USING_BORINGSSL && OPENSSL_VERSION_NUMBER >= 0x10100000L
+#   define USE_CTX_CACHE 1
+#   include <openssl/evp.h>
+#else
+#   define USE_CTX_CACHE 0
+#endif
+
+/* Kernel TLS offload, requires EVP_KDF API which is available since
+ * OpenSSL 3.0 to derive the record keys.
+ */
+#if PJ_SSL_SOCK_OSSL_HAS_KTLS && !USING_LIBRESSL && !USING_BORINGSSL && \
+    OPENSSL_VERSION_NUMBER >= 0x30000000L
+#   define USE_KTLS 1
+#   define SSL_SOCK_IMP_USE_KTLS
+#   include <errno.h>
+#   include <netinet/tcp.h>
+#   include <linux/tls.h>
+#   include <openssl/core_names.h>
+#   include <openssl/evp.h>
+#   include <openssl/kdf.h>
+#   ifndef SOL_TLS
+#       define SOL_TLS  282
+#   endif
+#   ifndef TCP_ULP
+#       define TCP_ULP  31
+#   endif
+#else
+#   define USE_KTLS 0
+#endif
+
 #if !USING_LIBRESSL && !defined(OPENSSL_NO_EC) \
         && OPENSSL_VERSION_NUMBER >= 0x1000200fL
 
@@ -228,6 +263,13 @@ typedef struct ossl_sock_t
     SSL                  *ossl_ssl;
     BIO                  *ossl_rbio;
     BIO                  *ossl_wbio;
+#if USE_KTLS
+    /* TLSv1.3 application traffic secrets, client & server */
+    unsigned char         ktls_secret[2][EVP_MAX_MD_SIZE];
+    unsigned              ktls_secret_len[2];
+    pj_uint64_t           ktls_seq[2];  /* record sequence, read & write */
+    pj_bool_t             ktls_disabled;
+#endif
 } ossl_sock_t;
 
 
@@ -683,6 +725,842 @@ static pj_status_t init_ossl_lock()
 
 #endif
 
+#if USE_CTX_CACHE
+
+/* Length of the cache keys, i.e: SHA-256 digest. */
+#define CTX_KEY_LEN             32
+
+#if PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT > 0
+#   define CTX_SESS_CNT         PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT
+#else
+#   define CTX_SESS_CNT         1
+#endif
+
+/* Client session, resumable when connecting to the same peer again. */
+typedef struct ctx_cache_sess
+{
+    unsigned char        peer[CTX_KEY_LEN];
+    SSL_SESSION         *sess;
+    pj_uint32_t          last_use;
+} ctx_cache_sess;
+
+/* Shared SSL context. The cache holds one reference of the context, each
+ * SSL socket using the context holds another one.
+ */
+typedef struct ctx_cache_entry
+{
+    unsigned char        key[CTX_KEY_LEN];
+    SSL_CTX             *ctx;
+    pj_uint32_t          last_use;
+    ctx_cache_sess       sess[CTX_SESS_CNT];
+} ctx_cache_entry;
+
+static CRYPTO_RWLOCK    *ctx_cache_lock;
+static pj_uint32_t       ctx_cache_clock;
+static ctx_cache_entry   ctx_cache[PJ_SSL_SOCK_OSSL_CTX_CACHE_SIZE];
+
+/* Add length prefixed data to the cache key digest. */
+static void ctx_key_update(EVP_MD_CTX *md, const void *data, pj_size_t len)
+{
+    pj_uint32_t len32 = (pj_uint32_t)len;
+
+    EVP_DigestUpdate(md, &len32, sizeof(len32));
+    if (len)
+        EVP_DigestUpdate(md, data, len);
+}
+
+/* Add a file name and its size and modification time to the cache key
+ * digest, so the context is not reused after the file has been updated.
+ */
+static void ctx_key_update_file(EVP_MD_CTX *md, const pj_str_t *path)
+{
+    pj_file_stat st;
+
+    ctx_key_update(md, path->ptr, path->slen);
+    if (path->slen && pj_file_getstat(path->ptr, &st) == PJ_SUCCESS) {
+        EVP_DigestUpdate(md, &st.size, sizeof(st.size));
+        EVP_DigestUpdate(md, &st.mtime, sizeof(st.mtime));
+    }
+}
+
+/* Calculate the cache key from all settings applied by init_ossl_ctx(). */
+static pj_bool_t ctx_cache_calc_key(pj_ssl_sock_t *ssock,
+                                    unsigned char key[CTX_KEY_LEN])
+{
+    pj_ssl_cert_t *cert = ssock->cert;
+    EVP_MD_CTX *md;
+    pj_uint32_t val[5];
+    unsigned len = 0;
+    int ok;
+
+    md = EVP_MD_CTX_new();
+    if (!md)
+        return PJ_FALSE;
+
+    ok = EVP_DigestInit_ex(md, EVP_sha256(), NULL);
+    if (ok) {
+        val[0] = ssock->is_server;
+        val[1] = ssock->param.proto;
+        val[2] = ssock->param.enable_renegotiation;
+        val[3] = (cert != NULL);
+        val[4] = ssock->param.enable_ktls || ssock->newsock_param.enable_ktls;
+        ctx_key_update(md, val, sizeof(val));
+        ctx_key_update(md, ssock->param.ciphers,
+                       ssock->param.ciphers_num * sizeof(pj_ssl_cipher));
+        if (cert) {
+            ctx_key_update_file(md, &cert->CA_file);
+            ctx_key_update_file(md, &cert->CA_path);
+            ctx_key_update_file(md, &cert->cert_file);
+            ctx_key_update_file(md, &cert->privkey_file);
+            ctx_key_update(md, cert->privkey_pass.ptr,
+                           cert->privkey_pass.slen);
+            ctx_key_update(md, cert->CA_buf.ptr, cert->CA_buf.slen);
+            ctx_key_update(md, cert->cert_buf.ptr, cert->cert_buf.slen);
+            ctx_key_update(md, cert->privkey_buf.ptr,
+                           cert->privkey_buf.slen);
+        }
+        ok = EVP_DigestFinal_ex(md, key, &len);
+    }
+    EVP_MD_CTX_free(md);
+
+    return (ok && len == CTX_KEY_LEN);
+}
+
+/* Release cache references of the entry. Cache lock must be held. */
+static void ctx_cache_entry_clear(ctx_cache_entry *e)
+{
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(e->sess); ++i) {
+        if (e->sess[i].sess)
+            SSL_SESSION_free(e->sess[i].sess);
+    }
+    if (e->ctx)
+        SSL_CTX_free(e->ctx);
+    pj_bzero(e, sizeof(*e));
+}
+
+/* Get a context from the cache, returning a new reference of it. */
+static SSL_CTX *ctx_cache_get(const unsigned char key[CTX_KEY_LEN])
+{
+    SSL_CTX *ctx = NULL;
+    unsigned i;
+
+    CRYPTO_THREAD_write_lock(ctx_cache_lock);
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache); ++i) {
+        ctx_cache_entry *e = &ctx_cache[i];
+
+        if (e->ctx && pj_memcmp(e->key, key, CTX_KEY_LEN) == 0) {
+            if (SSL_CTX_up_ref(e->ctx)) {
+                e->last_use = ++ctx_cache_clock;
+                ctx = e->ctx;
+            }
+            break;
+        }
+    }
+    CRYPTO_THREAD_unlock(ctx_cache_lock);
+
+    return ctx;
+}
+
+/* Add a newly created context to the cache, evicting the least recently
+ * used one when the cache is full. Contexts evicted are still valid for
+ * sockets using them, as they hold their own references.
+ */
+static void ctx_cache_put(const unsigned char key[CTX_KEY_LEN], SSL_CTX *ctx)
+{
+    ctx_cache_entry *e = NULL;
+    unsigned i;
+
+    CRYPTO_THREAD_write_lock(ctx_cache_lock);
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache); ++i) {
+        ctx_cache_entry *e2 = &ctx_cache[i];
+
+        if (e2->ctx && pj_memcmp(e2->key, key, CTX_KEY_LEN) == 0) {
+            /* Another socket has just added the same context */
+            e = NULL;
+            break;
+        }
+        if (!e || (e->ctx && (!e2->ctx || e2->last_use < e->last_use)))
+            e = e2;
+    }
+
+    if (e && SSL_CTX_up_ref(ctx)) {
+        ctx_cache_entry_clear(e);
+        pj_memcpy(e->key, key, CTX_KEY_LEN);
+        e->ctx = ctx;
+        e->last_use = ++ctx_cache_clock;
+    }
+    CRYPTO_THREAD_unlock(ctx_cache_lock);
+}
+
+#if PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT > 0
+
+/* Calculate the key of client sessions, from server name and address. */
+static pj_bool_t ctx_cache_calc_peer(pj_ssl_sock_t *ssock,
+                                     unsigned char peer[CTX_KEY_LEN])
+{
+    char addr[PJ_INET6_ADDRSTRLEN + 10];
+    EVP_MD_CTX *md;
+    unsigned len = 0;
+    int ok;
+
+    if (!pj_sockaddr_has_addr(&ssock->rem_addr))
+        return PJ_FALSE;
+
+    pj_sockaddr_print(&ssock->rem_addr, addr, sizeof(addr), 3);
+
+    md = EVP_MD_CTX_new();
+    if (!md)
+        return PJ_FALSE;
+
+    ok = EVP_DigestInit_ex(md, EVP_sha256(), NULL);
+    if (ok) {
+        ctx_key_update(md, ssock->param.server_name.ptr,
+                       ssock->param.server_name.slen);
+        ctx_key_update(md, addr, pj_ansi_strlen(addr));
+        ok = EVP_DigestFinal_ex(md, peer, &len);
+    }
+    EVP_MD_CTX_free(md);
+
+    return (ok && len == CTX_KEY_LEN);
+}
+
+/* Find cache entry of a context. Cache lock must be held. */
+static ctx_cache_entry *ctx_cache_find(const SSL_CTX *ctx)
+{
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache); ++i) {
+        if (ctx_cache[i].ctx == ctx)
+            return &ctx_cache[i];
+    }
+    return NULL;
+}
+
+/* New client session callback, store the session for resumption. */
+static int ctx_cache_new_sess_cb(SSL *ssl, SSL_SESSION *sess)
+{
+    pj_ssl_sock_t *ssock;
+    ctx_cache_entry *e;
+    ctx_cache_sess *cs = NULL;
+    unsigned char peer[CTX_KEY_LEN];
+    unsigned i;
+
+    ssock = (pj_ssl_sock_t *)SSL_get_ex_data(ssl, sslsock_idx);
+
+    /* Resumed sessions skip certificate verification, so only keep
+     * sessions of successfully verified peers.
+     */
+    if (!ssock || ssock->verify_status != PJ_SSL_CERT_ESUCCESS ||
+        !ctx_cache_calc_peer(ssock, peer))
+    {
+        return 0;
+    }
+
+    CRYPTO_THREAD_write_lock(ctx_cache_lock);
+    e = ctx_cache_find(SSL_get_SSL_CTX(ssl));
+    if (e) {
+        for (i = 0; i < PJ_ARRAY_SIZE(e->sess); ++i) {
+            ctx_cache_sess *cs2 = &e->sess[i];
+
+            if (cs2->sess && pj_memcmp(cs2->peer, peer, CTX_KEY_LEN) == 0) {
+                cs = cs2;
+                break;
+            }
+            if (!cs || (cs->sess && (!cs2->sess ||
+                                     cs2->last_use < cs->last_use)))
+            {
+                cs = cs2;
+            }
+        }
+
+        if (cs->sess)
+            SSL_SESSION_free(cs->sess);
+        pj_memcpy(cs->peer, peer, CTX_KEY_LEN);
+        cs->sess = sess;
+        cs->last_use = ++ctx_cache_clock;
+    }
+    CRYPTO_THREAD_unlock(ctx_cache_lock);
+
+    /* Returning 1 means we keep the session reference */
+    return (e != NULL);
+}
+
+/* Set previous session of the same peer to the client SSL instance. */
+static void ctx_cache_resume_sess(pj_ssl_sock_t *ssock)
+{
+    ossl_sock_t *ossock = (ossl_sock_t *)ssock;
+    ctx_cache_entry *e;
+    SSL_SESSION *sess = NULL;
+    unsigned char peer[CTX_KEY_LEN];
+    unsigned i;
+
+    if (!ctx_cache_calc_peer(ssock, peer))
+        return;
+
+    CRYPTO_THREAD_write_lock(ctx_cache_lock);
+    e = ctx_cache_find(ossock->ossl_ctx);
+    for (i = 0; e && i < PJ_ARRAY_SIZE(e->sess); ++i) {
+        ctx_cache_sess *cs = &e->sess[i];
+
+        if (cs->sess && pj_memcmp(cs->peer, peer, CTX_KEY_LEN) == 0) {
+            sess = cs->sess;
+#ifdef TLS1_3_VERSION
+            /* TLSv1.3 tickets should only be used once (RFC 8446 C.4),
+             * the new connection will receive new tickets.
+             */
+            if (SSL_SESSION_get_protocol_version(sess) >= TLS1_3_VERSION) {
+                cs->sess = NULL;
+                break;
+            }
+#endif
+            SSL_SESSION_up_ref(sess);
+            cs->last_use = ++ctx_cache_clock;
+            break;
+        }
+    }
+    CRYPTO_THREAD_unlock(ctx_cache_lock);
+
+    if (sess) {
+        if (!SSL_set_session(ossock->ossl_ssl, sess)) {
+            PJ_LOG(4, (ssock->pool->obj_name, "Failed to set session "
+                       "for resumption"));
+        }
+        SSL_SESSION_free(sess);
+    }
+}
+
+#endif  /* PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT */
+
+/* Release all cached contexts and sessions on library shutdown. */
+static void ctx_cache_flush(void)
+{
+    unsigned i;
+
+    if (!ctx_cache_lock)
+        return;
+
+    CRYPTO_THREAD_write_lock(ctx_cache_lock);
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache); ++i)
+        ctx_cache_entry_clear(&ctx_cache[i]);
+    CRYPTO_THREAD_unlock(ctx_cache_lock);
+}
+
+#endif  /* USE_CTX_CACHE */
+
+#if USE_KTLS
+/*
+ *******************************************************************
+ * Kernel TLS offload.
+ *******************************************************************
+ */
+
+/* Kernel record layer parameters of one direction */
+typedef union ktls_crypto_info
+{
+    struct tls_crypto_info                      info;
+    struct tls12_crypto_info_aes_gcm_128        aes_gcm_128;
+    struct tls12_crypto_info_aes_gcm_256        aes_gcm_256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305  chacha20_poly1305;
+#endif
+} ktls_crypto_info;
+
+/* Capture TLSv1.3 application traffic secrets, these are not available
+ * via any other OpenSSL API.
+ */
+static void ktls_keylog_cb(const SSL *ssl, const char *line)
+{
+    ossl_sock_t *ossock = (ossl_sock_t *)SSL_get_ex_data(ssl, sslsock_idx);
+    const char *p;
+    unsigned idx, len = 0;
+
+    if (!ossock || !ossock->base.param.enable_ktls)
+        return;
+
+    if (pj_ansi_strncmp(line, "CLIENT_TRAFFIC_SECRET_0 ", 24) == 0)
+        idx = 0;
+    else if (pj_ansi_strncmp(line, "SERVER_TRAFFIC_SECRET_0 ", 24) == 0)
+        idx = 1;
+    else
+        return;
+
+    /* Skip client random */
+    p = strchr(line + 24, ' ');
+    if (!p)
+        return;
+
+    for (++p; pj_isxdigit(p[0]) && pj_isxdigit(p[1]) &&
+              len < sizeof(ossock->ktls_secret[idx]); p += 2)
+    {
+        ossock->ktls_secret[idx][len++] = (unsigned char)
+                                          ((pj_hex_digit_to_val(p[0]) << 4) |
+                                           pj_hex_digit_to_val(p[1]));
+    }
+    ossock->ktls_secret_len[idx] = len;
+}
+
+/* Track record sequence numbers, the kernel needs them to continue
+ * the record layer after the handshake.
+ */
+static void ktls_msg_cb(int write_p, int version, int content_type,
+                        const void *buf, size_t len, SSL *ssl, void *arg)
+{
+    ossl_sock_t *ossock = (ossl_sock_t *)SSL_get_ex_data(ssl, sslsock_idx);
+    pj_uint64_t *seq;
+
+    PJ_UNUSED_ARG(version);
+    PJ_UNUSED_ARG(arg);
+
+    if (!ossock)
+        return;
+
+    seq = &ossock->ktls_seq[write_p? 1 : 0];
+    switch (content_type) {
+    case SSL3_RT_HEADER:
+        ++*seq;
+        break;
+    case SSL3_RT_CHANGE_CIPHER_SPEC:
+        /* New keys are used from the next record (TLSv1.2) */
+        *seq = 0;
+        break;
+    case SSL3_RT_HANDSHAKE:
+        if (len == 0)
+            break;
+        if (*(const unsigned char *)buf == SSL3_MT_FINISHED &&
+            SSL_version(ssl) == TLS1_3_VERSION)
+        {
+            /* Application traffic keys are used after Finished */
+            *seq = 0;
+        } else if (*(const unsigned char *)buf == SSL3_MT_KEY_UPDATE) {
+            ossock->ktls_disabled = PJ_TRUE;
+        }
+        break;
+    }
+}
+
+/* Derive keying material using the specified OpenSSL KDF */
+static pj_bool_t ktls_kdf(const char *name, OSSL_PARAM params[],
+                          unsigned char *out, pj_size_t out_len)
+{
+    EVP_KDF *kdf;
+    EVP_KDF_CTX *kctx = NULL;
+    int ok = 0;
+
+    kdf = EVP_KDF_fetch(NULL, name, NULL);
+    if (kdf) {
+        kctx = EVP_KDF_CTX_new(kdf);
+        EVP_KDF_free(kdf);
+    }
+    if (kctx) {
+        ok = EVP_KDF_derive(kctx, out, out_len, params);
+        EVP_KDF_CTX_free(kctx);
+    }
+
+    return (ok > 0);
+}
+
+/* TLSv1.3 HKDF-Expand-Label() with empty context (RFC 8446 section 7.1) */
+static pj_bool_t ktls_expand_label(const EVP_MD *md,
+                                   const unsigned char *secret,
+                                   pj_size_t secret_len,
+                                   const char *label,
+                                   unsigned char *out, pj_size_t out_len)
+{
+    unsigned char info[16];
+    pj_size_t label_len = pj_ansi_strlen(label);
+    pj_size_t info_len = 0;
+    int mode = EVP_KDF_HKDF_MODE_EXPAND_ONLY;
+    OSSL_PARAM params[5];
+
+    pj_assert(label_len + 10 <= sizeof(info));
+
+    info[info_len++] = (unsigned char)(out_len >> 8);
+    info[info_len++] = (unsigned char)out_len;
+    info[info_len++] = (unsigned char)(6 + label_len);
+    pj_memcpy(info + info_len, "tls13 ", 6);
+    info_len += 6;
+    pj_memcpy(info + info_len, label, label_len);
+    info_len += label_len;
+    info[info_len++] = 0;
+
+    params[0] = OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &mode);
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST,
+                                        (char *)EVP_MD_get0_name(md), 0);
+    params[2] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY,
+                                        (void *)secret, secret_len);
+    params[3] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO,
+                                        info, info_len);
+    params[4] = OSSL_PARAM_construct_end();
+
+    return ktls_kdf(OSSL_KDF_NAME_HKDF, params, out, out_len);
+}
+
+/* Derive client & server write keys and implicit IVs of the session */
+static pj_bool_t ktls_derive_keys(ossl_sock_t *ossock, const EVP_MD *md,
+                                  pj_size_t key_len, pj_size_t iv_len,
+                                  unsigned char key[2][32],
+                                  unsigned char iv[2][12])
+{
+    SSL *ssl = ossock->ossl_ssl;
+    unsigned i;
+
+    if (SSL_version(ssl) == TLS1_3_VERSION) {
+        for (i = 0; i < 2; ++i) {
+            if (ossock->ktls_secret_len[i] != (unsigned)EVP_MD_get_size(md) ||
+                !ktls_expand_label(md, ossock->ktls_secret[i],
+                                   ossock->ktls_secret_len[i], "key",
+                                   key[i], key_len) ||
+                !ktls_expand_label(md, ossock->ktls_secret[i],
+                                   ossock->ktls_secret_len[i], "iv",
+                                   iv[i], iv_len))
+            {
+                return PJ_FALSE;
+            }
+        }
+    } else {
+        /* TLSv1.2 key block (RFC 5246 section 6.3), AEAD ciphers have
+         * no MAC keys.
+         */
+        unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+        unsigned char seed[13 + 2*SSL3_RANDOM_SIZE];
+        unsigned char block[2*32 + 2*12];
+        pj_size_t master_len;
+        OSSL_PARAM params[4];
+        pj_bool_t ok;
+
+        master_len = SSL_SESSION_get_master_key(SSL_get_session(ssl),
+                                                master, sizeof(master));
+        pj_memcpy(seed, "key expansion", 13);
+        if (master_len == 0 ||
+            SSL_get_server_random(ssl, seed + 13, SSL3_RANDOM_SIZE) !=
+                SSL3_RANDOM_SIZE ||
+            SSL_get_client_random(ssl, seed + 13 + SSL3_RANDOM_SIZE,
+                                  SSL3_RANDOM_SIZE) != SSL3_RANDOM_SIZE)
+        {
+            OPENSSL_cleanse(master, sizeof(master));
+            return PJ_FALSE;
+        }
+
+        params[0] = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST,
+                                        (char *)EVP_MD_get0_name(md), 0);
+        params[1] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SECRET,
+                                        master, master_len);
+        params[2] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SEED,
+                                        seed, sizeof(seed));
+        params[3] = OSSL_PARAM_construct_end();
+
+        ok = ktls_kdf(OSSL_KDF_NAME_TLS1_PRF, params, block,
+                      2*(key_len + iv_len));
+        if (ok) {
+            pj_memcpy(key[0], block, key_len);
+            pj_memcpy(key[1], block + key_len, key_len);
+            pj_memcpy(iv[0], block + 2*key_len, iv_len);
+            pj_memcpy(iv[1], block + 2*key_len + iv_len, iv_len);
+        }
+        OPENSSL_cleanse(master, sizeof(master));
+        OPENSSL_cleanse(block, sizeof(block));
+        if (!ok)
+            return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
+/* Fill kernel record layer parameters */
+static void ktls_fill_crypto_info(ktls_crypto_info *ci, int version,
+                                  int cipher_type, const unsigned char *key,
+                                  const unsigned char *iv, pj_uint64_t seq)
+{
+    unsigned char rec_seq[8];
+    unsigned i;
+
+    for (i = 0; i < 8; ++i)
+        rec_seq[i] = (unsigned char)(seq >> (56 - i*8));
+
+    pj_bzero(ci, sizeof(*ci));
+    ci->info.version = (version == TLS1_3_VERSION)? TLS_1_3_VERSION :
+                                                    TLS_1_2_VERSION;
+    ci->info.cipher_type = (unsigned short)cipher_type;
+
+    /* For TLSv1.2 AES-GCM, the kernel uses the IV as the initial explicit
+     * nonce, the record sequence number is a good one.
+     */
+#define FILL_GCM(gcm) \
+    pj_memcpy(gcm.key, key, sizeof(gcm.key)); \
+    pj_memcpy(gcm.salt, iv, sizeof(gcm.salt)); \
+    if (version == TLS1_3_VERSION) \
+        pj_memcpy(gcm.iv, iv + sizeof(gcm.salt), sizeof(gcm.iv)); \
+    else \
+        pj_memcpy(gcm.iv, rec_seq, sizeof(gcm.iv)); \
+    pj_memcpy(gcm.rec_seq, rec_seq, sizeof(gcm.rec_seq))
+
+    switch (cipher_type) {
+    case TLS_CIPHER_AES_GCM_128:
+        FILL_GCM(ci->aes_gcm_128);
+        break;
+    case TLS_CIPHER_AES_GCM_256:
+        FILL_GCM(ci->aes_gcm_256);
+        break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case TLS_CIPHER_CHACHA20_POLY1305:
+        pj_memcpy(ci->chacha20_poly1305.key, key,
+                  sizeof(ci->chacha20_poly1305.key));
+        pj_memcpy(ci->chacha20_poly1305.iv, iv,
+                  sizeof(ci->chacha20_poly1305.iv));
+        pj_memcpy(ci->chacha20_poly1305.rec_seq, rec_seq,
+                  sizeof(ci->chacha20_poly1305.rec_seq));
+        break;
+#endif
+    }
+
+#undef FILL_GCM
+}
+
+static pj_status_t ssl_ktls_start(pj_ssl_sock_t *ssock)
+{
+    ossl_sock_t *ossock = (ossl_sock_t *)ssock;
+    SSL *ssl = ossock->ossl_ssl;
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+    const EVP_MD *md = cipher? SSL_CIPHER_get_handshake_digest(cipher) : NULL;
+    int version = SSL_version(ssl);
+    int cipher_type = 0;
+    pj_size_t key_len = 0, iv_len, ci_len = 0;
+    unsigned char key[2][32], iv[2][12];
+    ktls_crypto_info ci[2];
+    unsigned tx = ssock->is_server? 1 : 0;
+    const char *reason = NULL;
+    pj_status_t status = PJ_SUCCESS;
+
+    if (!md || (version != TLS1_2_VERSION && version != TLS1_3_VERSION)) {
+        reason = "unsupported protocol";
+    } else {
+        switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+        case NID_aes_128_gcm:
+            cipher_type = TLS_CIPHER_AES_GCM_128;
+            key_len = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+            ci_len = sizeof(ci[0].aes_gcm_128);
+            break;
+        case NID_aes_256_gcm:
+            cipher_type = TLS_CIPHER_AES_GCM_256;
+            key_len = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+            ci_len = sizeof(ci[0].aes_gcm_256);
+            break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+        case NID_chacha20_poly1305:
+            cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+            key_len = TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE;
+            ci_len = sizeof(ci[0].chacha20_poly1305);
+            break;
+#endif
+        default:
+            reason = "unsupported cipher";
+            break;
+        }
+    }
+
+    /* Implicit IV length, TLSv1.2 AES-GCM only uses 4 bytes salt */
+    if (version != TLS1_3_VERSION && (cipher_type == TLS_CIPHER_AES_GCM_128 ||
+                                      cipher_type == TLS_CIPHER_AES_GCM_256))
+    {
+        iv_len = 4;
+    } else {
+        iv_len = 12;
+    }
+
+    pj_lock_acquire(ssock->write_mutex);
+
+    /* Any record still buffered in userspace would be lost */
+    if (!reason && (ossock->ktls_disabled ||
+                    ssock->send_buf.len ||
+                    ssock->send_buf_pending.data_len ||
+                    !pj_list_empty(&ssock->write_pending) ||
+                    !io_empty(ssock, &ssock->circ_buf_output) ||
+                    BIO_pending(ossock->ossl_rbio) ||
+                    SSL_has_pending(ssl)))
+    {
+        reason = "pending records";
+    }
+
+    if (!reason && !ktls_derive_keys(ossock, md, key_len, iv_len, key, iv))
+        reason = "failed to derive keys";
+
+    if (!reason) {
+        ktls_fill_crypto_info(&ci[0], version, cipher_type, key[tx], iv[tx],
+                              ossock->ktls_seq[1]);
+        ktls_fill_crypto_info(&ci[1], version, cipher_type, key[!tx],
+                              iv[!tx], ossock->ktls_seq[0]);
+
+        status = pj_sock_setsockopt(ssock->sock, IPPROTO_TCP, TCP_ULP,
+                                    "tls", sizeof("tls"));
+        if (status == PJ_SUCCESS) {
+            status = pj_sock_setsockopt(ssock->sock, SOL_TLS, TLS_TX,
+                                        &ci[0], (int)ci_len);
+        }
+        if (status != PJ_SUCCESS) {
+            /* Nothing has been offloaded yet */
+            PJ_PERROR(4,(ssock->pool->obj_name, status,
+                         "Kernel TLS is not used"));
+            status = PJ_ENOTSUP;
+        } else {
+            /* Records are now written by the kernel, there is no way
+             * back to userspace TLS.
+             */
+            ssock->ktls = PJ_TRUE;
+            status = pj_sock_setsockopt(ssock->sock, SOL_TLS, TLS_RX,
+                                        &ci[1], (int)ci_len);
+        }
+    }
+
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(iv, sizeof(iv));
+    OPENSSL_cleanse(ci, sizeof(ci));
+    OPENSSL_cleanse(ossock->ktls_secret, sizeof(ossock->ktls_secret));
+
+    pj_lock_release(ssock->write_mutex);
+
+    if (reason) {
+        PJ_LOG(4,(ssock->pool->obj_name, "Kernel TLS is not used: %s",
+                  reason));
+        return PJ_ENOTSUP;
+    }
+    if (status != PJ_SUCCESS)
+        return status;
+
+    PJ_LOG(4,(ssock->pool->obj_name, "Records offloaded to kernel TLS (%s)",
+              SSL_CIPHER_get_name(cipher)));
+    return PJ_SUCCESS;
+}
+
+/* Read exactly len bytes of non application data record */
+static pj_status_t ktls_recv_ctrl(pj_ssl_sock_t *ssock, unsigned char *buf,
+                                  pj_size_t len, unsigned char *type)
+{
+    char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+
+    while (len) {
+        struct msghdr msg;
+        struct iovec iov;
+        struct cmsghdr *cmsg;
+        ssize_t rc;
+
+        pj_bzero(&msg, sizeof(msg));
+        iov.iov_base = buf;
+        iov.iov_len = len;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cbuf;
+        msg.msg_controllen = sizeof(cbuf);
+
+        rc = recvmsg(ssock->sock, &msg, 0);
+        if (rc < 0)
+            return PJ_STATUS_FROM_OS(errno);
+        if (rc == 0)
+            return PJ_EEOF;
+
+        /* Records of other type must not be merged */
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_level != SOL_TLS ||
+            cmsg->cmsg_type != TLS_GET_RECORD_TYPE ||
+            *CMSG_DATA(cmsg) == SSL3_RT_APPLICATION_DATA)
+        {
+            return PJ_EINVALIDOP;
+        }
+        *type = *CMSG_DATA(cmsg);
+
+        buf += rc;
+        len -= rc;
+    }
+
+    return PJ_SUCCESS;
+}
+
+static pj_status_t ssl_ktls_on_read_error(pj_ssl_sock_t *ssock,
+                                          pj_status_t status)
+{
+    unsigned char buf[64];
+    unsigned char type;
+    pj_size_t len;
+
+    /* Kernel fails plain reads when a control record is received */
+    if (status != PJ_STATUS_FROM_OS(EIO) || ssock->sock == PJ_INVALID_SOCKET)
+        return status;
+
+    /* Alert and handshake message headers are at least two bytes */
+    status = ktls_recv_ctrl(ssock, buf, 2, &type);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    if (type == SSL3_RT_ALERT) {
+        if (buf[1] == SSL_AD_CLOSE_NOTIFY)
+            return PJ_EEOF;
+
+        PJ_LOG(3,(ssock->pool->obj_name, "Received TLS alert: %s",
+                  SSL_alert_desc_string_long(buf[1])));
+        return PJ_STATUS_FROM_OS(OSERR_ECONNRESET);
+    }
+
+    if (type != SSL3_RT_HANDSHAKE)
+        return PJ_EINVALIDOP;
+
+    status = ktls_recv_ctrl(ssock, buf + 2, 2, &type);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    switch (buf[0]) {
+    case SSL3_MT_NEWSESSION_TICKET:
+    case SSL3_MT_HELLO_REQUEST:
+        /* Session tickets are not stored, and renegotiation request may
+         * be ignored.
+         */
+        len = ((pj_size_t)buf[1] << 16) | (buf[2] << 8) | buf[3];
+        while (len && status == PJ_SUCCESS) {
+            pj_size_t n = PJ_MIN(len, sizeof(buf));
+            status = ktls_recv_ctrl(ssock, buf, n, &type);
+            len -= n;
+        }
+        return status;
+    default:
+        /* E.g: key update, which is not supported yet */
+        PJ_LOG(3,(ssock->pool->obj_name, "Unsupported post-handshake "
+                  "message type %d", buf[0]));
+        return PJ_ENOTSUP;
+    }
+}
+
+/* Send close notify alert via kernel TLS */
+static void ktls_send_close_notify(pj_ssl_sock_t *ssock)
+{
+    unsigned char alert[2] = { SSL3_AL_WARNING, SSL_AD_CLOSE_NOTIFY };
+    char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+
+    pj_bzero(&msg, sizeof(msg));
+    pj_bzero(cbuf, sizeof(cbuf));
+    iov.iov_base = alert;
+    iov.iov_len = sizeof(alert);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(cmsg) = SSL3_RT_ALERT;
+
+    if (sendmsg(ssock->sock, &msg, MSG_DONTWAIT) < 0) {
+        PJ_PERROR(4,(ssock->pool->obj_name, PJ_STATUS_FROM_OS(errno),
+                     "Failed to send close notify"));
+    }
+}
+
+#endif  /* USE_KTLS */
+
 /* Initialize OpenSSL */
 static pj_status_t init_openssl(void)
 {
@@ -895,6 +1773,20 @@ static pj_status_t init_openssl(void)
         return status;
 #endif
 
+#if USE_CTX_CACHE
+    /* Init shared SSL context cache */
+    ctx_cache_lock = CRYPTO_THREAD_lock_new();
+    if (ctx_cache_lock) {
+        if (pj_atexit(&ctx_cache_flush) != PJ_SUCCESS) {
+            PJ_LOG(3, (THIS_FILE, "Warning! Unable to set SSL context "
+                       "cache release method."));
+        }
+    } else {
+        PJ_LOG(3, (THIS_FILE, "Warning! Unable to create SSL context cache "
+                   "lock, context sharing is disabled."));
+    }
+#endif
+
     return status;
 }
 
@@ -1132,10 +2024,26 @@ static pj_status_t init_ossl_ctx(pj_ssl_sock_t *ssock)
     pj_ssl_cert_t *cert = ssock->cert;
     int rc;
     pj_status_t status;
+#if USE_CTX_CACHE
+    unsigned char ctx_key[CTX_KEY_LEN];
+    pj_bool_t use_cache;
+#endif
 
     if (ssock->param.proto == PJ_SSL_SOCK_PROTO_DEFAULT)
         ssock->param.proto = PJ_SSL_SOCK_PROTO_SSL23;
 
+#if USE_CTX_CACHE
+    /* Reuse the context of sockets with identical settings */
+    use_cache = ctx_cache_lock && ctx_cache_calc_key(ssock, ctx_key);
+    if (use_cache) {
+        ossock->ossl_ctx = ctx_cache_get(ctx_key);
+        if (ossock->ossl_ctx) {
+            PJ_LOG(5, (ssock->pool->obj_name, "Using shared SSL context"));
+            goto on_return;
+        }
+    }
+#endif
+
     /* Determine SSL method to use */
     /* Specific version methods are deprecated since 1.1.0 */
 #if (USING_LIBRESSL && LIBRESSL_VERSION_NUMBER < 0x2020100fL)\
@@ -1247,6 +2155,12 @@ static pj_status_t init_ossl_ctx(pj_ssl_sock_t *ssock)
     if (ssl_opt)
         SSL_CTX_set_options(ctx, ssl_opt);
 
+#if USE_KTLS
+    /* TLSv1.3 traffic secrets are needed for kernel TLS */
+    if (ssock->param.enable_ktls || ssock->newsock_param.enable_ktls)
+        SSL_CTX_set_keylog_callback(ctx, &ktls_keylog_cb);
+#endif
+
     /* Set cipher list */
     status = set_cipher_list(ssock);
     if (status != PJ_SUCCESS) {
@@ -1600,6 +2514,22 @@ static pj_status_t init_ossl_ctx(pj_ssl_sock_t *ssock)
         }
     }
 
+#if USE_CTX_CACHE
+    if (use_cache) {
+#if PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT > 0
+        if (!ssock->is_server) {
+            /* Keep client sessions in the cache for resumption */
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                           SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(ctx, &ctx_cache_new_sess_cb);
+        }
+#endif
+        ctx_cache_put(ctx_key, ctx);
+    }
+
+on_return:
+#endif
+
     /* Early sensitive data cleanup after OpenSSL context setup. However,
      * this cannot be done for listener sockets, as the data will still
      * be needed by accepted sockets.
@@ -1642,6 +2572,11 @@ static pj_status_t ssl_create(pj_ssl_sock_t *ssock)
             ((ossl_sock_t *)ssock->parent)->own_ctx = PJ_TRUE;
         }
         ossock->ossl_ctx = server_ctx;
+#if USE_CTX_CACHE
+        /* Hold a context reference, so it may outlive the listener */
+        if (SSL_CTX_up_ref(server_ctx))
+            ossock->own_ctx = PJ_TRUE;
+#endif
     } else {
         status = init_ossl_ctx(ssock);
         if (status != PJ_SUCCESS)
@@ -1657,6 +2592,21 @@ static pj_status_t ssl_create(pj_ssl_sock_t *ssock)
     /* Set SSL sock as application data of SSL instance */
     SSL_set_ex_data(ossock->ossl_ssl, sslsock_idx, ssock);
 
+#if USE_KTLS
+    ssock->ktls = PJ_FALSE;
+    ossock->ktls_seq[0] = ossock->ktls_seq[1] = 0;
+    ossock->ktls_secret_len[0] = ossock->ktls_secret_len[1] = 0;
+    ossock->ktls_disabled = PJ_FALSE;
+    if (ssock->param.enable_ktls)
+        SSL_set_msg_callback(ossock->ossl_ssl, &ktls_msg_cb);
+#endif
+
+#if USE_CTX_CACHE && PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT > 0
+    /* Try to resume previous session with the server */
+    if (!ssock->is_server)
+        ctx_cache_resume_sess(ssock);
+#endif
+
     /* SSL verification options */
     mode = SSL_VERIFY_PEER;
     if (ssock->is_server && ssock->param.require_client_cert)
@@ -1739,6 +2689,16 @@ static void ssl_reset_sock_state(pj_ssl_sock_t *ssock)
      * Call SSL_shutdown() when there is a timeout handshake failure or
      * the last error is not SSL_ERROR_SYSCALL and not SSL_ERROR_SSL.
      */
+#if USE_KTLS
+    if (ssock->ktls) {
+        /* Records are protected by the kernel now */
+        if (ssock->sock != PJ_INVALID_SOCKET &&
+            ssock->ssl_state == SSL_STATE_ESTABLISHED)
+        {
+            ktls_send_close_notify(ssock);
+        }
+    } else
+#endif
     if (ossock->ossl_ssl && SSL_in_init(ossock->ossl_ssl) == 0) {
         if (ssock->handshake_status == PJ_ETIMEDOUT ||
             (ssock->last_err != SSL_ERROR_SYSCALL &&
@@ -1882,17 +2842,10 @@ static pj_status_t set_curves_list(pj_ssl_sock_t *ssock)
         curves[cnt] = get_nid_from_cid(ssock->param.curves[cnt]);
     }
 
-    if( SSL_is_server(ossock->ossl_ssl) ) {
-        ret = SSL_set1_curves(ossock->ossl_ssl, curves,
-                              ssock->param.curves_num);
-        if (ret < 1)
-            return GET_SSL_STATUS(ssock);
-    } else {
-        ret = SSL_CTX_set1_curves(ossock->ossl_ctx, curves,
-                                  ssock->param.curves_num);
-        if (ret < 1)
-            return GET_SSL_STATUS(ssock);
-    }
+    /* Set on the SSL instance, as the context may be shared */
+    ret = SSL_set1_curves(ossock->ossl_ssl, curves, ssock->param.curves_num);
+    if (ret < 1)
+        return GET_SSL_STATUS(ssock);
 #else
     PJ_UNUSED_ARG(ssock);
 #endif
@@ -2315,10 +3268,18 @@ static void ssl_set_state(pj_ssl_sock_t *ssock, pj_bool_t is_server)
 /* Server Name Indication server callback */
 static int sni_cb(SSL *ssl, int *al, void *arg)
 {
-    pj_ssl_sock_t *ssock = (pj_ssl_sock_t *)arg;
+    pj_ssl_sock_t *ssock;
     const char *sname;
 
     PJ_UNUSED_ARG(al);
+    PJ_UNUSED_ARG(arg);
+
+    /* The context may be shared by sockets with different server names,
+     * so get the socket from the SSL instance.
+     */
+    ssock = (pj_ssl_sock_t *)SSL_get_ex_data(ssl, sslsock_idx);
+    if (!ssock || ssock->param.server_name.slen == 0)
+        return SSL_TLSEXT_ERR_NOACK;
 
     sname = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
     if (!sname || pj_stricmp2(&ssock->param.server_name, sname)) {
@@ -2338,11 +3299,9 @@ static void ssl_set_peer_name(pj_ssl_sock_t *ssock)
         get_ip_addr_ver(&ssock->param.server_name) == 0)
     {
         if (ssock->is_server) {
-#if defined(SSL_CTX_set_tlsext_servername_callback) && \
-    defined(SSL_CTX_set_tlsext_servername_arg)
+#if defined(SSL_CTX_set_tlsext_servername_callback)
 
             SSL_CTX_set_tlsext_servername_callback(ossock->ossl_ctx, &sni_cb);
-            SSL_CTX_set_tlsext_servername_arg(ossock->ossl_ctx, ssock);
 
 #endif
         } else {
@@ -88,6 +88,7 @@ struct test_state
     pj_bool_t       check_echo;     /* flag to compare sent & echoed data   */
     const char     *check_echo_ptr; /* pointer/cursor for comparing data    */
     struct send_key send_key;       /* send op key                          */
+    pj_bool_t       session_reused; /* TLS session has been resumed         */
 };
 
 static void dump_ssl_info(const pj_ssl_sock_info *si)
@@ -98,7 +99,8 @@ static void dump_ssl_info(const pj_ssl_sock_info *si)
     tmp_st = pj_ssl_cipher_name(si->cipher);
     if (tmp_st == NULL)
         tmp_st = "[Unknown]";
-    PJ_LOG(3, ("", ".....Cipher: %s", tmp_st));
+    PJ_LOG(3, ("", ".....Cipher: %s%s", tmp_st,
+               (si->ktls? " (kernel TLS)" : "")));
 
     /* Print remote certificate info and verification result */
     if (si->remote_cert_info && si->remote_cert_info->subject.info.slen) 
@@ -150,6 +152,7 @@ static pj_bool_t ssl_on_connect_complete(pj_ssl_sock_t *ssock,
     pj_sockaddr_print((pj_sockaddr_t*)&info.local_addr, buf1, sizeof(buf1), 1);
     pj_sockaddr_print((pj_sockaddr_t*)&info.remote_addr, buf2, sizeof(buf2), 1);
     PJ_LOG(3, ("", "...Connected %s -> %s!", buf1, buf2));
+    st->session_reused = info.session_reused;
 
     if (st->is_verbose)
         dump_ssl_info(&info);
@@ -540,7 +543,8 @@ static pj_status_t load_cert_to_buf(pj_pool_t *pool, const pj_str_t *file_name,
 
 static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
                      pj_ssl_cipher srv_cipher, pj_ssl_cipher cli_cipher,
-                     pj_bool_t req_client_cert, pj_bool_t client_provide_cert)
+                     pj_bool_t req_client_cert, pj_bool_t client_provide_cert,
+                     pj_bool_t enable_ktls)
 {
     pj_pool_t *pool = NULL;
     pj_ioqueue_t *ioqueue = NULL;
@@ -575,6 +579,7 @@ static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
     param.ioqueue = ioqueue;
     param.timer_heap = timer;
     param.ciphers = ciphers;
+    param.enable_ktls = enable_ktls;
 
     /* Init default bind address */
     {
@@ -784,6 +789,174 @@ on_return:
 }
 
 
+#if (PJ_SSL_SOCK_IMP == PJ_SSL_SOCK_IMP_OPENSSL) && \
+    PJ_SSL_SOCK_OSSL_CTX_CACHE_SIZE > 0 && PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT > 0
+/* Connect two clients sequentially to the same server, the second client
+ * should resume the TLS session of the first one.
+ */
+static int session_reuse_test(pj_ssl_sock_proto proto)
+{
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_timer_heap_t *timer = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_param param;
+    struct test_state state_serv = { 0 };
+    struct test_state state_cli;
+    pj_sockaddr addr, listen_addr;
+    pj_ssl_cert_t *cert = NULL;
+    pj_str_t ca_file = pj_str(CERT_CA_FILE);
+    pj_str_t cert_file = pj_str(CERT_FILE);
+    pj_str_t privkey_file = pj_str(CERT_PRIVKEY_FILE);
+    pj_str_t privkey_pass = pj_str(CERT_PRIVKEY_PASS);
+    pj_str_t null_str = pj_str("");
+    char send_str[] = "Session reuse test";
+    unsigned i;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "ssl_reuse", 256, 256, NULL);
+
+    status = pj_ioqueue_create(pool, 16, &ioqueue);
+    if (status != PJ_SUCCESS) {
+        goto on_return;
+    }
+
+    status = pj_timer_heap_create(pool, 4, &timer);
+    if (status != PJ_SUCCESS) {
+        goto on_return;
+    }
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete2 = &ssl_on_accept_complete;
+    param.cb.on_connect_complete = &ssl_on_connect_complete;
+    param.cb.on_data_read = &ssl_on_data_read;
+    param.cb.on_data_sent = &ssl_on_data_sent;
+    param.ioqueue = ioqueue;
+    param.timer_heap = timer;
+    param.proto = proto;
+
+    {
+        pj_str_t tmp_st;
+        pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp_st, "127.0.0.1"), 0);
+    }
+
+    /* === SERVER === */
+    param.user_data = &state_serv;
+    state_serv.pool = pool;
+    state_serv.echo = PJ_TRUE;
+    state_serv.is_server = PJ_TRUE;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status != PJ_SUCCESS) {
+        goto on_return;
+    }
+
+    status = pj_ssl_cert_load_from_files(pool, &ca_file, &cert_file,
+                                         &privkey_file, &privkey_pass,
+                                         &cert);
+    if (status != PJ_SUCCESS) {
+        goto on_return;
+    }
+
+    status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+    if (status != PJ_SUCCESS) {
+        goto on_return;
+    }
+
+    status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr,
+                                      pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS) {
+        goto on_return;
+    }
+
+    {
+        pj_ssl_sock_info info;
+
+        pj_ssl_sock_get_info(ssock_serv, &info);
+        pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    /* === CLIENTS === */
+    status = pj_ssl_cert_load_from_files(pool, &ca_file, &null_str,
+                                         &null_str, &null_str, &cert);
+    if (status != PJ_SUCCESS) {
+        goto on_return;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        pj_ssl_sock_t *ssock_cli = NULL;
+
+        pj_bzero(&state_cli, sizeof(state_cli));
+        state_cli.pool = pool;
+        state_cli.check_echo = PJ_TRUE;
+        state_cli.send_str = send_str;
+        state_cli.send_str_len = sizeof(send_str);
+        param.user_data = &state_cli;
+
+        status = pj_ssl_sock_create(pool, &param, &ssock_cli);
+        if (status != PJ_SUCCESS) {
+            goto on_return;
+        }
+
+        status = pj_ssl_sock_set_certificate(ssock_cli, pool, cert);
+        if (status != PJ_SUCCESS) {
+            pj_ssl_sock_close(ssock_cli);
+            goto on_return;
+        }
+
+        status = pj_ssl_sock_start_connect(ssock_cli, pool, &addr,
+                                           &listen_addr,
+                                           pj_sockaddr_get_len(&addr));
+        if (status == PJ_SUCCESS) {
+            ssl_on_connect_complete(ssock_cli, PJ_SUCCESS);
+        } else if (status != PJ_EPENDING) {
+            pj_ssl_sock_close(ssock_cli);
+            goto on_return;
+        }
+
+        while (!state_serv.err && !state_cli.err && !state_cli.done) {
+            pj_time_val delay = {0, 100};
+            pj_ioqueue_poll(ioqueue, &delay);
+        }
+
+        if (state_serv.err || state_cli.err) {
+            status = state_serv.err? state_serv.err : state_cli.err;
+            goto on_return;
+        }
+
+        PJ_LOG(3, ("", "...Connection #%d: session %s", i + 1,
+                   (state_cli.session_reused? "resumed" : "not resumed")));
+
+        if (state_cli.session_reused != (i > 0)) {
+            status = PJ_EBUG;
+            goto on_return;
+        }
+    }
+
+    status = PJ_SUCCESS;
+
+on_return:
+    if (ssock_serv)
+        pj_ssl_sock_close(ssock_serv);
+
+    /* Clean up sockets */
+    {
+        pj_time_val delay = {0, 100};
+        while (ioqueue && pj_ioqueue_poll(ioqueue, &delay) > 0);
+    }
+
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    if (timer)
+        pj_timer_heap_destroy(timer);
+    if (pool)
+        pj_pool_release(pool);
+
+    return status;
+}
+#endif
+
+
 static pj_bool_t asock_on_data_read(pj_activesock_t *asock,
                                     void *data,
                                     pj_size_t size,
@@ -1534,35 +1707,35 @@ int ssl_sock_test(void)
     PJ_LOG(3,("", "..echo test w/ TLSv1 and PJ_TLS_RSA_WITH_AES_256_CBC_SHA cipher"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1, PJ_SSL_SOCK_PROTO_TLS1, 
                     PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA, 
-                    PJ_FALSE, PJ_FALSE);
+                    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
         return ret;
 
     PJ_LOG(3,("", "..echo test w/ SSLv23 and PJ_TLS_RSA_WITH_AES_256_CBC_SHA cipher"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_SSL23, PJ_SSL_SOCK_PROTO_SSL23, 
                     PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-                    PJ_FALSE, PJ_FALSE);
+                    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
         return ret;
 
     PJ_LOG(3,("", "..echo test w/ compatible proto: server TLSv1.2 vs client TLSv1.2"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1_2, PJ_SSL_SOCK_PROTO_TLS1_2, 
                     -1, -1,
-                    PJ_FALSE, PJ_FALSE);
+                    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
         return ret;
 
     PJ_LOG(3,("", "..echo test w/ compatible proto: server TLSv1.2+1.3 vs client TLSv1.3"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1_2 | PJ_SSL_SOCK_PROTO_TLS1_3, PJ_SSL_SOCK_PROTO_TLS1_3, 
                     -1, -1,
-                    PJ_FALSE, PJ_FALSE);
+                    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
         return ret;
 
     PJ_LOG(3,("", "..echo test w/ incompatible proto: server TLSv1 vs client SSL3"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1, PJ_SSL_SOCK_PROTO_SSL3, 
                     PJ_TLS_RSA_WITH_DES_CBC_SHA, PJ_TLS_RSA_WITH_DES_CBC_SHA,
-                    PJ_FALSE, PJ_FALSE);
+                    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
         return PJ_EBUG;
 
@@ -1571,7 +1744,7 @@ int ssl_sock_test(void)
     PJ_LOG(3,("", "..echo test w/ incompatible proto: server TLSv1.2 vs client TLSv1.3"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1_2, PJ_SSL_SOCK_PROTO_TLS1_3, 
                     -1, -1,
-                    PJ_FALSE, PJ_FALSE);
+                    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
         return PJ_EBUG;
 #endif
@@ -1584,7 +1757,7 @@ int ssl_sock_test(void)
     PJ_LOG(3,("", "..echo test w/ incompatible ciphers"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
                     PJ_TLS_RSA_WITH_DES_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-                    PJ_FALSE, PJ_FALSE);
+                    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
         return PJ_EBUG;
 #endif
@@ -1592,14 +1765,40 @@ int ssl_sock_test(void)
     PJ_LOG(3,("", "..echo test w/ client cert required but not provided"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
                     PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-                    PJ_TRUE, PJ_FALSE);
+                    PJ_TRUE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
         return PJ_EBUG;
 
     PJ_LOG(3,("", "..echo test w/ client cert required and provided"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
                     PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-                    PJ_TRUE, PJ_TRUE);
+                    PJ_TRUE, PJ_TRUE, PJ_FALSE);
+    if (ret != 0)
+        return ret;
+
+#if (PJ_SSL_SOCK_IMP == PJ_SSL_SOCK_IMP_OPENSSL) && \
+    PJ_SSL_SOCK_OSSL_CTX_CACHE_SIZE > 0 && PJ_SSL_SOCK_OSSL_CLIENT_SESSION_CNT > 0
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.2"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_2);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..session reuse test w/ TLSv1.3"));
+    ret = session_reuse_test(PJ_SSL_SOCK_PROTO_TLS1_3);
+    if (ret != 0)
+        return ret;
+#endif
+
+    /* Falls back to userspace TLS when kernel TLS is not available */
+    PJ_LOG(3,("", "..echo test w/ kernel TLS: TLSv1.2"));
+    ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1_2, PJ_SSL_SOCK_PROTO_TLS1_2,
+                    -1, -1, PJ_FALSE, PJ_FALSE, PJ_TRUE);
+    if (ret != 0)
+        return ret;
+
+    PJ_LOG(3,("", "..echo test w/ kernel TLS: TLSv1.3"));
+    ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1_3, PJ_SSL_SOCK_PROTO_TLS1_3,
+                    -1, -1, PJ_FALSE, PJ_FALSE, PJ_TRUE);
     if (ret != 0)
         return ret;
 
@@ -105,6 +105,61 @@ enum pjmedia_conf_option
 };
 
 
+/**
+ * Mixing settings of the conference bridge. These settings control which
+ * ports take part in mixing on each clock tick, so that the mixing cost
+ * scales with the number of active talkers rather than with the number of
+ * connected participants. Use #pjmedia_conf_mix_setting_default() to
+ * initialize this structure.
+ *
+ * Note that frames that are pure digital silence are always left out of
+ * mixing, since mixing them does not change the result.
+ */
+typedef struct pjmedia_conf_mix_setting
+{
+    /**
+     * Leave ports whose received signal is classified as silence by the
+     * per-port silence detector out of mixing. Listeners of such ports
+     * will receive zero samples instead of the low level signal.
+     *
+     * Note that some hardphones are known to generate noise when they
+     * receive very low (or zero) signal (see ticket #671), so this
+     * setting is disabled by default.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t       skip_silence;
+
+    /**
+     * Silence detector threshold, in linear average level, used when
+     * \a skip_silence is enabled. Specify -1 to use the adaptive silence
+     * detector with its default threshold.
+     *
+     * Default: -1
+     */
+    int             vad_threshold;
+
+    /**
+     * Maximum number of ports to be mixed on each frame. When the number
+     * of active (i.e. non-silent) ports exceeds this value, only the
+     * loudest ports are mixed. Specify zero to mix all active ports.
+     *
+     * Default: 0
+     */
+    unsigned        max_speakers;
+
+} pjmedia_conf_mix_setting;
+
+
+/**
+ * Initialize mixing settings with default values.
+ *
+ * @param setting       The settings to be initialized.
+ */
+PJ_DECL(void) pjmedia_conf_mix_setting_default(
+                                        pjmedia_conf_mix_setting *setting);
+
+
 /**
  * Create conference bridge with the specified parameters. The sampling rate,
  * samples per frame, and bits per sample will be used for the internal
@@ -586,6 +641,33 @@ PJ_DECL(pj_status_t) pjmedia_conf_adjust_conn_level( pjmedia_conf *conf,
                                                      int adj_level );
 
 
+/**
+ * Change the mixing settings of the conference bridge. The new settings
+ * take effect on the next frame.
+ *
+ * @param conf          The conference bridge.
+ * @param setting       The new mixing settings.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_set_mix_setting(
+                                    pjmedia_conf *conf,
+                                    const pjmedia_conf_mix_setting *setting);
+
+
+/**
+ * Get the current mixing settings of the conference bridge.
+ *
+ * @param conf          The conference bridge.
+ * @param setting       Pointer to receive the settings.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_get_mix_setting(
+                                    pjmedia_conf *conf,
+                                    pjmedia_conf_mix_setting *setting);
+
+
 
 PJ_END_DECL
 
@@ -268,6 +268,19 @@
 #endif
 
 
+/**
+ * Use SIMD instructions (SSE2 or NEON, when the compiler targets them) to
+ * calculate the waveform correlation in the WSOLA pitch search, which is
+ * run on every PLC and discard operation. The SIMD correlation is used by
+ * both the floating and fixed point WSOLA builds.
+ *
+ * Default: 1
+ */
+#ifndef PJMEDIA_WSOLA_HAS_SIMD
+#   define PJMEDIA_WSOLA_HAS_SIMD           1
+#endif
+
+
 /**
  * Limit the number of calls by stream to the PLC to generate synthetic
  * frames to this duration. If packets are still lost after this maximum
@@ -398,6 +411,39 @@
 #endif
 
 
+/**
+ * Enable the polyphase filter path of the libresample backend. When the
+ * conversion ratio reduces to at most #PJMEDIA_RESAMPLE_MAX_PHASES phases
+ * and the frame size maps to a whole number of output samples (e.g.
+ * 8KHz, 16KHz and 48KHz with 10/20ms frames), the high quality resampler
+ * precomputes one FIR filter per phase from the libresample impulse
+ * response and runs it with SIMD (SSE or NEON when available) floating
+ * point dot products. The coefficient tables are shared by all resample
+ * sessions with the same (rate_in, rate_out, filter size) and pool factory.
+ *
+ * This option is only used when PJMEDIA_RESAMPLE_IMP is
+ * PJMEDIA_RESAMPLE_LIBRESAMPLE and requires floating point support.
+ *
+ * Default: enabled when PJ_HAS_FLOATING_POINT is set.
+ */
+#ifndef PJMEDIA_RESAMPLE_HAS_POLYPHASE
+#   define PJMEDIA_RESAMPLE_HAS_POLYPHASE   PJ_HAS_FLOATING_POINT
+#endif
+
+
+/**
+ * Maximum number of filter phases (i.e. the output rate divided by the
+ * greatest common divisor of input and output rates) for which the
+ * polyphase resampler will be used. Conversions with more phases fall
+ * back to the generic libresample routine.
+ *
+ * Default: 160 (enough for 44.1KHz to 48KHz conversion)
+ */
+#ifndef PJMEDIA_RESAMPLE_MAX_PHASES
+#   define PJMEDIA_RESAMPLE_MAX_PHASES      160
+#endif
+
+
 /**
  * Specify whether libsamplerate, when used, should be linked statically
  * into the application. This option is only useful for Visual Studio
@@ -1703,6 +1749,38 @@
 #   define PJMEDIA_VID_STREAM_CHECK_RTP_PT      PJMEDIA_STREAM_CHECK_RTP_PT
 #endif
 
+
+/**
+ * Default number of worker threads used by the video conference bridge
+ * to render the sink frames, see pjmedia_vid_conf_setting.worker_cnt.
+ * Rendering a layout with several sources, e.g: in a multi-party video
+ * conference, may take a significant portion of the frame interval, so
+ * applications hosting such conferences may want to set this to the
+ * number of available CPU cores minus one.
+ *
+ * Default: 0 (render in the clock thread)
+ */
+#ifndef PJMEDIA_VID_CONF_WORKER_CNT
+#   define PJMEDIA_VID_CONF_WORKER_CNT          0
+#endif
+
+
+/**
+ * Maximum number of idle converter instances kept by the converter manager
+ * for reuse. When a converter is destroyed, it is kept in the manager's
+ * cache, and a later pjmedia_converter_create() with the same formats and
+ * sizes (e.g: after a video resolution renegotiation, or when a participant
+ * joins a video conference) reuses it instead of setting up a new backend
+ * context. Set to zero to disable the cache.
+ *
+ * See also #pjmedia_converter_mgr_set_cache_size().
+ *
+ * Default: 8
+ */
+#ifndef PJMEDIA_CONVERTER_CACHE_SIZE
+#   define PJMEDIA_CONVERTER_CACHE_SIZE         8
+#endif
+
 /**
  * @}
  */
@@ -223,6 +223,22 @@ struct pjmedia_converter_op
 };
 
 
+/**
+ * Statistics of the converter cache of a conversion manager, see
+ * #pjmedia_converter_mgr_get_cache_stat().
+ */
+typedef struct pjmedia_converter_cache_stat
+{
+    unsigned            max_idle;   /**< Maximum idle converters kept.      */
+    unsigned            idle_cnt;   /**< Idle converters in the cache.      */
+    unsigned            busy_cnt;   /**< Converters currently in use.       */
+    pj_uint32_t         hit_cnt;    /**< Converters reused from the cache.  */
+    pj_uint32_t         miss_cnt;   /**< Converters created by the backend. */
+    pj_uint32_t         evict_cnt;  /**< Idle converters destroyed to make
+                                         room in the cache.                 */
+} pjmedia_converter_cache_stat;
+
+
 /**
  * Opaque data type for conversion manager. Typically, the conversion manager
  * is a singleton instance, although application may instantiate more than one
@@ -267,6 +283,10 @@ PJ_DECL(void) pjmedia_converter_mgr_set_instance(pjmedia_converter_mgr *mgr);
  * Destroy a converter manager. If the manager happens to be the singleton
  * instance, the singleton instance will be set to NULL.
  *
+ * All converters created by the manager must have been destroyed before
+ * the manager is destroyed. Converters still in use are released by this
+ * function, and must not be used or destroyed afterwards.
+ *
  * @param mgr           The converter manager. Specify NULL to use
  *                      the singleton instance.
  */
@@ -303,10 +323,45 @@ pjmedia_converter_mgr_unregister_factory(pjmedia_converter_mgr *mgr,
                                          pjmedia_converter_factory *f,
                                          pj_bool_t call_destroy);
 
+/**
+ * Set the maximum number of idle converters kept by the conversion manager
+ * for reuse. Idle converters exceeding the new limit are destroyed.
+ * Specify zero to disable the cache. The initial value is
+ * #PJMEDIA_CONVERTER_CACHE_SIZE.
+ *
+ * @param mgr           The converter manager. Specify NULL to use
+ *                      the singleton instance.
+ * @param max_idle      Maximum number of idle converters.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_converter_mgr_set_cache_size(pjmedia_converter_mgr *mgr,
+                                     unsigned max_idle);
+
+/**
+ * Get the statistics of the converter cache of the conversion manager.
+ *
+ * @param mgr           The converter manager. Specify NULL to use
+ *                      the singleton instance.
+ * @param stat          Pointer to receive the statistics.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_converter_mgr_get_cache_stat(pjmedia_converter_mgr *mgr,
+                                     pjmedia_converter_cache_stat *stat);
+
 /**
  * Create a converter instance to perform the specified format conversion
  * as specified in \a param.
  *
+ * When the converter cache of the manager is enabled, an idle converter
+ * with the same formats and sizes is reused if available, and the
+ * converter memory is owned by the manager rather than \a pool. So the
+ * converter must always be released with #pjmedia_converter_destroy(),
+ * before the manager is destroyed.
+ *
  * @param mgr           The converter manager. Specify NULL to use
  *                      the singleton instance.
  * @param pool          Pool to allocate the memory from.
@@ -110,7 +110,10 @@ PJ_DECL(unsigned) pjmedia_resample_get_input_size(pjmedia_resample *resample);
 
 
 /**
- * Destroy the resample.
+ * Destroy the resample. This also releases the filter tables that may be
+ * shared with other resample sessions of the same conversion parameters
+ * (see #PJMEDIA_RESAMPLE_HAS_POLYPHASE), so it must be called before the
+ * pool factory of the session pool is destroyed.
  *
  * @param resample              The resample session.
  */
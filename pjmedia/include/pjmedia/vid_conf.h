@@ -117,6 +117,16 @@ typedef struct pjmedia_vid_conf_setting
      */
     unsigned             layout;
 
+    /**
+     * Number of worker threads to render (i.e: scale, convert, and compose)
+     * the sink frames. When this is non-zero, rendering of the sinks due on
+     * a clock tick is spread over the worker threads and the clock thread.
+     * Zero means all rendering is done by the clock thread.
+     *
+     * Default: PJMEDIA_VID_CONF_WORKER_CNT
+     */
+    unsigned             worker_cnt;
+
 } pjmedia_vid_conf_setting;
 
 
@@ -208,6 +208,26 @@ PJ_DECL(pj_status_t) pjmedia_wsola_discard(pjmedia_wsola *wsola,
                                            unsigned *erase_cnt);
 
 
+/**
+ * Calculate the correlation (sum of products) of two blocks of samples,
+ * which is the waveform similarity measure used by the WSOLA pitch
+ * search. The result is exact for any sample values.
+ *
+ * @param frm       The first block of samples.
+ * @param sr        The second block of samples.
+ * @param count     Number of samples in each block.
+ * @param use_simd  Use the SIMD implementation, if it is available (see
+ *                  #PJMEDIA_WSOLA_HAS_SIMD). Otherwise the portable
+ *                  implementation is used.
+ *
+ * @return          The correlation.
+ */
+PJ_DECL(pj_int64_t) pjmedia_wsola_correlate(const pj_int16_t frm[],
+                                            const pj_int16_t sr[],
+                                            unsigned count,
+                                            pj_bool_t use_simd);
+
+
 PJ_END_DECL
 
 /**
@@ -1035,6 +1035,31 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
     return PJ_SUCCESS;
 }
 
+/*
+ * Change mixing settings. The switchboard does not mix, so this is not
+ * supported.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_set_mix_setting(
+                                    pjmedia_conf *conf,
+                                    const pjmedia_conf_mix_setting *setting)
+{
+    PJ_UNUSED_ARG(conf);
+    PJ_UNUSED_ARG(setting);
+    return PJ_ENOTSUP;
+}
+
+/*
+ * Get mixing settings.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_get_mix_setting(
+                                    pjmedia_conf *conf,
+                                    pjmedia_conf_mix_setting *setting)
+{
+    PJ_ASSERT_RETURN(conf && setting, PJ_EINVAL);
+    pjmedia_conf_mix_setting_default(setting);
+    return PJ_SUCCESS;
+}
+
 /* Deliver frm_src to a listener port, eventually call  port's put_frame() 
  * when samples count in the frm_dst are equal to port's samples_per_frame.
  */
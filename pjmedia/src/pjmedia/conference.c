@@ -31,6 +31,18 @@
 #include <pj/pool.h>
 #include <pj/string.h>
 
+
+/*
+ * Initialize mixing settings (shared with the switchboard implementation).
+ */
+PJ_DEF(void) pjmedia_conf_mix_setting_default(
+                                        pjmedia_conf_mix_setting *setting)
+{
+    pj_bzero(setting, sizeof(*setting));
+    setting->vad_threshold = -1;
+}
+
+
 #if !defined(PJMEDIA_CONF_USE_SWITCH_BOARD) || PJMEDIA_CONF_USE_SWITCH_BOARD==0
 
 /* CONF_DEBUG enables detailed operation of the conference bridge.
@@ -137,6 +149,13 @@ struct conf_port
     unsigned             rx_adj_level;  /**< Adjustment for RX.             */
     pj_int16_t          *adj_level_buf; /**< The adjustment buffer.         */
 
+    /* Voice activity of the received signal, used to leave silent ports
+     * out of mixing (see pjmedia_conf_mix_setting).
+     */
+    pjmedia_silence_det *vad;           /**< Silence detector for RX.       */
+    pj_int32_t           rx_avg_level;  /**< Last linear average RX level.  */
+    pj_int16_t          *rx_frame_buf;  /**< Frame held for N-loudest mix.  */
+
     /* Resample, for converting clock rate, if they're different. */
     pjmedia_resample    *rx_resample;
     pjmedia_resample    *tx_resample;
@@ -242,6 +261,8 @@ struct pjmedia_conf
     unsigned              channel_count;/**< Number of channels (1=mono).   */
     unsigned              samples_per_frame;    /**< Samples per frame.     */
     unsigned              bits_per_sample;      /**< Bits per sample.       */
+    pjmedia_conf_mix_setting mix_setting;       /**< Mixing settings.       */
+    struct conf_port    **active_ports; /**< Loudest ports of the frame.    */
 };
 
 
@@ -316,6 +337,25 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
     conf_port->adj_level_buf = (pj_int16_t*) pj_pool_zalloc(pool, 
                                conf->samples_per_frame * sizeof(pj_int16_t));
 
+    /* Create the frame buffer to hold the received frame while the loudest
+     * ports are being selected.
+     */
+    conf_port->rx_frame_buf = (pj_int16_t*) pj_pool_zalloc(pool,
+                               conf->samples_per_frame * sizeof(pj_int16_t));
+    PJ_ASSERT_RETURN(conf_port->rx_frame_buf, PJ_ENOMEM);
+
+    /* Create silence detector for the received signal. */
+    status = pjmedia_silence_det_create(pool, conf->clock_rate,
+                                        conf->samples_per_frame,
+                                        &conf_port->vad);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    if (conf->mix_setting.vad_threshold >= 0) {
+        pjmedia_silence_det_set_fixed(conf_port->vad,
+                                      conf->mix_setting.vad_threshold);
+    }
+
     /* If port's clock rate is different than conference's clock rate,
      * create a resample sessions.
      */
@@ -351,8 +391,11 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
                                          conf_port->clock_rate, /* Rate out */
                                          conf->samples_per_frame,
                                          &conf_port->tx_resample);
-        if (status != PJ_SUCCESS)
+        if (status != PJ_SUCCESS) {
+            pjmedia_resample_destroy(conf_port->rx_resample);
+            conf_port->rx_resample = NULL;
             return status;
+        }
     }
 
     /*
@@ -572,6 +615,11 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
     conf->channel_count = channel_count;
     conf->samples_per_frame = samples_per_frame;
     conf->bits_per_sample = bits_per_sample;
+    pjmedia_conf_mix_setting_default(&conf->mix_setting);
+
+    conf->active_ports = (struct conf_port**)
+                         pj_pool_zalloc(pool, max_ports*sizeof(void*));
+    PJ_ASSERT_RETURN(conf->active_ports, PJ_ENOMEM);
 
     
     /* Create and initialize the master port interface. */
@@ -1551,6 +1599,69 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_conn_level( pjmedia_conf *conf,
 }
 
 
+/*
+ * Change mixing settings.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_set_mix_setting(
+                                    pjmedia_conf *conf,
+                                    const pjmedia_conf_mix_setting *setting)
+{
+    unsigned i, ci;
+
+    PJ_ASSERT_RETURN(conf && setting, PJ_EINVAL);
+    PJ_ASSERT_RETURN(setting->max_speakers <= conf->max_ports, PJ_EINVAL);
+
+    pj_mutex_lock(conf->mutex);
+
+    /* Apply the silence detector threshold to all ports. */
+    if (setting->vad_threshold != conf->mix_setting.vad_threshold) {
+        for (i=0, ci=0; i<conf->max_ports && ci<conf->port_cnt; ++i) {
+            struct conf_port *conf_port = conf->ports[i];
+
+            if (!conf_port)
+                continue;
+
+            ++ci;
+
+            if (setting->vad_threshold >= 0) {
+                pjmedia_silence_det_set_fixed(conf_port->vad,
+                                              setting->vad_threshold);
+            } else {
+                pjmedia_silence_det_set_adaptive(conf_port->vad, -1);
+            }
+        }
+    }
+
+    pj_memcpy(&conf->mix_setting, setting, sizeof(*setting));
+
+    pj_mutex_unlock(conf->mutex);
+
+    PJ_LOG(5,(THIS_FILE, "Mix setting changed: skip_silence=%d, "
+              "vad_threshold=%d, max_speakers=%d",
+              setting->skip_silence, setting->vad_threshold,
+              setting->max_speakers));
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get mixing settings.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_get_mix_setting(
+                                    pjmedia_conf *conf,
+                                    pjmedia_conf_mix_setting *setting)
+{
+    PJ_ASSERT_RETURN(conf && setting, PJ_EINVAL);
+
+    pj_mutex_lock(conf->mutex);
+    pj_memcpy(setting, &conf->mix_setting, sizeof(*setting));
+    pj_mutex_unlock(conf->mutex);
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Read from port.
  */
@@ -1943,6 +2054,105 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
 }
 
 
+/*
+ * Add the frame received from the port to the mix buffer of all of its
+ * listeners.
+ */
+static void mix_port(pjmedia_conf *conf, struct conf_port *conf_port,
+                     pj_int16_t *p_in)
+{
+    unsigned cj;
+
+    for (cj=0; cj < conf_port->listener_cnt; ++cj) 
+    {
+        struct conf_port *listener;
+        pj_int32_t *mix_buf;            
+        pj_int16_t *p_in_conn_leveled;
+
+        listener = conf->ports[conf_port->listener_slots[cj]];
+
+        /* Skip if this listener doesn't want to receive audio */
+        if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
+            continue;
+
+        mix_buf = listener->mix_buf;
+
+        /* apply connection level, if not normal */
+        if (conf_port->listener_adj_level[cj] != NORMAL_LEVEL) {
+            unsigned k = 0;
+            for (; k < conf->samples_per_frame; ++k) {
+                /* For the level adjustment, we need to store the sample to
+                 * a temporary 32bit integer value to avoid overflowing the
+                 * 16bit sample storage.
+                 */
+                pj_int32_t itemp;
+
+                itemp = p_in[k];
+                /*itemp = itemp * adj / NORMAL_LEVEL;*/
+                /* bad code (signed/unsigned badness):
+                 *  itemp = (itemp * conf_port->listsener_adj_level) >> 7;
+                 */
+                itemp *= conf_port->listener_adj_level[cj];
+                itemp >>= 7;
+
+                /* Clip the signal if it's too loud */
+                if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
+                else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+
+                conf_port->adj_level_buf[k] = (pj_int16_t)itemp;
+            }
+
+            /* take the leveled frame */
+            p_in_conn_leveled = conf_port->adj_level_buf;
+        } else {
+            /* take the frame as-is */
+            p_in_conn_leveled = p_in;
+        }
+
+        if (listener->transmitter_cnt > 1) {
+            /* Mixing signals,
+             * and calculate appropriate level adjustment if there is
+             * any overflowed level in the mixed signal.
+             */
+            unsigned k, samples_per_frame = conf->samples_per_frame;
+            pj_int32_t mix_buf_min = 0;
+            pj_int32_t mix_buf_max = 0;
+
+            for (k = 0; k < samples_per_frame; ++k) {
+                mix_buf[k] += p_in_conn_leveled[k];
+                if (mix_buf[k] < mix_buf_min)
+                    mix_buf_min = mix_buf[k];
+                if (mix_buf[k] > mix_buf_max)
+                    mix_buf_max = mix_buf[k];
+            }
+
+            /* Check if normalization adjustment needed. */
+            if (mix_buf_min < MIN_LEVEL || mix_buf_max > MAX_LEVEL) {
+                int tmp_adj;
+
+                if (-mix_buf_min > mix_buf_max)
+                    mix_buf_max = -mix_buf_min;
+
+                /* NORMAL_LEVEL * MAX_LEVEL / mix_buf_max; */
+                tmp_adj = (MAX_LEVEL<<7) / mix_buf_max;
+                if (tmp_adj < listener->mix_adj)
+                    listener->mix_adj = tmp_adj;
+            }
+        } else {
+            /* Only 1 transmitter:
+             * just copy the samples to the mix buffer
+             * no mixing and level adjustment needed
+             */
+            unsigned k, samples_per_frame = conf->samples_per_frame;
+
+            for (k = 0; k < samples_per_frame; ++k) {
+                mix_buf[k] = p_in_conn_leveled[k];
+            }
+        }
+    } /* loop the listeners of conf port */
+}
+
+
 /*
  * Player callback.
  */
@@ -1951,7 +2161,8 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 {
     pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
     pjmedia_frame_type speaker_frame_type = PJMEDIA_FRAME_TYPE_NONE;
-    unsigned ci, cj, i, j;
+    unsigned ci, i, j;
+    unsigned max_speakers, active_cnt = 0;
     pj_int16_t *p_in;
     
     TRACE_((THIS_FILE, "- clock -"));
@@ -1963,6 +2174,11 @@ static pj_status_t get_frame(pjmedia_port *this_port,
     /* Must lock mutex */
     pj_mutex_lock(conf->mutex);
 
+    /* When mixing is limited to the loudest ports, each port's frame is
+     * kept in its own buffer until all ports have been read.
+     */
+    max_speakers = conf->mix_setting.max_speakers;
+
     /* Reset port source count. We will only reset port's mix
      * buffer when we have someone transmitting to it.
      */
@@ -2016,6 +2232,11 @@ static pj_status_t get_frame(pjmedia_port *this_port,
             continue;
         }
 
+        if (max_speakers)
+            p_in = conf_port->rx_frame_buf;
+        else
+            p_in = (pj_int16_t*) frame->buf;
+
         /* Get frame from this port.
          * For passive ports, get the frame from the delay_buf.
          * For other ports, get the frame from the port. 
@@ -2023,8 +2244,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
         if (conf_port->delay_buf != NULL) {
             pj_status_t status;
         
-            status = pjmedia_delay_buf_get(conf_port->delay_buf,
-                                  (pj_int16_t*)frame->buf);
+            status = pjmedia_delay_buf_get(conf_port->delay_buf, p_in);
             if (status != PJ_SUCCESS) {
                 conf_port->rx_level = 0;
                 continue;
@@ -2035,7 +2255,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
             pj_status_t status;
             pjmedia_frame_type frame_type;
 
-            status = read_port(conf, conf_port, (pj_int16_t*)frame->buf, 
+            status = read_port(conf, conf_port, p_in,
                                conf->samples_per_frame, &frame_type);
             
             if (status != PJ_SUCCESS) {
@@ -2066,8 +2286,6 @@ static pj_status_t get_frame(pjmedia_port *this_port,
             }           
         }
 
-        p_in = (pj_int16_t*) frame->buf;
-
         /* Adjust the RX level from this port
          * and calculate the average level at the same time.
          */
@@ -2100,7 +2318,17 @@ static pj_status_t get_frame(pjmedia_port *this_port,
             }
         }
 
+        /* Frame of pure digital silence does not change the mixed signal
+         * (mix buffers have been reset above), so skip it entirely.
+         */
+        if (level == 0) {
+            conf_port->rx_avg_level = 0;
+            conf_port->rx_level = 0;
+            continue;
+        }
+
         level /= conf->samples_per_frame;
+        conf_port->rx_avg_level = level;
 
         /* Convert level to 8bit complement ulaw */
         level = pjmedia_linear2ulaw(level) ^ 0xff;
@@ -2110,100 +2338,50 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 
         // Ticket #671: Skipping very low audio signal may cause noise 
         // to be generated in the remote end by some hardphones.
-        /* Skip processing frame if level is zero */
-        //if (level == 0)
-        //    continue;
-
-        /* Add the signal to all listeners. */
-        for (cj=0; cj < conf_port->listener_cnt; ++cj) 
+        // That's why skipping silent (but non-zero) frames is optional.
+        if (conf->mix_setting.skip_silence &&
+            pjmedia_silence_det_apply(conf_port->vad,
+                                      conf_port->rx_avg_level))
         {
-            struct conf_port *listener;
-            pj_int32_t *mix_buf;            
-            pj_int16_t *p_in_conn_leveled;
-
-            listener = conf->ports[conf_port->listener_slots[cj]];
-
-            /* Skip if this listener doesn't want to receive audio */
-            if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
-                continue;
+            continue;
+        }
 
-            mix_buf = listener->mix_buf;
-
-            /* apply connection level, if not normal */
-            if (conf_port->listener_adj_level[cj] != NORMAL_LEVEL) {
-                unsigned k = 0;
-                for (; k < conf->samples_per_frame; ++k) {
-                    /* For the level adjustment, we need to store the sample to
-                     * a temporary 32bit integer value to avoid overflowing the
-                     * 16bit sample storage.
-                     */
-                    pj_int32_t itemp;
-
-                    itemp = p_in[k];
-                    /*itemp = itemp * adj / NORMAL_LEVEL;*/
-                    /* bad code (signed/unsigned badness):
-                     *  itemp = (itemp * conf_port->listsener_adj_level) >> 7;
-                     */
-                    itemp *= conf_port->listener_adj_level[cj];
-                    itemp >>= 7;
-
-                    /* Clip the signal if it's too loud */
-                    if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-                    else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
-
-                    conf_port->adj_level_buf[k] = (pj_int16_t)itemp;
+        /* Add the signal to all listeners, or keep the frame until the
+         * loudest ports are known.
+         */
+        if (max_speakers == 0) {
+            mix_port(conf, conf_port, p_in);
+        } else {
+            unsigned pos;
+
+            /* Keep active_ports sorted by level, loudest first. */
+            if (active_cnt == max_speakers) {
+                if (conf_port->rx_avg_level <=
+                    conf->active_ports[active_cnt-1]->rx_avg_level)
+                {
+                    continue;
                 }
-
-                /* take the leveled frame */
-                p_in_conn_leveled = conf_port->adj_level_buf;
-            } else {
-                /* take the frame as-is */
-                p_in_conn_leveled = p_in;
+                --active_cnt;
             }
-
-            if (listener->transmitter_cnt > 1) {
-                /* Mixing signals,
-                 * and calculate appropriate level adjustment if there is
-                 * any overflowed level in the mixed signal.
-                 */
-                unsigned k, samples_per_frame = conf->samples_per_frame;
-                pj_int32_t mix_buf_min = 0;
-                pj_int32_t mix_buf_max = 0;
-
-                for (k = 0; k < samples_per_frame; ++k) {
-                    mix_buf[k] += p_in_conn_leveled[k];
-                    if (mix_buf[k] < mix_buf_min)
-                        mix_buf_min = mix_buf[k];
-                    if (mix_buf[k] > mix_buf_max)
-                        mix_buf_max = mix_buf[k];
-                }
-
-                /* Check if normalization adjustment needed. */
-                if (mix_buf_min < MIN_LEVEL || mix_buf_max > MAX_LEVEL) {
-                    int tmp_adj;
-
-                    if (-mix_buf_min > mix_buf_max)
-                        mix_buf_max = -mix_buf_min;
-
-                    /* NORMAL_LEVEL * MAX_LEVEL / mix_buf_max; */
-                    tmp_adj = (MAX_LEVEL<<7) / mix_buf_max;
-                    if (tmp_adj < listener->mix_adj)
-                        listener->mix_adj = tmp_adj;
-                }
-            } else {
-                /* Only 1 transmitter:
-                 * just copy the samples to the mix buffer
-                 * no mixing and level adjustment needed
-                 */
-                unsigned k, samples_per_frame = conf->samples_per_frame;
-
-                for (k = 0; k < samples_per_frame; ++k) {
-                    mix_buf[k] = p_in_conn_leveled[k];
+            for (pos = active_cnt; pos > 0; --pos) {
+                if (conf->active_ports[pos-1]->rx_avg_level >=
+                    conf_port->rx_avg_level)
+                {
+                    break;
                 }
+                conf->active_ports[pos] = conf->active_ports[pos-1];
             }
-        } /* loop the listeners of conf port */
+            conf->active_ports[pos] = conf_port;
+            ++active_cnt;
+        }
     } /* loop of all conf ports */
 
+    /* Mix the loudest ports. */
+    for (i=0; i<active_cnt; ++i) {
+        mix_port(conf, conf->active_ports[i],
+                 conf->active_ports[i]->rx_frame_buf);
+    }
+
     /* Time for all ports to transmit whetever they have in their
      * buffer. 
      */
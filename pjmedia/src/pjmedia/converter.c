@@ -18,16 +18,49 @@
 #include <pjmedia/converter.h>
 #include <pj/assert.h>
 #include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
 
 #define THIS_FILE       "converter.c"
 
+/* Cache list node of a converter. */
+typedef struct conv_node
+{
+    PJ_DECL_LIST_MEMBER(struct conv_node);
+    struct cached_converter    *cc;
+} conv_node;
+
+/* Converter created through the converter cache. It wraps the converter
+ * created by the backend, and is put back to the cache of the manager
+ * when destroyed.
+ */
+typedef struct cached_converter
+{
+    pjmedia_converter           base;
+    pjmedia_converter_mgr      *mgr;        /* Owner of the cache          */
+    pj_pool_t                  *pool;       /* Owns backend converter      */
+    pjmedia_conversion_param    param;      /* Cache key                   */
+    pjmedia_converter          *cv;         /* Backend converter           */
+    conv_node                   node;       /* Node in idle or busy list   */
+} cached_converter;
+
 struct pjmedia_converter_mgr
 {
     pjmedia_converter_factory  factory_list;
+
+    /* Converter cache */
+    pj_pool_factory            *pf;         /* To create converter pools    */
+    pj_mutex_t                 *mutex;      /* Protects the cache           */
+    conv_node                   idle_list;  /* Idle converters, MRU first   */
+    conv_node                   busy_list;  /* Converters in use            */
+    pjmedia_converter_cache_stat cache_stat;/* Cache statistics             */
 };
 
 static pjmedia_converter_mgr *converter_manager_instance;
 
+static void cached_conv_free(cached_converter *cc);
+
 #if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0) && \
     defined(PJMEDIA_HAS_LIBSWSCALE) && (PJMEDIA_HAS_LIBSWSCALE != 0)
 PJ_DECL(pj_status_t)
@@ -46,9 +79,18 @@ PJ_DEF(pj_status_t) pjmedia_converter_mgr_create(pj_pool_t *pool,
     pjmedia_converter_mgr *mgr;
     pj_status_t status = PJ_SUCCESS;
 
-    mgr = PJ_POOL_ALLOC_T(pool, pjmedia_converter_mgr);
+    mgr = PJ_POOL_ZALLOC_T(pool, pjmedia_converter_mgr);
     pj_list_init(&mgr->factory_list);
 
+    /* Init converter cache, it is simply disabled if the mutex cannot be
+     * created.
+     */
+    mgr->pf = pool->factory;
+    pj_list_init(&mgr->idle_list);
+    pj_list_init(&mgr->busy_list);
+    if (pj_mutex_create_simple(pool, "convmgr", &mgr->mutex) == PJ_SUCCESS)
+        mgr->cache_stat.max_idle = PJMEDIA_CONVERTER_CACHE_SIZE;
+
     if (!converter_manager_instance)
         converter_manager_instance = mgr;
 
@@ -95,6 +137,30 @@ PJ_DEF(void) pjmedia_converter_mgr_destroy(pjmedia_converter_mgr *mgr)
 
     PJ_ASSERT_ON_FAIL(mgr != NULL, return);
 
+    /* Destroy the idle converters. The ones still in use are detached
+     * from the manager, they will be freed when their owner destroys them.
+     */
+    if (mgr->mutex) {
+        pjmedia_converter_mgr_set_cache_size(mgr, 0);
+
+        pj_mutex_lock(mgr->mutex);
+        if (!pj_list_empty(&mgr->busy_list)) {
+            PJ_LOG(2,(THIS_FILE, "Warning: %d converter(s) not destroyed "
+                                 "before the converter manager",
+                                 (int)pj_list_size(&mgr->busy_list)));
+        }
+        while (!pj_list_empty(&mgr->busy_list)) {
+            conv_node *node = mgr->busy_list.next;
+            pj_list_erase(node);
+            node->cc->mgr = NULL;
+        }
+        mgr->cache_stat.busy_cnt = 0;
+        pj_mutex_unlock(mgr->mutex);
+
+        pj_mutex_destroy(mgr->mutex);
+        mgr->mutex = NULL;
+    }
+
     f = mgr->factory_list.next;
     while (f != &mgr->factory_list) {
         pjmedia_converter_factory *next = f->next;
@@ -147,18 +213,171 @@ pjmedia_converter_mgr_unregister_factory(pjmedia_converter_mgr *mgr,
     return PJ_SUCCESS;
 }
 
-PJ_DEF(pj_status_t) pjmedia_converter_create(pjmedia_converter_mgr *mgr,
-                                              pj_pool_t *pool,
-                                              pjmedia_conversion_param *param,
-                                              pjmedia_converter **p_cv)
+/* Compare the cache key of two video formats, return 0 if equal. Frame
+ * rate and bitrate do not matter to the converters.
+ */
+static int cmp_conv_fmt(const pjmedia_format *fmt1,
+                        const pjmedia_format *fmt2)
 {
-    pjmedia_converter_factory *f;
-    pjmedia_converter *cv = NULL;
-    pj_status_t status = PJ_ENOTFOUND;
+    if (fmt1->id != fmt2->id || fmt1->type != fmt2->type ||
+        fmt1->detail_type != fmt2->detail_type)
+    {
+        return 1;
+    }
+    if (fmt1->detail_type == PJMEDIA_FORMAT_DETAIL_VIDEO) {
+        return (fmt1->det.vid.size.w != fmt2->det.vid.size.w ||
+                fmt1->det.vid.size.h != fmt2->det.vid.size.h);
+    }
+    return pj_memcmp(&fmt1->det, &fmt2->det, sizeof(fmt1->det));
+}
+
+/* Release the backend converter and the pool of a cached converter. */
+static void cached_conv_free(cached_converter *cc)
+{
+    pj_pool_t *pool = cc->pool;
+
+    (*cc->cv->op->destroy)(cc->cv);
+    pj_pool_release(pool);
+}
+
+static pj_status_t cached_conv_convert(pjmedia_converter *converter,
+                                       pjmedia_frame *src_frame,
+                                       pjmedia_frame *dst_frame)
+{
+    cached_converter *cc = (cached_converter*)converter;
+    return (*cc->cv->op->convert)(cc->cv, src_frame, dst_frame);
+}
+
+static pj_status_t cached_conv_convert2(
+                                    pjmedia_converter       *converter,
+                                    pjmedia_frame           *src_frame,
+                                    const pjmedia_rect_size *src_frame_size,
+                                    const pjmedia_coord     *src_pos,
+                                    pjmedia_frame           *dst_frame,
+                                    const pjmedia_rect_size *dst_frame_size,
+                                    const pjmedia_coord     *dst_pos,
+                                    pjmedia_converter_convert_setting
+                                                            *param)
+{
+    cached_converter *cc = (cached_converter*)converter;
+
+    if (!cc->cv->op->convert2)
+        return PJ_ENOTSUP;
+
+    return (*cc->cv->op->convert2)(cc->cv, src_frame, src_frame_size,
+                                   src_pos, dst_frame, dst_frame_size,
+                                   dst_pos, param);
+}
+
+/* Put the converter back to the cache, or destroy it if the cache is
+ * full or disabled.
+ */
+static void cached_conv_destroy(pjmedia_converter *converter)
+{
+    cached_converter *cc = (cached_converter*)converter;
+    pjmedia_converter_mgr *mgr = cc->mgr;
+    cached_converter *evicted = NULL;
+
+    /* Detached from the destroyed manager */
+    if (!mgr) {
+        cached_conv_free(cc);
+        return;
+    }
+
+    pj_mutex_lock(mgr->mutex);
+
+    pj_list_erase(&cc->node);
+    --mgr->cache_stat.busy_cnt;
+
+    if (mgr->cache_stat.max_idle == 0) {
+        evicted = cc;
+    } else {
+        pj_list_push_front(&mgr->idle_list, &cc->node);
+        ++mgr->cache_stat.idle_cnt;
+
+        /* Evict the least recently used converter */
+        if (mgr->cache_stat.idle_cnt > mgr->cache_stat.max_idle) {
+            conv_node *lru = mgr->idle_list.prev;
+            pj_list_erase(lru);
+            --mgr->cache_stat.idle_cnt;
+            ++mgr->cache_stat.evict_cnt;
+            evicted = lru->cc;
+        }
+    }
+
+    pj_mutex_unlock(mgr->mutex);
+
+    if (evicted)
+        cached_conv_free(evicted);
+}
+
+static pjmedia_converter_op cached_conv_op =
+{
+    &cached_conv_convert,
+    &cached_conv_destroy,
+    &cached_conv_convert2
+};
+
+PJ_DEF(pj_status_t)
+pjmedia_converter_mgr_set_cache_size(pjmedia_converter_mgr *mgr,
+                                     unsigned max_idle)
+{
+    conv_node evicted;
 
     if (!mgr) mgr = pjmedia_converter_mgr_instance();
 
     PJ_ASSERT_RETURN(mgr != NULL, PJ_EINVAL);
+    PJ_ASSERT_RETURN(mgr->mutex, PJ_EINVALIDOP);
+
+    pj_list_init(&evicted);
+
+    pj_mutex_lock(mgr->mutex);
+    mgr->cache_stat.max_idle = max_idle;
+    while (mgr->cache_stat.idle_cnt > max_idle) {
+        conv_node *lru = mgr->idle_list.prev;
+        pj_list_erase(lru);
+        pj_list_push_back(&evicted, lru);
+        --mgr->cache_stat.idle_cnt;
+        ++mgr->cache_stat.evict_cnt;
+    }
+    pj_mutex_unlock(mgr->mutex);
+
+    /* Destroy the evicted converters outside the lock */
+    while (!pj_list_empty(&evicted)) {
+        conv_node *node = evicted.next;
+        pj_list_erase(node);
+        cached_conv_free(node->cc);
+    }
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t)
+pjmedia_converter_mgr_get_cache_stat(pjmedia_converter_mgr *mgr,
+                                     pjmedia_converter_cache_stat *stat)
+{
+    if (!mgr) mgr = pjmedia_converter_mgr_instance();
+
+    PJ_ASSERT_RETURN(mgr && stat, PJ_EINVAL);
+
+    if (mgr->mutex)
+        pj_mutex_lock(mgr->mutex);
+    pj_memcpy(stat, &mgr->cache_stat, sizeof(*stat));
+    if (mgr->mutex)
+        pj_mutex_unlock(mgr->mutex);
+
+    return PJ_SUCCESS;
+}
+
+/* Create the converter from the first factory that supports it. */
+static pj_status_t create_converter(pjmedia_converter_mgr *mgr,
+                                    pj_pool_t *pool,
+                                    pjmedia_conversion_param *param,
+                                    pjmedia_converter **p_cv)
+{
+    pjmedia_converter_factory *f;
+    pjmedia_converter *cv = NULL;
+    pj_status_t status = PJ_ENOTFOUND;
 
     *p_cv = NULL;
 
@@ -178,6 +397,81 @@ PJ_DEF(pj_status_t) pjmedia_converter_create(pjmedia_converter_mgr *mgr,
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pjmedia_converter_create(pjmedia_converter_mgr *mgr,
+                                              pj_pool_t *pool,
+                                              pjmedia_conversion_param *param,
+                                              pjmedia_converter **p_cv)
+{
+    cached_converter *cc = NULL;
+    conv_node *node;
+    pj_pool_t *cc_pool;
+    pj_status_t status;
+
+    if (!mgr) mgr = pjmedia_converter_mgr_instance();
+
+    PJ_ASSERT_RETURN(mgr != NULL, PJ_EINVAL);
+
+    *p_cv = NULL;
+
+    /* Create directly from the caller's pool if the cache is disabled */
+    if (!mgr->mutex || mgr->cache_stat.max_idle == 0)
+        return create_converter(mgr, pool, param, p_cv);
+
+    /* Look up an idle converter in the cache */
+    pj_mutex_lock(mgr->mutex);
+    for (node = mgr->idle_list.next; node != &mgr->idle_list;
+         node = node->next)
+    {
+        if (cmp_conv_fmt(&node->cc->param.src, &param->src) == 0 &&
+            cmp_conv_fmt(&node->cc->param.dst, &param->dst) == 0)
+        {
+            cc = node->cc;
+            pj_list_erase(node);
+            --mgr->cache_stat.idle_cnt;
+            pj_list_push_back(&mgr->busy_list, node);
+            ++mgr->cache_stat.busy_cnt;
+            ++mgr->cache_stat.hit_cnt;
+            break;
+        }
+    }
+    pj_mutex_unlock(mgr->mutex);
+
+    if (cc) {
+        *p_cv = &cc->base;
+        return PJ_SUCCESS;
+    }
+
+    /* Not found, create a new one with its own pool so it may outlive
+     * the caller's pool in the cache.
+     */
+    cc_pool = pj_pool_create(mgr->pf, "conv%p", 512, 512, NULL);
+    if (!cc_pool)
+        return PJ_ENOMEM;
+
+    cc = PJ_POOL_ZALLOC_T(cc_pool, cached_converter);
+    cc->pool = cc_pool;
+    cc->param = *param;
+    cc->node.cc = cc;
+    cc->base.op = &cached_conv_op;
+
+    status = create_converter(mgr, cc_pool, param, &cc->cv);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(cc_pool);
+        return status;
+    }
+
+    pj_mutex_lock(mgr->mutex);
+    cc->mgr = mgr;
+    pj_list_push_back(&mgr->busy_list, &cc->node);
+    ++mgr->cache_stat.busy_cnt;
+    ++mgr->cache_stat.miss_cnt;
+    pj_mutex_unlock(mgr->mutex);
+
+    *p_cv = &cc->base;
+
+    return PJ_SUCCESS;
+}
+
 PJ_DEF(pj_status_t) pjmedia_converter_convert(pjmedia_converter *cv,
                                                pjmedia_frame *src_frame,
                                                pjmedia_frame *dst_frame)
@@ -114,6 +114,12 @@ PJ_DEF(pj_status_t) pjmedia_resample_port_create( pj_pool_t *pool,
                                      d_afd->clock_rate,
                                      PJMEDIA_PIA_SPF(&rport->base.info),
                                      &rport->resample_put);
+    if (status != PJ_SUCCESS) {
+        /* Release the filter table held by the "get_frame" resample */
+        pjmedia_resample_destroy(rport->resample_get);
+        rport->resample_get = NULL;
+        return status;
+    }
 
     /* Media port interface */
     rport->base.get_frame = &resample_get_frame;
@@ -21,8 +21,11 @@
 
 #include <pjmedia/errno.h>
 #include <pj/assert.h>
+#include <pj/list.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/string.h>
 
 
 #if PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_LIBRESAMPLE
@@ -32,6 +35,51 @@
 #define THIS_FILE   "resample.c"
 
 
+#if PJMEDIA_RESAMPLE_HAS_POLYPHASE
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#   define POLY_HAS_SSE     1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define POLY_HAS_NEON    1
+#endif
+
+/* Number of zero guard samples after the input buffer, to cover the taps
+ * added when rounding the filter length up to a multiple of four.
+ */
+#define POLY_GUARD      4
+
+/* Polyphase filter table. The table only depends on the conversion
+ * parameters, so it is shared by every resample session with the same
+ * (rate_in, rate_out, filter size) that was created from the same pool
+ * factory.
+ */
+typedef struct poly_filter
+{
+    PJ_DECL_LIST_MEMBER(struct poly_filter);
+    pj_pool_t       *pool;          /* Pool owning this table.              */
+    pj_pool_factory *factory;       /* Key: pool factory.                   */
+    unsigned         rate_in;       /* Key: input clock rate.               */
+    unsigned         rate_out;      /* Key: output clock rate.              */
+    pj_bool_t        large_filter;  /* Key: large filter?                   */
+    unsigned         ref_cnt;       /* Number of sessions using the table.  */
+    unsigned         L;             /* Interpolation factor (phase count).  */
+    unsigned         M;             /* Decimation factor.                   */
+    unsigned         half;          /* Taps up to and including x[t].       */
+    unsigned         taps;          /* Taps per phase, multiple of four.    */
+    float           *coef;          /* L phases of taps coefficients.       */
+} poly_filter;
+
+/* List of shared polyphase filter tables, protected by the pjlib
+ * critical section.
+ */
+static poly_filter poly_filter_list;
+static pj_bool_t   poly_filter_list_initialized;
+
+#endif  /* PJMEDIA_RESAMPLE_HAS_POLYPHASE */
+
 
 struct pjmedia_resample
 {
@@ -48,9 +96,309 @@ struct pjmedia_resample
     /* Buffer for multichannel */
     pj_int16_t **in_buffer;     /* Array of input buffer for each channel.  */
     pj_int16_t  *tmp_buffer;    /* Temporary output buffer for processing.  */
+
+#if PJMEDIA_RESAMPLE_HAS_POLYPHASE
+    /* Polyphase filter, NULL if libresample routines are used. */
+    poly_filter *poly;          /* Shared filter table.                     */
+    unsigned     poly_hist;     /* History length, in samples per channel.  */
+    float      **poly_buf;      /* Per channel history + input buffer.      */
+#endif
 };
 
 
+#if PJMEDIA_RESAMPLE_HAS_POLYPHASE
+
+static unsigned poly_gcd(unsigned a, unsigned b)
+{
+    while (b) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Build the coefficients of each filter phase from the libresample
+ * impulse response, with the same cutoff and gain as res_Resample().
+ */
+static pj_status_t poly_filter_create(pj_pool_factory *factory,
+                                      unsigned rate_in,
+                                      unsigned rate_out,
+                                      pj_bool_t large_filter,
+                                      poly_filter **p_flt)
+{
+    const RES_HWORD *imp, *imp_d;
+    RES_UHWORD nwing, lp_scl, npc;
+    double factor, dh, width, gain;
+    unsigned g, L, ph, j;
+    pj_pool_t *pool;
+    poly_filter *flt;
+
+    if (!res_GetFilter((RES_BOOL)large_filter, &imp, &imp_d, &nwing,
+                       &lp_scl, &npc))
+    {
+        return PJ_ENOTSUP;
+    }
+
+    g = poly_gcd(rate_in, rate_out);
+    L = rate_out / g;
+    if (L > PJMEDIA_RESAMPLE_MAX_PHASES)
+        return PJ_ETOOBIG;
+
+    pool = pj_pool_create(factory, "resample%p", 512, 512, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    flt = PJ_POOL_ZALLOC_T(pool, poly_filter);
+    flt->pool = pool;
+    flt->factory = factory;
+    flt->rate_in = rate_in;
+    flt->rate_out = rate_out;
+    flt->large_filter = large_filter;
+    flt->L = L;
+    flt->M = rate_in / g;
+
+    /* When downsampling, the impulse response is stretched to move the
+     * cutoff below the output Nyquist frequency, and the gain reduced
+     * accordingly. libresample scales the filter output by LpScl/2^29
+     * (Nhxn + Nhg + NLpScl bits).
+     */
+    factor = rate_out * 1.0 / rate_in;
+    if (factor < 1) {
+        dh = npc * factor;
+        gain = (unsigned)(lp_scl * factor + 0.5) / (double)(1 << 29);
+    } else {
+        dh = npc;
+        gain = lp_scl / (double)(1 << 29);
+    }
+
+    /* One wing of the filter, in input samples */
+    width = nwing / dh;
+    flt->half = (unsigned)width;
+    if (flt->half < width)
+        ++flt->half;
+    ++flt->half;
+    flt->taps = (flt->half * 2 + 3) & ~3;
+
+    /* Coefficient rows must be 16 bytes aligned for the SIMD loads */
+    flt->coef = (float*)pj_pool_alloc(pool, flt->taps * L * sizeof(float) +
+                                            16);
+    flt->coef = (float*)(((pj_size_t)flt->coef + 15) & ~(pj_size_t)15);
+
+    /* Phase ph is used for output samples whose position falls at
+     * fraction ph/L after input sample x[t]. Tap j is applied to input
+     * sample x[t - half + 1 + j].
+     */
+    for (ph = 0; ph < L; ++ph) {
+        float *row = flt->coef + ph * flt->taps;
+        double frac = ph * 1.0 / L;
+
+        for (j = 0; j < flt->taps; ++j) {
+            double d = (double)j - flt->half + 1 - frac;
+            double x = (d < 0 ? -d : d) * dh;
+            unsigned k = (unsigned)x;
+
+            if (k >= nwing) {
+                row[j] = 0;
+            } else {
+                row[j] = (float)((imp[k] + imp_d[k] * (x - k)) * gain);
+            }
+        }
+    }
+
+    *p_flt = flt;
+    return PJ_SUCCESS;
+}
+
+/* Get a shared filter table, creating it when needed */
+static pj_status_t poly_filter_get(pj_pool_factory *factory,
+                                   unsigned rate_in,
+                                   unsigned rate_out,
+                                   pj_bool_t large_filter,
+                                   poly_filter **p_flt)
+{
+    poly_filter *flt;
+    pj_status_t status;
+
+    pj_enter_critical_section();
+
+    if (!poly_filter_list_initialized) {
+        pj_list_init(&poly_filter_list);
+        poly_filter_list_initialized = PJ_TRUE;
+    }
+
+    flt = poly_filter_list.next;
+    while (flt != &poly_filter_list) {
+        if (flt->factory == factory && flt->rate_in == rate_in &&
+            flt->rate_out == rate_out && flt->large_filter == large_filter)
+        {
+            ++flt->ref_cnt;
+            pj_leave_critical_section();
+            *p_flt = flt;
+            return PJ_SUCCESS;
+        }
+        flt = flt->next;
+    }
+
+    status = poly_filter_create(factory, rate_in, rate_out, large_filter,
+                                &flt);
+    if (status == PJ_SUCCESS) {
+        flt->ref_cnt = 1;
+        pj_list_push_back(&poly_filter_list, flt);
+        *p_flt = flt;
+    }
+
+    pj_leave_critical_section();
+    return status;
+}
+
+static void poly_filter_release(poly_filter *flt)
+{
+    pj_enter_critical_section();
+    if (--flt->ref_cnt == 0) {
+        pj_list_erase(flt);
+        pj_pool_release(flt->pool);
+    }
+    pj_leave_critical_section();
+}
+
+/* Set up the polyphase resampler for the session. On failure, the
+ * session keeps using the libresample routines.
+ */
+static pj_status_t poly_init(pj_pool_t *pool,
+                             pjmedia_resample *resample,
+                             unsigned rate_in,
+                             unsigned rate_out)
+{
+    unsigned g, mono_frame, delay, i;
+    poly_filter *flt;
+    pj_status_t status;
+
+    /* The frame must produce a whole number of output samples, so that
+     * every frame starts at filter phase zero.
+     */
+    g = poly_gcd(rate_in, rate_out);
+    mono_frame = resample->frame_size / resample->channel_cnt;
+    if ((mono_frame * (rate_out / g)) % (rate_in / g) != 0)
+        return PJ_EINVAL;
+
+    status = poly_filter_get(pool->factory, rate_in, rate_out,
+                             resample->large_filter, &flt);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* Keep the libresample delay, unless the filter needs more lookahead
+     * (the clamping of xoff for small frames is not needed here).
+     */
+    delay = res_GetXOFF(resample->factor, (char)resample->large_filter);
+    if (delay < flt->half)
+        delay = flt->half;
+
+    resample->poly = flt;
+    resample->poly_hist = delay + flt->half - 1;
+    resample->poly_buf = (float**)
+                         pj_pool_calloc(pool, resample->channel_cnt,
+                                        sizeof(float*));
+    for (i = 0; i < resample->channel_cnt; ++i) {
+        resample->poly_buf[i] = (float*)
+                                pj_pool_calloc(pool,
+                                               resample->poly_hist +
+                                               mono_frame + POLY_GUARD,
+                                               sizeof(float));
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Filter one output sample */
+static float poly_dot(const float *x, const float *h, unsigned taps)
+{
+    unsigned i;
+
+#if defined(POLY_HAS_SSE)
+    __m128 acc = _mm_setzero_ps();
+
+    for (i = 0; i < taps; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + i),
+                                         _mm_load_ps(h + i)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+
+#elif defined(POLY_HAS_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    float32x2_t sum;
+
+    for (i = 0; i < taps; i += 4)
+        acc = vmlaq_f32(acc, vld1q_f32(x + i), vld1q_f32(h + i));
+    sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+
+#else
+    float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+
+    for (i = 0; i < taps; i += 4) {
+        acc0 += x[i] * h[i];
+        acc1 += x[i+1] * h[i+1];
+        acc2 += x[i+2] * h[i+2];
+        acc3 += x[i+3] * h[i+3];
+    }
+    return (acc0 + acc1) + (acc2 + acc3);
+#endif
+}
+
+static void poly_run(pjmedia_resample *resample,
+                     const pj_int16_t *input,
+                     pj_int16_t *output)
+{
+    const poly_filter *flt = resample->poly;
+    unsigned cnt = resample->channel_cnt;
+    unsigned nx = resample->frame_size / cnt;
+    unsigned ny = nx * flt->L / flt->M;
+    unsigned step = flt->M / flt->L;
+    unsigned step_ph = flt->M % flt->L;
+    unsigned ch;
+
+    for (ch = 0; ch < cnt; ++ch) {
+        float *buf = resample->poly_buf[ch];
+        float *x = buf + resample->poly_hist;
+        const pj_int16_t *src = input + ch;
+        pj_int16_t *dst = output + ch;
+        unsigned i, pos = 0, ph = 0;
+
+        /* Append (and deinterleave) the frame after the history */
+        for (i = 0; i < nx; ++i, src += cnt)
+            x[i] = *src;
+
+        /* The first tap of output sample 0 is at the start of buf */
+        for (i = 0; i < ny; ++i, dst += cnt) {
+            float v = poly_dot(buf + pos, flt->coef + ph * flt->taps,
+                               flt->taps);
+
+            if (v >= 32767.0f)
+                *dst = 32767;
+            else if (v <= -32768.0f)
+                *dst = -32768;
+            else
+                *dst = (pj_int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+
+            pos += step;
+            ph += step_ph;
+            if (ph >= flt->L) {
+                ph -= flt->L;
+                ++pos;
+            }
+        }
+
+        /* Update history */
+        pj_memmove(buf, buf + nx, resample->poly_hist * sizeof(float));
+    }
+}
+
+#endif  /* PJMEDIA_RESAMPLE_HAS_POLYPHASE */
+
+
 PJ_DEF(pj_status_t) pjmedia_resample_create( pj_pool_t *pool,
                                              pj_bool_t high_quality,
                                              pj_bool_t large_filter,
@@ -84,6 +432,21 @@ PJ_DEF(pj_status_t) pjmedia_resample_create( pj_pool_t *pool,
     resample->channel_cnt = channel_count;
     resample->frame_size = samples_per_frame;
 
+#if PJMEDIA_RESAMPLE_HAS_POLYPHASE
+    if (high_quality && channel_count &&
+        poly_init(pool, resample, rate_in, rate_out) == PJ_SUCCESS)
+    {
+        *p_resample = resample;
+
+        PJ_LOG(5,(THIS_FILE, "resample created: polyphase, %s filter, "
+                             "%d phases x %d taps, in/out rate=%d/%d",
+                             (large_filter?"large":"small"),
+                             resample->poly->L, resample->poly->taps,
+                             rate_in, rate_out));
+        return PJ_SUCCESS;
+    }
+#endif
+
     if (high_quality) {
         /* This is a bug in xoff calculation, thanks Stephane Lussier
          * of Macadamian dot com.
@@ -213,6 +576,13 @@ PJ_DEF(void) pjmedia_resample_run( pjmedia_resample *resample,
      * and the next, ...
      *
      */
+#if PJMEDIA_RESAMPLE_HAS_POLYPHASE
+    if (resample->poly) {
+        poly_run(resample, input, output);
+        return;
+    }
+#endif
+
     if (resample->channel_cnt == 1) {
         pj_int16_t *dst_buf;
         const pj_int16_t *src_buf;
@@ -293,7 +663,14 @@ PJ_DEF(unsigned) pjmedia_resample_get_input_size(pjmedia_resample *resample)
 
 PJ_DEF(void) pjmedia_resample_destroy(pjmedia_resample *resample)
 {
+#if PJMEDIA_RESAMPLE_HAS_POLYPHASE
+    if (resample && resample->poly) {
+        poly_filter_release(resample->poly);
+        resample->poly = NULL;
+    }
+#else
     PJ_UNUSED_ARG(resample);
+#endif
 }
 
 
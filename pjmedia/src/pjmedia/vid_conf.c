@@ -47,6 +47,7 @@
 
 /* Forward declarations */
 typedef struct op_entry op_entry;
+typedef struct render_job render_job;
 
 /*
  * Conference bridge.
@@ -63,9 +64,41 @@ struct pjmedia_vid_conf
 
     op_entry             *op_queue;     /**< Queue of operations.           */
     op_entry             *op_queue_free;/**< Queue of free entries.         */
+
+    render_job           *jobs;         /**< Sinks to render in this tick.  */
+    unsigned              job_cnt;      /**< Number of jobs in this tick.   */
+    pj_atomic_t          *job_idx;      /**< Next job to be taken.          */
+    pj_thread_t         **workers;      /**< Render worker threads.         */
+    unsigned              worker_cnt;   /**< Number of worker threads.      */
+    pj_sem_t             *job_sem;      /**< Signals workers to render.     */
+    pj_sem_t             *done_sem;     /**< Signals worker has finished.   */
+    pj_bool_t             quitting;     /**< Workers should quit.           */
 };
 
 
+/*
+ * Scaled copy of a source frame. When several sinks render the same region
+ * of a source to the same size and format (e.g: all participants of a
+ * conference viewing the same layout), the source is scaled once into this
+ * buffer, and the buffer is then copied to each sink.
+ */
+typedef struct scaled_copy
+{
+    PJ_DECL_LIST_MEMBER(struct scaled_copy);
+    pj_pool_t           *pool;          /**< Pool.                          */
+    unsigned             ref_cnt;       /**< Number of render states.       */
+    pjmedia_rect         src_rect;      /**< Source region.                 */
+    pjmedia_format_id    fmt_id;        /**< Format ID of the copy.         */
+    pjmedia_rect_size    size;          /**< Size of the copy.              */
+    pjmedia_converter   *converter;     /**< Converter.                     */
+    void                *buf;           /**< Buffer of the copy.            */
+    pj_size_t            frm_size;      /**< Frame size of the copy.        */
+    pj_mutex_t          *mutex;         /**< Serialize rendering the copy.  */
+    pj_bool_t            valid;         /**< Buffer has been rendered?      */
+    pj_uint32_t          frame_seq;     /**< Source frame rendered.         */
+} scaled_copy;
+
+
 /*
  * Rendering state: converter, layout settings, etc.
  */
@@ -80,6 +113,7 @@ typedef struct render_state
     pjmedia_rect        dst_rect;       /**< Destination region.            */
 
     pjmedia_converter   *converter;     /**< Converter.                     */
+    scaled_copy         *scaled;        /**< Scaled copy of the source.     */
 
 } render_state;
 
@@ -100,6 +134,8 @@ typedef struct vconf_port
     pj_size_t            get_buf_size;  /**< Buffer size for get_frame().   */
     pj_size_t            get_frm_size;	/**< Frame size for get_frame().    */
     pj_bool_t            got_frame;     /**< Last get_frame() got frame?    */
+    pj_uint32_t          frame_seq;     /**< Sequence of the got frame.     */
+    scaled_copy          scaled_copies; /**< List of scaled copies.         */
     void                *put_buf;       /**< Buffer for put_frame().        */
     pj_size_t            put_buf_size;  /**< Buffer size for put_frame().   */
     pj_size_t            put_frm_size;	/**< Frame size for put_frame().    */
@@ -117,6 +153,17 @@ typedef struct vconf_port
 } vconf_port;
 
 
+/*
+ * Sink to be rendered on a clock tick.
+ */
+struct render_job
+{
+    vconf_port          *sink;          /**< The sink port.                 */
+    pj_bool_t            rendered;      /**< Any source frame rendered?     */
+    pj_bool_t            ts_incremented;/**< Sink ts_next updated already?  */
+};
+
+
 /* Prototypes */
 static void on_clock_tick(const pj_timestamp *ts, void *user_data);
 static pj_status_t render_src_frame(vconf_port *src, vconf_port *sink,
@@ -124,6 +171,7 @@ static pj_status_t render_src_frame(vconf_port *src, vconf_port *sink,
 static void update_render_state(pjmedia_vid_conf *vid_conf, vconf_port *cp);
 static void cleanup_render_state(vconf_port *cp,
                                  unsigned transmitter_idx);
+static int render_worker_thread(void *arg);
 
 
 /* As we don't hold mutex in the clock tick, some video conference operations
@@ -235,6 +283,7 @@ PJ_DEF(void) pjmedia_vid_conf_setting_default(pjmedia_vid_conf_setting *opt)
     pj_bzero(opt, sizeof(*opt));
     opt->max_slot_cnt = 32;
     opt->frame_rate = 60;
+    opt->worker_cnt = PJMEDIA_VID_CONF_WORKER_CNT;
 }
 
 
@@ -313,11 +362,61 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_create(
     pj_list_init(vid_conf->op_queue);
     pj_list_init(vid_conf->op_queue_free);
 
+    /* Allocate render jobs */
+    vid_conf->jobs = (render_job*)
+                     pj_pool_zalloc(pool, vid_conf->opt.max_slot_cnt *
+                                          sizeof(render_job));
+    if (!vid_conf->jobs) {
+        PJ_PERROR(1, (THIS_FILE, PJ_ENOMEM, "Create failed in alloc jobs"));
+        pjmedia_vid_conf_destroy(vid_conf);
+        return PJ_ENOMEM;
+    }
+
+    /* Create render worker threads */
+    if (vid_conf->opt.worker_cnt) {
+        unsigned i;
+
+        status = pj_atomic_create(pool, 0, &vid_conf->job_idx);
+        if (status == PJ_SUCCESS) {
+            status = pj_sem_create(pool, "vconf_job", 0,
+                                   vid_conf->opt.worker_cnt,
+                                   &vid_conf->job_sem);
+        }
+        if (status == PJ_SUCCESS) {
+            status = pj_sem_create(pool, "vconf_done", 0,
+                                   vid_conf->opt.worker_cnt,
+                                   &vid_conf->done_sem);
+        }
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(1, (THIS_FILE, status, "Create failed in create "
+                                             "worker sync objects"));
+            pjmedia_vid_conf_destroy(vid_conf);
+            return status;
+        }
+
+        vid_conf->workers = (pj_thread_t**)
+                            pj_pool_zalloc(pool, vid_conf->opt.worker_cnt *
+                                                 sizeof(pj_thread_t*));
+        for (i = 0; i < vid_conf->opt.worker_cnt; ++i) {
+            status = pj_thread_create(pool, "vconf_worker",
+                                      &render_worker_thread, vid_conf,
+                                      0, 0, &vid_conf->workers[i]);
+            if (status != PJ_SUCCESS) {
+                PJ_PERROR(1, (THIS_FILE, status, "Create failed in create "
+                                                 "worker thread"));
+                pjmedia_vid_conf_destroy(vid_conf);
+                return status;
+            }
+            ++vid_conf->worker_cnt;
+        }
+    }
+
     /* Done */
     *p_vid_conf = vid_conf;
 
-    PJ_LOG(4,(THIS_FILE, "Created video conference bridge with %d ports",
-              vid_conf->opt.max_slot_cnt));
+    PJ_LOG(4,(THIS_FILE, "Created video conference bridge with %d ports "
+              "and %d render worker(s)",
+              vid_conf->opt.max_slot_cnt, vid_conf->worker_cnt));
 
     return PJ_SUCCESS;
 }
@@ -340,6 +439,30 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_destroy(pjmedia_vid_conf *vid_conf)
         vid_conf->clock = NULL;
     }
 
+    /* Stop render worker threads */
+    if (vid_conf->worker_cnt) {
+        vid_conf->quitting = PJ_TRUE;
+        for (i=0; i < vid_conf->worker_cnt; ++i)
+            pj_sem_post(vid_conf->job_sem);
+        for (i=0; i < vid_conf->worker_cnt; ++i) {
+            pj_thread_join(vid_conf->workers[i]);
+            pj_thread_destroy(vid_conf->workers[i]);
+        }
+        vid_conf->worker_cnt = 0;
+    }
+    if (vid_conf->job_sem) {
+        pj_sem_destroy(vid_conf->job_sem);
+        vid_conf->job_sem = NULL;
+    }
+    if (vid_conf->done_sem) {
+        pj_sem_destroy(vid_conf->done_sem);
+        vid_conf->done_sem = NULL;
+    }
+    if (vid_conf->job_idx) {
+        pj_atomic_destroy(vid_conf->job_idx);
+        vid_conf->job_idx = NULL;
+    }
+
     /* Remove any registered ports (at least to cleanup their pool) */
     for (i=0; i < vid_conf->opt.max_slot_cnt; ++i) {
         if (vid_conf->ports[i]) {
@@ -429,6 +552,7 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_add_port( pjmedia_vid_conf *vid_conf,
     cport->format = port->info.fmt;
     cport->idx  = index;
     pj_strdup_with_null(pool, &cport->name, name);
+    pj_list_init(&cport->scaled_copies);
 
     /* Setup port's group lock if not yet */
     if (!port->grp_lock) {
@@ -1018,6 +1142,68 @@ static int cmp_size(const pjmedia_format *fmt1, const pjmedia_format *fmt2)
 }
 
 
+/* Render all source frames of a sink to the sink buffer. */
+static void render_sink(pjmedia_vid_conf *vid_conf, render_job *job)
+{
+    vconf_port *sink = job->sink;
+    unsigned j;
+    pj_status_t status;
+
+    for (j=0; j < sink->transmitter_cnt; ++j) {
+        vconf_port *src = vid_conf->ports[sink->transmitter_slots[j]];
+
+        if (!src->got_frame)
+            continue;
+
+        /* Render src get buffer to sink put buffer (based on
+         * sink layout settings, if any)
+         */
+        status = render_src_frame(src, sink, j);
+        if (status == PJ_SUCCESS) {
+            job->rendered = PJ_TRUE;
+        } else {
+            PJ_PERROR(5, (THIS_FILE, status,
+                          "Failed to render frame from port %d [%s] "
+                          "to port %d [%s]",
+                          src->idx, src->port->info.name.ptr,
+                          sink->idx, sink->port->info.name.ptr));
+        }
+    }
+}
+
+
+/* Take and render sinks from the job list until none is left. */
+static void run_render_jobs(pjmedia_vid_conf *vid_conf)
+{
+    for (;;) {
+        pj_atomic_value_t idx = pj_atomic_inc_and_get(vid_conf->job_idx) - 1;
+
+        if (idx >= (pj_atomic_value_t)vid_conf->job_cnt)
+            break;
+
+        render_sink(vid_conf, &vid_conf->jobs[idx]);
+    }
+}
+
+
+/* Render worker thread. */
+static int render_worker_thread(void *arg)
+{
+    pjmedia_vid_conf *vid_conf = (pjmedia_vid_conf*)arg;
+
+    for (;;) {
+        pj_sem_wait(vid_conf->job_sem);
+        if (vid_conf->quitting)
+            break;
+
+        run_render_jobs(vid_conf);
+        pj_sem_post(vid_conf->done_sem);
+    }
+
+    return 0;
+}
+
+
 static void on_clock_tick(const pj_timestamp *now, void *user_data)
 {
     pjmedia_vid_conf *vid_conf = (pjmedia_vid_conf*)user_data;
@@ -1042,15 +1228,22 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
      * must not be changed when the execution reaches this point, so
      * operations that change the states must be queued or sync-ed with
      * the clock.
+     *
+     * The tick is processed in three steps:
+     * 1. get frames from the sources of the sinks that are due,
+     * 2. render the sinks, possibly in parallel with the worker threads,
+     * 3. put frames to the sinks.
+     * Only the rendering step may run in parallel, it only reads the
+     * source buffers and writes to the buffer of the sink being rendered.
      */
+    vid_conf->job_cnt = 0;
 
     /* Iterate all (sink) ports */
     for (i=0, ci=0; i<vid_conf->opt.max_slot_cnt &&
                     ci<vid_conf->port_cnt; ++i)
     {
         unsigned j;
-        pj_bool_t frame_rendered = PJ_FALSE;
-        pj_bool_t ts_incremented = PJ_FALSE;
+        render_job *job;
         vconf_port *sink = vid_conf->ports[i];
         pjmedia_format *cur_fmt, *new_fmt;
 
@@ -1087,6 +1280,11 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
             op_update_port(vid_conf, &prm);
         }
 
+        job = &vid_conf->jobs[vid_conf->job_cnt++];
+        job->sink = sink;
+        job->rendered = PJ_FALSE;
+        job->ts_incremented = PJ_FALSE;
+
         /* Iterate transmitters of this sink port */
         for (j=0; j < sink->transmitter_cnt; ++j) {
             vconf_port *src = vid_conf->ports[sink->transmitter_slots[j]];
@@ -1117,6 +1315,7 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
                     src->got_frame = PJ_FALSE;
                 } else {
                     src->got_frame = (frame.size == src->get_frm_size);
+                    ++src->frame_seq;
 
                     /* There is a possibility that the source port's format has
                      * changed, but we haven't received the event yet.
@@ -1134,25 +1333,34 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
 
                 /* Update next src put/get */
                 pj_add_timestamp32(&src->ts_next, src->ts_interval);
-                ts_incremented = src==sink;
-            }
-
-            if (src->got_frame) {
-                /* Render src get buffer to sink put buffer (based on
-                 * sink layout settings, if any)
-                 */
-                status = render_src_frame(src, sink, j);
-                if (status == PJ_SUCCESS) {
-                    frame_rendered = PJ_TRUE;
-                } else {
-                    PJ_PERROR(5, (THIS_FILE, status,
-                                  "Failed to render frame from port %d [%s] "
-                                  "to port %d [%s]",
-                                  src->idx, src->port->info.name.ptr,
-                                  sink->idx, sink->port->info.name.ptr));
-                }
+                if (src == sink)
+                    job->ts_incremented = PJ_TRUE;
             }
         }
+    }
+
+    /* Render the sinks */
+    if (vid_conf->worker_cnt && vid_conf->job_cnt > 1) {
+        unsigned wcnt = PJ_MIN(vid_conf->worker_cnt, vid_conf->job_cnt - 1);
+
+        pj_atomic_set(vid_conf->job_idx, 0);
+        for (i=0; i < wcnt; ++i)
+            pj_sem_post(vid_conf->job_sem);
+
+        /* The clock thread renders too */
+        run_render_jobs(vid_conf);
+
+        for (i=0; i < wcnt; ++i)
+            pj_sem_wait(vid_conf->done_sem);
+    } else {
+        for (i=0; i < vid_conf->job_cnt; ++i)
+            render_sink(vid_conf, &vid_conf->jobs[i]);
+    }
+
+    /* Put frames to the sinks */
+    for (i=0; i < vid_conf->job_cnt; ++i) {
+        render_job *job = &vid_conf->jobs[i];
+        vconf_port *sink = job->sink;
 
         /* Call sink->put_frame()
          * Note that if transmitter_cnt==0, we should still call put_frame()
@@ -1162,12 +1370,12 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
         pj_bzero(&frame, sizeof(frame));
         frame.type = PJMEDIA_FRAME_TYPE_VIDEO;
         frame.timestamp = *now;
-        if (frame_rendered) {
+        if (job->rendered) {
             frame.buf = sink->put_buf;
             frame.size = sink->put_frm_size;
         }
         status = pjmedia_port_put_frame(sink->port, &frame);
-        if (frame_rendered && status != PJ_SUCCESS) {
+        if (job->rendered && status != PJ_SUCCESS) {
             sink->last_err_cnt++;
             if (sink->last_err != status ||
                 sink->last_err_cnt % MAX_ERR_COUNT == 0)
@@ -1188,7 +1396,7 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
         /* Update next put/get, careful that it may have been updated
          * if this port transmits to itself!
          */
-        if (!ts_incremented) {
+        if (!job->ts_incremented) {
             pj_add_timestamp32(&sink->ts_next, sink->ts_interval);
         }
     }
@@ -1221,6 +1429,113 @@ static void match_ratio_crop(pjmedia_rect_size *size,
     return;
 }
 
+/* Get a scaled copy of the source for the render state, the copy is shared
+ * by all render states (of different sinks) that render the same source
+ * region to the same size and format.
+ */
+static scaled_copy* acquire_scaled_copy(vconf_port *src,
+                                        const render_state *rs)
+{
+    scaled_copy *sc;
+    pj_status_t status;
+
+    for (sc = src->scaled_copies.next; sc != &src->scaled_copies;
+         sc = sc->next)
+    {
+        if (sc->fmt_id == rs->dst_fmt_id &&
+            sc->size.w == rs->dst_rect.size.w &&
+            sc->size.h == rs->dst_rect.size.h &&
+            sc->src_rect.coord.x == rs->src_rect.coord.x &&
+            sc->src_rect.coord.y == rs->src_rect.coord.y &&
+            sc->src_rect.size.w == rs->src_rect.size.w &&
+            sc->src_rect.size.h == rs->src_rect.size.h)
+        {
+            break;
+        }
+    }
+
+    if (sc == &src->scaled_copies) {
+        pj_pool_t *pool;
+
+        pool = pj_pool_create(src->pool->factory, "vcport_sc", 256, 256,
+                              NULL);
+        if (!pool)
+            return NULL;
+
+        sc = PJ_POOL_ZALLOC_T(pool, scaled_copy);
+        sc->pool = pool;
+        sc->src_rect = rs->src_rect;
+        sc->fmt_id = rs->dst_fmt_id;
+        sc->size = rs->dst_rect.size;
+        pj_list_push_back(&src->scaled_copies, sc);
+    }
+
+    ++sc->ref_cnt;
+
+    /* Only setup the buffer and converter once the copy is shared */
+    if (sc->ref_cnt == 2 && !sc->converter) {
+        const pjmedia_video_format_info *vfi;
+        pjmedia_video_apply_fmt_param vafp;
+        pjmedia_conversion_param cparam;
+
+        vfi = pjmedia_get_video_format_info(NULL, sc->fmt_id);
+        if (!vfi)
+            return sc;
+
+        pj_bzero(&vafp, sizeof(vafp));
+        vafp.size = sc->size;
+        status = (*vfi->apply_fmt)(vfi, &vafp);
+        if (status != PJ_SUCCESS)
+            return sc;
+
+        sc->frm_size = vafp.framebytes;
+        sc->buf = pj_pool_alloc(sc->pool, sc->frm_size);
+
+        status = pj_mutex_create_simple(sc->pool, "vcport_sc", &sc->mutex);
+        if (status != PJ_SUCCESS)
+            return sc;
+
+        pjmedia_format_init_video(&cparam.src, rs->src_fmt_id,
+                                  sc->src_rect.size.w, sc->src_rect.size.h,
+                                  0, 1);
+        pjmedia_format_init_video(&cparam.dst, sc->fmt_id,
+                                  sc->size.w, sc->size.h, 0, 1);
+        status = pjmedia_converter_create(NULL, sc->pool, &cparam,
+                                          &sc->converter);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(4,(THIS_FILE, status,
+                         "Port %d failed creating shared converter",
+                         src->idx));
+        }
+
+        TRACE_((THIS_FILE, "Port %d shares scaled copy %dx%d",
+                src->idx, sc->size.w, sc->size.h));
+    }
+
+    return sc;
+}
+
+
+/* Release a scaled copy acquired by acquire_scaled_copy(). */
+static void release_scaled_copy(scaled_copy *sc)
+{
+    pj_assert(sc->ref_cnt > 0);
+    if (--sc->ref_cnt)
+        return;
+
+    pj_list_erase(sc);
+    if (sc->converter) {
+        pjmedia_converter_destroy(sc->converter);
+        sc->converter = NULL;
+    }
+    if (sc->mutex) {
+        pj_mutex_destroy(sc->mutex);
+        sc->mutex = NULL;
+    }
+    pj_pool_safe_release(&sc->pool);
+}
+
+
 /* Cleanup rendering states, called when a transmitter is disconnected
  * from a listener, or before reinit-ing rendering state of a listener
  * when new connection has just been made.
@@ -1234,6 +1549,11 @@ static void cleanup_render_state(vconf_port *cp,
         pjmedia_converter_destroy(rs->converter);
         rs->converter = NULL;
     }
+    if (rs && rs->scaled)
+    {
+        release_scaled_copy(rs->scaled);
+        rs->scaled = NULL;
+    }
     cp->render_states[transmitter_idx] = NULL;
 
     if (cp->render_pool[transmitter_idx]) {
@@ -1429,9 +1749,73 @@ static void update_render_state(pjmedia_vid_conf *vid_conf, vconf_port *cp)
                          "Port %d failed creating converter "
                          "for source %d", cp->idx, i));
         }
+
+        /* Scaled copy of the source, shared with other sinks (if any) */
+        rs->scaled = acquire_scaled_copy(
+                            vid_conf->ports[cp->transmitter_slots[i]], rs);
     }
 }
 
+
+/* Copy a scaled copy to a region of the sink buffer. */
+static pj_status_t copy_scaled_frame(const scaled_copy *sc,
+                                     vconf_port *sink,
+                                     const render_state *rs)
+{
+    const pjmedia_video_format_info *vfi;
+    pjmedia_video_apply_fmt_param src_vafp, dst_vafp;
+    unsigned i;
+
+    vfi = pjmedia_get_video_format_info(NULL, sc->fmt_id);
+    if (!vfi)
+        return PJMEDIA_EBADFMT;
+
+    pj_bzero(&src_vafp, sizeof(src_vafp));
+    src_vafp.size = sc->size;
+    src_vafp.buffer = (pj_uint8_t*)sc->buf;
+    (*vfi->apply_fmt)(vfi, &src_vafp);
+
+    pj_bzero(&dst_vafp, sizeof(dst_vafp));
+    dst_vafp.size = rs->dst_frame_size;
+    dst_vafp.buffer = (pj_uint8_t*)sink->put_buf;
+    (*vfi->apply_fmt)(vfi, &dst_vafp);
+    if (dst_vafp.framebytes > sink->put_frm_size)
+        return PJMEDIA_EVID_BADFORMAT;
+
+    /* Copy plane by plane, the region offset is calculated the same way
+     * as the converter does.
+     */
+    for (i = 0; i < vfi->plane_cnt; ++i) {
+        unsigned src_rows = (unsigned)(src_vafp.plane_bytes[i] /
+                                       src_vafp.strides[i]);
+        unsigned dst_rows = (unsigned)(dst_vafp.plane_bytes[i] /
+                                       dst_vafp.strides[i]);
+        unsigned y = rs->dst_rect.coord.y * dst_rows / dst_vafp.size.h;
+        unsigned x = rs->dst_rect.coord.x * dst_vafp.strides[i] /
+                     dst_vafp.size.w;
+        unsigned row_len = src_vafp.strides[i];
+        const pj_uint8_t *src_row = src_vafp.planes[i];
+        pj_uint8_t *dst_row = dst_vafp.planes[i] +
+                              y * dst_vafp.strides[i] + x;
+        unsigned r;
+
+        if (y >= dst_rows || x >= (unsigned)dst_vafp.strides[i])
+            continue;
+        if (row_len > dst_vafp.strides[i] - x)
+            row_len = dst_vafp.strides[i] - x;
+        if (src_rows > dst_rows - y)
+            src_rows = dst_rows - y;
+
+        for (r = 0; r < src_rows; ++r) {
+            pj_memcpy(dst_row, src_row, row_len);
+            src_row += src_vafp.strides[i];
+            dst_row += dst_vafp.strides[i];
+        }
+    }
+
+    return PJ_SUCCESS;
+}
+
 /* Render frame from source to sink buffer based on rendering settings. */
 static pj_status_t render_src_frame(vconf_port *src, vconf_port *sink,
                                     unsigned transmitter_idx)
@@ -1453,6 +1837,50 @@ static pj_status_t render_src_frame(vconf_port *src, vconf_port *sink,
         if (src->get_frm_size != sink->put_frm_size)
             return PJMEDIA_EVID_BADFORMAT;
         pj_memcpy(sink->put_buf, src->get_buf, src->get_frm_size);
+    } else if (rs && rs->scaled && rs->scaled->ref_cnt > 1 &&
+               rs->scaled->converter)
+    {
+        /* Scale the source once for all sinks sharing the copy, the sinks
+         * may be rendered in parallel by the worker threads.
+         */
+        scaled_copy *sc = rs->scaled;
+
+        pj_mutex_lock(sc->mutex);
+        if (!sc->valid || sc->frame_seq != src->frame_seq) {
+            pjmedia_frame src_frame, dst_frame;
+            pjmedia_coord dst_pos = {0, 0};
+
+            pj_bzero(&src_frame, sizeof(src_frame));
+            src_frame.buf = src->get_buf;
+            src_frame.size = src->get_frm_size;
+
+            pj_bzero(&dst_frame, sizeof(dst_frame));
+            dst_frame.buf = sc->buf;
+            dst_frame.size = sc->frm_size;
+
+            status = pjmedia_converter_convert2(sc->converter,
+                                                &src_frame,
+                                                &rs->src_frame_size,
+                                                &rs->src_rect.coord,
+                                                &dst_frame,
+                                                &sc->size,
+                                                &dst_pos,
+                                                NULL);
+            sc->valid = (status == PJ_SUCCESS);
+            sc->frame_seq = src->frame_seq;
+        } else {
+            status = PJ_SUCCESS;
+        }
+        pj_mutex_unlock(sc->mutex);
+
+        if (status == PJ_SUCCESS && sc->valid)
+            status = copy_scaled_frame(sc, sink, rs);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(4,(THIS_FILE, status,
+                         "Port id %d: failed in rendering scaled copy "
+                         "of port id %d", sink->idx, src->idx));
+            return status;
+        }
     } else if (rs && rs->converter) {
         pjmedia_frame src_frame, dst_frame;
         
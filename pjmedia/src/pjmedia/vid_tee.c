@@ -379,9 +379,16 @@ static pj_status_t tee_get_frame(pjmedia_port *port, pjmedia_frame *frame)
 static pj_status_t tee_destroy(pjmedia_port *port)
 {
     vid_tee_port *tee = (vid_tee_port*)port;
+    unsigned i;
 
     PJ_ASSERT_RETURN(port && port->info.signature==TEE_PORT_SIGN, PJ_EINVAL);
 
+    /* Converters may be cached by the converter manager, release them */
+    for (i = 0; i < tee->dst_port_cnt; ++i) {
+        if (tee->tee_conv[i].conv)
+            pjmedia_converter_destroy(tee->tee_conv[i].conv);
+    }
+
     pj_pool_release(tee->pool);
     if (tee->buf_pool)
         pj_pool_release(tee->buf_pool);
@@ -41,6 +41,20 @@
 #   define PJMEDIA_WSOLA_LINEAR_WIN    (!PJ_HAS_FLOATING_POINT)
 #endif
 
+/*
+ * SIMD support for the waveform similarity search.
+ */
+#if PJMEDIA_WSOLA_HAS_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       include <emmintrin.h>
+#       define WSOLA_HAS_SSE2   1
+#   elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#       include <arm_neon.h>
+#       define WSOLA_HAS_NEON   1
+#   endif
+#endif
+
 
 #if 0
 #   define TRACE_(x)    PJ_LOG(4,x)
@@ -55,6 +69,105 @@
 #endif
 
 
+/*
+ * Correlation of two blocks of samples. This is the inner loop of the
+ * waveform similarity search, and is shared by the floating and fixed
+ * point versions since the integer result is exact (and faster to
+ * compute with SIMD than the floating point products).
+ *
+ * Each product fits in 32 bits, but a sum of two products may not
+ * (2 * -32768 * -32768 = 2^31), so sums are accumulated in 64 bits.
+ */
+static pj_int64_t correlate_scalar(const pj_int16_t *frm,
+                                   const pj_int16_t *sr,
+                                   unsigned count)
+{
+    pj_int64_t corr = 0;
+    unsigned i = 0;
+
+    /* Do calculation on 8 samples at once */
+    for (; i + 8 <= count; i += 8) {
+        corr += (pj_int64_t)(((int)frm[i+0]) * ((int)sr[i+0])) +
+                (pj_int64_t)(((int)frm[i+1]) * ((int)sr[i+1])) +
+                (pj_int64_t)(((int)frm[i+2]) * ((int)sr[i+2])) +
+                (pj_int64_t)(((int)frm[i+3]) * ((int)sr[i+3])) +
+                (pj_int64_t)(((int)frm[i+4]) * ((int)sr[i+4])) +
+                (pj_int64_t)(((int)frm[i+5]) * ((int)sr[i+5])) +
+                (pj_int64_t)(((int)frm[i+6]) * ((int)sr[i+6])) +
+                (pj_int64_t)(((int)frm[i+7]) * ((int)sr[i+7]));
+    }
+
+    /* Process remaining samples. */
+    for (; i < count; ++i) {
+        corr += ((int)frm[i]) * ((int)sr[i]);
+    }
+
+    return corr;
+}
+
+#if defined(WSOLA_HAS_SSE2) || defined(WSOLA_HAS_NEON)
+static pj_int64_t correlate(const pj_int16_t *frm, const pj_int16_t *sr,
+                            unsigned count)
+{
+    pj_int64_t corr;
+    unsigned i = 0;
+
+#if defined(WSOLA_HAS_SSE2)
+    /* Each 32bit lane of pmaddwd holds the sum of two products. The sum
+     * only overflows when all four samples are -32768, and the lane then
+     * wraps to exactly INT32_MIN (which no other inputs produce), so such
+     * lanes are zero extended to +2^31 instead of sign extended.
+     */
+    const __m128i int_min = _mm_set1_epi32((int)0x80000000);
+    __m128i acc = _mm_setzero_si128();
+    pj_int64_t lanes[2];
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i p, sign;
+
+        p = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(frm + i)),
+                           _mm_loadu_si128((const __m128i*)(sr + i)));
+        sign = _mm_andnot_si128(_mm_cmpeq_epi32(p, int_min),
+                                _mm_srai_epi32(p, 31));
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(p, sign));
+    }
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    corr = lanes[0] + lanes[1];
+
+#else
+    /* Products are widened to 32 bits and pairwise added into 64 bits */
+    int64x2_t acc = vdupq_n_s64(0);
+
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t a = vld1q_s16(frm + i);
+        int16x8_t b = vld1q_s16(sr + i);
+
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(a), vget_low_s16(b)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(a),
+                                         vget_high_s16(b)));
+    }
+    corr = vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+#endif
+
+    /* Process remaining samples. */
+    return corr + correlate_scalar(frm + i, sr + i, count - i);
+}
+#else
+#   define correlate    correlate_scalar
+#endif
+
+
+PJ_DEF(pj_int64_t) pjmedia_wsola_correlate(const pj_int16_t frm[],
+                                           const pj_int16_t sr[],
+                                           unsigned count,
+                                           pj_bool_t use_simd)
+{
+    return use_simd ? correlate(frm, sr, count) :
+                      correlate_scalar(frm, sr, count);
+}
+
+
 #if (PJMEDIA_WSOLA_IMP==PJMEDIA_WSOLA_IMP_WSOLA) || \
     (PJMEDIA_WSOLA_IMP==PJMEDIA_WSOLA_IMP_WSOLA_LITE)
 
@@ -216,39 +329,16 @@ static pj_int16_t *find_pitch(pj_int16_t *frm, pj_int16_t *beg, pj_int16_t *end,
 
 #endif
 
-#if defined(PJ_HAS_FLOATING_POINT) && PJ_HAS_FLOATING_POINT!=0
-/*
- * Floating point version.
- */
-
 #if (PJMEDIA_WSOLA_IMP==PJMEDIA_WSOLA_IMP_WSOLA)
 
 static pj_int16_t *find_pitch(pj_int16_t *frm, pj_int16_t *beg, pj_int16_t *end, 
                          unsigned template_cnt, int first)
 {
     pj_int16_t *sr, *best=beg;
-    double best_corr = 0;
+    pj_int64_t best_corr = 0;
 
     for (sr=beg; sr!=end; ++sr) {
-        double corr = 0;
-        unsigned i;
-
-        /* Do calculation on 8 samples at once */
-        for (i=0; i<template_cnt-8; i += 8) {
-            corr += ((float)frm[i+0]) * ((float)sr[i+0]) + 
-                    ((float)frm[i+1]) * ((float)sr[i+1]) + 
-                    ((float)frm[i+2]) * ((float)sr[i+2]) + 
-                    ((float)frm[i+3]) * ((float)sr[i+3]) + 
-                    ((float)frm[i+4]) * ((float)sr[i+4]) + 
-                    ((float)frm[i+5]) * ((float)sr[i+5]) + 
-                    ((float)frm[i+6]) * ((float)sr[i+6]) + 
-                    ((float)frm[i+7]) * ((float)sr[i+7]);
-        }
-
-        /* Process remaining samples. */
-        for (; i<template_cnt; ++i) {
-            corr += ((double)frm[i]) * ((float)sr[i]);
-        }
+        pj_int64_t corr = correlate(frm, sr, template_cnt);
 
         if (first) {
             if (corr > best_corr) {
@@ -269,6 +359,12 @@ static pj_int16_t *find_pitch(pj_int16_t *frm, pj_int16_t *beg, pj_int16_t *end,
 
 #endif
 
+#if defined(PJ_HAS_FLOATING_POINT) && PJ_HAS_FLOATING_POINT!=0
+/*
+ * Floating point version.
+ */
+
+
 static void overlapp_add(pj_int16_t dst[], unsigned count,
                          pj_int16_t l[], pj_int16_t r[],
                          float w[])
@@ -311,54 +407,6 @@ static void create_win(pj_pool_t *pool, float **pw, unsigned count)
 #define WINDOW_BITS     15
 enum { WINDOW_MAX_VAL = (1 << WINDOW_BITS)-1 };
 
-#if (PJMEDIA_WSOLA_IMP==PJMEDIA_WSOLA_IMP_WSOLA)
-
-static pj_int16_t *find_pitch(pj_int16_t *frm, pj_int16_t *beg, pj_int16_t *end, 
-                         unsigned template_cnt, int first)
-{
-    pj_int16_t *sr, *best=beg;
-    pj_int64_t best_corr = 0;
-
-    
-    for (sr=beg; sr!=end; ++sr) {
-        pj_int64_t corr = 0;
-        unsigned i;
-
-        /* Do calculation on 8 samples at once */
-        for (i=0; i<template_cnt-8; i+=8) {
-            corr += ((int)frm[i+0]) * ((int)sr[i+0]) + 
-                    ((int)frm[i+1]) * ((int)sr[i+1]) + 
-                    ((int)frm[i+2]) * ((int)sr[i+2]) +
-                    ((int)frm[i+3]) * ((int)sr[i+3]) +
-                    ((int)frm[i+4]) * ((int)sr[i+4]) +
-                    ((int)frm[i+5]) * ((int)sr[i+5]) +
-                    ((int)frm[i+6]) * ((int)sr[i+6]) +
-                    ((int)frm[i+7]) * ((int)sr[i+7]);
-        }
-
-        /* Process remaining samples. */
-        for (; i<template_cnt; ++i) {
-            corr += ((int)frm[i]) * ((int)sr[i]);
-        }
-
-        if (first) {
-            if (corr > best_corr) {
-                best_corr = corr;
-                best = sr;
-            }
-        } else {
-            if (corr >= best_corr) {
-                best_corr = corr;
-                best = sr;
-            }
-        }
-    }
-
-    /*TRACE_((THIS_FILE, "found pitch at %u", best-beg));*/
-    return best;
-}
-
-#endif
 
 
 static void overlapp_add(pj_int16_t dst[], unsigned count,
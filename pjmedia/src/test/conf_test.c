@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "conf_test.c"
+
+#if !defined(PJMEDIA_CONF_USE_SWITCH_BOARD) || PJMEDIA_CONF_USE_SWITCH_BOARD==0
+
+#define CLOCK_RATE          8000
+#define SAMPLES_PER_FRAME   160
+#define SRC_CNT             4
+#define TICKS               10
+
+/* Source port generating a constant signal, and sink port keeping the
+ * last frame it received.
+ */
+struct test_port
+{
+    pjmedia_port    base;
+    pj_int16_t      value;
+    unsigned        put_cnt;
+    pj_int16_t      last[SAMPLES_PER_FRAME];
+};
+
+static pj_status_t src_get_frame(pjmedia_port *this_port,
+                                 pjmedia_frame *frame)
+{
+    struct test_port *port = (struct test_port*)this_port;
+    pj_int16_t *samples = (pj_int16_t*)frame->buf;
+    unsigned i;
+
+    for (i = 0; i < SAMPLES_PER_FRAME; ++i)
+        samples[i] = port->value;
+    frame->size = SAMPLES_PER_FRAME * 2;
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t sink_put_frame(pjmedia_port *this_port,
+                                  pjmedia_frame *frame)
+{
+    struct test_port *port = (struct test_port*)this_port;
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO) {
+        pjmedia_copy_samples(port->last, (const pj_int16_t*)frame->buf,
+                             SAMPLES_PER_FRAME);
+    } else {
+        pjmedia_zero_samples(port->last, SAMPLES_PER_FRAME);
+    }
+    ++port->put_cnt;
+    return PJ_SUCCESS;
+}
+
+static struct test_port *create_port(pj_pool_t *pool, const char *name,
+                                     pj_int16_t value)
+{
+    struct test_port *port = PJ_POOL_ZALLOC_T(pool, struct test_port);
+    pj_str_t port_name;
+
+    pjmedia_port_info_init(&port->base.info, pj_cstr(&port_name, name),
+                           PJMEDIA_SIG_CLASS_PORT_AUD('T','C'), CLOCK_RATE,
+                           1, 16, SAMPLES_PER_FRAME);
+    port->base.get_frame = &src_get_frame;
+    port->base.put_frame = &sink_put_frame;
+    port->value = value;
+    return port;
+}
+
+/* Run the bridge for a few ticks, and check the signal at the sink */
+static int run_check(pjmedia_conf *conf, struct test_port *sink,
+                     pj_int16_t expected, const char *title)
+{
+    pj_int16_t buf[SAMPLES_PER_FRAME];
+    pjmedia_port *master = pjmedia_conf_get_master_port(conf);
+    unsigned i, put_cnt = sink->put_cnt;
+
+    for (i = 0; i < TICKS; ++i) {
+        pjmedia_frame frame;
+
+        pj_bzero(&frame, sizeof(frame));
+        frame.buf = buf;
+        frame.size = sizeof(buf);
+        frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        pjmedia_port_get_frame(master, &frame);
+    }
+
+    if (sink->put_cnt - put_cnt != TICKS) {
+        PJ_LOG(1,(THIS_FILE, "  %s: error: sink got %d frames, "
+                  "expecting %d", title, sink->put_cnt - put_cnt, TICKS));
+        return -1;
+    }
+    for (i = 0; i < SAMPLES_PER_FRAME; ++i) {
+        if (sink->last[i] != expected) {
+            PJ_LOG(1,(THIS_FILE, "  %s: error: sample %d is %d, "
+                      "expecting %d", title, i, sink->last[i], expected));
+            return -2;
+        }
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  %s: ok", title));
+    return 0;
+}
+
+/*
+ * Check which ports are mixed under the different mixing settings.
+ */
+static int mix_setting_test(pj_pool_t *pool)
+{
+    static const pj_int16_t values[SRC_CNT] = { 0, 1000, 2000, 4000 };
+    pjmedia_conf *conf;
+    pjmedia_conf_mix_setting setting;
+    struct test_port *sink;
+    unsigned sink_slot, i;
+    int rc = 0;
+    pj_status_t status;
+
+    status = pjmedia_conf_create(pool, SRC_CNT + 2, CLOCK_RATE, 1,
+                                 SAMPLES_PER_FRAME, 16,
+                                 PJMEDIA_CONF_NO_DEVICE, &conf);
+    if (status != PJ_SUCCESS)
+        return -10;
+
+    sink = create_port(pool, "sink", 0);
+    status = pjmedia_conf_add_port(conf, pool, &sink->base, NULL,
+                                   &sink_slot);
+    if (status != PJ_SUCCESS) {
+        rc = -20;
+        goto on_return;
+    }
+
+    for (i = 0; i < SRC_CNT; ++i) {
+        struct test_port *src = create_port(pool, "src", values[i]);
+        unsigned slot;
+
+        status = pjmedia_conf_add_port(conf, pool, &src->base, NULL, &slot);
+        if (status == PJ_SUCCESS)
+            status = pjmedia_conf_connect_port(conf, slot, sink_slot, 0);
+        if (status != PJ_SUCCESS) {
+            rc = -30;
+            goto on_return;
+        }
+    }
+
+    pjmedia_conf_get_mix_setting(conf, &setting);
+    if (setting.skip_silence || setting.max_speakers ||
+        setting.vad_threshold != -1)
+    {
+        rc = -40;
+        goto on_return;
+    }
+
+    /* Default: all ports are mixed (the silent one does not matter) */
+    rc = run_check(conf, sink, 7000, "mix all ports");
+    if (rc != 0) {
+        rc -= 50;
+        goto on_return;
+    }
+
+    /* Only the two loudest ports are mixed */
+    setting.max_speakers = 2;
+    pjmedia_conf_set_mix_setting(conf, &setting);
+    rc = run_check(conf, sink, 6000, "max_speakers=2");
+    if (rc != 0) {
+        rc -= 60;
+        goto on_return;
+    }
+
+    /* The digitally silent port must not take a speaker slot */
+    setting.max_speakers = 3;
+    pjmedia_conf_set_mix_setting(conf, &setting);
+    rc = run_check(conf, sink, 7000, "max_speakers=3");
+    if (rc != 0) {
+        rc -= 70;
+        goto on_return;
+    }
+
+    /* Ports below the silence threshold are left out */
+    setting.max_speakers = 0;
+    setting.skip_silence = PJ_TRUE;
+    setting.vad_threshold = 1500;
+    pjmedia_conf_set_mix_setting(conf, &setting);
+    rc = run_check(conf, sink, 6000, "skip_silence, threshold=1500");
+    if (rc != 0) {
+        rc -= 80;
+        goto on_return;
+    }
+
+    /* Both: the loudest non-silent port only */
+    setting.max_speakers = 1;
+    pjmedia_conf_set_mix_setting(conf, &setting);
+    rc = run_check(conf, sink, 4000, "skip_silence, max_speakers=1");
+    if (rc != 0) {
+        rc -= 90;
+        goto on_return;
+    }
+
+    /* Back to defaults */
+    pjmedia_conf_mix_setting_default(&setting);
+    pjmedia_conf_set_mix_setting(conf, &setting);
+    rc = run_check(conf, sink, 7000, "default setting");
+    if (rc != 0)
+        rc -= 100;
+
+on_return:
+    pjmedia_conf_destroy(conf);
+    return rc;
+}
+
+int conf_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, "conf_test", 4000, 4000, NULL);
+
+    PJ_LOG(3,(THIS_FILE, " conference mixing settings:"));
+    rc = mix_setting_test(pool);
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else   /* PJMEDIA_CONF_USE_SWITCH_BOARD */
+
+int conf_test(void)
+{
+    PJ_LOG(3,(THIS_FILE, " switchboard does not mix, test skipped"));
+    return 0;
+}
+
+#endif  /* PJMEDIA_CONF_USE_SWITCH_BOARD */
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjmedia/converter.h>
+
+#define THIS_FILE   "converter_test.c"
+
+/* Format only known to the dummy factory, so the converters are never
+ * created by the built-in backends of the manager.
+ */
+#define TEST_FMT_ID PJMEDIA_FORMAT_PACK('T','C','V','T')
+
+/* Dummy converter factory, counting the backend converter instances. */
+static unsigned create_cnt, destroy_cnt, convert_cnt;
+
+static pj_status_t dummy_convert(pjmedia_converter *cv,
+                                 pjmedia_frame *src_frame,
+                                 pjmedia_frame *dst_frame)
+{
+    PJ_UNUSED_ARG(cv);
+    PJ_UNUSED_ARG(src_frame);
+    PJ_UNUSED_ARG(dst_frame);
+    ++convert_cnt;
+    return PJ_SUCCESS;
+}
+
+static void dummy_destroy(pjmedia_converter *cv)
+{
+    PJ_UNUSED_ARG(cv);
+    ++destroy_cnt;
+}
+
+static pjmedia_converter_op dummy_op =
+{
+    &dummy_convert,
+    &dummy_destroy,
+    NULL
+};
+
+static pj_status_t dummy_create_converter(pjmedia_converter_factory *cf,
+                                          pj_pool_t *pool,
+                                          const pjmedia_conversion_param *prm,
+                                          pjmedia_converter **p_cv)
+{
+    pjmedia_converter *cv;
+
+    PJ_UNUSED_ARG(cf);
+    PJ_UNUSED_ARG(prm);
+
+    cv = PJ_POOL_ZALLOC_T(pool, pjmedia_converter);
+    cv->op = &dummy_op;
+    ++create_cnt;
+
+    *p_cv = cv;
+    return PJ_SUCCESS;
+}
+
+static void dummy_destroy_factory(pjmedia_converter_factory *cf)
+{
+    PJ_UNUSED_ARG(cf);
+}
+
+static pjmedia_converter_factory_op dummy_factory_op =
+{
+    &dummy_create_converter,
+    &dummy_destroy_factory
+};
+
+static void init_fmt(pjmedia_format *fmt, unsigned w, unsigned h,
+                     unsigned fps)
+{
+    pj_bzero(fmt, sizeof(*fmt));
+    fmt->id = TEST_FMT_ID;
+    fmt->type = PJMEDIA_TYPE_VIDEO;
+    fmt->detail_type = PJMEDIA_FORMAT_DETAIL_VIDEO;
+    fmt->det.vid.size.w = w;
+    fmt->det.vid.size.h = h;
+    fmt->det.vid.fps.num = fps;
+    fmt->det.vid.fps.denum = 1;
+}
+
+static void init_param(pjmedia_conversion_param *prm, unsigned w, unsigned h)
+{
+    init_fmt(&prm->src, 320, 240, 15);
+    init_fmt(&prm->dst, w, h, 30);
+}
+
+static int cache_test(pjmedia_converter_mgr *mgr, pj_pool_t *pool)
+{
+    pjmedia_converter_cache_stat stat;
+    pjmedia_conversion_param prm;
+    pjmedia_converter *cv[3], *cv2;
+    pj_pool_t *user_pool;
+    pjmedia_frame frm;
+    pj_status_t status;
+
+    pjmedia_converter_mgr_set_cache_size(mgr, 2);
+
+    /* First converter is created by the backend */
+    user_pool = pj_pool_create(mem, "convuser", 256, 256, NULL);
+    init_param(&prm, 640, 480);
+    status = pjmedia_converter_create(mgr, user_pool, &prm, &cv[0]);
+    if (status != PJ_SUCCESS)
+        return -10;
+
+    pj_bzero(&frm, sizeof(frm));
+    pjmedia_converter_convert(cv[0], &frm, &frm);
+    if (convert_cnt != 1)
+        return -20;
+    if (pjmedia_converter_convert2(cv[0], &frm, NULL, NULL, &frm, NULL, NULL,
+                                   NULL) != PJ_ENOTSUP)
+    {
+        return -30;
+    }
+
+    /* Once destroyed, the converter must outlive the creator's pool */
+    pjmedia_converter_destroy(cv[0]);
+    pj_pool_release(user_pool);
+    if (destroy_cnt != 0)
+        return -40;
+
+    /* Same formats and sizes, frame rate differs: reuse */
+    init_param(&prm, 640, 480);
+    prm.dst.det.vid.fps.num = 15;
+    status = pjmedia_converter_create(mgr, pool, &prm, &cv2);
+    if (status != PJ_SUCCESS || cv2 != cv[0] || create_cnt != 1)
+        return -50;
+    pjmedia_converter_convert(cv2, &frm, &frm);
+    if (convert_cnt != 2)
+        return -60;
+
+    /* Different sizes: new converters */
+    cv[0] = cv2;
+    init_param(&prm, 352, 288);
+    status = pjmedia_converter_create(mgr, pool, &prm, &cv[1]);
+    if (status != PJ_SUCCESS)
+        return -70;
+    init_param(&prm, 176, 144);
+    status = pjmedia_converter_create(mgr, pool, &prm, &cv[2]);
+    if (status != PJ_SUCCESS || create_cnt != 3)
+        return -80;
+
+    pjmedia_converter_mgr_get_cache_stat(mgr, &stat);
+    if (stat.busy_cnt != 3 || stat.idle_cnt != 0 || stat.hit_cnt != 1 ||
+        stat.miss_cnt != 3)
+    {
+        return -90;
+    }
+
+    /* Cache only keeps two of them */
+    pjmedia_converter_destroy(cv[0]);
+    pjmedia_converter_destroy(cv[1]);
+    pjmedia_converter_destroy(cv[2]);
+    pjmedia_converter_mgr_get_cache_stat(mgr, &stat);
+    if (stat.busy_cnt != 0 || stat.idle_cnt != 2 || stat.evict_cnt != 1 ||
+        destroy_cnt != 1)
+    {
+        return -100;
+    }
+
+    /* The least recently used one (640x480) was evicted */
+    init_param(&prm, 640, 480);
+    status = pjmedia_converter_create(mgr, pool, &prm, &cv2);
+    if (status != PJ_SUCCESS || create_cnt != 4)
+        return -110;
+    pjmedia_converter_destroy(cv2);
+
+    /* Disabling the cache destroys the idle converters */
+    pjmedia_converter_mgr_set_cache_size(mgr, 0);
+    pjmedia_converter_mgr_get_cache_stat(mgr, &stat);
+    if (stat.idle_cnt != 0 || destroy_cnt != create_cnt)
+        return -120;
+
+    /* With the cache disabled, the backend converter is used directly */
+    status = pjmedia_converter_create(mgr, pool, &prm, &cv2);
+    if (status != PJ_SUCCESS || cv2->op != &dummy_op)
+        return -130;
+    pjmedia_converter_destroy(cv2);
+
+    pjmedia_converter_mgr_get_cache_stat(mgr, &stat);
+    PJ_LOG(3,(THIS_FILE, "  cache: %d hit(s), %d miss(es), %d eviction(s)",
+              stat.hit_cnt, stat.miss_cnt, stat.evict_cnt));
+
+    return 0;
+}
+
+/* Idle converters are released by the manager, busy ones are detached
+ * from it and released when their owner destroys them.
+ */
+static int mgr_destroy_test(pjmedia_converter_factory *factory,
+                            pj_pool_t *pool)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)mem;
+    pjmedia_converter_mgr *mgr;
+    pjmedia_conversion_param prm;
+    pjmedia_converter *cv;
+    pjmedia_frame src, dst;
+    pj_size_t used_count;
+
+    used_count = cp->used_count;
+    create_cnt = destroy_cnt = 0;
+
+    pjmedia_converter_mgr_create(pool, &mgr);
+    pjmedia_converter_mgr_register_factory(mgr, factory);
+    pjmedia_converter_mgr_set_cache_size(mgr, 2);
+
+    /* One idle and one busy */
+    init_param(&prm, 640, 480);
+    if (pjmedia_converter_create(mgr, pool, &prm, &cv) != PJ_SUCCESS)
+        return -200;
+    pjmedia_converter_destroy(cv);
+    init_param(&prm, 352, 288);
+    if (pjmedia_converter_create(mgr, pool, &prm, &cv) != PJ_SUCCESS)
+        return -210;
+
+    pjmedia_converter_mgr_destroy(mgr);
+
+    if (create_cnt != 2 || destroy_cnt != 1)
+        return -220;
+
+    /* The busy converter is still usable after the manager is gone */
+    pj_bzero(&src, sizeof(src));
+    pj_bzero(&dst, sizeof(dst));
+    convert_cnt = 0;
+    if (pjmedia_converter_convert(cv, &src, &dst) != PJ_SUCCESS ||
+        convert_cnt != 1)
+    {
+        pjmedia_converter_destroy(cv);
+        return -230;
+    }
+
+    pjmedia_converter_destroy(cv);
+
+    if (destroy_cnt != 2)
+        return -240;
+    if (cp->used_count != used_count)
+        return -250;
+
+    return 0;
+}
+
+int converter_test(void)
+{
+    pjmedia_converter_factory factory;
+    pjmedia_converter_mgr *mgr;
+    pj_pool_t *pool;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, " converter cache test.."));
+
+    pool = pj_pool_create(mem, "convtest", 1000, 1000, NULL);
+
+#if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
+    /* Built-in converter factories look up the video format info */
+    pjmedia_video_format_mgr_create(pool, 64, 0, NULL);
+#endif
+
+    /* Use own manager. If there is no singleton yet, this manager will
+     * become the singleton until it is destroyed.
+     */
+    pjmedia_converter_mgr_create(pool, &mgr);
+
+    pj_bzero(&factory, sizeof(factory));
+    factory.name = "dummy";
+    factory.priority = PJMEDIA_CONVERTER_PRIORITY_NORMAL;
+    factory.op = &dummy_factory_op;
+    pjmedia_converter_mgr_register_factory(mgr, &factory);
+
+    rc = cache_test(mgr, pool);
+
+    pjmedia_converter_mgr_destroy(mgr);
+
+    if (rc == 0)
+        rc = mgr_destroy_test(&factory, pool);
+
+#if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
+    pjmedia_video_format_mgr_destroy(NULL);
+#endif
+    pj_pool_release(pool);
+
+    return rc;
+}
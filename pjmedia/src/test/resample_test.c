@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pj/math.h>
+
+#define THIS_FILE   "resample_test.c"
+
+#if PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_LIBRESAMPLE && \
+    PJMEDIA_RESAMPLE_HAS_POLYPHASE!=0
+
+#include <third_party/resample/include/resamplesubs.h>
+
+#define PTIME           20      /* Conference frame duration, in msec   */
+#define TEST_FRAMES     50      /* Frames to verify                     */
+#define BENCH_FRAMES    1000    /* Frames to run in the benchmark       */
+#define SHARE_CNT       32      /* Sessions to create for sharing test  */
+#define MIN_SNR_DB      40      /* Minimum polyphase vs scalar SNR      */
+
+static const struct rate_pair
+{
+    unsigned    rate_in;
+    unsigned    rate_out;
+} pairs[] =
+{
+    {  8000, 16000 },
+    { 16000,  8000 },
+    {  8000, 48000 },
+    { 48000,  8000 },
+    { 16000, 48000 },
+    { 48000, 16000 },
+};
+
+/* Reference resampler: libresample routine with the same history and
+ * lookahead handling as the scalar path of pjmedia_resample_run().
+ */
+typedef struct ref_resample
+{
+    double      factor;
+    unsigned    xoff;
+    unsigned    frame_size;
+    pj_int16_t *buffer;
+} ref_resample;
+
+static void ref_init(pj_pool_t *pool, ref_resample *ref,
+                     unsigned rate_in, unsigned rate_out,
+                     unsigned frame_size)
+{
+    ref->factor = rate_out * 1.0 / rate_in;
+    ref->xoff = res_GetXOFF(ref->factor, PJ_TRUE);
+    ref->frame_size = frame_size;
+    ref->buffer = (pj_int16_t*)
+                  pj_pool_zalloc(pool, (frame_size + ref->xoff * 2) *
+                                       sizeof(pj_int16_t));
+}
+
+static void ref_run(ref_resample *ref, const pj_int16_t *input,
+                    pj_int16_t *output)
+{
+    pjmedia_copy_samples(ref->buffer + ref->xoff * 2, input, ref->frame_size);
+    res_Resample(ref->buffer + ref->xoff, output, ref->factor,
+                 (pj_uint16_t)ref->frame_size, PJ_TRUE, PJ_TRUE);
+    pjmedia_copy_samples(ref->buffer, input + ref->frame_size - ref->xoff * 2,
+                         ref->xoff * 2);
+}
+
+/* Generate a frame of two tones */
+static void gen_frame(pj_int16_t *buf, unsigned count, unsigned rate,
+                      unsigned *phase)
+{
+    unsigned i;
+
+    for (i = 0; i < count; ++i, ++*phase) {
+        double t = *phase * 1.0 / rate;
+        buf[i] = (pj_int16_t)(8000 * sin(2 * PJ_PI * 440 * t) +
+                              4000 * sin(2 * PJ_PI * 1750 * t));
+    }
+}
+
+/* Compare polyphase output against the libresample routine. Note that
+ * libresample quantizes the output period to 15 fractional bits, so for
+ * ratios such as 1:6 its output drifts slightly within the frame while
+ * the polyphase filter phases are exact; hence the modest SNR threshold.
+ */
+static int verify_pair(pj_pool_t *pool, const struct rate_pair *pair)
+{
+    unsigned in_cnt = pair->rate_in * PTIME / 1000;
+    unsigned out_cnt = pair->rate_out * PTIME / 1000;
+    pj_int16_t *in_frm, *out_frm, *ref_frm;
+    pjmedia_resample *resample;
+    ref_resample ref;
+    double sig = 0, err = 0, snr;
+    unsigned i, j, phase = 0;
+    pj_status_t status;
+
+    in_frm = (pj_int16_t*)pj_pool_alloc(pool, in_cnt * sizeof(pj_int16_t));
+    out_frm = (pj_int16_t*)pj_pool_alloc(pool, out_cnt * sizeof(pj_int16_t));
+    ref_frm = (pj_int16_t*)pj_pool_alloc(pool, out_cnt * sizeof(pj_int16_t));
+
+    status = pjmedia_resample_create(pool, PJ_TRUE, PJ_TRUE, 1,
+                                     pair->rate_in, pair->rate_out,
+                                     in_cnt, &resample);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "  error creating resample");
+        return -10;
+    }
+    ref_init(pool, &ref, pair->rate_in, pair->rate_out, in_cnt);
+
+    for (i = 0; i < TEST_FRAMES; ++i) {
+        gen_frame(in_frm, in_cnt, pair->rate_in, &phase);
+        pjmedia_resample_run(resample, in_frm, out_frm);
+        ref_run(&ref, in_frm, ref_frm);
+
+        for (j = 0; j < out_cnt; ++j) {
+            double d = out_frm[j] - ref_frm[j];
+            sig += (double)ref_frm[j] * ref_frm[j];
+            err += d * d;
+        }
+    }
+    pjmedia_resample_destroy(resample);
+
+    snr = (err == 0) ? 999 : 10 * log10(sig / err);
+    PJ_LOG(3,(THIS_FILE, "  %5d -> %5d: SNR vs libresample %.1f dB",
+              pair->rate_in, pair->rate_out, snr));
+
+    if (snr < MIN_SNR_DB) {
+        PJ_LOG(1,(THIS_FILE, "  error: SNR too low"));
+        return -20;
+    }
+    return 0;
+}
+
+/* Sessions with the same parameters must share the coefficient table.
+ * The table is allocated from its own pool, so sharing is verified by
+ * counting the pools in use in the (caching pool) factory.
+ */
+static int share_test(pj_pool_t *pool)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)mem;
+    pjmedia_resample *resample[SHARE_CNT];
+    pj_size_t used_count;
+    pj_status_t status;
+    unsigned i;
+
+    used_count = cp->used_count;
+    for (i = 0; i < SHARE_CNT; ++i) {
+        status = pjmedia_resample_create(pool, PJ_TRUE, PJ_TRUE, 1, 8000,
+                                         48000, 160, &resample[i]);
+        if (status != PJ_SUCCESS)
+            return -30;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  %d sessions 8000 -> 48000 use %d filter "
+              "table(s)", SHARE_CNT, (int)(cp->used_count - used_count)));
+    if (cp->used_count != used_count + 1)
+        return -40;
+
+    for (i = 0; i < SHARE_CNT; ++i)
+        pjmedia_resample_destroy(resample[i]);
+
+    /* The table must be released with the last session */
+    if (cp->used_count != used_count)
+        return -50;
+
+    return 0;
+}
+
+/* Resample port must release the filter tables of both directions */
+static int port_test(pj_pool_t *pool)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)mem;
+    pjmedia_port *null_port, *rport;
+    pj_size_t used_count;
+    pj_status_t status;
+
+    status = pjmedia_null_port_create(pool, 16000, 1, 320, 16, &null_port);
+    if (status != PJ_SUCCESS)
+        return -70;
+
+    used_count = cp->used_count;
+    status = pjmedia_resample_port_create(pool, null_port, 8000, 0, &rport);
+    if (status != PJ_SUCCESS) {
+        pjmedia_port_destroy(null_port);
+        return -71;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  resample port 8000 <-> 16000 uses %d filter "
+              "table(s)", (int)(cp->used_count - used_count)));
+    if (cp->used_count != used_count + 2) {
+        pjmedia_port_destroy(rport);
+        return -72;
+    }
+
+    pjmedia_port_destroy(rport);
+    if (cp->used_count != used_count)
+        return -73;
+
+    return 0;
+}
+
+#if WITH_BENCHMARK
+/* Frame durations to benchmark, in msec */
+static const unsigned bench_ptimes[] = { 10, 20, 30 };
+
+static int bench_pair(pj_pool_t *pool, const struct rate_pair *pair,
+                      unsigned ptime)
+{
+    unsigned in_cnt = pair->rate_in * ptime / 1000;
+    unsigned out_cnt = pair->rate_out * ptime / 1000;
+    pj_int16_t *in_frm, *out_frm;
+    pjmedia_resample *resample;
+    ref_resample ref;
+    pj_timestamp t0, t1, t2;
+    pj_uint32_t poly_usec, ref_usec;
+    unsigned i, phase = 0;
+    pj_status_t status;
+
+    in_frm = (pj_int16_t*)pj_pool_alloc(pool, in_cnt * sizeof(pj_int16_t));
+    out_frm = (pj_int16_t*)pj_pool_alloc(pool, out_cnt * sizeof(pj_int16_t));
+    gen_frame(in_frm, in_cnt, pair->rate_in, &phase);
+
+    status = pjmedia_resample_create(pool, PJ_TRUE, PJ_TRUE, 1,
+                                     pair->rate_in, pair->rate_out,
+                                     in_cnt, &resample);
+    if (status != PJ_SUCCESS)
+        return -60;
+    ref_init(pool, &ref, pair->rate_in, pair->rate_out, in_cnt);
+
+    pj_get_timestamp(&t0);
+    for (i = 0; i < BENCH_FRAMES; ++i)
+        pjmedia_resample_run(resample, in_frm, out_frm);
+    pj_get_timestamp(&t1);
+    for (i = 0; i < BENCH_FRAMES; ++i)
+        ref_run(&ref, in_frm, out_frm);
+    pj_get_timestamp(&t2);
+
+    pjmedia_resample_destroy(resample);
+
+    poly_usec = pj_elapsed_usec(&t0, &t1);
+    ref_usec = pj_elapsed_usec(&t1, &t2);
+    PJ_LOG(3,(THIS_FILE, "  %5d -> %5d, %dms frame: polyphase %6.2f usec, "
+              "libresample %6.2f usec (x%.1f)",
+              pair->rate_in, pair->rate_out, ptime,
+              poly_usec * 1.0 / BENCH_FRAMES, ref_usec * 1.0 / BENCH_FRAMES,
+              poly_usec ? ref_usec * 1.0 / poly_usec : 0.0));
+    return 0;
+}
+#endif
+
+int resample_test(void)
+{
+    pj_pool_t *pool;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "resample_test", 4000, 4000, NULL);
+
+    PJ_LOG(3,(THIS_FILE, " verifying polyphase resampler:"));
+    for (i = 0; i < PJ_ARRAY_SIZE(pairs) && rc == 0; ++i)
+        rc = verify_pair(pool, &pairs[i]);
+
+    if (rc == 0)
+        rc = share_test(pool);
+
+    if (rc == 0)
+        rc = port_test(pool);
+
+#if WITH_BENCHMARK
+    if (rc == 0) {
+        unsigned j;
+
+        PJ_LOG(3,(THIS_FILE, " benchmarking (time per frame):"));
+        for (j = 0; j < PJ_ARRAY_SIZE(bench_ptimes) && rc == 0; ++j) {
+            for (i = 0; i < PJ_ARRAY_SIZE(pairs) && rc == 0; ++i)
+                rc = bench_pair(pool, &pairs[i], bench_ptimes[j]);
+        }
+    }
+#endif
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else   /* PJMEDIA_RESAMPLE_HAS_POLYPHASE */
+
+int resample_test(void)
+{
+    PJ_LOG(3,(THIS_FILE, " polyphase resampler is disabled, test skipped"));
+    return 0;
+}
+
+#endif  /* PJMEDIA_RESAMPLE_HAS_POLYPHASE */
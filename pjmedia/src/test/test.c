@@ -58,6 +58,9 @@ int test_main(void)
     int rc = 0;
     pj_caching_pool caching_pool;
     pj_pool_t *pool;
+#if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
+    pj_bool_t has_vid_mgr = PJ_FALSE;
+#endif
 
     pj_init();
     pj_caching_pool_init(&caching_pool, &pj_pool_factory_default_policy, 0);
@@ -71,16 +74,29 @@ int test_main(void)
 
     pjmedia_event_mgr_create(pool, 0, NULL);
 
+    /* Converter test creates its own converter managers, run it before
+     * the singleton is created as the built-in converter factories can
+     * only be registered to one manager at a time.
+     */
+#if HAS_CONVERTER_TEST
+    DO_TEST(converter_test());
+#endif
+
 #if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
     pjmedia_video_format_mgr_create(pool, 64, 0, NULL);
     pjmedia_converter_mgr_create(pool, NULL);
     pjmedia_vid_codec_mgr_create(pool, NULL);
+    has_vid_mgr = PJ_TRUE;
 #endif
 
 #if HAS_VID_PORT_TEST
     DO_TEST(vid_port_test());
 #endif
 
+#if HAS_VID_CONF_TEST
+    DO_TEST(vid_conf_test());
+#endif
+
 #if HAS_VID_DEV_TEST
     DO_TEST(vid_dev_test());
 #endif
@@ -101,6 +117,15 @@ int test_main(void)
 #if HAS_NACK_BUFFER_TEST
     DO_TEST(nack_buffer_test());
 #endif
+#if HAS_RESAMPLE_TEST
+    DO_TEST(resample_test());
+#endif
+#if HAS_WSOLA_TEST
+    DO_TEST(wsola_test());
+#endif
+#if HAS_CONF_TEST
+    DO_TEST(conf_test());
+#endif
 #if HAS_MIPS_TEST
     DO_TEST(mips_test());
 #endif
@@ -118,9 +143,11 @@ on_return:
     }
 
 #if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
-    pjmedia_video_format_mgr_destroy(pjmedia_video_format_mgr_instance());
-    pjmedia_converter_mgr_destroy(pjmedia_converter_mgr_instance());
-    pjmedia_vid_codec_mgr_destroy(pjmedia_vid_codec_mgr_instance());
+    if (has_vid_mgr) {
+        pjmedia_video_format_mgr_destroy(pjmedia_video_format_mgr_instance());
+        pjmedia_converter_mgr_destroy(pjmedia_converter_mgr_instance());
+        pjmedia_vid_codec_mgr_destroy(pjmedia_vid_codec_mgr_instance());
+    }
 #endif
 
     pjmedia_event_mgr_destroy(pjmedia_event_mgr_instance());
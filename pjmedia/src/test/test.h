@@ -30,6 +30,7 @@
 
 #define HAS_VID_DEV_TEST        PJMEDIA_HAS_VIDEO
 #define HAS_VID_PORT_TEST       PJMEDIA_HAS_VIDEO
+#define HAS_VID_CONF_TEST       PJMEDIA_HAS_VIDEO
 #ifndef HAS_VID_CODEC_TEST
     #define HAS_VID_CODEC_TEST  PJMEDIA_HAS_VIDEO
 #endif
@@ -38,18 +39,27 @@
 #define HAS_MIPS_TEST           WITH_BENCHMARK
 #define HAS_CODEC_VECTOR_TEST   1
 #define HAS_NACK_BUFFER_TEST    1
+#define HAS_RESAMPLE_TEST       1
+#define HAS_WSOLA_TEST          1
+#define HAS_CONVERTER_TEST      1
+#define HAS_CONF_TEST           1
 
 int session_test(void);
 int rtp_test(void);
 int sdp_test(void);
 int jbuf_main(void);
 int nack_buffer_test(void);
+int resample_test(void);
+int wsola_test(void);
+int converter_test(void);
+int conf_test(void);
 int sdp_neg_test(void);
 int mips_test(void);
 int codec_test_vectors(void);
 int vid_codec_test(void);
 int vid_dev_test(void);
 int vid_port_test(void);
+int vid_conf_test(void);
 
 extern pj_pool_factory *mem;
 void app_perror(pj_status_t status, const char *title);
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjmedia/vid_conf.h>
+
+
+#if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
+
+#define THIS_FILE       "vid_conf_test.c"
+
+#define WIDTH           64
+#define HEIGHT          48
+#define FPS             30
+#define PORT_CNT        6
+#define RUN_MSEC        400
+
+/* Source port generating a frame filled with a constant byte value, and
+ * sink port checking that every frame it receives is filled with the
+ * value of its source.
+ */
+struct test_port
+{
+    pjmedia_port    base;
+    pj_uint8_t      value;
+    unsigned        frame_cnt;
+    unsigned        bad_cnt;
+};
+
+static pj_status_t src_get_frame(pjmedia_port *this_port,
+                                 pjmedia_frame *frame)
+{
+    struct test_port *port = (struct test_port*)this_port;
+
+    pj_memset(frame->buf, port->value, frame->size);
+    frame->type = PJMEDIA_FRAME_TYPE_VIDEO;
+    ++port->frame_cnt;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t sink_put_frame(pjmedia_port *this_port,
+                                  pjmedia_frame *frame)
+{
+    struct test_port *port = (struct test_port*)this_port;
+    const pj_uint8_t *p = (const pj_uint8_t*)frame->buf;
+    pj_size_t i;
+
+    /* Zero sized frame is sent before the first source frame is rendered */
+    if (frame->size == 0)
+        return PJ_SUCCESS;
+
+    for (i = 0; i < frame->size; ++i) {
+        if (p[i] != port->value) {
+            ++port->bad_cnt;
+            break;
+        }
+    }
+    ++port->frame_cnt;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t port_on_destroy(pjmedia_port *this_port)
+{
+    PJ_UNUSED_ARG(this_port);
+    return PJ_SUCCESS;
+}
+
+static struct test_port *create_port(pj_pool_t *pool, const char *name,
+                                     pj_bool_t is_src, pj_uint8_t value)
+{
+    struct test_port *port = PJ_POOL_ZALLOC_T(pool, struct test_port);
+    pjmedia_format fmt;
+    pj_str_t port_name;
+
+    pjmedia_format_init_video(&fmt, PJMEDIA_FORMAT_I420, WIDTH, HEIGHT,
+                              FPS, 1);
+    pjmedia_port_info_init2(&port->base.info, pj_cstr(&port_name, name),
+                            PJMEDIA_SIG_CLASS_PORT_VID('T','C'),
+                            is_src? PJMEDIA_DIR_ENCODING :
+                                    PJMEDIA_DIR_DECODING,
+                            &fmt);
+    if (is_src)
+        port->base.get_frame = &src_get_frame;
+    else
+        port->base.put_frame = &sink_put_frame;
+    port->base.on_destroy = &port_on_destroy;
+    port->value = value;
+
+    if (pjmedia_port_init_grp_lock(&port->base, pool, NULL) != PJ_SUCCESS)
+        return NULL;
+
+    return port;
+}
+
+/* Feed each sink from its own source, so every sink is a separate render
+ * job, and check that all sinks get the right frames.
+ */
+static int worker_test(unsigned worker_cnt)
+{
+    pj_pool_t *pool;
+    pjmedia_vid_conf_setting opt;
+    pjmedia_vid_conf *vid_conf = NULL;
+    struct test_port *src[PORT_CNT], *sink[PORT_CNT];
+    unsigned src_slot[PORT_CNT], sink_slot[PORT_CNT];
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  %d sinks, %d render worker(s)",
+              PORT_CNT, worker_cnt));
+
+    pool = pj_pool_create(mem, "vidconftest", 4000, 4000, NULL);
+    pj_bzero(src, sizeof(src));
+    pj_bzero(sink, sizeof(sink));
+
+    for (i = 0; i < PORT_CNT; ++i) {
+        char name[16];
+
+        pj_ansi_snprintf(name, sizeof(name), "src%d", i);
+        src[i] = create_port(pool, name, PJ_TRUE, (pj_uint8_t)(0x10 + i));
+        pj_ansi_snprintf(name, sizeof(name), "sink%d", i);
+        sink[i] = create_port(pool, name, PJ_FALSE, (pj_uint8_t)(0x10 + i));
+        if (!src[i] || !sink[i]) {
+            rc = -10;
+            goto on_return;
+        }
+    }
+
+    pjmedia_vid_conf_setting_default(&opt);
+    opt.max_slot_cnt = PORT_CNT * 2;
+    opt.frame_rate = FPS;
+    opt.worker_cnt = worker_cnt;
+
+    status = pjmedia_vid_conf_create(pool, &opt, &vid_conf);
+    if (status != PJ_SUCCESS) {
+        app_perror(status, "  error creating video conference");
+        rc = -20;
+        goto on_return;
+    }
+
+    for (i = 0; i < PORT_CNT; ++i) {
+        status = pjmedia_vid_conf_add_port(vid_conf, pool, &src[i]->base,
+                                           &src[i]->base.info.name, NULL,
+                                           &src_slot[i]);
+        if (status == PJ_SUCCESS) {
+            status = pjmedia_vid_conf_add_port(vid_conf, pool,
+                                               &sink[i]->base,
+                                               &sink[i]->base.info.name,
+                                               NULL, &sink_slot[i]);
+        }
+        if (status == PJ_SUCCESS) {
+            status = pjmedia_vid_conf_connect_port(vid_conf, src_slot[i],
+                                                   sink_slot[i], NULL);
+        }
+        if (status != PJ_SUCCESS) {
+            app_perror(status, "  error adding port");
+            rc = -30;
+            goto on_return;
+        }
+    }
+
+    pj_thread_sleep(RUN_MSEC);
+
+    /* Stop the clock and workers before looking at the counters */
+    pjmedia_vid_conf_destroy(vid_conf);
+    vid_conf = NULL;
+
+    for (i = 0; i < PORT_CNT; ++i) {
+        PJ_LOG(4,(THIS_FILE, "    sink%d: %d frames, %d bad", i,
+                  sink[i]->frame_cnt, sink[i]->bad_cnt));
+        if (sink[i]->frame_cnt == 0) {
+            PJ_LOG(3,(THIS_FILE, "  error: sink%d got no frame", i));
+            rc = -40;
+            goto on_return;
+        }
+        if (sink[i]->bad_cnt != 0) {
+            PJ_LOG(3,(THIS_FILE, "  error: sink%d got %d bad frame(s)",
+                      i, sink[i]->bad_cnt));
+            rc = -50;
+            goto on_return;
+        }
+    }
+
+on_return:
+    if (vid_conf)
+        pjmedia_vid_conf_destroy(vid_conf);
+    for (i = 0; i < PORT_CNT; ++i) {
+        if (src[i])
+            pjmedia_port_destroy(&src[i]->base);
+        if (sink[i])
+            pjmedia_port_destroy(&sink[i]->base);
+    }
+    pj_pool_release(pool);
+    return rc;
+}
+
+int vid_conf_test(void)
+{
+    static const unsigned worker_cnts[] = { 0, 1, 2, PORT_CNT };
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "Video conference render workers test"));
+
+    for (i = 0; i < PJ_ARRAY_SIZE(worker_cnts); ++i) {
+        rc = worker_test(worker_cnts[i]);
+        if (rc != 0)
+            return rc;
+    }
+
+    return 0;
+}
+
+
+#endif /* PJMEDIA_HAS_VIDEO */
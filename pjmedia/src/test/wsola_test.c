@@ -16,13 +16,25 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
+#include "test.h"
 #include <pjmedia/wsola.h>
 #include <pj/log.h>
+#include <pj/math.h>
 #include <pj/pool.h>
 #include <pj/os.h>
+#include <pj/rand.h>
 #include <stdio.h>
 #include <assert.h>
 
+#define THIS_FILE           "wsola_test.c"
+
+/* Set to 1 to also run the expand/compress test on galileo16.pcm in the
+ * current directory.
+ */
+#ifndef WSOLA_FILE_TEST
+#   define WSOLA_FILE_TEST  0
+#endif
+
 #define CLOCK_RATE          16000
 #define SAMPLES_PER_FRAME   (10 * CLOCK_RATE / 1000)
 
@@ -84,7 +96,9 @@ void test_find_pitch(void)
 }
 #endif
 
-int expand(pj_pool_t *pool, const char *filein, const char *fileout,
+#if WSOLA_FILE_TEST
+
+static int expand(pj_pool_t *pool, const char *filein, const char *fileout,
            int expansion_rate100, int lost_rate10, int lost_burst)
 {
     enum { LOST_RATE = 10 };
@@ -202,9 +216,9 @@ static void save_file(const char *file,
     fclose(f);
 }
 
-int compress(pj_pool_t *pool, 
-             const char *filein, const char *fileout, 
-             int rate10)
+static int compress(pj_pool_t *pool, 
+                    const char *filein, const char *fileout, 
+                    int rate10)
 {
     enum { BUF_CNT = SAMPLES_PER_FRAME * 10 };
     FILE *in, *out;
@@ -296,6 +310,7 @@ int compress(pj_pool_t *pool,
 }
 
 
+#if 0
 static void mem_test(pj_pool_t *pool)
 {
     char unused[1024];
@@ -332,19 +347,12 @@ static void mem_test(pj_pool_t *pool)
               CLOCK_RATE * 100.0 / zero.u32.lo));
 
 }
+#endif
 
-int main()
+static int file_test(pj_pool_t *pool)
 {
-    pj_caching_pool cp;
-    pj_pool_t *pool;
     int i, rc;
 
-    //test_find_pitch();
-
-    pj_init();
-    pj_caching_pool_init(&cp, NULL, 0);
-    pool = pj_pool_create(&cp.factory, "", 1000, 1000, NULL);
-
     srand(2);
 
     rc = expand(pool, "galileo16.pcm", "temp1.pcm", 20, 0, 0);
@@ -355,18 +363,243 @@ int main()
         rc = compress(pool, "temp1.pcm", "output.pcm", 1);
     }
 
-    if (rc != 0) {
-        puts("Error");
-        return 1;
+    return rc;
+}
+
+#endif  /* WSOLA_FILE_TEST */
+
+
+/*
+ * The SIMD and portable correlation must give the exact sum of products,
+ * including on full-scale input where the sum of two products does not
+ * fit in 32 bits.
+ */
+#define CORR_MAX_CNT        200
+
+static int correlate_test(void)
+{
+    static const pj_int16_t extremes[] = { -32768, 32767, -32767, 0 };
+    pj_int16_t a[CORR_MAX_CNT], b[CORR_MAX_CNT];
+    unsigned pattern, cnt, i;
+
+    PJ_LOG(3,(THIS_FILE, " WSOLA correlation on full-scale input"));
+
+    pj_srand(0x1234);
+    for (pattern = 0; pattern < 4; ++pattern) {
+        for (i = 0; i < CORR_MAX_CNT; ++i) {
+            switch (pattern) {
+            case 0:
+                /* All samples -32768: every pair sum overflows int32 */
+                a[i] = b[i] = -32768;
+                break;
+            case 1:
+                /* Opposite full-scale signs */
+                a[i] = -32768;
+                b[i] = 32767;
+                break;
+            case 2:
+                /* Mixture of extreme values */
+                a[i] = extremes[pj_rand() % PJ_ARRAY_SIZE(extremes)];
+                b[i] = extremes[pj_rand() % PJ_ARRAY_SIZE(extremes)];
+                break;
+            default:
+                /* Random samples */
+                a[i] = (pj_int16_t)pj_rand();
+                b[i] = (pj_int16_t)pj_rand();
+                break;
+            }
+        }
+
+        for (cnt = 1; cnt <= CORR_MAX_CNT; ++cnt) {
+            pj_int64_t ref = 0, simd, scalar;
+
+            for (i = 0; i < cnt; ++i)
+                ref += (pj_int64_t)a[i] * b[i];
+
+            simd = pjmedia_wsola_correlate(a, b, cnt, PJ_TRUE);
+            scalar = pjmedia_wsola_correlate(a, b, cnt, PJ_FALSE);
+
+            if (simd != ref || scalar != ref) {
+                PJ_LOG(1,(THIS_FILE, "  error: pattern %d, count %d: "
+                          "expecting %lld, simd=%lld, scalar=%lld",
+                          pattern, cnt, (long long)ref, (long long)simd,
+                          (long long)scalar));
+                return -100;
+            }
+        }
+    }
+
+    return 0;
+}
+
+#if WITH_BENCHMARK
+/*
+ * Throughput benchmark of PLC (expansion) and discard (compression) with
+ * synthetic voiced signal, at the clock rates and loss rates seen in
+ * calls and conferences. Both operations spend most of their time in the
+ * pitch search.
+ */
+#define BENCH_PTIME         20
+#define BENCH_FRAMES        500
+
+/* Generate a voiced-like frame: harmonics of a slowly gliding pitch */
+static void gen_voiced(pj_int16_t *frm, unsigned count, unsigned clock_rate,
+                       unsigned *pos)
+{
+    unsigned i;
+
+    for (i = 0; i < count; ++i, ++*pos) {
+        double t = *pos * 1.0 / clock_rate;
+        double f0 = 140 + 20 * sin(2 * PJ_PI * 0.5 * t);
+        double v = 0;
+        unsigned h;
+
+        for (h = 1; h <= 5; ++h)
+            v += sin(2 * PJ_PI * f0 * h * t) / h;
+
+        frm[i] = (pj_int16_t)(v * 6000);
     }
+}
 
-#if 0
+static int bench_plc(pj_pool_t *pool, unsigned clock_rate, unsigned loss_pct)
+{
+    unsigned spf = clock_rate * BENCH_PTIME / 1000;
+    pj_int16_t *frm;
+    pjmedia_wsola *wsola;
+    pj_timestamp elapsed, t0, t1;
+    unsigned i, pos = 0, lost_cnt = 0, usec;
+    pj_bool_t prev_lost = PJ_FALSE;
+    pj_status_t status;
+
+    frm = (pj_int16_t*)pj_pool_alloc(pool, spf * sizeof(pj_int16_t));
+    status = pjmedia_wsola_create(pool, clock_rate, spf, 1, 0, &wsola);
+    if (status != PJ_SUCCESS)
+        return -10;
+
+    pj_srand(clock_rate + loss_pct);
+    elapsed.u64 = 0;
+
+    for (i = 0; i < BENCH_FRAMES; ++i) {
+        pj_bool_t lost = (pj_rand() % 100) < (int)loss_pct;
+
+        if (!lost)
+            gen_voiced(frm, spf, clock_rate, &pos);
+        else
+            pos += spf;
+
+        pj_get_timestamp(&t0);
+        if (lost) {
+            status = pjmedia_wsola_generate(wsola, frm);
+            ++lost_cnt;
+        } else {
+            status = pjmedia_wsola_save(wsola, frm, prev_lost);
+        }
+        pj_get_timestamp(&t1);
+        pj_sub_timestamp(&t1, &t0);
+        pj_add_timestamp(&elapsed, &t1);
+
+        if (status != PJ_SUCCESS) {
+            pjmedia_wsola_destroy(wsola);
+            return -20;
+        }
+        prev_lost = lost;
+    }
+
+    pjmedia_wsola_destroy(wsola);
+
+    t0.u64 = 0;
+    usec = pj_elapsed_usec(&t0, &elapsed);
+    if (usec == 0) usec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "  PLC %5dHz, %2d%% loss: %7.2f Msamples/s, "
+              "%6.2f usec/frame (%d lost frames)",
+              clock_rate, loss_pct,
+              BENCH_FRAMES * spf * 1.0 / usec,
+              usec * 1.0 / BENCH_FRAMES, lost_cnt));
+    return 0;
+}
+
+static int bench_discard(pj_pool_t *pool, unsigned clock_rate)
+{
+    unsigned spf = clock_rate * BENCH_PTIME / 1000;
+    unsigned buf_cnt = spf * 3;
+    pj_int16_t *buf;
+    pjmedia_wsola *wsola;
+    pj_timestamp elapsed, t0, t1;
+    unsigned i, pos = 0, usec;
+    pj_status_t status;
+
+    buf = (pj_int16_t*)pj_pool_alloc(pool, buf_cnt * sizeof(pj_int16_t));
+    status = pjmedia_wsola_create(pool, clock_rate, spf, 1, 0, &wsola);
+    if (status != PJ_SUCCESS)
+        return -30;
+
+    elapsed.u64 = 0;
+    for (i = 0; i < BENCH_FRAMES; ++i) {
+        unsigned del_cnt = spf;
+
+        gen_voiced(buf, buf_cnt, clock_rate, &pos);
+
+        pj_get_timestamp(&t0);
+        status = pjmedia_wsola_discard(wsola, buf, buf_cnt / 2,
+                                       buf + buf_cnt / 2,
+                                       buf_cnt - buf_cnt / 2, &del_cnt);
+        pj_get_timestamp(&t1);
+        pj_sub_timestamp(&t1, &t0);
+        pj_add_timestamp(&elapsed, &t1);
+
+        if (status != PJ_SUCCESS || del_cnt < spf) {
+            pjmedia_wsola_destroy(wsola);
+            return -40;
+        }
+    }
+
+    pjmedia_wsola_destroy(wsola);
+
+    t0.u64 = 0;
+    usec = pj_elapsed_usec(&t0, &elapsed);
+    if (usec == 0) usec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "  discard %5dHz: %6.2f usec/discard",
+              clock_rate, usec * 1.0 / BENCH_FRAMES));
+    return 0;
+}
+
+#endif  /* WITH_BENCHMARK */
+
+int wsola_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    rc = correlate_test();
+    if (rc != 0)
+        return rc;
+
+    pool = pj_pool_create(mem, "wsola_test", 4000, 4000, NULL);
+
+#if WITH_BENCHMARK
     {
-        char s[10];
-        puts("Press ENTER to quit");
-        fgets(s, sizeof(s), stdin);
+        static const unsigned rates[] = { 8000, 16000, 48000 };
+        static const unsigned losses[] = { 10, 30, 50 };
+        unsigned i, j;
+
+        PJ_LOG(3,(THIS_FILE, " WSOLA throughput, %dms frames:",
+                  BENCH_PTIME));
+        for (i = 0; i < PJ_ARRAY_SIZE(rates) && rc == 0; ++i) {
+            for (j = 0; j < PJ_ARRAY_SIZE(losses) && rc == 0; ++j)
+                rc = bench_plc(pool, rates[i], losses[j]);
+            if (rc == 0)
+                rc = bench_discard(pool, rates[i]);
+        }
     }
 #endif
 
-    return 0;
+#if WSOLA_FILE_TEST
+    if (rc == 0)
+        rc = file_test(pool);
+#endif
+
+    pj_pool_release(pool);
+    return rc;
 }
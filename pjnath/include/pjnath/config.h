@@ -142,6 +142,31 @@
 #endif
 
 
+/**
+ * Number of derived MESSAGE-INTEGRITY keys to be cached by each STUN
+ * session, so that the MD5 long term key and the keyed HMAC-SHA1 state
+ * do not have to be recalculated for every message. Set to zero to
+ * disable the cache.
+ *
+ * Default: 4
+ */
+#ifndef PJ_STUN_KEY_CACHE_SIZE
+#   define PJ_STUN_KEY_CACHE_SIZE                   4
+#endif
+
+
+/**
+ * Maximum length of the credential (realm, username, and password
+ * combined) and of the key that can be stored in the STUN key cache.
+ * Longer credentials are not cached.
+ *
+ * Default: 160
+ */
+#ifndef PJ_STUN_KEY_CACHE_MAX_LEN
+#   define PJ_STUN_KEY_CACHE_MAX_LEN                160
+#endif
+
+
 /* **************************************************************************
  * STUN TRANSPORT CONFIGURATION
  */
@@ -273,6 +298,32 @@
 #endif
 
 
+/**
+ * Size of the hash tables used by ICE stream transport multiplexer
+ * (#pj_ice_strans_mux) to look up the ICE stream transports by local
+ * ufrag and by remote address. Set this to roughly the number of
+ * ICE stream transports expected to share the multiplexer.
+ *
+ * Default: 1023
+ */
+#ifndef PJ_ICE_ST_MUX_HASH_SIZE
+#   define PJ_ICE_ST_MUX_HASH_SIZE                  1023
+#endif
+
+
+/**
+ * Maximum number of sends that may be pending at the same time on the
+ * sockets of ICE stream transport multiplexer (#pj_ice_strans_mux). Each
+ * pending send holds a copy of the packet, sending more than this will
+ * fail with PJ_EBUSY until some of the pending sends have completed.
+ *
+ * Default: 64
+ */
+#ifndef PJ_ICE_ST_MUX_MAX_PENDING_SEND
+#   define PJ_ICE_ST_MUX_MAX_PENDING_SEND           64
+#endif
+
+
 /**
  * The number of bits to represent component IDs. This will affect
  * the maximum number of components (PJ_ICE_MAX_COMP) value.
@@ -343,6 +394,32 @@
 #endif
 
 
+/**
+ * Minimum timer interval (in miliseconds) for starting ICE periodic checks
+ * when RTT based pacing is enabled (see \a rtt_pacing option in
+ * #pj_ice_sess_options). The adaptive Ta will never go below this value
+ * nor above PJ_ICE_TA_VAL.
+ *
+ * Default: 5
+ */
+#ifndef PJ_ICE_TA_MIN_VAL
+#   define PJ_ICE_TA_MIN_VAL                        5
+#endif
+
+
+/**
+ * Minimum STUN retransmission timeout (in miliseconds) for ICE connectivity
+ * checks when RTT based pacing is enabled. The timeout is derived from the
+ * smoothed RTT of the successful checks, bounded by this value and the
+ * \a rto_msec setting of the STUN configuration.
+ *
+ * Default: 50
+ */
+#ifndef PJ_ICE_MIN_RTO
+#   define PJ_ICE_MIN_RTO                           50
+#endif
+
+
 /**
  * According to ICE Section 8.2. Updating States, if an In-Progress pair in 
  * the check list is for the same component as a nominated pair, the agent 
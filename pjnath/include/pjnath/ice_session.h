@@ -416,6 +416,23 @@ struct pj_ice_sess_check
      * STUN transaction.
      */
     pj_status_t          err_code;
+
+    /**
+     * Round trip time (in milliseconds) measured from the last successful
+     * request of this check, or -1 if it has not been measured. This is
+     * only measured when \a rtt_pacing option is enabled.
+     */
+    int                  rtt;
+
+    /**
+     * Time when the last request of this check was sent.
+     */
+    pj_time_val          tx_time;
+
+    /**
+     * Initial retransmission timeout used by the last request of this check.
+     */
+    unsigned             tx_rto;
 };
 
 
@@ -672,6 +689,54 @@ typedef struct pj_ice_sess_options
      */
     pj_ice_sess_trickle trickle;
 
+    /**
+     * Run the session as an ICE-lite agent (RFC 8445 Section 2.5). A lite
+     * agent is always the controlled agent, never sends connectivity
+     * checks, only responds to the checks sent by the remote full agent,
+     * and considers a candidate pair nominated as soon as it receives a
+     * check with USE-CANDIDATE attribute for it. This is mainly useful for
+     * servers with public addresses, e.g: when many ICE stream transports
+     * share a set of sockets (see #pj_ice_strans_mux).
+     *
+     * Default value is PJ_FALSE.
+     */
+    pj_bool_t           lite;
+
+    /**
+     * Pace connectivity checks using the measured round trip time of the
+     * successful checks instead of the fixed PJ_ICE_TA_VAL interval. Once
+     * an RTT sample is available, Ta follows the smoothed RTT (bounded by
+     * PJ_ICE_TA_MIN_VAL and PJ_ICE_TA_VAL) and the retransmission timeout
+     * of subsequent checks is set to the RTT estimate plus four times its
+     * variance (bounded by PJ_ICE_MIN_RTO and the STUN \a rto_msec).
+     * Samples from retransmitted requests are ignored.
+     *
+     * Default value is PJ_FALSE.
+     */
+    pj_bool_t           rtt_pacing;
+
+    /**
+     * Run connectivity checks of independent components in parallel. When
+     * enabled, every Ta tick starts one check for each component that has
+     * a pair in Waiting or Frozen state, instead of a single check for the
+     * whole checklist.
+     *
+     * Default value is PJ_FALSE.
+     */
+    pj_bool_t           parallel_comp;
+
+    /**
+     * For controlling agent using regular nomination, start the nominated
+     * check as soon as every component has a valid pair whose local and
+     * remote candidates are host or server reflexive candidates, without
+     * waiting for \a nominated_check_delay nor for the remaining lower
+     * priority checks. Valid pairs using relayed candidates still wait
+     * for \a nominated_check_delay.
+     *
+     * Default value is PJ_FALSE.
+     */
+    pj_bool_t           early_nomination;
+
 } pj_ice_sess_options;
 
 
@@ -708,6 +773,12 @@ struct pj_ice_sess
 
     pj_stun_config       stun_cfg;                  /**< STUN settings.     */
 
+    /* RTT based pacing (rtt_pacing option) */
+    int                  srtt;                      /**< Smoothed RTT, or -1*/
+    int                  rttvar;                    /**< RTT variation.     */
+    unsigned             ta;                        /**< Current Ta (msec). */
+    unsigned             max_rto;                   /**< Configured RTO.    */
+
     /* STUN credentials */
     pj_str_t             tx_ufrag;                  /**< Remote ufrag.      */
     pj_str_t             tx_uname;                  /**< Uname for TX.      */
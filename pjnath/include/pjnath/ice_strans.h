@@ -123,6 +123,9 @@ PJ_BEGIN_DECL
 /** Forward declaration for ICE stream transport. */
 typedef struct pj_ice_strans pj_ice_strans;
 
+/** Forward declaration for ICE stream transport multiplexer. */
+typedef struct pj_ice_strans_mux pj_ice_strans_mux;
+
 /** Transport operation types to be reported on \a on_status() callback */
 typedef enum pj_ice_strans_op
 {
@@ -463,6 +466,22 @@ typedef struct pj_ice_strans_cfg
      */
     pj_ice_strans_turn_cfg turn_tp[PJ_ICE_MAX_TURN];
 
+    /**
+     * Shared sockets multiplexer. When this is set, the ICE stream
+     * transport does not create any socket of its own. Instead each
+     * component will have a single host candidate, which is the address of
+     * the multiplexer socket with the same index as the component (i.e.
+     * component 1 uses socket 0), and the ICE session will run in ICE-lite
+     * mode (see \a lite in #pj_ice_sess_options). The STUN and TURN
+     * transport settings above are ignored.
+     *
+     * The multiplexer must have at least as many sockets as the number of
+     * components, and it must outlive the ICE stream transport.
+     *
+     * Default: NULL
+     */
+    pj_ice_strans_mux   *mux;
+
     /**
      * Number of send buffers used for pj_ice_strans_sendto2(). If the send
      * buffers are full, pj_ice_strans_sendto()/sendto2() will return
@@ -1099,6 +1118,182 @@ PJ_DECL(pj_status_t) pj_ice_strans_sendto2(pj_ice_strans *ice_st,
                                            int dst_addr_len);
 
 
+/**
+ * This structure describes the settings of ICE stream transport
+ * multiplexer. Application should initialize the structure with
+ * #pj_ice_strans_mux_cfg_default() before changing the settings.
+ */
+typedef struct pj_ice_strans_mux_cfg
+{
+    /**
+     * Address family of the sockets.
+     *
+     * Default: pj_AF_INET()
+     */
+    int                 af;
+
+    /**
+     * Number of UDP sockets to create. Socket at index N serves
+     * component N+1 of all ICE stream transports, so this must not be less
+     * than the number of components of the ICE stream transports using the
+     * multiplexer.
+     *
+     * Default: 2 (RTP and RTCP)
+     */
+    unsigned            sock_cnt;
+
+    /**
+     * Address to bind the sockets to. If the port is set, socket N will be
+     * bound to that port plus N, otherwise the sockets will be bound to
+     * random ports. If the address is zero (any address), the host
+     * candidates will use the default host IP address.
+     *
+     * Default: any address and port zero
+     */
+    pj_sockaddr         bound_addr;
+
+    /**
+     * Maximum incoming and outgoing packet size.
+     *
+     * Default: PJ_STUN_SOCK_PKT_LEN
+     */
+    unsigned            max_pkt_size;
+
+    /**
+     * Number of concurrent asynchronous read operations on each socket.
+     * Since every packet of every ICE stream transport goes through these
+     * sockets, setting more than one may be useful when the ioqueue is
+     * polled by multiple threads.
+     *
+     * Default: 1
+     */
+    unsigned            async_cnt;
+
+    /**
+     * Specify target value for socket receive buffer size, applied with
+     * setsockopt(). Zero means the operating system default.
+     *
+     * Default: 0
+     */
+    unsigned            so_rcvbuf_size;
+
+    /**
+     * Specify target value for socket send buffer size, applied with
+     * setsockopt(). Zero means the operating system default.
+     *
+     * Default: 0
+     */
+    unsigned            so_sndbuf_size;
+
+} pj_ice_strans_mux_cfg;
+
+
+/**
+ * This structure contains the statistics of ICE stream transport
+ * multiplexer.
+ */
+typedef struct pj_ice_strans_mux_stat
+{
+    /**
+     * Number of ICE stream transports with ICE session currently
+     * registered (by their local ufrag).
+     */
+    unsigned            sess_cnt;
+
+    /**
+     * Number of remote addresses currently routed to a component, i.e.
+     * the nominated pairs.
+     */
+    unsigned            route_cnt;
+
+    /**
+     * Number of packets received and delivered to an ICE stream transport.
+     */
+    pj_uint32_t         rx_pkt;
+
+    /**
+     * Number of packets received and dropped because they do not belong
+     * to any registered ICE stream transport.
+     */
+    pj_uint32_t         rx_drop;
+
+} pj_ice_strans_mux_stat;
+
+
+/**
+ * Initialize ICE stream transport multiplexer settings with default values.
+ *
+ * @param cfg           The settings to be initialized.
+ */
+PJ_DECL(void) pj_ice_strans_mux_cfg_default(pj_ice_strans_mux_cfg *cfg);
+
+
+/**
+ * Create ICE stream transport multiplexer, a small set of UDP sockets to
+ * be shared by many ICE stream transports, so that a server handling many
+ * calls doesn't need a socket (and a file descriptor and ioqueue key) for
+ * every component of every call. The ICE stream transports are attached
+ * to the multiplexer with the \a mux field of #pj_ice_strans_cfg.
+ *
+ * Incoming STUN messages with USERNAME attribute are dispatched to the ICE
+ * stream transport whose ICE session has the local ufrag in the USERNAME,
+ * and once a candidate pair has been nominated, other packets from the
+ * remote address of the pair are dispatched to the component of the pair.
+ * Packets that match neither are dropped.
+ *
+ * @param stun_cfg      The STUN config containing the ioqueue and pool
+ *                      factory to be used.
+ * @param name          Optional name to identify the multiplexer in log.
+ * @param cfg           The multiplexer settings.
+ * @param p_mux         Pointer to receive the multiplexer.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ice_strans_mux_create(const pj_stun_config *stun_cfg,
+                                              const char *name,
+                                              const pj_ice_strans_mux_cfg *cfg,
+                                              pj_ice_strans_mux **p_mux);
+
+
+/**
+ * Destroy ICE stream transport multiplexer. All ICE stream transports
+ * using the multiplexer must have been destroyed before calling this
+ * function.
+ *
+ * @param mux           The multiplexer.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_ice_strans_mux_destroy(pj_ice_strans_mux *mux);
+
+
+/**
+ * Get the (published) address of a multiplexer socket, i.e. the host
+ * candidate address of the components served by the socket.
+ *
+ * @param mux           The multiplexer.
+ * @param sock_idx      The socket index.
+ * @param addr          Pointer to receive the address.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_ice_strans_mux_get_addr(pj_ice_strans_mux *mux,
+                                                unsigned sock_idx,
+                                                pj_sockaddr *addr);
+
+
+/**
+ * Get the multiplexer statistics.
+ *
+ * @param mux           The multiplexer.
+ * @param stat          Pointer to receive the statistics.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_ice_strans_mux_get_stat(pj_ice_strans_mux *mux,
+                                                pj_ice_strans_mux_stat *stat);
+
+
 /**
  * @}
  */
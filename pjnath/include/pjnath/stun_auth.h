@@ -25,6 +25,7 @@
  */
 
 #include <pjnath/stun_msg.h>
+#include <pjlib-util/hmac_sha1.h>
 
 
 PJ_BEGIN_DECL
@@ -444,6 +445,166 @@ PJ_DECL(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
                                                    const pj_str_t *key);
 
 
+/**
+ * An entry in the STUN key cache.
+ */
+typedef struct pj_stun_key_cache_entry
+{
+    /** Hash value of the lookup id, to speed up the lookup. */
+    pj_uint32_t          hash;
+
+    /** Length of the lookup id. */
+    unsigned             id_len;
+
+    /** The lookup id, i.e. the credential or the key itself. */
+    char                 id[PJ_STUN_KEY_CACHE_MAX_LEN + 4];
+
+    /** The MESSAGE-INTEGRITY key, pointing to key_buf. */
+    pj_str_t             key;
+
+    /** Buffer of the key. */
+    char                 key_buf[PJ_STUN_KEY_CACHE_MAX_LEN];
+
+    /** HMAC-SHA1 context which has been initialized with the key. */
+    pj_hmac_sha1_context hmac;
+
+} pj_stun_key_cache_entry;
+
+
+/**
+ * Small cache of MESSAGE-INTEGRITY keys derived from credentials. It
+ * saves the MD5 calculation of long term credential keys, and the
+ * keyed HMAC-SHA1 initialization, for each message. The cache is not
+ * thread safe; the STUN session maintains one per session and only
+ * accesses it while holding the session's lock.
+ */
+typedef struct pj_stun_key_cache
+{
+    /** Number of entries. */
+    unsigned                count;
+
+    /** Index of the entry to be replaced next when the cache is full. */
+    unsigned                next;
+
+    /** Number of lookups served from the cache. */
+    unsigned                hit_cnt;
+
+    /** Number of lookups which required key derivation. */
+    unsigned                miss_cnt;
+
+    /** The entries. */
+    pj_stun_key_cache_entry entry[PJ_STUN_KEY_CACHE_SIZE ?
+                                  PJ_STUN_KEY_CACHE_SIZE : 1];
+
+} pj_stun_key_cache;
+
+
+/**
+ * Initialize (or clear) the key cache.
+ *
+ * @param cache         The key cache.
+ */
+PJ_DECL(void) pj_stun_key_cache_init(pj_stun_key_cache *cache);
+
+
+/**
+ * Get the MESSAGE-INTEGRITY key of the credential from the cache,
+ * deriving it with #pj_stun_create_key() and adding it to the cache
+ * if it's not there yet.
+ *
+ * @param cache         The key cache.
+ * @param realm         The realm, for long term credential. Specify NULL
+ *                      or empty string for short term credential.
+ * @param username      The username.
+ * @param data_type     Password encoding.
+ * @param data          The password.
+ *
+ * @return              The cache entry, or NULL if the credential is too
+ *                      long to be cached (see PJ_STUN_KEY_CACHE_MAX_LEN).
+ */
+PJ_DECL(const pj_stun_key_cache_entry*)
+pj_stun_key_cache_get(pj_stun_key_cache *cache,
+                      const pj_str_t *realm,
+                      const pj_str_t *username,
+                      pj_stun_passwd_type data_type,
+                      const pj_str_t *data);
+
+
+/**
+ * Get the cache entry for the specified MESSAGE-INTEGRITY key, adding
+ * it to the cache if it's not there yet.
+ *
+ * @param cache         The key cache.
+ * @param key           The key.
+ *
+ * @return              The cache entry, or NULL if the key is too long
+ *                      to be cached.
+ */
+PJ_DECL(const pj_stun_key_cache_entry*)
+pj_stun_key_cache_get_by_key(pj_stun_key_cache *cache,
+                             const pj_str_t *key);
+
+
+/**
+ * Variant of #pj_stun_authenticate_request() which uses the key cache
+ * to avoid recalculating the key for each request.
+ *
+ * @param pkt           The original packet.
+ * @param pkt_len       The length of the packet.
+ * @param msg           The parsed message to be verified.
+ * @param cred          The credential to authenticate the message.
+ * @param cache         Optional key cache.
+ * @param pool          Pool for the response and the authentication info.
+ * @param info          Optional pointer to receive authentication info.
+ * @param p_response    Optional pointer to receive the response message.
+ *
+ * @return              PJ_SUCCESS if credential is verified successfully.
+ */
+PJ_DECL(pj_status_t) pj_stun_authenticate_request2(const pj_uint8_t *pkt,
+                                                   unsigned pkt_len,
+                                                   const pj_stun_msg *msg,
+                                                   pj_stun_auth_cred *cred,
+                                                   pj_stun_key_cache *cache,
+                                                   pj_pool_t *pool,
+                                                   pj_stun_req_cred_info *info,
+                                                   pj_stun_msg **p_response);
+
+
+/**
+ * Variant of #pj_stun_authenticate_response() which uses the key cache
+ * to avoid the keyed HMAC-SHA1 initialization for each response.
+ *
+ * @param pkt           The original packet.
+ * @param pkt_len       The length of the packet.
+ * @param msg           The parsed message to be verified.
+ * @param key           Authentication key.
+ * @param cache         Optional key cache.
+ *
+ * @return              PJ_SUCCESS if credential is verified successfully.
+ */
+PJ_DECL(pj_status_t) pj_stun_authenticate_response2(const pj_uint8_t *pkt,
+                                                    unsigned pkt_len,
+                                                    const pj_stun_msg *msg,
+                                                    const pj_str_t *key,
+                                                    pj_stun_key_cache *cache);
+
+
+/**
+ * Verify the MESSAGE-INTEGRITY of a message that has been parsed with
+ * #pj_stun_msg_view_parse(), e.g. an ICE connectivity check, without
+ * decoding the message.
+ *
+ * @param view          The message view.
+ * @param key           Authentication key.
+ * @param cache         Optional key cache.
+ *
+ * @return              PJ_SUCCESS if the MESSAGE-INTEGRITY is valid.
+ */
+PJ_DECL(pj_status_t) pj_stun_authenticate_view(const pj_stun_msg_view *view,
+                                               const pj_str_t *key,
+                                               pj_stun_key_cache *cache);
+
+
 /**
  * @}
  */
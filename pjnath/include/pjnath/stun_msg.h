@@ -1450,6 +1450,182 @@ PJ_DECL(pj_status_t) pj_stun_msg_decode(pj_pool_t *pool,
                                         pj_size_t *p_parsed_len,
                                         pj_stun_msg **p_response);
 
+
+/**
+ * This structure describes a read-only view of a STUN message, which is
+ * parsed in place by #pj_stun_msg_view_parse() without allocating any
+ * memory. Only the attributes used by Binding requests and responses
+ * (the ICE connectivity checks) are picked up, and pointers in the view
+ * point to the original packet, hence the packet must remain valid and
+ * unmodified for as long as the view is used.
+ *
+ * All integral fields are in host byte order.
+ */
+typedef struct pj_stun_msg_view
+{
+    /**
+     * The packet.
+     */
+    const pj_uint8_t   *pdu;
+
+    /**
+     * Length of the STUN message in the packet, including the header.
+     */
+    unsigned            msg_len;
+
+    /**
+     * Message type.
+     */
+    pj_uint16_t         type;
+
+    /**
+     * Magic cookie.
+     */
+    pj_uint32_t         magic;
+
+    /**
+     * Pointer to the 12 bytes transaction ID.
+     */
+    const pj_uint8_t   *tsx_id;
+
+    /**
+     * Bitmask of attributes found in the message, from
+     * pj_stun_msg_view_flag.
+     */
+    unsigned            flags;
+
+    /**
+     * Type of the first comprehension-required attribute that is not
+     * known to the STUN decoder, or zero. Application should reject the
+     * message (or decode it with #pj_stun_msg_decode() to get the proper
+     * error response) if this is set.
+     */
+    pj_uint16_t         unknown_attr;
+
+    /**
+     * USERNAME value.
+     */
+    pj_str_t            username;
+
+    /**
+     * REALM value.
+     */
+    pj_str_t            realm;
+
+    /**
+     * NONCE value.
+     */
+    pj_str_t            nonce;
+
+    /**
+     * SOFTWARE value.
+     */
+    pj_str_t            software;
+
+    /**
+     * PRIORITY value.
+     */
+    pj_uint32_t         priority;
+
+    /**
+     * ICE-CONTROLLING or ICE-CONTROLLED tie-breaker value.
+     */
+    pj_timestamp        tie_breaker;
+
+    /**
+     * ERROR-CODE value.
+     */
+    int                 err_code;
+
+    /**
+     * Offset of XOR-MAPPED-ADDRESS attribute from the start of the packet.
+     */
+    unsigned            xor_mapped_pos;
+
+    /**
+     * Offset of MESSAGE-INTEGRITY attribute from the start of the packet.
+     */
+    unsigned            msgint_pos;
+
+} pj_stun_msg_view;
+
+
+/**
+ * Flags in pj_stun_msg_view, telling which attributes are present.
+ */
+typedef enum pj_stun_msg_view_flag
+{
+    PJ_STUN_VIEW_HAS_USERNAME        = 1,   /**< USERNAME                   */
+    PJ_STUN_VIEW_HAS_REALM           = 2,   /**< REALM                      */
+    PJ_STUN_VIEW_HAS_NONCE           = 4,   /**< NONCE                      */
+    PJ_STUN_VIEW_HAS_PRIORITY        = 8,   /**< PRIORITY                   */
+    PJ_STUN_VIEW_HAS_USE_CANDIDATE   = 16,  /**< USE-CANDIDATE              */
+    PJ_STUN_VIEW_HAS_ICE_CONTROLLING = 32,  /**< ICE-CONTROLLING            */
+    PJ_STUN_VIEW_HAS_ICE_CONTROLLED  = 64,  /**< ICE-CONTROLLED             */
+    PJ_STUN_VIEW_HAS_ERROR_CODE      = 128, /**< ERROR-CODE                 */
+    PJ_STUN_VIEW_HAS_XOR_MAPPED_ADDR = 256, /**< XOR-MAPPED-ADDRESS         */
+    PJ_STUN_VIEW_HAS_MSGINT          = 512, /**< MESSAGE-INTEGRITY          */
+    PJ_STUN_VIEW_HAS_FINGERPRINT     = 1024,/**< FINGERPRINT                */
+    PJ_STUN_VIEW_HAS_SOFTWARE        = 2048,/**< SOFTWARE                   */
+    PJ_STUN_VIEW_HAS_OTHER           = 4096 /**< Any other attribute        */
+
+} pj_stun_msg_view_flag;
+
+
+/**
+ * Parse the packet into a STUN message view, without allocating memory.
+ * Attribute lengths are validated the same way as #pj_stun_msg_decode(),
+ * and FINGERPRINT is verified when PJ_STUN_CHECK_PACKET is specified.
+ * Other attributes are skipped, and PJ_STUN_VIEW_HAS_OTHER is set if any
+ * is found.
+ *
+ * @param pdu           The incoming packet to be parsed.
+ * @param pdu_len       The length of the incoming packet.
+ * @param options       Parsing flags, according to pj_stun_decode_options.
+ * @param view          The view to be initialized.
+ *
+ * @return              PJ_SUCCESS if the packet has been parsed.
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_view_parse(const pj_uint8_t *pdu,
+                                            pj_size_t pdu_len,
+                                            unsigned options,
+                                            pj_stun_msg_view *view);
+
+
+/**
+ * Get the address in the XOR-MAPPED-ADDRESS attribute of the view.
+ *
+ * @param view          The STUN message view.
+ * @param addr          Pointer to receive the address.
+ *
+ * @return              PJ_SUCCESS, or PJ_ENOTFOUND if the message does
+ *                      not contain XOR-MAPPED-ADDRESS attribute.
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_view_get_xor_mapped_addr(
+                                            const pj_stun_msg_view *view,
+                                            pj_sockaddr *addr);
+
+
+/**
+ * Create STUN message from the view, for messages that contain only the
+ * attributes known to the view (i.e. PJ_STUN_VIEW_HAS_OTHER is not set).
+ * The attributes are created directly in the order they appear in the
+ * packet, without going through the generic decoder, so that the message
+ * can be authenticated against the original packet.
+ *
+ * @param pool          Pool to allocate the message.
+ * @param view          The STUN message view.
+ * @param p_msg         Pointer to receive the message.
+ *
+ * @return              PJ_SUCCESS, or PJ_ENOTSUP if the message contains
+ *                      other attributes and must be decoded with
+ *                      #pj_stun_msg_decode().
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_view_to_msg(pj_pool_t *pool,
+                                             const pj_stun_msg_view *view,
+                                             pj_stun_msg **p_msg);
+
+
 /**
  * Dump STUN message to a printable string output.
  *
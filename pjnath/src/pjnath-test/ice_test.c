@@ -1603,3 +1603,775 @@ int trickle_ice_test(void)
 
     return rc;
 }
+
+
+/*
+ * ICE stream transport multiplexer test: many ICE-lite transports share
+ * the same two sockets, each negotiating with its own full agent.
+ */
+#define MUX_SESS_CNT    8
+#define MUX_COMP_CNT    2
+#define MUX_BURST_CNT   16
+
+struct mux_ept
+{
+    pj_ice_strans       *ice;
+    pj_str_t             ufrag;
+    pj_str_t             pass;
+    pj_status_t          init_status;
+    pj_status_t          nego_status;
+    unsigned             rx_cnt[MUX_COMP_CNT+1];
+};
+
+static void mux_on_rx_data(pj_ice_strans *ice_st,
+                           unsigned comp_id,
+                           void *pkt, pj_size_t size,
+                           const pj_sockaddr_t *src_addr,
+                           unsigned src_addr_len)
+{
+    struct mux_ept *ept;
+
+    PJ_UNUSED_ARG(pkt);
+    PJ_UNUSED_ARG(size);
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(src_addr_len);
+
+    ept = (struct mux_ept*) pj_ice_strans_get_user_data(ice_st);
+    if (ept && comp_id <= MUX_COMP_CNT)
+        ept->rx_cnt[comp_id]++;
+}
+
+static void mux_on_ice_complete(pj_ice_strans *ice_st,
+                                pj_ice_strans_op op,
+                                pj_status_t status)
+{
+    struct mux_ept *ept;
+
+    ept = (struct mux_ept*) pj_ice_strans_get_user_data(ice_st);
+    if (!ept)
+        return;
+
+    if (op == PJ_ICE_STRANS_OP_INIT)
+        ept->init_status = status;
+    else if (op == PJ_ICE_STRANS_OP_NEGOTIATION)
+        ept->nego_status = status;
+}
+
+static int mux_create_ept(pj_pool_t *pool, pj_stun_config *stun_cfg,
+                          pj_ice_strans_mux *mux, struct mux_ept *ept)
+{
+    pj_ice_strans_cfg ice_cfg;
+    pj_ice_strans_cb ice_cb;
+    pj_str_t loopback = pj_str("127.0.0.1");
+    pj_status_t status;
+
+    pj_bzero(&ice_cb, sizeof(ice_cb));
+    ice_cb.on_rx_data = &mux_on_rx_data;
+    ice_cb.on_ice_complete = &mux_on_ice_complete;
+
+    pj_ice_strans_cfg_default(&ice_cfg);
+    pj_memcpy(&ice_cfg.stun_cfg, stun_cfg, sizeof(pj_stun_config));
+    if (mux) {
+        ice_cfg.mux = mux;
+    } else {
+        ice_cfg.stun_tp_cnt = 1;
+        pj_ice_strans_stun_cfg_default(&ice_cfg.stun_tp[0]);
+        ice_cfg.stun_tp[0].loop_addr = PJ_TRUE;
+        pj_sockaddr_init(pj_AF_INET(), &ice_cfg.stun_tp[0].cfg.bound_addr,
+                         &loopback, 0);
+    }
+
+    ept->init_status = ept->nego_status = PJ_EPENDING;
+    status = pj_ice_strans_create(NULL, &ice_cfg, MUX_COMP_CNT, ept,
+                                  &ice_cb, &ept->ice);
+    if (status != PJ_SUCCESS) {
+        app_perror(INDENT "err: pj_ice_strans_create()", status);
+        return -1;
+    }
+
+    pj_create_unique_string(pool, &ept->ufrag);
+    pj_create_unique_string(pool, &ept->pass);
+    return 0;
+}
+
+static int mux_start_ice(struct mux_ept *ept, const struct mux_ept *remote)
+{
+    pj_ice_sess_cand rcand[MUX_COMP_CNT * PJ_ICE_ST_MAX_CAND];
+    unsigned i, rcand_cnt = 0;
+    pj_status_t status;
+
+    for (i=0; i<MUX_COMP_CNT; ++i) {
+        unsigned cnt = PJ_ARRAY_SIZE(rcand) - rcand_cnt;
+        status = pj_ice_strans_enum_cands(remote->ice, i+1, &cnt,
+                                          rcand+rcand_cnt);
+        if (status != PJ_SUCCESS)
+            return -1;
+        rcand_cnt += cnt;
+    }
+
+    status = pj_ice_strans_start_ice(ept->ice, &remote->ufrag, &remote->pass,
+                                     rcand_cnt, rcand);
+    if (status != PJ_SUCCESS) {
+        app_perror(INDENT "err: pj_ice_strans_start_ice()", status);
+        return -1;
+    }
+    return 0;
+}
+
+/* Send packets back to back on every component to the valid pair's
+ * remote address, reusing the same buffer.
+ */
+static int mux_send_all(struct mux_ept *ept, unsigned cnt)
+{
+    unsigned i, j;
+
+    for (i=1; i<=MUX_COMP_CNT; ++i) {
+        const pj_ice_sess_check *check;
+
+        check = pj_ice_strans_get_valid_pair(ept->ice, i);
+        if (!check)
+            return -1;
+
+        for (j=0; j<cnt; ++j) {
+            char data[16];
+            pj_status_t status;
+
+            pj_ansi_snprintf(data, sizeof(data), "data%d", j);
+            status = pj_ice_strans_sendto2(ept->ice, i, data,
+                                           pj_ansi_strlen(data),
+                                           &check->rcand->addr,
+                                           pj_sockaddr_get_len(
+                                                &check->rcand->addr));
+            if (status != PJ_SUCCESS && status != PJ_EPENDING)
+                return -2;
+        }
+    }
+    return 0;
+}
+
+static pj_bool_t mux_all_done(struct mux_ept *ept, unsigned cnt,
+                              pj_bool_t nego)
+{
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+        pj_status_t st = nego ? ept[i].nego_status : ept[i].init_status;
+        if (st == PJ_EPENDING)
+            return PJ_FALSE;
+    }
+    return PJ_TRUE;
+}
+
+int ice_mux_test(void)
+{
+    pj_pool_t *pool;
+    pj_stun_config stun_cfg;
+    pj_ice_strans_mux_cfg mux_cfg;
+    pj_ice_strans_mux *mux = NULL;
+    pj_ice_strans_mux_stat stat;
+    struct mux_ept lite[MUX_SESS_CNT], full[MUX_SESS_CNT];
+    pj_str_t loopback = pj_str("127.0.0.1");
+    pj_time_val t0, t;
+    unsigned i, j;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "ICE-lite with shared sockets mux"));
+    pj_log_push_indent();
+
+    pj_bzero(lite, sizeof(lite));
+    pj_bzero(full, sizeof(full));
+
+    pool = pj_pool_create(mem, NULL, 512, 512, NULL);
+    rc = create_stun_config(pool, &stun_cfg);
+    if (rc != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        pj_log_pop_indent();
+        return -5000;
+    }
+
+    pj_ice_strans_mux_cfg_default(&mux_cfg);
+    mux_cfg.sock_cnt = MUX_COMP_CNT;
+    pj_sockaddr_init(pj_AF_INET(), &mux_cfg.bound_addr, &loopback, 0);
+    if (pj_ice_strans_mux_create(&stun_cfg, NULL, &mux_cfg, &mux) !=
+        PJ_SUCCESS)
+    {
+        rc = -5010;
+        goto on_return;
+    }
+
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        if (mux_create_ept(pool, &stun_cfg, mux, &lite[i]) ||
+            mux_create_ept(pool, &stun_cfg, NULL, &full[i]))
+        {
+            rc = -5020;
+            goto on_return;
+        }
+    }
+
+    for (j=0; j<500 && (!mux_all_done(lite, MUX_SESS_CNT, PJ_FALSE) ||
+                        !mux_all_done(full, MUX_SESS_CNT, PJ_FALSE)); ++j)
+    {
+        poll_events(&stun_cfg, 10, PJ_FALSE);
+    }
+
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        pj_ice_sess_cand cand;
+
+        if (lite[i].init_status != PJ_SUCCESS ||
+            full[i].init_status != PJ_SUCCESS)
+        {
+            rc = -5030;
+            goto on_return;
+        }
+
+        /* Lite transport has the mux socket address as host candidate */
+        for (j=1; j<=MUX_COMP_CNT; ++j) {
+            pj_sockaddr addr;
+
+            pj_ice_strans_mux_get_addr(mux, j-1, &addr);
+            if (pj_ice_strans_get_def_cand(lite[i].ice, j, &cand) !=
+                    PJ_SUCCESS ||
+                pj_sockaddr_cmp(&cand.addr, &addr) != 0)
+            {
+                rc = -5040;
+                goto on_return;
+            }
+        }
+
+        /* Role is forced to controlled */
+        if (pj_ice_strans_init_ice(lite[i].ice, PJ_ICE_SESS_ROLE_CONTROLLING,
+                                   &lite[i].ufrag, &lite[i].pass) !=
+                PJ_SUCCESS ||
+            pj_ice_strans_init_ice(full[i].ice, PJ_ICE_SESS_ROLE_CONTROLLING,
+                                   &full[i].ufrag, &full[i].pass) !=
+                PJ_SUCCESS)
+        {
+            rc = -5050;
+            goto on_return;
+        }
+        if (pj_ice_strans_get_role(lite[i].ice) !=
+            PJ_ICE_SESS_ROLE_CONTROLLED)
+        {
+            rc = -5055;
+            goto on_return;
+        }
+    }
+
+    pj_ice_strans_mux_get_stat(mux, &stat);
+    if (stat.sess_cnt != MUX_SESS_CNT || stat.route_cnt != 0) {
+        rc = -5060;
+        goto on_return;
+    }
+
+    pj_gettimeofday(&t0);
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        if (mux_start_ice(&lite[i], &full[i]) ||
+            mux_start_ice(&full[i], &lite[i]))
+        {
+            rc = -5070;
+            goto on_return;
+        }
+    }
+
+    for (j=0; j<1000 && (!mux_all_done(lite, MUX_SESS_CNT, PJ_TRUE) ||
+                         !mux_all_done(full, MUX_SESS_CNT, PJ_TRUE)); ++j)
+    {
+        poll_events(&stun_cfg, 10, PJ_FALSE);
+    }
+    pj_gettimeofday(&t);
+    PJ_TIME_VAL_SUB(t, t0);
+
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        if (lite[i].nego_status != PJ_SUCCESS ||
+            full[i].nego_status != PJ_SUCCESS)
+        {
+            PJ_LOG(3,(THIS_FILE, INDENT "err: session %d nego status "
+                      "lite=%d full=%d", i, lite[i].nego_status,
+                      full[i].nego_status));
+            rc = -5080;
+            goto on_return;
+        }
+    }
+
+    PJ_LOG(3,(THIS_FILE, INDENT "%d sessions negotiated over %d shared "
+              "sockets in %ld ms", MUX_SESS_CNT, MUX_COMP_CNT,
+              PJ_TIME_VAL_MSEC(t)));
+
+    pj_ice_strans_mux_get_stat(mux, &stat);
+    if (stat.route_cnt != MUX_SESS_CNT * MUX_COMP_CNT) {
+        rc = -5090;
+        goto on_return;
+    }
+
+    /* Data must be delivered to the right session in both directions */
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        if (mux_send_all(&lite[i], 1) || mux_send_all(&full[i], 1)) {
+            rc = -5100;
+            goto on_return;
+        }
+    }
+    poll_events(&stun_cfg, 100, PJ_FALSE);
+
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        for (j=1; j<=MUX_COMP_CNT; ++j) {
+            if (lite[i].rx_cnt[j] != 1 || full[i].rx_cnt[j] != 1) {
+                PJ_LOG(3,(THIS_FILE, INDENT "err: session %d comp %d "
+                          "rx lite=%d full=%d", i, j, lite[i].rx_cnt[j],
+                          full[i].rx_cnt[j]));
+                rc = -5110;
+                goto on_return;
+            }
+        }
+    }
+
+    /* Back to back sends while previous ones may still be pending */
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        if (mux_send_all(&lite[i], MUX_BURST_CNT)) {
+            rc = -5112;
+            goto on_return;
+        }
+    }
+    poll_events(&stun_cfg, 100, PJ_FALSE);
+
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        for (j=1; j<=MUX_COMP_CNT; ++j) {
+            if (full[i].rx_cnt[j] != 1 + MUX_BURST_CNT) {
+                PJ_LOG(3,(THIS_FILE, INDENT "err: session %d comp %d "
+                          "burst rx=%d", i, j, full[i].rx_cnt[j]));
+                rc = -5114;
+                goto on_return;
+            }
+        }
+    }
+
+    /* Packet from unknown address is dropped */
+    {
+        pj_ice_strans_mux_stat stat2;
+        pj_sock_t sock;
+        pj_sockaddr addr;
+        pj_ssize_t len = 4;
+
+        pj_ice_strans_mux_get_stat(mux, &stat);
+        pj_ice_strans_mux_get_addr(mux, 0, &addr);
+        if (pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock) !=
+            PJ_SUCCESS)
+        {
+            rc = -5120;
+            goto on_return;
+        }
+        pj_sock_sendto(sock, "junk", &len, 0, &addr,
+                       pj_sockaddr_get_len(&addr));
+        poll_events(&stun_cfg, 50, PJ_FALSE);
+        pj_sock_close(sock);
+
+        pj_ice_strans_mux_get_stat(mux, &stat2);
+        if (stat2.rx_drop != stat.rx_drop + 1 ||
+            stat2.rx_pkt != stat.rx_pkt)
+        {
+            rc = -5130;
+            goto on_return;
+        }
+    }
+
+    /* Stopping ICE unregisters the session and its routes */
+    for (i=0; i<MUX_SESS_CNT; ++i)
+        pj_ice_strans_stop_ice(lite[i].ice);
+
+    pj_ice_strans_mux_get_stat(mux, &stat);
+    if (stat.sess_cnt != 0 || stat.route_cnt != 0) {
+        rc = -5140;
+        goto on_return;
+    }
+
+on_return:
+    for (i=0; i<MUX_SESS_CNT; ++i) {
+        if (lite[i].ice)
+            pj_ice_strans_destroy(lite[i].ice);
+        if (full[i].ice)
+            pj_ice_strans_destroy(full[i].ice);
+    }
+    poll_events(&stun_cfg, 100, PJ_FALSE);
+    if (mux)
+        pj_ice_strans_mux_destroy(mux);
+    poll_events(&stun_cfg, 100, PJ_FALSE);
+
+    destroy_stun_config(&stun_cfg);
+    pj_pool_release(pool);
+    pj_log_pop_indent();
+
+    return rc;
+}
+
+
+/*
+ * Connectivity check scheduling benchmark: two ICE sessions talk to each
+ * other over a simulated lossy network (no sockets, packets are delivered
+ * by timer after a fixed one-way delay, or dropped at random). Only the
+ * lower priority candidates are reachable, so the checker has to walk
+ * through the failing pairs first. The time to the first valid pair and
+ * to the completion is reported for the default fixed Ta scheduler and
+ * for the adaptive one (RTT pacing, parallel components, early
+ * nomination).
+ */
+#define PACE_COMP_CNT   2
+#define PACE_CAND_CNT   3
+#define PACE_DELAY      2       /* One-way delay, msec */
+#define PACE_RUNS       5
+#define PACE_TIMEOUT    20000
+
+struct pace_pkt
+{
+    PJ_DECL_LIST_MEMBER(struct pace_pkt);
+    pj_timer_entry       timer;
+    pj_ice_sess         *ice;
+    unsigned             comp_id;
+    unsigned             transport_id;
+    pj_sockaddr          src_addr;
+    unsigned             size;
+    char                 data[PJ_STUN_MAX_PKT_LEN];
+};
+
+struct pace_ept
+{
+    pj_ice_sess         *ice;
+    struct pace_ept     *peer;
+    pj_str_t             ufrag;
+    pj_str_t             pass;
+    pj_time_val          valid_time;
+    pj_time_val          done_time;
+    pj_status_t          nego_status;
+};
+
+static struct pace_net
+{
+    pj_pool_t           *pool;
+    pj_stun_config      *stun_cfg;
+    unsigned             loss_pct;
+    struct pace_pkt      pending;
+    struct pace_pkt      free_list;
+} pace_net;
+
+static void pace_on_deliver(pj_timer_heap_t *th, pj_timer_entry *te)
+{
+    struct pace_pkt *pkt = (struct pace_pkt*) te->user_data;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_list_erase(pkt);
+    pj_ice_sess_on_rx_pkt(pkt->ice, pkt->comp_id, pkt->transport_id,
+                          pkt->data, pkt->size, &pkt->src_addr,
+                          pj_sockaddr_get_len(&pkt->src_addr));
+    pj_list_push_back(&pace_net.free_list, pkt);
+}
+
+static void pace_on_valid_pair(pj_ice_sess *ice)
+{
+    struct pace_ept *ept = (struct pace_ept*) ice->user_data;
+    pj_gettickcount(&ept->valid_time);
+}
+
+static void pace_on_ice_complete(pj_ice_sess *ice, pj_status_t status)
+{
+    struct pace_ept *ept = (struct pace_ept*) ice->user_data;
+    pj_gettickcount(&ept->done_time);
+    ept->nego_status = status;
+}
+
+/* Find the candidate (i.e. the transport) of the session owning addr */
+static int pace_find_cand(pj_ice_sess *ice, unsigned comp_id,
+                          const pj_sockaddr_t *addr)
+{
+    unsigned i;
+
+    for (i=0; i<ice->lcand_cnt; ++i) {
+        if (ice->lcand[i].comp_id == comp_id &&
+            pj_sockaddr_cmp(&ice->lcand[i].addr, addr) == 0)
+        {
+            return ice->lcand[i].transport_id;
+        }
+    }
+    return -1;
+}
+
+static pj_status_t pace_on_tx_pkt(pj_ice_sess *ice, unsigned comp_id,
+                                  unsigned transport_id,
+                                  const void *data, pj_size_t size,
+                                  const pj_sockaddr_t *dst_addr,
+                                  unsigned dst_addr_len)
+{
+    struct pace_ept *ept = (struct pace_ept*) ice->user_data;
+    struct pace_pkt *pkt;
+    pj_time_val delay = {0, PACE_DELAY};
+    unsigned i;
+    int dst_tp;
+
+    PJ_UNUSED_ARG(dst_addr_len);
+
+    /* The first (highest priority) candidate is unreachable */
+    dst_tp = pace_find_cand(ept->peer->ice, comp_id, dst_addr);
+    if (transport_id == 0 || dst_tp <= 0)
+        return PJ_SUCCESS;
+
+    if ((unsigned)(pj_rand() % 100) < pace_net.loss_pct)
+        return PJ_SUCCESS;
+
+    if (!pj_list_empty(&pace_net.free_list)) {
+        pkt = pace_net.free_list.next;
+        pj_list_erase(pkt);
+    } else {
+        pkt = PJ_POOL_ZALLOC_T(pace_net.pool, struct pace_pkt);
+    }
+
+    pkt->ice = ept->peer->ice;
+    pkt->comp_id = comp_id;
+    pkt->transport_id = dst_tp;
+    pkt->size = (unsigned)size;
+    pj_memcpy(pkt->data, data, size);
+    for (i=0; i<ice->lcand_cnt; ++i) {
+        if (ice->lcand[i].comp_id == comp_id &&
+            ice->lcand[i].transport_id == transport_id)
+        {
+            pj_sockaddr_cp(&pkt->src_addr, &ice->lcand[i].addr);
+            break;
+        }
+    }
+
+    pj_timer_entry_init(&pkt->timer, 0, pkt, &pace_on_deliver);
+    pj_list_push_back(&pace_net.pending, pkt);
+    pj_timer_heap_schedule(pace_net.stun_cfg->timer_heap, &pkt->timer,
+                           &delay);
+    return PJ_SUCCESS;
+}
+
+static void pace_on_rx_data(pj_ice_sess *ice, unsigned comp_id,
+                            unsigned transport_id,
+                            void *pkt, pj_size_t size,
+                            const pj_sockaddr_t *src_addr,
+                            unsigned src_addr_len)
+{
+    PJ_UNUSED_ARG(ice);
+    PJ_UNUSED_ARG(comp_id);
+    PJ_UNUSED_ARG(transport_id);
+    PJ_UNUSED_ARG(pkt);
+    PJ_UNUSED_ARG(size);
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(src_addr_len);
+}
+
+static int pace_create_ept(pj_stun_config *stun_cfg, pj_ice_sess_role role,
+                           const char *net, const pj_ice_sess_options *opt,
+                           struct pace_ept *ept)
+{
+    pj_ice_sess_cb cb;
+    unsigned comp_id, i;
+    pj_status_t status;
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_valid_pair = &pace_on_valid_pair;
+    cb.on_ice_complete = &pace_on_ice_complete;
+    cb.on_tx_pkt = &pace_on_tx_pkt;
+    cb.on_rx_data = &pace_on_rx_data;
+
+    pj_create_unique_string(pace_net.pool, &ept->ufrag);
+    pj_create_unique_string(pace_net.pool, &ept->pass);
+    ept->nego_status = PJ_EPENDING;
+
+    status = pj_ice_sess_create(stun_cfg, NULL, role, PACE_COMP_CNT, &cb,
+                                &ept->ufrag, &ept->pass, NULL, &ept->ice);
+    if (status != PJ_SUCCESS)
+        return -1;
+
+    ept->ice->user_data = ept;
+    pj_ice_sess_set_options(ept->ice, opt);
+
+    for (comp_id=1; comp_id<=PACE_COMP_CNT; ++comp_id) {
+        for (i=0; i<PACE_CAND_CNT; ++i) {
+            char host[PJ_INET6_ADDRSTRLEN];
+            pj_str_t foundation;
+            pj_sockaddr addr;
+
+            pj_ansi_snprintf(host, sizeof(host), "%s.%d", net, i+1);
+            pj_sockaddr_init(pj_AF_INET(), &addr, pj_cstr(&foundation, host),
+                             (pj_uint16_t)(4000 + comp_id));
+            pj_ice_calc_foundation(pace_net.pool, &foundation,
+                                   PJ_ICE_CAND_TYPE_HOST, &addr);
+
+            status = pj_ice_sess_add_cand(ept->ice, comp_id, i,
+                                          PJ_ICE_CAND_TYPE_HOST,
+                                          (pj_uint16_t)(65535 - i),
+                                          &foundation, &addr, &addr, NULL,
+                                          pj_sockaddr_get_len(&addr), NULL);
+            if (status != PJ_SUCCESS)
+                return -2;
+        }
+    }
+    return 0;
+}
+
+/* Run one negotiation, return the elapsed times in msec. The negotiation
+ * itself may fail when all retransmissions of a check are lost, this is
+ * reported in p_status.
+ */
+static int pace_run(pj_stun_config *stun_cfg, unsigned loss_pct,
+                    const pj_ice_sess_options *opt, pj_status_t *p_status,
+                    unsigned *valid_msec, unsigned *done_msec)
+{
+    struct pace_ept ept1, ept2;
+    pj_time_val t0, t;
+    int rc = 0;
+
+    pj_bzero(&ept1, sizeof(ept1));
+    pj_bzero(&ept2, sizeof(ept2));
+    ept1.peer = &ept2;
+    ept2.peer = &ept1;
+    pace_net.loss_pct = loss_pct;
+
+    if (pace_create_ept(stun_cfg, PJ_ICE_SESS_ROLE_CONTROLLING, "10.1.0",
+                        opt, &ept1) ||
+        pace_create_ept(stun_cfg, PJ_ICE_SESS_ROLE_CONTROLLED, "10.2.0",
+                        opt, &ept2))
+    {
+        rc = -5200;
+        goto on_return;
+    }
+
+    if (pj_ice_sess_create_check_list(ept1.ice, &ept2.ufrag, &ept2.pass,
+                                      ept2.ice->lcand_cnt,
+                                      ept2.ice->lcand) != PJ_SUCCESS ||
+        pj_ice_sess_create_check_list(ept2.ice, &ept1.ufrag, &ept1.pass,
+                                      ept1.ice->lcand_cnt,
+                                      ept1.ice->lcand) != PJ_SUCCESS)
+    {
+        rc = -5210;
+        goto on_return;
+    }
+
+    pj_gettickcount(&t0);
+    if (pj_ice_sess_start_check(ept1.ice) != PJ_SUCCESS ||
+        pj_ice_sess_start_check(ept2.ice) != PJ_SUCCESS)
+    {
+        rc = -5220;
+        goto on_return;
+    }
+
+    /* Once the controlling agent has failed, there is no point waiting
+     * for the controlled agent to time out waiting for nomination.
+     */
+    do {
+        poll_events(stun_cfg, 1, PJ_FALSE);
+        pj_gettickcount(&t);
+        PJ_TIME_VAL_SUB(t, t0);
+    } while ((ept1.nego_status == PJ_EPENDING ||
+              (ept1.nego_status == PJ_SUCCESS &&
+               ept2.nego_status == PJ_EPENDING)) &&
+             PJ_TIME_VAL_MSEC(t) < PACE_TIMEOUT);
+
+    if (ept1.nego_status == PJ_EPENDING ||
+        (ept1.nego_status == PJ_SUCCESS && ept2.nego_status == PJ_EPENDING))
+    {
+        PJ_LOG(3,(THIS_FILE, INDENT "err: negotiation timed out"));
+        rc = -5230;
+        goto on_return;
+    }
+
+    *p_status = (ept1.nego_status != PJ_SUCCESS ? ept1.nego_status :
+                 ept2.nego_status);
+    if (*p_status != PJ_SUCCESS)
+        goto on_return;
+
+    PJ_TIME_VAL_SUB(ept1.valid_time, t0);
+    PJ_TIME_VAL_SUB(ept1.done_time, t0);
+    *valid_msec = PJ_TIME_VAL_MSEC(ept1.valid_time);
+    *done_msec = PJ_TIME_VAL_MSEC(ept1.done_time);
+
+on_return:
+    if (ept1.ice)
+        pj_ice_sess_destroy(ept1.ice);
+    if (ept2.ice)
+        pj_ice_sess_destroy(ept2.ice);
+
+    /* Drop the packets still in flight */
+    while (!pj_list_empty(&pace_net.pending)) {
+        struct pace_pkt *pkt = pace_net.pending.next;
+        pj_timer_heap_cancel(stun_cfg->timer_heap, &pkt->timer);
+        pj_list_erase(pkt);
+        pj_list_push_back(&pace_net.free_list, pkt);
+    }
+    poll_events(stun_cfg, 10, PJ_FALSE);
+
+    return rc;
+}
+
+int ice_pacing_test(void)
+{
+    static const unsigned loss[] = { 0, 10, 30 };
+    pj_pool_t *pool;
+    pj_stun_config stun_cfg;
+    unsigned i, j, k;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "ICE check pacing over lossy network "
+              "(%d ms one-way delay)", PACE_DELAY));
+    pj_log_push_indent();
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    rc = create_stun_config(pool, &stun_cfg);
+    if (rc != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        pj_log_pop_indent();
+        return -5190;
+    }
+
+    pj_bzero(&pace_net, sizeof(pace_net));
+    pace_net.pool = pool;
+    pace_net.stun_cfg = &stun_cfg;
+    pj_list_init(&pace_net.pending);
+    pj_list_init(&pace_net.free_list);
+    pj_srand(0x1CE);
+
+    for (i=0; i<PJ_ARRAY_SIZE(loss) && rc==0; ++i) {
+        for (j=0; j<2 && rc==0; ++j) {
+            pj_ice_sess_options opt;
+            unsigned valid_sum = 0, done_sum = 0, ok_cnt = 0;
+
+            /* Regular nomination, fixed Ta vs adaptive scheduler */
+            pj_ice_sess_options_default(&opt);
+            opt.aggressive = PJ_FALSE;
+            opt.rtt_pacing = opt.parallel_comp = opt.early_nomination =
+                (j == 1);
+
+            for (k=0; k<PACE_RUNS && rc==0; ++k) {
+                unsigned valid_msec = 0, done_msec = 0;
+                pj_status_t status = PJ_SUCCESS;
+
+                rc = pace_run(&stun_cfg, loss[i], &opt, &status,
+                              &valid_msec, &done_msec);
+                if (rc == 0 && status == PJ_SUCCESS) {
+                    valid_sum += valid_msec;
+                    done_sum += done_msec;
+                    ++ok_cnt;
+                }
+            }
+            if (rc != 0)
+                break;
+
+            /* Failure is possible on lossy network, but not all the time */
+            if (ok_cnt == 0) {
+                PJ_LOG(3,(THIS_FILE, INDENT "err: all negotiations failed"));
+                rc = -5240;
+                break;
+            }
+
+            PJ_LOG(3,(THIS_FILE, INDENT "loss %2d%%, %-8s: first valid pair "
+                      "%4d ms, complete %4d ms (%d/%d ok)", loss[i],
+                      (j ? "adaptive" : "fixed"), valid_sum / ok_cnt,
+                      done_sum / ok_cnt, ok_cnt, PACE_RUNS));
+        }
+    }
+
+    destroy_stun_config(&stun_cfg);
+    pj_pool_release(pool);
+    pj_log_pop_indent();
+
+    return rc;
+}
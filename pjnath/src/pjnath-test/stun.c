@@ -956,6 +956,301 @@ static int handle_unknown_non_mandatory(void)
 }
 
 
+/* Parse messages with the zero-allocation view, and verify the
+ * MESSAGE-INTEGRITY with the key cache.
+ */
+static int view_test(void)
+{
+    static const pj_str_t REALM = {"pjsip.org", 9};
+    pj_pool_t *pool = pj_pool_create(mem, NULL, 1000, 1000, NULL);
+    struct test_vector *v = &test_vectors[0];
+    pj_str_t v_username, v_password, key;
+    pj_stun_key_cache cache;
+    const pj_stun_key_cache_entry *e;
+    pj_stun_msg_view view;
+    pj_stun_msg *msg, *msg1, *msg2;
+    pj_stun_auth_cred cred;
+    pj_sockaddr addr, addr2;
+    pj_uint8_t packet[500];
+    pj_str_t tmp;
+    pj_size_t len;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  message view and key cache"));
+
+    v_username = pj_str(v->username);
+    v_password = pj_str(v->password);
+    pj_stun_key_cache_init(&cache);
+
+    /* Binding request test vector */
+    status = pj_stun_msg_view_parse((pj_uint8_t*)v->pdu, v->pdu_len,
+                                    PJ_STUN_IS_DATAGRAM | PJ_STUN_CHECK_PACKET,
+                                    &view);
+    if (status != PJ_SUCCESS) {
+        rc = -4500;
+        goto on_return;
+    }
+    if (view.type != PJ_STUN_BINDING_REQUEST || view.msg_len != v->pdu_len ||
+        pj_memcmp(view.tsx_id, v->tsx_id, 12) ||
+        (view.flags & PJ_STUN_VIEW_HAS_PRIORITY) == 0 ||
+        view.priority != 0x6e0001ff ||
+        (view.flags & PJ_STUN_VIEW_HAS_ICE_CONTROLLED) == 0 ||
+        (view.flags & PJ_STUN_VIEW_HAS_FINGERPRINT) == 0 ||
+        pj_strcmp(&view.username, &v_username) || view.unknown_attr)
+    {
+        rc = -4510;
+        goto on_return;
+    }
+
+    /* Verify MESSAGE-INTEGRITY, with and without the cache */
+    if (pj_stun_authenticate_view(&view, &v_password, NULL) != PJ_SUCCESS ||
+        pj_stun_authenticate_view(&view, &v_password, &cache) != PJ_SUCCESS ||
+        pj_stun_authenticate_view(&view, &v_password, &cache) != PJ_SUCCESS ||
+        cache.hit_cnt != 1 || cache.miss_cnt != 1)
+    {
+        rc = -4520;
+        goto on_return;
+    }
+    if (pj_stun_authenticate_view(&view, &PASSWORD, &cache) == PJ_SUCCESS) {
+        rc = -4530;
+        goto on_return;
+    }
+
+    /* Message created from the view must match the decoded message */
+    pj_bzero(&cred, sizeof(cred));
+    cred.type = PJ_STUN_AUTH_CRED_STATIC;
+    cred.data.static_cred.username = v_username;
+    cred.data.static_cred.data_type = PJ_STUN_PASSWD_PLAIN;
+    cred.data.static_cred.data = v_password;
+    status = pj_stun_msg_decode(pool, (pj_uint8_t*)v->pdu, v->pdu_len,
+                                PJ_STUN_IS_DATAGRAM, &msg1, NULL, NULL);
+    if (status != PJ_SUCCESS ||
+        pj_stun_msg_view_to_msg(pool, &view, &msg2) != PJ_SUCCESS ||
+        cmp_msg(msg1, msg2) != 0 ||
+        pj_stun_authenticate_request((pj_uint8_t*)v->pdu, v->pdu_len, msg2,
+                                     &cred, pool, NULL, NULL) != PJ_SUCCESS)
+    {
+        rc = -4535;
+        goto on_return;
+    }
+
+    /* Long term key from the cache must match pj_stun_create_key() */
+    pj_stun_create_key(pool, &key, &REALM, &USERNAME, PJ_STUN_PASSWD_PLAIN,
+                       &PASSWORD);
+    e = pj_stun_key_cache_get(&cache, &REALM, &USERNAME,
+                              PJ_STUN_PASSWD_PLAIN, &PASSWORD);
+    if (!e || pj_strcmp(&e->key, &key) ||
+        pj_stun_key_cache_get(&cache, &REALM, &USERNAME,
+                              PJ_STUN_PASSWD_PLAIN, &PASSWORD) != e)
+    {
+        rc = -4540;
+        goto on_return;
+    }
+
+    /* Binding response with XOR-MAPPED-ADDRESS, signed with long term key */
+    pj_sockaddr_parse(pj_AF_INET(), 0, pj_cstr(&tmp, "192.0.2.1:3478"),
+                      &addr);
+    status = pj_stun_msg_create(pool, PJ_STUN_BINDING_RESPONSE, PJ_STUN_MAGIC,
+                                NULL, &msg);
+    status |= pj_stun_msg_add_sockaddr_attr(pool, msg,
+                                            PJ_STUN_ATTR_XOR_MAPPED_ADDR,
+                                            PJ_TRUE, &addr, sizeof(addr));
+    status |= pj_stun_msg_add_msgint_attr(pool, msg);
+    status |= pj_stun_msg_add_uint_attr(pool, msg, PJ_STUN_ATTR_FINGERPRINT, 0);
+    status |= pj_stun_msg_encode(msg, packet, sizeof(packet), 0, &key, &len);
+    if (status != PJ_SUCCESS) {
+        rc = -4550;
+        goto on_return;
+    }
+
+    status = pj_stun_msg_view_parse(packet, len, PJ_STUN_IS_DATAGRAM |
+                                    PJ_STUN_CHECK_PACKET, &view);
+    if (status != PJ_SUCCESS ||
+        pj_stun_msg_view_get_xor_mapped_addr(&view, &addr2) != PJ_SUCCESS ||
+        pj_sockaddr_cmp(&addr, &addr2) != 0 ||
+        pj_stun_authenticate_view(&view, &key, &cache) != PJ_SUCCESS)
+    {
+        rc = -4560;
+        goto on_return;
+    }
+    if (pj_stun_msg_view_to_msg(pool, &view, &msg2) != PJ_SUCCESS ||
+        cmp_msg(msg, msg2) != 0)
+    {
+        rc = -4565;
+        goto on_return;
+    }
+
+    /* Messages with other attributes must go through the decoder */
+    status = pj_stun_msg_create(pool, PJ_STUN_BINDING_REQUEST, PJ_STUN_MAGIC,
+                                NULL, &msg);
+    status |= pj_stun_msg_add_uint_attr(pool, msg, PJ_STUN_ATTR_LIFETIME, 60);
+    status |= pj_stun_msg_encode(msg, packet, sizeof(packet), 0, NULL, &len);
+    if (status != PJ_SUCCESS ||
+        pj_stun_msg_view_parse(packet, len, PJ_STUN_IS_DATAGRAM,
+                               &view) != PJ_SUCCESS ||
+        (view.flags & PJ_STUN_VIEW_HAS_OTHER) == 0 ||
+        pj_stun_msg_view_to_msg(pool, &view, &msg2) != PJ_ENOTSUP)
+    {
+        rc = -4568;
+        goto on_return;
+    }
+
+    /* Truncated and corrupted packets must be rejected */
+    if (pj_stun_msg_view_parse(packet, len-4, PJ_STUN_IS_DATAGRAM,
+                               &view) == PJ_SUCCESS)
+    {
+        rc = -4570;
+        goto on_return;
+    }
+    packet[22] ^= 0xFF;
+    if (pj_stun_msg_view_parse(packet, len, PJ_STUN_IS_DATAGRAM,
+                               &view) == PJ_SUCCESS)
+    {
+        rc = -4580;
+        goto on_return;
+    }
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+
+/* Compare decoding and authenticating Binding requests with the full
+ * decoder against the message view and key cache.
+ */
+static int auth_bench(void)
+{
+    enum { LOOP = 20000 };
+    static const pj_str_t REALM = {"pjsip.org", 9};
+    static const pj_str_t NONCE = {"1234567890abcdef", 16};
+    pj_pool_t *pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    pj_stun_auth_cred cred;
+    pj_stun_key_cache cache;
+    pj_stun_msg_view view;
+    pj_stun_msg *msg;
+    pj_timestamp t0, t1;
+    pj_uint8_t packet[500];
+    pj_str_t key;
+    pj_size_t len;
+    pj_uint32_t usec[3];
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  authentication benchmark (%d requests)", LOOP));
+
+    /* Binding request with long term credential */
+    pj_stun_create_key(pool, &key, &REALM, &USERNAME, PJ_STUN_PASSWD_PLAIN,
+                       &PASSWORD);
+    status = pj_stun_msg_create(pool, PJ_STUN_BINDING_REQUEST, PJ_STUN_MAGIC,
+                                NULL, &msg);
+    status |= pj_stun_msg_add_uint_attr(pool, msg, PJ_STUN_ATTR_PRIORITY,
+                                        0x6e0001ff);
+    status |= pj_stun_msg_add_string_attr(pool, msg, PJ_STUN_ATTR_USERNAME,
+                                          &USERNAME);
+    status |= pj_stun_msg_add_string_attr(pool, msg, PJ_STUN_ATTR_REALM,
+                                          &REALM);
+    status |= pj_stun_msg_add_string_attr(pool, msg, PJ_STUN_ATTR_NONCE,
+                                          &NONCE);
+    status |= pj_stun_msg_add_msgint_attr(pool, msg);
+    status |= pj_stun_msg_add_uint_attr(pool, msg, PJ_STUN_ATTR_FINGERPRINT, 0);
+    status |= pj_stun_msg_encode(msg, packet, sizeof(packet), 0, &key, &len);
+    if (status != PJ_SUCCESS) {
+        rc = -4600;
+        goto on_return;
+    }
+
+    pj_bzero(&cred, sizeof(cred));
+    cred.type = PJ_STUN_AUTH_CRED_STATIC;
+    cred.data.static_cred.realm = REALM;
+    cred.data.static_cred.username = USERNAME;
+    cred.data.static_cred.data_type = PJ_STUN_PASSWD_PLAIN;
+    cred.data.static_cred.data = PASSWORD;
+    cred.data.static_cred.nonce = NONCE;
+
+    /* Full decode, key calculated for each request */
+    pj_get_timestamp(&t0);
+    for (i=0; i<LOOP; ++i) {
+        pj_pool_reset(pool);
+        status = pj_stun_msg_decode(pool, packet, len, PJ_STUN_IS_DATAGRAM |
+                                    PJ_STUN_CHECK_PACKET, &msg, NULL, NULL);
+        if (status == PJ_SUCCESS)
+            status = pj_stun_authenticate_request(packet, (unsigned)len, msg,
+                                                  &cred, pool, NULL, NULL);
+        if (status != PJ_SUCCESS) {
+            rc = -4610;
+            goto on_return;
+        }
+    }
+    pj_get_timestamp(&t1);
+    usec[0] = pj_elapsed_usec(&t0, &t1);
+
+    /* Full decode, with the key cache */
+    pj_stun_key_cache_init(&cache);
+    pj_get_timestamp(&t0);
+    for (i=0; i<LOOP; ++i) {
+        pj_pool_reset(pool);
+        status = pj_stun_msg_decode(pool, packet, len, PJ_STUN_IS_DATAGRAM |
+                                    PJ_STUN_CHECK_PACKET, &msg, NULL, NULL);
+        if (status == PJ_SUCCESS)
+            status = pj_stun_authenticate_request2(packet, (unsigned)len, msg,
+                                                   &cred, &cache, pool, NULL,
+                                                   NULL);
+        if (status != PJ_SUCCESS) {
+            rc = -4620;
+            goto on_return;
+        }
+    }
+    pj_get_timestamp(&t1);
+    usec[1] = pj_elapsed_usec(&t0, &t1);
+
+    /* Message view, with the key cache */
+    pj_stun_key_cache_init(&cache);
+    pj_get_timestamp(&t0);
+    for (i=0; i<LOOP; ++i) {
+        const pj_stun_key_cache_entry *e;
+
+        status = pj_stun_msg_view_parse(packet, len, PJ_STUN_IS_DATAGRAM |
+                                        PJ_STUN_CHECK_PACKET, &view);
+        if (status != PJ_SUCCESS) {
+            rc = -4630;
+            goto on_return;
+        }
+        e = pj_stun_key_cache_get(&cache, &view.realm, &view.username,
+                                  PJ_STUN_PASSWD_PLAIN, &PASSWORD);
+        status = pj_stun_authenticate_view(&view, &e->key, &cache);
+        if (status != PJ_SUCCESS) {
+            rc = -4640;
+            goto on_return;
+        }
+    }
+    pj_get_timestamp(&t1);
+    usec[2] = pj_elapsed_usec(&t0, &t1);
+
+    /* One miss for the credential, and one for the key */
+    if (cache.miss_cnt != 2) {
+        rc = -4650;
+        goto on_return;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "    decode + authenticate     : %6u usec "
+                         "(%u ns/msg)", usec[0],
+                         (unsigned)((pj_uint64_t)usec[0] * 1000 / LOOP)));
+    PJ_LOG(3,(THIS_FILE, "    decode + cached key       : %6u usec "
+                         "(%u ns/msg)", usec[1],
+                         (unsigned)((pj_uint64_t)usec[1] * 1000 / LOOP)));
+    PJ_LOG(3,(THIS_FILE, "    view + cached key         : %6u usec "
+                         "(%u ns/msg)", usec[2],
+                         (unsigned)((pj_uint64_t)usec[2] * 1000 / LOOP)));
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+
 int stun_test(void)
 {
     int pad, rc;
@@ -978,6 +1273,14 @@ int stun_test(void)
     if (rc != 0)
         goto on_return;
 
+    rc = view_test();
+    if (rc != 0)
+        goto on_return;
+
+    rc = auth_bench();
+    if (rc != 0)
+        goto on_return;
+
 on_return:
     pj_stun_set_padding_char(pad);
     return rc;
@@ -221,6 +221,8 @@ static int test_inner(void)
 
 #if INCLUDE_ICE_TEST
     DO_TEST(ice_test());
+    DO_TEST(ice_mux_test());
+    DO_TEST(ice_pacing_test());
 #endif
 
 #if INCLUDE_TRICKLE_ICE_TEST
@@ -53,6 +53,8 @@ int stun_sock_test(void);
 int turn_sock_test(void);
 int ice_test(void);
 int trickle_ice_test(void);
+int ice_mux_test(void);
+int ice_pacing_test(void);
 int concur_test(void);
 int test_main(void);
 
@@ -325,6 +325,10 @@ PJ_DEF(void) pj_ice_sess_options_default(pj_ice_sess_options *opt)
     opt->controlled_agent_want_nom_timeout = 
         ICE_CONTROLLED_AGENT_WAIT_NOMINATION_TIMEOUT;
     opt->trickle = PJ_ICE_SESS_TRICKLE_DISABLED;
+    opt->lite = PJ_FALSE;
+    opt->rtt_pacing = PJ_FALSE;
+    opt->parallel_comp = PJ_FALSE;
+    opt->early_nomination = PJ_FALSE;
 }
 
 /*
@@ -381,6 +385,9 @@ PJ_DEF(pj_status_t) pj_ice_sess_create(pj_stun_config *stun_cfg,
 
     pj_memcpy(&ice->cb, cb, sizeof(*cb));
     pj_memcpy(&ice->stun_cfg, stun_cfg, sizeof(*stun_cfg));
+    ice->srtt = -1;
+    ice->ta = PJ_ICE_TA_VAL;
+    ice->max_rto = stun_cfg->rto_msec;
 
     ice->comp_cnt = comp_cnt;
     for (i=0; i<comp_cnt; ++i) {
@@ -465,6 +472,17 @@ PJ_DEF(pj_status_t) pj_ice_sess_set_options(pj_ice_sess *ice,
         }
     }
 
+    if (ice->opt.lite) {
+        /* ICE-lite agent is always the controlled agent */
+        if (ice->role != PJ_ICE_SESS_ROLE_CONTROLLED) {
+            LOG4((ice->obj_name, "ICE-lite agent, changing role to "
+                                 "controlled"));
+            pj_ice_sess_change_role(ice, PJ_ICE_SESS_ROLE_CONTROLLED);
+        }
+        LOG5((ice->obj_name, "ICE-lite mode is active"));
+        return PJ_SUCCESS;
+    }
+
     LOG5((ice->obj_name, "ICE nomination type set to %s",
           (ice->opt.aggressive ? "aggressive" : "regular")));
     return PJ_SUCCESS;
@@ -1618,6 +1636,43 @@ static pj_bool_t check_ice_complete(pj_ice_sess *ice)
             return PJ_FALSE;
         }
 
+        /* With early nomination, don't wait for the remaining checks if
+         * every component already has a valid pair not using relay.
+         */
+        if (ice->opt.early_nomination) {
+            for (i=0; i<ice->comp_cnt; ++i) {
+                const pj_ice_sess_check *vc = ice->comp[i].valid_check;
+                if (vc->lcand->type == PJ_ICE_CAND_TYPE_RELAYED ||
+                    vc->rcand->type == PJ_ICE_CAND_TYPE_RELAYED)
+                {
+                    break;
+                }
+            }
+
+            if (i == ice->comp_cnt) {
+                LOG4((ice->obj_name,
+                      "All components have a direct valid pair, starting "
+                      "early nomination now"));
+
+                /* The remaining pairs will never be checked once nomination
+                 * is started, remove them so that failure of the nominated
+                 * check ends the checklist.
+                 */
+                for (i=0; i<ice->clist.count; ++i) {
+                    pj_ice_sess_check *c = &ice->clist.checks[i];
+                    if (c->state == PJ_ICE_SESS_CHECK_STATE_FROZEN ||
+                        c->state == PJ_ICE_SESS_CHECK_STATE_WAITING)
+                    {
+                        check_set_state(ice, c, PJ_ICE_SESS_CHECK_STATE_FAILED,
+                                        PJ_ECANCELLED);
+                    }
+                }
+
+                start_nominated_check(ice);
+                return PJ_FALSE;
+            }
+        }
+
         LOG4((ice->obj_name, 
               "Scheduling nominated check in %d ms",
               ice->opt.nominated_check_delay));
@@ -1950,6 +2005,7 @@ static pj_status_t add_rcand_and_update_checklist(
             chk->rcand = rcand;
             chk->prio = CALC_CHECK_PRIO(ice, lcand, rcand);
             chk->state = PJ_ICE_SESS_CHECK_STATE_FROZEN;
+            chk->rtt = -1;
             chk->foundation_idx = get_check_foundation_idx(ice, lcand, rcand,
                                                            PJ_TRUE);
 
@@ -2322,6 +2378,10 @@ static pj_status_t perform_check(pj_ice_sess *ice,
         return status;
     }
 
+    /* Remember when the request was sent for RTT measurement */
+    pj_gettickcount(&check->tx_time);
+    check->tx_rto = ice->stun_cfg.rto_msec;
+
     check_set_state(ice, check, PJ_ICE_SESS_CHECK_STATE_IN_PROGRESS, 
                     PJ_SUCCESS);
     pj_log_pop_indent();
@@ -2329,6 +2389,63 @@ static pj_status_t perform_check(pj_ice_sess *ice,
 }
 
 
+/* Update RTT estimate from a successful check, and adjust Ta and the
+ * retransmission timeout of subsequent checks accordingly (RFC 6298
+ * style smoothing, rtt_pacing option).
+ */
+static void update_rtt(pj_ice_sess *ice, pj_ice_sess_check *check)
+{
+    pj_time_val now;
+    unsigned rtt, rto;
+
+    if (!ice->opt.rtt_pacing)
+        return;
+
+    pj_gettickcount(&now);
+    PJ_TIME_VAL_SUB(now, check->tx_time);
+    if (now.sec < 0)
+        return;
+    rtt = PJ_TIME_VAL_MSEC(now);
+
+    /* Karn's algorithm: the response may belong to a retransmission
+     * if it arrives after the initial retransmission timeout, so the
+     * sample is ambiguous.
+     */
+    if (rtt >= check->tx_rto)
+        return;
+
+    check->rtt = rtt;
+
+    if (ice->srtt < 0) {
+        ice->srtt = rtt;
+        ice->rttvar = rtt / 2;
+    } else {
+        int delta = ice->srtt - (int)rtt;
+        if (delta < 0) delta = -delta;
+        ice->rttvar = (3 * ice->rttvar + delta) / 4;
+        ice->srtt = (7 * ice->srtt + (int)rtt) / 8;
+    }
+
+    rto = ice->srtt + 4 * ice->rttvar;
+    if (rto < PJ_ICE_MIN_RTO)
+        rto = PJ_ICE_MIN_RTO;
+    if (rto > ice->max_rto)
+        rto = ice->max_rto;
+    ice->stun_cfg.rto_msec = rto;
+
+    ice->ta = ice->srtt;
+    if (ice->ta < PJ_ICE_TA_MIN_VAL)
+        ice->ta = PJ_ICE_TA_MIN_VAL;
+    if (ice->ta > PJ_ICE_TA_VAL)
+        ice->ta = PJ_ICE_TA_VAL;
+
+    LOG5((ice->obj_name, "Check %ld rtt=%ums, srtt=%dms, rttvar=%dms: "
+          "Ta=%ums, RTO=%ums",
+          GET_CHECK_ID(&ice->clist, check), rtt, ice->srtt, ice->rttvar,
+          ice->ta, rto));
+}
+
+
 /* Start periodic check for the specified checklist.
  * This callback is called by timer on every Ta (20msec by default)
  */
@@ -2338,8 +2455,8 @@ static pj_status_t start_periodic_check(pj_timer_heap_t *th,
     timer_data *td;
     pj_ice_sess *ice;
     pj_ice_sess_checklist *clist;
-    pj_ice_sess_check *check = NULL;
-    unsigned i, check_idx = 0;
+    unsigned check_ids[PJ_ICE_MAX_COMP];
+    unsigned i, check_cnt = 0;
     pj_status_t status;
 
     td = (struct timer_data*) te->user_data;
@@ -2367,12 +2484,16 @@ static pj_status_t start_periodic_check(pj_timer_heap_t *th,
      *   of each component.
      * - Otherwise, check any first/highest-prio pair in Waiting, or Frozen
      *   if no pair is in Waiting.
+     * With parallel_comp option, one pair is picked for each component,
+     * otherwise only one pair is picked for the whole checklist.
      */
     if (ice->is_nominating && !ice->opt.aggressive) {
         /* ICE is nominating in regular nomination, find any first valid pair,
          * the pair should already be in Waiting state.
          */
-        for (i=0; i<ice->comp_cnt && !check; ++i) {
+        for (i=0; i<ice->comp_cnt && (!check_cnt || ice->opt.parallel_comp);
+             ++i)
+        {
             unsigned j;
             const pj_ice_sess_check *vc = ice->comp[i].valid_check;
             for (j=0; j<ice->clist.count; ++j) {
@@ -2381,8 +2502,7 @@ static pj_status_t start_periodic_check(pj_timer_heap_t *th,
                     c->lcand->transport_id == vc->lcand->transport_id &&
                     c->rcand == vc->rcand)
                 {
-                    check = c;
-                    check_idx = j;
+                    check_ids[check_cnt++] = j;
                     break;
                 }
             }
@@ -2390,50 +2510,78 @@ static pj_status_t start_periodic_check(pj_timer_heap_t *th,
 
     } else {
         /* Not nominating or in aggressive-nomination mode */
+        unsigned comp_id = (ice->opt.parallel_comp ? 1 : 0);
 
-        /* Find any pair with highest priority on Waiting state. */
-        for (i=0; i<clist->count; ++i) {
-            pj_ice_sess_check *c = &clist->checks[i];
-            if (c->state == PJ_ICE_SESS_CHECK_STATE_WAITING) {
-                check = c;
-                check_idx = i;
-                break;
-            }
-        }
+        do {
+            int idx = -1;
 
-        /* If we don't have anything in Waiting state, find any pair with
-         * highest priority in Frozen state.
-         */
-        if (!check) {
+            /* Find any pair with highest priority on Waiting state. */
             for (i=0; i<clist->count; ++i) {
                 pj_ice_sess_check *c = &clist->checks[i];
-                if (c->state == PJ_ICE_SESS_CHECK_STATE_FROZEN) {
-                    check = c;
-                    check_idx = i;
+                if (c->state == PJ_ICE_SESS_CHECK_STATE_WAITING &&
+                    (!comp_id || c->lcand->comp_id == comp_id))
+                {
+                    idx = i;
                     break;
                 }
             }
-        }
+
+            /* If we don't have anything in Waiting state, find any pair with
+             * highest priority in Frozen state.
+             */
+            if (idx < 0) {
+                for (i=0; i<clist->count; ++i) {
+                    pj_ice_sess_check *c = &clist->checks[i];
+                    if (c->state == PJ_ICE_SESS_CHECK_STATE_FROZEN &&
+                        (!comp_id || c->lcand->comp_id == comp_id))
+                    {
+                        idx = i;
+                        break;
+                    }
+                }
+            }
+
+            if (idx >= 0)
+                check_ids[check_cnt++] = idx;
+
+        } while (ice->opt.parallel_comp && ++comp_id <= ice->comp_cnt);
     }
 
     /* Perform check & schedule next check for next candidate pair,
      * unless there is no suitable candidate pair (all pairs have been checked
      * or empty checklist).
      */
-    if (check) {
+    if (check_cnt) {
         pj_time_val timeout = {0, PJ_ICE_TA_VAL};
 
-        status = perform_check(ice, clist, check_idx, ice->is_nominating);
-        if (status != PJ_SUCCESS) {
-            check_set_state(ice, check,
-                            PJ_ICE_SESS_CHECK_STATE_FAILED, status);
-            on_check_complete(ice, check);
+        if (ice->opt.rtt_pacing)
+            timeout.msec = ice->ta;
+
+        for (i=0; i<check_cnt && !ice->is_complete; ++i) {
+            pj_ice_sess_check *check = &clist->checks[check_ids[i]];
+
+            /* Another check may have been completed by the previous one */
+            if (check->state != PJ_ICE_SESS_CHECK_STATE_WAITING &&
+                check->state != PJ_ICE_SESS_CHECK_STATE_FROZEN)
+            {
+                continue;
+            }
+
+            status = perform_check(ice, clist, check_ids[i],
+                                   ice->is_nominating);
+            if (status != PJ_SUCCESS) {
+                check_set_state(ice, check,
+                                PJ_ICE_SESS_CHECK_STATE_FAILED, status);
+                on_check_complete(ice, check);
+            }
         }
 
         /* Schedule next check */
-        pj_time_val_normalize(&timeout);
-        pj_timer_heap_schedule_w_grp_lock(th, te, &timeout, PJ_TRUE,
-                                          ice->grp_lock);
+        if (!ice->is_complete) {
+            pj_time_val_normalize(&timeout);
+            pj_timer_heap_schedule_w_grp_lock(th, te, &timeout, PJ_TRUE,
+                                              ice->grp_lock);
+        }
     }
 
     pj_grp_lock_release(ice->grp_lock);
@@ -2610,12 +2758,14 @@ PJ_DEF(pj_status_t) pj_ice_sess_start_check(pj_ice_sess *ice)
     }
     pj_list_init(&ice->early_check);
 
-    /* Start periodic check */
+    /* Start periodic check, unless we are ICE-lite agent which never
+     * sends any checks.
+     */
     /* We could start it immediately like below, but lets schedule timer 
      * instead to reduce stack usage:
      * return start_periodic_check(ice->stun_cfg.timer_heap, &clist->timer);
      */
-    if (!pj_timer_entry_running(&clist->timer)) {
+    if (!ice->opt.lite && !pj_timer_entry_running(&clist->timer)) {
         pj_time_val delay = {0, 0};
         status = pj_timer_heap_schedule_w_grp_lock(ice->stun_cfg.timer_heap,
                                                    &clist->timer, &delay,
@@ -2751,6 +2901,9 @@ static void on_stun_request_complete(pj_stun_session *stun_sess,
     //pj_assert(tdata == check->tdata);
     check->tdata = NULL;
 
+    if (status == PJ_SUCCESS)
+        update_rtt(ice, check);
+
     /* Init lcand to NULL. lcand will be found from the mapped address
      * found in the response.
      */
@@ -3039,9 +3192,12 @@ static void on_stun_request_complete(pj_stun_session *stun_sess,
         new_check->state = PJ_ICE_SESS_CHECK_STATE_SUCCEEDED;
         new_check->nominated = check->nominated;
         new_check->err_code = PJ_SUCCESS;
+        new_check->rtt = check->rtt;
     } else {
         new_check = &ice->valid_list.checks[i];
         ice->valid_list.checks[i].nominated = check->nominated;
+        if (check->rtt >= 0)
+            ice->valid_list.checks[i].rtt = check->rtt;
     }
 
     /* Update valid check and nominated check for the component */
@@ -3164,8 +3320,11 @@ static pj_status_t on_stun_rx_request(pj_stun_session *sess,
     }
 
     /* 7.2.1.1.  Detecting and Repairing Role Conflicts
+     * (ICE-lite agent is always controlled, so it never changes role).
      */
-    if (ice->role == PJ_ICE_SESS_ROLE_CONTROLLING &&
+    if (ice->opt.lite) {
+        /* Nothing to do */
+    } else if (ice->role == PJ_ICE_SESS_ROLE_CONTROLLING &&
         role_attr && role_attr->hdr.type == PJ_STUN_ATTR_ICE_CONTROLLING)
     {
         if (pj_cmp_timestamp(&ice->tie_breaker, &role_attr->value) < 0) {
@@ -3305,6 +3464,96 @@ static pj_status_t on_stun_rx_request(pj_stun_session *sess,
 }
 
 
+/* ICE-lite: a check from the remote full agent has been received and
+ * responded. Since we don't send checks, the pair becomes valid as soon as
+ * the request is received, and it is nominated when the request contains
+ * USE-CANDIDATE (RFC 8445 Section 7.3.1.5).
+ */
+static void handle_lite_check(pj_ice_sess *ice,
+                              pj_ice_sess_cand *lcand,
+                              pj_ice_sess_cand *rcand,
+                              pj_bool_t use_candidate)
+{
+    pj_ice_sess_check *c, *vc;
+    unsigned i;
+
+    /* Find the pair in the checklist, or add it */
+    for (i=0; i<ice->clist.count; ++i) {
+        c = &ice->clist.checks[i];
+        if (c->lcand == lcand && c->rcand == rcand)
+            break;
+    }
+
+    if (i == ice->clist.count) {
+        if (ice->clist.count >= PJ_ICE_MAX_CHECKS) {
+            LOG4((ice->obj_name, "Error: unable to add ICE-lite pair: "
+                 "TOO MANY CHECKS IN CHECKLIST!"));
+            return;
+        }
+
+        c = &ice->clist.checks[ice->clist.count++];
+        c->lcand = lcand;
+        c->rcand = rcand;
+        c->prio = CALC_CHECK_PRIO(ice, lcand, rcand);
+        c->foundation_idx = get_check_foundation_idx(ice, lcand, rcand,
+                                                     PJ_TRUE);
+        c->nominated = PJ_FALSE;
+        c->tdata = NULL;
+        c->rtt = -1;
+
+        LOG4((ice->obj_name, "New ICE-lite pair added: %d", i));
+    } else {
+        c = &ice->clist.checks[i];
+    }
+
+    c->nominated = (use_candidate || c->nominated);
+
+    /* Add pair to valid list, if it's not there, otherwise just update
+     * nominated flag
+     */
+    for (i=0; i<ice->valid_list.count; ++i) {
+        if (ice->valid_list.checks[i].lcand == lcand &&
+            ice->valid_list.checks[i].rcand == rcand)
+            break;
+    }
+
+    if (i == ice->valid_list.count) {
+        if (ice->valid_list.count >= PJ_ICE_MAX_CHECKS)
+            return;
+
+        vc = &ice->valid_list.checks[ice->valid_list.count++];
+        vc->lcand = lcand;
+        vc->rcand = rcand;
+        vc->prio = c->prio;
+        vc->state = PJ_ICE_SESS_CHECK_STATE_SUCCEEDED;
+        vc->nominated = c->nominated;
+        vc->err_code = PJ_SUCCESS;
+        vc->rtt = -1;
+    } else {
+        vc = &ice->valid_list.checks[i];
+        vc->nominated = c->nominated;
+    }
+
+    /* Update valid check and nominated check for the component, then
+     * sort the valid list (must be in this order, see #953).
+     */
+    update_comp_check(ice, lcand->comp_id, vc);
+    sort_checklist(ice, &ice->valid_list);
+
+    if (c->state != PJ_ICE_SESS_CHECK_STATE_SUCCEEDED) {
+        check_set_state(ice, c, PJ_ICE_SESS_CHECK_STATE_SUCCEEDED,
+                        PJ_SUCCESS);
+    } else if (!use_candidate) {
+        /* Nothing new */
+        return;
+    }
+
+    pj_log_push_indent();
+    on_check_complete(ice, c);
+    pj_log_pop_indent();
+}
+
+
 /* Handle incoming Binding request and perform triggered check.
  * This function may be called by on_stun_rx_request(), or when
  * SDP answer is received and we have received early checks.
@@ -3414,6 +3663,12 @@ static void handle_incoming_check(pj_ice_sess *ice,
      * Create candidate pair for this request. 
      */
 
+    /* ICE-lite agent doesn't perform triggered checks */
+    if (ice->opt.lite) {
+        handle_lite_check(ice, lcand, rcand, rcheck->use_candidate);
+        return;
+    }
+
     /* 
      * 7.2.1.4.  Triggered Checks
      *
@@ -3533,6 +3788,7 @@ static void handle_incoming_check(pj_ice_sess *ice,
         c->state = PJ_ICE_SESS_CHECK_STATE_WAITING;
         c->nominated = rcheck->use_candidate;
         c->err_code = PJ_SUCCESS;
+        c->rtt = -1;
         ++ice->clist.count;
 
         LOG4((ice->obj_name, "New triggered check added: %d", check_id));
@@ -20,7 +20,9 @@
 #include <pjnath/errno.h>
 #include <pj/addr_resolv.h>
 #include <pj/array.h>
+#include <pj/activesock.h>
 #include <pj/assert.h>
+#include <pj/hash.h>
 #include <pj/ip_helper.h>
 #include <pj/lock.h>
 #include <pj/log.h>
@@ -44,7 +46,8 @@ enum tp_type
 {
     TP_NONE,
     TP_STUN,
-    TP_TURN
+    TP_TURN,
+    TP_MUX
 };
 
 
@@ -133,7 +136,6 @@ static void turn_on_state(pj_turn_sock *turn_sock, pj_turn_state_t old_state,
                           pj_turn_state_t new_state);
 
 
-
 /* Forward decls */
 static pj_bool_t on_data_sent(pj_ice_strans *ice_st, pj_ssize_t sent);
 static void check_pending_send(pj_ice_strans *ice_st);
@@ -142,6 +144,14 @@ static void destroy_ice_st(pj_ice_strans *ice_st);
 #define ice_st_perror(ice_st,msg,rc) pjnath_perror(ice_st->obj_name,msg,rc)
 static void sess_init_update(pj_ice_strans *ice_st);
 
+
+/* Key of the multiplexer remote address table. */
+typedef struct mux_addr_key
+{
+    pj_uint32_t          sock_idx;      /**< Multiplexer socket index.  */
+    pj_sockaddr          addr;          /**< Remote address.            */
+} mux_addr_key;
+
 /**
  * This structure describes an ICE stream transport component. A component
  * in ICE stream transport typically corresponds to a single socket created
@@ -179,6 +189,12 @@ typedef struct pj_ice_strans_comp
 
     unsigned             default_cand;  /**< Default candidate.         */
 
+    struct {
+        pj_bool_t        routed;        /**< Remote address routed?     */
+        mux_addr_key     key;           /**< Routed remote address.     */
+        pj_hash_entry_buf he;           /**< Entry in the route table.  */
+    } mux;
+
 } pj_ice_strans_comp;
 
 
@@ -232,6 +248,9 @@ struct pj_ice_strans
                                                signalled end of candidate? */
     pj_bool_t                loc_cand_end;/**< Trickle ICE: local has
                                                signalled end of candidate? */
+
+    pj_str_t                 mux_ufrag; /**< Ufrag registered to mux.   */
+    pj_hash_entry_buf        mux_he;    /**< Entry in the ufrag table.  */
 };
 
 
@@ -247,6 +266,71 @@ typedef struct sock_user_data
 } sock_user_data;
 
 
+/**
+ * This structure describes a shared socket of ICE stream transport
+ * multiplexer.
+ */
+typedef struct mux_sock
+{
+    pj_ice_strans_mux   *mux;           /**< The multiplexer.           */
+    unsigned             idx;           /**< Socket index.              */
+    pj_activesock_t     *asock;         /**< Active socket.             */
+    pj_sockaddr          addr;          /**< Published address.         */
+} mux_sock;
+
+
+/**
+ * Pending send operation on a multiplexer socket. The packet is copied
+ * to the operation's buffer, which stays valid until the send completes.
+ */
+typedef struct mux_send_op
+{
+    PJ_DECL_LIST_MEMBER(struct mux_send_op);
+    pj_ioqueue_op_key_t  key;           /**< Send key.                  */
+    pj_ice_strans_comp  *comp;          /**< The sending component.     */
+    pj_uint8_t          *buf;           /**< Packet buffer.             */
+} mux_send_op;
+
+
+/**
+ * ICE stream transport multiplexer.
+ */
+struct pj_ice_strans_mux
+{
+    char                    *obj_name;  /**< Log ID.                    */
+    pj_pool_t               *pool;      /**< Pool used by this object.  */
+    pj_grp_lock_t           *grp_lock;  /**< Group lock.                */
+    pj_lock_t               *lock;      /**< Protects the tables.       */
+    pj_ice_strans_mux_cfg    cfg;       /**< Settings.                  */
+    unsigned                 sock_cnt;  /**< Number of sockets.         */
+    mux_sock                *sock;      /**< Sockets array.             */
+    pj_hash_table_t         *ufrag_tbl; /**< Local ufrag -> ice_st.     */
+    pj_hash_table_t         *addr_tbl;  /**< Remote address -> comp.    */
+    mux_send_op              free_send_op; /**< Free send operations.   */
+    unsigned                 send_op_cnt; /**< Send operations created. */
+    pj_uint32_t              rx_pkt;    /**< Packets delivered.         */
+    pj_uint32_t              rx_drop;   /**< Packets dropped.           */
+    pj_bool_t                is_destroying; /**< Destroy requested?     */
+};
+
+
+/* Receive path */
+static void comp_on_rx_pkt(pj_ice_strans_comp *comp,
+                           unsigned transport_id,
+                           void *pkt, unsigned pkt_len,
+                           const pj_sockaddr_t *src_addr,
+                           unsigned addr_len);
+
+/* Multiplexer functions */
+static pj_status_t mux_register(pj_ice_strans *ice_st);
+static void mux_unregister(pj_ice_strans *ice_st);
+static void mux_update_routes(pj_ice_strans *ice_st);
+static pj_status_t mux_sendto(pj_ice_strans_comp *comp,
+                              const void *pkt, pj_size_t size,
+                              const pj_sockaddr_t *dst_addr,
+                              unsigned dst_addr_len);
+
+
 /* Validate configuration */
 static pj_status_t pj_ice_strans_cfg_check_valid(const pj_ice_strans_cfg *cfg)
 {
@@ -773,6 +857,28 @@ static pj_status_t create_comp(pj_ice_strans *ice_st, unsigned comp_id)
     /* Initialize default candidate */
     comp->default_cand = 0;
 
+    /* Use the multiplexer socket as the only host candidate */
+    if (ice_st->cfg.mux) {
+        pj_ice_sess_cand *cand = &comp->cand_list[comp->cand_cnt++];
+        char addrinfo[PJ_INET6_ADDRSTRLEN+10];
+
+        cand->type = PJ_ICE_CAND_TYPE_HOST;
+        cand->status = PJ_SUCCESS;
+        cand->local_pref = HOST_PREF;
+        cand->transport_id = CREATE_TP_ID(TP_MUX, 0);
+        cand->comp_id = (pj_uint8_t) comp_id;
+        pj_ice_strans_mux_get_addr(ice_st->cfg.mux, comp_id-1, &cand->addr);
+        pj_sockaddr_cp(&cand->base_addr, &cand->addr);
+        pj_bzero(&cand->rel_addr, sizeof(cand->rel_addr));
+        pj_ice_calc_foundation(ice_st->pool, &cand->foundation,
+                               cand->type, &cand->base_addr);
+
+        PJ_LOG(4,(ice_st->obj_name,
+                  "Comp %d: multiplexed host candidate %s added",
+                  comp_id, pj_sockaddr_print(&cand->addr, addrinfo,
+                                             sizeof(addrinfo), 3)));
+    }
+
     /* Create STUN transport if configured */
     for (i=0; i<ice_st->cfg.stun_tp_cnt; ++i) {
         unsigned max_cand_cnt = PJ_ICE_ST_MAX_CAND - comp->cand_cnt -
@@ -876,6 +982,7 @@ PJ_DEF(pj_status_t) pj_ice_strans_create( const char *name,
 
     PJ_ASSERT_RETURN(comp_cnt && cb && p_ice_st &&
                      comp_cnt <= PJ_ICE_MAX_COMP , PJ_EINVAL);
+    PJ_ASSERT_RETURN(!cfg->mux || comp_cnt <= cfg->mux->sock_cnt, PJ_EINVAL);
 
     if (name == NULL)
         name = "ice%p";
@@ -930,6 +1037,15 @@ PJ_DEF(pj_status_t) pj_ice_strans_create( const char *name,
         ice_st->cfg.turn_tp[0] = ice_st->cfg.turn;
     }
 
+    /* With multiplexer, the shared sockets are the only transport, and
+     * the session runs in ICE-lite mode.
+     */
+    if (ice_st->cfg.mux) {
+        ice_st->cfg.stun_tp_cnt = 0;
+        ice_st->cfg.turn_tp_cnt = 0;
+        ice_st->cfg.opt.lite = PJ_TRUE;
+    }
+
     for (i=0; i<ice_st->cfg.stun_tp_cnt; ++i)
         ice_st->cfg.stun_tp[i].cfg.grp_lock = ice_st->grp_lock;
     for (i=0; i<ice_st->cfg.turn_tp_cnt; ++i)
@@ -1023,6 +1139,10 @@ static void destroy_ice_st(pj_ice_strans *ice_st)
 
     ice_st->destroy_req = PJ_TRUE;
 
+    /* Stop receiving packets from the multiplexer */
+    if (ice_st->cfg.mux)
+        mux_unregister(ice_st);
+
     /* Destroy ICE if we have ICE */
     if (ice_st->ice) {
         pj_ice_sess *ice = ice_st->ice;
@@ -1378,6 +1498,13 @@ PJ_DEF(pj_status_t) pj_ice_strans_init_ice(pj_ice_strans *ice_st,
         }
     }
 
+    /* Receive the checks for our ufrag from the multiplexer */
+    if (ice_st->cfg.mux) {
+        status = mux_register(ice_st);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+
     /* ICE session is ready for negotiation */
     ice_st->state = PJ_ICE_STRANS_STATE_SESS_READY;
 
@@ -1742,6 +1869,9 @@ PJ_DEF(pj_status_t) pj_ice_strans_stop_ice(pj_ice_strans *ice_st)
      */
     pj_grp_lock_acquire(ice_st->grp_lock);
 
+    if (ice_st->cfg.mux)
+        mux_unregister(ice_st);
+
     if (ice_st->ice) {
         ice_st->ice_prev = ice_st->ice;
         ice_st->ice = NULL;
@@ -1867,7 +1997,10 @@ static pj_status_t send_data(pj_ice_strans *ice_st,
     if (def_cand->status == PJ_SUCCESS) {
         unsigned tp_idx = GET_TP_IDX(def_cand->transport_id);
 
-        if (def_cand->type == PJ_ICE_CAND_TYPE_RELAYED) {
+        if (GET_TP_TYPE(def_cand->transport_id) == TP_MUX) {
+            status = mux_sendto(comp, buf, data_len, dst_addr, dst_addr_len);
+            goto on_return;
+        } else if (def_cand->type == PJ_ICE_CAND_TYPE_RELAYED) {
 
             enum {
                 msg_disable_ind = 0xFFFF &
@@ -1997,6 +2130,9 @@ static void on_valid_pair(pj_ice_sess *ice)
 
     pj_grp_lock_add_ref(ice_st->grp_lock);
 
+    if (ice_st->cfg.mux)
+        mux_update_routes(ice_st);
+
     pj_gettimeofday(&t);
     PJ_TIME_VAL_SUB(t, ice_st->start_time);
     msec = PJ_TIME_VAL_MSEC(t);
@@ -2081,6 +2217,9 @@ static void on_ice_complete(pj_ice_sess *ice, pj_status_t status)
 
     pj_grp_lock_add_ref(ice_st->grp_lock);
 
+    if (ice_st->cfg.mux && status == PJ_SUCCESS)
+        mux_update_routes(ice_st);
+
     pj_gettimeofday(&t);
     PJ_TIME_VAL_SUB(t, ice_st->start_time);
     msec = PJ_TIME_VAL_MSEC(t);
@@ -2220,6 +2359,8 @@ static pj_status_t ice_tx_pkt(pj_ice_sess *ice,
         } else {
             status = PJ_EINVALIDOP;
         }
+    } else if (tp_typ == TP_MUX) {
+        status = mux_sendto(comp, buf, size, dst_addr, dst_addr_len);
     } else if (tp_typ == TP_STUN) {
         const pj_sockaddr_t *dest_addr;
         unsigned dest_addr_len;
@@ -2333,9 +2474,7 @@ static pj_bool_t stun_on_rx_data(pj_stun_sock *stun_sock,
                                  unsigned addr_len)
 {
     sock_user_data *data;
-    pj_ice_strans_comp *comp;
     pj_ice_strans *ice_st;
-    pj_status_t status;
 
     data = (sock_user_data*) pj_stun_sock_get_user_data(stun_sock);
     if (data == NULL) {
@@ -2343,11 +2482,28 @@ static pj_bool_t stun_on_rx_data(pj_stun_sock *stun_sock,
         return PJ_FALSE;
     }
 
-    comp = data->comp;
-    ice_st = comp->ice_st;
+    ice_st = data->comp->ice_st;
 
     pj_grp_lock_add_ref(ice_st->grp_lock);
 
+    comp_on_rx_pkt(data->comp, data->transport_id, pkt, pkt_len,
+                   src_addr, addr_len);
+
+    return pj_grp_lock_dec_ref(ice_st->grp_lock) ? PJ_FALSE : PJ_TRUE;
+}
+
+/* Hand over incoming packet received by a component transport to the ICE
+ * session, or to application if there is no ICE session.
+ */
+static void comp_on_rx_pkt(pj_ice_strans_comp *comp,
+                           unsigned transport_id,
+                           void *pkt, unsigned pkt_len,
+                           const pj_sockaddr_t *src_addr,
+                           unsigned addr_len)
+{
+    pj_ice_strans *ice_st = comp->ice_st;
+    pj_status_t status;
+
     if (ice_st->ice == NULL) {
         /* The ICE session is gone, but we're still receiving packets.
          * This could also happen if remote doesn't do ICE. So just
@@ -2362,7 +2518,7 @@ static pj_bool_t stun_on_rx_data(pj_stun_sock *stun_sock,
 
         /* Hand over the packet to ICE session */
         status = pj_ice_sess_on_rx_pkt(comp->ice_st->ice, comp->comp_id,
-                                       data->transport_id,
+                                       transport_id,
                                        pkt, pkt_len,
                                        src_addr, addr_len);
 
@@ -2371,8 +2527,6 @@ static pj_bool_t stun_on_rx_data(pj_stun_sock *stun_sock,
                           status);
         }
     }
-
-    return pj_grp_lock_dec_ref(ice_st->grp_lock) ? PJ_FALSE : PJ_TRUE;
 }
 
 /* Notifification when asynchronous send operation to the STUN socket
@@ -2951,3 +3105,576 @@ on_return:
     pj_log_pop_indent();
 }
 
+
+
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * ICE stream transport multiplexer.
+ */
+
+
+static pj_bool_t mux_on_data_recvfrom(pj_activesock_t *asock,
+                                      void *data,
+                                      pj_size_t size,
+                                      const pj_sockaddr_t *src_addr,
+                                      int addr_len,
+                                      pj_status_t status);
+static pj_bool_t mux_on_data_sent(pj_activesock_t *asock,
+                                  pj_ioqueue_op_key_t *send_key,
+                                  pj_ssize_t sent);
+
+
+/* Initialize the key of remote address table */
+static void mux_init_key(mux_addr_key *key, unsigned sock_idx,
+                         const pj_sockaddr_t *addr)
+{
+    const pj_sockaddr *a = (const pj_sockaddr*)addr;
+
+    /* Copy the address field by field so that the padding is always zero */
+    pj_bzero(key, sizeof(*key));
+    key->sock_idx = sock_idx;
+    key->addr.addr.sa_family = a->addr.sa_family;
+    pj_sockaddr_copy_addr(&key->addr, a);
+    pj_sockaddr_set_port(&key->addr, pj_sockaddr_get_port(a));
+}
+
+
+/*
+ * Initialize multiplexer settings with default values.
+ */
+PJ_DEF(void) pj_ice_strans_mux_cfg_default(pj_ice_strans_mux_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+
+    cfg->af = pj_AF_INET();
+    cfg->sock_cnt = 2;
+    cfg->max_pkt_size = PJ_STUN_SOCK_PKT_LEN;
+    cfg->async_cnt = 1;
+}
+
+
+/* Create and bind one shared socket */
+static pj_status_t mux_create_sock(pj_ice_strans_mux *mux,
+                                   const pj_stun_config *stun_cfg,
+                                   unsigned idx)
+{
+    mux_sock *ms = &mux->sock[idx];
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_sockaddr bound_addr;
+    pj_activesock_cfg activesock_cfg;
+    pj_activesock_cb activesock_cb;
+    int addr_len;
+    pj_status_t status;
+
+    ms->mux = mux;
+    ms->idx = idx;
+
+    pj_sockaddr_init(mux->cfg.af, &bound_addr, NULL, 0);
+    if (mux->cfg.bound_addr.addr.sa_family == pj_AF_INET() ||
+        mux->cfg.bound_addr.addr.sa_family == pj_AF_INET6())
+    {
+        pj_uint16_t port = pj_sockaddr_get_port(&mux->cfg.bound_addr);
+
+        pj_sockaddr_cp(&bound_addr, &mux->cfg.bound_addr);
+        if (port)
+            pj_sockaddr_set_port(&bound_addr, (pj_uint16_t)(port + idx));
+    }
+
+    status = pj_sock_socket(bound_addr.addr.sa_family, pj_SOCK_DGRAM(), 0,
+                            &sock);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* Apply socket buffer size */
+    if (mux->cfg.so_rcvbuf_size > 0) {
+        unsigned sobuf_size = mux->cfg.so_rcvbuf_size;
+        status = pj_sock_setsockopt_sobuf(sock, pj_SO_RCVBUF(),
+                                          PJ_TRUE, &sobuf_size);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(3, (mux->obj_name, status,
+                          "Failed setting SO_RCVBUF"));
+        }
+    }
+    if (mux->cfg.so_sndbuf_size > 0) {
+        unsigned sobuf_size = mux->cfg.so_sndbuf_size;
+        status = pj_sock_setsockopt_sobuf(sock, pj_SO_SNDBUF(),
+                                          PJ_TRUE, &sobuf_size);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(3, (mux->obj_name, status,
+                          "Failed setting SO_SNDBUF"));
+        }
+    }
+
+    status = pj_sock_bind(sock, &bound_addr,
+                          pj_sockaddr_get_len(&bound_addr));
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    /* Get the published address, use the default host address if the
+     * socket is bound to any address.
+     */
+    addr_len = sizeof(ms->addr);
+    status = pj_sock_getsockname(sock, &ms->addr, &addr_len);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    if (!pj_sockaddr_has_addr(&ms->addr)) {
+        pj_sockaddr host_addr;
+
+        status = pj_gethostip(ms->addr.addr.sa_family, &host_addr);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        pj_sockaddr_copy_addr(&ms->addr, &host_addr);
+    }
+
+    pj_activesock_cfg_default(&activesock_cfg);
+    activesock_cfg.grp_lock = mux->grp_lock;
+    activesock_cfg.async_cnt = mux->cfg.async_cnt;
+
+    pj_bzero(&activesock_cb, sizeof(activesock_cb));
+    activesock_cb.on_data_recvfrom = &mux_on_data_recvfrom;
+    activesock_cb.on_data_sent = &mux_on_data_sent;
+
+    status = pj_activesock_create(mux->pool, sock, pj_SOCK_DGRAM(),
+                                  &activesock_cfg, stun_cfg->ioqueue,
+                                  &activesock_cb, ms, &ms->asock);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    status = pj_activesock_start_recvfrom(ms->asock, mux->pool,
+                                          mux->cfg.max_pkt_size, 0);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    return PJ_SUCCESS;
+
+on_error:
+    pj_sock_close(sock);
+    return status;
+}
+
+
+/* Really destroy the multiplexer */
+static void mux_on_destroy(void *obj)
+{
+    pj_ice_strans_mux *mux = (pj_ice_strans_mux*)obj;
+
+    if (mux->lock) {
+        pj_lock_destroy(mux->lock);
+        mux->lock = NULL;
+    }
+
+    PJ_LOG(4,(mux->obj_name, "ICE stream transport mux destroyed"));
+    pj_pool_safe_release(&mux->pool);
+}
+
+
+/*
+ * Create the multiplexer.
+ */
+PJ_DEF(pj_status_t) pj_ice_strans_mux_create(const pj_stun_config *stun_cfg,
+                                             const char *name,
+                                             const pj_ice_strans_mux_cfg *cfg,
+                                             pj_ice_strans_mux **p_mux)
+{
+    pj_pool_t *pool;
+    pj_ice_strans_mux *mux;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(stun_cfg && stun_cfg->pf && stun_cfg->ioqueue &&
+                     cfg && p_mux, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cfg->sock_cnt > 0 && cfg->sock_cnt <= PJ_ICE_MAX_COMP &&
+                     cfg->max_pkt_size > 0 && cfg->async_cnt > 0, PJ_EINVAL);
+
+    if (name == NULL)
+        name = "icemux%p";
+
+    pool = pj_pool_create(stun_cfg->pf, name, 1000, 1000, NULL);
+    mux = PJ_POOL_ZALLOC_T(pool, pj_ice_strans_mux);
+    mux->pool = pool;
+    mux->obj_name = pool->obj_name;
+    pj_memcpy(&mux->cfg, cfg, sizeof(*cfg));
+
+    status = pj_grp_lock_create(pool, NULL, &mux->grp_lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+    pj_grp_lock_add_ref(mux->grp_lock);
+    pj_grp_lock_add_handler(mux->grp_lock, pool, mux, &mux_on_destroy);
+
+    status = pj_lock_create_simple_mutex(pool, mux->obj_name, &mux->lock);
+    if (status != PJ_SUCCESS) {
+        pj_ice_strans_mux_destroy(mux);
+        return status;
+    }
+
+    mux->ufrag_tbl = pj_hash_create(pool, PJ_ICE_ST_MUX_HASH_SIZE);
+    mux->addr_tbl = pj_hash_create(pool, PJ_ICE_ST_MUX_HASH_SIZE);
+    pj_list_init(&mux->free_send_op);
+
+    mux->sock = (mux_sock*)
+                pj_pool_calloc(pool, cfg->sock_cnt, sizeof(mux_sock));
+    for (i=0; i<cfg->sock_cnt; ++i) {
+        char addrinfo[PJ_INET6_ADDRSTRLEN+10];
+
+        status = mux_create_sock(mux, stun_cfg, i);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(3,(mux->obj_name, status,
+                         "Failed creating mux socket %d", i));
+            pj_ice_strans_mux_destroy(mux);
+            return status;
+        }
+        ++mux->sock_cnt;
+
+        PJ_LOG(4,(mux->obj_name, "Mux socket %d bound to %s", i,
+                  pj_sockaddr_print(&mux->sock[i].addr, addrinfo,
+                                    sizeof(addrinfo), 3)));
+    }
+
+    *p_mux = mux;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Destroy the multiplexer.
+ */
+PJ_DEF(pj_status_t) pj_ice_strans_mux_destroy(pj_ice_strans_mux *mux)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(mux, PJ_EINVAL);
+
+    pj_grp_lock_acquire(mux->grp_lock);
+
+    if (mux->is_destroying) {
+        pj_grp_lock_release(mux->grp_lock);
+        return PJ_SUCCESS;
+    }
+
+    mux->is_destroying = PJ_TRUE;
+
+    if (mux->ufrag_tbl && pj_hash_count(mux->ufrag_tbl)) {
+        PJ_LOG(2,(mux->obj_name, "Warning: destroying mux while %d ICE "
+                  "stream transport(s) still use it",
+                  pj_hash_count(mux->ufrag_tbl)));
+    }
+
+    for (i=0; i<mux->sock_cnt; ++i) {
+        if (mux->sock[i].asock) {
+            pj_activesock_close(mux->sock[i].asock);
+            mux->sock[i].asock = NULL;
+        }
+    }
+
+    pj_grp_lock_dec_ref(mux->grp_lock);
+    pj_grp_lock_release(mux->grp_lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get the address of a multiplexer socket.
+ */
+PJ_DEF(pj_status_t) pj_ice_strans_mux_get_addr(pj_ice_strans_mux *mux,
+                                               unsigned sock_idx,
+                                               pj_sockaddr *addr)
+{
+    PJ_ASSERT_RETURN(mux && addr && sock_idx < mux->sock_cnt, PJ_EINVAL);
+    pj_sockaddr_cp(addr, &mux->sock[sock_idx].addr);
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get the multiplexer statistics.
+ */
+PJ_DEF(pj_status_t) pj_ice_strans_mux_get_stat(pj_ice_strans_mux *mux,
+                                               pj_ice_strans_mux_stat *stat)
+{
+    PJ_ASSERT_RETURN(mux && stat, PJ_EINVAL);
+
+    pj_lock_acquire(mux->lock);
+    stat->sess_cnt = pj_hash_count(mux->ufrag_tbl);
+    stat->route_cnt = pj_hash_count(mux->addr_tbl);
+    stat->rx_pkt = mux->rx_pkt;
+    stat->rx_drop = mux->rx_drop;
+    pj_lock_release(mux->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Register the local ufrag of the ICE session of the ICE stream
+ * transport, so that incoming checks are dispatched to it.
+ */
+static pj_status_t mux_register(pj_ice_strans *ice_st)
+{
+    pj_ice_strans_mux *mux = ice_st->cfg.mux;
+    const pj_str_t *ufrag = &ice_st->ice->rx_ufrag;
+
+    pj_lock_acquire(mux->lock);
+
+    if (pj_hash_get(mux->ufrag_tbl, ufrag->ptr, (unsigned)ufrag->slen,
+                    NULL) != NULL)
+    {
+        pj_lock_release(mux->lock);
+        PJ_LOG(3,(ice_st->obj_name, "Error: ufrag %.*s is already "
+                  "registered in mux", (int)ufrag->slen, ufrag->ptr));
+        return PJ_EEXISTS;
+    }
+
+    /* The ufrag belongs to the ICE session, which is destroyed only after
+     * we unregister.
+     */
+    ice_st->mux_ufrag = *ufrag;
+    pj_hash_set_np(mux->ufrag_tbl, ice_st->mux_ufrag.ptr,
+                   (unsigned)ice_st->mux_ufrag.slen, 0, ice_st->mux_he,
+                   ice_st);
+
+    pj_lock_release(mux->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Remove the remote address route of a component. Mux lock must be held. */
+static void mux_remove_route(pj_ice_strans_mux *mux, pj_ice_strans_comp *comp)
+{
+    if (comp->mux.routed) {
+        pj_hash_set_np(mux->addr_tbl, &comp->mux.key, sizeof(mux_addr_key),
+                       0, comp->mux.he, NULL);
+        comp->mux.routed = PJ_FALSE;
+    }
+}
+
+
+/* Remove ICE stream transport ufrag and routes from the multiplexer */
+static void mux_unregister(pj_ice_strans *ice_st)
+{
+    pj_ice_strans_mux *mux = ice_st->cfg.mux;
+    unsigned i;
+
+    pj_lock_acquire(mux->lock);
+
+    if (ice_st->mux_ufrag.slen) {
+        pj_hash_set_np(mux->ufrag_tbl, ice_st->mux_ufrag.ptr,
+                       (unsigned)ice_st->mux_ufrag.slen, 0, ice_st->mux_he,
+                       NULL);
+        ice_st->mux_ufrag.slen = 0;
+    }
+
+    for (i=0; i<ice_st->comp_cnt; ++i) {
+        if (ice_st->comp[i])
+            mux_remove_route(mux, ice_st->comp[i]);
+    }
+
+    pj_lock_release(mux->lock);
+}
+
+
+/* Route packets from the remote address of the valid pair of each
+ * component to the component.
+ */
+static void mux_update_routes(pj_ice_strans *ice_st)
+{
+    pj_ice_strans_mux *mux = ice_st->cfg.mux;
+    unsigned i;
+
+    if (ice_st->ice == NULL)
+        return;
+
+    pj_lock_acquire(mux->lock);
+
+    for (i=0; i<ice_st->comp_cnt && i<ice_st->ice->comp_cnt; ++i) {
+        pj_ice_strans_comp *comp = ice_st->comp[i];
+        const pj_ice_sess_check *check = ice_st->ice->comp[i].valid_check;
+        mux_addr_key key;
+
+        if (!comp || !check)
+            continue;
+
+        mux_init_key(&key, i, &check->rcand->addr);
+        if (comp->mux.routed) {
+            if (pj_memcmp(&key, &comp->mux.key, sizeof(key)) == 0)
+                continue;
+            mux_remove_route(mux, comp);
+        }
+
+        /* The same remote address may not be routed to two components */
+        if (pj_hash_get(mux->addr_tbl, &key, sizeof(key), NULL) != NULL) {
+            char addrinfo[PJ_INET6_ADDRSTRLEN+10];
+
+            PJ_LOG(3,(ice_st->obj_name, "Comp %d: remote address %s is "
+                      "already routed to other transport in mux",
+                      i+1, pj_sockaddr_print(&check->rcand->addr, addrinfo,
+                                             sizeof(addrinfo), 3)));
+            continue;
+        }
+
+        pj_memcpy(&comp->mux.key, &key, sizeof(key));
+        pj_hash_set_np(mux->addr_tbl, &comp->mux.key, sizeof(mux_addr_key),
+                       0, comp->mux.he, comp);
+        comp->mux.routed = PJ_TRUE;
+    }
+
+    pj_lock_release(mux->lock);
+}
+
+
+/* Send packet via the multiplexer socket of the component */
+static pj_status_t mux_sendto(pj_ice_strans_comp *comp,
+                              const void *pkt, pj_size_t size,
+                              const pj_sockaddr_t *dst_addr,
+                              unsigned dst_addr_len)
+{
+    pj_ice_strans_mux *mux = comp->ice_st->cfg.mux;
+    pj_activesock_t *asock = mux->sock[comp->comp_id-1].asock;
+    mux_send_op *op;
+    pj_ssize_t len = size;
+    pj_status_t status;
+
+    if (asock == NULL)
+        return PJ_EINVALIDOP;
+
+    if (size > mux->cfg.max_pkt_size)
+        return PJ_ETOOBIG;
+
+    /* Previous sends may still be pending, get a free send operation */
+    pj_lock_acquire(mux->lock);
+    if (!pj_list_empty(&mux->free_send_op)) {
+        op = mux->free_send_op.next;
+        pj_list_erase(op);
+    } else if (mux->send_op_cnt < PJ_ICE_ST_MUX_MAX_PENDING_SEND) {
+        op = PJ_POOL_ZALLOC_T(mux->pool, mux_send_op);
+        op->buf = (pj_uint8_t*) pj_pool_alloc(mux->pool,
+                                              mux->cfg.max_pkt_size);
+        pj_ioqueue_op_key_init(&op->key, sizeof(op->key));
+        op->key.user_data = op;
+        ++mux->send_op_cnt;
+    } else {
+        op = NULL;
+    }
+    pj_lock_release(mux->lock);
+
+    if (op == NULL)
+        return PJ_EBUSY;
+
+    op->comp = comp;
+    pj_memcpy(op->buf, pkt, size);
+
+    /* Keep the transport alive until pending send has completed */
+    pj_grp_lock_add_ref(comp->ice_st->grp_lock);
+
+    status = pj_activesock_sendto(asock, &op->key, op->buf, &len, 0,
+                                  dst_addr, dst_addr_len);
+    if (status != PJ_EPENDING) {
+        pj_lock_acquire(mux->lock);
+        pj_list_push_back(&mux->free_send_op, op);
+        pj_lock_release(mux->lock);
+        pj_grp_lock_dec_ref(comp->ice_st->grp_lock);
+    }
+
+    return status;
+}
+
+
+/* Incoming packet on a multiplexer socket */
+static pj_bool_t mux_on_data_recvfrom(pj_activesock_t *asock,
+                                      void *data,
+                                      pj_size_t size,
+                                      const pj_sockaddr_t *src_addr,
+                                      int addr_len,
+                                      pj_status_t status)
+{
+    mux_sock *ms = (mux_sock*) pj_activesock_get_user_data(asock);
+    pj_ice_strans_mux *mux = ms->mux;
+    pj_ice_strans_comp *comp = NULL;
+    pj_ice_strans *ice_st;
+    pj_stun_msg_view view;
+
+    if (mux->is_destroying)
+        return PJ_FALSE;
+
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4,(mux->obj_name, status, "recvfrom() error"));
+        return PJ_TRUE;
+    }
+
+    pj_lock_acquire(mux->lock);
+
+    status = pj_stun_msg_view_parse((const pj_uint8_t*)data, size,
+                                    PJ_STUN_IS_DATAGRAM |
+                                        PJ_STUN_CHECK_PACKET,
+                                    &view);
+    if (status == PJ_SUCCESS && (view.flags & PJ_STUN_VIEW_HAS_USERNAME)) {
+        /* Connectivity check: USERNAME is "local-ufrag:remote-ufrag" */
+        pj_str_t ufrag = view.username;
+        const char *colon;
+
+        colon = (const char*) pj_memchr(ufrag.ptr, ':', ufrag.slen);
+        if (colon)
+            ufrag.slen = colon - ufrag.ptr;
+
+        ice_st = (pj_ice_strans*)
+                 pj_hash_get(mux->ufrag_tbl, ufrag.ptr, (unsigned)ufrag.slen,
+                             NULL);
+        if (ice_st && ms->idx < ice_st->comp_cnt)
+            comp = ice_st->comp[ms->idx];
+    } else {
+        /* Anything else must come from a nominated remote address */
+        mux_addr_key key;
+
+        mux_init_key(&key, ms->idx, src_addr);
+        comp = (pj_ice_strans_comp*)
+               pj_hash_get(mux->addr_tbl, &key, sizeof(key), NULL);
+    }
+
+    if (comp) {
+        ice_st = comp->ice_st;
+        pj_grp_lock_add_ref(ice_st->grp_lock);
+        ++mux->rx_pkt;
+    } else {
+        ++mux->rx_drop;
+    }
+
+    pj_lock_release(mux->lock);
+
+    if (comp == NULL) {
+        TRACE_PKT((mux->obj_name, "Dropped %lu bytes packet on socket %d",
+                   (unsigned long)size, ms->idx));
+        return PJ_TRUE;
+    }
+
+    comp_on_rx_pkt(comp, CREATE_TP_ID(TP_MUX, 0), data, (unsigned)size,
+                   src_addr, addr_len);
+
+    pj_grp_lock_dec_ref(ice_st->grp_lock);
+
+    return PJ_TRUE;
+}
+
+
+/* Asynchronous send on a multiplexer socket has completed */
+static pj_bool_t mux_on_data_sent(pj_activesock_t *asock,
+                                  pj_ioqueue_op_key_t *send_key,
+                                  pj_ssize_t sent)
+{
+    mux_sock *ms = (mux_sock*) pj_activesock_get_user_data(asock);
+    mux_send_op *op = (mux_send_op*) send_key->user_data;
+    pj_ice_strans *ice_st = op->comp->ice_st;
+
+    pj_lock_acquire(ms->mux->lock);
+    pj_list_push_back(&ms->mux->free_send_op, op);
+    pj_lock_release(ms->mux->lock);
+
+    on_data_sent(ice_st, sent);
+    pj_grp_lock_dec_ref(ice_st->grp_lock);
+
+    return PJ_TRUE;
+}
@@ -22,6 +22,7 @@
 #include <pjlib-util/md5.h>
 #include <pjlib-util/sha1.h>
 #include <pj/assert.h>
+#include <pj/hash.h>
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/string.h>
@@ -161,6 +162,211 @@ PJ_INLINE(void) PUT_VAL16(pj_uint8_t *buf, unsigned pos, pj_uint16_t hval)
 }
 
 
+/* Calculate MESSAGE-INTEGRITY of the packet. The amsgi_pos is the position
+ * of the MESSAGE-INTEGRITY attribute, relative to the end of the header.
+ * If keyed context is specified, it is used instead of initializing the
+ * HMAC with the key.
+ */
+static void calc_msgint(const pj_hmac_sha1_context *keyed,
+                        const pj_str_t *key,
+                        const pj_uint8_t *pkt,
+                        unsigned amsgi_pos,
+                        pj_bool_t has_attr_beyond_mi,
+                        pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE])
+{
+    pj_hmac_sha1_context ctx;
+
+    if (keyed) {
+        pj_memcpy(&ctx, keyed, sizeof(ctx));
+    } else {
+        pj_hmac_sha1_init(&ctx, (const pj_uint8_t*)key->ptr,
+                          (unsigned)key->slen);
+    }
+
+#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
+    /* Pre rfc3489bis-06 style of calculation */
+    PJ_UNUSED_ARG(has_attr_beyond_mi);
+    pj_hmac_sha1_update(&ctx, pkt, 20);
+#else
+    /* First calculate HMAC for the header.
+     * The calculation is different depending on whether FINGERPRINT attribute
+     * is present in the message.
+     */
+    if (has_attr_beyond_mi) {
+        pj_uint8_t hdr_copy[20];
+        pj_memcpy(hdr_copy, pkt, 20);
+        PUT_VAL16(hdr_copy, 2, (pj_uint16_t)(amsgi_pos + 24));
+        pj_hmac_sha1_update(&ctx, hdr_copy, 20);
+    } else {
+        pj_hmac_sha1_update(&ctx, pkt, 20);
+    }
+#endif  /* PJ_STUN_OLD_STYLE_MI_FINGERPRINT */
+
+    /* Now update with the message body */
+    pj_hmac_sha1_update(&ctx, pkt+20, amsgi_pos);
+#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
+    // This is no longer necessary as per rfc3489bis-08
+    if ((amsgi_pos+20) & 0x3F) {
+        pj_uint8_t zeroes[64];
+        pj_bzero(zeroes, sizeof(zeroes));
+        pj_hmac_sha1_update(&ctx, zeroes, 64-((amsgi_pos+20) & 0x3F));
+    }
+#endif
+    pj_hmac_sha1_final(&ctx, digest);
+}
+
+
+/*
+ * Key cache.
+ */
+PJ_DEF(void) pj_stun_key_cache_init(pj_stun_key_cache *cache)
+{
+    PJ_ASSERT_ON_FAIL(cache, return);
+
+    cache->count = cache->next = 0;
+    cache->hit_cnt = cache->miss_cnt = 0;
+}
+
+/* Find entry by its id, or add a new one with the specified key */
+static const pj_stun_key_cache_entry *key_cache_lookup(
+                                            pj_stun_key_cache *cache,
+                                            const char *id,
+                                            unsigned id_len,
+                                            const pj_str_t *realm,
+                                            const pj_str_t *username,
+                                            pj_stun_passwd_type data_type,
+                                            const pj_str_t *data)
+{
+    pj_stun_key_cache_entry *e;
+    pj_uint32_t hash;
+    unsigned i;
+
+    hash = pj_hash_calc(0, id, id_len);
+    for (i=0; i<cache->count; ++i) {
+        e = &cache->entry[i];
+        if (e->hash == hash && e->id_len == id_len &&
+            pj_memcmp(e->id, id, id_len) == 0)
+        {
+            ++cache->hit_cnt;
+            return e;
+        }
+    }
+
+    /* Not found, replace the oldest entry if the cache is full */
+    ++cache->miss_cnt;
+    if (cache->count < PJ_STUN_KEY_CACHE_SIZE) {
+        e = &cache->entry[cache->count++];
+    } else {
+        e = &cache->entry[cache->next];
+        cache->next = (cache->next + 1) % PJ_STUN_KEY_CACHE_SIZE;
+    }
+
+    e->hash = hash;
+    e->id_len = id_len;
+    pj_memcpy(e->id, id, id_len);
+
+    /* Derive the key, the same way as pj_stun_create_key() */
+    e->key.ptr = e->key_buf;
+    if (realm && realm->slen && data_type == PJ_STUN_PASSWD_PLAIN) {
+        calc_md5_key((pj_uint8_t*)e->key_buf, realm, username, data);
+        e->key.slen = 16;
+    } else {
+        pj_memcpy(e->key_buf, data->ptr, data->slen);
+        e->key.slen = data->slen;
+    }
+
+    pj_hmac_sha1_init(&e->hmac, (const pj_uint8_t*)e->key.ptr,
+                      (unsigned)e->key.slen);
+
+    return e;
+}
+
+PJ_DEF(const pj_stun_key_cache_entry*)
+pj_stun_key_cache_get(pj_stun_key_cache *cache,
+                      const pj_str_t *realm,
+                      const pj_str_t *username,
+                      pj_stun_passwd_type data_type,
+                      const pj_str_t *data)
+{
+    char id[PJ_STUN_KEY_CACHE_MAX_LEN + 4];
+    pj_ssize_t realm_len = realm ? realm->slen : 0;
+    char *p = id;
+
+    PJ_ASSERT_RETURN(cache && username && data, NULL);
+
+    if (PJ_STUN_KEY_CACHE_SIZE == 0 ||
+        realm_len + username->slen + data->slen > PJ_STUN_KEY_CACHE_MAX_LEN)
+    {
+        return NULL;
+    }
+
+    /* The id: 'c', data type, lengths of realm and username, followed
+     * by realm, username, and password.
+     */
+    *p++ = 'c';
+    *p++ = (char)data_type;
+    *p++ = (char)realm_len;
+    *p++ = (char)username->slen;
+    if (realm_len) {
+        pj_memcpy(p, realm->ptr, realm_len);
+        p += realm_len;
+    }
+    pj_memcpy(p, username->ptr, username->slen);
+    p += username->slen;
+    pj_memcpy(p, data->ptr, data->slen);
+    p += data->slen;
+
+    return key_cache_lookup(cache, id, (unsigned)(p - id), realm, username,
+                            data_type, data);
+}
+
+PJ_DEF(const pj_stun_key_cache_entry*)
+pj_stun_key_cache_get_by_key(pj_stun_key_cache *cache,
+                             const pj_str_t *key)
+{
+    char id[PJ_STUN_KEY_CACHE_MAX_LEN + 4];
+
+    PJ_ASSERT_RETURN(cache && key, NULL);
+
+    if (PJ_STUN_KEY_CACHE_SIZE == 0 ||
+        key->slen > PJ_STUN_KEY_CACHE_MAX_LEN)
+    {
+        return NULL;
+    }
+
+    /* The id: 'k' followed by the key */
+    id[0] = 'k';
+    id[1] = id[2] = id[3] = 0;
+    pj_memcpy(id+4, key->ptr, key->slen);
+
+    return key_cache_lookup(cache, id, (unsigned)key->slen + 4, NULL, NULL,
+                            PJ_STUN_PASSWD_HASHED, key);
+}
+
+
+/* Create the key, using the cache if it's specified */
+static const pj_stun_key_cache_entry *create_key(pj_stun_key_cache *cache,
+                                                 pj_pool_t *pool,
+                                                 pj_str_t *key,
+                                                 const pj_str_t *realm,
+                                                 const pj_str_t *username,
+                                                 pj_stun_passwd_type data_type,
+                                                 const pj_str_t *data)
+{
+    const pj_stun_key_cache_entry *e = NULL;
+
+    if (cache)
+        e = pj_stun_key_cache_get(cache, realm, username, data_type, data);
+
+    if (e)
+        pj_strdup(pool, key, &e->key);
+    else
+        pj_stun_create_key(pool, key, realm, username, data_type, data);
+
+    return e;
+}
+
+
 /* Send 401 response */
 static pj_status_t create_challenge(pj_pool_t *pool,
                                     const pj_stun_msg *msg,
@@ -218,15 +424,30 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
                                                  pj_pool_t *pool,
                                                  pj_stun_req_cred_info *p_info,
                                                  pj_stun_msg **p_response)
+{
+    return pj_stun_authenticate_request2(pkt, pkt_len, msg, cred, NULL,
+                                         pool, p_info, p_response);
+}
+
+
+/* Verify credential in the request, using the key cache */
+PJ_DEF(pj_status_t) pj_stun_authenticate_request2(const pj_uint8_t *pkt,
+                                                  unsigned pkt_len,
+                                                  const pj_stun_msg *msg,
+                                                  pj_stun_auth_cred *cred,
+                                                  pj_stun_key_cache *cache,
+                                                  pj_pool_t *pool,
+                                                  pj_stun_req_cred_info *p_info,
+                                                  pj_stun_msg **p_response)
 {
     pj_stun_req_cred_info tmp_info;
+    const pj_stun_key_cache_entry *key_entry = NULL;
     const pj_stun_msgint_attr *amsgi;
     unsigned i, amsgi_pos;
     pj_bool_t has_attr_beyond_mi;
     const pj_stun_username_attr *auser;
     const pj_stun_realm_attr *arealm;
     const pj_stun_realm_attr *anonce;
-    pj_hmac_sha1_context ctx;
     pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE];
     pj_stun_status err_code;
     const char *err_text = NULL;
@@ -324,9 +545,10 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
         if (username_ok) {
             pj_strdup(pool, &p_info->username, 
                       &cred->data.static_cred.username);
-            pj_stun_create_key(pool, &p_info->auth_key, &p_info->realm,
-                               &auser->value, cred->data.static_cred.data_type,
-                               &cred->data.static_cred.data);
+            key_entry = create_key(cache, pool, &p_info->auth_key,
+                                   &p_info->realm, &auser->value,
+                                   cred->data.static_cred.data_type,
+                                   &cred->data.static_cred.data);
             /* Unlikely to happen but this makes static analyzers happy */
             PJ_ASSERT_RETURN(p_info->auth_key.ptr, PJ_EBUG);
         } else {
@@ -349,9 +571,9 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
                                               &data_type, &password);
         if (rc == PJ_SUCCESS) {
             pj_strdup(pool, &p_info->username, &auser->value);
-            pj_stun_create_key(pool, &p_info->auth_key, 
-                               (arealm?&arealm->value:NULL), &auser->value, 
-                               data_type, &password);
+            key_entry = create_key(cache, pool, &p_info->auth_key,
+                                   (arealm?&arealm->value:NULL),
+                                   &auser->value, data_type, &password);
             /* Unlikely to happen but this makes static analyzers happy */
             PJ_ASSERT_RETURN(p_info->auth_key.ptr, PJ_EBUG);
         } else {
@@ -445,39 +667,8 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
     }
 
     /* Now calculate HMAC of the message. */
-    pj_hmac_sha1_init(&ctx, (pj_uint8_t*)p_info->auth_key.ptr, 
-                      (unsigned)p_info->auth_key.slen);
-
-#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
-    /* Pre rfc3489bis-06 style of calculation */
-    pj_hmac_sha1_update(&ctx, pkt, 20);
-#else
-    /* First calculate HMAC for the header.
-     * The calculation is different depending on whether FINGERPRINT attribute
-     * is present in the message.
-     */
-    if (has_attr_beyond_mi) {
-        pj_uint8_t hdr_copy[20];
-        pj_memcpy(hdr_copy, pkt, 20);
-        PUT_VAL16(hdr_copy, 2, (pj_uint16_t)(amsgi_pos + 24));
-        pj_hmac_sha1_update(&ctx, hdr_copy, 20);
-    } else {
-        pj_hmac_sha1_update(&ctx, pkt, 20);
-    }
-#endif  /* PJ_STUN_OLD_STYLE_MI_FINGERPRINT */
-
-    /* Now update with the message body */
-    pj_hmac_sha1_update(&ctx, pkt+20, amsgi_pos);
-#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
-    // This is no longer necessary as per rfc3489bis-08
-    if ((amsgi_pos+20) & 0x3F) {
-        pj_uint8_t zeroes[64];
-        pj_bzero(zeroes, sizeof(zeroes));
-        pj_hmac_sha1_update(&ctx, zeroes, 64-((amsgi_pos+20) & 0x3F));
-    }
-#endif
-    pj_hmac_sha1_final(&ctx, digest);
-
+    calc_msgint(key_entry ? &key_entry->hmac : NULL, &p_info->auth_key,
+                pkt, amsgi_pos, has_attr_beyond_mi, digest);
 
     /* Compare HMACs */
     if (pj_memcmp(amsgi->hmac, digest, 20)) {
@@ -548,11 +739,22 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
                                                   unsigned pkt_len,
                                                   const pj_stun_msg *msg,
                                                   const pj_str_t *key)
+{
+    return pj_stun_authenticate_response2(pkt, pkt_len, msg, key, NULL);
+}
+
+
+/* Authenticate MESSAGE-INTEGRITY in the response, using the key cache */
+PJ_DEF(pj_status_t) pj_stun_authenticate_response2(const pj_uint8_t *pkt,
+                                                   unsigned pkt_len,
+                                                   const pj_stun_msg *msg,
+                                                   const pj_str_t *key,
+                                                   pj_stun_key_cache *cache)
 {
     const pj_stun_msgint_attr *amsgi;
+    const pj_stun_key_cache_entry *key_entry = NULL;
     unsigned i, amsgi_pos;
     pj_bool_t has_attr_beyond_mi;
-    pj_hmac_sha1_context ctx;
     pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE];
 
     PJ_ASSERT_RETURN(pkt && pkt_len && msg && key, PJ_EINVAL);
@@ -590,37 +792,9 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
     }
 
     /* Now calculate HMAC of the message. */
-    pj_hmac_sha1_init(&ctx, (pj_uint8_t*)key->ptr, (unsigned)key->slen);
-
-#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
-    /* Pre rfc3489bis-06 style of calculation */
-    pj_hmac_sha1_update(&ctx, pkt, 20);
-#else
-    /* First calculate HMAC for the header.
-     * The calculation is different depending on whether FINGERPRINT attribute
-     * is present in the message.
-     */
-    if (has_attr_beyond_mi) {
-        pj_uint8_t hdr_copy[20];
-        pj_memcpy(hdr_copy, pkt, 20);
-        PUT_VAL16(hdr_copy, 2, (pj_uint16_t)(amsgi_pos+24));
-        pj_hmac_sha1_update(&ctx, hdr_copy, 20);
-    } else {
-        pj_hmac_sha1_update(&ctx, pkt, 20);
-    }
-#endif  /* PJ_STUN_OLD_STYLE_MI_FINGERPRINT */
-
-    /* Now update with the message body */
-    pj_hmac_sha1_update(&ctx, pkt+20, amsgi_pos);
-#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
-    // This is no longer necessary as per rfc3489bis-08
-    if ((amsgi_pos+20) & 0x3F) {
-        pj_uint8_t zeroes[64];
-        pj_bzero(zeroes, sizeof(zeroes));
-        pj_hmac_sha1_update(&ctx, zeroes, 64-((amsgi_pos+20) & 0x3F));
-    }
-#endif
-    pj_hmac_sha1_final(&ctx, digest);
+    key_entry = cache ? pj_stun_key_cache_get_by_key(cache, key) : NULL;
+    calc_msgint(key_entry ? &key_entry->hmac : NULL, key, pkt, amsgi_pos,
+                has_attr_beyond_mi, digest);
 
     /* Compare HMACs */
     if (pj_memcmp(amsgi->hmac, digest, 20)) {
@@ -632,3 +806,34 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
     return PJ_SUCCESS;
 }
 
+
+
+/* Authenticate MESSAGE-INTEGRITY in the message view */
+PJ_DEF(pj_status_t) pj_stun_authenticate_view(const pj_stun_msg_view *view,
+                                              const pj_str_t *key,
+                                              pj_stun_key_cache *cache)
+{
+    const pj_stun_key_cache_entry *key_entry = NULL;
+    pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE];
+    unsigned amsgi_pos;
+
+    PJ_ASSERT_RETURN(view && key, PJ_EINVAL);
+
+    if ((view->flags & PJ_STUN_VIEW_HAS_MSGINT) == 0)
+        return PJ_STATUS_FROM_STUN_CODE(PJ_STUN_SC_UNAUTHORIZED);
+
+    /* Position relative to the end of the header */
+    amsgi_pos = view->msgint_pos - 20;
+
+    key_entry = cache ? pj_stun_key_cache_get_by_key(cache, key) : NULL;
+    calc_msgint(key_entry ? &key_entry->hmac : NULL, key, view->pdu,
+                amsgi_pos, (view->msgint_pos + 24 < view->msg_len), digest);
+
+    /* Compare HMACs */
+    if (pj_memcmp(view->pdu + view->msgint_pos + 4, digest, 20)) {
+        /* HMAC value mismatch */
+        return PJ_STATUS_FROM_STUN_CODE(PJ_STUN_SC_UNAUTHORIZED);
+    }
+
+    return PJ_SUCCESS;
+}
@@ -2560,6 +2560,287 @@ PJ_DEF(pj_status_t) pj_stun_msg_decode(pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
+
+/*
+ * Parse incoming packet into STUN message view, without allocating memory.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_view_parse(const pj_uint8_t *pdu,
+                                           pj_size_t pdu_len,
+                                           unsigned options,
+                                           pj_stun_msg_view *view)
+{
+    unsigned pos, msg_len;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pdu && pdu_len && view, PJ_EINVAL);
+
+    /* Check if this is a STUN message, if necessary */
+    if (options & PJ_STUN_CHECK_PACKET) {
+        status = pj_stun_msg_check(pdu, pdu_len, options);
+        if (status != PJ_SUCCESS)
+            return status;
+    } else if (pdu_len < sizeof(pj_stun_msg_hdr)) {
+        return PJNATH_EINSTUNMSGLEN;
+    }
+
+    msg_len = GETVAL16H(pdu, 2) + 20;
+    if (msg_len > pdu_len ||
+        ((options & PJ_STUN_IS_DATAGRAM) && msg_len != pdu_len))
+    {
+        return PJNATH_EINSTUNMSGLEN;
+    }
+
+    pj_bzero(view, sizeof(*view));
+    view->pdu = pdu;
+    view->msg_len = msg_len;
+    view->type = GETVAL16H(pdu, 0);
+    view->magic = GETVAL32H(pdu, 4);
+    view->tsx_id = pdu + 8;
+
+    /* Walk the attributes */
+    pos = sizeof(pj_stun_msg_hdr);
+    while (pos + ATTR_HDR_LEN <= msg_len) {
+        unsigned attr_type, attr_len, attr_val_len;
+        const pj_uint8_t *val;
+
+        attr_type = GETVAL16H(pdu, pos);
+        attr_len = GETVAL16H(pdu, pos+2);
+        attr_val_len = (attr_len + 3) & (~3);
+        val = pdu + pos + ATTR_HDR_LEN;
+
+        if (pos + ATTR_HDR_LEN + attr_val_len > msg_len)
+            return PJNATH_ESTUNINATTRLEN;
+
+        /* Only FINGERPRINT may follow FINGERPRINT */
+        if (view->flags & PJ_STUN_VIEW_HAS_FINGERPRINT) {
+            return attr_type == PJ_STUN_ATTR_FINGERPRINT ?
+                   PJNATH_ESTUNDUPATTR : PJNATH_ESTUNFINGERPOS;
+        }
+
+        switch (attr_type) {
+        case PJ_STUN_ATTR_USERNAME:
+            view->username.ptr = (char*)val;
+            view->username.slen = attr_len;
+            view->flags |= PJ_STUN_VIEW_HAS_USERNAME;
+            break;
+        case PJ_STUN_ATTR_REALM:
+            view->realm.ptr = (char*)val;
+            view->realm.slen = attr_len;
+            view->flags |= PJ_STUN_VIEW_HAS_REALM;
+            break;
+        case PJ_STUN_ATTR_NONCE:
+            view->nonce.ptr = (char*)val;
+            view->nonce.slen = attr_len;
+            view->flags |= PJ_STUN_VIEW_HAS_NONCE;
+            break;
+        case PJ_STUN_ATTR_SOFTWARE:
+            view->software.ptr = (char*)val;
+            view->software.slen = attr_len;
+            view->flags |= PJ_STUN_VIEW_HAS_SOFTWARE;
+            break;
+        case PJ_STUN_ATTR_PRIORITY:
+            if (attr_len != 4)
+                return PJNATH_ESTUNINATTRLEN;
+            view->priority = GETVAL32H(val, 0);
+            view->flags |= PJ_STUN_VIEW_HAS_PRIORITY;
+            break;
+        case PJ_STUN_ATTR_USE_CANDIDATE:
+            if (attr_len != 0)
+                return PJNATH_ESTUNINATTRLEN;
+            view->flags |= PJ_STUN_VIEW_HAS_USE_CANDIDATE;
+            break;
+        case PJ_STUN_ATTR_ICE_CONTROLLING:
+        case PJ_STUN_ATTR_ICE_CONTROLLED:
+            if (attr_len != 8)
+                return PJNATH_ESTUNINATTRLEN;
+            GETVAL64H(val, 0, &view->tie_breaker);
+            view->flags |= (attr_type == PJ_STUN_ATTR_ICE_CONTROLLING ?
+                            PJ_STUN_VIEW_HAS_ICE_CONTROLLING :
+                            PJ_STUN_VIEW_HAS_ICE_CONTROLLED);
+            break;
+        case PJ_STUN_ATTR_ERROR_CODE:
+            if (attr_len < 4)
+                return PJNATH_ESTUNINATTRLEN;
+            view->err_code = val[2] * 100 + val[3];
+            view->flags |= PJ_STUN_VIEW_HAS_ERROR_CODE;
+            break;
+        case PJ_STUN_ATTR_XOR_MAPPED_ADDR:
+            if (attr_len != STUN_GENERIC_IPV4_ADDR_LEN &&
+                attr_len != STUN_GENERIC_IPV6_ADDR_LEN)
+            {
+                return PJNATH_ESTUNINATTRLEN;
+            }
+            view->xor_mapped_pos = pos;
+            view->flags |= PJ_STUN_VIEW_HAS_XOR_MAPPED_ADDR;
+            break;
+        case PJ_STUN_ATTR_MESSAGE_INTEGRITY:
+            if (attr_len != 20)
+                return PJNATH_ESTUNINATTRLEN;
+            if (view->flags & PJ_STUN_VIEW_HAS_MSGINT)
+                return PJNATH_ESTUNDUPATTR;
+            view->msgint_pos = pos;
+            view->flags |= PJ_STUN_VIEW_HAS_MSGINT;
+            break;
+        case PJ_STUN_ATTR_FINGERPRINT:
+            if (attr_len != 4)
+                return PJNATH_ESTUNINATTRLEN;
+            view->flags |= PJ_STUN_VIEW_HAS_FINGERPRINT;
+            break;
+        default:
+            if (attr_type <= 0x7FFF && view->unknown_attr == 0 &&
+                find_attr_desc(attr_type) == NULL)
+            {
+                view->unknown_attr = (pj_uint16_t)attr_type;
+            }
+            view->flags |= PJ_STUN_VIEW_HAS_OTHER;
+            break;
+        }
+
+        pos += ATTR_HDR_LEN + attr_val_len;
+    }
+
+    if (pos != msg_len) {
+        /* Stray trailing bytes */
+        return PJNATH_EINSTUNMSGLEN;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get XOR-MAPPED-ADDRESS from the message view.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_view_get_xor_mapped_addr(
+                                            const pj_stun_msg_view *view,
+                                            pj_sockaddr *addr)
+{
+    const pj_uint8_t *buf;
+    pj_uint16_t port;
+
+    PJ_ASSERT_RETURN(view && addr, PJ_EINVAL);
+
+    if ((view->flags & PJ_STUN_VIEW_HAS_XOR_MAPPED_ADDR) == 0)
+        return PJ_ENOTFOUND;
+
+    buf = view->pdu + view->xor_mapped_pos;
+    port = (pj_uint16_t)(GETVAL16H(buf, ATTR_HDR_LEN+2) ^
+                         (PJ_STUN_MAGIC >> 16));
+
+    if (buf[ATTR_HDR_LEN+1] == 1 &&
+        GETVAL16H(buf, 2) == STUN_GENERIC_IPV4_ADDR_LEN)
+    {
+        pj_uint32_t ip = GETVAL32H(buf, ATTR_HDR_LEN+4) ^ PJ_STUN_MAGIC;
+
+        pj_sockaddr_init(pj_AF_INET(), addr, NULL, port);
+        addr->ipv4.sin_addr.s_addr = pj_htonl(ip);
+
+    } else if (buf[ATTR_HDR_LEN+1] == 2 &&
+               GETVAL16H(buf, 2) == STUN_GENERIC_IPV6_ADDR_LEN)
+    {
+        pj_uint32_t magic = pj_htonl(PJ_STUN_MAGIC);
+        pj_uint8_t *dst;
+        unsigned i;
+
+        pj_sockaddr_init(pj_AF_INET6(), addr, NULL, port);
+        dst = (pj_uint8_t*) &addr->ipv6.sin6_addr;
+        pj_memcpy(dst, buf+ATTR_HDR_LEN+4, 16);
+
+        /* XOR with the magic cookie and the transaction ID */
+        for (i=0; i<4; ++i)
+            dst[i] ^= ((const pj_uint8_t*)&magic)[i];
+        for (i=0; i<12; ++i)
+            dst[i+4] ^= view->tsx_id[i];
+
+    } else {
+        return PJNATH_EINVAF;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Create STUN message from the view.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_view_to_msg(pj_pool_t *pool,
+                                            const pj_stun_msg_view *view,
+                                            pj_stun_msg **p_msg)
+{
+    const pj_uint8_t *pdu;
+    pj_stun_msg *msg;
+    unsigned pos;
+
+    PJ_ASSERT_RETURN(pool && view && view->pdu && p_msg, PJ_EINVAL);
+
+    if (view->flags & PJ_STUN_VIEW_HAS_OTHER)
+        return PJ_ENOTSUP;
+
+    pdu = view->pdu;
+
+    /* Copy the header, and convert to host byte order */
+    msg = PJ_POOL_ZALLOC_T(pool, pj_stun_msg);
+    pj_memcpy(&msg->hdr, pdu, sizeof(pj_stun_msg_hdr));
+    msg->hdr.type = view->type;
+    msg->hdr.length = (pj_uint16_t)(view->msg_len - sizeof(pj_stun_msg_hdr));
+    msg->hdr.magic = view->magic;
+
+    /* The view has validated the attributes, create them in packet order */
+    pos = sizeof(pj_stun_msg_hdr);
+    while (pos + ATTR_HDR_LEN <= view->msg_len) {
+        unsigned attr_type = GETVAL16H(pdu, pos);
+        unsigned attr_len = GETVAL16H(pdu, pos+2);
+        const pj_uint8_t *buf = pdu + pos;
+        void *attr;
+        pj_status_t status;
+
+        switch (attr_type) {
+        case PJ_STUN_ATTR_USERNAME:
+        case PJ_STUN_ATTR_REALM:
+        case PJ_STUN_ATTR_NONCE:
+        case PJ_STUN_ATTR_SOFTWARE:
+            status = decode_string_attr(pool, buf, &msg->hdr, &attr);
+            break;
+        case PJ_STUN_ATTR_PRIORITY:
+        case PJ_STUN_ATTR_FINGERPRINT:
+            status = decode_uint_attr(pool, buf, &msg->hdr, &attr);
+            break;
+        case PJ_STUN_ATTR_USE_CANDIDATE:
+            status = decode_empty_attr(pool, buf, &msg->hdr, &attr);
+            break;
+        case PJ_STUN_ATTR_ICE_CONTROLLING:
+        case PJ_STUN_ATTR_ICE_CONTROLLED:
+            status = decode_uint64_attr(pool, buf, &msg->hdr, &attr);
+            break;
+        case PJ_STUN_ATTR_ERROR_CODE:
+            status = decode_errcode_attr(pool, buf, &msg->hdr, &attr);
+            break;
+        case PJ_STUN_ATTR_XOR_MAPPED_ADDR:
+            status = decode_xored_sockaddr_attr(pool, buf, &msg->hdr, &attr);
+            break;
+        case PJ_STUN_ATTR_MESSAGE_INTEGRITY:
+            status = decode_msgint_attr(pool, buf, &msg->hdr, &attr);
+            break;
+        default:
+            pj_assert(!"Attribute not in the view");
+            return PJ_ENOTSUP;
+        }
+
+        if (status != PJ_SUCCESS)
+            return status;
+
+        if (msg->attr_count >= PJ_STUN_MAX_ATTR)
+            return PJNATH_ESTUNTOOMANYATTR;
+
+        msg->attr[msg->attr_count++] = (pj_stun_attr_hdr*)attr;
+        pos += ATTR_HDR_LEN + ((attr_len + 3) & (~3));
+    }
+
+    *p_msg = msg;
+
+    return PJ_SUCCESS;
+}
+
 /*
 static char *print_binary(const pj_uint8_t *data, unsigned data_len)
 {
@@ -46,6 +46,10 @@ struct pj_stun_session
 
     pj_str_t             srv_name;
 
+#if PJ_STUN_KEY_CACHE_SIZE
+    pj_stun_key_cache   *key_cache;
+#endif
+
     pj_stun_tx_data      pending_request_list;
     pj_stun_tx_data      cached_response_list;
 };
@@ -64,6 +68,12 @@ struct pj_stun_session
 #define TDATA_POOL_SIZE             PJNATH_POOL_LEN_STUN_TDATA
 #define TDATA_POOL_INC              PJNATH_POOL_INC_STUN_TDATA
 
+#if PJ_STUN_KEY_CACHE_SIZE
+#   define KEY_CACHE(sess)          ((sess)->key_cache)
+#else
+#   define KEY_CACHE(sess)          NULL
+#endif
+
 
 static void stun_tsx_on_complete(pj_stun_client_tsx *tsx,
                                  pj_status_t status, 
@@ -100,17 +110,16 @@ static pj_status_t tsx_erase(pj_stun_session *sess,
     return PJ_SUCCESS;
 }
 
-static pj_stun_tx_data* tsx_lookup(pj_stun_session *sess,
-                                   const pj_stun_msg *msg)
+static pj_stun_tx_data* tsx_lookup_id(pj_stun_session *sess,
+                                      pj_uint32_t magic,
+                                      const pj_uint8_t *tsx_id)
 {
     pj_stun_tx_data *tdata;
 
     tdata = sess->pending_request_list.next;
     while (tdata != &sess->pending_request_list) {
-        pj_assert(sizeof(tdata->msg_key)==sizeof(msg->hdr.tsx_id));
-        if (tdata->msg_magic == msg->hdr.magic &&
-            pj_memcmp(tdata->msg_key, msg->hdr.tsx_id, 
-                      sizeof(msg->hdr.tsx_id))==0)
+        if (tdata->msg_magic == magic &&
+            pj_memcmp(tdata->msg_key, tsx_id, sizeof(tdata->msg_key))==0)
         {
             return tdata;
         }
@@ -120,6 +129,14 @@ static pj_stun_tx_data* tsx_lookup(pj_stun_session *sess,
     return NULL;
 }
 
+static pj_stun_tx_data* tsx_lookup(pj_stun_session *sess,
+                                   const pj_stun_msg *msg)
+{
+    pj_assert(sizeof(sess->pending_request_list.msg_key) ==
+              sizeof(msg->hdr.tsx_id));
+    return tsx_lookup_id(sess, msg->hdr.magic, msg->hdr.tsx_id);
+}
+
 static pj_status_t create_tdata(pj_stun_session *sess,
                                 pj_stun_tx_data **p_tdata)
 {
@@ -582,6 +599,11 @@ PJ_DEF(pj_status_t) pj_stun_session_create( pj_stun_config *cfg,
     pj_list_init(&sess->pending_request_list);
     pj_list_init(&sess->cached_response_list);
 
+#if PJ_STUN_KEY_CACHE_SIZE
+    sess->key_cache = PJ_POOL_ALLOC_T(pool, pj_stun_key_cache);
+    pj_stun_key_cache_init(sess->key_cache);
+#endif
+
     *p_sess = sess;
 
     return PJ_SUCCESS;
@@ -694,6 +716,9 @@ PJ_DEF(pj_status_t) pj_stun_session_set_credential(pj_stun_session *sess,
         sess->auth_type = PJ_STUN_AUTH_NONE;
         pj_bzero(&sess->cred, sizeof(sess->cred));
     }
+#if PJ_STUN_KEY_CACHE_SIZE
+    pj_stun_key_cache_init(sess->key_cache);
+#endif
     pj_grp_lock_release(sess->grp_lock);
 
     return PJ_SUCCESS;
@@ -718,6 +743,26 @@ PJ_DEF(pj_bool_t) pj_stun_session_use_fingerprint(pj_stun_session *sess,
     return old_use;
 }
 
+/* Create the MESSAGE-INTEGRITY key, from the key cache if possible */
+static void create_key(pj_stun_session *sess,
+                       pj_pool_t *pool,
+                       pj_str_t *key,
+                       const pj_str_t *realm,
+                       const pj_str_t *username,
+                       pj_stun_passwd_type data_type,
+                       const pj_str_t *data)
+{
+    const pj_stun_key_cache_entry *e = NULL;
+
+    if (KEY_CACHE(sess))
+        e = pj_stun_key_cache_get(KEY_CACHE(sess), realm, username,
+                                  data_type, data);
+    if (e)
+        pj_strdup(pool, key, &e->key);
+    else
+        pj_stun_create_key(pool, key, realm, username, data_type, data);
+}
+
 static pj_status_t get_auth(pj_stun_session *sess,
                             pj_stun_tx_data *tdata)
 {
@@ -727,11 +772,11 @@ static pj_status_t get_auth(pj_stun_session *sess,
         tdata->auth_info.username = sess->cred.data.static_cred.username;
         tdata->auth_info.nonce = sess->cred.data.static_cred.nonce;
 
-        pj_stun_create_key(tdata->pool, &tdata->auth_info.auth_key, 
-                           &tdata->auth_info.realm,
-                           &tdata->auth_info.username,
-                           sess->cred.data.static_cred.data_type,
-                           &sess->cred.data.static_cred.data);
+        create_key(sess, tdata->pool, &tdata->auth_info.auth_key,
+                   &tdata->auth_info.realm,
+                   &tdata->auth_info.username,
+                   sess->cred.data.static_cred.data_type,
+                   &sess->cred.data.static_cred.data);
 
     } else if (sess->cred.type == PJ_STUN_AUTH_CRED_DYNAMIC) {
         pj_str_t password;
@@ -748,9 +793,9 @@ static pj_status_t get_auth(pj_stun_session *sess,
         if (rc != PJ_SUCCESS)
             return rc;
 
-        pj_stun_create_key(tdata->pool, &tdata->auth_info.auth_key, 
-                           &tdata->auth_info.realm, &tdata->auth_info.username,
-                           data_type, &password);
+        create_key(sess, tdata->pool, &tdata->auth_info.auth_key,
+                   &tdata->auth_info.realm, &tdata->auth_info.username,
+                   data_type, &password);
 
     } else {
         pj_assert(!"Unknown credential type");
@@ -1256,9 +1301,9 @@ static pj_status_t authenticate_req(pj_stun_session *sess,
         return PJ_SUCCESS;
     }
 
-    status = pj_stun_authenticate_request(pkt, pkt_len, rdata->msg, 
-                                          &sess->cred, tmp_pool, &rdata->info,
-                                          &response);
+    status = pj_stun_authenticate_request2(pkt, pkt_len, rdata->msg,
+                                           &sess->cred, KEY_CACHE(sess),
+                                           tmp_pool, &rdata->info, &response);
     if (status != PJ_SUCCESS && response != NULL) {
         PJ_PERROR(5,(SNAME(sess), status, "Message authentication failed"));
         send_response(sess, token, tmp_pool, response, &rdata->info, 
@@ -1299,8 +1344,9 @@ static pj_status_t on_incoming_response(pj_stun_session *sess,
         tdata->auth_info.auth_key.slen != 0 && 
         pj_stun_auth_valid_for_msg(msg))
     {
-        status = pj_stun_authenticate_response(pkt, pkt_len, msg, 
-                                               &tdata->auth_info.auth_key);
+        status = pj_stun_authenticate_response2(pkt, pkt_len, msg,
+                                                &tdata->auth_info.auth_key,
+                                                KEY_CACHE(sess));
         if (status != PJ_SUCCESS) {
             PJ_PERROR(5,(SNAME(sess), status,
                          "Response authentication failed"));
@@ -1325,7 +1371,9 @@ static pj_status_t on_incoming_response(pj_stun_session *sess,
 /* For requests, check if we cache the response */
 static pj_status_t check_cached_response(pj_stun_session *sess,
                                          pj_pool_t *tmp_pool,
-                                         const pj_stun_msg *msg,
+                                         unsigned msg_type,
+                                         pj_uint32_t magic,
+                                         const pj_uint8_t *tsx_id,
                                          const pj_sockaddr_t *src_addr,
                                          unsigned src_addr_len)
 {
@@ -1334,10 +1382,9 @@ static pj_status_t check_cached_response(pj_stun_session *sess,
     /* First lookup response in response cache */
     t = sess->cached_response_list.next;
     while (t != &sess->cached_response_list) {
-        if (t->msg_magic == msg->hdr.magic &&
-            t->msg->hdr.type == msg->hdr.type &&
-            pj_memcmp(t->msg_key, msg->hdr.tsx_id, 
-                      sizeof(msg->hdr.tsx_id))==0)
+        if (t->msg_magic == magic &&
+            t->msg->hdr.type == msg_type &&
+            pj_memcmp(t->msg_key, tsx_id, sizeof(t->msg_key))==0)
         {
             break;
         }
@@ -1475,6 +1522,7 @@ PJ_DEF(pj_status_t) pj_stun_session_on_rx_pkt(pj_stun_session *sess,
                                               unsigned src_addr_len)
 {
     pj_stun_msg *msg, *response;
+    pj_stun_msg_view view;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(sess && packet && pkt_size, PJ_EINVAL);
@@ -1491,27 +1539,74 @@ PJ_DEF(pj_status_t) pj_stun_session_on_rx_pkt(pj_stun_session *sess,
 
     /* Reset pool */
     pj_pool_reset(sess->rx_pool);
+    msg = NULL;
 
-    /* Try to parse the message */
-    status = pj_stun_msg_decode(sess->rx_pool, (const pj_uint8_t*)packet,
-                                pkt_size, options, 
-                                &msg, parsed_len, &response);
-    if (status != PJ_SUCCESS) {
-        LOG_ERR_(sess, "STUN msg_decode() error", status);
-        if (response) {
-            send_response(sess, token, sess->rx_pool, response, NULL,
-                          PJ_FALSE, src_addr, src_addr_len);
+    /* Before decoding the message, find out from the packet whether it's
+     * a response to unknown transaction or a request retransmission, so
+     * that they can be handled without decoding.
+     */
+    if (pj_stun_msg_view_parse((const pj_uint8_t*)packet, pkt_size,
+                               options, &view) == PJ_SUCCESS)
+    {
+        if (PJ_STUN_IS_RESPONSE(view.type) &&
+            tsx_lookup_id(sess, view.magic, view.tsx_id) == NULL)
+        {
+            PJ_LOG(5,(SNAME(sess), 
+                      "Transaction not found, response silently discarded"));
+            if (parsed_len)
+                *parsed_len = view.msg_len;
+            status = PJ_SUCCESS;
+            goto on_return;
+        }
+
+        if (PJ_STUN_IS_REQUEST(view.type) &&
+            check_cached_response(sess, sess->rx_pool, view.type, view.magic,
+                                  view.tsx_id, src_addr,
+                                  src_addr_len) == PJ_SUCCESS)
+        {
+            if (parsed_len)
+                *parsed_len = view.msg_len;
+            status = PJ_SUCCESS;
+            goto on_return;
+        }
+
+        /* Binding requests and responses carrying only the attributes
+         * known to the view (e.g. ICE connectivity checks) are created
+         * from the view, without the full decoder.
+         */
+        if (PJ_STUN_GET_METHOD(view.type) == PJ_STUN_BINDING_METHOD &&
+            !PJ_STUN_IS_INDICATION(view.type) &&
+            pj_stun_msg_view_to_msg(sess->rx_pool, &view, &msg) == PJ_SUCCESS)
+        {
+            if (parsed_len)
+                *parsed_len = view.msg_len;
+            dump_rx_msg(sess, msg, (unsigned)pkt_size, src_addr);
         }
-        goto on_return;
     }
 
-    dump_rx_msg(sess, msg, (unsigned)pkt_size, src_addr);
+    if (msg == NULL) {
+        /* Try to parse the message */
+        status = pj_stun_msg_decode(sess->rx_pool, (const pj_uint8_t*)packet,
+                                    pkt_size, options, 
+                                    &msg, parsed_len, &response);
+        if (status != PJ_SUCCESS) {
+            LOG_ERR_(sess, "STUN msg_decode() error", status);
+            if (response) {
+                send_response(sess, token, sess->rx_pool, response, NULL,
+                              PJ_FALSE, src_addr, src_addr_len);
+            }
+            goto on_return;
+        }
+
+        dump_rx_msg(sess, msg, (unsigned)pkt_size, src_addr);
 
-    /* For requests, check if we have cached response */
-    status = check_cached_response(sess, sess->rx_pool, msg, 
-                                   src_addr, src_addr_len);
-    if (status == PJ_SUCCESS) {
-        goto on_return;
+        /* For requests, check if we have cached response */
+        status = check_cached_response(sess, sess->rx_pool, msg->hdr.type,
+                                       msg->hdr.magic, msg->hdr.tsx_id,
+                                       src_addr, src_addr_len);
+        if (status == PJ_SUCCESS) {
+            goto on_return;
+        }
     }
 
     /* Handle message */
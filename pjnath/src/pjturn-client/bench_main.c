@@ -0,0 +1,838 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * TURN relay load generator.
+ *
+ * Opens a number of allocations against a TURN server, binds a channel
+ * on each of them to a local peer, and pumps RTP sized packets through
+ * the relay. The peers echo the packets back, so each packet crosses the
+ * relay twice. At the end it reports the relayed packet rate, the round
+ * trip latency percentiles, and (when the server's process ID is given on
+ * Linux) the CPU and memory used by the server per allocation.
+ */
+#include <pjnath.h>
+#include <pjlib-util.h>
+#include <pjlib.h>
+
+#if defined(PJ_LINUX) && PJ_LINUX!=0
+#   include <stdio.h>
+#   include <unistd.h>
+#   define HAS_PROC_STAT    1
+#else
+#   define HAS_PROC_STAT    0
+#endif
+
+
+#define THIS_FILE       "bench_main.c"
+
+#define HIST_RES_USEC   10                  /* Latency histogram resolution */
+#define HIST_BUCKETS    10000               /* Up to 100 ms                 */
+#define TICK_MSEC       5                   /* Sender loop interval         */
+#define SETUP_TIMEOUT   30                  /* Seconds to wait for allocs   */
+#define WARMUP_MSEC     1000                /* Wait for ChannelBind         */
+#define DRAIN_MSEC      500                 /* Wait for last echoes         */
+
+
+/* Header of each packet sent through the relay */
+typedef struct bench_pkt
+{
+    pj_uint32_t         alloc_id;
+    pj_uint32_t         seq;
+    pj_timestamp        ts;
+} bench_pkt;
+
+/* A worker thread, with its own ioqueue and echo peer */
+struct worker
+{
+    unsigned             id;
+    pj_pool_t           *pool;
+    pj_stun_config       stun_cfg;
+    pj_thread_t         *thread;
+    pj_activesock_t     *peer_sock;
+    pj_sock_t            peer_fd;
+    pj_sockaddr          peer_addr;
+
+    /* Statistics, only updated by the worker thread */
+    pj_uint64_t          peer_rx;
+    pj_uint64_t          rx;
+    pj_uint32_t         *hist;
+    pj_uint32_t          hist_over;
+    pj_uint32_t          max_usec;
+};
+
+/* An allocation */
+struct alloc
+{
+    unsigned             id;
+    struct worker       *worker;
+    pj_turn_sock        *relay;
+    pj_bool_t            ready;
+    pj_bool_t            failed;
+    pj_uint32_t          seq;
+    pj_uint64_t          credit;            /* In packet x usec units       */
+};
+
+static struct global
+{
+    pj_caching_pool      cp;
+    pj_pool_t           *pool;
+    pj_bool_t            quit;
+
+    unsigned             worker_cnt;
+    struct worker       *worker;
+
+    unsigned             alloc_cnt;
+    struct alloc        *alloc;
+    pj_atomic_t         *ready_cnt;
+    pj_atomic_t         *fail_cnt;
+
+    pj_uint64_t          tx;
+    pj_uint64_t          tx_err;
+} g;
+
+static struct options
+{
+    pj_bool_t    use_tcp;
+    char        *srv_addr;
+    char        *srv_port;
+    char        *realm;
+    char        *user_name;
+    char        *password;
+    char        *peer_ip;
+    unsigned     count;
+    unsigned     duration;
+    unsigned     rate;
+    unsigned     size;
+    unsigned     alloc_rate;
+    unsigned     srv_pid;
+} o;
+
+
+static int worker_thread(void *arg);
+static void turn_on_rx_data(pj_turn_sock *relay,
+                            void *pkt,
+                            unsigned pkt_len,
+                            const pj_sockaddr_t *peer_addr,
+                            unsigned addr_len);
+static void turn_on_state(pj_turn_sock *relay, pj_turn_state_t old_state,
+                          pj_turn_state_t new_state);
+static pj_bool_t peer_on_data_recvfrom(pj_activesock_t *asock,
+                                       void *data,
+                                       pj_size_t size,
+                                       const pj_sockaddr_t *src_addr,
+                                       int addr_len,
+                                       pj_status_t status);
+
+
+static void my_perror(const char *title, pj_status_t status)
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+    pj_strerror(status, errmsg, sizeof(errmsg));
+
+    PJ_LOG(1,(THIS_FILE, "%s: %s", title, errmsg));
+}
+
+#define CHECK(expr)     status=expr; \
+                        if (status!=PJ_SUCCESS) { \
+                            my_perror(#expr, status); \
+                            return status; \
+                        }
+
+
+/*
+ * Server process statistics, read from procfs.
+ */
+typedef struct proc_stat
+{
+    pj_bool_t   valid;
+    double      cpu_sec;                    /* User+system CPU time */
+    pj_size_t   rss;                        /* Resident set size    */
+} proc_stat;
+
+static void read_proc_stat(unsigned pid, proc_stat *st)
+{
+    pj_bzero(st, sizeof(*st));
+
+#if HAS_PROC_STAT
+    if (pid) {
+        char path[64], line[1024];
+        unsigned long utime, stime, size, resident;
+        char *p;
+        FILE *f;
+
+        pj_ansi_snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+        f = fopen(path, "r");
+        if (!f)
+            return;
+        p = fgets(line, sizeof(line), f) ? strrchr(line, ')') : NULL;
+        fclose(f);
+        if (!p || sscanf(p+2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                              "%lu %lu", &utime, &stime) != 2)
+        {
+            return;
+        }
+
+        pj_ansi_snprintf(path, sizeof(path), "/proc/%u/statm", pid);
+        f = fopen(path, "r");
+        if (!f)
+            return;
+        if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+            fclose(f);
+            return;
+        }
+        fclose(f);
+
+        st->cpu_sec = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+        st->rss = (pj_size_t)resident * sysconf(_SC_PAGESIZE);
+        st->valid = PJ_TRUE;
+    }
+#else
+    PJ_UNUSED_ARG(pid);
+#endif
+}
+
+
+static pj_status_t init_worker(struct worker *w, unsigned max_handles)
+{
+    pj_activesock_cb peer_cb;
+    pj_activesock_cfg peer_cfg;
+    pj_str_t peer_ip = pj_str(o.peer_ip);
+    int addr_len;
+    pj_status_t status;
+
+    w->pool = pj_pool_create(&g.cp.factory, "worker%p", 1000, 1000, NULL);
+    w->hist = (pj_uint32_t*) pj_pool_calloc(w->pool, HIST_BUCKETS,
+                                            sizeof(pj_uint32_t));
+
+    pj_stun_config_init(&w->stun_cfg, &g.cp.factory, 0, NULL, NULL);
+    CHECK( pj_timer_heap_create(w->pool, max_handles * 4,
+                                &w->stun_cfg.timer_heap) );
+    CHECK( pj_ioqueue_create(w->pool, max_handles, &w->stun_cfg.ioqueue) );
+
+    /* The echo peer */
+    CHECK( pj_sockaddr_init(pj_AF_INET(), &w->peer_addr, &peer_ip, 0) );
+
+    pj_bzero(&peer_cb, sizeof(peer_cb));
+    peer_cb.on_data_recvfrom = &peer_on_data_recvfrom;
+    pj_activesock_cfg_default(&peer_cfg);
+    peer_cfg.async_cnt = 4;
+
+    CHECK( pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &w->peer_fd) );
+    addr_len = sizeof(w->peer_addr);
+    if ((status=pj_sock_bind(w->peer_fd, &w->peer_addr, addr_len)) != 0 ||
+        (status=pj_sock_getsockname(w->peer_fd, &w->peer_addr,
+                                    &addr_len)) != 0)
+    {
+        my_perror("Error binding peer socket", status);
+        pj_sock_close(w->peer_fd);
+        w->peer_fd = PJ_INVALID_SOCKET;
+        return status;
+    }
+    CHECK( pj_activesock_create(w->pool, w->peer_fd, pj_SOCK_DGRAM(),
+                                &peer_cfg, w->stun_cfg.ioqueue, &peer_cb, w,
+                                &w->peer_sock) );
+    CHECK( pj_activesock_start_recvfrom(w->peer_sock, w->pool,
+                                        PJ_TURN_MAX_PKT_LEN, 0) );
+
+    CHECK( pj_thread_create(w->pool, "worker", &worker_thread, w, 0, 0,
+                            &w->thread) );
+
+    return PJ_SUCCESS;
+}
+
+
+static pj_status_t init(void)
+{
+    unsigned i, per_worker;
+    pj_status_t status;
+
+    CHECK( pj_init() );
+    pj_log_set_level(3);
+    CHECK( pjlib_util_init() );
+    CHECK( pjnath_init() );
+
+    pj_caching_pool_init(&g.cp, &pj_pool_factory_default_policy, 0);
+
+    g.pool = pj_pool_create(&g.cp.factory, "main", 1000, 1000, NULL);
+
+    CHECK( pj_atomic_create(g.pool, 0, &g.ready_cnt) );
+    CHECK( pj_atomic_create(g.pool, 0, &g.fail_cnt) );
+
+    /* Spread the allocations among as many workers as needed to stay
+     * within the ioqueue limit. One handle is used by the echo peer.
+     */
+    per_worker = PJ_IOQUEUE_MAX_HANDLES - 2;
+    g.worker_cnt = (o.count + per_worker - 1) / per_worker;
+    g.worker = (struct worker*) pj_pool_calloc(g.pool, g.worker_cnt,
+                                               sizeof(struct worker));
+    for (i=0; i<g.worker_cnt; ++i) {
+        g.worker[i].id = i;
+        status = init_worker(&g.worker[i], PJ_IOQUEUE_MAX_HANDLES);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    g.alloc_cnt = o.count;
+    g.alloc = (struct alloc*) pj_pool_calloc(g.pool, g.alloc_cnt,
+                                             sizeof(struct alloc));
+    for (i=0; i<g.alloc_cnt; ++i) {
+        g.alloc[i].id = i;
+        g.alloc[i].worker = &g.worker[i / per_worker];
+    }
+
+    PJ_LOG(3,(THIS_FILE, "%d allocation(s) on %d worker thread(s)",
+              g.alloc_cnt, g.worker_cnt));
+
+    return PJ_SUCCESS;
+}
+
+
+static void bench_shutdown(void)
+{
+    unsigned i;
+
+    for (i=0; g.alloc && i<g.alloc_cnt; ++i) {
+        if (g.alloc[i].relay) {
+            pj_turn_sock_destroy(g.alloc[i].relay);
+        }
+    }
+
+    /* Let the workers complete the deallocations */
+    if (g.worker_cnt)
+        pj_thread_sleep(500);
+
+    g.quit = PJ_TRUE;
+    for (i=0; i<g.worker_cnt; ++i) {
+        struct worker *w = &g.worker[i];
+
+        if (w->thread) {
+            pj_thread_join(w->thread);
+            pj_thread_destroy(w->thread);
+        }
+        if (w->peer_sock)
+            pj_activesock_close(w->peer_sock);
+        if (w->stun_cfg.timer_heap)
+            pj_timer_heap_destroy(w->stun_cfg.timer_heap);
+        if (w->stun_cfg.ioqueue)
+            pj_ioqueue_destroy(w->stun_cfg.ioqueue);
+        if (w->pool)
+            pj_pool_release(w->pool);
+    }
+
+    if (g.ready_cnt)
+        pj_atomic_destroy(g.ready_cnt);
+    if (g.fail_cnt)
+        pj_atomic_destroy(g.fail_cnt);
+    if (g.pool)
+        pj_pool_release(g.pool);
+    pj_caching_pool_destroy(&g.cp);
+    pj_shutdown();
+}
+
+
+static int worker_thread(void *arg)
+{
+    struct worker *w = (struct worker*) arg;
+
+    while (!g.quit) {
+        const pj_time_val delay = {0, 10};
+
+        pj_ioqueue_poll(w->stun_cfg.ioqueue, &delay);
+        pj_timer_heap_poll(w->stun_cfg.timer_heap, NULL);
+    }
+
+    return 0;
+}
+
+
+static pj_status_t create_alloc(struct alloc *a)
+{
+    pj_turn_sock_cb rel_cb;
+    pj_stun_auth_cred cred;
+    pj_str_t srv;
+    pj_status_t status;
+
+    pj_bzero(&rel_cb, sizeof(rel_cb));
+    rel_cb.on_rx_data = &turn_on_rx_data;
+    rel_cb.on_state = &turn_on_state;
+    CHECK( pj_turn_sock_create(&a->worker->stun_cfg, pj_AF_INET(),
+                               (o.use_tcp? PJ_TURN_TP_TCP : PJ_TURN_TP_UDP),
+                               &rel_cb, NULL, a, &a->relay) );
+
+    pj_bzero(&cred, sizeof(cred));
+    cred.type = PJ_STUN_AUTH_CRED_STATIC;
+    cred.data.static_cred.realm = pj_str(o.realm);
+    cred.data.static_cred.username = pj_str(o.user_name);
+    cred.data.static_cred.data_type = PJ_STUN_PASSWD_PLAIN;
+    cred.data.static_cred.data = pj_str(o.password);
+
+    srv = pj_str(o.srv_addr);
+    CHECK( pj_turn_sock_alloc(a->relay, &srv,
+                              (o.srv_port?atoi(o.srv_port):PJ_STUN_PORT),
+                              NULL, &cred, NULL) );
+
+    return PJ_SUCCESS;
+}
+
+
+static void turn_on_state(pj_turn_sock *relay, pj_turn_state_t old_state,
+                          pj_turn_state_t new_state)
+{
+    struct alloc *a = (struct alloc*) pj_turn_sock_get_user_data(relay);
+
+    PJ_UNUSED_ARG(old_state);
+
+    if (!a)
+        return;
+
+    if (new_state == PJ_TURN_STATE_READY) {
+        pj_status_t status;
+
+        /* Bind a channel to the worker's peer */
+        status = pj_turn_sock_bind_channel(relay, &a->worker->peer_addr,
+                                    pj_sockaddr_get_len(&a->worker->peer_addr));
+        if (status != PJ_SUCCESS) {
+            my_perror("pj_turn_sock_bind_channel()", status);
+            a->failed = PJ_TRUE;
+            pj_atomic_inc(g.fail_cnt);
+            return;
+        }
+
+        a->ready = PJ_TRUE;
+        pj_atomic_inc(g.ready_cnt);
+
+    } else if (new_state > PJ_TURN_STATE_READY) {
+        if (a->ready) {
+            a->ready = PJ_FALSE;
+            pj_atomic_dec(g.ready_cnt);
+        } else if (!a->failed && g.quit == PJ_FALSE &&
+                   new_state >= PJ_TURN_STATE_DEALLOCATING)
+        {
+            a->failed = PJ_TRUE;
+            pj_atomic_inc(g.fail_cnt);
+        }
+        if (new_state == PJ_TURN_STATE_DESTROYING) {
+            pj_turn_sock_set_user_data(relay, NULL);
+            a->relay = NULL;
+        }
+    }
+}
+
+
+static void turn_on_rx_data(pj_turn_sock *relay,
+                            void *pkt,
+                            unsigned pkt_len,
+                            const pj_sockaddr_t *peer_addr,
+                            unsigned addr_len)
+{
+    struct alloc *a = (struct alloc*) pj_turn_sock_get_user_data(relay);
+    struct worker *w;
+    bench_pkt hdr;
+    pj_timestamp now;
+    pj_uint32_t usec;
+
+    PJ_UNUSED_ARG(peer_addr);
+    PJ_UNUSED_ARG(addr_len);
+
+    if (!a || pkt_len < sizeof(hdr))
+        return;
+
+    w = a->worker;
+    pj_memcpy(&hdr, pkt, sizeof(hdr));
+    pj_get_timestamp(&now);
+    usec = pj_elapsed_usec(&hdr.ts, &now);
+
+    ++w->rx;
+    if (usec / HIST_RES_USEC < HIST_BUCKETS)
+        ++w->hist[usec / HIST_RES_USEC];
+    else
+        ++w->hist_over;
+    if (usec > w->max_usec)
+        w->max_usec = usec;
+}
+
+
+/* The peer echoes everything back to the relay */
+static pj_bool_t peer_on_data_recvfrom(pj_activesock_t *asock,
+                                       void *data,
+                                       pj_size_t size,
+                                       const pj_sockaddr_t *src_addr,
+                                       int addr_len,
+                                       pj_status_t status)
+{
+    struct worker *w = (struct worker*) pj_activesock_get_user_data(asock);
+
+    if (status == PJ_SUCCESS && size > 0) {
+        pj_ssize_t len = size;
+
+        ++w->peer_rx;
+        pj_sock_sendto(w->peer_fd, data, &len, 0, src_addr, addr_len);
+    }
+
+    return PJ_TRUE;
+}
+
+
+/* Send the packets due for the allocations, given the elapsed time */
+static void pump(unsigned elapsed_usec, char *buf)
+{
+    unsigned i;
+
+    for (i=0; i<g.alloc_cnt; ++i) {
+        struct alloc *a = &g.alloc[i];
+
+        if (!a->ready)
+            continue;
+
+        a->credit += (pj_uint64_t)elapsed_usec * o.rate;
+        while (a->credit >= 1000000) {
+            bench_pkt *hdr = (bench_pkt*)buf;
+            pj_status_t status;
+
+            a->credit -= 1000000;
+
+            hdr->alloc_id = a->id;
+            hdr->seq = a->seq++;
+            pj_get_timestamp(&hdr->ts);
+
+            status = pj_turn_sock_sendto(a->relay, (const pj_uint8_t*)buf,
+                                         o.size, &a->worker->peer_addr,
+                                   pj_sockaddr_get_len(&a->worker->peer_addr));
+            if (status == PJ_SUCCESS || status == PJ_EPENDING)
+                ++g.tx;
+            else
+                ++g.tx_err;
+        }
+    }
+}
+
+
+/* Get the latency (in usec) at the specified percentile (x10) */
+static unsigned get_percentile(const pj_uint32_t *hist, pj_uint64_t total,
+                               unsigned permille, unsigned max_usec)
+{
+    pj_uint64_t target, sum = 0;
+    unsigned i;
+
+    target = (total * permille + 999) / 1000;
+    for (i=0; i<HIST_BUCKETS; ++i) {
+        sum += hist[i];
+        if (sum >= target && sum > 0)
+            return (i + 1) * HIST_RES_USEC;
+    }
+    return max_usec;
+}
+
+
+static void report(unsigned dur_msec, const proc_stat *st_idle,
+                   const proc_stat *st_ready, const proc_stat *st_end)
+{
+    static const unsigned pct[] = { 500, 900, 990, 999 };
+    pj_uint32_t *hist;
+    pj_uint64_t rx = 0, peer_rx = 0, over = 0;
+    unsigned i, j, ready, max_usec = 0;
+
+    hist = (pj_uint32_t*) pj_pool_calloc(g.pool, HIST_BUCKETS,
+                                         sizeof(pj_uint32_t));
+    for (i=0; i<g.worker_cnt; ++i) {
+        struct worker *w = &g.worker[i];
+
+        rx += w->rx;
+        peer_rx += w->peer_rx;
+        over += w->hist_over;
+        if (w->max_usec > max_usec)
+            max_usec = w->max_usec;
+        for (j=0; j<HIST_BUCKETS; ++j)
+            hist[j] += w->hist[j];
+    }
+
+    ready = (unsigned) pj_atomic_get(g.ready_cnt);
+
+    printf("\n");
+    printf("Allocations      : %u ready, %u failed (of %u)\n",
+           ready, (unsigned)pj_atomic_get(g.fail_cnt), g.alloc_cnt);
+    printf("Duration         : %u.%03u s\n", dur_msec/1000, dur_msec%1000);
+    printf("Packet size      : %u bytes, %u pps per allocation\n",
+           o.size, o.rate);
+    printf("Sent by clients  : %llu (%llu error)\n",
+           (unsigned long long)g.tx, (unsigned long long)g.tx_err);
+    printf("Received by peers: %llu\n", (unsigned long long)peer_rx);
+    printf("Echoed to clients: %llu (%llu lost)\n",
+           (unsigned long long)rx,
+           (unsigned long long)(g.tx > rx ? g.tx - rx : 0));
+    if (dur_msec) {
+        printf("Relay rate       : %llu pps (client->peer + peer->client)\n",
+               (unsigned long long)((peer_rx + rx) * 1000 / dur_msec));
+    }
+
+    printf("Round trip (2 relay traversals):\n");
+    for (i=0; i<PJ_ARRAY_SIZE(pct); ++i) {
+        unsigned usec = get_percentile(hist, rx, pct[i], max_usec);
+        printf("  p%-5.1f         : %u.%03u ms\n", pct[i]/10.0,
+               usec/1000, usec%1000);
+    }
+    printf("  max            : %u.%03u ms\n", max_usec/1000, max_usec%1000);
+    if (over) {
+        printf("  over %d ms     : %llu\n", HIST_BUCKETS*HIST_RES_USEC/1000,
+               (unsigned long long)over);
+    }
+
+    if (st_idle->valid && st_ready->valid && st_end->valid && ready) {
+        double cpu = (st_end->cpu_sec - st_ready->cpu_sec) * 100000.0 /
+                     (dur_msec ? dur_msec : 1);
+        long mem = (long)st_ready->rss - (long)st_idle->rss;
+
+        printf("Server CPU       : %.1f%% total, %.3f%% per allocation\n",
+               cpu, cpu / ready);
+        printf("Server memory    : %ld KB total, %ld bytes per allocation\n",
+               mem / 1024, mem / (long)ready);
+    } else if (o.srv_pid) {
+        printf("Server stats     : unavailable\n");
+    }
+}
+
+
+static pj_status_t run(void)
+{
+    proc_stat st_idle, st_ready, st_end;
+    pj_time_val start, now, last;
+    unsigned i, created, dur_msec;
+    char *buf;
+
+    read_proc_stat(o.srv_pid, &st_idle);
+
+    /* Create the allocations, with the specified rate */
+    PJ_LOG(3,(THIS_FILE, "Creating allocations.."));
+    pj_gettimeofday(&start);
+    for (created=0; created<g.alloc_cnt; ) {
+        unsigned due;
+
+        pj_gettimeofday(&now);
+        PJ_TIME_VAL_SUB(now, start);
+        due = (unsigned)(PJ_TIME_VAL_MSEC(now) * o.alloc_rate / 1000) + 1;
+
+        for (; created<due && created<g.alloc_cnt; ++created) {
+            if (create_alloc(&g.alloc[created]) != PJ_SUCCESS) {
+                g.alloc[created].failed = PJ_TRUE;
+                pj_atomic_inc(g.fail_cnt);
+            }
+        }
+        pj_thread_sleep(TICK_MSEC);
+    }
+
+    /* Wait until all allocations are done */
+    pj_gettimeofday(&start);
+    for (;;) {
+        unsigned done = (unsigned)(pj_atomic_get(g.ready_cnt) +
+                                   pj_atomic_get(g.fail_cnt));
+        if (done >= g.alloc_cnt)
+            break;
+
+        pj_gettimeofday(&now);
+        PJ_TIME_VAL_SUB(now, start);
+        if (now.sec >= SETUP_TIMEOUT) {
+            PJ_LOG(2,(THIS_FILE, "Timeout waiting for allocations"));
+            break;
+        }
+        pj_thread_sleep(100);
+    }
+
+    PJ_LOG(3,(THIS_FILE, "%ld allocation(s) ready, %ld failed",
+              pj_atomic_get(g.ready_cnt), pj_atomic_get(g.fail_cnt)));
+    if (pj_atomic_get(g.ready_cnt) == 0)
+        return PJ_ENOTFOUND;
+
+    /* Wait for the ChannelBind to complete */
+    pj_thread_sleep(WARMUP_MSEC);
+    read_proc_stat(o.srv_pid, &st_ready);
+
+    /* Reset statistics gathered during the setup */
+    for (i=0; i<g.worker_cnt; ++i) {
+        struct worker *w = &g.worker[i];
+        w->rx = w->peer_rx = 0;
+        w->hist_over = w->max_usec = 0;
+        pj_bzero(w->hist, HIST_BUCKETS * sizeof(pj_uint32_t));
+    }
+
+    /* Pump */
+    PJ_LOG(3,(THIS_FILE, "Sending for %d seconds..", o.duration));
+    buf = (char*) pj_pool_zalloc(g.pool, o.size);
+    pj_gettimeofday(&start);
+    last = start;
+    for (;;) {
+        pj_time_val elapsed;
+
+        pj_gettimeofday(&now);
+        elapsed = now;
+        PJ_TIME_VAL_SUB(elapsed, last);
+        last = now;
+        pump((unsigned)PJ_TIME_VAL_MSEC(elapsed) * 1000, buf);
+
+        PJ_TIME_VAL_SUB(now, start);
+        if (now.sec >= (long)o.duration)
+            break;
+
+        pj_thread_sleep(TICK_MSEC);
+    }
+    pj_gettimeofday(&now);
+    PJ_TIME_VAL_SUB(now, start);
+    dur_msec = (unsigned)PJ_TIME_VAL_MSEC(now);
+    read_proc_stat(o.srv_pid, &st_end);
+
+    /* Wait for the last echoes */
+    pj_thread_sleep(DRAIN_MSEC);
+
+    report(dur_msec, &st_idle, &st_ready, &st_end);
+
+    return PJ_SUCCESS;
+}
+
+
+static void usage(void)
+{
+    puts("Usage: pjturn_bench TURN-SERVER [OPTIONS]");
+    puts("");
+    puts("where TURN-SERVER is \"host[:port]\"");
+    puts("");
+    puts("and OPTIONS:");
+    puts(" --tcp, -T             Use TCP to connect to TURN server");
+    puts(" --realm, -r REALM     Set realm of the credential to REALM");
+    puts(" --username, -u UID    Set username of the credential to UID");
+    puts(" --password, -p PASSWD Set password of the credential to PASSWD");
+    puts(" --count, -n N         Number of allocations (default: 100)");
+    puts(" --duration, -d SEC    Sending duration (default: 10)");
+    puts(" --rate, -R PPS        Packets per second per allocation (default: 50)");
+    puts(" --size, -s BYTES      Packet size (default: 172)");
+    puts(" --alloc-rate, -a N    Allocations created per second (default: 100)");
+    puts(" --peer, -P IP         Address to bind the peers to (default: 127.0.0.1)");
+    puts(" --srv-pid, -i PID     Server process ID, to report its CPU and memory");
+    puts("                       usage per allocation (Linux only)");
+    puts(" --help, -h");
+    puts("");
+    puts("Note that the number of sockets per ioqueue is limited by");
+    puts("PJ_IOQUEUE_MAX_HANDLES, for both the server and this tool. The");
+    puts("allocations are spread among worker threads accordingly.");
+}
+
+int main(int argc, char *argv[])
+{
+    struct pj_getopt_option long_options[] = {
+        { "realm",      1, 0, 'r'},
+        { "username",   1, 0, 'u'},
+        { "password",   1, 0, 'p'},
+        { "tcp",        0, 0, 'T'},
+        { "count",      1, 0, 'n'},
+        { "duration",   1, 0, 'd'},
+        { "rate",       1, 0, 'R'},
+        { "size",       1, 0, 's'},
+        { "alloc-rate", 1, 0, 'a'},
+        { "peer",       1, 0, 'P'},
+        { "srv-pid",    1, 0, 'i'},
+        { "help",       0, 0, 'h'},
+        { NULL,         0, 0, 0}
+    };
+    int c, opt_id;
+    char *pos;
+    pj_status_t status;
+
+    o.realm = "pjsip.org";
+    o.user_name = "100";
+    o.password = "100";
+    o.peer_ip = "127.0.0.1";
+    o.count = 100;
+    o.duration = 10;
+    o.rate = 50;
+    o.size = 172;
+    o.alloc_rate = 100;
+
+    while((c=pj_getopt_long(argc,argv, "r:u:p:n:d:R:s:a:P:i:hT",
+                            long_options, &opt_id))!=-1)
+    {
+        switch (c) {
+        case 'r':
+            o.realm = pj_optarg;
+            break;
+        case 'u':
+            o.user_name = pj_optarg;
+            break;
+        case 'p':
+            o.password = pj_optarg;
+            break;
+        case 'T':
+            o.use_tcp = PJ_TRUE;
+            break;
+        case 'n':
+            o.count = atoi(pj_optarg);
+            break;
+        case 'd':
+            o.duration = atoi(pj_optarg);
+            break;
+        case 'R':
+            o.rate = atoi(pj_optarg);
+            break;
+        case 's':
+            o.size = atoi(pj_optarg);
+            break;
+        case 'a':
+            o.alloc_rate = atoi(pj_optarg);
+            break;
+        case 'P':
+            o.peer_ip = pj_optarg;
+            break;
+        case 'i':
+            o.srv_pid = atoi(pj_optarg);
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            printf("Argument \"%s\" is not valid. Use -h to see help",
+                   argv[pj_optind]);
+            return 1;
+        }
+    }
+
+    if (pj_optind == argc) {
+        puts("Error: TURN-SERVER is needed");
+        usage();
+        return 1;
+    }
+
+    if (o.count == 0 || o.rate == 0 || o.alloc_rate == 0 ||
+        o.size < sizeof(bench_pkt) || o.size > PJ_TURN_MAX_PKT_LEN)
+    {
+        puts("Error: invalid count, rate, or size");
+        return 1;
+    }
+
+    if ((pos=pj_ansi_strchr(argv[pj_optind], ':')) != NULL) {
+        o.srv_addr = argv[pj_optind];
+        *pos = '\0';
+        o.srv_port = pos+1;
+    } else {
+        o.srv_addr = argv[pj_optind];
+    }
+
+    if ((status=init()) == PJ_SUCCESS)
+        status = run();
+
+    bench_shutdown();
+    return status ? 1 : 0;
+}
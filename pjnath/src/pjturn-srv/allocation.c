@@ -303,6 +303,7 @@ PJ_DEF(pj_status_t) pj_turn_allocation_create(pj_turn_transport *transport,
     alloc->obj_name = pool->obj_name;
     alloc->relay.tp.sock = PJ_INVALID_SOCKET;
     alloc->server = transport->listener->server;
+    alloc->shard = transport->shard;
 
     alloc->bandwidth = req.bandwidth;
 
@@ -322,9 +323,6 @@ PJ_DEF(pj_status_t) pj_turn_allocation_create(pj_turn_transport *transport,
     /* Create peer hash table */
     alloc->peer_table = pj_hash_create(pool, PEER_TABLE_SIZE);
 
-    /* Create channel hash table */
-    alloc->ch_table = pj_hash_create(pool, PEER_TABLE_SIZE);
-
     /* Print info */
     pj_ansi_strxcpy(alloc->info,
                     pj_turn_tp_type_name(transport->listener->tp_type),
@@ -337,7 +335,7 @@ PJ_DEF(pj_status_t) pj_turn_allocation_create(pj_turn_transport *transport,
     sess_cb.on_send_msg = &stun_on_send_msg;
     sess_cb.on_rx_request = &stun_on_rx_request;
     sess_cb.on_rx_indication = &stun_on_rx_indication;
-    status = pj_stun_session_create(&srv->core.stun_cfg, alloc->obj_name,
+    status = pj_stun_session_create(&alloc->shard->stun_cfg, alloc->obj_name,
                                     &sess_cb, PJ_FALSE, NULL, &alloc->sess);
     if (status != PJ_SUCCESS) {
         goto on_error;
@@ -363,7 +361,9 @@ PJ_DEF(pj_status_t) pj_turn_allocation_create(pj_turn_transport *transport,
     }
 
     /* Register this allocation */
-    pj_turn_srv_register_allocation(srv, alloc);
+    status = pj_turn_srv_register_allocation(srv, alloc);
+    if (status != PJ_SUCCESS)
+        goto on_error;
 
     /* Respond to ALLOCATE request */
     status = send_allocate_response(alloc, srv_sess, transport, rdata);
@@ -395,8 +395,12 @@ on_error:
 /* Destroy relay resource */
 static void destroy_relay(pj_turn_relay_res *relay)
 {
+    /* Don't leave queued packets referring to the socket */
+    if (relay->allocation && relay->allocation->shard)
+        pj_turn_srv_shard_flush(relay->allocation->shard);
+
     if (relay->timer.id) {
-        pj_timer_heap_cancel(relay->allocation->server->core.timer_heap,
+        pj_timer_heap_cancel(relay->allocation->shard->timer_heap,
                              &relay->timer);
         relay->timer.id = PJ_FALSE;
     }
@@ -492,7 +496,7 @@ static void alloc_shutdown(pj_turn_allocation *alloc)
     /* Work with existing schedule */
     if (alloc->relay.timer.id == TIMER_ID_TIMEOUT) {
         /* Cancel existing shutdown timer */
-        pj_timer_heap_cancel(alloc->server->core.timer_heap,
+        pj_timer_heap_cancel(alloc->shard->timer_heap,
                              &alloc->relay.timer);
         alloc->relay.timer.id = TIMER_ID_NONE;
 
@@ -514,7 +518,7 @@ static void alloc_shutdown(pj_turn_allocation *alloc)
 
     /* Schedule destroy timer */
     alloc->relay.timer.id = TIMER_ID_DESTROY;
-    pj_timer_heap_schedule(alloc->server->core.timer_heap,
+    pj_timer_heap_schedule(alloc->shard->timer_heap,
                            &alloc->relay.timer, &destroy_delay);
 }
 
@@ -530,7 +534,7 @@ static pj_status_t resched_timeout(pj_turn_allocation *alloc)
 
     pj_assert(alloc->relay.timer.id != TIMER_ID_DESTROY);
     if (alloc->relay.timer.id != 0) {
-        pj_timer_heap_cancel(alloc->server->core.timer_heap,
+        pj_timer_heap_cancel(alloc->shard->timer_heap,
                              &alloc->relay.timer);
         alloc->relay.timer.id = TIMER_ID_NONE;
     }
@@ -539,7 +543,7 @@ static pj_status_t resched_timeout(pj_turn_allocation *alloc)
     delay.msec = 0;
 
     alloc->relay.timer.id = TIMER_ID_TIMEOUT;
-    status = pj_timer_heap_schedule(alloc->server->core.timer_heap,
+    status = pj_timer_heap_schedule(alloc->shard->timer_heap,
                                     &alloc->relay.timer, &delay);
     if (status != PJ_SUCCESS) {
         alloc->relay.timer.id = TIMER_ID_NONE;
@@ -722,8 +726,9 @@ static pj_status_t create_relay(pj_turn_srv *srv,
     pj_bzero(&icb, sizeof(icb));
     icb.on_read_complete = &on_rx_from_peer;
 
-    status = pj_ioqueue_register_sock(pool, srv->core.ioqueue, relay->tp.sock,
-                                      relay, &icb, &relay->tp.key);
+    status = pj_ioqueue_register_sock(pool, alloc->shard->ioqueue,
+                                      relay->tp.sock, relay, &icb,
+                                      &relay->tp.key);
     if (status != PJ_SUCCESS) {
         PJ_LOG(4,(THIS_FILE, "pj_ioqueue_register_sock() failed: err %d",
                   status));
@@ -828,6 +833,35 @@ static pj_turn_permission *create_permission(pj_turn_allocation *alloc,
     return perm;
 }
 
+/* Get the channel table entry of the channel number, optionally allocating
+ * the chunk. Return NULL if the channel number is invalid or the chunk
+ * doesn't exist.
+ */
+static pj_turn_permission **get_ch_slot(pj_turn_allocation *alloc,
+                                        unsigned chnum,
+                                        pj_bool_t create)
+{
+    unsigned idx, chunk;
+
+    if (chnum < PJ_TURN_SRV_CH_MIN || chnum > PJ_TURN_SRV_CH_MAX)
+        return NULL;
+
+    idx = chnum - PJ_TURN_SRV_CH_MIN;
+    chunk = idx / PJ_TURN_SRV_CH_CHUNK;
+
+    if (alloc->ch_table[chunk] == NULL) {
+        if (!create)
+            return NULL;
+
+        alloc->ch_table[chunk] = (pj_turn_permission**)
+                                 pj_pool_calloc(alloc->pool,
+                                                PJ_TURN_SRV_CH_CHUNK,
+                                                sizeof(pj_turn_permission*));
+    }
+
+    return &alloc->ch_table[chunk][idx % PJ_TURN_SRV_CH_CHUNK];
+}
+
 /* Check if a permission isn't expired. Return NULL if expired. */
 static pj_turn_permission *check_permission_expiry(pj_turn_permission *perm)
 {
@@ -845,10 +879,14 @@ static pj_turn_permission *check_permission_expiry(pj_turn_permission *perm)
                 pj_sockaddr_get_addr(&perm->hkey.peer_addr),
                 pj_sockaddr_get_addr_len(&perm->hkey.peer_addr), 0, NULL);
 
-    /* Remove from channel hash table, if assigned a channel number */
+    /* Remove from channel table, if assigned a channel number */
     if (perm->channel != PJ_TURN_INVALID_CHANNEL) {
-        pj_hash_set(NULL, alloc->ch_table, &perm->channel,
-                    sizeof(perm->channel), 0, NULL);
+        pj_turn_permission **slot = get_ch_slot(alloc, perm->channel,
+                                                PJ_FALSE);
+        if (slot && *slot == perm) {
+            *slot = NULL;
+            --alloc->ch_cnt;
+        }
     }
 
     return NULL;
@@ -873,18 +911,15 @@ lookup_permission_by_addr(pj_turn_allocation *alloc,
     return perm ? check_permission_expiry(perm) : NULL;
 }
 
-/* Lookup permission in hash table by the channel number */
+/* Lookup permission in the channel table by the channel number */
 static pj_turn_permission*
 lookup_permission_by_chnum(pj_turn_allocation *alloc,
                            unsigned chnum)
 {
-    pj_uint16_t chnum16 = (pj_uint16_t)chnum;
-    pj_turn_permission *perm;
+    pj_turn_permission **slot;
 
-    /* Lookup in peer hash table */
-    perm = (pj_turn_permission*) pj_hash_get(alloc->ch_table, &chnum16,
-                                            sizeof(chnum16), NULL);
-    return perm ? check_permission_expiry(perm) : NULL;
+    slot = get_ch_slot(alloc, chnum, PJ_FALSE);
+    return (slot && *slot) ? check_permission_expiry(*slot) : NULL;
 }
 
 /* Update permission because of data from client to peer.
@@ -900,6 +935,56 @@ static pj_bool_t refresh_permission(pj_turn_permission *perm)
     return PJ_TRUE;
 }
 
+/*
+ * ChannelData fast path. An allocation is only accessed by the worker
+ * thread of its shard (packets received by other shards are handed over
+ * by the server), which is also the only thread modifying the channel
+ * table and destroying the permissions, so the allocation lock is not
+ * needed to relay the data. Packets which need any kind of special
+ * treatment are left to the normal path.
+ *
+ * Return PJ_TRUE if the packet has been relayed.
+ */
+static pj_bool_t relay_channel_data(pj_turn_allocation *alloc,
+                                    pj_turn_pkt *pkt)
+{
+    pj_turn_channel_data *cd = (pj_turn_channel_data*)pkt->pkt;
+    pj_turn_permission **slot, *perm;
+    pj_time_val now;
+    pj_size_t len;
+
+    if (pkt->transport->listener->tp_type != PJ_TURN_TP_UDP ||
+        alloc->relay.tp.sock == PJ_INVALID_SOCKET)
+    {
+        return PJ_FALSE;
+    }
+
+    len = pj_ntohs(cd->length);
+    if (pkt->len < len + sizeof(*cd))
+        return PJ_FALSE;
+
+    slot = get_ch_slot(alloc, pj_ntohs(cd->ch_number), PJ_FALSE);
+    perm = slot ? *slot : NULL;
+    if (!perm)
+        return PJ_FALSE;
+
+    /* Expired permission will be removed by the normal path */
+    pj_gettimeofday(&now);
+    if (!PJ_TIME_VAL_GT(perm->expiry, now))
+        return PJ_FALSE;
+
+    /* Relay the data */
+    pj_turn_srv_shard_sendto(alloc->shard, alloc->relay.tp.sock, NULL, 0,
+                             cd+1, len, &perm->hkey.peer_addr,
+                             pj_sockaddr_get_len(&perm->hkey.peer_addr));
+
+    /* Refresh permission */
+    perm->expiry.sec = now.sec + PJ_TURN_CHANNEL_TIMEOUT;
+    perm->expiry.msec = now.msec;
+
+    return PJ_TRUE;
+}
+
 /*
  * Handle incoming packet from client. This would have been called by
  * server upon receiving packet from a listener.
@@ -910,6 +995,16 @@ PJ_DEF(void) pj_turn_allocation_on_rx_client_pkt(pj_turn_allocation *alloc,
     pj_bool_t is_stun;
     pj_status_t status;
 
+    /* Must be called by the worker thread of the allocation's shard */
+    pj_assert(pj_turn_srv_shard_is_current(alloc->shard));
+
+    /* ChannelData (first two bits are 01) takes the fast path if possible */
+    if ((*((pj_uint8_t*)pkt->pkt) & 0xC0) == 0x40 &&
+        relay_channel_data(alloc, pkt))
+    {
+        return;
+    }
+
     /* Lock this allocation */
     pj_lock_acquire(alloc->lock);
 
@@ -1043,6 +1138,17 @@ static void handle_peer_pkt(pj_turn_allocation *alloc,
         cd->ch_number = pj_htons(perm->channel);
         cd->length = pj_htons((pj_uint16_t)len);
 
+        /* Queue to the shard's batch if possible */
+        if (alloc->transport->sock != PJ_INVALID_SOCKET &&
+            pj_turn_srv_shard_sendto(alloc->shard, alloc->transport->sock,
+                                     cd, sizeof(*cd), pkt, len,
+                                     &alloc->hkey.clt_addr,
+                                     pj_sockaddr_get_len(&alloc->hkey.clt_addr))
+                == PJ_SUCCESS)
+        {
+            return;
+        }
+
         /* Copy data */
         pj_memcpy(rel->tp.tx_pkt+sizeof(pj_turn_channel_data), pkt, len);
 
@@ -1241,6 +1347,15 @@ static pj_status_t stun_on_rx_request(pj_stun_session *sess,
             return PJ_SUCCESS;
         }
 
+        /* Check the channel number range */
+        if (PJ_STUN_GET_CH_NB(ch_attr->value) < PJ_TURN_SRV_CH_MIN ||
+            PJ_STUN_GET_CH_NB(ch_attr->value) > PJ_TURN_SRV_CH_MAX)
+        {
+            send_reply_err(alloc, rdata, PJ_TRUE, PJ_STUN_SC_BAD_REQUEST,
+                           "Invalid channel number");
+            return PJ_SUCCESS;
+        }
+
         /* Find permission with the channel number */
         p1 = lookup_permission_by_chnum(alloc, PJ_STUN_GET_CH_NB(ch_attr->value));
 
@@ -1288,10 +1403,9 @@ static pj_status_t stun_on_rx_request(pj_stun_session *sess,
         /* Assign channel number to permission */
         p2->channel = PJ_STUN_GET_CH_NB(ch_attr->value);
 
-        /* Register to hash table */
-        pj_assert(sizeof(p2->channel)==2);
-        pj_hash_set(alloc->pool, alloc->ch_table, &p2->channel,
-                    sizeof(p2->channel), 0, p2);
+        /* Register to channel table */
+        *get_ch_slot(alloc, p2->channel, PJ_TRUE) = p2;
+        ++alloc->ch_cnt;
 
         /* Update */
         refresh_permission(p2);
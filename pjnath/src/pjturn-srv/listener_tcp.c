@@ -35,6 +35,7 @@ struct tcp_listener
     pj_ioqueue_key_t        *key;
     unsigned                 accept_cnt;
     struct accept_op        *accept_op; /* Array of accept_op's */
+    unsigned                 next_shard;/* Shard for next connection */
 };
 
 
@@ -44,6 +45,7 @@ static void lis_on_accept_complete(pj_ioqueue_key_t *key,
                                    pj_status_t status);
 static pj_status_t lis_destroy(pj_turn_listener *listener);
 static void transport_create(pj_sock_t sock, pj_turn_listener *lis,
+                             pj_turn_srv_shard *shard,
                              pj_sockaddr_t *src_addr, int src_addr_len);
 
 static void show_err(const char *sender, const char *title, 
@@ -113,11 +115,14 @@ PJ_DEF(pj_status_t) pj_turn_listener_create_tcp(pj_turn_srv *srv,
     if (status != PJ_SUCCESS)
         goto on_error;
 
-    /* Register to ioqueue */
+    /* Register to ioqueue. Connections are accepted by the first shard,
+     * and handed over to the shards in round-robin fashion.
+     */
     pj_bzero(&ioqueue_cb, sizeof(ioqueue_cb));
     ioqueue_cb.on_accept_complete = &lis_on_accept_complete;
-    status = pj_ioqueue_register_sock(pool, srv->core.ioqueue, tcp_lis->base.sock,
-                                      tcp_lis, &ioqueue_cb, &tcp_lis->key);
+    status = pj_ioqueue_register_sock(pool, srv->core.shard[0].ioqueue,
+                                      tcp_lis->base.sock, tcp_lis,
+                                      &ioqueue_cb, &tcp_lis->key);
 
     /* Create op keys */
     tcp_lis->accept_op = (struct accept_op*)pj_pool_calloc(pool, concurrency_cnt,
@@ -195,11 +200,19 @@ static void lis_on_accept_complete(pj_ioqueue_key_t *key,
     do {
         /* Report new connection. */
         if (status == PJ_SUCCESS) {
+            pj_turn_srv *srv = tcp_lis->base.server;
+            pj_turn_srv_shard *shard;
             char addr[PJ_INET6_ADDRSTRLEN+8];
-            PJ_LOG(5,(tcp_lis->base.obj_name, "Incoming TCP from %s",
+
+            shard = &srv->core.shard[tcp_lis->next_shard];
+            tcp_lis->next_shard = (tcp_lis->next_shard + 1) %
+                                  srv->core.shard_cnt;
+
+            PJ_LOG(5,(tcp_lis->base.obj_name, "Incoming TCP from %s (%s)",
                       pj_sockaddr_print(&accept_op->src_addr, addr,
-                                        sizeof(addr), 3)));
-            transport_create(accept_op->sock, &tcp_lis->base,
+                                        sizeof(addr), 3),
+                      shard->obj_name));
+            transport_create(accept_op->sock, &tcp_lis->base, shard,
                              &accept_op->src_addr, accept_op->src_addr_len);
         } else if (status != PJ_EPENDING) {
             show_err(tcp_lis->base.obj_name, "accept()", status);
@@ -275,6 +288,7 @@ static void timer_callback(pj_timer_heap_t *timer_heap,
                            pj_timer_entry *entry);
 
 static void transport_create(pj_sock_t sock, pj_turn_listener *lis,
+                             pj_turn_srv_shard *shard,
                              pj_sockaddr_t *src_addr, int src_addr_len)
 {
     pj_pool_t *pool;
@@ -287,6 +301,8 @@ static void transport_create(pj_sock_t sock, pj_turn_listener *lis,
     tcp = PJ_POOL_ZALLOC_T(pool, struct tcp_transport);
     tcp->base.obj_name = pool->obj_name;
     tcp->base.listener = lis;
+    tcp->base.shard = shard;
+    tcp->base.sock = PJ_INVALID_SOCKET;
     tcp->base.info = lis->info;
     tcp->base.sendto = &tcp_sendto;
     tcp->base.add_ref = &tcp_add_ref;
@@ -299,7 +315,7 @@ static void transport_create(pj_sock_t sock, pj_turn_listener *lis,
     /* Register to ioqueue */
     pj_bzero(&cb, sizeof(cb));
     cb.on_read_complete = &tcp_on_read_complete;
-    status = pj_ioqueue_register_sock(pool, lis->server->core.ioqueue, sock,
+    status = pj_ioqueue_register_sock(pool, shard->ioqueue, sock,
                                       tcp, &cb, &tcp->key);
     if (status != PJ_SUCCESS) {
         tcp_destroy(tcp);
@@ -454,7 +470,7 @@ static void tcp_add_ref(pj_turn_transport *tp,
 
     /* Cancel shutdown timer if it's running */
     if (tcp->timer.id != TIMER_NONE) {
-        pj_timer_heap_cancel(tcp->base.listener->server->core.timer_heap,
+        pj_timer_heap_cancel(tcp->base.shard->timer_heap,
                              &tcp->timer);
         tcp->timer.id = TIMER_NONE;
     }
@@ -475,7 +491,7 @@ static void tcp_dec_ref(pj_turn_transport *tp,
     if (tcp->ref_cnt == 0 && tcp->timer.id == TIMER_NONE) {
         pj_time_val delay = { SHUTDOWN_DELAY, 0 };
         tcp->timer.id = TIMER_DESTROY;
-        pj_timer_heap_schedule(tcp->base.listener->server->core.timer_heap,
+        pj_timer_heap_schedule(tcp->base.shard->timer_heap,
                                &tcp->timer, &delay);
     }
 }
@@ -25,15 +25,26 @@ struct read_op
     pj_turn_pkt         pkt;
 };
 
+struct udp_listener;
+
+/* One socket for each server shard, all bound to the listener address */
+struct udp_socket
+{
+    pj_turn_transport        tp;        /* Transport instance, must be
+                                           the first member */
+    struct udp_listener     *udp;       /* The listener */
+    pj_sock_t                sock;
+    pj_ioqueue_key_t        *key;
+    struct read_op         **read_op;   /* Array of read_op's   */
+};
+
 struct udp_listener
 {
     pj_turn_listener         base;
 
-    pj_ioqueue_key_t        *key;
     unsigned                 read_cnt;
-    struct read_op          **read_op;  /* Array of read_op's   */
-
-    pj_turn_transport        tp;        /* Transport instance */
+    unsigned                 sock_cnt;
+    struct udp_socket       *sock;      /* Array of sockets */
 };
 
 
@@ -54,6 +65,121 @@ static void udp_dec_ref(pj_turn_transport *tp,
                         pj_turn_allocation *alloc);
 
 
+/*
+ * Create, bind, and register the socket of the specified shard.
+ */
+static pj_status_t create_socket(struct udp_listener *udp, unsigned idx,
+                                 pj_bool_t reuse_port)
+{
+    pj_turn_srv *srv = udp->base.server;
+    struct udp_socket *us = &udp->sock[idx];
+    pj_ioqueue_callback ioqueue_cb;
+    unsigned i;
+    pj_status_t status;
+
+    us->udp = udp;
+    us->tp.obj_name = udp->base.obj_name;
+    us->tp.info = udp->base.info;
+    us->tp.listener = &udp->base;
+    us->tp.shard = &srv->core.shard[idx];
+    us->tp.sendto = &udp_sendto;
+    us->tp.add_ref = &udp_add_ref;
+    us->tp.dec_ref = &udp_dec_ref;
+
+    /* Create socket */
+    status = pj_sock_socket(udp->base.addr.addr.sa_family, pj_SOCK_DGRAM(),
+                            0, &us->sock);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    us->tp.sock = us->sock;
+
+#if defined(SO_REUSEPORT)
+    if (reuse_port) {
+        int enabled = 1;
+        status = pj_sock_setsockopt(us->sock, pj_SOL_SOCKET(), SO_REUSEPORT,
+                                    &enabled, sizeof(enabled));
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+#else
+    PJ_UNUSED_ARG(reuse_port);
+#endif
+
+    /* Bind socket */
+    status = pj_sock_bind(us->sock, &udp->base.addr, 
+                          pj_sockaddr_get_len(&udp->base.addr));
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* The other sockets must bind to the same port */
+    if (pj_sockaddr_get_port(&udp->base.addr) == 0) {
+        pj_sockaddr bound_addr;
+        int namelen = sizeof(bound_addr);
+
+        status = pj_sock_getsockname(us->sock, &bound_addr, &namelen);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_sockaddr_set_port(&udp->base.addr,
+                             pj_sockaddr_get_port(&bound_addr));
+    }
+
+    /* Register to the shard's ioqueue */
+    pj_bzero(&ioqueue_cb, sizeof(ioqueue_cb));
+    ioqueue_cb.on_read_complete = on_read_complete;
+    status = pj_ioqueue_register_sock(udp->base.pool, us->tp.shard->ioqueue,
+                                      us->sock, us, &ioqueue_cb, &us->key);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* Create op keys */
+    us->read_op = (struct read_op**)pj_pool_calloc(udp->base.pool,
+                                                   udp->read_cnt,
+                                                   sizeof(struct read_op*));
+
+    /* Create each read_op and kick off read operation */
+    for (i=0; i<udp->read_cnt; ++i) {
+        pj_pool_t *rpool = pj_pool_create(srv->core.pf, "rop%p", 
+                                          1000, 1000, NULL);
+
+        us->read_op[i] = PJ_POOL_ZALLOC_T(udp->base.pool, struct read_op);
+        us->read_op[i]->pkt.pool = rpool;
+
+        on_read_complete(us->key, &us->read_op[i]->op_key, 0);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Close the socket and release its read operations.
+ */
+static void destroy_socket(struct udp_listener *udp, struct udp_socket *us)
+{
+    unsigned i;
+
+    if (us->key) {
+        pj_ioqueue_unregister(us->key);
+        us->key = NULL;
+        us->sock = PJ_INVALID_SOCKET;
+    } else if (us->sock != PJ_INVALID_SOCKET) {
+        pj_sock_close(us->sock);
+        us->sock = PJ_INVALID_SOCKET;
+    }
+    us->tp.sock = PJ_INVALID_SOCKET;
+
+    for (i=0; us->read_op && i<udp->read_cnt; ++i) {
+        if (us->read_op[i] && us->read_op[i]->pkt.pool) {
+            pj_pool_t *rpool = us->read_op[i]->pkt.pool;
+            us->read_op[i]->pkt.pool = NULL;
+            pj_pool_release(rpool);
+        }
+    }
+}
+
+
 /*
  * Create a new listener on the specified port.
  */
@@ -67,7 +193,6 @@ PJ_DEF(pj_status_t) pj_turn_listener_create_udp( pj_turn_srv *srv,
 {
     pj_pool_t *pool;
     struct udp_listener *udp;
-    pj_ioqueue_callback ioqueue_cb;
     unsigned i;
     pj_status_t status;
 
@@ -83,58 +208,49 @@ PJ_DEF(pj_status_t) pj_turn_listener_create_udp( pj_turn_srv *srv,
     udp->read_cnt = concurrency_cnt;
     udp->base.flags = flags;
 
-    udp->tp.obj_name = udp->base.obj_name;
-    udp->tp.info = udp->base.info;
-    udp->tp.listener = &udp->base;
-    udp->tp.sendto = &udp_sendto;
-    udp->tp.add_ref = &udp_add_ref;
-    udp->tp.dec_ref = &udp_dec_ref;
-
-    /* Create socket */
-    status = pj_sock_socket(af, pj_SOCK_DGRAM(), 0, &udp->base.sock);
-    if (status != PJ_SUCCESS)
-        goto on_error;
+    /* One socket for each shard, if the kernel can balance the packets */
+    udp->sock = (struct udp_socket*)
+                pj_pool_calloc(pool, srv->core.shard_cnt,
+                               sizeof(struct udp_socket));
+    for (i=0; i<srv->core.shard_cnt; ++i)
+        udp->sock[i].sock = PJ_INVALID_SOCKET;
+#if defined(SO_REUSEPORT)
+    udp->sock_cnt = srv->core.shard_cnt;
+#else
+    udp->sock_cnt = 1;
+#endif
 
     /* Init bind address */
     status = pj_sockaddr_init(af, &udp->base.addr, bound_addr, 
                               (pj_uint16_t)port);
     if (status != PJ_SUCCESS) 
         goto on_error;
-    
+
+    /* Create the sockets */
+    for (i=0; i<udp->sock_cnt; ++i) {
+        status = create_socket(udp, i, udp->sock_cnt > 1);
+        if (status != PJ_SUCCESS && i == 0 && udp->sock_cnt > 1) {
+            /* SO_REUSEPORT may not be supported, use single socket */
+            PJ_PERROR(4,(udp->base.obj_name, status,
+                         "Unable to bind socket with SO_REUSEPORT, "
+                         "falling back to single socket"));
+            destroy_socket(udp, &udp->sock[0]);
+            udp->sock_cnt = 1;
+            status = create_socket(udp, 0, PJ_FALSE);
+        }
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+    udp->base.sock = udp->sock[0].sock;
+
     /* Create info */
     pj_ansi_strxcpy(udp->base.info, "UDP:", sizeof(udp->base.info));
     pj_sockaddr_print(&udp->base.addr, udp->base.info+4, 
                       sizeof(udp->base.info)-4, 3);
 
-    /* Bind socket */
-    status = pj_sock_bind(udp->base.sock, &udp->base.addr, 
-                          pj_sockaddr_get_len(&udp->base.addr));
-    if (status != PJ_SUCCESS)
-        goto on_error;
-
-    /* Register to ioqueue */
-    pj_bzero(&ioqueue_cb, sizeof(ioqueue_cb));
-    ioqueue_cb.on_read_complete = on_read_complete;
-    status = pj_ioqueue_register_sock(pool, srv->core.ioqueue, udp->base.sock,
-                                      udp, &ioqueue_cb, &udp->key);
-
-    /* Create op keys */
-    udp->read_op = (struct read_op**)pj_pool_calloc(pool, concurrency_cnt, 
-                                                    sizeof(struct read_op*));
-
-    /* Create each read_op and kick off read operation */
-    for (i=0; i<concurrency_cnt; ++i) {
-        pj_pool_t *rpool = pj_pool_create(srv->core.pf, "rop%p", 
-                                          1000, 1000, NULL);
-
-        udp->read_op[i] = PJ_POOL_ZALLOC_T(pool, struct read_op);
-        udp->read_op[i]->pkt.pool = rpool;
-
-        on_read_complete(udp->key, &udp->read_op[i]->op_key, 0);
-    }
-
     /* Done */
-    PJ_LOG(4,(udp->base.obj_name, "Listener %s created", udp->base.info));
+    PJ_LOG(4,(udp->base.obj_name, "Listener %s created with %d socket(s)",
+              udp->base.info, udp->sock_cnt));
 
     *p_listener = &udp->base;
     return PJ_SUCCESS;
@@ -154,22 +270,9 @@ static pj_status_t udp_destroy(pj_turn_listener *listener)
     struct udp_listener *udp = (struct udp_listener *)listener;
     unsigned i;
 
-    if (udp->key) {
-        pj_ioqueue_unregister(udp->key);
-        udp->key = NULL;
-        udp->base.sock = PJ_INVALID_SOCKET;
-    } else if (udp->base.sock != PJ_INVALID_SOCKET) {
-        pj_sock_close(udp->base.sock);
-        udp->base.sock = PJ_INVALID_SOCKET;
-    }
-
-    for (i=0; i<udp->read_cnt; ++i) {
-        if (udp->read_op[i]->pkt.pool) {
-            pj_pool_t *rpool = udp->read_op[i]->pkt.pool;
-            udp->read_op[i]->pkt.pool = NULL;
-            pj_pool_release(rpool);
-        }
-    }
+    for (i=0; i<udp->sock_cnt; ++i)
+        destroy_socket(udp, &udp->sock[i]);
+    udp->base.sock = PJ_INVALID_SOCKET;
 
     if (udp->base.pool) {
         pj_pool_t *pool = udp->base.pool;
@@ -193,8 +296,9 @@ static pj_status_t udp_sendto(pj_turn_transport *tp,
                               const pj_sockaddr_t *addr,
                               int addr_len)
 {
+    struct udp_socket *us = (struct udp_socket*) tp;
     pj_ssize_t len = size;
-    return pj_sock_sendto(tp->listener->sock, packet, &len, flag, addr, addr_len);
+    return pj_sock_sendto(us->sock, packet, &len, flag, addr, addr_len);
 }
 
 
@@ -222,11 +326,11 @@ static void on_read_complete(pj_ioqueue_key_t *key,
                              pj_ioqueue_op_key_t *op_key, 
                              pj_ssize_t bytes_read)
 {
-    struct udp_listener *udp;
+    struct udp_socket *us;
     struct read_op *read_op = (struct read_op*) op_key;
     pj_status_t status;
 
-    udp = (struct udp_listener*) pj_ioqueue_get_user_data(key);
+    us = (struct udp_socket*) pj_ioqueue_get_user_data(key);
 
     do {
         pj_pool_t *rpool;
@@ -236,22 +340,22 @@ static void on_read_complete(pj_ioqueue_key_t *key,
             read_op->pkt.len = bytes_read;
             pj_gettimeofday(&read_op->pkt.rx_time);
 
-            pj_turn_srv_on_rx_pkt(udp->base.server, &read_op->pkt);
+            pj_turn_srv_on_rx_pkt(us->udp->base.server, &read_op->pkt);
         }
 
         /* Reset pool */
         rpool = read_op->pkt.pool;
         pj_pool_reset(rpool);
         read_op->pkt.pool = rpool;
-        read_op->pkt.transport = &udp->tp;
-        read_op->pkt.src.tp_type = udp->base.tp_type;
+        read_op->pkt.transport = &us->tp;
+        read_op->pkt.src.tp_type = us->udp->base.tp_type;
 
         /* Read next packet */
         bytes_read = sizeof(read_op->pkt.pkt);
         read_op->pkt.src_addr_len = sizeof(read_op->pkt.src.clt_addr);
         pj_bzero(&read_op->pkt.src.clt_addr, sizeof(read_op->pkt.src.clt_addr));
 
-        status = pj_ioqueue_recvfrom(udp->key, op_key,
+        status = pj_ioqueue_recvfrom(us->key, op_key,
                                      read_op->pkt.pkt, &bytes_read, 0,
                                      &read_op->pkt.src.clt_addr, 
                                      &read_op->pkt.src_addr_len);
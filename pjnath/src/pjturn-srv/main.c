@@ -18,6 +18,7 @@
  */
 #include "turn.h"
 #include "auth.h"
+#include <pjlib-util.h>
 
 #define REALM           "pjsip.org"
 //#define TURN_PORT     PJ_STUN_TURN_PORT
@@ -41,25 +42,29 @@ static void dump_status(pj_turn_srv *srv)
     char addr[80];
     pj_hash_iterator_t itbuf, *it;
     pj_time_val now;
-    unsigned i;
+    unsigned i, j, client_cnt;
 
     for (i=0; i<srv->core.lis_cnt; ++i) {
         pj_turn_listener *lis = srv->core.listener[i];
         printf("Server address : %s\n", lis->info);
     }
 
-    printf("Worker threads : %d\n", srv->core.thread_cnt);
+    client_cnt = 0;
+    for (i=0; i<srv->core.shard_cnt; ++i)
+        client_cnt += pj_hash_count(srv->core.shard[i].tables.alloc);
+
+    printf("Worker threads : %d\n", srv->core.shard_cnt);
     printf("Total mem usage: %u.%03uMB\n", (unsigned)(g_cp.used_size / 1000000), 
            (unsigned)((g_cp.used_size % 1000000)/1000));
     printf("UDP port range : %u %u %u (next/min/max)\n", srv->ports.next_udp,
            srv->ports.min_udp, srv->ports.max_udp);
     printf("TCP port range : %u %u %u (next/min/max)\n", srv->ports.next_tcp,
            srv->ports.min_tcp, srv->ports.max_tcp);
-    printf("Clients #      : %u\n", pj_hash_count(srv->tables.alloc));
+    printf("Clients #      : %u\n", client_cnt);
 
     puts("");
 
-    if (pj_hash_count(srv->tables.alloc)==0) {
+    if (client_cnt==0) {
         return;
     }
 
@@ -68,24 +73,31 @@ static void dump_status(pj_turn_srv *srv)
 
     pj_gettimeofday(&now);
 
-    it = pj_hash_first(srv->tables.alloc, &itbuf);
     i=1;
-    while (it) {
-        pj_turn_allocation *alloc = (pj_turn_allocation*) 
-                                    pj_hash_this(srv->tables.alloc, it);
-        printf("%-3d %-22s %-22s %-8.*s %-4d %-4ld %-4d %-4d\n",
-               i,
-               alloc->info,
-               pj_sockaddr_print(&alloc->relay.hkey.addr, addr, sizeof(addr), 3),
-               (int)alloc->cred.data.static_cred.username.slen,
-               alloc->cred.data.static_cred.username.ptr,
-               alloc->relay.lifetime,
-               alloc->relay.expiry.sec - now.sec,
-               pj_hash_count(alloc->peer_table), 
-               pj_hash_count(alloc->ch_table));
-
-        it = pj_hash_next(srv->tables.alloc, it);
-        ++i;
+    for (j=0; j<srv->core.shard_cnt; ++j) {
+        pj_turn_srv_shard *shard = &srv->core.shard[j];
+
+        pj_lock_acquire(shard->lock);
+        it = pj_hash_first(shard->tables.alloc, &itbuf);
+        while (it) {
+            pj_turn_allocation *alloc = (pj_turn_allocation*) 
+                                        pj_hash_this(shard->tables.alloc, it);
+            printf("%-3d %-22s %-22s %-8.*s %-4d %-4ld %-4d %-4d\n",
+                   i,
+                   alloc->info,
+                   pj_sockaddr_print(&alloc->relay.hkey.addr, addr,
+                                     sizeof(addr), 3),
+                   (int)alloc->cred.data.static_cred.username.slen,
+                   alloc->cred.data.static_cred.username.ptr,
+                   alloc->relay.lifetime,
+                   alloc->relay.expiry.sec - now.sec,
+                   pj_hash_count(alloc->peer_table), 
+                   alloc->ch_cnt);
+
+            it = pj_hash_next(shard->tables.alloc, it);
+            ++i;
+        }
+        pj_lock_release(shard->lock);
     }
 }
 
@@ -121,12 +133,50 @@ static void console_main(pj_turn_srv *srv)
     }
 }
 
-int main()
+static void usage(void)
+{
+    puts("Usage: pjturn-srv [OPTIONS]");
+    puts("");
+    puts("where OPTIONS:");
+    printf(" --workers, -w N       Number of worker threads, normally the number\n"
+           "                       of CPU cores (default: %d)\n",
+           PJ_TURN_SRV_SHARD_CNT);
+    puts(" --help, -h");
+}
+
+int main(int argc, char *argv[])
 {
+    struct pj_getopt_option long_options[] = {
+        { "workers",    1, 0, 'w'},
+        { "help",       0, 0, 'h'},
+        { NULL,         0, 0, 0}
+    };
     pj_turn_srv *srv;
     pj_turn_listener *listener;
+    unsigned worker_cnt = PJ_TURN_SRV_SHARD_CNT;
+    pj_str_t str;
+    int c, opt_id;
     pj_status_t status;
 
+    while((c=pj_getopt_long(argc,argv, "w:h", long_options, &opt_id))!=-1) {
+        switch (c) {
+        case 'w':
+            worker_cnt = (unsigned) pj_strtoul(pj_cstr(&str, pj_optarg));
+            if (worker_cnt < 1) {
+                puts("Error: invalid number of worker threads");
+                return 1;
+            }
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            printf("Argument \"%s\" is not valid. Use -h to see help",
+                   argv[pj_optind]);
+            return 1;
+        }
+    }
+
     status = pj_init();
     if (status != PJ_SUCCESS)
         return err("pj_init() error", status);
@@ -138,7 +188,7 @@ int main()
 
     pj_turn_auth_init(REALM);
 
-    status = pj_turn_srv_create(&g_cp.factory, &srv);
+    status = pj_turn_srv_create2(&g_cp.factory, worker_cnt, &srv);
     if (status != PJ_SUCCESS)
         return err("Error creating server", status);
 
@@ -147,16 +197,20 @@ int main()
     if (status != PJ_SUCCESS)
         return err("Error creating UDP listener", status);
 
+    status = pj_turn_srv_add_listener(srv, listener);
+    if (status != PJ_SUCCESS)
+        return err("Error adding listener", status);
+
 #if PJ_HAS_TCP
     status = pj_turn_listener_create_tcp(srv, pj_AF_INET(), NULL, 
                                          TURN_PORT, 1, 0, &listener);
     if (status != PJ_SUCCESS)
         return err("Error creating listener", status);
-#endif
 
     status = pj_turn_srv_add_listener(srv, listener);
     if (status != PJ_SUCCESS)
         return err("Error adding listener", status);
+#endif
 
     puts("Server is running");
 
@@ -16,10 +16,19 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE      /* for sendmmsg() */
+#endif
 #include "turn.h"
 #include "auth.h"
 
-#define MAX_CLIENTS             32
+#if PJ_TURN_SRV_HAS_SENDMMSG
+#   include <sys/socket.h>
+#   include <errno.h>
+#endif
+
+#define MAX_CLIENTS             4096
+#define MIN_SHARD_CLIENTS       32
 #define MAX_PEERS_PER_CLIENT    8
 //#define MAX_HANDLES           (MAX_CLIENTS*MAX_PEERS_PER_CLIENT+MAX_LISTENERS)
 #define MAX_HANDLES             PJ_IOQUEUE_MAX_HANDLES
@@ -27,11 +36,14 @@
 #define MIN_PORT                49152
 #define MAX_PORT                65535
 #define MAX_LISTENERS           16
-#define MAX_THREADS             2
+#define MAX_SHARDS              64
 #define MAX_NET_EVENTS          1000
 
 /* Prototypes */
-static int server_thread_proc(void *arg);
+static int shard_thread_proc(void *arg);
+static void on_fwd_wakeup(pj_ioqueue_key_t *key,
+                          pj_ioqueue_op_key_t *op_key,
+                          pj_ssize_t bytes_read);
 static pj_status_t on_tx_stun_msg( pj_stun_session *sess,
                                    void *token,
                                    const void *pkt,
@@ -46,6 +58,59 @@ static pj_status_t on_rx_stun_request(pj_stun_session *sess,
                                       const pj_sockaddr_t *src_addr,
                                       unsigned src_addr_len);
 
+/* A queued datagram */
+struct tx_pkt
+{
+    pj_sock_t           sock;
+    pj_sockaddr         addr;
+    int                 addr_len;
+    pj_size_t           len;
+    char                data[PJ_TURN_MAX_PKT_LEN+4];
+};
+
+/* Queue of datagrams of a shard */
+struct pj_turn_tx_batch
+{
+    unsigned            cnt;
+    struct tx_pkt       pkt[PJ_TURN_SRV_TX_BATCH_SIZE];
+#if PJ_TURN_SRV_HAS_SENDMMSG
+    struct mmsghdr      msg[PJ_TURN_SRV_TX_BATCH_SIZE];
+    struct iovec        iov[PJ_TURN_SRV_TX_BATCH_SIZE];
+#endif
+};
+
+/* A client packet handed over to another shard */
+struct fwd_pkt
+{
+    pj_turn_transport      *transport;
+    pj_turn_allocation_key  src;
+    int                     src_addr_len;
+    pj_time_val             rx_time;
+    pj_size_t               len;
+    pj_uint8_t              data[PJ_TURN_MAX_PKT_LEN];
+};
+
+/* Queue of client packets to be processed by the shard owning their
+ * allocation.
+ */
+struct pj_turn_fwd_queue
+{
+    pj_lock_t          *lock;
+    unsigned            head;
+    unsigned            cnt;
+    struct fwd_pkt      pkt[PJ_TURN_SRV_FWD_QUEUE_SIZE];
+
+    /* Loopback socket to wake up the worker thread of the shard */
+    pj_sock_t           sock;
+    pj_sockaddr         addr;
+    pj_ioqueue_key_t   *key;
+    pj_ioqueue_op_key_t read_key;
+    char                read_buf[4];
+
+    /* Packet being processed by the shard's worker thread */
+    pj_turn_pkt         rx;
+};
+
 struct saved_cred
 {
     pj_str_t realm;
@@ -78,13 +143,152 @@ PJ_DEF(const char*) pj_turn_tp_type_name(int tp_type)
 PJ_DEF(pj_status_t) pj_turn_srv_create(pj_pool_factory *pf,
                                        pj_turn_srv **p_srv)
 {
-    pj_pool_t *pool;
+    return pj_turn_srv_create2(pf, PJ_TURN_SRV_SHARD_CNT, p_srv);
+}
+
+
+/*
+ * Create the socket which wakes up the worker thread of the shard when
+ * packets have been handed over to it.
+ */
+static pj_status_t init_fwd_wakeup(pj_turn_srv_shard *shard)
+{
+    pj_turn_fwd_queue *q = shard->fwd_queue;
+    pj_ioqueue_callback icb;
+    pj_str_t loopback = { "127.0.0.1", 9 };
+    int addr_len;
+    pj_status_t status;
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &q->sock);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_sockaddr_init(pj_AF_INET(), &q->addr, &loopback, 0);
+    status = pj_sock_bind(q->sock, &q->addr, pj_sockaddr_get_len(&q->addr));
+    if (status != PJ_SUCCESS)
+        return status;
+
+    addr_len = sizeof(q->addr);
+    status = pj_sock_getsockname(q->sock, &q->addr, &addr_len);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_bzero(&icb, sizeof(icb));
+    icb.on_read_complete = &on_fwd_wakeup;
+
+    status = pj_ioqueue_register_sock(shard->server->core.pool,
+                                      shard->ioqueue, q->sock, shard,
+                                      &icb, &q->key);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* Kick off pending read operation */
+    pj_ioqueue_op_key_init(&q->read_key, sizeof(q->read_key));
+    on_fwd_wakeup(q->key, &q->read_key, 0);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Init a shard: its ioqueue, timer heap, tables and STUN session.
+ */
+static pj_status_t shard_init(pj_turn_srv *srv, unsigned id)
+{
+    pj_turn_srv_shard *shard = &srv->core.shard[id];
+    pj_pool_t *pool = srv->core.pool;
     pj_stun_session_cb sess_cb;
+    unsigned table_size;
+    pj_status_t status;
+
+    shard->server = srv;
+    shard->id = id;
+    pj_ansi_snprintf(shard->obj_name, sizeof(shard->obj_name), "%s-%u",
+                     srv->obj_name, id);
+
+    /* Create ioqueue */
+    status = pj_ioqueue_create(pool, MAX_HANDLES, &shard->ioqueue);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* Shard mutex */
+    status = pj_lock_create_recursive_mutex(pool, shard->obj_name,
+                                            &shard->lock);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* Create timer heap */
+    status = pj_timer_heap_create(pool, MAX_TIMER, &shard->timer_heap);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    /* Configure lock for the timer heap */
+    pj_timer_heap_set_lock(shard->timer_heap, shard->lock, PJ_FALSE);
+
+    /* Create hash tables. The clients are spread among the shards. */
+    table_size = MAX_CLIENTS / srv->core.shard_cnt;
+    if (table_size < MIN_SHARD_CLIENTS)
+        table_size = MIN_SHARD_CLIENTS;
+    shard->tables.alloc = pj_hash_create(pool, table_size);
+    shard->tables.res = pj_hash_create(pool, table_size);
+
+    /* Init STUN config */
+    pj_stun_config_init(&shard->stun_cfg, srv->core.pf, 0, shard->ioqueue,
+                        shard->timer_heap);
+
+    /* Create STUN session to handle new allocation */
+    pj_bzero(&sess_cb, sizeof(sess_cb));
+    sess_cb.on_rx_request = &on_rx_stun_request;
+    sess_cb.on_send_msg = &on_tx_stun_msg;
+
+    status = pj_stun_session_create(&shard->stun_cfg, shard->obj_name,
+                                    &sess_cb, PJ_FALSE, NULL,
+                                    &shard->stun_sess);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_stun_session_set_user_data(shard->stun_sess, srv);
+    pj_stun_session_set_credential(shard->stun_sess, PJ_STUN_AUTH_LONG_TERM,
+                                   &srv->core.cred);
+
+    /* Transmit queue */
+    shard->tx_batch = PJ_POOL_ZALLOC_T(pool, pj_turn_tx_batch);
+
+    /* Queue of packets handed over by other shards */
+    shard->fwd_queue = PJ_POOL_ZALLOC_T(pool, pj_turn_fwd_queue);
+    shard->fwd_queue->sock = PJ_INVALID_SOCKET;
+    status = pj_lock_create_simple_mutex(pool, shard->obj_name,
+                                         &shard->fwd_queue->lock);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    shard->fwd_queue->rx.pool = pj_pool_create(srv->core.pf, "fwd%p",
+                                               1000, 1000, NULL);
+    if (!shard->fwd_queue->rx.pool)
+        return PJ_ENOMEM;
+
+    status = init_fwd_wakeup(shard);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Create server with the specified number of shards.
+ */
+PJ_DEF(pj_status_t) pj_turn_srv_create2(pj_pool_factory *pf,
+                                        unsigned shard_cnt,
+                                        pj_turn_srv **p_srv)
+{
+    pj_pool_t *pool;
     pj_turn_srv *srv;
     unsigned i;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(pf && p_srv, PJ_EINVAL);
+    PJ_ASSERT_RETURN(shard_cnt > 0 && shard_cnt <= MAX_SHARDS, PJ_EINVAL);
 
     /* Create server and init core settings */
     pool = pj_pool_create(pf, "srv%p", 1000, 1000, NULL);
@@ -94,11 +298,6 @@ PJ_DEF(pj_status_t) pj_turn_srv_create(pj_pool_factory *pf,
     srv->core.pool = pool;
     srv->core.tls_key = srv->core.tls_data = -1;
 
-    /* Create ioqueue */
-    status = pj_ioqueue_create(pool, MAX_HANDLES, &srv->core.ioqueue);
-    if (status != PJ_SUCCESS)
-        goto on_error;
-
     /* Server mutex */
     status = pj_lock_create_recursive_mutex(pool, srv->obj_name,
                                             &srv->core.lock);
@@ -114,33 +313,17 @@ PJ_DEF(pj_status_t) pj_turn_srv_create(pj_pool_factory *pf,
     if (status != PJ_SUCCESS)
         goto on_error;
 
-    /* Create timer heap */
-    status = pj_timer_heap_create(pool, MAX_TIMER, &srv->core.timer_heap);
-    if (status != PJ_SUCCESS)
-        goto on_error;
-
-    /* Configure lock for the timer heap */
-    pj_timer_heap_set_lock(srv->core.timer_heap, srv->core.lock, PJ_FALSE);
-
     /* Array of listeners */
     srv->core.listener = (pj_turn_listener**)
                          pj_pool_calloc(pool, MAX_LISTENERS,
                                         sizeof(srv->core.listener[0]));
 
-    /* Create hash tables */
-    srv->tables.alloc = pj_hash_create(pool, MAX_CLIENTS);
-    srv->tables.res = pj_hash_create(pool, MAX_CLIENTS);
-
     /* Init ports settings */
     srv->ports.min_udp = srv->ports.next_udp = MIN_PORT;
     srv->ports.max_udp = MAX_PORT;
     srv->ports.min_tcp = srv->ports.next_tcp = MIN_PORT;
     srv->ports.max_tcp = MAX_PORT;
 
-    /* Init STUN config */
-    pj_stun_config_init(&srv->core.stun_cfg, pf, 0, srv->core.ioqueue,
-                        srv->core.timer_heap);
-
     /* Init STUN credential */
     srv->core.cred.type = PJ_STUN_AUTH_CRED_DYNAMIC;
     srv->core.cred.data.dyn_cred.user_data = srv;
@@ -148,40 +331,31 @@ PJ_DEF(pj_status_t) pj_turn_srv_create(pj_pool_factory *pf,
     srv->core.cred.data.dyn_cred.get_password = &pj_turn_get_password;
     srv->core.cred.data.dyn_cred.verify_nonce = &pj_turn_verify_nonce;
 
-    /* Create STUN session to handle new allocation */
-    pj_bzero(&sess_cb, sizeof(sess_cb));
-    sess_cb.on_rx_request = &on_rx_stun_request;
-    sess_cb.on_send_msg = &on_tx_stun_msg;
+    /* Array of shards */
+    srv->core.shard_cnt = shard_cnt;
+    srv->core.shard = (pj_turn_srv_shard*)
+                      pj_pool_calloc(pool, shard_cnt,
+                                     sizeof(pj_turn_srv_shard));
 
-    status = pj_stun_session_create(&srv->core.stun_cfg, srv->obj_name,
-                                    &sess_cb, PJ_FALSE, NULL,
-                                    &srv->core.stun_sess);
-    if (status != PJ_SUCCESS) {
-        goto on_error;
+    for (i=0; i<shard_cnt; ++i) {
+        status = shard_init(srv, i);
+        if (status != PJ_SUCCESS)
+            goto on_error;
     }
 
-    pj_stun_session_set_user_data(srv->core.stun_sess, srv);
-    pj_stun_session_set_credential(srv->core.stun_sess, PJ_STUN_AUTH_LONG_TERM,
-                                   &srv->core.cred);
+    /* Start the worker threads, one for each shard */
+    for (i=0; i<shard_cnt; ++i) {
+        pj_turn_srv_shard *shard = &srv->core.shard[i];
 
-
-    /* Array of worker threads */
-    srv->core.thread_cnt = MAX_THREADS;
-    srv->core.thread = (pj_thread_t**)
-                       pj_pool_calloc(pool, srv->core.thread_cnt,
-                                      sizeof(pj_thread_t*));
-
-    /* Start the worker threads */
-    for (i=0; i<srv->core.thread_cnt; ++i) {
-        status = pj_thread_create(pool, srv->obj_name, &server_thread_proc,
-                                  srv, 0, 0, &srv->core.thread[i]);
+        status = pj_thread_create(pool, shard->obj_name, &shard_thread_proc,
+                                  shard, 0, 0, &shard->thread);
         if (status != PJ_SUCCESS)
             goto on_error;
     }
 
     /* We're done. Application should add listeners now */
-    PJ_LOG(4,(srv->obj_name, "TURN server v%s is running",
-              pj_get_version()));
+    PJ_LOG(4,(srv->obj_name, "TURN server v%s is running with %d shard(s)",
+              pj_get_version(), shard_cnt));
 
     *p_srv = srv;
     return PJ_SUCCESS;
@@ -192,21 +366,164 @@ on_error:
 }
 
 
+/*
+ * Get the shard whose allocation table holds the allocation of the client.
+ * The table is keyed by the client address alone, so that the allocation
+ * can be found with one lookup whichever shard has received the packet.
+ */
+static pj_turn_srv_shard *get_dir_shard(pj_turn_srv *srv,
+                                        const pj_turn_allocation_key *key)
+{
+    pj_uint32_t hval;
+
+    hval = pj_hash_calc(0, key, sizeof(*key));
+    return &srv->core.shard[hval % srv->core.shard_cnt];
+}
+
+
+/*
+ * Hand over a client packet to the shard owning its allocation. The packet
+ * is dropped if the queue of the shard is full.
+ */
+static void forward_pkt(pj_turn_srv_shard *shard, const pj_turn_pkt *pkt)
+{
+    pj_turn_fwd_queue *q = shard->fwd_queue;
+    struct fwd_pkt *fp;
+    pj_bool_t wakeup;
+
+    pj_lock_acquire(q->lock);
+
+    if (q->cnt == PJ_ARRAY_SIZE(q->pkt)) {
+        pj_lock_release(q->lock);
+        PJ_LOG(5,(shard->obj_name, "Forward queue full, packet dropped"));
+        return;
+    }
+
+    fp = &q->pkt[(q->head + q->cnt) % PJ_ARRAY_SIZE(q->pkt)];
+    fp->transport = pkt->transport;
+    pj_memcpy(&fp->src, &pkt->src, sizeof(pkt->src));
+    fp->src_addr_len = pkt->src_addr_len;
+    fp->rx_time = pkt->rx_time;
+    fp->len = pkt->len;
+    pj_memcpy(fp->data, pkt->pkt, pkt->len);
+    wakeup = (q->cnt++ == 0);
+
+    pj_lock_release(q->lock);
+
+    /* Wake up the owner if it may be waiting for network events. Should
+     * the datagram be lost, the queue is still processed on the next
+     * poll timeout.
+     */
+    if (wakeup) {
+        pj_ssize_t len = 1;
+        pj_sock_sendto(q->sock, "w", &len, 0, &q->addr,
+                       pj_sockaddr_get_len(&q->addr));
+    }
+}
+
+
+/*
+ * Process the packets handed over by other shards. Only called by the
+ * shard's worker thread.
+ */
+static void shard_process_fwd(pj_turn_srv_shard *shard)
+{
+    pj_turn_fwd_queue *q = shard->fwd_queue;
+    pj_turn_pkt *pkt = &q->rx;
+
+    for (;;) {
+        pj_turn_srv_shard *dir;
+        pj_turn_allocation *alloc;
+        struct fwd_pkt *fp;
+        pj_pool_t *pool;
+
+        pj_lock_acquire(q->lock);
+        if (q->cnt == 0) {
+            pj_lock_release(q->lock);
+            break;
+        }
+
+        fp = &q->pkt[q->head];
+        pkt->transport = fp->transport;
+        pj_memcpy(&pkt->src, &fp->src, sizeof(fp->src));
+        pkt->src_addr_len = fp->src_addr_len;
+        pkt->rx_time = fp->rx_time;
+        pkt->len = fp->len;
+        pj_memcpy(pkt->pkt, fp->data, fp->len);
+
+        q->head = (q->head + 1) % PJ_ARRAY_SIZE(q->pkt);
+        --q->cnt;
+        pj_lock_release(q->lock);
+
+        /* The allocation may have gone since the packet was queued */
+        dir = get_dir_shard(shard->server, &pkt->src);
+        pj_lock_acquire(dir->lock);
+        alloc = (pj_turn_allocation*)
+                pj_hash_get(dir->tables.alloc, &pkt->src, sizeof(pkt->src),
+                            NULL);
+        pj_lock_release(dir->lock);
+
+        if (alloc && alloc->shard == shard)
+            pj_turn_allocation_on_rx_client_pkt(alloc, pkt);
+
+        pool = pkt->pool;
+        pj_pool_reset(pool);
+        pkt->pool = pool;
+    }
+
+    pj_turn_srv_shard_flush(shard);
+}
+
+
+/*
+ * Callback when the worker thread of the shard is woken up to process
+ * the packets handed over to it.
+ */
+static void on_fwd_wakeup(pj_ioqueue_key_t *key,
+                          pj_ioqueue_op_key_t *op_key,
+                          pj_ssize_t bytes_read)
+{
+    pj_turn_srv_shard *shard;
+    pj_turn_fwd_queue *q;
+    pj_status_t status;
+
+    shard = (pj_turn_srv_shard*) pj_ioqueue_get_user_data(key);
+    q = shard->fwd_queue;
+
+    do {
+        if (bytes_read > 0)
+            shard_process_fwd(shard);
+
+        /* Read next wake up datagram */
+        bytes_read = sizeof(q->read_buf);
+        status = pj_ioqueue_recv(key, op_key, q->read_buf, &bytes_read, 0);
+        if (status != PJ_EPENDING && status != PJ_SUCCESS)
+            bytes_read = -status;
+
+    } while (status != PJ_EPENDING && status != PJ_ECANCELLED &&
+             status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL));
+}
+
+
 /*
  * Handle timer and network events
  */
-static void srv_handle_events(pj_turn_srv *srv, const pj_time_val *max_timeout)
+static void shard_handle_events(pj_turn_srv_shard *shard,
+                                const pj_time_val *max_timeout)
 {
     /* timeout is 'out' var. This just to make compiler happy. */
     pj_time_val timeout = { 0, 0};
     unsigned net_event_count = 0;
     int c;
 
+    /* Process the packets handed over by other shards */
+    shard_process_fwd(shard);
+
     /* Poll the timer. The timer heap has its own mutex for better
      * granularity, so we don't need to lock the server.
      */
     timeout.sec = timeout.msec = 0;
-    c = pj_timer_heap_poll( srv->core.timer_heap, &timeout );
+    c = pj_timer_heap_poll( shard->timer_heap, &timeout );
 
     /* timer_heap_poll should never ever returns negative value, or otherwise
      * ioqueue_poll() will block forever!
@@ -233,7 +550,7 @@ static void srv_handle_events(pj_turn_srv *srv, const pj_time_val *max_timeout)
      *   reported in timely manner.
      */
     do {
-        c = pj_ioqueue_poll( srv->core.ioqueue, &timeout);
+        c = pj_ioqueue_poll( shard->ioqueue, &timeout);
         if (c < 0) {
             pj_thread_sleep(PJ_TIME_VAL_MSEC(timeout));
             return;
@@ -242,26 +559,141 @@ static void srv_handle_events(pj_turn_srv *srv, const pj_time_val *max_timeout)
         } else {
             net_event_count += c;
             timeout.sec = timeout.msec = 0;
+
+            /* Send the datagrams queued while processing the events */
+            pj_turn_srv_shard_flush(shard);
         }
     } while (c > 0 && net_event_count < MAX_NET_EVENTS);
 
 }
 
 /*
- * Server worker thread proc.
+ * Shard worker thread proc.
  */
-static int server_thread_proc(void *arg)
+static int shard_thread_proc(void *arg)
 {
-    pj_turn_srv *srv = (pj_turn_srv*)arg;
+    pj_turn_srv_shard *shard = (pj_turn_srv_shard*)arg;
 
-    while (!srv->core.quit) {
+    while (!shard->server->core.quit) {
         pj_time_val timeout_max = {0, 100};
-        srv_handle_events(srv, &timeout_max);
+        shard_handle_events(shard, &timeout_max);
     }
 
     return 0;
 }
 
+/*
+ * Check whether the calling thread is the worker thread of the shard.
+ */
+PJ_DEF(pj_bool_t) pj_turn_srv_shard_is_current(const pj_turn_srv_shard *shard)
+{
+    return shard->thread && shard->thread == pj_thread_this();
+}
+
+/*
+ * Queue a datagram.
+ */
+PJ_DEF(pj_status_t) pj_turn_srv_shard_sendto(pj_turn_srv_shard *shard,
+                                             pj_sock_t sock,
+                                             const void *hdr,
+                                             unsigned hdr_len,
+                                             const void *data,
+                                             pj_size_t len,
+                                             const pj_sockaddr_t *addr,
+                                             int addr_len)
+{
+    pj_turn_tx_batch *batch = shard->tx_batch;
+    struct tx_pkt *pkt;
+
+    PJ_ASSERT_RETURN(hdr_len + len <= sizeof(pkt->data), PJ_ETOOBIG);
+    PJ_ASSERT_RETURN(addr_len <= (int)sizeof(pj_sockaddr), PJ_EINVAL);
+
+    if (!batch || !pj_turn_srv_shard_is_current(shard))
+        return PJ_EINVALIDOP;
+
+    if (batch->cnt == PJ_ARRAY_SIZE(batch->pkt))
+        pj_turn_srv_shard_flush(shard);
+
+    pkt = &batch->pkt[batch->cnt++];
+    pkt->sock = sock;
+    pj_memcpy(&pkt->addr, addr, addr_len);
+    pkt->addr_len = addr_len;
+    if (hdr_len)
+        pj_memcpy(pkt->data, hdr, hdr_len);
+    pj_memcpy(pkt->data + hdr_len, data, len);
+    pkt->len = hdr_len + len;
+
+    return PJ_SUCCESS;
+}
+
+#if PJ_TURN_SRV_HAS_SENDMMSG
+/* Send the queued datagrams [start, end) which share the same socket. */
+static void send_batch(pj_turn_tx_batch *batch, unsigned start, unsigned end)
+{
+    pj_sock_t sock = batch->pkt[start].sock;
+    unsigned i;
+
+    for (i=start; i<end; ++i) {
+        struct tx_pkt *pkt = &batch->pkt[i];
+
+        batch->iov[i].iov_base = pkt->data;
+        batch->iov[i].iov_len = pkt->len;
+        pj_bzero(&batch->msg[i], sizeof(batch->msg[i]));
+        batch->msg[i].msg_hdr.msg_name = &pkt->addr;
+        batch->msg[i].msg_hdr.msg_namelen = pkt->addr_len;
+        batch->msg[i].msg_hdr.msg_iov = &batch->iov[i];
+        batch->msg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (start < end) {
+        int rc = sendmmsg(sock, &batch->msg[start], end - start, 0);
+        if (rc > 0) {
+            start += rc;
+        } else if (rc < 0 && errno == EINTR) {
+            continue;
+        } else {
+            /* Drop the datagram which can't be sent, like sendto() would */
+            ++start;
+        }
+    }
+}
+#endif
+
+/*
+ * Send the queued datagrams.
+ */
+PJ_DEF(void) pj_turn_srv_shard_flush(pj_turn_srv_shard *shard)
+{
+    pj_turn_tx_batch *batch = shard->tx_batch;
+    unsigned i;
+
+    if (!batch || batch->cnt == 0 || !pj_turn_srv_shard_is_current(shard))
+        return;
+
+#if PJ_TURN_SRV_HAS_SENDMMSG
+    /* One system call for each run of datagrams sharing the same socket */
+    for (i=0; i<batch->cnt; ) {
+        unsigned end = i+1;
+
+        while (end < batch->cnt && batch->pkt[end].sock == batch->pkt[i].sock)
+            ++end;
+
+        send_batch(batch, i, end);
+        i = end;
+    }
+#else
+    for (i=0; i<batch->cnt; ++i) {
+        struct tx_pkt *pkt = &batch->pkt[i];
+        pj_ssize_t len = pkt->len;
+
+        pj_sock_sendto(pkt->sock, pkt->data, &len, 0, &pkt->addr,
+                       pkt->addr_len);
+    }
+#endif
+
+    batch->cnt = 0;
+}
+
 /*
  * Destroy the server.
  */
@@ -272,56 +704,86 @@ PJ_DEF(pj_status_t) pj_turn_srv_destroy(pj_turn_srv *srv)
 
     /* Stop all worker threads */
     srv->core.quit = PJ_TRUE;
-    for (i=0; i<srv->core.thread_cnt; ++i) {
-        if (srv->core.thread[i]) {
-            pj_thread_join(srv->core.thread[i]);
-            pj_thread_destroy(srv->core.thread[i]);
-            srv->core.thread[i] = NULL;
+    for (i=0; i<srv->core.shard_cnt; ++i) {
+        pj_turn_srv_shard *shard = &srv->core.shard[i];
+
+        if (shard->thread) {
+            pj_thread_join(shard->thread);
+            pj_thread_destroy(shard->thread);
+            shard->thread = NULL;
         }
     }
 
     /* Destroy all allocations FIRST */
-    if (srv->tables.alloc) {
-        it = pj_hash_first(srv->tables.alloc, &itbuf);
+    for (i=0; i<srv->core.shard_cnt; ++i) {
+        pj_turn_srv_shard *shard = &srv->core.shard[i];
+
+        if (!shard->tables.alloc)
+            continue;
+
+        it = pj_hash_first(shard->tables.alloc, &itbuf);
         while (it != NULL) {
             pj_turn_allocation *alloc = (pj_turn_allocation*)
-                                        pj_hash_this(srv->tables.alloc, it);
-            pj_hash_iterator_t *next = pj_hash_next(srv->tables.alloc, it);
+                                        pj_hash_this(shard->tables.alloc, it);
+            pj_hash_iterator_t *next = pj_hash_next(shard->tables.alloc, it);
             pj_turn_allocation_destroy(alloc);
             it = next;
         }
     }
 
-    /* Destroy all listeners. */
-    for (i=0; i<srv->core.lis_cnt; ++i) {
+    /* Destroy all listeners. Note that pj_turn_listener_destroy() will
+     * decrement the listener count.
+     */
+    for (i=0; srv->core.listener && i<MAX_LISTENERS; ++i) {
         if (srv->core.listener[i]) {
             pj_turn_listener_destroy(srv->core.listener[i]);
             srv->core.listener[i] = NULL;
         }
     }
 
-    /* Destroy STUN session */
-    if (srv->core.stun_sess) {
-        pj_stun_session_destroy(srv->core.stun_sess);
-        srv->core.stun_sess = NULL;
-    }
+    for (i=0; i<srv->core.shard_cnt; ++i) {
+        pj_turn_srv_shard *shard = &srv->core.shard[i];
 
-    /* Destroy hash tables (well, sort of) */
-    if (srv->tables.alloc) {
-        srv->tables.alloc = NULL;
-        srv->tables.res = NULL;
-    }
+        /* Destroy STUN session */
+        if (shard->stun_sess) {
+            pj_stun_session_destroy(shard->stun_sess);
+            shard->stun_sess = NULL;
+        }
 
-    /* Destroy timer heap */
-    if (srv->core.timer_heap) {
-        pj_timer_heap_destroy(srv->core.timer_heap);
-        srv->core.timer_heap = NULL;
-    }
+        /* Destroy hash tables (well, sort of) */
+        shard->tables.alloc = NULL;
+        shard->tables.res = NULL;
+
+        /* Destroy timer heap */
+        if (shard->timer_heap) {
+            pj_timer_heap_destroy(shard->timer_heap);
+            shard->timer_heap = NULL;
+        }
+
+        /* Destroy forward queue */
+        if (shard->fwd_queue) {
+            if (shard->fwd_queue->key)
+                pj_ioqueue_unregister(shard->fwd_queue->key);
+            else if (shard->fwd_queue->sock != PJ_INVALID_SOCKET)
+                pj_sock_close(shard->fwd_queue->sock);
+            if (shard->fwd_queue->rx.pool)
+                pj_pool_release(shard->fwd_queue->rx.pool);
+            if (shard->fwd_queue->lock)
+                pj_lock_destroy(shard->fwd_queue->lock);
+            shard->fwd_queue = NULL;
+        }
 
-    /* Destroy ioqueue */
-    if (srv->core.ioqueue) {
-        pj_ioqueue_destroy(srv->core.ioqueue);
-        srv->core.ioqueue = NULL;
+        /* Destroy ioqueue */
+        if (shard->ioqueue) {
+            pj_ioqueue_destroy(shard->ioqueue);
+            shard->ioqueue = NULL;
+        }
+
+        /* Destroy shard lock */
+        if (shard->lock) {
+            pj_lock_destroy(shard->lock);
+            shard->lock = NULL;
+        }
     }
 
     /* Destroy thread local IDs */
@@ -428,14 +890,32 @@ PJ_DEF(void) pj_turn_transport_dec_ref( pj_turn_transport *transport,
 PJ_DEF(pj_status_t) pj_turn_srv_register_allocation(pj_turn_srv *srv,
                                                     pj_turn_allocation *alloc)
 {
-    /* Add to hash tables */
-    pj_lock_acquire(srv->core.lock);
-    pj_hash_set(alloc->pool, srv->tables.alloc,
+    pj_turn_srv_shard *shard = alloc->shard;
+    pj_turn_srv_shard *dir;
+
+    PJ_ASSERT_RETURN(shard && shard->server == srv, PJ_EINVAL);
+
+    /* Add to the allocation table of the client. Another shard may have
+     * just created an allocation for the same client.
+     */
+    dir = get_dir_shard(srv, &alloc->hkey);
+    pj_lock_acquire(dir->lock);
+    if (pj_hash_get(dir->tables.alloc, &alloc->hkey, sizeof(alloc->hkey),
+                    NULL))
+    {
+        pj_lock_release(dir->lock);
+        return PJ_EEXISTS;
+    }
+    pj_hash_set(alloc->pool, dir->tables.alloc,
                 &alloc->hkey, sizeof(alloc->hkey), 0, alloc);
-    pj_hash_set(alloc->pool, srv->tables.res,
+    pj_lock_release(dir->lock);
+
+    /* Add to the relay table of the owning shard */
+    pj_lock_acquire(shard->lock);
+    pj_hash_set(alloc->pool, shard->tables.res,
                 &alloc->relay.hkey, sizeof(alloc->relay.hkey), 0,
                 &alloc->relay);
-    pj_lock_release(srv->core.lock);
+    pj_lock_release(shard->lock);
 
     return PJ_SUCCESS;
 }
@@ -447,13 +927,32 @@ PJ_DEF(pj_status_t) pj_turn_srv_register_allocation(pj_turn_srv *srv,
 PJ_DEF(pj_status_t) pj_turn_srv_unregister_allocation(pj_turn_srv *srv,
                                                      pj_turn_allocation *alloc)
 {
-    /* Unregister from hash tables */
-    pj_lock_acquire(srv->core.lock);
-    pj_hash_set(alloc->pool, srv->tables.alloc,
-                &alloc->hkey, sizeof(alloc->hkey), 0, NULL);
-    pj_hash_set(alloc->pool, srv->tables.res,
-                &alloc->relay.hkey, sizeof(alloc->relay.hkey), 0, NULL);
-    pj_lock_release(srv->core.lock);
+    pj_turn_srv_shard *shard = alloc->shard;
+    pj_turn_srv_shard *dir;
+
+    PJ_ASSERT_RETURN(shard && shard->server == srv, PJ_EINVAL);
+
+    /* Remove from the allocation table, unless the entry belongs to
+     * another allocation (i.e. this one has failed to register).
+     */
+    dir = get_dir_shard(srv, &alloc->hkey);
+    pj_lock_acquire(dir->lock);
+    if (pj_hash_get(dir->tables.alloc, &alloc->hkey, sizeof(alloc->hkey),
+                    NULL) == alloc)
+    {
+        pj_hash_set(alloc->pool, dir->tables.alloc,
+                    &alloc->hkey, sizeof(alloc->hkey), 0, NULL);
+    }
+    pj_lock_release(dir->lock);
+
+    pj_lock_acquire(shard->lock);
+    if (pj_hash_get(shard->tables.res, &alloc->relay.hkey,
+                    sizeof(alloc->relay.hkey), NULL) == &alloc->relay)
+    {
+        pj_hash_set(alloc->pool, shard->tables.res,
+                    &alloc->relay.hkey, sizeof(alloc->relay.hkey), 0, NULL);
+    }
+    pj_lock_release(shard->lock);
 
     return PJ_SUCCESS;
 }
@@ -598,13 +1097,33 @@ static void handle_binding_request(pj_turn_pkt *pkt,
 PJ_DEF(void) pj_turn_srv_on_rx_pkt(pj_turn_srv *srv,
                                    pj_turn_pkt *pkt)
 {
+    pj_turn_srv_shard *shard = pkt->transport->shard;
+    pj_turn_srv_shard *dir, *owner = NULL;
     pj_turn_allocation *alloc;
 
     /* Get TURN allocation from the source address */
-    pj_lock_acquire(srv->core.lock);
+    dir = get_dir_shard(srv, &pkt->src);
+    pj_lock_acquire(dir->lock);
     alloc = (pj_turn_allocation*)
-            pj_hash_get(srv->tables.alloc, &pkt->src, sizeof(pkt->src), NULL);
-    pj_lock_release(srv->core.lock);
+            pj_hash_get(dir->tables.alloc, &pkt->src, sizeof(pkt->src),
+                        NULL);
+    if (alloc)
+        owner = alloc->shard;
+    pj_lock_release(dir->lock);
+
+    /* Normally the kernel keeps delivering packets from a client to the
+     * same socket, hence the shard owning its allocation. If the socket
+     * group has changed (e.g. a listener socket was closed), hand over the
+     * packet to the owner, since an allocation may only be accessed by the
+     * worker thread of its shard. Stream transports are always served by
+     * the owner.
+     */
+    if (alloc && owner != shard) {
+        if (pkt->transport->listener->tp_type == PJ_TURN_TP_UDP)
+            forward_pkt(owner, pkt);
+        pkt->len = 0;
+        return;
+    }
 
     /* If allocation is found, just hand over the packet to the
      * allocation.
@@ -665,7 +1184,7 @@ PJ_DEF(void) pj_turn_srv_on_rx_pkt(pj_turn_srv *srv,
          */
         options &= ~PJ_STUN_CHECK_PACKET;
         parsed_len = 0;
-        status = pj_stun_session_on_rx_pkt(srv->core.stun_sess, pkt->pkt,
+        status = pj_stun_session_on_rx_pkt(shard->stun_sess, pkt->pkt,
                                            pkt->len, options, pkt->transport,
                                            &parsed_len, &pkt->src.clt_addr,
                                            pkt->src_addr_len);
@@ -0,0 +1,782 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Test the server shards. The packets from clients are injected to the
+ * server in the worker thread of a chosen shard, as if they were received
+ * by a listener socket of that shard, and the packets to the clients are
+ * captured by the fake transports.
+ */
+#include "turn.h"
+#include "auth.h"
+#include <pjlib-util.h>
+
+#define THIS_FILE       "srv_test.c"
+#define REALM           "pjsip.org"
+#define USERNAME        "100"
+#define PASSWORD        "100"
+#define NONCE           "pjnath"
+#define SHARD_CNT       2
+#define CH_NUM          0x4000
+#define WAIT_MSEC       2000
+#define CLIENT_CNT      4
+#define ROUND_CNT       50
+#define ROUND_MSEC      5
+
+/* Fake transport of a shard */
+struct test_tp
+{
+    pj_turn_transport       base;
+    struct test_ctx        *ctx;
+};
+
+/* Packet injected in the worker thread of a shard */
+struct inject_op
+{
+    pj_timer_entry          timer;
+    pj_turn_srv            *srv;
+    pj_turn_pkt             pkt;
+    volatile pj_bool_t      done;
+};
+
+/* ChannelData sent by all clients in rounds, received by one shard */
+struct burst_op
+{
+    pj_timer_entry          timer;
+    struct test_ctx        *ctx;
+    unsigned                shard_idx;
+    unsigned                round;
+    unsigned                round_cnt;
+    pj_turn_pkt             pkt;
+    volatile pj_bool_t      done;
+};
+
+struct test_ctx
+{
+    pj_pool_t              *pool;
+    pj_turn_srv            *srv;
+    pj_turn_listener        lis;
+    struct test_tp          tp[SHARD_CNT];
+    struct inject_op       *op;
+    pj_str_t                key;
+    pj_sockaddr             clt_addr[CLIENT_CNT];
+
+    /* Packets sent to the clients */
+    pj_lock_t              *lock;
+    unsigned                stun_cnt;
+    pj_uint8_t              stun_pkt[PJ_TURN_MAX_PKT_LEN];
+    pj_size_t               stun_len;
+    unsigned                cd_cnt;
+};
+
+static pj_caching_pool g_cp;
+
+
+static pj_status_t tp_sendto(pj_turn_transport *tp,
+                             const void *packet,
+                             pj_size_t size,
+                             unsigned flag,
+                             const pj_sockaddr_t *addr,
+                             int addr_len)
+{
+    struct test_ctx *ctx = ((struct test_tp*)tp)->ctx;
+
+    PJ_UNUSED_ARG(flag);
+    PJ_UNUSED_ARG(addr);
+    PJ_UNUSED_ARG(addr_len);
+
+    pj_lock_acquire(ctx->lock);
+    if ((*(const pj_uint8_t*)packet & 0xC0) == 0x40) {
+        ++ctx->cd_cnt;
+    } else if (size <= sizeof(ctx->stun_pkt)) {
+        pj_memcpy(ctx->stun_pkt, packet, size);
+        ctx->stun_len = size;
+        ++ctx->stun_cnt;
+    }
+    pj_lock_release(ctx->lock);
+
+    return PJ_SUCCESS;
+}
+
+static void tp_add_ref(pj_turn_transport *tp, pj_turn_allocation *alloc)
+{
+    PJ_UNUSED_ARG(tp);
+    PJ_UNUSED_ARG(alloc);
+}
+
+static void tp_dec_ref(pj_turn_transport *tp, pj_turn_allocation *alloc)
+{
+    PJ_UNUSED_ARG(tp);
+    PJ_UNUSED_ARG(alloc);
+}
+
+static void inject_cb(pj_timer_heap_t *th, pj_timer_entry *e)
+{
+    struct inject_op *op = (struct inject_op*)e->user_data;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_turn_srv_on_rx_pkt(op->srv, &op->pkt);
+    pj_turn_srv_shard_flush(op->pkt.transport->shard);
+    op->done = PJ_TRUE;
+}
+
+/* Inject a packet from the client, as received by the specified shard */
+static int inject(struct test_ctx *ctx, unsigned shard_idx,
+                  const pj_sockaddr *src, const void *data, pj_size_t len)
+{
+    struct inject_op *op = ctx->op;
+    pj_turn_srv_shard *shard = &ctx->srv->core.shard[shard_idx];
+    pj_time_val delay = { 0, 0 };
+    unsigned msec;
+
+    op->srv = ctx->srv;
+    op->pkt.transport = &ctx->tp[shard_idx].base;
+    pj_bzero(&op->pkt.src, sizeof(op->pkt.src));
+    op->pkt.src.tp_type = PJ_TURN_TP_UDP;
+    pj_sockaddr_cp(&op->pkt.src.clt_addr, src);
+    op->pkt.src_addr_len = pj_sockaddr_get_len(src);
+    pj_gettimeofday(&op->pkt.rx_time);
+    pj_memcpy(op->pkt.pkt, data, len);
+    op->pkt.len = len;
+    op->done = PJ_FALSE;
+
+    pj_timer_entry_init(&op->timer, 0, op, &inject_cb);
+    if (pj_timer_heap_schedule(shard->timer_heap, &op->timer, &delay))
+        return -10;
+
+    for (msec = 0; !op->done && msec < WAIT_MSEC; msec += 10)
+        pj_thread_sleep(10);
+
+    return op->done ? 0 : -20;
+}
+
+/* Send request and wait for the response */
+static int send_request(struct test_ctx *ctx, unsigned shard_idx,
+                        const pj_sockaddr *src, pj_stun_msg *req,
+                        pj_bool_t auth, pj_stun_msg **p_res)
+{
+    pj_uint8_t buf[512];
+    pj_size_t len;
+    unsigned cnt, msec;
+    pj_status_t status;
+
+    if (auth) {
+        pj_str_t s;
+
+        pj_stun_msg_add_string_attr(ctx->pool, req, PJ_STUN_ATTR_USERNAME,
+                                    pj_cstr(&s, USERNAME));
+        pj_stun_msg_add_string_attr(ctx->pool, req, PJ_STUN_ATTR_REALM,
+                                    pj_cstr(&s, REALM));
+        pj_stun_msg_add_string_attr(ctx->pool, req, PJ_STUN_ATTR_NONCE,
+                                    pj_cstr(&s, NONCE));
+        pj_stun_msg_add_msgint_attr(ctx->pool, req);
+    }
+
+    status = pj_stun_msg_encode(req, buf, sizeof(buf), 0,
+                                auth ? &ctx->key : NULL, &len);
+    if (status != PJ_SUCCESS)
+        return -100;
+
+    pj_lock_acquire(ctx->lock);
+    cnt = ctx->stun_cnt;
+    pj_lock_release(ctx->lock);
+
+    if (inject(ctx, shard_idx, src, buf, len))
+        return -110;
+
+    for (msec = 0; msec < WAIT_MSEC; msec += 10) {
+        pj_bool_t got;
+
+        pj_lock_acquire(ctx->lock);
+        got = (ctx->stun_cnt != cnt);
+        if (got) {
+            status = pj_stun_msg_decode(ctx->pool, ctx->stun_pkt,
+                                        ctx->stun_len, PJ_STUN_IS_DATAGRAM,
+                                        p_res, NULL, NULL);
+        }
+        pj_lock_release(ctx->lock);
+
+        if (got) {
+            if (status != PJ_SUCCESS)
+                return -120;
+            if (pj_memcmp((*p_res)->hdr.tsx_id, req->hdr.tsx_id,
+                          sizeof(req->hdr.tsx_id)))
+            {
+                return -130;
+            }
+            return 0;
+        }
+        pj_thread_sleep(10);
+    }
+
+    return -140;
+}
+
+/* Create an allocation for the client, in the specified shard */
+static int allocate(struct test_ctx *ctx, unsigned shard_idx,
+                    const pj_sockaddr *src, pj_sockaddr *relay_addr)
+{
+    pj_stun_msg *req, *res;
+    pj_stun_sockaddr_attr *sa;
+    int rc;
+
+    if (pj_stun_msg_create(ctx->pool, PJ_STUN_ALLOCATE_REQUEST,
+                           PJ_STUN_MAGIC, NULL, &req))
+    {
+        return -200;
+    }
+    pj_stun_msg_add_uint_attr(ctx->pool, req,
+                              PJ_STUN_ATTR_REQ_TRANSPORT,
+                              PJ_STUN_SET_RT_PROTO(PJ_TURN_TP_UDP));
+
+    rc = send_request(ctx, shard_idx, src, req, PJ_TRUE, &res);
+    if (rc)
+        return rc;
+
+    if (res->hdr.type != PJ_STUN_ALLOCATE_RESPONSE)
+        return -210;
+
+    sa = (pj_stun_sockaddr_attr*)
+         pj_stun_msg_find_attr(res, PJ_STUN_ATTR_XOR_RELAYED_ADDR, 0);
+    if (!sa)
+        return -220;
+
+    pj_sockaddr_cp(relay_addr, &sa->sockaddr);
+    return 0;
+}
+
+/* Bind channel to the peer */
+static int channel_bind(struct test_ctx *ctx, unsigned shard_idx,
+                        const pj_sockaddr *src, unsigned ch_num,
+                        const pj_sockaddr *peer_addr)
+{
+    pj_stun_msg *req, *res;
+    int rc;
+
+    if (pj_stun_msg_create(ctx->pool, PJ_STUN_CHANNEL_BIND_REQUEST,
+                           PJ_STUN_MAGIC, NULL, &req))
+    {
+        return -300;
+    }
+    pj_stun_msg_add_uint_attr(ctx->pool, req, PJ_STUN_ATTR_CHANNEL_NUMBER,
+                              PJ_STUN_SET_CH_NB(ch_num));
+    pj_stun_msg_add_sockaddr_attr(ctx->pool, req, PJ_STUN_ATTR_XOR_PEER_ADDR,
+                                  PJ_TRUE, peer_addr,
+                                  pj_sockaddr_get_len(peer_addr));
+
+    rc = send_request(ctx, shard_idx, src, req, PJ_TRUE, &res);
+    if (rc)
+        return rc;
+
+    if (res->hdr.type != PJ_STUN_CHANNEL_BIND_RESPONSE)
+        return -310;
+
+    return 0;
+}
+
+/* Send ChannelData from the client */
+static int send_channel_data(struct test_ctx *ctx, unsigned shard_idx,
+                             const pj_sockaddr *src, unsigned ch_num,
+                             const char *data)
+{
+    pj_uint8_t buf[128];
+    pj_turn_channel_data *cd = (pj_turn_channel_data*)buf;
+    pj_size_t len = pj_ansi_strlen(data);
+
+    cd->ch_number = pj_htons((pj_uint16_t)ch_num);
+    cd->length = pj_htons((pj_uint16_t)len);
+    pj_memcpy(cd+1, data, len);
+
+    return inject(ctx, shard_idx, src, buf, sizeof(*cd) + len);
+}
+
+/* Create the peer socket */
+static int create_peer(pj_sock_t *sock, pj_sockaddr *addr)
+{
+    pj_str_t s;
+    int addr_len;
+
+    pj_sockaddr_init(pj_AF_INET(), addr, pj_cstr(&s, "127.0.0.1"), 0);
+    if (pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, sock))
+        return -1;
+    if (pj_sock_bind(*sock, addr, pj_sockaddr_get_len(addr)))
+        return -2;
+
+    addr_len = sizeof(*addr);
+    if (pj_sock_getsockname(*sock, addr, &addr_len))
+        return -3;
+
+    return 0;
+}
+
+/* Receive data on the peer socket */
+static pj_ssize_t peer_recv(pj_sock_t sock, char *buf, pj_size_t size,
+                            unsigned msec)
+{
+    pj_fd_set_t rset;
+    pj_time_val timeout;
+    pj_ssize_t len;
+
+    timeout.sec = 0;
+    timeout.msec = msec;
+    pj_time_val_normalize(&timeout);
+    PJ_FD_ZERO(&rset);
+    PJ_FD_SET(sock, &rset);
+    if (pj_sock_select((int)sock+1, &rset, NULL, NULL, &timeout) <= 0)
+        return -1;
+
+    len = size;
+    if (pj_sock_recv(sock, buf, &len, 0) != PJ_SUCCESS)
+        return -1;
+
+    return len;
+}
+
+/* Wait until the clients have received the specified number of
+ * ChannelData packets.
+ */
+static int wait_channel_data(struct test_ctx *ctx, unsigned cnt)
+{
+    unsigned msec;
+
+    for (msec = 0; msec < WAIT_MSEC; msec += 10) {
+        unsigned cd_cnt;
+
+        pj_lock_acquire(ctx->lock);
+        cd_cnt = ctx->cd_cnt;
+        pj_lock_release(ctx->lock);
+
+        if (cd_cnt >= cnt)
+            return 0;
+        pj_thread_sleep(10);
+    }
+    return -1;
+}
+
+static int init_ctx(struct test_ctx *ctx)
+{
+    pj_str_t realm, user, passwd;
+    unsigned i;
+
+    pj_bzero(ctx, sizeof(*ctx));
+    ctx->pool = pj_pool_create(&g_cp.factory, "srvtest", 4000, 4000, NULL);
+    ctx->op = PJ_POOL_ZALLOC_T(ctx->pool, struct inject_op);
+    ctx->op->pkt.pool = pj_pool_create(&g_cp.factory, "srvtestpkt", 1000,
+                                       1000, NULL);
+
+    if (pj_lock_create_simple_mutex(ctx->pool, "srvtest", &ctx->lock))
+        return -1;
+
+    pj_stun_create_key(ctx->pool, &ctx->key, pj_cstr(&realm, REALM),
+                       pj_cstr(&user, USERNAME), PJ_STUN_PASSWD_PLAIN,
+                       pj_cstr(&passwd, PASSWORD));
+
+    if (pj_turn_srv_create2(&g_cp.factory, SHARD_CNT, &ctx->srv))
+        return -2;
+
+    /* Fake listener, the relays are bound to its address */
+    ctx->lis.obj_name = "testlis";
+    ctx->lis.server = ctx->srv;
+    ctx->lis.tp_type = PJ_TURN_TP_UDP;
+    ctx->lis.sock = PJ_INVALID_SOCKET;
+    pj_sockaddr_init(pj_AF_INET(), &ctx->lis.addr, pj_cstr(&realm, "127.0.0.1"),
+                     0);
+
+    /* One transport for each shard */
+    for (i = 0; i < SHARD_CNT; ++i) {
+        struct test_tp *tp = &ctx->tp[i];
+
+        tp->ctx = ctx;
+        tp->base.obj_name = "testtp";
+        tp->base.info = "testtp";
+        tp->base.listener = &ctx->lis;
+        tp->base.shard = &ctx->srv->core.shard[i];
+        tp->base.sock = PJ_INVALID_SOCKET;
+        tp->base.sendto = &tp_sendto;
+        tp->base.add_ref = &tp_add_ref;
+        tp->base.dec_ref = &tp_dec_ref;
+    }
+
+    return 0;
+}
+
+static void destroy_ctx(struct test_ctx *ctx)
+{
+    if (ctx->srv)
+        pj_turn_srv_destroy(ctx->srv);
+    if (ctx->lock)
+        pj_lock_destroy(ctx->lock);
+    pj_pool_release(ctx->op->pkt.pool);
+    pj_pool_release(ctx->pool);
+}
+
+/*
+ * Relay data of a client whose packets are received by both shards. The
+ * packets received by the shard not owning the allocation must be handed
+ * over to the owner.
+ */
+static int cross_shard_test(void)
+{
+    struct test_ctx ctx;
+    pj_sockaddr clt_addr, peer_addr, relay_addr;
+    pj_sock_t peer = PJ_INVALID_SOCKET;
+    pj_str_t s;
+    char buf[64];
+    pj_ssize_t len;
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  cross shard test"));
+
+    rc = init_ctx(&ctx);
+    if (rc)
+        goto on_return;
+
+    if (create_peer(&peer, &peer_addr)) {
+        rc = -10;
+        goto on_return;
+    }
+
+    /* The allocation is owned by shard 0 */
+    pj_sockaddr_init(pj_AF_INET(), &clt_addr, pj_cstr(&s, "127.0.0.1"), 5000);
+    rc = allocate(&ctx, 0, &clt_addr, &relay_addr);
+    if (rc)
+        goto on_return;
+
+    /* Channel bind received by the other shard */
+    rc = channel_bind(&ctx, 1, &clt_addr, CH_NUM, &peer_addr);
+    if (rc)
+        goto on_return;
+
+    /* ChannelData received by both shards must reach the peer */
+    for (i = 0; i < SHARD_CNT; ++i) {
+        char data[16];
+
+        pj_ansi_snprintf(data, sizeof(data), "data%d", i);
+        rc = send_channel_data(&ctx, i, &clt_addr, CH_NUM, data);
+        if (rc) {
+            rc = -20;
+            goto on_return;
+        }
+
+        len = peer_recv(peer, buf, sizeof(buf), WAIT_MSEC);
+        if (len != (pj_ssize_t)pj_ansi_strlen(data) ||
+            pj_memcmp(buf, data, len))
+        {
+            PJ_LOG(3,(THIS_FILE, "  error: peer didn't get data from "
+                      "shard %d", i));
+            rc = -30;
+            goto on_return;
+        }
+    }
+
+    /* Data from the peer goes to the client as ChannelData */
+    len = 4;
+    pj_sock_sendto(peer, "peer", &len, 0, &relay_addr,
+                   pj_sockaddr_get_len(&relay_addr));
+    if (wait_channel_data(&ctx, 1)) {
+        rc = -40;
+        goto on_return;
+    }
+
+on_return:
+    if (peer != PJ_INVALID_SOCKET)
+        pj_sock_close(peer);
+    destroy_ctx(&ctx);
+    return rc;
+}
+
+static void burst_cb(pj_timer_heap_t *th, pj_timer_entry *e)
+{
+    struct burst_op *op = (struct burst_op*)e->user_data;
+    struct test_ctx *ctx = op->ctx;
+    pj_turn_channel_data *cd = (pj_turn_channel_data*)op->pkt.pkt;
+    pj_time_val delay = { 0, ROUND_MSEC };
+    unsigned i;
+
+    /* One packet from each client, the payload is the client index */
+    for (i = 0; i < CLIENT_CNT; ++i) {
+        op->pkt.transport = &ctx->tp[op->shard_idx].base;
+        pj_bzero(&op->pkt.src, sizeof(op->pkt.src));
+        op->pkt.src.tp_type = PJ_TURN_TP_UDP;
+        pj_sockaddr_cp(&op->pkt.src.clt_addr, &ctx->clt_addr[i]);
+        op->pkt.src_addr_len = pj_sockaddr_get_len(&ctx->clt_addr[i]);
+        pj_gettimeofday(&op->pkt.rx_time);
+        cd->ch_number = pj_htons(CH_NUM);
+        cd->length = pj_htons(1);
+        op->pkt.pkt[sizeof(*cd)] = (pj_uint8_t)i;
+        op->pkt.len = sizeof(*cd) + 1;
+
+        pj_turn_srv_on_rx_pkt(ctx->srv, &op->pkt);
+    }
+    pj_turn_srv_shard_flush(&ctx->srv->core.shard[op->shard_idx]);
+
+    if (++op->round < op->round_cnt)
+        pj_timer_heap_schedule(th, &op->timer, &delay);
+    else
+        op->done = PJ_TRUE;
+}
+
+/* Start sending ChannelData from all clients in all shards */
+static int start_bursts(struct test_ctx *ctx, struct burst_op op[],
+                        unsigned round_cnt)
+{
+    pj_time_val delay = { 0, 0 };
+    unsigned i;
+
+    for (i = 0; i < SHARD_CNT; ++i) {
+        op[i].ctx = ctx;
+        op[i].shard_idx = i;
+        op[i].round = 0;
+        op[i].round_cnt = round_cnt;
+        op[i].done = PJ_FALSE;
+        op[i].pkt.pool = ctx->op->pkt.pool;
+        pj_timer_entry_init(&op[i].timer, 0, &op[i], &burst_cb);
+        if (pj_timer_heap_schedule(ctx->srv->core.shard[i].timer_heap,
+                                   &op[i].timer, &delay))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static pj_bool_t bursts_done(struct burst_op op[])
+{
+    unsigned i;
+
+    for (i = 0; i < SHARD_CNT; ++i) {
+        if (!op[i].done)
+            return PJ_FALSE;
+    }
+    return PJ_TRUE;
+}
+
+/* Delete the allocation of the client */
+static int deallocate(struct test_ctx *ctx, unsigned shard_idx,
+                      const pj_sockaddr *src)
+{
+    pj_stun_msg *req, *res;
+    int rc;
+
+    if (pj_stun_msg_create(ctx->pool, PJ_STUN_REFRESH_REQUEST,
+                           PJ_STUN_MAGIC, NULL, &req))
+    {
+        return -400;
+    }
+    pj_stun_msg_add_uint_attr(ctx->pool, req, PJ_STUN_ATTR_LIFETIME, 0);
+
+    rc = send_request(ctx, shard_idx, src, req, PJ_TRUE, &res);
+    if (rc)
+        return rc;
+
+    if (res->hdr.type != PJ_STUN_REFRESH_RESPONSE)
+        return -410;
+
+    return 0;
+}
+
+/*
+ * Relay ChannelData received by both shards for several clients, while
+ * the channels are being refreshed and later the allocations deleted.
+ */
+static int concurrent_test(void)
+{
+    struct test_ctx ctx;
+    struct burst_op *op = NULL;
+    pj_sockaddr peer_addr, relay_addr;
+    pj_sock_t peer = PJ_INVALID_SOCKET;
+    unsigned rx_cnt[CLIENT_CNT];
+    unsigned i, k, total, msec;
+    char buf[64];
+    pj_ssize_t len;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  concurrent ChannelData test"));
+
+    pj_bzero(rx_cnt, sizeof(rx_cnt));
+
+    rc = init_ctx(&ctx);
+    if (rc)
+        goto on_return;
+
+    op = (struct burst_op*) pj_pool_calloc(ctx.pool, SHARD_CNT,
+                                           sizeof(struct burst_op));
+
+    if (create_peer(&peer, &peer_addr)) {
+        rc = -10;
+        goto on_return;
+    }
+
+    /* Spread the allocations among the shards, all relaying to the peer */
+    for (i = 0; i < CLIENT_CNT; ++i) {
+        pj_str_t s;
+
+        pj_sockaddr_init(pj_AF_INET(), &ctx.clt_addr[i],
+                         pj_cstr(&s, "127.0.0.1"), (pj_uint16_t)(6000 + i));
+        rc = allocate(&ctx, i % SHARD_CNT, &ctx.clt_addr[i], &relay_addr);
+        if (rc)
+            goto on_return;
+
+        rc = channel_bind(&ctx, (i + 1) % SHARD_CNT, &ctx.clt_addr[i],
+                          CH_NUM, &peer_addr);
+        if (rc)
+            goto on_return;
+    }
+
+    /* Refresh the channels while ChannelData is being relayed */
+    rc = start_bursts(&ctx, op, ROUND_CNT);
+    if (rc) {
+        rc = -20;
+        goto on_return;
+    }
+
+    for (k = 0; !bursts_done(op); ++k) {
+        rc = channel_bind(&ctx, k % SHARD_CNT, &ctx.clt_addr[k % CLIENT_CNT],
+                          CH_NUM, &peer_addr);
+        if (rc)
+            goto on_return;
+
+        while ((len = peer_recv(peer, buf, sizeof(buf), 0)) > 0) {
+            if (len == 1 && (unsigned)buf[0] < CLIENT_CNT)
+                ++rx_cnt[(unsigned)buf[0]];
+        }
+    }
+
+    /* Every packet must have been relayed */
+    total = 0;
+    for (msec = 0; total < CLIENT_CNT * SHARD_CNT * ROUND_CNT &&
+                   msec < WAIT_MSEC; )
+    {
+        len = peer_recv(peer, buf, sizeof(buf), 10);
+        if (len < 0) {
+            msec += 10;
+        } else if (len == 1 && (unsigned)buf[0] < CLIENT_CNT) {
+            ++rx_cnt[(unsigned)buf[0]];
+        }
+
+        for (i = 0, total = 0; i < CLIENT_CNT; ++i)
+            total += rx_cnt[i];
+    }
+
+    for (i = 0; i < CLIENT_CNT; ++i) {
+        PJ_LOG(4,(THIS_FILE, "    client %d: %d packets relayed", i,
+                  rx_cnt[i]));
+        if (rx_cnt[i] != SHARD_CNT * ROUND_CNT) {
+            PJ_LOG(3,(THIS_FILE, "  error: client %d: %d of %d packets "
+                      "relayed", i, rx_cnt[i], SHARD_CNT * ROUND_CNT));
+            rc = -30;
+            goto on_return;
+        }
+    }
+
+    /* Delete the allocations while ChannelData is being relayed. The
+     * allocations are destroyed some time after the deallocation.
+     */
+    rc = start_bursts(&ctx, op, (WAIT_MSEC / 2) / ROUND_MSEC);
+    if (rc) {
+        rc = -40;
+        goto on_return;
+    }
+
+    for (i = 0; i < CLIENT_CNT; ++i) {
+        rc = deallocate(&ctx, (i + 1) % SHARD_CNT, &ctx.clt_addr[i]);
+        if (rc)
+            goto on_return;
+    }
+
+    for (msec = 0; !bursts_done(op) && msec < WAIT_MSEC * 2; msec += 10)
+        pj_thread_sleep(10);
+
+    if (!bursts_done(op)) {
+        rc = -50;
+        goto on_return;
+    }
+
+    for (i = 0; i < SHARD_CNT; ++i) {
+        pj_lock_acquire(ctx.srv->core.shard[i].lock);
+        total = pj_hash_count(ctx.srv->core.shard[i].tables.alloc);
+        pj_lock_release(ctx.srv->core.shard[i].lock);
+
+        if (total != 0) {
+            rc = -60;
+            goto on_return;
+        }
+    }
+
+on_return:
+    /* Stop the worker threads before the bursts are released */
+    if (ctx.srv) {
+        pj_turn_srv_destroy(ctx.srv);
+        ctx.srv = NULL;
+    }
+    if (peer != PJ_INVALID_SOCKET)
+        pj_sock_close(peer);
+    destroy_ctx(&ctx);
+    return rc;
+}
+
+static int srv_test(void)
+{
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "TURN server shard test"));
+
+    rc = cross_shard_test();
+    if (rc)
+        return rc;
+
+    rc = concurrent_test();
+    if (rc)
+        return rc;
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    pj_status_t status;
+    int rc;
+
+    PJ_UNUSED_ARG(argc);
+    PJ_UNUSED_ARG(argv);
+
+    status = pj_init();
+    if (status != PJ_SUCCESS)
+        return 1;
+
+    pjlib_util_init();
+    pjnath_init();
+
+    pj_log_set_level(3);
+    pj_caching_pool_init(&g_cp, NULL, 0);
+    pj_turn_auth_init(REALM);
+
+    rc = srv_test();
+    if (rc == 0) {
+        PJ_LOG(3,(THIS_FILE, "Looks like everything is okay!"));
+    } else {
+        PJ_LOG(3,(THIS_FILE, "Test completed with error(s): %d", rc));
+    }
+
+    pj_caching_pool_destroy(&g_cp);
+    pj_shutdown();
+
+    return rc ? 1 : 0;
+}
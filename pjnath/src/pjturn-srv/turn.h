@@ -28,11 +28,66 @@ typedef struct pj_turn_transport    pj_turn_transport;
 typedef struct pj_turn_permission   pj_turn_permission;
 typedef struct pj_turn_allocation   pj_turn_allocation;
 typedef struct pj_turn_srv          pj_turn_srv;
+typedef struct pj_turn_srv_shard    pj_turn_srv_shard;
+typedef struct pj_turn_tx_batch     pj_turn_tx_batch;
+typedef struct pj_turn_fwd_queue    pj_turn_fwd_queue;
 typedef struct pj_turn_pkt          pj_turn_pkt;
 
 
 #define PJ_TURN_INVALID_LIS_ID      ((unsigned)-1)
 
+/** Minimum valid channel number. */
+#define PJ_TURN_SRV_CH_MIN          0x4000
+
+/** Maximum valid channel number (inclusive). */
+#define PJ_TURN_SRV_CH_MAX          0x7FFF
+
+/** Number of entries in each chunk of the allocation's channel table. */
+#define PJ_TURN_SRV_CH_CHUNK        256
+
+/** Number of chunks in the allocation's channel table. */
+#define PJ_TURN_SRV_CH_CHUNK_CNT    ((PJ_TURN_SRV_CH_MAX-PJ_TURN_SRV_CH_MIN+1)/\
+                                     PJ_TURN_SRV_CH_CHUNK)
+
+/**
+ * Specify whether the datagrams relayed by a shard are sent in batches
+ * with sendmmsg(). Default is enabled on Linux.
+ */
+#ifndef PJ_TURN_SRV_HAS_SENDMMSG
+#   if defined(PJ_LINUX) && PJ_LINUX!=0
+#       define PJ_TURN_SRV_HAS_SENDMMSG     1
+#   else
+#       define PJ_TURN_SRV_HAS_SENDMMSG     0
+#   endif
+#endif
+
+/**
+ * Maximum number of datagrams queued by a shard before they are sent.
+ * The queue is also flushed every time the shard has finished processing
+ * the events of one ioqueue poll.
+ */
+#ifndef PJ_TURN_SRV_TX_BATCH_SIZE
+#   define PJ_TURN_SRV_TX_BATCH_SIZE        32
+#endif
+
+/**
+ * Default number of server shards, i.e. worker threads, used by
+ * pj_turn_srv_create().
+ */
+#ifndef PJ_TURN_SRV_SHARD_CNT
+#   define PJ_TURN_SRV_SHARD_CNT            2
+#endif
+
+/**
+ * Maximum number of client packets waiting to be handed over to the shard
+ * owning their allocation, when they are received by another shard. The
+ * owner is woken up to process the queue, more packets are dropped until
+ * it has done so.
+ */
+#ifndef PJ_TURN_SRV_FWD_QUEUE_SIZE
+#   define PJ_TURN_SRV_FWD_QUEUE_SIZE       32
+#endif
+
 /** 
  * Get transport type name string.
  */
@@ -136,6 +191,12 @@ struct pj_turn_allocation
     /** Server instance. */
     pj_turn_srv         *server;
 
+    /** Server shard which owns this allocation. The allocation may only
+     *  be accessed by the worker thread of this shard, client packets
+     *  received by other shards are handed over to it.
+     */
+    pj_turn_srv_shard   *shard;
+
     /** Transport to send/receive packets to/from client. */
     pj_turn_transport   *transport;
 
@@ -157,8 +218,16 @@ struct pj_turn_allocation
     /** Peer hash table (keyed by peer address) */
     pj_hash_table_t     *peer_table;
 
-    /** Channel hash table (keyed by channel number) */
-    pj_hash_table_t     *ch_table;
+    /** Channel table, indexed by channel number minus PJ_TURN_SRV_CH_MIN.
+     *  The chunks are allocated on demand. The table is updated with the
+     *  allocation lock held, and read without the lock by the ChannelData
+     *  fast path. This is safe since the allocation is only accessed by
+     *  the worker thread of its shard.
+     */
+    pj_turn_permission **ch_table[PJ_TURN_SRV_CH_CHUNK_CNT];
+
+    /** Number of channels bound. */
+    unsigned            ch_cnt;
 };
 
 
@@ -210,7 +279,8 @@ PJ_DECL(void) pj_turn_allocation_destroy(pj_turn_allocation *alloc);
 
 
 /**
- * Handle incoming packet from client.
+ * Handle incoming packet from client. This may only be called by the
+ * worker thread of the allocation's shard.
  */
 PJ_DECL(void) pj_turn_allocation_on_rx_client_pkt(pj_turn_allocation *alloc,
                                                   pj_turn_pkt *pkt);
@@ -279,6 +349,16 @@ struct pj_turn_transport
     /** Listener instance */
     pj_turn_listener    *listener;
 
+    /** Server shard which polls this transport. Allocations created
+     *  through this transport will belong to the same shard.
+     */
+    pj_turn_srv_shard   *shard;
+
+    /** Datagram socket which packets to the client may be sent with
+     *  directly (e.g. in batches), or PJ_INVALID_SOCKET.
+     */
+    pj_sock_t           sock;
+
     /** Sendto handler */
     pj_status_t         (*sendto)(pj_turn_transport *tp,
                                   const void *packet,
@@ -327,7 +407,10 @@ struct pj_turn_pkt
 
 
 /**
- * Create a UDP listener on the specified port.
+ * Create a UDP listener on the specified port. When the server has more
+ * than one shard and the platform supports SO_REUSEPORT, one socket is
+ * bound for each shard and the kernel distributes clients among them.
+ * Otherwise a single socket is polled by the first shard.
  */
 PJ_DECL(pj_status_t) pj_turn_listener_create_udp(pj_turn_srv *srv,
                                                  int af,
@@ -338,7 +421,8 @@ PJ_DECL(pj_status_t) pj_turn_listener_create_udp(pj_turn_srv *srv,
                                                  pj_turn_listener **p_lis);
 
 /**
- * Create a TCP listener on the specified port.
+ * Create a TCP listener on the specified port. Accepted connections are
+ * assigned to the server shards in round-robin fashion.
  */
 PJ_DECL(pj_status_t) pj_turn_listener_create_tcp(pj_turn_srv *srv,
                                                  int af,
@@ -373,6 +457,66 @@ PJ_DECL(void) pj_turn_transport_dec_ref(pj_turn_transport *transport,
 /*
  * TURN Server API
  */
+
+/**
+ * This structure describes a TURN server shard. Each shard has its own
+ * ioqueue, timer heap, worker thread and allocation tables, so that
+ * allocations in different shards are processed independently of each
+ * other.
+ */
+struct pj_turn_srv_shard
+{
+    /** Object name */
+    char                obj_name[PJ_MAX_OBJ_NAME];
+
+    /** TURN server instance. */
+    pj_turn_srv         *server;
+
+    /** Shard index in the server. */
+    unsigned            id;
+
+    /** Ioqueue for this shard. */
+    pj_ioqueue_t        *ioqueue;
+
+    /** Mutex to protect the hash tables and the timer heap. */
+    pj_lock_t           *lock;
+
+    /** Timer heap for this shard. */
+    pj_timer_heap_t     *timer_heap;
+
+    /** Worker thread. */
+    pj_thread_t         *thread;
+
+    /** STUN config. */
+    pj_stun_config      stun_cfg;
+
+    /** STUN session to handle initial Allocate request. */
+    pj_stun_session     *stun_sess;
+
+    /** Queue of relayed datagrams waiting to be sent. */
+    pj_turn_tx_batch    *tx_batch;
+
+    /** Queue of client packets handed over by other shards. */
+    pj_turn_fwd_queue   *fwd_queue;
+
+    /** Hash tables */
+    struct {
+        /** Allocations hash table, indexed by transport type and
+         *  client address. The allocation of a client is kept in the
+         *  table of the shard selected by the hash of its key, which is
+         *  not necessarily the shard owning the allocation.
+         */
+        pj_hash_table_t *alloc;
+
+        /** Relay resource hash table, indexed by transport type and
+         *  relay address.
+         */
+        pj_hash_table_t *res;
+
+    } tables;
+};
+
+
 /**
  * This structure describes TURN pj_turn_srv instance.
  */
@@ -389,36 +533,24 @@ struct pj_turn_srv
         /** Pool for this server instance. */
         pj_pool_t       *pool;
 
-        /** Global Ioqueue */
-        pj_ioqueue_t    *ioqueue;
-
-        /** Mutex */
+        /** Mutex to protect the listeners and ports settings. */
         pj_lock_t       *lock;
 
-        /** Global timer heap instance. */
-        pj_timer_heap_t *timer_heap;
-
         /** Number of listeners */
         unsigned         lis_cnt;
 
         /** Array of listeners. */
         pj_turn_listener **listener;
 
-        /** STUN session to handle initial Allocate request. */
-        pj_stun_session *stun_sess;
-
-        /** Number of worker threads. */
-        unsigned        thread_cnt;
+        /** Number of shards, each is served by one worker thread. */
+        unsigned        shard_cnt;
 
-        /** Array of worker threads. */
-        pj_thread_t     **thread;
+        /** Array of shards. */
+        pj_turn_srv_shard *shard;
 
         /** Thread quit signal */
         pj_bool_t       quit;
 
-        /** STUN config. */
-        pj_stun_config   stun_cfg;
-
         /** STUN auth credential. */
         pj_stun_auth_cred cred;
 
@@ -427,21 +559,6 @@ struct pj_turn_srv
 
     } core;
 
-    
-    /** Hash tables */
-    struct {
-        /** Allocations hash table, indexed by transport type and
-         *  client address. 
-         */
-        pj_hash_table_t *alloc;
-
-        /** Relay resource hash table, indexed by transport type and
-         *  relay address. 
-         */
-        pj_hash_table_t *res;
-
-    } tables;
-
     /** Ports settings */
     struct {
         /** Minimum UDP port number. */
@@ -468,11 +585,20 @@ struct pj_turn_srv
 
 
 /** 
- * Create server.
+ * Create server with the default number of shards.
  */
 PJ_DECL(pj_status_t) pj_turn_srv_create(pj_pool_factory *pf,
                                         pj_turn_srv **p_srv);
 
+/**
+ * Create server with the specified number of shards. Each shard is
+ * served by its own worker thread, so this is normally set to the number
+ * of CPU cores available to the server.
+ */
+PJ_DECL(pj_status_t) pj_turn_srv_create2(pj_pool_factory *pf,
+                                         unsigned shard_cnt,
+                                         pj_turn_srv **p_srv);
+
 /** 
  * Destroy server.
  */
@@ -485,17 +611,51 @@ PJ_DECL(pj_status_t) pj_turn_srv_add_listener(pj_turn_srv *srv,
                                               pj_turn_listener *lis);
 
 /**
- * Register an allocation.
+ * Register an allocation to the server tables.
+ *
+ * @return              PJ_SUCCESS, or PJ_EEXISTS if another allocation
+ *                      has been registered for the same client.
  */
 PJ_DECL(pj_status_t) pj_turn_srv_register_allocation(pj_turn_srv *srv,
                                                      pj_turn_allocation *alloc);
 
 /**
- * Unregister an allocation.
+ * Unregister an allocation from the server tables.
  */
 PJ_DECL(pj_status_t) pj_turn_srv_unregister_allocation(pj_turn_srv *srv,
                                                        pj_turn_allocation *alloc);
 
+/**
+ * Check whether the calling thread is the worker thread of the shard.
+ */
+PJ_DECL(pj_bool_t) pj_turn_srv_shard_is_current(const pj_turn_srv_shard *shard);
+
+/**
+ * Queue a datagram to be sent with the socket. The datagram consists of
+ * the optional header followed by the data. The queue is flushed when it's
+ * full or when the shard has finished processing the current network
+ * events.
+ *
+ * This may only be called by the shard's worker thread.
+ *
+ * @return              PJ_SUCCESS if the datagram has been queued, or
+ *                      PJ_EINVALIDOP if called from other thread.
+ */
+PJ_DECL(pj_status_t) pj_turn_srv_shard_sendto(pj_turn_srv_shard *shard,
+                                              pj_sock_t sock,
+                                              const void *hdr,
+                                              unsigned hdr_len,
+                                              const void *data,
+                                              pj_size_t len,
+                                              const pj_sockaddr_t *addr,
+                                              int addr_len);
+
+/**
+ * Send the queued datagrams of the shard. This does nothing if called
+ * from thread other than the shard's worker thread.
+ */
+PJ_DECL(void) pj_turn_srv_shard_flush(pj_turn_srv_shard *shard);
+
 /**
  * This callback is called by UDP listener on incoming packet.
  */
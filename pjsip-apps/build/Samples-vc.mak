@@ -78,6 +78,7 @@ BINDIR = ..\bin\samples\$(TARGET)
 SAMPLES = $(BINDIR)\auddemo.exe \
 	  $(BINDIR)\aectest.exe \
 	  $(BINDIR)\aviplay.exe \
+	  $(BINDIR)\callchurn.exe \
 	  $(BINDIR)\clidemo.exe \
 	  $(BINDIR)\confsample.exe \
 	  $(BINDIR)\confbench.exe \
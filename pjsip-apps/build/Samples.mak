@@ -19,6 +19,7 @@ BINDIR := ../bin/samples/$(TARGET_NAME)
 SAMPLES := auddemo \
 	   aviplay \
 	   aectest \
+	   callchurn \
 	   clidemo \
 	   confsample \
 	   encdec \
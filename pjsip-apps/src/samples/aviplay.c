@@ -198,6 +198,7 @@ static int aviplay(pj_pool_t *pool, const char *fname)
     avi_port_t avi_port;
     
     pj_bzero(&avi_port, sizeof(avi_port));
+    pj_bzero(&codec_port_data, sizeof(codec_port_data));
     
     CHECK( pjmedia_avi_player_create_streams(pool, fname, 0, &avi_streams) );
     
@@ -418,6 +419,8 @@ on_return:
         pjmedia_vid_codec_close(codec);
         pjmedia_vid_codec_mgr_dealloc_codec(NULL, codec);
     }
+    if (codec_port_data.conv)
+        pjmedia_converter_destroy(codec_port_data.conv);
     
     return rc;
 }
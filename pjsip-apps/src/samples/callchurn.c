@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * callchurn.c
+ *
+ * Call churn benchmark for pjsua-lib. The program makes calls to itself
+ * over a loopback UDP transport, answers them automatically, and hangs up
+ * as soon as each call is confirmed, keeping a fixed number of calls in
+ * progress. At the end it prints the number of completed calls per second.
+ *
+ * Since both ends of every call live in the same pjsua instance, the
+ * number reflects how well pjsua-lib's locking lets unrelated calls
+ * progress in parallel on the worker threads.
+ *
+ * Usage:
+ *   callchurn [options]
+ *
+ *   -t N   Number of pjsua worker threads (default: 1)
+ *   -c N   Number of outgoing calls kept in progress (default: 16)
+ *   -d N   Test duration in seconds (default: 10)
+ *   -w N   Milliseconds to sleep in each application callback, to
+ *          simulate slow applications (default: 0)
+ *   -p N   SIP UDP port (default: 5080)
+ *   -l N   Console log level (default: 1)
+ *
+ * Every call opens RTP and RTCP sockets on both of its ends, and closed
+ * sockets are only recycled by the ioqueue after PJ_IOQUEUE_KEY_FREE_DELAY.
+ * The default PJ_IOQUEUE_MAX_HANDLES of the select() ioqueue is therefore
+ * too small for fast churn; build with a larger PJ_IOQUEUE_MAX_HANDLES
+ * and/or a shorter PJ_IOQUEUE_KEY_FREE_DELAY in config_site.h before
+ * running this test.
+ */
+
+#include <pjsua-lib/pjsua.h>
+#include <pjlib-util/getopt.h>
+
+#define THIS_FILE       "callchurn.c"
+
+
+static struct app
+{
+    unsigned             thread_cnt;
+    unsigned             concurrency;
+    unsigned             duration;
+    unsigned             cb_delay;
+    unsigned             port;
+    unsigned             log_level;
+
+    pj_pool_t           *pool;
+    pj_atomic_t         *outstanding;
+    pj_atomic_t         *completed;
+    pj_atomic_t         *failed;
+} app;
+
+
+static void usage(void)
+{
+    puts("Usage: callchurn [-t threads] [-c concurrent calls] "
+         "[-d seconds] [-w callback delay ms] [-p port] [-l log level]");
+}
+
+
+static void app_perror(const char *title, pj_status_t status)
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+
+    pj_strerror(status, errmsg, sizeof(errmsg));
+    PJ_LOG(1,(THIS_FILE, "%s: %s", title, errmsg));
+}
+
+
+/* Auto-answer incoming calls */
+static void on_incoming_call(pjsua_acc_id acc_id, pjsua_call_id call_id,
+                             pjsip_rx_data *rdata)
+{
+    PJ_UNUSED_ARG(acc_id);
+    PJ_UNUSED_ARG(rdata);
+
+    if (app.cb_delay)
+        pj_thread_sleep(app.cb_delay);
+
+    pjsua_call_answer(call_id, 200, NULL, NULL);
+}
+
+
+/* Hang up outgoing calls once confirmed and count the completed ones */
+static void on_call_state(pjsua_call_id call_id, pjsip_event *e)
+{
+    pjsua_call_info ci;
+
+    PJ_UNUSED_ARG(e);
+
+    if (pjsua_call_get_info(call_id, &ci) != PJ_SUCCESS ||
+        ci.role != PJSIP_ROLE_UAC)
+    {
+        return;
+    }
+
+    if (ci.state == PJSIP_INV_STATE_CONFIRMED) {
+        if (app.cb_delay)
+            pj_thread_sleep(app.cb_delay);
+
+        pjsua_call_hangup(call_id, 0, NULL, NULL);
+
+    } else if (ci.state == PJSIP_INV_STATE_DISCONNECTED) {
+        if (ci.connect_duration.sec == 0 && ci.connect_duration.msec == 0 &&
+            ci.last_status != PJSIP_SC_OK)
+        {
+            pj_atomic_inc(app.failed);
+        } else {
+            pj_atomic_inc(app.completed);
+        }
+        pj_atomic_dec(app.outstanding);
+    }
+}
+
+
+static pj_status_t parse_args(int argc, char *argv[])
+{
+    int c;
+
+    app.thread_cnt = 1;
+    app.concurrency = 16;
+    app.duration = 10;
+    app.cb_delay = 0;
+    app.port = 5080;
+    app.log_level = 1;
+
+    while ((c=pj_getopt(argc, argv, "t:c:d:w:p:l:h")) != -1) {
+        switch (c) {
+        case 't':
+            app.thread_cnt = atoi(pj_optarg);
+            break;
+        case 'c':
+            app.concurrency = atoi(pj_optarg);
+            break;
+        case 'd':
+            app.duration = atoi(pj_optarg);
+            break;
+        case 'w':
+            app.cb_delay = atoi(pj_optarg);
+            break;
+        case 'p':
+            app.port = atoi(pj_optarg);
+            break;
+        case 'l':
+            app.log_level = atoi(pj_optarg);
+            break;
+        default:
+            usage();
+            return PJ_EINVAL;
+        }
+    }
+
+    if (app.thread_cnt == 0 || app.concurrency == 0 || app.duration == 0) {
+        usage();
+        return PJ_EINVAL;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+static pj_status_t init(void)
+{
+    pjsua_config cfg;
+    pjsua_logging_config log_cfg;
+    pjsua_media_config media_cfg;
+    pjsua_transport_config tp_cfg;
+    pjsua_transport_id tp_id;
+    pjsua_acc_id acc_id;
+    pj_status_t status;
+
+    status = pjsua_create();
+    if (status != PJ_SUCCESS) {
+        app_perror("pjsua_create() error", status);
+        return status;
+    }
+
+    pjsua_config_default(&cfg);
+    cfg.thread_cnt = app.thread_cnt;
+    /* Each call has both of its ends in this instance, and slots of
+     * disconnected calls are only freed after on_call_state() returns.
+     */
+    cfg.max_calls = app.concurrency * 4 + 4;
+    cfg.cb.on_incoming_call = &on_incoming_call;
+    cfg.cb.on_call_state = &on_call_state;
+
+    pjsua_logging_config_default(&log_cfg);
+    log_cfg.console_level = app.log_level;
+    log_cfg.level = app.log_level;
+
+    pjsua_media_config_default(&media_cfg);
+    media_cfg.max_media_ports = cfg.max_calls + 4;
+
+    status = pjsua_init(&cfg, &log_cfg, &media_cfg);
+    if (status != PJ_SUCCESS) {
+        app_perror("pjsua_init() error", status);
+        return status;
+    }
+
+    pjsua_transport_config_default(&tp_cfg);
+    tp_cfg.port = app.port;
+    tp_cfg.bound_addr = pj_str("127.0.0.1");
+    status = pjsua_transport_create(PJSIP_TRANSPORT_UDP, &tp_cfg, &tp_id);
+    if (status != PJ_SUCCESS) {
+        app_perror("Error creating transport", status);
+        return status;
+    }
+
+    status = pjsua_acc_add_local(tp_id, PJ_TRUE, &acc_id);
+    if (status != PJ_SUCCESS) {
+        app_perror("Error adding account", status);
+        return status;
+    }
+
+    status = pjsua_start();
+    if (status != PJ_SUCCESS) {
+        app_perror("pjsua_start() error", status);
+        return status;
+    }
+
+    pjsua_set_null_snd_dev();
+
+    app.pool = pjsua_pool_create("callchurn", 512, 512);
+    pj_atomic_create(app.pool, 0, &app.outstanding);
+    pj_atomic_create(app.pool, 0, &app.completed);
+    pj_atomic_create(app.pool, 0, &app.failed);
+
+    return PJ_SUCCESS;
+}
+
+
+static void run(void)
+{
+    char uri[80];
+    pj_str_t dst;
+    pj_time_val start, now, elapsed;
+    unsigned msec, errors = 0;
+    pj_atomic_value_t completed, failed;
+
+    pj_ansi_snprintf(uri, sizeof(uri), "sip:churn@127.0.0.1:%u", app.port);
+    dst = pj_str(uri);
+
+    PJ_LOG(3,(THIS_FILE, "Running %u concurrent calls on %u thread(s) "
+                         "for %u seconds..", app.concurrency, app.thread_cnt,
+                         app.duration));
+
+    pj_gettimeofday(&start);
+    for (;;) {
+        pj_gettimeofday(&now);
+        elapsed = now;
+        PJ_TIME_VAL_SUB(elapsed, start);
+        if (elapsed.sec >= (long)app.duration)
+            break;
+
+        if (pj_atomic_get(app.outstanding) < (pj_atomic_value_t)
+                                             app.concurrency)
+        {
+            pj_status_t status;
+
+            pj_atomic_inc(app.outstanding);
+            status = pjsua_call_make_call(pjsua_acc_get_default(), &dst,
+                                          NULL, NULL, NULL, NULL);
+            if (status != PJ_SUCCESS) {
+                pj_atomic_dec(app.outstanding);
+                if (errors++ == 0)
+                    app_perror("Error making call", status);
+                pj_thread_sleep(10);
+            }
+        } else {
+            pj_thread_sleep(1);
+        }
+    }
+
+    /* Snapshot the counters before draining the calls still in progress */
+    pj_gettimeofday(&now);
+    elapsed = now;
+    PJ_TIME_VAL_SUB(elapsed, start);
+    msec = PJ_TIME_VAL_MSEC(elapsed);
+    completed = pj_atomic_get(app.completed);
+    failed = pj_atomic_get(app.failed);
+
+    for (elapsed.sec = 0;
+         pj_atomic_get(app.outstanding) > 0 && elapsed.sec < 5; )
+    {
+        pj_thread_sleep(10);
+        pj_gettimeofday(&elapsed);
+        PJ_TIME_VAL_SUB(elapsed, now);
+    }
+
+    printf("Completed %ld calls in %u ms: %.1f calls/sec "
+           "(threads=%u, concurrency=%u, failed=%ld, make_call errors=%u)\n",
+           (long)completed, msec,
+           msec ? completed * 1000.0 / msec : 0.0,
+           app.thread_cnt, app.concurrency, (long)failed, errors);
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (parse_args(argc, argv) != PJ_SUCCESS)
+        return 1;
+
+    if (init() != PJ_SUCCESS) {
+        pjsua_destroy();
+        return 1;
+    }
+
+    run();
+
+    pjsua_call_hangup_all();
+    if (app.pool)
+        pj_pool_release(app.pool);
+    pjsua_destroy();
+
+    return 0;
+}
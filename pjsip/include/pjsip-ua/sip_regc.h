@@ -46,6 +46,9 @@ PJ_BEGIN_DECL
 /** Typedef for client registration data. */
 typedef struct pjsip_regc pjsip_regc;
 
+/** Typedef for registration pacer, see #pjsip_regc_pacer_create(). */
+typedef struct pjsip_regc_pacer pjsip_regc_pacer;
+
 /** Maximum contacts in registration. */
 #define PJSIP_REGC_MAX_CONTACT  10
 
@@ -113,7 +116,8 @@ struct pjsip_regc_info
 {
     pj_str_t    server_uri; /**< Server URI,                                */
     pj_str_t    client_uri; /**< Client URI (From header).                  */
-    pj_bool_t   is_busy;    /**< Have pending transaction?                  */
+    pj_bool_t   is_busy;    /**< Have pending transaction, or a request
+                                 waiting in the pacer's queue?              */
     pj_bool_t   auto_reg;   /**< Will register automatically?               */
     unsigned    interval;   /**< Registration interval (seconds).           */
     unsigned    next_reg;   /**< Time until next registration (seconds).    */
@@ -301,6 +305,74 @@ pjsip_regc_set_delay_before_refresh( pjsip_regc *regc,
                                      pj_uint32_t delay );
 
 
+/**
+ * Set the maximum random interval, in seconds, to subtract from each
+ * automatic refresh delay. This keeps registrations which were created
+ * at the same time from refreshing at the same time forever after.
+ *
+ * @param regc      The registration structure.
+ * @param jitter    Maximum number of seconds to refresh earlier than
+ *                  scheduled, or zero to disable (the default).
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_set_refresh_jitter(pjsip_regc *regc,
+                                                   pj_uint32_t jitter);
+
+
+/**
+ * Create a registration pacer. A pacer limits the rate of REGISTER
+ * requests sent by all client registrations attached to it with
+ * #pjsip_regc_set_pacer(). Requests exceeding the rate, including
+ * automatic refreshes, are queued and sent in the order they were
+ * submitted. Unregistration requests are never delayed.
+ *
+ * @param pool      Pool to allocate the pacer.
+ * @param rate      Maximum number of REGISTER requests per second.
+ * @param p_pacer   Pointer to receive the pacer.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_pacer_create(pj_pool_t *pool,
+                                             unsigned rate,
+                                             pjsip_regc_pacer **p_pacer);
+
+
+/**
+ * Destroy the pacer. All client registrations using the pacer must have
+ * been destroyed.
+ *
+ * @param pacer     The pacer.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_pacer_destroy(pjsip_regc_pacer *pacer);
+
+
+/**
+ * Get the number of REGISTER requests currently waiting in the pacer's
+ * queue.
+ *
+ * @param pacer     The pacer.
+ *
+ * @return          Number of queued requests.
+ */
+PJ_DECL(unsigned) pjsip_regc_pacer_get_backlog(pjsip_regc_pacer *pacer);
+
+
+/**
+ * Attach the client registration to a pacer, or detach it by passing
+ * NULL. This should be done before any request is sent.
+ *
+ * @param regc      The registration structure.
+ * @param pacer     The pacer, or NULL.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_set_pacer(pjsip_regc *regc,
+                                          pjsip_regc_pacer *pacer);
+
+
 /**
  * Set authentication credentials to use by this registration.
  *
@@ -309,6 +309,57 @@ typedef pj_status_t pjsip_auth_lookup_cred2(
                                 pjsip_cred_info *cred_info );
 
 
+/**
+ * Opaque handle of a pending asynchronous credential lookup, see
+ * #pjsip_auth_lookup_cred_async.
+ */
+typedef struct pjsip_auth_lookup_op pjsip_auth_lookup_op;
+
+
+/**
+ * Type of function to start an asynchronous credential lookup, e.g.
+ * to query a database or a remote store without blocking the worker
+ * thread which received the request.
+ *
+ * When the function returns PJ_SUCCESS, the application MUST eventually
+ * call #pjsip_auth_srv_lookup_complete() exactly once for the operation,
+ * from any thread. It may also do so before this function returns.
+ *
+ * @param param         The input param for credential lookup. The rdata
+ *                      in the param is a clone of the request, which stays
+ *                      valid until the lookup is completed.
+ * @param op            The operation, to be passed to
+ *                      #pjsip_auth_srv_lookup_complete().
+ *
+ * @return              PJ_SUCCESS if the lookup has been started. Any
+ *                      other value fails the verification right away, and
+ *                      the application MUST NOT complete the operation.
+ */
+typedef pj_status_t pjsip_auth_lookup_cred_async(
+                                const pjsip_auth_lookup_cred_param *param,
+                                pjsip_auth_lookup_op *op);
+
+
+/**
+ * Type of function to receive the result of
+ * #pjsip_auth_srv_verify_async() when the verification has been
+ * suspended for a credential lookup.
+ *
+ * @param rdata         The request being authenticated. This is a clone
+ *                      of the original request, which is only valid until
+ *                      the callback returns.
+ * @param status        PJ_SUCCESS if the request is authenticated,
+ *                      otherwise one of the error codes of
+ *                      #pjsip_auth_srv_verify().
+ * @param status_code   Suitable status code to be sent to the client.
+ * @param token         The token given to #pjsip_auth_srv_verify_async().
+ */
+typedef void pjsip_auth_srv_verify_cb(pjsip_rx_data *rdata,
+                                      pj_status_t status,
+                                      int status_code,
+                                      void *token);
+
+
 /** Flag to specify that server is a proxy. */
 #define PJSIP_AUTH_SRV_IS_PROXY     1
 
@@ -322,6 +373,11 @@ typedef struct pjsip_auth_srv
     pjsip_auth_lookup_cred  *lookup;    /**< Lookup function.               */
     pjsip_auth_lookup_cred2 *lookup2;   /**< Lookup function with additional
                                              info in its input param.       */
+    pjsip_auth_lookup_cred_async *lookup_async;
+                                        /**< Asynchronous lookup function.  */
+    unsigned                 cache_ttl; /**< HA1 cache lifetime, in seconds.*/
+    struct pjsip_auth_srv_cache *cache; /**< HA1 cache, when cache_ttl is
+                                             set.                           */
 } pjsip_auth_srv;
 
 
@@ -502,6 +558,28 @@ typedef struct pjsip_auth_srv_init_param
      */
     unsigned                     options;
 
+    /**
+     * Optional asynchronous account lookup function, used by
+     * #pjsip_auth_srv_verify_async(). At least one of \a lookup2 and
+     * \a lookup_async must be set.
+     */
+    pjsip_auth_lookup_cred_async *lookup_async;
+
+    /**
+     * Number of seconds to cache the HA1 of credentials returned by the
+     * lookup functions, so that subsequent requests from the same account
+     * are verified without a lookup. Note that changes in the credential
+     * store may take this long to take effect, unless the application
+     * calls #pjsip_auth_srv_flush_cache(); only requests that verify
+     * against the cached HA1 are answered from the cache, the others
+     * cause a new lookup. If this is set, the
+     * application must call #pjsip_auth_srv_deinit() when done with the
+     * session.
+     *
+     * Default: 0 (no caching)
+     */
+    unsigned                     cache_ttl;
+
 } pjsip_auth_srv_init_param;
 
 
@@ -545,6 +623,88 @@ PJ_DECL(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
                                             int *status_code );
 
 
+/**
+ * Deinitialize server authorization session, releasing the HA1 cache.
+ * All asynchronous lookups must have been completed.
+ *
+ * @param auth_srv      The server authentication structure.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_deinit(pjsip_auth_srv *auth_srv);
+
+
+/**
+ * Verify the authorization information in the specified request without
+ * blocking the calling thread on the credential lookup. When the
+ * request verifies against the HA1 cache, or the session has no
+ * asynchronous lookup function, the request is verified right away like
+ * #pjsip_auth_srv_verify(). Otherwise the verification is suspended until
+ * the application completes the lookup with
+ * #pjsip_auth_srv_lookup_complete(), and the result is reported to the
+ * callback.
+ *
+ * Since the request will be answered later, the application should
+ * normally create the UAS transaction for the request before calling
+ * this function, so that retransmissions are absorbed meanwhile.
+ *
+ * @param auth_srv      The server authentication structure.
+ * @param rdata         Incoming request to be authenticated.
+ * @param token         Arbitrary token to be given to the callback.
+ * @param cb            Callback to receive the result, when the
+ *                      verification is suspended.
+ * @param status_code   When not null, it will be filled with suitable
+ *                      status code when the function doesn't return
+ *                      PJ_EPENDING.
+ *
+ * @return              PJ_EPENDING if the verification will complete
+ *                      asynchronously, in which case the callback will
+ *                      be called (possibly before this function returns).
+ *                      Otherwise the result of the verification, as
+ *                      #pjsip_auth_srv_verify(), and the callback will
+ *                      not be called.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_verify_async(pjsip_auth_srv *auth_srv,
+                                                 pjsip_rx_data *rdata,
+                                                 void *token,
+                                                 pjsip_auth_srv_verify_cb *cb,
+                                                 int *status_code);
+
+
+/**
+ * Complete an asynchronous credential lookup started by the
+ * #pjsip_auth_lookup_cred_async callback, and resume the verification of
+ * the request. The verification callback is called from this function.
+ *
+ * @param op            The lookup operation.
+ * @param status        PJ_SUCCESS if the credential was found. Otherwise
+ *                      the lookup error, such as PJSIP_EAUTHACCNOTFOUND or
+ *                      PJSIP_EAUTHACCDISABLED.
+ * @param cred_info     The credential, when status is PJ_SUCCESS. It is
+ *                      only used during this call.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_lookup_complete(
+                                            pjsip_auth_lookup_op *op,
+                                            pj_status_t status,
+                                            const pjsip_cred_info *cred_info);
+
+
+/**
+ * Remove cached HA1 entries, e.g. after a password has been changed in
+ * the credential store.
+ *
+ * @param auth_srv      The server authentication structure.
+ * @param acc_name      The account name to remove, or NULL to remove all
+ *                      entries.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_flush_cache(pjsip_auth_srv *auth_srv,
+                                                const pj_str_t *acc_name);
+
+
 /**
  * Add authentication challenge headers to the outgoing response in tdata. 
  * Application may specify its customized nonce and opaque for the challenge, 
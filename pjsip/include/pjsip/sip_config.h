@@ -261,6 +261,16 @@ typedef struct pjsip_cfg_t
          */
         long keep_alive_interval;
 
+        /**
+         * Set the maximum time, in milliseconds, that outgoing messages
+         * may be held by TCP transports so that messages sent to the same
+         * connection in a burst are written to the socket together. If the
+         * value is zero, each message is sent as soon as possible.
+         *
+         * Default is PJSIP_TCP_COALESCE_DELAY.
+         */
+        unsigned coalesce_delay;
+
     } tcp;
 
     /** TLS transport settings */
@@ -327,6 +337,19 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_MAX_DIALOG_COUNT       (512-1)
 #endif
 
+/**
+ * Specify the number of shards of the dialog hash table in the user agent
+ * layer. Each shard has its own mutex, so that looking up, registering,
+ * and unregistering dialogs with different local tags can proceed in
+ * parallel. The PJSIP_MAX_DIALOG_COUNT hash table entries are divided
+ * among the shards. Set to 1 to use a single table and mutex.
+ *
+ * Default value is 16.
+ */
+#ifndef PJSIP_UA_DLG_TABLE_SHARDS
+#   define PJSIP_UA_DLG_TABLE_SHARDS    16
+#endif
+
 
 /**
  * Specify maximum number of transports.
@@ -804,6 +827,40 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Set the maximum time, in milliseconds, that TCP transports may hold
+ * outgoing messages in order to write several messages queued to the same
+ * connection with a single send operation. Messages that are queued while
+ * a previous write is still in progress are always coalesced into the next
+ * write when this is enabled. If the value is zero, coalescing is disabled
+ * and each message is sent with its own send operation.
+ *
+ * This option can be changed in run-time by settting
+ * \a tcp.coalesce_delay field of pjsip_cfg().
+ *
+ * Default: 0 (disabled)
+ *
+ * @see PJSIP_TCP_COALESCE_MAX_SIZE
+ */
+#ifndef PJSIP_TCP_COALESCE_DELAY
+#   define PJSIP_TCP_COALESCE_DELAY         0
+#endif
+
+
+/**
+ * Maximum number of bytes that TCP transports will write with a single
+ * send operation when coalescing outgoing messages. Messages larger than
+ * this are sent on their own, without being copied. Also when this many
+ * bytes are queued, they are sent without waiting for
+ * PJSIP_TCP_COALESCE_DELAY to elapse.
+ *
+ * Default: 16000
+ */
+#ifndef PJSIP_TCP_COALESCE_MAX_SIZE
+#   define PJSIP_TCP_COALESCE_MAX_SIZE      16000
+#endif
+
+
 /**
  * The initial timeout interval for incoming TCP transports
  * (i.e. server side) in the event that no valid SIP message is received
@@ -894,6 +951,24 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * When the SIP resolver queries both DNS A and AAAA records of a host
+ * (i.e. the port is specified and the address family is not restricted),
+ * this specifies how long (in msec) to wait for the other address family
+ * once the first one has answered with addresses, before reporting the
+ * result without it (the "Resolution Delay" of RFC 8305). The resolved
+ * addresses are ordered starting with the family that answered first,
+ * alternating between families.
+ *
+ * Set to zero to always wait for both queries to complete.
+ *
+ * Default: 50
+ */
+#ifndef PJSIP_RESOLVE_FAMILY_DELAY
+#   define PJSIP_RESOLVE_FAMILY_DELAY           50
+#endif
+
+
 /**
  * Enable TLS SIP transport support. For most systems this means that
  * OpenSSL must be installed.
@@ -1334,6 +1409,18 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_AUTH_ALLOW_MULTIPLE_AUTH_HEADER 0
 #endif
 
+/**
+ * Maximum number of HA1 entries kept by the server authorization session
+ * when credential caching is enabled (see \a cache_ttl in
+ * #pjsip_auth_srv_init_param). When the cache is full, the oldest entry
+ * is replaced.
+ *
+ * Default is 1024
+ */
+#ifndef PJSIP_AUTH_SRV_CACHE_MAX_SIZE
+#   define PJSIP_AUTH_SRV_CACHE_MAX_SIZE        1024
+#endif
+
 /*****************************************************************************
  *  SIP Event framework and presence settings.
  */
@@ -294,6 +294,45 @@ PJ_DECL(pj_status_t) pjsip_find_msg(const char *buf,
                                     pj_bool_t is_datagram, 
                                     pj_size_t *msg_size);
 
+/**
+ * Progress of stream message framing by #pjsip_find_msg2(), kept between
+ * reads of a partially received message so that data already examined
+ * is not scanned again. Initialize with zeroes, and reset to zeroes
+ * whenever the start of the message buffer changes, i.e: after a message
+ * has been consumed.
+ */
+typedef struct pjsip_find_msg_state
+{
+    pj_size_t   hdr_scanned;    /**< Length of data searched for the end
+                                     of the header area.                */
+    pj_size_t   msg_size;       /**< Size of the message once the header
+                                     area has been received, or zero.   */
+} pjsip_find_msg_state;
+
+/**
+ * Incremental version of #pjsip_find_msg() for stream oriented transports.
+ * Each call only searches the newly appended data for the end of the
+ * header area, and the Content-Length header is only looked up once the
+ * header area is complete. Subsequent calls on the same message merely
+ * compare the received length to the known message size.
+ *
+ * @param buf           The input buffer, which must be NULL terminated.
+ * @param size          The length of the string (not counting NULL
+ *                      terminator).
+ * @param state         The framing state of the message at the start of
+ *                      the buffer.
+ * @param msg_size      [out] If message is valid, this parameter will
+ *                      contain the size of the SIP message (including
+ *                      body, if any).
+ *
+ * @return              PJ_SUCCESS if a message is found, PJSIP_EPARTIALMSG
+ *                      if more data is needed, or other error code.
+ */
+PJ_DECL(pj_status_t) pjsip_find_msg2(const char *buf,
+                                     pj_size_t size,
+                                     pjsip_find_msg_state *state,
+                                     pj_size_t *msg_size);
+
 /**
  * Parse the content of a header and return the header instance.
  * This function parses the content of a header (ie. part after colon) according
@@ -293,6 +293,23 @@ PJ_DECL(pj_status_t) pjsip_resolver_set_ext_resolver(
                                                 pjsip_resolver_t *res,
                                                 pjsip_ext_resolver *ext_res);
 
+/**
+ * Set the timer heap to be used by the SIP resolver engine. The timer
+ * heap is needed to report the result of A/AAAA resolution before the
+ * slower of the two queries completes (see #PJSIP_RESOLVE_FAMILY_DELAY).
+ * Without it, the resolver waits for both queries.
+ *
+ * Note that the endpoint sets its own timer heap to the resolver it
+ * creates, so application normally does not need to call this function.
+ *
+ * @param res       The SIP resolver engine.
+ * @param timer_heap The timer heap, or NULL.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_resolver_set_timer_heap(pjsip_resolver_t *res,
+                                                  pj_timer_heap_t *timer_heap);
+
 /**
  * Get the DNS resolver instance of the SIP resolver engine. 
  *
@@ -868,6 +868,8 @@ struct pjsip_transport
 
     pj_timestamp            last_recv_ts;   /**< Last time receiving data.  */
     pj_size_t               last_recv_len;  /**< Last received data length. */
+    pjsip_find_msg_state    rx_msg_state;   /**< Framing state of partially
+                                                 received stream message.   */
 
     void                   *data;           /**< Internal transport data.   */
     unsigned                initial_timeout;/**< Initial timeout interval
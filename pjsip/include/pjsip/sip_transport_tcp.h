@@ -236,6 +236,39 @@ PJ_DECL(pj_status_t) pjsip_tcp_transport_start3(
  */
 PJ_DECL(pj_sock_t) pjsip_tcp_transport_get_socket(pjsip_transport *transport);
 
+
+/**
+ * Transmit statistics of a TCP transport.
+ */
+typedef struct pjsip_tcp_transport_stat
+{
+    /**
+     * Number of messages written to the socket.
+     */
+    pj_uint32_t         tx_msg_cnt;
+
+    /**
+     * Number of socket writes used to send them. This is lower than
+     * \a tx_msg_cnt when messages are coalesced (see
+     * PJSIP_TCP_COALESCE_DELAY).
+     */
+    pj_uint32_t         tx_write_cnt;
+
+} pjsip_tcp_transport_stat;
+
+
+/**
+ * Get the transmit statistics of the TCP transport.
+ *
+ * @param transport     The TCP transport.
+ * @param stat          Pointer to receive the statistics.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_tcp_transport_get_stat(
+                                        pjsip_transport *transport,
+                                        pjsip_tcp_transport_stat *stat);
+
 /**
  * Start the TCP listener, if the listener is not started yet. This is useful
  * to start the listener manually, if listener was not started when 
@@ -390,6 +390,17 @@ typedef struct pjsip_tls_setting
      */
     pj_bool_t enable_renegotiation;
 
+    /**
+     * Specify if record encryption and decryption of established TLS
+     * connections should be offloaded to the kernel (kTLS). Currently
+     * only available for OpenSSL backend on Linux, connections that
+     * cannot be offloaded keep using userspace TLS. See also
+     * \a enable_ktls in #pj_ssl_sock_param.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t enable_ktls;
+
     /**
      * Callback to be called when a accept operation of the TLS listener fails.
      *
@@ -2131,13 +2131,26 @@ typedef struct pjsua_config
 {
 
     /** 
-     * Maximum calls to support (default: 4). The value specified here
-     * must be smaller than or equal to the compile time maximum settings
-     * PJSUA_MAX_CALLS. To increase this limit, the library must be
-     * recompiled with new PJSUA_MAX_CALLS value.
+     * Maximum calls to support (default: PJSUA_MAX_CALLS). The call table
+     * is allocated with this many entries when #pjsua_init() is called,
+     * so the value may exceed PJSUA_MAX_CALLS without recompiling the
+     * library.
      */
     unsigned        max_calls;
 
+    /**
+     * Maximum accounts to support (default: PJSUA_MAX_ACC). Like
+     * \a max_calls, the account table is allocated with this many entries
+     * by #pjsua_init().
+     */
+    unsigned        max_acc;
+
+    /**
+     * Maximum buddies in the buddy list (default: PJSUA_MAX_BUDDIES). The
+     * buddy table is allocated with this many entries by #pjsua_init().
+     */
+    unsigned        max_buddies;
+
     /** 
      * Number of worker threads. Normally application will want to have at
      * least one worker thread, unless when it wants to poll the library
@@ -2432,6 +2445,18 @@ typedef struct pjsua_config
      */
     pj_bool_t        ignore_unexpected_invites;
 
+    /**
+     * Maximum number of REGISTER requests per second sent by all accounts
+     * together. Requests exceeding the rate, including automatic refreshes,
+     * are queued and sent in FIFO order, which avoids flooding the
+     * registrar when many accounts register at once (e.g. on startup or
+     * after a network change). Unregistrations are never delayed. See
+     * also \a reg_refresh_jitter in #pjsua_acc_config.
+     *
+     * Default: 0 (no limit)
+     */
+    unsigned         reg_max_rate;
+
 } pjsua_config;
 
 
@@ -3458,8 +3483,8 @@ PJ_DECL(pj_status_t) pjsua_transport_lis_start( pjsua_transport_id id,
  * header in outgoing requests.
  *
  * PJSUA-API supports creating and managing multiple accounts. The maximum
- * number of accounts is limited by a compile time constant
- * <tt>PJSUA_MAX_ACC</tt>.
+ * number of accounts is set by \a max_acc field of #pjsua_config, which
+ * defaults to <tt>PJSUA_MAX_ACC</tt>.
  *
  * Account may or may not have client registration associated with it.
  * An account is also associated with <b>route set</b> and some <b>authentication
@@ -3487,7 +3512,8 @@ PJ_DECL(pj_status_t) pjsua_transport_lis_start( pjsua_transport_id id,
  */
 
 /**
- * Maximum accounts.
+ * Default maximum accounts, used to initialize \a max_acc field of
+ * #pjsua_config.
  */
 #ifndef PJSUA_MAX_ACC
 #   define PJSUA_MAX_ACC            8
@@ -4072,6 +4098,16 @@ typedef struct pjsua_acc_config
      */
     unsigned        reg_delay_before_refresh;
 
+    /**
+     * Specify the maximum number of seconds to randomly refresh the client
+     * registration earlier than scheduled by \a reg_delay_before_refresh.
+     * This prevents accounts which registered at the same time from
+     * refreshing at the same time for as long as they stay registered.
+     *
+     * Default: 0 (no jitter)
+     */
+    unsigned        reg_refresh_jitter;
+
     /**
      * Specify the maximum time to wait for unregistration requests to
      * complete during library shutdown sequence.
@@ -5159,7 +5195,8 @@ PJ_DECL(pj_status_t) pjsua_acc_set_transport(pjsua_acc_id acc_id,
  */
 
 /**
- * Maximum simultaneous calls.
+ * Default maximum simultaneous calls, used to initialize \a max_calls
+ * field of #pjsua_config.
  */
 #ifndef PJSUA_MAX_CALLS
 #   define PJSUA_MAX_CALLS          4
@@ -6451,7 +6488,8 @@ pjsua_call_get_med_transport_info(pjsua_call_id call_id,
  */
 
 /**
- * Max buddies in buddy list.
+ * Default max buddies in buddy list, used to initialize \a max_buddies
+ * field of #pjsua_config.
  */
 #ifndef PJSUA_MAX_BUDDIES
 #   define PJSUA_MAX_BUDDIES        256
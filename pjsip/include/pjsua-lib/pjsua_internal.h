@@ -265,10 +265,14 @@ struct pjsua_srv_pres
 typedef struct pjsua_acc
 {
     pj_pool_t       *pool;          /**< Pool for this account.         */
+    pj_grp_lock_t   *grp_lock;      /**< Protects validity, regc and
+                                         registration/online status.    */
     pjsua_acc_config cfg;           /**< Account configuration.         */
     pj_bool_t        valid;         /**< Is this account valid?         */
 
     int              index;         /**< Index in accounts array.       */
+    pjsua_acc_id     hash_next;     /**< Next account in the same
+                                         user@domain hash bucket.       */
     pj_str_t         display;       /**< Display name, if any.          */
     pj_str_t         user_part;     /**< User part of local URI.        */
     pj_bool_t        is_sips;       /**< Local URI uses "sips"?         */
@@ -368,6 +372,8 @@ typedef struct pjsua_buddy
 {
     pj_pool_t           *pool;      /**< Pool for this buddy.           */
     unsigned             index;     /**< Buddy index.                   */
+    pjsua_buddy_id       hash_next; /**< Next buddy in the same hash
+                                         bucket.                        */
     void                *user_data; /**< Application data.              */
     pj_str_t             uri;       /**< Buddy URI.                     */
     pj_str_t             contact;   /**< Contact learned from subscrp.  */
@@ -524,18 +530,32 @@ struct pjsua_data
     /* Account: */
     unsigned             acc_cnt;            /**< Number of accounts.   */
     pjsua_acc_id         default_acc;        /**< Default account ID    */
-    pjsua_acc            acc[PJSUA_MAX_ACC]; /**< Account array.        */
-    pjsua_acc_id         acc_ids[PJSUA_MAX_ACC]; /**< Acc sorted by prio*/
+    pjsua_acc           *acc;                /**< Account array, sized
+                                                  by ua_cfg.max_acc.    */
+    pjsua_acc_id        *acc_ids;            /**< Acc sorted by prio    */
+    pjsua_acc_id        *acc_hash;           /**< Acc by user@domain.   */
+    unsigned             acc_hash_size;      /**< Buckets in acc_hash.  */
+    pjsip_regc_pacer    *reg_pacer;          /**< REGISTER rate limiter,
+                                                  if reg_max_rate is set*/
 
     /* Calls: */
     pjsua_config         ua_cfg;                /**< UA config.         */
     unsigned             call_cnt;              /**< Call counter.      */
-    pjsua_call           calls[PJSUA_MAX_CALLS];/**< Calls array.       */
+    pjsua_call          *calls;                 /**< Calls array, sized
+                                                     by ua_cfg.max_calls*/
+    pj_grp_lock_t      **call_grp_lock;         /**< Per slot lock which
+                                                     protects the slot's
+                                                     inv and async dialog.
+                                                     Kept outside calls[]
+                                                     so reset_call() may
+                                                     clear the slot.    */
     pjsua_call_id        next_call_id;          /**< Next call id to use*/
 
     /* Buddy; */
     unsigned             buddy_cnt;                 /**< Buddy count.   */
-    pjsua_buddy          buddy[PJSUA_MAX_BUDDIES];  /**< Buddy array.   */
+    pjsua_buddy         *buddy;                     /**< Buddy array.   */
+    pjsua_buddy_id      *buddy_hash;                /**< Buddy by URI.  */
+    unsigned             buddy_hash_size;           /**< Hash buckets.  */
 
     /* Presence: */
     pj_timer_entry       pres_timer;/**< Presence refresh timer.        */
@@ -639,6 +659,12 @@ PJ_INLINE(pjsua_im_data*) pjsua_im_data_dup(pj_pool_t *pool,
 }
 
 
+/*
+ * Lock ordering: dialog lock, then PJSUA_LOCK(), then the call or account
+ * group lock. The call and account group locks come last: apart from
+ * try-locks and the registration session's own lock, nothing else may be
+ * acquired while holding them.
+ */
 #if 1
 
 PJ_INLINE(void) PJSUA_LOCK()
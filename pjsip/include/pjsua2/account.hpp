@@ -161,6 +161,15 @@ struct AccountRegConfig : public PersistentObject
      */
     unsigned            delayBeforeRefreshSec;
 
+    /**
+     * Specify the maximum number of seconds to randomly refresh the client
+     * registration earlier than scheduled, so that accounts which
+     * registered together don't keep refreshing together.
+     *
+     * Default: 0 (no jitter)
+     */
+    unsigned            refreshJitterSec;
+
     /**
      * Specify whether calls of the configured account should be dropped
      * after registration failure and an attempt of re-registration has
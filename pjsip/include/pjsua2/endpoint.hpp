@@ -637,14 +637,22 @@ struct OnCredAuthParam
 struct UaConfig : public PersistentObject
 {
     /**
-     * Maximum calls to support (default: 4). The value specified here
-     * must be smaller than the compile time maximum settings
-     * PJSUA_MAX_CALLS, which by default is 32. To increase this
-     * limit, the library must be recompiled with new PJSUA_MAX_CALLS
-     * value.
+     * Maximum calls to support (default: PJSUA_MAX_CALLS). The call
+     * table is allocated with this many entries when the library is
+     * initialized.
      */
     unsigned            maxCalls;
 
+    /**
+     * Maximum accounts to support (default: PJSUA_MAX_ACC).
+     */
+    unsigned            maxAccounts;
+
+    /**
+     * Maximum buddies to support (default: PJSUA_MAX_BUDDIES).
+     */
+    unsigned            maxBuddies;
+
     /**
      * Number of worker threads. Normally application will want to have at
      * least one worker thread, unless when it wants to poll the library
@@ -787,6 +795,15 @@ struct UaConfig : public PersistentObject
      */
     bool                ignoreUnexpectedInvites;
 
+    /**
+     * Maximum number of REGISTER requests per second sent by all accounts
+     * together. Requests exceeding the rate are queued and sent in FIFO
+     * order. Unregistrations are never delayed.
+     *
+     * Default: 0 (no limit)
+     */
+    unsigned            regMaxRate;
+
 public:
     /**
      * Default constructor to initialize with default values.
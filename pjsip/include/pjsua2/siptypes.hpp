@@ -288,6 +288,15 @@ struct TlsConfig : public PersistentObject
      */
     bool                enableRenegotiation;
 
+    /**
+     * Specify if TLS records should be offloaded to the kernel (kTLS)
+     * after the handshake. Currently only available for OpenSSL backend
+     * on Linux.
+     *
+     * Default: PJ_FALSE
+     */
+    bool                enableKtls;
+
 public:
     /** Default constructor initialises with default values */
     TlsConfig();
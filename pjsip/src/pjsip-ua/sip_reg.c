@@ -36,6 +36,7 @@
 
 
 #define REFRESH_TIMER           1
+#define SEND_TIMER              2
 #define DELAY_BEFORE_REFRESH    PJSIP_REGISTER_CLIENT_DELAY_BEFORE_REFRESH
 #define THIS_FILE               "sip_reg.c"
 
@@ -57,6 +58,20 @@ enum regc_op
     REGC_UNREGISTERING
 };
 
+/**
+ * Registration pacer, shared by client registrations to spread their
+ * REGISTER requests to at most "rate" requests per second. Time slots are
+ * handed out in FIFO order, so requests are sent in the order they were
+ * submitted to pjsip_regc_send().
+ */
+struct pjsip_regc_pacer
+{
+    pj_lock_t                   *lock;
+    unsigned                     rate;
+    pj_uint64_t                  next_usec;
+    unsigned                     backlog;
+};
+
 /**
  * SIP client registration structure.
  */
@@ -89,6 +104,7 @@ struct pjsip_regc
     pj_uint32_t                  expires;
     pj_uint32_t                  expires_requested;
     pj_uint32_t                  delay_before_refresh;
+    pj_uint32_t                  refresh_jitter;
     pjsip_route_hdr              route_set;
     pjsip_hdr                    hdr_list;
     pjsip_host_port              via_addr;
@@ -103,6 +119,11 @@ struct pjsip_regc
     pj_time_val                  next_reg;
     pj_timer_entry               timer;
 
+    /* Request waiting for its turn in the pacer. */
+    pjsip_regc_pacer            *pacer;
+    pjsip_tx_data               *pending_tdata;
+    pj_timer_entry               send_timer;
+
     /* Transport selector */
     pjsip_tpselector             tp_sel;
 
@@ -118,6 +139,11 @@ struct pjsip_regc
 };
 
 
+static void cancel_pending_send(pjsip_regc *regc);
+static pj_status_t regc_send(pjsip_regc *regc, pjsip_tx_data *tdata,
+                             pj_bool_t paced);
+
+
 PJ_DEF(pj_status_t) pjsip_regc_create( pjsip_endpoint *endpt, void *token,
                                        pjsip_regc_cb *cb,
                                        pjsip_regc **p_regc)
@@ -184,6 +210,9 @@ PJ_DEF(pj_status_t) pjsip_regc_destroy2(pjsip_regc *regc, pj_bool_t force)
         return PJ_EBUSY;
     }
 
+    /* Drop request still waiting in the pacer */
+    cancel_pending_send(regc);
+
     if (regc->has_tsx || pj_atomic_get(regc->busy_ctr) != 0) {
         regc->_delete_flag = 1;
         regc->cb = NULL;
@@ -220,7 +249,8 @@ PJ_DEF(pj_status_t) pjsip_regc_get_info( pjsip_regc *regc,
 
     info->server_uri = regc->str_srv_url;
     info->client_uri = regc->from_uri;
-    info->is_busy = (pj_atomic_get(regc->busy_ctr) || regc->has_tsx);
+    info->is_busy = (pj_atomic_get(regc->busy_ctr) || regc->has_tsx ||
+                     regc->pending_tdata);
     info->auto_reg = regc->auto_reg;
     info->interval = regc->expires;
     info->transport = regc->has_tsx? regc->info_transport :
@@ -862,6 +892,11 @@ static void schedule_registration ( pjsip_regc *regc, pj_uint32_t expiration )
         {
             delay.sec = regc->expires;
         }
+        /* Refresh somewhat earlier at random, so that registrations which
+         * were created together don't stay in lockstep.
+         */
+        if (regc->refresh_jitter)
+            delay.sec -= (pj_rand() & 0x7FFFFFFF) % (regc->refresh_jitter+1);
         if (delay.sec < DELAY_BEFORE_REFRESH) 
             delay.sec = DELAY_BEFORE_REFRESH;
         regc->timer.cb = &regc_refresh_timer_cb;
@@ -931,6 +966,155 @@ pjsip_regc_set_delay_before_refresh( pjsip_regc *regc,
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pjsip_regc_set_refresh_jitter(pjsip_regc *regc,
+                                                  pj_uint32_t jitter)
+{
+    PJ_ASSERT_RETURN(regc, PJ_EINVAL);
+
+    pj_lock_acquire(regc->lock);
+    regc->refresh_jitter = jitter;
+    pj_lock_release(regc->lock);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_pacer_create(pj_pool_t *pool,
+                                            unsigned rate,
+                                            pjsip_regc_pacer **p_pacer)
+{
+    pjsip_regc_pacer *pacer;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && rate && p_pacer, PJ_EINVAL);
+
+    pacer = PJ_POOL_ZALLOC_T(pool, pjsip_regc_pacer);
+    pacer->rate = rate;
+
+    status = pj_lock_create_simple_mutex(pool, "regcpacer", &pacer->lock);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    *p_pacer = pacer;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_pacer_destroy(pjsip_regc_pacer *pacer)
+{
+    PJ_ASSERT_RETURN(pacer, PJ_EINVAL);
+
+    if (pacer->lock) {
+        pj_lock_destroy(pacer->lock);
+        pacer->lock = NULL;
+    }
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(unsigned) pjsip_regc_pacer_get_backlog(pjsip_regc_pacer *pacer)
+{
+    unsigned backlog;
+
+    PJ_ASSERT_RETURN(pacer, 0);
+
+    pj_lock_acquire(pacer->lock);
+    backlog = pacer->backlog;
+    pj_lock_release(pacer->lock);
+
+    return backlog;
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_set_pacer(pjsip_regc *regc,
+                                         pjsip_regc_pacer *pacer)
+{
+    PJ_ASSERT_RETURN(regc, PJ_EINVAL);
+
+    pj_lock_acquire(regc->lock);
+    if (pacer != regc->pacer)
+        cancel_pending_send(regc);
+    regc->pacer = pacer;
+    pj_lock_release(regc->lock);
+
+    return PJ_SUCCESS;
+}
+
+/* Reserve the next free time slot of the pacer, and return the time to
+ * wait until the slot, in msec. A non-zero delay puts the request in the
+ * backlog until pacer_done() is called.
+ */
+static unsigned pacer_reserve(pjsip_regc_pacer *pacer)
+{
+    pj_time_val now;
+    pj_uint64_t now_usec, delay_usec;
+
+    pj_gettickcount(&now);
+    now_usec = (pj_uint64_t)now.sec * 1000000 + now.msec * 1000;
+
+    pj_lock_acquire(pacer->lock);
+    if (pacer->next_usec < now_usec)
+        pacer->next_usec = now_usec;
+    delay_usec = pacer->next_usec - now_usec;
+    pacer->next_usec += 1000000 / pacer->rate;
+    if (delay_usec >= 1000)
+        ++pacer->backlog;
+    pj_lock_release(pacer->lock);
+
+    return (unsigned)(delay_usec / 1000);
+}
+
+static void pacer_done(pjsip_regc_pacer *pacer)
+{
+    pj_lock_acquire(pacer->lock);
+    pj_assert(pacer->backlog > 0);
+    --pacer->backlog;
+    pj_lock_release(pacer->lock);
+}
+
+/* Must be called with regc lock held. */
+static void cancel_pending_send(pjsip_regc *regc)
+{
+    if (regc->send_timer.id != 0) {
+        pjsip_endpt_cancel_timer(regc->endpt, &regc->send_timer);
+        regc->send_timer.id = 0;
+    }
+    if (regc->pending_tdata) {
+        pjsip_tx_data_dec_ref(regc->pending_tdata);
+        regc->pending_tdata = NULL;
+        pacer_done(regc->pacer);
+    }
+}
+
+static void regc_send_timer_cb(pj_timer_heap_t *timer_heap,
+                               struct pj_timer_entry *entry)
+{
+    pjsip_regc *regc = (pjsip_regc*) entry->user_data;
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    pjsip_regc_add_ref(regc);
+
+    pj_lock_acquire(regc->lock);
+    entry->id = 0;
+    tdata = regc->pending_tdata;
+    regc->pending_tdata = NULL;
+    if (tdata)
+        pacer_done(regc->pacer);
+    pj_lock_release(regc->lock);
+
+    if (tdata) {
+        status = regc_send(regc, tdata, PJ_FALSE);
+        if (status != PJ_SUCCESS && regc->cb) {
+            char errmsg[PJ_ERR_MSG_SIZE];
+            pj_str_t reason = pj_strerror(status, errmsg, sizeof(errmsg));
+            call_callback(regc, status, 400, &reason, NULL, NOEXP, 0, NULL,
+                          PJ_FALSE);
+        }
+    }
+
+    /* Delete the record if user destroy regc during the callback. */
+    pjsip_regc_dec_ref(regc);
+}
+
 
 static pj_uint32_t calculate_response_expiration(const pjsip_regc *regc,
                                                  const pjsip_rx_data *rdata,
@@ -1236,7 +1420,7 @@ static void regc_tsx_callback(void *token, pjsip_event *event)
              * incremented.
              */
             pj_lock_release(regc->lock);
-            status = pjsip_regc_send(regc, tdata);
+            status = regc_send(regc, tdata, PJ_FALSE);
             pj_lock_acquire(regc->lock);
         }
         
@@ -1433,6 +1617,19 @@ handle_err:
 }
 
 PJ_DEF(pj_status_t) pjsip_regc_send(pjsip_regc *regc, pjsip_tx_data *tdata)
+{
+    PJ_ASSERT_RETURN(regc && tdata, PJ_EINVAL);
+
+    return regc_send(regc, tdata, PJ_TRUE);
+}
+
+/* Send the request. When "paced" is set and regc is attached to a pacer,
+ * a REGISTER may be queued in the pacer instead, to be sent later by
+ * regc_send_timer_cb(). Requests which complete a transaction already
+ * admitted by the pacer (authentication retry) are not paced again.
+ */
+static pj_status_t regc_send(pjsip_regc *regc, pjsip_tx_data *tdata,
+                             pj_bool_t paced)
 {
     pj_status_t status;
     pjsip_cseq_hdr *cseq_hdr;
@@ -1452,6 +1649,62 @@ PJ_DEF(pj_status_t) pjsip_regc_send(pjsip_regc *regc, pjsip_tx_data *tdata)
         return PJSIP_EBUSY;
     }
 
+    /* Find Expires header */
+    expires_hdr = (pjsip_expires_hdr*)
+                  pjsip_msg_find_hdr(tdata->msg, PJSIP_H_EXPIRES, NULL);
+
+    /* Only REGISTER is paced, unregistration is sent right away */
+    if (expires_hdr && expires_hdr->ivalue==0)
+        paced = PJ_FALSE;
+
+    /* A newer request supersedes the one waiting in the pacer */
+    if (regc->pending_tdata) {
+        if (paced && regc->pacer) {
+            pjsip_tx_data_dec_ref(regc->pending_tdata);
+            regc->pending_tdata = NULL;
+        } else {
+            cancel_pending_send(regc);
+        }
+    }
+
+    if (paced && regc->pacer) {
+        unsigned delay_msec = 0;
+
+        /* Reuse the slot already reserved by the superseded request */
+        if (regc->send_timer.id == 0)
+            delay_msec = pacer_reserve(regc->pacer);
+
+        if (regc->send_timer.id != 0 || delay_msec != 0) {
+            regc->pending_tdata = tdata;
+
+            if (regc->send_timer.id == 0) {
+                pj_time_val delay;
+
+                delay.sec = delay_msec / 1000;
+                delay.msec = delay_msec % 1000;
+                pj_timer_entry_init(&regc->send_timer, SEND_TIMER, regc,
+                                    &regc_send_timer_cb);
+                status = pjsip_endpt_schedule_timer(regc->endpt,
+                                                    &regc->send_timer,
+                                                    &delay);
+                if (status != PJ_SUCCESS) {
+                    regc->send_timer.id = 0;
+                    cancel_pending_send(regc);
+                    pj_lock_release(regc->lock);
+                    pjsip_regc_dec_ref(regc);
+                    return status;
+                }
+            }
+
+            PJ_LOG(5,(THIS_FILE, "%s queued in pacer for %u ms",
+                      pjsip_tx_data_get_info(tdata), delay_msec));
+
+            pj_lock_release(regc->lock);
+            pjsip_regc_dec_ref(regc);
+            return PJ_SUCCESS;
+        }
+    }
+
     /* Just regc->has_tsx check above should be enough. This assertion check
      * may cause problem, e.g: when regc_tsx_callback() invokes callback,
      * lock is released and 'has_tsx' is set to FALSE and 'current_op' has
@@ -1468,10 +1721,6 @@ PJ_DEF(pj_status_t) pjsip_regc_send(pjsip_regc *regc, pjsip_tx_data *tdata)
                pjsip_msg_find_hdr(tdata->msg, PJSIP_H_CSEQ, NULL);
     cseq_hdr->cseq = cseq;
 
-    /* Find Expires header */
-    expires_hdr = (pjsip_expires_hdr*)
-                  pjsip_msg_find_hdr(tdata->msg, PJSIP_H_EXPIRES, NULL);
-
     /* Bind to transport selector */
     pjsip_tx_data_set_transport(tdata, &regc->tp_sel);
 
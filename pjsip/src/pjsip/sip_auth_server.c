@@ -22,8 +22,51 @@
 #include <pjsip/sip_auth_msg.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_transport.h>
-#include <pj/string.h>
+#include <pjlib-util/md5.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/hash.h>
+#include <pj/lock.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+
+/* Longest account name to be cached. */
+#define CACHE_MAX_NAME_LEN      64
+
+/* Cached HA1 of an account. */
+typedef struct ha1_entry
+{
+    PJ_DECL_LIST_MEMBER(struct ha1_entry);
+    pj_hash_entry_buf    hbuf;
+    pj_str_t             acc_name;
+    char                 name_buf[CACHE_MAX_NAME_LEN];
+    char                 ha1[PJSIP_MD5STRLEN];
+    pj_time_val          expire;
+} ha1_entry;
+
+/* HA1 cache of server authorization session. Entries are kept in
+ * insertion order, so the oldest entry is at the head of the list.
+ */
+struct pjsip_auth_srv_cache
+{
+    pj_pool_t           *pool;
+    pj_lock_t           *lock;
+    pj_hash_table_t     *ht;
+    ha1_entry            used_list;
+    ha1_entry            free_list;
+    unsigned             count;
+};
+
+/* Pending asynchronous credential lookup. */
+struct pjsip_auth_lookup_op
+{
+    pjsip_auth_srv              *auth_srv;
+    pjsip_rx_data               *rdata;
+    void                        *token;
+    pjsip_auth_srv_verify_cb    *cb;
+};
 
 
 /*
@@ -62,7 +105,188 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_init2(
     pj_bzero(auth_srv, sizeof(*auth_srv));
     pj_strdup( pool, &auth_srv->realm, param->realm);
     auth_srv->lookup2 = param->lookup2;
+    auth_srv->lookup_async = param->lookup_async;
     auth_srv->is_proxy = (param->options & PJSIP_AUTH_SRV_IS_PROXY);
+    auth_srv->cache_ttl = param->cache_ttl;
+
+    if (auth_srv->cache_ttl) {
+        struct pjsip_auth_srv_cache *cache;
+        pj_status_t status;
+
+        cache = PJ_POOL_ZALLOC_T(pool, struct pjsip_auth_srv_cache);
+        cache->pool = pool;
+        cache->ht = pj_hash_create(pool, PJSIP_AUTH_SRV_CACHE_MAX_SIZE);
+        pj_list_init(&cache->used_list);
+        pj_list_init(&cache->free_list);
+
+        status = pj_lock_create_simple_mutex(pool, "authsrv", &cache->lock);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        auth_srv->cache = cache;
+    }
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * Deinitialize server authorization session.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_deinit(pjsip_auth_srv *auth_srv)
+{
+    PJ_ASSERT_RETURN(auth_srv, PJ_EINVAL);
+
+    if (auth_srv->cache) {
+        pj_lock_destroy(auth_srv->cache->lock);
+        auth_srv->cache = NULL;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/* Remove entry from the cache. Cache lock must be held. */
+static void cache_remove(struct pjsip_auth_srv_cache *cache, ha1_entry *e)
+{
+    pj_hash_set(NULL, cache->ht, e->acc_name.ptr, (unsigned)e->acc_name.slen,
+                0, NULL);
+    pj_list_erase(e);
+    pj_list_push_back(&cache->free_list, e);
+    --cache->count;
+}
+
+/* Find the HA1 of the account in the cache. */
+static pj_bool_t cache_get(pjsip_auth_srv *auth_srv,
+                           const pj_str_t *acc_name,
+                           char ha1[PJSIP_MD5STRLEN])
+{
+    struct pjsip_auth_srv_cache *cache = auth_srv->cache;
+    ha1_entry *e;
+    pj_time_val now;
+    pj_bool_t found = PJ_FALSE;
+
+    pj_gettickcount(&now);
+
+    pj_lock_acquire(cache->lock);
+    e = (ha1_entry*) pj_hash_get(cache->ht, acc_name->ptr,
+                                 (unsigned)acc_name->slen, NULL);
+    if (e) {
+        if (PJ_TIME_VAL_GT(e->expire, now)) {
+            pj_memcpy(ha1, e->ha1, PJSIP_MD5STRLEN);
+            found = PJ_TRUE;
+        } else {
+            cache_remove(cache, e);
+        }
+    }
+    pj_lock_release(cache->lock);
+
+    return found;
+}
+
+/* Add the HA1 of the credential to the cache. */
+static void cache_put(pjsip_auth_srv *auth_srv,
+                      const pjsip_cred_info *cred_info)
+{
+    struct pjsip_auth_srv_cache *cache = auth_srv->cache;
+    char ha1[PJSIP_MD5STRLEN];
+    ha1_entry *e;
+
+    /* Only cache simple credentials for our realm, so that cached entries
+     * can be verified against the realm in the request.
+     */
+    if (cred_info->username.slen > CACHE_MAX_NAME_LEN ||
+        pj_strcmp(&cred_info->realm, &auth_srv->realm) != 0)
+    {
+        return;
+    }
+
+    if (cred_info->data_type == PJSIP_CRED_DATA_PLAIN_PASSWD) {
+        pj_md5_context pms;
+        pj_uint8_t digest[16];
+        unsigned i;
+
+        /* ha1 = MD5(username ":" realm ":" password) */
+        pj_md5_init(&pms);
+        pj_md5_update(&pms, (const pj_uint8_t*)cred_info->username.ptr,
+                      (unsigned)cred_info->username.slen);
+        pj_md5_update(&pms, (const pj_uint8_t*)":", 1);
+        pj_md5_update(&pms, (const pj_uint8_t*)cred_info->realm.ptr,
+                      (unsigned)cred_info->realm.slen);
+        pj_md5_update(&pms, (const pj_uint8_t*)":", 1);
+        pj_md5_update(&pms, (const pj_uint8_t*)cred_info->data.ptr,
+                      (unsigned)cred_info->data.slen);
+        pj_md5_final(&pms, digest);
+
+        for (i=0; i<16; ++i)
+            pj_val_to_hex_digit(digest[i], &ha1[i*2]);
+
+    } else if (cred_info->data_type == PJSIP_CRED_DATA_DIGEST &&
+               cred_info->data.slen == PJSIP_MD5STRLEN)
+    {
+        pj_memcpy(ha1, cred_info->data.ptr, PJSIP_MD5STRLEN);
+
+    } else {
+        return;
+    }
+
+    pj_lock_acquire(cache->lock);
+
+    e = (ha1_entry*) pj_hash_get(cache->ht, cred_info->username.ptr,
+                                 (unsigned)cred_info->username.slen, NULL);
+    if (e) {
+        cache_remove(cache, e);
+    } else if (cache->count >= PJSIP_AUTH_SRV_CACHE_MAX_SIZE) {
+        cache_remove(cache, cache->used_list.next);
+    }
+
+    if (!pj_list_empty(&cache->free_list)) {
+        e = cache->free_list.next;
+        pj_list_erase(e);
+    } else {
+        e = PJ_POOL_ZALLOC_T(cache->pool, ha1_entry);
+    }
+
+    pj_memcpy(e->name_buf, cred_info->username.ptr, cred_info->username.slen);
+    pj_strset(&e->acc_name, e->name_buf, cred_info->username.slen);
+    pj_memcpy(e->ha1, ha1, PJSIP_MD5STRLEN);
+    pj_gettickcount(&e->expire);
+    e->expire.sec += auth_srv->cache_ttl;
+
+    pj_hash_set_np(cache->ht, e->acc_name.ptr, (unsigned)e->acc_name.slen, 0,
+                   e->hbuf, e);
+    pj_list_push_back(&cache->used_list, e);
+    ++cache->count;
+
+    pj_lock_release(cache->lock);
+}
+
+/*
+ * Remove cached HA1 entries.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_flush_cache(pjsip_auth_srv *auth_srv,
+                                               const pj_str_t *acc_name)
+{
+    struct pjsip_auth_srv_cache *cache;
+
+    PJ_ASSERT_RETURN(auth_srv, PJ_EINVAL);
+
+    cache = auth_srv->cache;
+    if (!cache)
+        return PJ_SUCCESS;
+
+    pj_lock_acquire(cache->lock);
+    if (acc_name) {
+        ha1_entry *e;
+
+        e = (ha1_entry*) pj_hash_get(cache->ht, acc_name->ptr,
+                                     (unsigned)acc_name->slen, NULL);
+        if (e)
+            cache_remove(cache, e);
+    } else {
+        while (!pj_list_empty(&cache->used_list))
+            cache_remove(cache, cache->used_list.next);
+    }
+    pj_lock_release(cache->lock);
 
     return PJ_SUCCESS;
 }
@@ -119,30 +343,18 @@ static pj_status_t pjsip_auth_verify( const pjsip_authorization_hdr *hdr,
 }
 
 
-/*
- * Request the authorization server framework to verify the authorization 
- * information in the specified request in rdata.
- */
-PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
-                                           pjsip_rx_data *rdata,
-                                           int *status_code)
+/* Find the Authorization/Proxy-Authorization header for our realm. */
+static pj_status_t find_auth_hdr(pjsip_auth_srv *auth_srv,
+                                 pjsip_msg *msg,
+                                 pjsip_authorization_hdr **p_h_auth,
+                                 int *status_code)
 {
     pjsip_authorization_hdr *h_auth;
-    pjsip_msg *msg = rdata->msg_info.msg;
     pjsip_hdr_e htype;
-    pj_str_t acc_name;
-    pjsip_cred_info cred_info;
-    pj_status_t status;
-
-    PJ_ASSERT_RETURN(auth_srv && rdata, PJ_EINVAL);
-    PJ_ASSERT_RETURN(msg->type == PJSIP_REQUEST_MSG, PJSIP_ENOTREQUESTMSG);
 
     htype = auth_srv->is_proxy ? PJSIP_H_PROXY_AUTHORIZATION : 
                                  PJSIP_H_AUTHORIZATION;
 
-    /* Initialize status with 200. */
-    *status_code = 200;
-
     /* Find authorization header for our realm. */
     h_auth = (pjsip_authorization_hdr*) pjsip_msg_find_hdr(msg, htype, NULL);
     while (h_auth) {
@@ -164,13 +376,105 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
     }
 
     /* Check authorization scheme. */
-    if (pj_stricmp(&h_auth->scheme, &pjsip_DIGEST_STR) == 0)
-        acc_name = h_auth->credential.digest.username;
-    else {
+    if (pj_stricmp(&h_auth->scheme, &pjsip_DIGEST_STR) != 0) {
         *status_code = auth_srv->is_proxy ? 407 : 401;
         return PJSIP_EINVALIDAUTHSCHEME;
     }
 
+    *p_h_auth = h_auth;
+    return PJ_SUCCESS;
+}
+
+/* Verify the request against the cached HA1, if there is one. Only a
+ * successful verification is answered from the cache. Otherwise the entry
+ * is removed and the caller looks the credential up again, so that a
+ * changed password or a disabled account takes effect right away.
+ */
+static pj_bool_t verify_cached(pjsip_auth_srv *auth_srv,
+                               const pjsip_authorization_hdr *h_auth,
+                               const pjsip_msg *msg,
+                               pj_status_t *status,
+                               int *status_code)
+{
+    const pjsip_digest_credential *dig = &h_auth->credential.digest;
+    pjsip_cred_info cred_info;
+    char ha1[PJSIP_MD5STRLEN];
+
+    if (!auth_srv->cache || pj_strcmp(&dig->realm, &auth_srv->realm) != 0 ||
+        !cache_get(auth_srv, &dig->username, ha1))
+    {
+        return PJ_FALSE;
+    }
+
+    pj_bzero(&cred_info, sizeof(cred_info));
+    cred_info.realm = auth_srv->realm;
+    cred_info.username = dig->username;
+    cred_info.data_type = PJSIP_CRED_DATA_DIGEST;
+    pj_strset(&cred_info.data, ha1, PJSIP_MD5STRLEN);
+
+    if (pjsip_auth_verify(h_auth, &msg->line.req.method.name,
+                          &cred_info) != PJ_SUCCESS)
+    {
+        pjsip_auth_srv_flush_cache(auth_srv, &dig->username);
+        return PJ_FALSE;
+    }
+
+    *status = PJ_SUCCESS;
+    *status_code = 200;
+    return PJ_TRUE;
+}
+
+/* Verify the request against the credential returned by lookup. */
+static pj_status_t verify_cred(pjsip_auth_srv *auth_srv,
+                               const pjsip_authorization_hdr *h_auth,
+                               const pjsip_msg *msg,
+                               const pjsip_cred_info *cred_info,
+                               int *status_code)
+{
+    pj_status_t status;
+
+    /* Authenticate with the specified credential. */
+    status = pjsip_auth_verify(h_auth, &msg->line.req.method.name, 
+                               cred_info);
+    if (status == PJ_SUCCESS && auth_srv->cache)
+        cache_put(auth_srv, cred_info);
+    *status_code = (status == PJ_SUCCESS) ? 200 : PJSIP_SC_FORBIDDEN;
+    return status;
+}
+
+
+/*
+ * Request the authorization server framework to verify the authorization 
+ * information in the specified request in rdata.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
+                                           pjsip_rx_data *rdata,
+                                           int *status_code)
+{
+    pjsip_authorization_hdr *h_auth;
+    pjsip_msg *msg = rdata->msg_info.msg;
+    pj_str_t acc_name;
+    pjsip_cred_info cred_info;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(auth_srv && rdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(msg->type == PJSIP_REQUEST_MSG, PJSIP_ENOTREQUESTMSG);
+
+    /* Initialize status with 200. */
+    *status_code = 200;
+
+    status = find_auth_hdr(auth_srv, msg, &h_auth, status_code);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    acc_name = h_auth->credential.digest.username;
+
+    /* Try the cache first. */
+    if (verify_cached(auth_srv, h_auth, msg, &status, status_code))
+        return status;
+
+    PJ_ASSERT_RETURN(auth_srv->lookup || auth_srv->lookup2, PJ_EINVALIDOP);
+
     /* Find the credential information for the account. */
     if (auth_srv->lookup2) {
         pjsip_auth_lookup_cred_param param;
@@ -193,16 +497,113 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
         }
     }
 
-    /* Authenticate with the specified credential. */
-    status = pjsip_auth_verify(h_auth, &msg->line.req.method.name, 
-                               &cred_info);
+    return verify_cred(auth_srv, h_auth, msg, &cred_info, status_code);
+}
+
+
+/*
+ * Verify the request, suspending the verification for asynchronous
+ * credential lookup when needed.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_verify_async(pjsip_auth_srv *auth_srv,
+                                                pjsip_rx_data *rdata,
+                                                void *token,
+                                                pjsip_auth_srv_verify_cb *cb,
+                                                int *status_code)
+{
+    pjsip_authorization_hdr *h_auth;
+    pjsip_msg *msg = rdata->msg_info.msg;
+    pjsip_auth_lookup_cred_param param;
+    pjsip_auth_lookup_op *op;
+    pjsip_rx_data *cloned;
+    int code = 200;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(auth_srv && rdata && cb, PJ_EINVAL);
+    PJ_ASSERT_RETURN(msg->type == PJSIP_REQUEST_MSG, PJSIP_ENOTREQUESTMSG);
+
+    /* Without asynchronous lookup, this is just the usual verification. */
+    if (!auth_srv->lookup_async) {
+        status = pjsip_auth_srv_verify(auth_srv, rdata, &code);
+        goto on_return;
+    }
+
+    status = find_auth_hdr(auth_srv, msg, &h_auth, &code);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    if (verify_cached(auth_srv, h_auth, msg, &status, &code))
+        goto on_return;
+
+    /* Keep the request until the lookup completes. */
+    status = pjsip_rx_data_clone(rdata, 0, &cloned);
     if (status != PJ_SUCCESS) {
-        *status_code = PJSIP_SC_FORBIDDEN;
+        code = PJSIP_SC_INTERNAL_SERVER_ERROR;
+        goto on_return;
     }
+
+    op = PJ_POOL_ZALLOC_T(cloned->tp_info.pool, pjsip_auth_lookup_op);
+    op->auth_srv = auth_srv;
+    op->rdata = cloned;
+    op->token = token;
+    op->cb = cb;
+
+    pj_bzero(&param, sizeof(param));
+    param.realm = auth_srv->realm;
+    param.acc_name = h_auth->credential.digest.username;
+    param.rdata = cloned;
+
+    /* Note that op may have been completed and freed once this returns. */
+    status = (*auth_srv->lookup_async)(&param, op);
+    if (status != PJ_SUCCESS) {
+        pjsip_rx_data_free_cloned(cloned);
+        code = PJSIP_SC_FORBIDDEN;
+        goto on_return;
+    }
+
+    return PJ_EPENDING;
+
+on_return:
+    if (status_code)
+        *status_code = code;
     return status;
 }
 
 
+/*
+ * Complete asynchronous credential lookup.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_srv_lookup_complete(
+                                            pjsip_auth_lookup_op *op,
+                                            pj_status_t status,
+                                            const pjsip_cred_info *cred_info)
+{
+    pjsip_rx_data *rdata;
+    pjsip_authorization_hdr *h_auth = NULL;
+    int code = PJSIP_SC_FORBIDDEN;
+
+    PJ_ASSERT_RETURN(op && (status != PJ_SUCCESS || cred_info), PJ_EINVAL);
+
+    rdata = op->rdata;
+
+    if (status == PJ_SUCCESS) {
+        status = find_auth_hdr(op->auth_srv, rdata->msg_info.msg, &h_auth,
+                               &code);
+    }
+    if (status == PJ_SUCCESS) {
+        status = verify_cred(op->auth_srv, h_auth, rdata->msg_info.msg,
+                             cred_info, &code);
+    }
+
+    (*op->cb)(rdata, status, code, op->token);
+
+    /* This also releases op */
+    pjsip_rx_data_free_cloned(rdata);
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Add authentication challenge headers to the outgoing response in tdata. 
  * Application may specify its customized nonce and opaque for the challenge, 
@@ -58,7 +58,8 @@ pjsip_cfg_t pjsip_sip_cfg_var =
 
     /* TCP transport settings */
     {
-        PJSIP_TCP_KEEP_ALIVE_INTERVAL
+        PJSIP_TCP_KEEP_ALIVE_INTERVAL,
+        PJSIP_TCP_COALESCE_DELAY
     },
 
     /* TLS transport settings */
@@ -72,6 +73,8 @@ PJ_DEF(void) pjsip_dump_config(void)
     PJ_LOG(3, (id, "Dumping PJSIP configurations:"));
     PJ_LOG(3, (id, " PJSIP_MAX_DIALOG_COUNT                             : %d", 
                PJSIP_MAX_DIALOG_COUNT));
+    PJ_LOG(3, (id, " PJSIP_UA_DLG_TABLE_SHARDS                          : %d", 
+               PJSIP_UA_DLG_TABLE_SHARDS));
     PJ_LOG(3, (id, " PJSIP_MAX_TRANSPORTS                               : %d", 
                PJSIP_MAX_TRANSPORTS));
     PJ_LOG(3, (id, " PJSIP_TPMGR_HTABLE_SIZE                            : %d", 
@@ -118,6 +121,10 @@ PJ_DEF(void) pjsip_dump_config(void)
                PJSIP_TLS_TRANSPORT_DONT_CREATE_LISTENER));
     PJ_LOG(3, (id, " PJSIP_TCP_KEEP_ALIVE_INTERVAL                      : %d", 
                PJSIP_TCP_KEEP_ALIVE_INTERVAL));
+    PJ_LOG(3, (id, " PJSIP_TCP_COALESCE_DELAY                           : %d", 
+               PJSIP_TCP_COALESCE_DELAY));
+    PJ_LOG(3, (id, " PJSIP_TCP_COALESCE_MAX_SIZE                        : %d", 
+               PJSIP_TCP_COALESCE_MAX_SIZE));
     PJ_LOG(3, (id, " PJSIP_POOL_INC_TRANSPORT                           : %d", 
                PJSIP_POOL_INC_TRANSPORT));
     PJ_LOG(3, (id, " PJSIP_POOL_LEN_TDATA                               : %d", 
@@ -254,6 +261,8 @@ PJ_DEF(void) pjsip_dump_config(void)
                pjsip_cfg()->regc.add_xuid_param));
     PJ_LOG(3, (id, " pjsip_cfg()->tcp.keep_alive_interval               : %ld", 
                pjsip_cfg()->tcp.keep_alive_interval));
+    PJ_LOG(3, (id, " pjsip_cfg()->tcp.coalesce_delay                    : %u", 
+               pjsip_cfg()->tcp.coalesce_delay));
     PJ_LOG(3, (id, " pjsip_cfg()->tls.keep_alive_interval               : %ld", 
                pjsip_cfg()->tls.keep_alive_interval));
 }
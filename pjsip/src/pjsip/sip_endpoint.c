@@ -527,6 +527,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
                       "Error creating resolver instance"));
         goto on_error;
     }
+    pjsip_resolver_set_timer_heap(endpt->resolver, endpt->timer_heap);
 
     /* Initialize request headers. */
     pj_list_init(&endpt->req_hdr);
@@ -833,42 +833,21 @@ PJ_DEF(pjsip_msg *) pjsip_parse_rdata( char *buf, pj_size_t size,
     return rdata->msg_info.msg;
 }
 
-/* Determine if a message has been received. */
-PJ_DEF(pj_status_t) pjsip_find_msg( const char *buf, pj_size_t size, 
-                                  pj_bool_t is_datagram, pj_size_t *msg_size)
-{
 #if PJ_HAS_TCP
-    const char *volatile hdr_end;
-    const char *volatile body_start;
-    const char *pos;
+/* Get the message size from the Content-Length header, hdr_end points to
+ * the empty line ending the header area.
+ */
+static pj_status_t get_msg_size(const char *buf, const char *hdr_end,
+                                pj_size_t *msg_size)
+{
+    const char *body_start = hdr_end+2;
     const char *volatile line;
     int content_length = -1;
     pj_str_t cur_msg;
     pj_status_t status = PJSIP_EMISSINGHDR;
-    const pj_str_t end_hdr = { "\n\r\n", 3};
-
-    *msg_size = size;
-
-    /* For datagram, the whole datagram IS the message. */
-    if (is_datagram) {
-        return PJ_SUCCESS;
-    }
-
-
-    /* Find the end of header area by finding an empty line. 
-     * Don't use plain strstr() since we want to be able to handle
-     * NULL character in the message
-     */
-    cur_msg.ptr = (char*)buf; cur_msg.slen = size;
-    pos = pj_strstr(&cur_msg, &end_hdr);
-    if (pos == NULL) {
-        return PJSIP_EPARTIALMSG;
-    }
- 
-    hdr_end = pos+1;
-    body_start = pos+3;
 
     /* Find "Content-Length" header the hard way. */
+    cur_msg.ptr = (char*)buf; cur_msg.slen = body_start - buf;
     line = pj_strchr(&cur_msg, '\n');
     while (line && line < hdr_end) {
         ++line;
@@ -940,8 +919,46 @@ PJ_DEF(pj_status_t) pjsip_find_msg( const char *buf, pj_size_t size,
         return status;
     }
 
-    /* Enough packet received? */
     *msg_size = (body_start - buf) + content_length;
+    return PJ_SUCCESS;
+}
+#endif
+
+/* Determine if a message has been received. */
+PJ_DEF(pj_status_t) pjsip_find_msg( const char *buf, pj_size_t size, 
+                                  pj_bool_t is_datagram, pj_size_t *msg_size)
+{
+#if PJ_HAS_TCP
+    const char *pos;
+    pj_str_t cur_msg;
+    pj_status_t status;
+    const pj_str_t end_hdr = { "\n\r\n", 3};
+
+    *msg_size = size;
+
+    /* For datagram, the whole datagram IS the message. */
+    if (is_datagram) {
+        return PJ_SUCCESS;
+    }
+
+
+    /* Find the end of header area by finding an empty line. 
+     * Don't use plain strstr() since we want to be able to handle
+     * NULL character in the message
+     */
+    cur_msg.ptr = (char*)buf; cur_msg.slen = size;
+    pos = pj_strstr(&cur_msg, &end_hdr);
+    if (pos == NULL) {
+        return PJSIP_EPARTIALMSG;
+    }
+
+    status = get_msg_size(buf, pos+1, msg_size);
+    if (status != PJ_SUCCESS) {
+        *msg_size = size;
+        return status;
+    }
+
+    /* Enough packet received? */
     return (*msg_size) <= size ? PJ_SUCCESS : PJSIP_EPARTIALMSG;
 #else
     PJ_UNUSED_ARG(buf);
@@ -951,6 +968,66 @@ PJ_DEF(pj_status_t) pjsip_find_msg( const char *buf, pj_size_t size,
 #endif
 }
 
+/* Incremental version of pjsip_find_msg() for stream transports. */
+PJ_DEF(pj_status_t) pjsip_find_msg2( const char *buf, pj_size_t size,
+                                     pjsip_find_msg_state *state,
+                                     pj_size_t *msg_size)
+{
+#if PJ_HAS_TCP
+    const char *pos;
+    pj_str_t cur_msg;
+    pj_size_t offset;
+    pj_status_t status;
+    const pj_str_t end_hdr = { "\n\r\n", 3};
+
+    PJ_ASSERT_RETURN(buf && state && msg_size, PJ_EINVAL);
+
+    *msg_size = size;
+
+    /* Buffer is shorter than the one previously scanned, it must have
+     * been reset by the transport.
+     */
+    if (state->hdr_scanned > size)
+        pj_bzero(state, sizeof(*state));
+
+    /* Header area has been received, just wait for the whole body. */
+    if (state->msg_size) {
+        *msg_size = state->msg_size;
+        return (*msg_size) <= size ? PJ_SUCCESS : PJSIP_EPARTIALMSG;
+    }
+
+    /* Only search the new data, but include the last two bytes already
+     * searched as the empty line may straddle both.
+     */
+    offset = (state->hdr_scanned > 2) ? state->hdr_scanned - 2 : 0;
+    cur_msg.ptr = (char*)buf + offset; cur_msg.slen = size - offset;
+    pos = pj_strstr(&cur_msg, &end_hdr);
+    if (pos == NULL) {
+        state->hdr_scanned = size;
+        return PJSIP_EPARTIALMSG;
+    }
+
+    /* Keep the empty line position, so that when Content-Length is
+     * invalid only the header area is examined again on the next call.
+     */
+    state->hdr_scanned = pos - buf;
+
+    status = get_msg_size(buf, pos+1, &state->msg_size);
+    if (status != PJ_SUCCESS) {
+        state->msg_size = 0;
+        return status;
+    }
+
+    *msg_size = state->msg_size;
+    return (*msg_size) <= size ? PJ_SUCCESS : PJSIP_EPARTIALMSG;
+#else
+    PJ_UNUSED_ARG(buf);
+    PJ_UNUSED_ARG(state);
+    *msg_size = size;
+    return PJ_SUCCESS;
+#endif
+}
+
 /* Public function to parse URI */
 PJ_DEF(pjsip_uri*) pjsip_parse_uri( pj_pool_t *pool, 
                                          char *buf, pj_size_t size,
@@ -25,10 +25,12 @@
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/rand.h>
 #include <pj/string.h>
+#include <pj/timer.h>
 
 
 #define THIS_FILE   "sip_resolve.c"
@@ -44,6 +46,8 @@ struct naptr_target
 
 struct query
 {
+    PJ_DECL_LIST_MEMBER(struct query);  /* Dual queries of the resolver */
+
     char                    *objname;
 
     pj_dns_type              query_type;
@@ -65,6 +69,18 @@ struct query
 
     /* Query result */
     pjsip_server_addresses   server;
+
+    /* Dual A/AAAA resolution state, only used when the result may be
+     * reported before both queries complete (see start_dual_query()).
+     */
+    pjsip_resolver_t        *resolver;
+    pj_pool_t               *pool;
+    pj_grp_lock_t           *grp_lock;
+    pj_timer_heap_t         *timer_heap;
+    pj_timer_entry           timer;
+    pj_bool_t                a_pending;
+    pj_bool_t                aaaa_pending;
+    pj_bool_t                reported;
 };
 
 
@@ -72,6 +88,9 @@ struct pjsip_resolver_t
 {
     pj_dns_resolver *res;
     pjsip_ext_resolver *ext_res;
+    pj_timer_heap_t *timer_heap;
+    pj_lock_t *lock;                /* Protects dual_query_list */
+    struct query dual_query_list;   /* Dual A/AAAA resolutions  */
 };
 
 
@@ -84,6 +103,11 @@ static void dns_a_callback(void *user_data,
 static void dns_aaaa_callback(void *user_data,
                               pj_status_t status,
                               pj_dns_parsed_packet *response);
+static pj_status_t create_dual_query(pjsip_resolver_t *resolver,
+                                     pj_pool_t *pool,
+                                     struct query **p_query);
+static void start_dual_query(pjsip_resolver_t *resolver, struct query *query);
+static void release_dual_query(struct query *query);
 
 
 /*
@@ -93,9 +117,17 @@ PJ_DEF(pj_status_t) pjsip_resolver_create( pj_pool_t *pool,
                                            pjsip_resolver_t **p_res)
 {
     pjsip_resolver_t *resolver;
+    pj_status_t status;
 
     PJ_ASSERT_RETURN(pool && p_res, PJ_EINVAL);
     resolver = PJ_POOL_ZALLOC_T(pool, pjsip_resolver_t);
+    pj_list_init(&resolver->dual_query_list);
+
+    status = pj_lock_create_recursive_mutex(pool, "sipres%p",
+                                            &resolver->lock);
+    if (status != PJ_SUCCESS)
+        return status;
+
     *p_res = resolver;
 
     return PJ_SUCCESS;
@@ -140,6 +172,18 @@ PJ_DEF(pj_status_t) pjsip_resolver_set_ext_resolver(pjsip_resolver_t *res,
 }
 
 
+/*
+ * Public API to set the timer heap for the SIP resolver.
+ */
+PJ_DEF(pj_status_t) pjsip_resolver_set_timer_heap(pjsip_resolver_t *res,
+                                                  pj_timer_heap_t *timer_heap)
+{
+    PJ_ASSERT_RETURN(res, PJ_EINVAL);
+    res->timer_heap = timer_heap;
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Public API to get the internal DNS resolver.
  */
@@ -154,12 +198,32 @@ PJ_DEF(pj_dns_resolver*) pjsip_resolver_get_resolver(pjsip_resolver_t *res)
  */
 PJ_DEF(void) pjsip_resolver_destroy(pjsip_resolver_t *resolver)
 {
+    struct query *query;
+
+    /* Cancel dual A/AAAA resolutions that are still pending and release
+     * their state, since the DNS resolver below is destroyed without
+     * notifying its queries.
+     */
+    pj_lock_acquire(resolver->lock);
+    query = resolver->dual_query_list.next;
+    while (query != &resolver->dual_query_list) {
+        struct query *next = query->next;
+
+        /* This may destroy the query, removing it from the list */
+        release_dual_query(query);
+        query = next;
+    }
+    pj_lock_release(resolver->lock);
+
     if (resolver->res) {
 #if PJSIP_HAS_RESOLVER
         pj_dns_resolver_destroy(resolver->res, PJ_FALSE);
 #endif
         resolver->res = NULL;
     }
+
+    pj_lock_destroy(resolver->lock);
+    resolver->lock = NULL;
 }
 
 /*
@@ -388,8 +452,20 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
     /* Target is not an IP address so we need to resolve it. */
 #if PJSIP_HAS_RESOLVER
 
-    /* Build the query state */
-    query = PJ_POOL_ZALLOC_T(pool, struct query);
+    /* Build the query state. When both A and AAAA records of the host
+     * are queried, the result may be reported before the slower query
+     * completes, so the state must outlive the caller's pool.
+     */
+    if (target->addr.port != 0 && af == pj_AF_UNSPEC() &&
+        resolver->timer_heap && PJSIP_RESOLVE_FAMILY_DELAY > 0)
+    {
+        status = create_dual_query(resolver, pool, &query);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+        pool = query->pool;
+    } else {
+        query = PJ_POOL_ZALLOC_T(pool, struct query);
+    }
     query->objname = THIS_FILE;
     query->token = token;
     query->cb = cb;
@@ -465,6 +541,10 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
                                     query->req.def_port, pool, resolver->res,
                                     opt, query, &srv_resolver_cb, NULL);
 
+    } else if (query->query_type == PJ_DNS_TYPE_A && query->grp_lock) {
+
+        start_dual_query(resolver, query);
+
     } else if (query->query_type == PJ_DNS_TYPE_A) {
 
         /* Resolve DNS A record if address family is not fixed to IPv6 */
@@ -522,18 +602,58 @@ on_error:
 
 #if PJSIP_HAS_RESOLVER
 
-/* 
- * This callback is called when target is resolved with DNS A query.
+/*
+ * Reorder entries [start, end) of the result so that the address families
+ * alternate, starting with the family of the first entry and keeping the
+ * order of the addresses within each family (RFC 8305 section 4). This way
+ * failover to the next address tries the other family first instead of
+ * going through every address of a family that may be unreachable.
  */
-static void dns_a_callback(void *user_data,
-                           pj_status_t status,
-                           pj_dns_parsed_packet *pkt)
+static void interleave_families(pjsip_server_addresses *srv,
+                                unsigned start, unsigned end)
 {
-    struct query *query = (struct query*) user_data;
-    pjsip_server_addresses *srv = &query->server;
+    pjsip_server_address_record tmp[PJSIP_MAX_RESOLVED_ADDRESSES];
+    unsigned first[PJSIP_MAX_RESOLVED_ADDRESSES];
+    unsigned other[PJSIP_MAX_RESOLVED_ADDRESSES];
+    unsigned i, cnt, first_cnt = 0, other_cnt = 0, fi = 0, oi = 0;
+    int first_af;
+
+    /* Two entries always alternate (or are of the same family) */
+    if (end - start < 3)
+        return;
 
-    /* Reset outstanding job */
-    query->object = NULL;
+    cnt = end - start;
+    pj_memcpy(tmp, &srv->entry[start], cnt * sizeof(tmp[0]));
+
+    first_af = tmp[0].addr.addr.sa_family;
+    for (i = 0; i < cnt; ++i) {
+        if (tmp[i].addr.addr.sa_family == first_af)
+            first[first_cnt++] = i;
+        else
+            other[other_cnt++] = i;
+    }
+
+    if (other_cnt == 0)
+        return;
+
+    i = start;
+    while (fi < first_cnt || oi < other_cnt) {
+        if (fi < first_cnt)
+            srv->entry[i++] = tmp[first[fi++]];
+        if (oi < other_cnt)
+            srv->entry[i++] = tmp[other[oi++]];
+    }
+}
+
+
+/*
+ * Add the addresses in DNS A or AAAA response to the query result.
+ */
+static void add_addr_records(struct query *query, int af,
+                             pj_status_t status,
+                             pj_dns_parsed_packet *pkt)
+{
+    pjsip_server_addresses *srv = &query->server;
 
     if (status == PJ_SUCCESS) {
         pj_dns_addr_record rec;
@@ -543,99 +663,340 @@ static void dns_a_callback(void *user_data,
         rec.addr_count = 0;
         status = pj_dns_parse_addr_response(pkt, &rec);
 
-        /* Build server addresses and call callback */
+        /* Build server addresses */
         for (i = 0; i < rec.addr_count &&
                     srv->count < PJSIP_MAX_RESOLVED_ADDRESSES; ++i)
         {
+            pjsip_server_address_record *e = &srv->entry[srv->count];
+
             /* Should not happen, just in case */
-            if (rec.addr[i].af != pj_AF_INET())
+            if (rec.addr[i].af != af)
                 continue;
 
-            srv->entry[srv->count].type = query->naptr[0].type;
-            srv->entry[srv->count].priority = 0;
-            srv->entry[srv->count].weight = 0;
-            srv->entry[srv->count].addr_len = sizeof(pj_sockaddr_in);
-            pj_sockaddr_in_init(&srv->entry[srv->count].addr.ipv4,
-                                0, (pj_uint16_t)query->req.def_port);
-            srv->entry[srv->count].addr.ipv4.sin_addr = rec.addr[i].ip.v4;
+            e->type = query->naptr[0].type;
+            e->priority = 0;
+            e->weight = 0;
+            pj_sockaddr_init(af, &e->addr, NULL,
+                             (pj_uint16_t)query->req.def_port);
+            if (af == pj_AF_INET6()) {
+                e->type |= PJSIP_TRANSPORT_IPV6;
+                e->addr.ipv6.sin6_addr = rec.addr[i].ip.v6;
+            } else {
+                e->addr.ipv4.sin_addr = rec.addr[i].ip.v4;
+            }
+            e->addr_len = pj_sockaddr_get_len(&e->addr);
 
             ++srv->count;
         }
     }
-    
+
     if (status != PJ_SUCCESS) {
         PJ_PERROR(4,(query->objname, status,
-                     "DNS A record resolution failed"));
+                     "DNS %s record resolution failed",
+                     (af == pj_AF_INET6() ? "AAAA" : "A")));
 
         query->last_error = status;
     }
+}
 
-    /* Call the callback if all DNS queries have been completed */
-    if (query->object == NULL && query->object6 == NULL) {
-        if (srv->count > 0)
-            (*query->cb)(PJ_SUCCESS, query->token, &query->server);
-        else
-            (*query->cb)(query->last_error, query->token, NULL);
+
+/*
+ * Call the application callback with the result of A/AAAA resolution.
+ */
+static void report_addr_result(struct query *query)
+{
+    pjsip_server_addresses *srv = &query->server;
+
+    if (srv->count > 0) {
+        interleave_families(srv, 0, srv->count);
+        (*query->cb)(PJ_SUCCESS, query->token, srv);
+    } else {
+        (*query->cb)(query->last_error, query->token, NULL);
     }
 }
 
 
-/* 
- * This callback is called when target is resolved with DNS AAAA query.
+/*
+ * Called when the other address family has not answered within
+ * PJSIP_RESOLVE_FAMILY_DELAY of the first one.
  */
-static void dns_aaaa_callback(void *user_data,
-                              pj_status_t status,
-                              pj_dns_parsed_packet *pkt)
+static void dual_query_timer_cb(pj_timer_heap_t *timer_heap,
+                                pj_timer_entry *entry)
 {
-    struct query *query = (struct query*) user_data;
-    pjsip_server_addresses *srv = &query->server;
+    struct query *query = (struct query*) entry->user_data;
+    pj_bool_t report = PJ_FALSE;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    pj_grp_lock_acquire(query->grp_lock);
+    entry->id = 0;
+    if (!query->reported) {
+        PJ_LOG(5,(query->objname,
+                  "DNS %s query for %.*s is still pending, proceeding with "
+                  "%d address(es)",
+                  (query->aaaa_pending ? "AAAA" : "A"),
+                  (int)query->naptr[0].name.slen, query->naptr[0].name.ptr,
+                  query->server.count));
+        query->reported = PJ_TRUE;
+        report = PJ_TRUE;
+    }
+    pj_grp_lock_release(query->grp_lock);
 
-    /* Reset outstanding job */
-    query->object6 = NULL;
+    if (report)
+        report_addr_result(query);
+}
 
-    if (status == PJ_SUCCESS) {
-        pj_dns_addr_record rec;
-        unsigned i;
 
-        /* Parse the response */
-        rec.addr_count = 0;
-        status = pj_dns_parse_addr_response(pkt, &rec);
+/*
+ * Handle the completion of one of the queries of dual A/AAAA resolution.
+ * The result is reported when both queries have completed, or
+ * PJSIP_RESOLVE_FAMILY_DELAY after the first family has produced
+ * addresses, whichever comes first. A query completing after the result
+ * has been reported is ignored.
+ */
+static void dual_query_cb(struct query *query, int af,
+                          pj_status_t status,
+                          pj_dns_parsed_packet *pkt)
+{
+    pj_bool_t report = PJ_FALSE;
 
-        /* Build server addresses and call callback */
-        for (i = 0; i < rec.addr_count &&
-                    srv->count < PJSIP_MAX_RESOLVED_ADDRESSES; ++i)
-        {
-            /* Should not happen, just in case */
-            if (rec.addr[i].af != pj_AF_INET6())
-                continue;
+    pj_grp_lock_acquire(query->grp_lock);
 
-            srv->entry[srv->count].type = query->naptr[0].type |
-                                          PJSIP_TRANSPORT_IPV6;
-            srv->entry[srv->count].priority = 0;
-            srv->entry[srv->count].weight = 0;
-            srv->entry[srv->count].addr_len = sizeof(pj_sockaddr_in6);
-            pj_sockaddr_init(pj_AF_INET6(), &srv->entry[srv->count].addr,
-                             0, (pj_uint16_t)query->req.def_port);
-            srv->entry[srv->count].addr.ipv6.sin6_addr = rec.addr[i].ip.v6;
+    if (af == pj_AF_INET6()) {
+        query->aaaa_pending = PJ_FALSE;
+        query->object6 = NULL;
+    } else {
+        query->a_pending = PJ_FALSE;
+        query->object = NULL;
+    }
 
-            ++srv->count;
+    if (!query->reported) {
+        add_addr_records(query, af, status, pkt);
+
+        if (!query->a_pending && !query->aaaa_pending) {
+            report = PJ_TRUE;
+        } else if (query->server.count > 0 && query->timer.id == 0) {
+            pj_time_val delay = {0, PJSIP_RESOLVE_FAMILY_DELAY};
+
+            pj_time_val_normalize(&delay);
+            status = pj_timer_heap_schedule_w_grp_lock(query->timer_heap,
+                                                       &query->timer,
+                                                       &delay, 1,
+                                                       query->grp_lock);
+            if (status != PJ_SUCCESS)
+                report = PJ_TRUE;
         }
+
+        if (report) {
+            query->reported = PJ_TRUE;
+            pj_timer_heap_cancel_if_active(query->timer_heap,
+                                           &query->timer, 0);
+        }
+    }
+
+    pj_grp_lock_release(query->grp_lock);
+
+    if (report)
+        report_addr_result(query);
+
+    /* Release the reference held by this DNS query */
+    pj_grp_lock_dec_ref(query->grp_lock);
+}
+
+
+static void dual_query_on_destroy(void *arg)
+{
+    struct query *query = (struct query*) arg;
+    pjsip_resolver_t *resolver = query->resolver;
+
+    pj_lock_acquire(resolver->lock);
+    pj_list_erase(query);
+    pj_lock_release(resolver->lock);
+
+    pj_pool_safe_release(&query->pool);
+}
+
+
+/*
+ * Cancel the pending DNS queries and the timer of a dual A/AAAA
+ * resolution and release the references they hold, without reporting the
+ * result. Called when the resolver is destroyed.
+ */
+static void release_dual_query(struct query *query)
+{
+    unsigned ref_cnt = 0;
+
+    pj_grp_lock_acquire(query->grp_lock);
+    query->reported = PJ_TRUE;
+    if (query->a_pending) {
+        if (query->object)
+            pj_dns_resolver_cancel_query(query->object, PJ_FALSE);
+        query->object = NULL;
+        query->a_pending = PJ_FALSE;
+        ++ref_cnt;
     }
-    
+    if (query->aaaa_pending) {
+        if (query->object6)
+            pj_dns_resolver_cancel_query(query->object6, PJ_FALSE);
+        query->object6 = NULL;
+        query->aaaa_pending = PJ_FALSE;
+        ++ref_cnt;
+    }
+    pj_timer_heap_cancel_if_active(query->timer_heap, &query->timer, 0);
+    pj_grp_lock_release(query->grp_lock);
+
+    while (ref_cnt--)
+        pj_grp_lock_dec_ref(query->grp_lock);
+}
+
+
+/*
+ * Create the state for dual A/AAAA resolution, in its own pool.
+ */
+static pj_status_t create_dual_query(pjsip_resolver_t *resolver,
+                                     pj_pool_t *pool,
+                                     struct query **p_query)
+{
+    pj_pool_t *qpool;
+    struct query *query;
+    pj_status_t status;
+
+    qpool = pj_pool_create(pool->factory, "rslv%p", 512, 512, NULL);
+    if (!qpool)
+        return PJ_ENOMEM;
+
+    query = PJ_POOL_ZALLOC_T(qpool, struct query);
+    query->resolver = resolver;
+    query->pool = qpool;
+
+    /* Add to the list before the handler may be called */
+    pj_lock_acquire(resolver->lock);
+    pj_list_push_back(&resolver->dual_query_list, query);
+    pj_lock_release(resolver->lock);
+
+    status = pj_grp_lock_create_w_handler(qpool, NULL, query,
+                                          &dual_query_on_destroy,
+                                          &query->grp_lock);
     if (status != PJ_SUCCESS) {
-        PJ_PERROR(4,(query->objname, status,
-                     "DNS AAAA record resolution failed"));
+        pj_lock_acquire(resolver->lock);
+        pj_list_erase(query);
+        pj_lock_release(resolver->lock);
+        pj_pool_release(qpool);
+        return status;
+    }
 
-        query->last_error = status;
+    *p_query = query;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Start DNS A and AAAA queries for the target. Each query holds a
+ * reference to the state until its callback has been called, so a query
+ * that completes after the result has been reported is still safe.
+ */
+static void start_dual_query(pjsip_resolver_t *resolver, struct query *query)
+{
+    pj_dns_async_query *object;
+    pj_status_t status;
+
+    query->timer_heap = resolver->timer_heap;
+    pj_timer_entry_init(&query->timer, 0, query, &dual_query_timer_cb);
+
+    /* Both queries must be marked pending before any of them is started,
+     * since the callback is called inline when the records are cached.
+     */
+    query->a_pending = PJ_TRUE;
+    query->aaaa_pending = PJ_TRUE;
+
+    /* Hold a reference until both queries have been started */
+    pj_grp_lock_add_ref(query->grp_lock);
+
+    /* The query objects are kept, so that the queries can be cancelled
+     * when the resolver is destroyed, unless they have completed already
+     * (the callback may be called before the start function returns).
+     */
+    pj_grp_lock_add_ref(query->grp_lock);
+    object = NULL;
+    status = pj_dns_resolver_start_query(resolver->res,
+                                         &query->naptr[0].name,
+                                         PJ_DNS_TYPE_A, 0,
+                                         &dns_a_callback, query, &object);
+    if (status != PJ_SUCCESS) {
+        dual_query_cb(query, pj_AF_INET(), status, NULL);
+    } else {
+        pj_grp_lock_acquire(query->grp_lock);
+        if (query->a_pending)
+            query->object = object;
+        pj_grp_lock_release(query->grp_lock);
+    }
+
+    pj_grp_lock_add_ref(query->grp_lock);
+    object = NULL;
+    status = pj_dns_resolver_start_query(resolver->res,
+                                         &query->naptr[0].name,
+                                         PJ_DNS_TYPE_AAAA, 0,
+                                         &dns_aaaa_callback, query, &object);
+    if (status != PJ_SUCCESS) {
+        dual_query_cb(query, pj_AF_INET6(), status, NULL);
+    } else {
+        pj_grp_lock_acquire(query->grp_lock);
+        if (query->aaaa_pending)
+            query->object6 = object;
+        pj_grp_lock_release(query->grp_lock);
     }
 
+    pj_grp_lock_dec_ref(query->grp_lock);
+}
+
+
+/* 
+ * This callback is called when target is resolved with DNS A query.
+ */
+static void dns_a_callback(void *user_data,
+                           pj_status_t status,
+                           pj_dns_parsed_packet *pkt)
+{
+    struct query *query = (struct query*) user_data;
+
+    if (query->grp_lock) {
+        dual_query_cb(query, pj_AF_INET(), status, pkt);
+        return;
+    }
+
+    /* Reset outstanding job */
+    query->object = NULL;
+
+    add_addr_records(query, pj_AF_INET(), status, pkt);
+
     /* Call the callback if all DNS queries have been completed */
-    if (query->object == NULL && query->object6 == NULL) {
-        if (srv->count > 0)
-            (*query->cb)(PJ_SUCCESS, query->token, &query->server);
-        else
-            (*query->cb)(query->last_error, query->token, NULL);
+    if (query->object == NULL && query->object6 == NULL)
+        report_addr_result(query);
+}
+
+
+/* 
+ * This callback is called when target is resolved with DNS AAAA query.
+ */
+static void dns_aaaa_callback(void *user_data,
+                              pj_status_t status,
+                              pj_dns_parsed_packet *pkt)
+{
+    struct query *query = (struct query*) user_data;
+
+    if (query->grp_lock) {
+        dual_query_cb(query, pj_AF_INET6(), status, pkt);
+        return;
     }
+
+    /* Reset outstanding job */
+    query->object6 = NULL;
+
+    add_addr_records(query, pj_AF_INET6(), status, pkt);
+
+    /* Call the callback if all DNS queries have been completed */
+    if (query->object == NULL && query->object6 == NULL)
+        report_addr_result(query);
 }
 
 
@@ -661,6 +1022,7 @@ static void srv_resolver_cb(void *user_data,
     srv.count = 0;
     for (i=0; i<rec->count; ++i) {
         const pj_dns_addr_record *s = &rec->entry[i].server;
+        unsigned start = srv.count;
         unsigned j;
 
         for (j = 0; j < s->addr_count &&
@@ -685,6 +1047,9 @@ static void srv_resolver_cb(void *user_data,
 
             ++srv.count;
         }
+
+        /* Alternate address families among the target's addresses */
+        interleave_families(&srv, start, srv.count);
     }
 
     /* Call the callback */
@@ -2090,6 +2090,9 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
             remaining_len -= (p - current_pkt);
             total_processed += (p - current_pkt);
 
+            /* Message start has moved, restart stream framing */
+            pj_bzero(&tr->rx_msg_state, sizeof(tr->rx_msg_state));
+
             /* Notify application about the dropped newlines */
             if (mgr->tp_drop_data_cb) {
                 pjsip_tp_dropped_data dd;
@@ -2119,13 +2122,18 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
         rdata->msg_info.msg_buf = current_pkt;
         rdata->msg_info.len = (int)remaining_len;
 
-        /* For TCP transport, check if the whole message has been received. */
+        /* For TCP transport, check if the whole message has been received.
+         * The framing state is kept in the transport, so the part of the
+         * message examined on previous reads is not scanned again.
+         */
         if ((tr->flag & PJSIP_TRANSPORT_DATAGRAM) == 0) {
             pj_status_t msg_status;
-            msg_status = pjsip_find_msg(current_pkt, remaining_len, PJ_FALSE, 
-                                        &msg_fragment_size);
+            msg_status = pjsip_find_msg2(current_pkt, remaining_len,
+                                         &tr->rx_msg_state,
+                                         &msg_fragment_size);
             if (msg_status != PJ_SUCCESS) {
                 if (remaining_len == PJSIP_MAX_PKT_LEN) {
+                    pj_bzero(&tr->rx_msg_state, sizeof(tr->rx_msg_state));
                     mgr->on_rx_msg(mgr->endpt, PJSIP_ERXOVERFLOW, rdata);
                     
                     /* Notify application about the message overflow */
@@ -2160,6 +2168,9 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
                     return total_processed;
                 }
             }
+
+            /* The message will be consumed */
+            pj_bzero(&tr->rx_msg_state, sizeof(tr->rx_msg_state));
         }
 
         /* Update msg_info. */
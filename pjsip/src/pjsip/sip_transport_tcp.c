@@ -44,6 +44,14 @@
 struct tcp_listener;
 struct tcp_transport;
 
+/* Write coalescing timer id */
+enum
+{
+    COALESCE_TIMER_NONE,
+    COALESCE_TIMER_DELAY,
+    COALESCE_TIMER_FLUSH
+};
+
 
 /*
  * This is the TCP listener, which is a "descendant" of pjsip_tpfactory (the
@@ -74,7 +82,8 @@ struct tcp_listener
  * A delayed transmission occurs when application sends tx_data when
  * the TCP connect/establishment is still in progress. These delayed
  * transmission will be "flushed" once the socket is connected (either
- * successfully or with errors).
+ * successfully or with errors). It is also used to queue transmit data
+ * that is waiting to be coalesced (see PJSIP_TCP_COALESCE_DELAY).
  */
 struct delayed_tdata
 {
@@ -121,6 +130,20 @@ struct tcp_transport
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
 
+    /* Write coalescing. Messages are queued in coalesce_list until the
+     * timer fires, enough bytes are queued, or the previous write completes.
+     * The messages being written with batch_op_key are kept in batch_list.
+     */
+    struct delayed_tdata     coalesce_list;
+    pj_size_t                coalesce_len;
+    pj_timer_entry           coalesce_timer;
+    struct delayed_tdata     batch_list;
+    pjsip_tx_data_op_key     batch_op_key;
+    char                    *batch_buf;
+
+    /* Transmit statistics, protected by base.lock */
+    pjsip_tcp_transport_stat tx_stat;
+
     /* Group lock to be used by TCP transport and ioqueue key */
     pj_grp_lock_t           *grp_lock;
 
@@ -604,6 +627,12 @@ static pj_bool_t on_connect_complete(pj_activesock_t *asock,
 /* TCP keep-alive timer callback */
 static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e);
 
+/* Write coalescing */
+static void tcp_coalesce_timer(pj_timer_heap_t *th, pj_timer_entry *e);
+static void tcp_flush_batch(struct tcp_transport *tcp);
+static void tcp_on_batch_sent(struct tcp_transport *tcp,
+                              pj_ssize_t bytes_sent);
+
 /* Clean up TCP resources */
 static void tcp_on_destroy(void *arg);
 
@@ -644,6 +673,8 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     tcp->sock = sock;
     /*tcp->listener = listener;*/
     pj_list_init(&tcp->delayed_list);
+    pj_list_init(&tcp->coalesce_list);
+    pj_list_init(&tcp->batch_list);
     tcp->base.pool = pool;
 
     pj_ansi_snprintf(tcp->base.obj_name, PJ_MAX_OBJ_NAME, 
@@ -727,6 +758,12 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     pj_ioqueue_op_key_init(&tcp->ka_op_key.key, sizeof(pj_ioqueue_op_key_t));
     pj_strdup(tcp->base.pool, &tcp->ka_pkt, &ka_pkt);
 
+    /* Initialize write coalescing */
+    tcp->coalesce_timer.user_data = (void*)tcp;
+    tcp->coalesce_timer.cb = &tcp_coalesce_timer;
+    pj_ioqueue_op_key_init(&tcp->batch_op_key.key,
+                           sizeof(pj_ioqueue_op_key_t));
+
     if (is_server && listener->initial_timeout) {
         /* Initialize initial timer. */
         pjsip_transport_add_ref(&tcp->base);
@@ -754,6 +791,7 @@ on_error:
 /* Flush all delayed transmision once the socket is connected. */
 static void tcp_flush_pending_tx(struct tcp_transport *tcp)
 {
+    pj_bool_t coalesce = (pjsip_cfg()->tcp.coalesce_delay != 0);
     pj_time_val now;
 
     pj_gettickcount(&now);
@@ -780,8 +818,18 @@ static void tcp_flush_pending_tx(struct tcp_transport *tcp)
             continue;
         }
 
-        /* send! */
         size = tdata->buf.cur - tdata->buf.start;
+
+        /* Send them together with a single write if coalescing */
+        if (coalesce) {
+            pj_list_push_back(&tcp->coalesce_list, pending_tx);
+            tcp->coalesce_len += size;
+            continue;
+        }
+
+        /* send! */
+        ++tcp->tx_stat.tx_msg_cnt;
+        ++tcp->tx_stat.tx_write_cnt;
         status = pj_activesock_send(tcp->asock, op_key, tdata->buf.start, 
                                     &size, 0);
         if (status != PJ_EPENDING) {
@@ -792,6 +840,142 @@ static void tcp_flush_pending_tx(struct tcp_transport *tcp)
 
     }
     pj_lock_release(tcp->base.lock);
+
+    if (coalesce)
+        tcp_flush_batch(tcp);
+}
+
+
+/* Write as many queued messages as possible with a single send operation.
+ * Only one such write can be outstanding, the next one is started when
+ * it completes.
+ */
+static void tcp_flush_batch(struct tcp_transport *tcp)
+{
+    pj_lock_acquire(tcp->base.lock);
+
+    while (!tcp->is_closing && pj_list_empty(&tcp->batch_list) &&
+           !pj_list_empty(&tcp->coalesce_list))
+    {
+        struct delayed_tdata *pending_tx;
+        pjsip_tx_data *tdata;
+        const char *data;
+        pj_ssize_t size;
+        pj_status_t status;
+
+        pj_timer_heap_cancel_if_active(
+                        pjsip_endpt_get_timer_heap(tcp->base.endpt),
+                        &tcp->coalesce_timer, COALESCE_TIMER_NONE);
+
+        pending_tx = tcp->coalesce_list.next;
+        tdata = pending_tx->tdata_op_key->tdata;
+        size = tdata->buf.cur - tdata->buf.start;
+
+        if (pending_tx->next == &tcp->coalesce_list ||
+            size > PJSIP_TCP_COALESCE_MAX_SIZE)
+        {
+            /* Nothing to coalesce with, send from the tdata's own buffer */
+            pj_list_erase(pending_tx);
+            pj_list_push_back(&tcp->batch_list, pending_tx);
+            ++tcp->tx_stat.tx_msg_cnt;
+            data = tdata->buf.start;
+
+        } else {
+            if (tcp->batch_buf == NULL) {
+                tcp->batch_buf = (char*)
+                                 pj_pool_alloc(tcp->base.pool,
+                                               PJSIP_TCP_COALESCE_MAX_SIZE);
+            }
+
+            /* Copy the queued messages in order for as long as they fit */
+            size = 0;
+            while (!pj_list_empty(&tcp->coalesce_list)) {
+                pj_ssize_t len;
+
+                pending_tx = tcp->coalesce_list.next;
+                tdata = pending_tx->tdata_op_key->tdata;
+                len = tdata->buf.cur - tdata->buf.start;
+                if (size + len > PJSIP_TCP_COALESCE_MAX_SIZE)
+                    break;
+
+                pj_memcpy(tcp->batch_buf + size, tdata->buf.start, len);
+                size += len;
+
+                pj_list_erase(pending_tx);
+                pj_list_push_back(&tcp->batch_list, pending_tx);
+                ++tcp->tx_stat.tx_msg_cnt;
+            }
+            data = tcp->batch_buf;
+        }
+
+        tcp->coalesce_len -= size;
+        ++tcp->tx_stat.tx_write_cnt;
+
+        status = pj_activesock_send(tcp->asock, &tcp->batch_op_key.key,
+                                    data, &size, 0);
+        if (status == PJ_EPENDING)
+            break;
+
+        /* On failure the batch is reported with the error, which also
+         * initiates the transport shutdown, so stop writing here.
+         */
+        if (status != PJ_SUCCESS)
+            size = -status;
+
+        /* Completed immediately, notify and continue with the rest */
+        pj_lock_release(tcp->base.lock);
+        tcp_on_batch_sent(tcp, size);
+        if (size <= 0)
+            return;
+        pj_lock_acquire(tcp->base.lock);
+    }
+
+    pj_lock_release(tcp->base.lock);
+}
+
+
+/* Notify completion of every message in the batch that has been written. */
+static void tcp_on_batch_sent(struct tcp_transport *tcp,
+                              pj_ssize_t bytes_sent)
+{
+    struct delayed_tdata batch;
+
+    pj_list_init(&batch);
+    pj_lock_acquire(tcp->base.lock);
+    pj_list_merge_last(&batch, &tcp->batch_list);
+    pj_lock_release(tcp->base.lock);
+
+    while (!pj_list_empty(&batch)) {
+        struct delayed_tdata *pending_tx;
+        pjsip_tx_data *tdata;
+        pj_ioqueue_op_key_t *op_key;
+        pj_ssize_t size;
+
+        pending_tx = batch.next;
+        pj_list_erase(pending_tx);
+
+        tdata = pending_tx->tdata_op_key->tdata;
+        op_key = (pj_ioqueue_op_key_t*)pending_tx->tdata_op_key;
+        size = (bytes_sent > 0) ? tdata->buf.cur - tdata->buf.start :
+                                  bytes_sent;
+
+        on_data_sent(tcp->asock, op_key, size);
+    }
+}
+
+
+/* Write coalescing timer callback */
+static void tcp_coalesce_timer(pj_timer_heap_t *th, pj_timer_entry *e)
+{
+    struct tcp_transport *tcp = (struct tcp_transport*) e->user_data;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_lock_acquire(tcp->base.lock);
+    e->id = COALESCE_TIMER_NONE;
+    pj_lock_release(tcp->base.lock);
+
+    tcp_flush_batch(tcp);
 }
 
 
@@ -837,7 +1021,17 @@ static pj_status_t tcp_destroy(pjsip_transport *transport,
         tcp->ka_timer.id = PJ_FALSE;
     }
 
-    /* Cancel all delayed transmits */
+    /* Stop write coalescing timer. */
+    pj_timer_heap_cancel_if_active(pjsip_endpt_get_timer_heap(tcp->base.endpt),
+                                   &tcp->coalesce_timer, COALESCE_TIMER_NONE);
+
+    /* Cancel all delayed and coalesced transmits */
+    pj_lock_acquire(tcp->base.lock);
+    pj_list_merge_last(&tcp->delayed_list, &tcp->batch_list);
+    pj_list_merge_last(&tcp->delayed_list, &tcp->coalesce_list);
+    tcp->coalesce_len = 0;
+    pj_lock_release(tcp->base.lock);
+
     while (!pj_list_empty(&tcp->delayed_list)) {
         struct delayed_tdata *pending_tx;
         pj_ioqueue_op_key_t *op_key;
@@ -1220,6 +1414,18 @@ static pj_bool_t on_data_sent(pj_activesock_t *asock,
                                 pj_activesock_get_user_data(asock);
     pjsip_tx_data_op_key *tdata_op_key = (pjsip_tx_data_op_key*)op_key;
 
+    /* Coalesced write completion, notify each message and write the
+     * ones that have been queued in the mean time.
+     */
+    if (op_key == &tcp->batch_op_key.key) {
+        tcp_on_batch_sent(tcp, bytes_sent);
+        if (bytes_sent <= 0)
+            return PJ_FALSE;
+
+        tcp_flush_batch(tcp);
+        return PJ_TRUE;
+    }
+
     /* Note that op_key may be the op_key from keep-alive, thus
      * it will not have tdata etc.
      */
@@ -1331,6 +1537,69 @@ static pj_status_t tcp_send_msg(pjsip_transport *transport,
 
         pj_lock_release(tcp->base.lock);
     } 
+
+    /* Queue the message to be coalesced with other messages. Once this
+     * is done, keep queueing as long as there are queued messages even if
+     * coalescing is disabled in the mean time, to preserve their order.
+     * The lists are checked with the lock held, since they are modified
+     * by the flush and by other threads sending on this transport.
+     */
+    if (!delayed) {
+        pj_lock_acquire(tcp->base.lock);
+
+        if (pjsip_cfg()->tcp.coalesce_delay ||
+            !pj_list_empty(&tcp->coalesce_list) ||
+            !pj_list_empty(&tcp->batch_list))
+        {
+            struct delayed_tdata *delayed_tdata;
+
+            delayed_tdata = PJ_POOL_ZALLOC_T(tdata->pool, 
+                                             struct delayed_tdata);
+            delayed_tdata->tdata_op_key = &tdata->op_key;
+
+            pj_list_push_back(&tcp->coalesce_list, delayed_tdata);
+            tcp->coalesce_len += tdata->buf.cur - tdata->buf.start;
+
+            /* Unless a write is in progress (the queue will be flushed
+             * when it completes), start the write from the timer. When
+             * enough data is queued, flush immediately but still from the
+             * timer, so that the transmit callbacks are never called from
+             * this function.
+             */
+            if (pj_list_empty(&tcp->batch_list) &&
+                tcp->coalesce_timer.id != COALESCE_TIMER_FLUSH)
+            {
+                pj_time_val delay = { 0, 0 };
+                int timer_id = COALESCE_TIMER_FLUSH;
+
+                if (tcp->coalesce_len < PJSIP_TCP_COALESCE_MAX_SIZE) {
+                    delay.msec = pjsip_cfg()->tcp.coalesce_delay;
+                    pj_time_val_normalize(&delay);
+                    if (delay.sec || delay.msec)
+                        timer_id = COALESCE_TIMER_DELAY;
+                }
+
+                if (tcp->coalesce_timer.id != timer_id) {
+                    pj_timer_heap_cancel_if_active(
+                                pjsip_endpt_get_timer_heap(tcp->base.endpt),
+                                &tcp->coalesce_timer, COALESCE_TIMER_NONE);
+                    pjsip_endpt_schedule_timer_w_grp_lock(
+                                                tcp->base.endpt,
+                                                &tcp->coalesce_timer,
+                                                &delay, timer_id,
+                                                tcp->grp_lock);
+                }
+            }
+
+            status = PJ_EPENDING;
+            delayed = PJ_TRUE;
+        } else {
+            ++tcp->tx_stat.tx_msg_cnt;
+            ++tcp->tx_stat.tx_write_cnt;
+        }
+
+        pj_lock_release(tcp->base.lock);
+    }
     
     if (!delayed) {
         /*
@@ -1632,6 +1901,22 @@ PJ_DEF(pj_sock_t) pjsip_tcp_transport_get_socket(pjsip_transport *transport)
 }
 
 
+PJ_DEF(pj_status_t) pjsip_tcp_transport_get_stat(
+                                        pjsip_transport *transport,
+                                        pjsip_tcp_transport_stat *stat)
+{
+    struct tcp_transport *tcp = (struct tcp_transport*)transport;
+
+    PJ_ASSERT_RETURN(transport && stat, PJ_EINVAL);
+
+    pj_lock_acquire(tcp->base.lock);
+    pj_memcpy(stat, &tcp->tx_stat, sizeof(*stat));
+    pj_lock_release(tcp->base.lock);
+
+    return PJ_SUCCESS;
+}
+
+
 PJ_DEF(pj_status_t) pjsip_tcp_transport_lis_start(pjsip_tpfactory *factory,
                                                  const pj_sockaddr *local,
                                                  const pjsip_host_port *a_name)
@@ -341,6 +341,7 @@ static void set_ssock_param(pj_ssl_sock_param *ssock_param,
 
     ssock_param->enable_renegotiation =
                                     listener->tls_setting.enable_renegotiation;
+    ssock_param->enable_ktls = listener->tls_setting.enable_ktls;
     /* Copy the sockopt */
     if (listener->tls_setting.sockopt_params.cnt > 0) {
         pj_memcpy(&ssock_param->sockopt_params, 
@@ -1238,6 +1239,7 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
                                      listener->tls_setting.sockopt_ignore_error;
 
     ssock_param.enable_renegotiation = listener->tls_setting.enable_renegotiation;
+    ssock_param.enable_ktls = listener->tls_setting.enable_ktls;
     /* Copy the sockopt */
     if (listener->tls_setting.sockopt_params.cnt > 0) {
         pj_memcpy(&ssock_param.sockopt_params, 
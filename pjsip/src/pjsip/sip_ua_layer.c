@@ -72,6 +72,21 @@ struct dlg_set
 };
 
 
+/* The dialog sets are distributed among several shards based on the hash
+ * value of the local tag (the dialog set key). Each shard has its own
+ * mutex, hash table, and free nodes, so lookups of dialogs in different
+ * shards don't contend with each other. All dialogs in a dialog set share
+ * the same local tag hash value, hence they're always in the same shard.
+ */
+struct dlg_shard
+{
+    pj_mutex_t          *mutex;
+    pj_pool_t           *pool;
+    pj_hash_table_t     *dlg_table;
+    struct dlg_set       free_dlgset_nodes;
+};
+
+
 /*
  * Module interface.
  */
@@ -80,10 +95,8 @@ static struct user_agent
     pjsip_module         mod;
     pj_pool_t           *pool;
     pjsip_endpoint      *endpt;
-    pj_mutex_t          *mutex;
-    pj_hash_table_t     *dlg_table;
+    struct dlg_shard    *shards;
     pjsip_ua_init_param  param;
-    struct dlg_set       free_dlgset_nodes;
 
 } mod_ua = 
 {
@@ -111,6 +124,7 @@ static struct user_agent
  */
 static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
 {
+    unsigned i;
     pj_status_t status;
 
     /* Initialize the user agent. */
@@ -120,15 +134,33 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (mod_ua.pool == NULL)
         return PJ_ENOMEM;
 
-    status = pj_mutex_create_recursive(mod_ua.pool, " ua%p", &mod_ua.mutex);
-    if (status != PJ_SUCCESS)
-        return status;
+    mod_ua.shards = (struct dlg_shard*)
+                    pj_pool_calloc(mod_ua.pool, PJSIP_UA_DLG_TABLE_SHARDS,
+                                   sizeof(struct dlg_shard));
 
-    mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
-    if (mod_ua.dlg_table == NULL)
-        return PJ_ENOMEM;
+    for (i = 0; i < PJSIP_UA_DLG_TABLE_SHARDS; ++i) {
+        struct dlg_shard *shard = &mod_ua.shards[i];
+
+        shard->pool = pjsip_endpt_create_pool(endpt, "uadlg%p",
+                                              PJSIP_POOL_LEN_UA,
+                                              PJSIP_POOL_INC_UA);
+        if (shard->pool == NULL)
+            return PJ_ENOMEM;
 
-    pj_list_init(&mod_ua.free_dlgset_nodes);
+        status = pj_mutex_create_recursive(shard->pool, " ua%p",
+                                           &shard->mutex);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        shard->dlg_table = pj_hash_create(shard->pool,
+                                          (PJSIP_MAX_DIALOG_COUNT +
+                                           PJSIP_UA_DLG_TABLE_SHARDS - 1) /
+                                          PJSIP_UA_DLG_TABLE_SHARDS);
+        if (shard->dlg_table == NULL)
+            return PJ_ENOMEM;
+
+        pj_list_init(&shard->free_dlgset_nodes);
+    }
 
     /* Initialize dialog lock. */
     status = pj_thread_local_alloc(&pjsip_dlg_lock_tls_id);
@@ -148,8 +180,19 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
  */
 static pj_status_t mod_ua_unload(void)
 {
+    unsigned i;
+
     pj_thread_local_free(pjsip_dlg_lock_tls_id);
-    pj_mutex_destroy(mod_ua.mutex);
+
+    for (i = 0; mod_ua.shards && i < PJSIP_UA_DLG_TABLE_SHARDS; ++i) {
+        struct dlg_shard *shard = &mod_ua.shards[i];
+
+        if (shard->mutex)
+            pj_mutex_destroy(shard->mutex);
+        if (shard->pool)
+            pjsip_endpt_release_pool(mod_ua.endpt, shard->pool);
+    }
+    mod_ua.shards = NULL;
 
     /* Release pool */
     if (mod_ua.pool) {
@@ -264,21 +307,42 @@ PJ_DEF(void) pjsip_ua_create_dlg_set_key( pj_pool_t *pool,
 }
 */
 
+/*
+ * Get the shard of the dialog hash table for the specified local tag
+ * hash value.
+ */
+static struct dlg_shard *get_shard(pj_uint32_t tag_hval)
+{
+    /* Don't use the lowest bits, they select the hash table bucket. */
+    return &mod_ua.shards[(tag_hval >> 16) % PJSIP_UA_DLG_TABLE_SHARDS];
+}
+
+/*
+ * Get the shard of the dialog hash table for the specified local tag,
+ * and also return the hash value of the tag to be used in the lookup.
+ */
+static struct dlg_shard *get_shard_by_tag(const pj_str_t *tag,
+                                          pj_uint32_t *tag_hval)
+{
+    *tag_hval = pj_hash_calc_tolower(0, NULL, tag);
+    return get_shard(*tag_hval);
+}
+
 /*
  * Acquire one dlg_set node to be put in the hash table.
- * This will first look in the free nodes list, then allocate
- * a new one from UA's pool when one is not available.
+ * This will first look in the shard's free nodes list, then allocate
+ * a new one from the shard's pool when one is not available.
  */
-static struct dlg_set *alloc_dlgset_node(void)
+static struct dlg_set *alloc_dlgset_node(struct dlg_shard *shard)
 {
     struct dlg_set *set;
 
-    if (!pj_list_empty(&mod_ua.free_dlgset_nodes)) {
-        set = mod_ua.free_dlgset_nodes.next;
+    if (!pj_list_empty(&shard->free_dlgset_nodes)) {
+        set = shard->free_dlgset_nodes.next;
         pj_list_erase(set);
         return set;
     } else {
-        set = PJ_POOL_ALLOC_T(mod_ua.pool, struct dlg_set);
+        set = PJ_POOL_ALLOC_T(shard->pool, struct dlg_set);
         return set;
     }
 }
@@ -290,6 +354,8 @@ static struct dlg_set *alloc_dlgset_node(void)
 PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
                                            pjsip_dialog *dlg )
 {
+    struct dlg_shard *shard;
+
     /* Sanity check. */
     PJ_ASSERT_RETURN(ua && dlg, PJ_EINVAL);
 
@@ -302,15 +368,16 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
     //               (dlg->role==PJSIP_ROLE_UAS && dlg->remote.info->tag.slen
     //                && dlg->remote.tag_hval != 0), PJ_EBUG);
 
-    /* Lock the user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the shard of the user agent. */
+    shard = get_shard(dlg->local.tag_hval);
+    pj_mutex_lock(shard->mutex);
 
     /* For UAC, check if there is existing dialog in the same set. */
     if (dlg->role == PJSIP_ROLE_UAC) {
         struct dlg_set *dlg_set;
 
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower( mod_ua.dlg_table,
+                  pj_hash_get_lower( shard->dlg_table,
                                      dlg->local.info->tag.ptr, 
                                      (unsigned)dlg->local.info->tag.slen,
                                      &dlg->local.tag_hval);
@@ -328,7 +395,7 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
             /* This is the first dialog in the dialog set. 
              * Create the dialog set and add this dialog to it.
              */
-            dlg_set = alloc_dlgset_node();
+            dlg_set = alloc_dlgset_node(shard);
             dlg_set->ht_key = dlg->local.info->tag;
             pj_list_init(&dlg_set->dlg_list);
             pj_list_push_back(&dlg_set->dlg_list, dlg);
@@ -336,7 +403,7 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
             dlg->dlg_set = dlg_set;
 
             /* Register the dialog set in the hash table. */
-            pj_hash_set_np_lower(mod_ua.dlg_table, 
+            pj_hash_set_np_lower(shard->dlg_table, 
                                  dlg_set->ht_key.ptr,
                                  (unsigned)dlg_set->ht_key.slen,
                                  dlg->local.tag_hval, dlg_set->ht_entry,
@@ -347,21 +414,21 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
         /* For UAS, create the dialog set with a single dialog as member. */
         struct dlg_set *dlg_set;
 
-        dlg_set = alloc_dlgset_node();
+        dlg_set = alloc_dlgset_node(shard);
         dlg_set->ht_key = dlg->local.info->tag;
         pj_list_init(&dlg_set->dlg_list);
         pj_list_push_back(&dlg_set->dlg_list, dlg);
 
         dlg->dlg_set = dlg_set;
 
-        pj_hash_set_np_lower(mod_ua.dlg_table, 
+        pj_hash_set_np_lower(shard->dlg_table, 
                              dlg_set->ht_key.ptr,
                              (unsigned)dlg_set->ht_key.slen,
                              dlg->local.tag_hval, dlg_set->ht_entry, dlg_set);
     }
 
     /* Unlock user agent. */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Done. */
     return PJ_SUCCESS;
@@ -371,6 +438,7 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
 PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
                                              pjsip_dialog *dlg )
 {
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *d;
 
@@ -380,8 +448,9 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     /* Check that dialog has been registered. */
     PJ_ASSERT_RETURN(dlg->dlg_set, PJ_EINVALIDOP);
 
-    /* Lock user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the shard of the user agent. */
+    shard = get_shard(dlg->local.tag_hval);
+    pj_mutex_lock(shard->mutex);
 
     /* Find this dialog from the dialog set. */
     dlg_set = (struct dlg_set*) dlg->dlg_set;
@@ -392,7 +461,7 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
 
     if (d != dlg) {
         pj_assert(!"Dialog is not registered!");
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return PJ_EINVALIDOP;
     }
 
@@ -403,16 +472,16 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     if (pj_list_empty(&dlg_set->dlg_list)) {
 
         /* Verify that the dialog set is valid */
-        pj_assert(pj_hash_get_lower(mod_ua.dlg_table, dlg_set->ht_key.ptr,
+        pj_assert(pj_hash_get_lower(shard->dlg_table, dlg_set->ht_key.ptr,
                                     (unsigned)dlg_set->ht_key.slen,
                                     &dlg->local.tag_hval) == dlg_set);
 
-        pj_hash_set_lower(NULL, mod_ua.dlg_table, dlg_set->ht_key.ptr,
+        pj_hash_set_lower(NULL, shard->dlg_table, dlg_set->ht_key.ptr,
                           (unsigned)dlg_set->ht_key.slen,
                           dlg->local.tag_hval, NULL);
 
         /* Return dlg_set to free nodes. */
-        pj_list_push_back(&mod_ua.free_dlgset_nodes, dlg_set);
+        pj_list_push_back(&shard->free_dlgset_nodes, dlg_set);
     } else {
         /* If the just unregistered dialog is being used as hash key,
          * reset the dlg_set entry with a new key (i.e: from the first dialog
@@ -426,13 +495,13 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
             /* Verify that the old & new keys share the hash value */
             pj_assert(key_dlg->local.tag_hval == dlg->local.tag_hval);
 
-            pj_hash_set_lower(NULL, mod_ua.dlg_table, dlg_set->ht_key.ptr,
+            pj_hash_set_lower(NULL, shard->dlg_table, dlg_set->ht_key.ptr,
                               (unsigned)dlg_set->ht_key.slen,
                               dlg->local.tag_hval, NULL);
 
             dlg_set->ht_key = key_dlg->local.info->tag;
 
-            pj_hash_set_np_lower(mod_ua.dlg_table,
+            pj_hash_set_np_lower(shard->dlg_table,
                                  dlg_set->ht_key.ptr,
                                  (unsigned)dlg_set->ht_key.slen,
                                  key_dlg->local.tag_hval, dlg_set->ht_entry,
@@ -441,7 +510,7 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     }
 
     /* Unlock user agent. */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Done. */
     return PJ_SUCCESS;
@@ -470,13 +539,17 @@ PJ_DEF(pjsip_dialog*) pjsip_tsx_get_dlg( pjsip_transaction *tsx )
  */
 PJ_DEF(unsigned) pjsip_ua_get_dlg_set_count(void)
 {
-    unsigned count;
+    unsigned i, count = 0;
+
+    PJ_ASSERT_RETURN(mod_ua.endpt && mod_ua.shards, 0);
 
-    PJ_ASSERT_RETURN(mod_ua.endpt, 0);
+    for (i = 0; i < PJSIP_UA_DLG_TABLE_SHARDS; ++i) {
+        struct dlg_shard *shard = &mod_ua.shards[i];
 
-    pj_mutex_lock(mod_ua.mutex);
-    count = pj_hash_count(mod_ua.dlg_table);
-    pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_lock(shard->mutex);
+        count += pj_hash_count(shard->dlg_table);
+        pj_mutex_unlock(shard->mutex);
+    }
 
     return count;
 }
@@ -490,21 +563,24 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
                                            const pj_str_t *remote_tag,
                                            pj_bool_t lock_dialog)
 {
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *dlg;
+    pj_uint32_t tag_hval;
 
     PJ_ASSERT_RETURN(call_id && local_tag && remote_tag, NULL);
 
-    /* Lock user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the shard of the user agent. */
+    shard = get_shard_by_tag(local_tag, &tag_hval);
+    pj_mutex_lock(shard->mutex);
 
     /* Lookup the dialog set. */
     dlg_set = (struct dlg_set*)
-              pj_hash_get_lower(mod_ua.dlg_table, local_tag->ptr,
-                                (unsigned)local_tag->slen, NULL);
+              pj_hash_get_lower(shard->dlg_table, local_tag->ptr,
+                                (unsigned)local_tag->slen, &tag_hval);
     if (dlg_set == NULL) {
         /* Not found */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return NULL;
     }
 
@@ -520,7 +596,7 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 
     if (dlg == (pjsip_dialog*)&dlg_set->dlg_list) {
         /* Not found */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return NULL;
     }
 
@@ -530,7 +606,7 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
         PJ_LOG(6, (THIS_FILE, "Dialog not found: local and remote tags "
                               "matched but not call id"));
 
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return NULL;
     }
 
@@ -546,18 +622,18 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
              */
 
             /* Unlock user agent. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
             /* Lock dialog */
             pjsip_dlg_inc_lock(dlg);
 
         } else {
             /* Unlock user agent. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
         }
 
     } else {
         /* Unlock user agent. */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
     }
 
     return dlg;
@@ -566,9 +642,14 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 
 /*
  * Find the first dialog in dialog set in hash table for an incoming message.
+ * On return, the shard where the dialog set is looked up is locked and
+ * returned in p_shard, unless it's NULL.
  */
-static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
+static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata,
+                                             struct dlg_shard **p_shard )
 {
+    *p_shard = NULL;
+
     /* CANCEL message doesn't have To tag, so we must lookup the dialog
      * by finding the INVITE UAS transaction being cancelled.
      */
@@ -596,13 +677,22 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 
         /* We should find the dialog attached to the INVITE transaction */
         if (tsx) {
-            dlg = (pjsip_dialog*) tsx->mod_data[mod_ua.mod.id];
-            pj_grp_lock_dec_ref(tsx->grp_lock);
+            struct dlg_set *dlg_set = NULL;
 
             /* Dlg may be NULL on some extreme condition
-             * (e.g. during debugging where initially there is a dialog)
+             * (e.g. during debugging where initially there is a dialog).
+             * The dialog can't be destroyed while we hold the reference
+             * to its transaction.
              */
-            return dlg ? (struct dlg_set*) dlg->dlg_set : NULL;
+            dlg = (pjsip_dialog*) tsx->mod_data[mod_ua.mod.id];
+            if (dlg) {
+                *p_shard = get_shard(dlg->local.tag_hval);
+                pj_mutex_lock((*p_shard)->mutex);
+                dlg_set = (struct dlg_set*) dlg->dlg_set;
+            }
+            pj_grp_lock_dec_ref(tsx->grp_lock);
+
+            return dlg_set;
 
         } else {
             return NULL;
@@ -612,16 +702,20 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
     } else {
         pj_str_t *tag;
         struct dlg_set *dlg_set;
+        pj_uint32_t tag_hval;
 
         if (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG)
             tag = &rdata->msg_info.to->tag;
         else
             tag = &rdata->msg_info.from->tag;
 
+        *p_shard = get_shard_by_tag(tag, &tag_hval);
+        pj_mutex_lock((*p_shard)->mutex);
+
         /* Lookup the dialog set. */
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower(mod_ua.dlg_table, tag->ptr, 
-                                    (unsigned)tag->slen, NULL);
+                  pj_hash_get_lower((*p_shard)->dlg_table, tag->ptr, 
+                                    (unsigned)tag->slen, &tag_hval);
         return dlg_set;
     }
 }
@@ -629,6 +723,7 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 /* On received requests. */
 static pj_bool_t mod_ua_on_rx_request(pjsip_rx_data *rdata)
 {
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pj_str_t *from_tag;
     pjsip_dialog *dlg;
@@ -649,18 +744,18 @@ static pj_bool_t mod_ua_on_rx_request(pjsip_rx_data *rdata)
 
 retry_on_deadlock:
 
-    /* Lock user agent before looking up the dialog hash table. */
-    pj_mutex_lock(mod_ua.mutex);
-
-    /* Lookup the dialog set, based on the To tag header. */
-    dlg_set = find_dlg_set_for_msg(rdata);
+    /* Lookup the dialog set, based on the To tag header. This will also
+     * lock the user agent's dialog hash table shard.
+     */
+    dlg_set = find_dlg_set_for_msg(rdata, &shard);
 
     /* If dialog is not found, respond with 481 (Call/Transaction
      * Does Not Exist).
      */
     if (dlg_set == NULL) {
         /* Unable to find dialog. */
-        pj_mutex_unlock(mod_ua.mutex);
+        if (shard)
+            pj_mutex_unlock(shard->mutex);
 
         if (rdata->msg_info.msg->line.req.method.id != PJSIP_ACK_METHOD) {
             PJ_LOG(5,(THIS_FILE, 
@@ -701,7 +796,7 @@ retry_on_deadlock:
 
         if (first_dlg->remote.info->tag.slen != 0) {
             /* Not found. Mulfunction UAC? */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
 
             if (rdata->msg_info.msg->line.req.method.id != PJSIP_ACK_METHOD) {
                 PJ_LOG(5,(THIS_FILE, 
@@ -733,13 +828,13 @@ retry_on_deadlock:
          * because of deadlock. Release UA mutex, yield, and retry 
          * the whole thing once again.
          */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         pj_thread_sleep(0);
         goto retry_on_deadlock;
     }
 
     /* Done with processing in UA layer, release lock */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Pass to dialog. */
     pjsip_dlg_on_rx_request(dlg, rdata);
@@ -757,6 +852,7 @@ retry_on_deadlock:
 static pj_bool_t mod_ua_on_rx_response(pjsip_rx_data *rdata)
 {
     pjsip_transaction *tsx;
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *dlg;
     pj_status_t status;
@@ -775,20 +871,19 @@ retry_on_deadlock:
 
     dlg = NULL;
 
-    /* Lock user agent dlg table before we're doing anything. */
-    pj_mutex_lock(mod_ua.mutex);
-
     /* Check if transaction is present. */
     tsx = pjsip_rdata_get_tsx(rdata);
     if (tsx) {
         /* Check if dialog is present in the transaction. */
         dlg = pjsip_tsx_get_dlg(tsx);
         if (!dlg) {
-            /* Unlock dialog hash table. */
-            pj_mutex_unlock(mod_ua.mutex);
             return PJ_FALSE;
         }
 
+        /* Lock the dialog hash table shard of the dialog set. */
+        shard = get_shard(dlg->local.tag_hval);
+        pj_mutex_lock(shard->mutex);
+
         /* Get the dialog set. */
         dlg_set = (struct dlg_set*) dlg->dlg_set;
 
@@ -803,6 +898,7 @@ retry_on_deadlock:
          * dialog.
          */
         pjsip_cseq_hdr *cseq_hdr = rdata->msg_info.cseq;
+        pj_uint32_t tag_hval;
 
         if (cseq_hdr->method.id != PJSIP_INVITE_METHOD ||
             rdata->msg_info.msg->line.status.code / 100 != 2)
@@ -811,22 +907,23 @@ retry_on_deadlock:
              * This must be some stateless response sent by other modules,
              * or a very late response.
              */
-            /* Unlock dialog hash table. */
-            pj_mutex_unlock(mod_ua.mutex);
             return PJ_FALSE;
         }
 
+        /* Lock the dialog hash table shard of the dialog set. */
+        shard = get_shard_by_tag(&rdata->msg_info.from->tag, &tag_hval);
+        pj_mutex_lock(shard->mutex);
 
         /* Get the dialog set. */
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower(mod_ua.dlg_table, 
+                  pj_hash_get_lower(shard->dlg_table, 
                                     rdata->msg_info.from->tag.ptr,
                                     (unsigned)rdata->msg_info.from->tag.slen,
-                                    NULL);
+                                    &tag_hval);
 
         if (!dlg_set) {
             /* Unlock dialog hash table. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
 
             /* Strayed 2xx response!! */
             PJ_LOG(4,(THIS_FILE, 
@@ -896,7 +993,7 @@ retry_on_deadlock:
                 dlg = (*mod_ua.param.on_dlg_forked)(dlg_set->dlg_list.next, 
                                                     rdata);
                 if (dlg == NULL) {
-                    pj_mutex_unlock(mod_ua.mutex);
+                    pj_mutex_unlock(shard->mutex);
                     return PJ_TRUE;
                 }
             } else {
@@ -942,13 +1039,13 @@ retry_on_deadlock:
          * situation, and for safety, try to avoid deadlock by releasing
          * UA mutex, yield, and retry the whole processing once again.
          */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         pj_thread_sleep(0);
         goto retry_on_deadlock;
     }
 
     /* We're done with processing in the UA layer, we can release the mutex */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Pass the response to the dialog. */
     pjsip_dlg_on_rx_response(dlg, rdata);
@@ -994,21 +1091,29 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
     char dlginfo[128];
+    unsigned i, count;
+
+    PJ_ASSERT_ON_FAIL(mod_ua.shards, return);
 
-    pj_mutex_lock(mod_ua.mutex);
+    count = pjsip_ua_get_dlg_set_count();
 
-    PJ_LOG(3, (THIS_FILE, "Number of dialog sets: %u", 
-                          pj_hash_count(mod_ua.dlg_table)));
+    PJ_LOG(3, (THIS_FILE, "Number of dialog sets: %u", count));
 
-    if (detail && pj_hash_count(mod_ua.dlg_table)) {
+    if (detail && count)
         PJ_LOG(3, (THIS_FILE, "Dumping dialog sets:"));
-        it = pj_hash_first(mod_ua.dlg_table, &itbuf);
-        for (; it != NULL; it = pj_hash_next(mod_ua.dlg_table, it))  {
+
+    for (i = 0; detail && i < PJSIP_UA_DLG_TABLE_SHARDS; ++i) {
+        struct dlg_shard *shard = &mod_ua.shards[i];
+
+        pj_mutex_lock(shard->mutex);
+
+        it = pj_hash_first(shard->dlg_table, &itbuf);
+        for (; it != NULL; it = pj_hash_next(shard->dlg_table, it))  {
             struct dlg_set *dlg_set;
             pjsip_dialog *dlg;
             const char *title;
 
-            dlg_set = (struct dlg_set*) pj_hash_this(mod_ua.dlg_table, it);
+            dlg_set = (struct dlg_set*) pj_hash_this(shard->dlg_table, it);
             if (!dlg_set || pj_list_empty(&dlg_set->dlg_list)) continue;
 
             /* First dialog in dialog set. */
@@ -1028,9 +1133,9 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
                 dlg = dlg->next;
             }
         }
-    }
 
-    pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
+    }
 #endif
 }
 
@@ -49,11 +49,54 @@ PJ_DEF(unsigned) pjsua_acc_get_count(void)
  */
 PJ_DEF(pj_bool_t) pjsua_acc_is_valid(pjsua_acc_id acc_id)
 {
-    return acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc) &&
+    return acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc &&
            pjsua_var.acc[acc_id].valid;
 }
 
 
+/*
+ * Get the bucket of user@domain in the account hash table. The hash is
+ * case insensitive, matching the comparison in
+ * pjsua_acc_find_for_incoming().
+ */
+static pjsua_acc_id *get_acc_bucket(const pj_str_t *user,
+                                    const pj_str_t *domain)
+{
+    const pj_str_t at = { "@", 1 };
+    pj_uint32_t hval;
+
+    hval = pj_hash_calc_tolower(0, NULL, user);
+    hval = pj_hash_calc_tolower(hval, NULL, &at);
+    hval = pj_hash_calc_tolower(hval, NULL, domain);
+
+    return &pjsua_var.acc_hash[hval & (pjsua_var.acc_hash_size - 1)];
+}
+
+/* Add account to the user@domain hash table. */
+static void acc_hash_add(pjsua_acc *acc)
+{
+    pjsua_acc_id *bucket = get_acc_bucket(&acc->user_part, &acc->srv_domain);
+
+    acc->hash_next = *bucket;
+    *bucket = acc->index;
+}
+
+/* Remove account from the user@domain hash table. */
+static void acc_hash_remove(pjsua_acc *acc)
+{
+    pjsua_acc_id *p = get_acc_bucket(&acc->user_part, &acc->srv_domain);
+
+    while (*p != PJSUA_INVALID_ID) {
+        if (*p == acc->index) {
+            *p = acc->hash_next;
+            break;
+        }
+        p = &pjsua_var.acc[*p].hash_next;
+    }
+    acc->hash_next = PJSUA_INVALID_ID;
+}
+
+
 /*
  * Set default account
  */
@@ -105,6 +148,7 @@ PJ_DEF(void) pjsua_acc_config_dup( pj_pool_t *pool,
 
     dst->reg_timeout = src->reg_timeout;
     dst->reg_delay_before_refresh = src->reg_delay_before_refresh;
+    dst->reg_refresh_jitter = src->reg_refresh_jitter;
     dst->cred_count = src->cred_count;
 
     for (i=0; i<src->cred_count; ++i) {
@@ -222,12 +266,14 @@ static void init_outbound_setting(pjsua_acc *acc)
  */
 static pj_status_t destroy_regc(pjsua_acc *acc, pj_bool_t force)
 {
+    pj_grp_lock_acquire(acc->grp_lock);
     if (acc->regc) {
         pj_status_t status = pjsip_regc_destroy2(acc->regc, force);
         if (status != PJ_SUCCESS && !force) {
             /* If regc destroy failed and not forced, we should not
              * deinit and return here.
              */
+            pj_grp_lock_release(acc->grp_lock);
             return status;
         }
     }
@@ -236,6 +282,7 @@ static pj_status_t destroy_regc(pjsua_acc *acc, pj_bool_t force)
     acc->reg_mapped_addr.slen = 0;
     acc->rfc5626_status = OUTBOUND_UNKNOWN;
     acc->rfc5626_flowtmr = 0;
+    pj_grp_lock_release(acc->grp_lock);
 
     return PJ_SUCCESS;
 }
@@ -422,7 +469,10 @@ static pj_status_t initialize_acc(unsigned acc_id)
     }
 
     /* Mark account as valid */
+    pj_grp_lock_acquire(acc->grp_lock);
     pjsua_var.acc[acc_id].valid = PJ_TRUE;
+    pj_grp_lock_release(acc->grp_lock);
+    acc_hash_add(acc);
 
     /* Insert account ID into account ID array, sorted by priority */
     for (i=0; i<pjsua_var.acc_cnt; ++i) {
@@ -459,7 +509,7 @@ PJ_DEF(pj_status_t) pjsua_acc_add( const pjsua_acc_config *cfg,
     pj_status_t status = PJ_SUCCESS;
 
     PJ_ASSERT_RETURN(cfg, PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc_cnt < PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(pjsua_var.acc_cnt < pjsua_var.ua_cfg.max_acc,
                      PJ_ETOOMANY);
 
 #if !PJ_HAS_IPV6
@@ -478,13 +528,13 @@ PJ_DEF(pj_status_t) pjsua_acc_add( const pjsua_acc_config *cfg,
     PJSUA_LOCK();
 
     /* Find empty account id. */
-    for (id=0; id < PJ_ARRAY_SIZE(pjsua_var.acc); ++id) {
+    for (id=0; id < pjsua_var.ua_cfg.max_acc; ++id) {
         if (pjsua_var.acc[id].valid == PJ_FALSE)
             break;
     }
 
     /* Expect to find a slot */
-    PJ_ASSERT_ON_FAIL(  id < PJ_ARRAY_SIZE(pjsua_var.acc), 
+    PJ_ASSERT_ON_FAIL(  id < pjsua_var.ua_cfg.max_acc, 
                         {PJSUA_UNLOCK(); return PJ_EBUG;});
 
     acc = &pjsua_var.acc[id];
@@ -632,15 +682,13 @@ PJ_DEF(pj_status_t) pjsua_acc_add_local( pjsua_transport_id tid,
 PJ_DEF(pj_status_t) pjsua_acc_set_user_data(pjsua_acc_id acc_id,
                                             void *user_data)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
 
-    PJSUA_LOCK();
-
+    pj_grp_lock_acquire(pjsua_var.acc[acc_id].grp_lock);
     pjsua_var.acc[acc_id].cfg.user_data = user_data;
-
-    PJSUA_UNLOCK();
+    pj_grp_lock_release(pjsua_var.acc[acc_id].grp_lock);
 
     return PJ_SUCCESS;
 }
@@ -651,11 +699,17 @@ PJ_DEF(pj_status_t) pjsua_acc_set_user_data(pjsua_acc_id acc_id,
  */
 PJ_DEF(void*) pjsua_acc_get_user_data(pjsua_acc_id acc_id)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    void *user_data;
+
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      NULL);
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, NULL);
 
-    return pjsua_var.acc[acc_id].cfg.user_data;
+    pj_grp_lock_acquire(pjsua_var.acc[acc_id].grp_lock);
+    user_data = pjsua_var.acc[acc_id].cfg.user_data;
+    pj_grp_lock_release(pjsua_var.acc[acc_id].grp_lock);
+
+    return user_data;
 }
 
 
@@ -667,7 +721,7 @@ PJ_DEF(pj_status_t) pjsua_acc_del(pjsua_acc_id acc_id)
     pjsua_acc *acc;
     unsigned i;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
 
@@ -709,18 +763,25 @@ PJ_DEF(pj_status_t) pjsua_acc_del(pjsua_acc_id acc_id)
     /* Delete server presence subscription */
     pjsua_pres_delete_acc(acc_id, 0);
 
-    /* Release account pool */
+    /* Remove from user@domain hash table while the strings are valid */
+    acc_hash_remove(acc);
+
+    /* Release account pool and invalidate. Readers that only hold the
+     * account's group lock (e.g. pjsua_acc_get_info()) re-check validity
+     * under it.
+     */
+    pj_grp_lock_acquire(acc->grp_lock);
     if (acc->pool) {
         pj_pool_release(acc->pool);
         acc->pool = NULL;
     }
 
-    /* Invalidate */
     acc->valid = PJ_FALSE;
     pj_bzero(&acc->via_addr, sizeof(acc->via_addr));
     acc->via_tp = NULL;
     acc->next_rtp_port = 0;
     acc->ip_change_op = PJSUA_IP_CHANGE_OP_NULL;
+    pj_grp_lock_release(acc->grp_lock);
 
     /* Remove from array */
     for (i=0; i<pjsua_var.acc_cnt; ++i) {
@@ -759,7 +820,7 @@ PJ_DEF(pj_status_t) pjsua_acc_get_config(pjsua_acc_id acc_id,
                                          pj_pool_t *pool,
                                          pjsua_acc_config *acc_cfg)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc)
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc
                      && pjsua_var.acc[acc_id].valid, PJ_EINVAL);
     //this now would not work due to corrupt header list
     //pj_memcpy(acc_cfg, &pjsua_var.acc[acc_id].cfg, sizeof(*acc_cfg));
@@ -848,7 +909,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
     pj_bool_t update_mwi = PJ_FALSE;
     pj_status_t status = PJ_SUCCESS;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
 
 #if !PJ_HAS_IPV6
@@ -1009,12 +1070,19 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 
     /* == Apply the new config == */
 
-    /* Account ID. */
+    /* Account ID. The fields read by pjsua_acc_get_info() are written
+     * with the account's group lock held too, as it does not take
+     * PJSUA_LOCK.
+     */
     if (id_name_addr && id_sip_uri) {
+        acc_hash_remove(acc);
+        pj_grp_lock_acquire(acc->grp_lock);
         pj_strdup_with_null(acc->pool, &acc->cfg.id, &cfg->id);
+        pj_grp_lock_release(acc->grp_lock);
         pj_strdup_with_null(acc->pool, &acc->display, &id_name_addr->display);
         pj_strdup_with_null(acc->pool, &acc->user_part, &id_sip_uri->user);
         pj_strdup_with_null(acc->pool, &acc->srv_domain, &id_sip_uri->host);
+        acc_hash_add(acc);
         acc->srv_port = 0;
         acc->is_sips = PJSIP_URI_SCHEME_IS_SIPS(id_name_addr);
         update_reg = PJ_TRUE;
@@ -1306,6 +1374,12 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
             pjsip_regc_set_delay_before_refresh(acc->regc,
                                                 cfg->reg_delay_before_refresh);
     }
+    if (acc->cfg.reg_refresh_jitter != cfg->reg_refresh_jitter) {
+        acc->cfg.reg_refresh_jitter = cfg->reg_refresh_jitter;
+        if (acc->regc != NULL)
+            pjsip_regc_set_refresh_jitter(acc->regc,
+                                          cfg->reg_refresh_jitter);
+    }
 
     /* Allow via rewrite */
     if (acc->cfg.allow_via_rewrite != cfg->allow_via_rewrite) {
@@ -1340,7 +1414,9 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
     /* Registrar URI */
     if (pj_strcmp(&acc->cfg.reg_uri, &cfg->reg_uri)) {
         if (cfg->reg_uri.slen) {
+            pj_grp_lock_acquire(acc->grp_lock);
             pj_strdup_with_null(acc->pool, &acc->cfg.reg_uri, &cfg->reg_uri);
+            pj_grp_lock_release(acc->grp_lock);
             if (reg_sip_uri)
                 acc->srv_port = reg_sip_uri->port;
         } 
@@ -1522,7 +1598,7 @@ on_return:
 PJ_DEF(pj_status_t) pjsua_acc_set_online_status( pjsua_acc_id acc_id,
                                                  pj_bool_t is_online)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
 
@@ -1530,8 +1606,13 @@ PJ_DEF(pj_status_t) pjsua_acc_set_online_status( pjsua_acc_id acc_id,
               acc_id, is_online));
     pj_log_push_indent();
 
+    PJSUA_LOCK();
+    pj_grp_lock_acquire(pjsua_var.acc[acc_id].grp_lock);
     pjsua_var.acc[acc_id].online_status = is_online;
     pj_bzero(&pjsua_var.acc[acc_id].rpid, sizeof(pjrpid_element));
+    pj_grp_lock_release(pjsua_var.acc[acc_id].grp_lock);
+    PJSUA_UNLOCK();
+
     pjsua_pres_update_acc(acc_id, PJ_FALSE);
 
     pj_log_pop_indent();
@@ -1546,7 +1627,7 @@ PJ_DEF(pj_status_t) pjsua_acc_set_online_status2( pjsua_acc_id acc_id,
                                                   pj_bool_t is_online,
                                                   const pjrpid_element *pr)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
 
@@ -1555,8 +1636,10 @@ PJ_DEF(pj_status_t) pjsua_acc_set_online_status2( pjsua_acc_id acc_id,
     pj_log_push_indent();
 
     PJSUA_LOCK();
+    pj_grp_lock_acquire(pjsua_var.acc[acc_id].grp_lock);
     pjsua_var.acc[acc_id].online_status = is_online;
     pjrpid_element_dup(pjsua_var.acc[acc_id].pool, &pjsua_var.acc[acc_id].rpid, pr);
+    pj_grp_lock_release(pjsua_var.acc[acc_id].grp_lock);
     PJSUA_UNLOCK();
 
     pjsua_pres_update_acc(acc_id, PJ_TRUE);
@@ -2503,8 +2586,10 @@ static void regc_cb(struct pjsip_regc_cbparam *param)
         PJ_LOG(4, (THIS_FILE, "SIP registration updated status=%d", param->code));
     }
 
+    pj_grp_lock_acquire(acc->grp_lock);
     acc->reg_last_err = param->status;
     acc->reg_last_code = param->code;
+    pj_grp_lock_release(acc->grp_lock);
 
     /* Reaching this point means no contact rewrite, so reset the flag */
     acc->contact_rewritten = PJ_FALSE;
@@ -2526,21 +2611,41 @@ static void regc_cb(struct pjsip_regc_cbparam *param)
         schedule_reregistration(acc);
     }
 
-    /* Call the registration status callback */
+    /* Call the registration status callback. The application is called
+     * without PJSUA lock so that it may block or call back into pjsua
+     * without stalling other accounts; the regc stays alive since it is
+     * still busy invoking us.
+     */
+    if (pjsua_var.ua_cfg.cb.on_reg_state ||
+        pjsua_var.ua_cfg.cb.on_reg_state2)
+    {
+        unsigned num_locks;
+
+        num_locks = PJSUA_RELEASE_LOCK();
 
-    if (pjsua_var.ua_cfg.cb.on_reg_state) {
-        (*pjsua_var.ua_cfg.cb.on_reg_state)(acc->index);
-    }
+        if (pjsua_var.ua_cfg.cb.on_reg_state) {
+            (*pjsua_var.ua_cfg.cb.on_reg_state)(acc->index);
+        }
+
+        if (pjsua_var.ua_cfg.cb.on_reg_state2) {
+            pjsua_reg_info reg_info;
+            pjsip_regc_info rinfo;
+
+            pjsip_regc_get_info(param->regc, &rinfo);
+            reg_info.cbparam = param;
+            reg_info.regc = param->regc;
+            reg_info.renew = !param->is_unreg;
+            (*pjsua_var.ua_cfg.cb.on_reg_state2)(acc->index, &reg_info);
+        }
 
-    if (pjsua_var.ua_cfg.cb.on_reg_state2) {
-        pjsua_reg_info reg_info;
-        pjsip_regc_info rinfo;
+        PJSUA_RELOCK(num_locks);
 
-        pjsip_regc_get_info(param->regc, &rinfo);
-        reg_info.cbparam = param;
-        reg_info.regc = param->regc;
-        reg_info.renew = !param->is_unreg;
-        (*pjsua_var.ua_cfg.cb.on_reg_state2)(acc->index, &reg_info);
+        /* The account may have been deleted by the callback */
+        if (!acc->valid) {
+            PJSUA_UNLOCK();
+            pj_log_pop_indent();
+            return;
+        }
     }
 
     if (acc->ip_change_op == PJSUA_IP_CHANGE_OP_ACC_UPDATE_CONTACT) {
@@ -2619,8 +2724,10 @@ static pj_status_t pjsua_regc_init(int acc_id)
 
     /* initialize SIP registration if registrar is configured */
 
+    pj_grp_lock_acquire(acc->grp_lock);
     status = pjsip_regc_create( pjsua_var.endpt, 
                                 acc, &regc_cb, &acc->regc);
+    pj_grp_lock_release(acc->grp_lock);
 
     if (status != PJ_SUCCESS) {
         pjsua_perror(THIS_FILE, "Unable to create client registration", 
@@ -2680,6 +2787,11 @@ static pj_status_t pjsua_regc_init(int acc_id)
     /* Set delay before registration refresh */
     pjsip_regc_set_delay_before_refresh(acc->regc,
                                         acc->cfg.reg_delay_before_refresh);
+    pjsip_regc_set_refresh_jitter(acc->regc, acc->cfg.reg_refresh_jitter);
+
+    /* Share the REGISTER rate limit with the other accounts */
+    if (pjsua_var.reg_pacer)
+        pjsip_regc_set_pacer(acc->regc, pjsua_var.reg_pacer);
 
     /* Set authentication preference */
     pjsip_regc_set_prefs(acc->regc, &acc->cfg.auth_pref);
@@ -2850,7 +2962,7 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
     pj_status_t status = 0;
     pjsip_tx_data *tdata = 0;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
 
@@ -3018,14 +3130,17 @@ PJ_DEF(pj_status_t) pjsua_acc_get_info( pjsua_acc_id acc_id,
     
     pj_bzero(info, sizeof(pjsua_acc_info));
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc), 
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc, 
                      PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
 
-    PJSUA_LOCK();
+    /* Only the account's group lock is needed here, so querying one
+     * account does not contend with activity on the others.
+     */
+    pj_grp_lock_acquire(acc->grp_lock);
     
     if (pjsua_var.acc[acc_id].valid == PJ_FALSE) {
-        PJSUA_UNLOCK();
+        pj_grp_lock_release(acc->grp_lock);
         return PJ_EINVALIDOP;
     }
 
@@ -3068,7 +3183,7 @@ PJ_DEF(pj_status_t) pjsua_acc_get_info( pjsua_acc_id acc_id,
         info->expires = PJSIP_EXPIRES_NOT_SPECIFIED;
     }
 
-    PJSUA_UNLOCK();
+    pj_grp_lock_release(acc->grp_lock);
 
     return PJ_SUCCESS;
 
@@ -3087,7 +3202,7 @@ PJ_DEF(pj_status_t) pjsua_enum_accs(pjsua_acc_id ids[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (i=0, c=0; c<*count && i<pjsua_var.ua_cfg.max_acc; ++i) {
         if (!pjsua_var.acc[i].valid)
             continue;
         ids[c] = i;
@@ -3114,7 +3229,7 @@ PJ_DEF(pj_status_t) pjsua_acc_enum_info( pjsua_acc_info info[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (i=0, c=0; c<*count && i<pjsua_var.ua_cfg.max_acc; ++i) {
         if (!pjsua_var.acc[i].valid)
             continue;
 
@@ -3159,14 +3274,14 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
         !PJSIP_URI_SCHEME_IS_SIPS(uri)) 
     {
         /* Return the first account with proxy */
-        for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<pjsua_var.ua_cfg.max_acc; ++i) {
             if (!pjsua_var.acc[i].valid)
                 continue;
             if (!pj_list_empty(&pjsua_var.acc[i].route_set))
                 break;
         }
 
-        if (i != PJ_ARRAY_SIZE(pjsua_var.acc)) {
+        if (i != pjsua_var.ua_cfg.max_acc) {
             /* Found rather matching account */
             pj_pool_release(tmp_pool);
             PJSUA_UNLOCK();
@@ -3212,6 +3327,75 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
 }
 
 
+/* Get the score of the account for incoming request, see below. */
+static int get_acc_score(const pjsua_acc *acc, const pjsip_rx_data *rdata,
+                         const pjsip_sip_uri *sip_uri,
+                         const pjsip_sip_uri *request_sip_uri)
+{
+    int score = 0;
+
+    /* Match transport type */
+    if (acc->tp_type == rdata->tp_info.transport->key.type ||
+        acc->tp_type == PJSIP_TRANSPORT_UNSPECIFIED)
+    {
+        score |= 8;
+    }
+
+    /* Match domain */
+    if (pj_stricmp(&acc->srv_domain, &sip_uri->host)==0) {
+        score |= 4;
+    }
+
+    /* Match username */
+    if (pj_stricmp(&acc->user_part, &sip_uri->user)==0) {
+        score |= 2;
+    }
+
+    /* Match username of request URI */
+    if (request_sip_uri && pj_stricmp(&acc->user_part, &request_sip_uri->user)==0) {
+        score |= 1;
+    }
+
+    return score;
+}
+
+/* Find the account for incoming request in the user@domain hash table.
+ * Returns PJSUA_INVALID_ID if the result is not conclusive.
+ */
+static pjsua_acc_id find_acc_in_hash(const pjsip_rx_data *rdata,
+                                     const pjsip_sip_uri *sip_uri,
+                                     const pjsip_sip_uri *request_sip_uri,
+                                     int *p_score)
+{
+    pjsua_acc_id id = PJSUA_INVALID_ID;
+    pjsua_acc_id acc_id;
+    pj_bool_t tie = PJ_FALSE;
+    int max_score = 0;
+
+    acc_id = *get_acc_bucket(&sip_uri->user, &sip_uri->host);
+    while (acc_id != PJSUA_INVALID_ID) {
+        const pjsua_acc *acc = &pjsua_var.acc[acc_id];
+        int score = get_acc_score(acc, rdata, sip_uri, request_sip_uri);
+
+        if (score > max_score) {
+            id = acc_id;
+            max_score = score;
+            tie = PJ_FALSE;
+        } else if (score == max_score) {
+            tie = PJ_TRUE;
+        }
+        acc_id = acc->hash_next;
+    }
+
+    /* Ties are resolved by account priority in the full scan */
+    if (max_score < (8 | 4 | 2) || tie)
+        return PJSUA_INVALID_ID;
+
+    *p_score = max_score;
+    return id;
+}
+
+
 /*
  * This is an internal function to find the most appropriate account to be
  * used to handle incoming calls.
@@ -3270,37 +3454,23 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_incoming(pjsip_rx_data *rdata)
         request_sip_uri = (pjsip_sip_uri*)pjsip_uri_get_uri(request_uri);
     }
 
+    /* Accounts matching the transport, domain, and user part all live in
+     * the same user@domain hash bucket. If exactly one of them has the best
+     * score there, no other account can beat it, otherwise fall back to
+     * scanning the accounts in priority order.
+     */
     max_score = 0;
-    for (i=0; i < pjsua_var.acc_cnt; ++i) {
-        unsigned acc_id = pjsua_var.acc_ids[i];
-        pjsua_acc *acc = &pjsua_var.acc[acc_id];
-        int score = 0;
+    id = find_acc_in_hash(rdata, sip_uri, request_sip_uri, &max_score);
 
-        if (!acc->valid)
-            continue;
-
-        /* Match transport type */
-        if (acc->tp_type == rdata->tp_info.transport->key.type ||
-            acc->tp_type == PJSIP_TRANSPORT_UNSPECIFIED)
-        {
-            score |= 8;
-        }
+    for (i=0; id == PJSUA_INVALID_ID && i < pjsua_var.acc_cnt; ++i) {
+        pjsua_acc_id acc_id = pjsua_var.acc_ids[i];
+        int score;
 
-        /* Match domain */
-        if (pj_stricmp(&acc->srv_domain, &sip_uri->host)==0) {
-            score |= 4;
-        }
-
-        /* Match username */
-        if (pj_stricmp(&acc->user_part, &sip_uri->user)==0) {
-            score |= 2;
-        }
-
-        /* Match username of request URI */
-        if (request_sip_uri && pj_stricmp(&acc->user_part, &request_sip_uri->user)==0) {
-            score |= 1;
-        }
+        if (!pjsua_var.acc[acc_id].valid)
+            continue;
 
+        score = get_acc_score(&pjsua_var.acc[acc_id], rdata, sip_uri,
+                              request_sip_uri);
         if (score > max_score) {
             id = acc_id;
             max_score = score;
@@ -4269,7 +4439,7 @@ void pjsua_acc_on_tp_state_changed(pjsip_transport *tp,
     /* Enumerate accounts using this transport and perform actions
      * based on the transport state.
      */
-    for (i = 0; i < PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (i = 0; i < pjsua_var.ua_cfg.max_acc; ++i) {
         pjsua_acc *acc = &pjsua_var.acc[i];
 
         /* Skip if this account is not valid. */
@@ -4587,7 +4757,7 @@ void pjsua_acc_end_ip_change(pjsua_acc *acc)
                    "completed", acc->index));
         acc->ip_change_op = PJSUA_IP_CHANGE_OP_COMPLETED;
         if (pjsua_var.acc_cnt) {
-            for (; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+            for (; i < (int)pjsua_var.ua_cfg.max_acc; ++i) {
                 if (pjsua_var.acc[i].valid &&
                     pjsua_var.acc[i].ip_change_op !=
                                                   PJSUA_IP_CHANGE_OP_COMPLETED)
@@ -155,8 +155,11 @@ static pj_status_t call_inv_end_session(pjsua_call *call,
 static void reset_call(pjsua_call_id id)
 {
     pjsua_call *call = &pjsua_var.calls[id];
+    pj_grp_lock_t *grp_lock = pjsua_var.call_grp_lock[id];
     unsigned i;
 
+    pj_grp_lock_acquire(grp_lock);
+
     if (call->incoming_data) {
         pjsip_rx_data_free_cloned(call->incoming_data);
         call->incoming_data = NULL;
@@ -184,6 +187,24 @@ static void reset_call(pjsua_call_id id)
     pj_bzero(&call->trickle_ice, sizeof(call->trickle_ice));
     pj_timer_entry_init(&call->trickle_ice.timer, 0, call,
                         &trickle_ice_send_sip_info);
+
+    pj_grp_lock_release(grp_lock);
+}
+
+/*
+ * Set the invite session and dialog of the call slot. These are read by
+ * acquire_call() and pjsua_call_get_info() while holding only the slot's
+ * group lock.
+ */
+static void set_call_session(pjsua_call *call, pjsip_inv_session *inv,
+                             pjsip_dialog *dlg)
+{
+    pj_grp_lock_t *grp_lock = pjsua_var.call_grp_lock[call->index];
+
+    pj_grp_lock_acquire(grp_lock);
+    call->inv = inv;
+    call->async_call.dlg = dlg;
+    pj_grp_lock_release(grp_lock);
 }
 
 /* Get DTMF method type name */
@@ -209,17 +230,12 @@ pj_status_t pjsua_call_subsys_init(const pjsua_config *cfg)
     const pj_str_t str_trickle_ice = { "trickle-ice", 11 };
     pj_status_t status;
 
-    /* Init calls array. */
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.calls); ++i)
-        reset_call(i);
-
     /* Copy config */
     pjsua_config_dup(pjsua_var.pool, &pjsua_var.ua_cfg, cfg);
 
-    /* Verify settings */
-    if (pjsua_var.ua_cfg.max_calls >= PJSUA_MAX_CALLS) {
-        pjsua_var.ua_cfg.max_calls = PJSUA_MAX_CALLS;
-    }
+    /* Init calls array (allocated by pjsua_init() with max_calls entries) */
+    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i)
+        reset_call(i);
 
     /* Check the route URI's and force loose route if required */
     for (i=0; i<pjsua_var.ua_cfg.outbound_proxy_cnt; ++i) {
@@ -520,7 +536,7 @@ on_make_call_med_tp_complete(pjsua_call_id call_id,
     }
 
     /* Create and associate our data in the session. */
-    call->inv = inv;
+    set_call_session(call, inv, dlg);
 
     dlg->mod_data[pjsua_var.mod.id] = call;
     inv->mod_data[pjsua_var.mod.id] = call;
@@ -570,7 +586,8 @@ on_make_call_med_tp_complete(pjsua_call_id call_id,
         /* Upon failure to send first request, the invite
          * session would have been cleared.
          */
-        call->inv = inv = NULL;
+        inv = NULL;
+        set_call_session(call, NULL, dlg);
         goto on_error;
     }
 
@@ -598,11 +615,11 @@ on_error:
 
     /* This may destroy the dialog */
     pjsip_dlg_dec_lock(dlg);
-    call->async_call.dlg = NULL;
+    set_call_session(call, call->inv, NULL);
 
     if (inv != NULL) {
         pjsip_inv_terminate(inv, PJSIP_SC_OK, PJ_FALSE);
-        call->inv = NULL;
+        set_call_session(call, NULL, NULL);
     }
 
     if (call_id != -1) {
@@ -834,7 +851,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
     pj_status_t status;
 
     /* Check that account is valid */
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
 
     /* Check arguments */
@@ -974,7 +991,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
         call->async_call.call_var.out_call.msg_data = pjsua_msg_data_clone(
                                                           dlg->pool, msg_data);
     }
-    call->async_call.dlg = dlg;
+    set_call_session(call, NULL, dlg);
 
     /* Temporarily increment dialog session. Without this, dialog will be
      * prematurely destroyed if dec_lock() is called on the dialog before
@@ -1017,7 +1034,7 @@ on_error:
     if (dlg && call) {
         /* This may destroy the dialog */
         pjsip_dlg_dec_lock(dlg);
-        call->async_call.dlg = NULL;
+        set_call_session(call, call->inv, NULL);
     }
 
     if (call_id != -1) {
@@ -1953,13 +1970,11 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     pjsua_init_tpselector(acc_id, &tp_sel);
     pjsip_dlg_set_transport(dlg, &tp_sel);
 
-    /* Create and attach pjsua_var data to the dialog */
-    call->inv = inv;
-
-    /* Store variables required for the callback after the async
-     * media transport creation is completed.
+    /* Create and attach pjsua_var data to the dialog. Also store
+     * variables required for the callback after the async media transport
+     * creation is completed.
      */
-    call->async_call.dlg = dlg;
+    set_call_session(call, inv, dlg);
     pj_list_init(&call->async_call.call_var.inc_call.answers);
 
     pjsip_dlg_inc_session(dlg, &pjsua_var.mod);
@@ -1996,8 +2011,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
             }
             pjsip_dlg_dec_lock(dlg);
 
-            call->inv = NULL;
-            call->async_call.dlg = NULL;
+            set_call_session(call, NULL, NULL);
             goto on_return;
         }
         status = pjsua_media_channel_init(call->index, PJSIP_ROLE_UAS,
@@ -2046,8 +2060,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
                 }
                 pjsip_dlg_dec_lock(dlg);
 
-                call->inv = NULL;
-                call->async_call.dlg = NULL;
+                set_call_session(call, NULL, NULL);
                 goto on_return;
             }
         } else if (status != PJ_EPENDING) {
@@ -2061,8 +2074,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
             }
             pjsip_dlg_dec_lock(dlg);
 
-            call->inv = NULL;
-            call->async_call.dlg = NULL;
+            set_call_session(call, NULL, NULL);
             goto on_return;
         }
     }
@@ -2089,8 +2101,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
         pjsip_inv_terminate(inv, ret_st_code, PJ_FALSE);
 
         pjsua_media_channel_deinit(call->index);
-        call->inv = NULL;
-        call->async_call.dlg = NULL;
+        set_call_session(call, NULL, NULL);
 
         goto on_return;
     }
@@ -2131,8 +2142,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
             pjsip_inv_terminate(inv, ret_st_code, PJ_FALSE);
         }
         pjsua_media_channel_deinit(call->index);
-        call->inv = NULL;
-        call->async_call.dlg = NULL;
+        set_call_session(call, NULL, NULL);
         goto on_return;
 
     } else {
@@ -2141,8 +2151,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
         if (status != PJ_SUCCESS) {
             pjsua_perror(THIS_FILE, "Unable to send 100 response", status);
             pjsua_media_channel_deinit(call->index);
-            call->inv = NULL;
-            call->async_call.dlg = NULL;
+            set_call_session(call, NULL, NULL);
             goto on_return;
         }
 #endif
@@ -2183,7 +2192,13 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
              * invoked from on_create_media_transport().
              */
             if (call->incoming_data) {
+                /* Invoke the application without PJSUA lock; the dialog
+                 * lock we still hold keeps this call stable, while other
+                 * calls can progress meanwhile.
+                 */
+                unsigned num_locks = PJSUA_RELEASE_LOCK();
                 pjsua_var.ua_cfg.cb.on_incoming_call(acc_id, call_id, rdata);
+                PJSUA_RELOCK(num_locks);
             }
 
             /* Notes:
@@ -2242,11 +2257,19 @@ on_return:
  */
 PJ_DEF(pj_bool_t) pjsua_call_is_active(pjsua_call_id call_id)
 {
+    pjsua_call *call;
+    pj_bool_t active;
+
     PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
                      PJ_EINVAL);
-    return !pjsua_var.calls[call_id].hanging_up &&
-           pjsua_var.calls[call_id].inv != NULL &&
-           pjsua_var.calls[call_id].inv->state != PJSIP_INV_STATE_DISCONNECTED;
+
+    call = &pjsua_var.calls[call_id];
+    pj_grp_lock_acquire(pjsua_var.call_grp_lock[call_id]);
+    active = !call->hanging_up && call->inv != NULL &&
+             call->inv->state != PJSIP_INV_STATE_DISCONNECTED;
+    pj_grp_lock_release(pjsua_var.call_grp_lock[call_id]);
+
+    return active;
 }
 
 
@@ -2257,8 +2280,8 @@ pj_status_t acquire_call(const char *title,
                                 pjsip_dialog **p_dlg)
 {
     unsigned retry;
-    pjsua_call *call = NULL;
-    pj_bool_t has_pjsua_lock = PJ_FALSE;
+    pjsua_call *call = &pjsua_var.calls[call_id];
+    pj_grp_lock_t *grp_lock = pjsua_var.call_grp_lock[call_id];
     pj_status_t status = PJ_SUCCESS;
     pj_time_val time_start, timeout;
     pjsip_dialog *dlg = NULL;
@@ -2279,48 +2302,38 @@ pj_status_t acquire_call(const char *title,
                 break;
         }
 
-        has_pjsua_lock = PJ_FALSE;
-
-        status = PJSUA_TRY_LOCK();
-        if (status != PJ_SUCCESS) {
-            pj_thread_sleep(retry/10);
-            continue;
-        }
+        /* The slot's group lock is never held while waiting for another
+         * lock, so it is safe to block on it here. Only the dialog needs
+         * the try-and-retry loop.
+         */
+        pj_grp_lock_acquire(grp_lock);
 
-        has_pjsua_lock = PJ_TRUE;
-        call = &pjsua_var.calls[call_id];
         if (call->inv)
             dlg = call->inv->dlg;
         else
             dlg = call->async_call.dlg;
 
         if (dlg == NULL) {
-            PJSUA_UNLOCK();
+            pj_grp_lock_release(grp_lock);
             PJ_LOG(3,(THIS_FILE, "Invalid call_id %d in %s", call_id, title));
             return PJSIP_ESESSIONTERMINATED;
         }
 
         status = pjsip_dlg_try_inc_lock(dlg);
+        pj_grp_lock_release(grp_lock);
+
         if (status != PJ_SUCCESS) {
-            PJSUA_UNLOCK();
             pj_thread_sleep(retry/10);
             continue;
         }
 
-        PJSUA_UNLOCK();
-
         break;
     }
 
     if (status != PJ_SUCCESS) {
-        if (has_pjsua_lock == PJ_FALSE)
-            PJ_LOG(1,(THIS_FILE, "Timed-out trying to acquire PJSUA mutex "
-                                 "(possibly system has deadlocked) in %s",
-                                 title));
-        else
-            PJ_LOG(1,(THIS_FILE, "Timed-out trying to acquire dialog mutex "
-                                 "(possibly system has deadlocked) in %s",
-                                 title));
+        PJ_LOG(1,(THIS_FILE, "Timed-out trying to acquire dialog mutex "
+                             "(possibly system has deadlocked) in %s",
+                             title));
         return PJ_ETIMEDOUT;
     }
 
@@ -2338,6 +2351,7 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
                                          pjsua_call_info *info)
 {
     pjsua_call *call;
+    pj_grp_lock_t *grp_lock;
     pjsip_dialog *dlg;
     unsigned mi;
 
@@ -2346,15 +2360,17 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
 
     pj_bzero(info, sizeof(*info));
 
-    /* Use PJSUA_LOCK() instead of acquire_call():
+    /* Use the slot's group lock instead of acquire_call(), to avoid
+     * waiting for the dialog:
      *  https://github.com/pjsip/pjproject/issues/1371
      */
-    PJSUA_LOCK();
-
     call = &pjsua_var.calls[call_id];
+    grp_lock = pjsua_var.call_grp_lock[call_id];
+    pj_grp_lock_acquire(grp_lock);
+
     dlg = (call->inv ? call->inv->dlg : call->async_call.dlg);
     if (!dlg) {
-        PJSUA_UNLOCK();
+        pj_grp_lock_release(grp_lock);
         return PJSIP_ESESSIONTERMINATED;
     }
 
@@ -2541,7 +2557,7 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
         PJ_TIME_VAL_SUB(info->total_duration, call->start_time);
     }
 
-    PJSUA_UNLOCK();
+    pj_grp_lock_release(grp_lock);
 
     return PJ_SUCCESS;
 }
@@ -5171,7 +5187,7 @@ static void pjsua_call_on_state_changed(pjsip_inv_session *inv,
         PJSUA_LOCK();
 
         /* Free call */
-        call->inv = NULL;
+        set_call_session(call, NULL, call->async_call.dlg);
 
         pj_assert(pjsua_var.call_cnt > 0);
         --pjsua_var.call_cnt;
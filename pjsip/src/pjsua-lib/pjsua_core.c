@@ -56,9 +56,6 @@ static void init_data()
 
     pj_bzero(&pjsua_var, sizeof(pjsua_var));
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i)
-        pjsua_var.acc[i].index = i;
-    
     for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.tpdata); ++i)
         pjsua_var.tpdata[i].index = i;
 
@@ -69,6 +66,13 @@ static void init_data()
 
     pjsua_config_default(&pjsua_var.ua_cfg);
 
+    /* The call, account and buddy tables are only allocated by
+     * pjsua_init(), so keep their sizes zero until then.
+     */
+    pjsua_var.ua_cfg.max_calls = 0;
+    pjsua_var.ua_cfg.max_acc = 0;
+    pjsua_var.ua_cfg.max_buddies = 0;
+
     for (i=0; i<PJSUA_MAX_VID_WINS; ++i) {
         pjsua_vid_win_reset(i);
     }
@@ -104,6 +108,8 @@ PJ_DEF(void) pjsua_config_default(pjsua_config *cfg)
     pj_bzero(cfg, sizeof(*cfg));
 
     cfg->max_calls = PJSUA_MAX_CALLS;
+    cfg->max_acc = PJSUA_MAX_ACC;
+    cfg->max_buddies = PJSUA_MAX_BUDDIES;
     cfg->thread_cnt = PJSUA_SEPARATE_WORKER_FOR_TIMER? 2 : 1;
     cfg->nat_type_in_sdp = 1;
     cfg->stun_ignore_failure = PJ_TRUE;
@@ -1025,6 +1031,79 @@ static void upnp_cb(pj_status_t status)
 }
 #endif
 
+/* Get the number of hash buckets for a table with the specified size. */
+static unsigned get_hash_size(unsigned max_cnt)
+{
+    unsigned size = 8;
+
+    while (size < max_cnt)
+        size <<= 1;
+    return size;
+}
+
+/*
+ * Allocate the call, account and buddy tables. This must be done before
+ * the config is copied to pjsua_var.ua_cfg, since the table sizes are
+ * taken from there.
+ */
+static pj_status_t alloc_tables(const pjsua_config *cfg)
+{
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(cfg->max_calls > 0 && cfg->max_acc > 0, PJ_EINVAL);
+
+    pjsua_var.calls = (pjsua_call*)
+                      pj_pool_calloc(pjsua_var.pool, cfg->max_calls,
+                                     sizeof(pjsua_call));
+    pjsua_var.call_grp_lock = (pj_grp_lock_t**)
+                              pj_pool_calloc(pjsua_var.pool, cfg->max_calls,
+                                             sizeof(pj_grp_lock_t*));
+    for (i=0; i<cfg->max_calls; ++i) {
+        status = pj_grp_lock_create(pjsua_var.pool, NULL,
+                                    &pjsua_var.call_grp_lock[i]);
+        if (status != PJ_SUCCESS)
+            return status;
+        pj_grp_lock_add_ref(pjsua_var.call_grp_lock[i]);
+    }
+
+    pjsua_var.acc = (pjsua_acc*)
+                    pj_pool_calloc(pjsua_var.pool, cfg->max_acc,
+                                   sizeof(pjsua_acc));
+    pjsua_var.acc_ids = (pjsua_acc_id*)
+                        pj_pool_calloc(pjsua_var.pool, cfg->max_acc,
+                                       sizeof(pjsua_acc_id));
+    pjsua_var.acc_hash_size = get_hash_size(cfg->max_acc);
+    pjsua_var.acc_hash = (pjsua_acc_id*)
+                         pj_pool_alloc(pjsua_var.pool,
+                                       pjsua_var.acc_hash_size *
+                                       sizeof(pjsua_acc_id));
+    for (i=0; i<pjsua_var.acc_hash_size; ++i)
+        pjsua_var.acc_hash[i] = PJSUA_INVALID_ID;
+    for (i=0; i<cfg->max_acc; ++i) {
+        pjsua_var.acc[i].index = i;
+        pjsua_var.acc[i].hash_next = PJSUA_INVALID_ID;
+        status = pj_grp_lock_create(pjsua_var.pool, NULL,
+                                    &pjsua_var.acc[i].grp_lock);
+        if (status != PJ_SUCCESS)
+            return status;
+        pj_grp_lock_add_ref(pjsua_var.acc[i].grp_lock);
+    }
+
+    pjsua_var.buddy = (pjsua_buddy*)
+                      pj_pool_calloc(pjsua_var.pool, cfg->max_buddies,
+                                     sizeof(pjsua_buddy));
+    pjsua_var.buddy_hash_size = get_hash_size(cfg->max_buddies);
+    pjsua_var.buddy_hash = (pjsua_buddy_id*)
+                           pj_pool_alloc(pjsua_var.pool,
+                                         pjsua_var.buddy_hash_size *
+                                         sizeof(pjsua_buddy_id));
+    for (i=0; i<pjsua_var.buddy_hash_size; ++i)
+        pjsua_var.buddy_hash[i] = PJSUA_INVALID_ID;
+
+    return PJ_SUCCESS;
+}
+
 /*
  * Initialize pjsua with the specified settings. All the settings are 
  * optional, and the default values will be used when the config is not
@@ -1201,6 +1280,19 @@ PJ_DEF(pj_status_t) pjsua_init( const pjsua_config *ua_cfg,
     }
     
 
+    /* Allocate call, account, and buddy tables */
+    status = alloc_tables(ua_cfg);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    /* Create REGISTER rate limiter shared by all accounts */
+    if (ua_cfg->reg_max_rate) {
+        status = pjsip_regc_pacer_create(pjsua_var.pool, ua_cfg->reg_max_rate,
+                                         &pjsua_var.reg_pacer);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+
     /* Initialize PJSUA call subsystem: */
     status = pjsua_call_subsys_init(ua_cfg);
     if (status != PJ_SUCCESS)
@@ -1947,7 +2039,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         }
 
         /* Set all accounts to offline */
-        for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_acc; ++i) {
             if (!pjsua_var.acc[i].valid)
                 continue;
             pjsua_var.acc[i].online_status = PJ_FALSE;
@@ -1962,7 +2054,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
          */
         /* First stage, get the maximum wait time */
         max_wait = 100;
-        for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_acc; ++i) {
             if (!pjsua_var.acc[i].valid)
                 continue;
             if (pjsua_var.acc[i].cfg.unpublish_max_wait_time_msec > max_wait)
@@ -1977,21 +2069,21 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         /* Second stage, wait for unpublications to complete */
         for (i=0; i<(int)(max_wait/50); ++i) {
             unsigned j;
-            for (j=0; j<PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
+            for (j=0; j<pjsua_var.ua_cfg.max_acc; ++j) {
                 if (!pjsua_var.acc[j].valid)
                     continue;
 
                 if (pjsua_var.acc[j].publish_sess)
                     break;
             }
-            if (j != PJ_ARRAY_SIZE(pjsua_var.acc))
+            if (j != pjsua_var.ua_cfg.max_acc)
                 busy_sleep(50);
             else
                 break;
         }
 
         /* Third stage, forcefully destroy unfinished unpublications */
-        for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_acc; ++i) {
             if (pjsua_var.acc[i].publish_sess) {
                 pjsip_publishc_destroy(pjsua_var.acc[i].publish_sess);
                 pjsua_var.acc[i].publish_sess = NULL;
@@ -1999,7 +2091,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         }
 
         /* Unregister all accounts */
-        for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_acc; ++i) {
             if (!pjsua_var.acc[i].valid)
                 continue;
 
@@ -2016,7 +2108,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         /* Wait until all unregistrations are done (ticket #364) */
         /* First stage, get the maximum wait time */
         max_wait = 100;
-        for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_acc; ++i) {
             if (!pjsua_var.acc[i].valid)
                 continue;
             if (pjsua_var.acc[i].cfg.unreg_timeout > max_wait)
@@ -2031,14 +2123,14 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         /* Second stage, wait for unregistrations to complete */
         for (i=0; i<(int)(max_wait/50); ++i) {
             unsigned j;
-            for (j=0; j<PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
+            for (j=0; j<pjsua_var.ua_cfg.max_acc; ++j) {
                 if (!pjsua_var.acc[j].valid)
                     continue;
 
                 if (pjsua_var.acc[j].regc)
                     break;
             }
-            if (j != PJ_ARRAY_SIZE(pjsua_var.acc))
+            if (j != pjsua_var.ua_cfg.max_acc)
                 busy_sleep(50);
             else
                 break;
@@ -2098,7 +2190,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         pjsua_var.endpt = NULL;
 
         /* Destroy pool in the buddy object */
-        for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_buddies; ++i) {
             if (pjsua_var.buddy[i].pool) {
                 pj_pool_release(pjsua_var.buddy[i].pool);
                 pjsua_var.buddy[i].pool = NULL;
@@ -2106,7 +2198,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         }
 
         /* Destroy accounts */
-        for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_acc; ++i) {
             if (pjsua_var.acc[i].pool) {
                 pj_pool_release(pjsua_var.acc[i].pool);
                 pjsua_var.acc[i].pool = NULL;
@@ -2114,6 +2206,30 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         }
     }
 
+    /* Destroy REGISTER rate limiter, now that all regc are gone */
+    if (pjsua_var.reg_pacer) {
+        pjsip_regc_pacer_destroy(pjsua_var.reg_pacer);
+        pjsua_var.reg_pacer = NULL;
+    }
+
+    /* Destroy call and account group locks */
+    if (pjsua_var.call_grp_lock) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_calls; ++i) {
+            if (pjsua_var.call_grp_lock[i]) {
+                pj_grp_lock_dec_ref(pjsua_var.call_grp_lock[i]);
+                pjsua_var.call_grp_lock[i] = NULL;
+            }
+        }
+    }
+    if (pjsua_var.acc) {
+        for (i=0; i<(int)pjsua_var.ua_cfg.max_acc; ++i) {
+            if (pjsua_var.acc[i].grp_lock) {
+                pj_grp_lock_dec_ref(pjsua_var.acc[i].grp_lock);
+                pjsua_var.acc[i].grp_lock = NULL;
+            }
+        }
+    }
+
 #if defined(PJNATH_HAS_UPNP) && (PJNATH_HAS_UPNP != 0)
     /* Deinitialize UPnP */
     if (pjsua_var.ua_cfg.enable_upnp) {
@@ -2593,9 +2709,15 @@ PJ_DEF(pj_status_t) pjsua_transport_create( pjsip_transport_type_e type,
         addr_name.host = pj_str(hostbuf);
         addr_name.port = pj_sockaddr_get_port(&pub_addr);
 
-        /* Create UDP transport */
+        /* Create UDP transport. Keep one pending read per worker thread
+         * so that incoming requests for different calls can be processed
+         * in parallel.
+         */
         status = pjsip_udp_transport_attach2(pjsua_var.endpt, type, sock,
-                                             &addr_name, 1, &tp);
+                                             &addr_name,
+                                             PJ_MAX(pjsua_var.ua_cfg.thread_cnt,
+                                                    1),
+                                             &tp);
         if (status != PJ_SUCCESS) {
             pjsua_perror(THIS_FILE, "Error creating SIP UDP transport", 
                          status);
@@ -3685,7 +3807,9 @@ static pj_status_t handle_ip_change_on_acc()
 {
     int i = 0;
     pj_status_t status = PJ_SUCCESS;
-    pj_bool_t acc_done[PJSUA_MAX_ACC];
+    pj_pool_t *tmp_pool;
+    pj_bool_t *acc_done;
+    pjsua_acc_id *shut_acc_ids;
 
     PJSUA_LOCK();
 
@@ -3697,19 +3821,25 @@ static pj_status_t handle_ip_change_on_acc()
         return status;
     }
 
+    tmp_pool = pjsua_pool_create("tmpipchg", 512, 512);
+    acc_done = (pj_bool_t*) pj_pool_calloc(tmp_pool, pjsua_var.ua_cfg.max_acc,
+                                           sizeof(pj_bool_t));
+    shut_acc_ids = (pjsua_acc_id*) pj_pool_calloc(tmp_pool,
+                                                  pjsua_var.ua_cfg.max_acc,
+                                                  sizeof(pjsua_acc_id));
+
     /* Reset ip_change_active flag. */
-    for (; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (; i < (int)pjsua_var.ua_cfg.max_acc; ++i) {
         pjsua_var.acc[i].ip_change_op = PJSUA_IP_CHANGE_OP_NULL;
         acc_done[i] = PJ_FALSE;
     }
 
-    for (i = 0; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (i = 0; i < (int)pjsua_var.ua_cfg.max_acc; ++i) {
         pj_bool_t shutdown_transport = PJ_FALSE;
         pjsip_regc_info regc_info;
         char acc_id[PJSUA_MAX_ACC * 4];
         pjsua_acc *acc = &pjsua_var.acc[i];
         pjsip_transport *transport = NULL;
-        pjsua_acc_id shut_acc_ids[PJSUA_MAX_ACC];
         unsigned shut_acc_cnt = 0;
 
         if (!acc->valid || (acc_done[i]))
@@ -3780,7 +3910,7 @@ static pj_status_t handle_ip_change_on_acc()
             int j = i + 1;
 
             /* Find other account that uses the same transport. */
-            for (; j < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
+            for (; j < (int)pjsua_var.ua_cfg.max_acc; ++j) {
                 pjsip_regc_info tmp_regc_info;
                 pjsua_acc *next_acc = &pjsua_var.acc[j];
 
@@ -3832,6 +3962,7 @@ static pj_status_t handle_ip_change_on_acc()
             }
         }
     }
+    pj_pool_release(tmp_pool);
     PJSUA_UNLOCK();
     return status;
 }
@@ -3966,7 +4097,7 @@ PJ_DEF(pj_status_t) pjsua_handle_ip_change(const pjsua_ip_change_param *param)
 
     PJ_ASSERT_RETURN(param, PJ_EINVAL);
 
-    for (; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (; i < (int)pjsua_var.ua_cfg.max_acc; ++i) {
         if (pjsua_var.acc[i].valid &&
             pjsua_var.acc[i].ip_change_op != PJSUA_IP_CHANGE_OP_NULL &&
             pjsua_var.acc[i].ip_change_op != PJSUA_IP_CHANGE_OP_COMPLETED)
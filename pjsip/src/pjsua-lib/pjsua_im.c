@@ -545,7 +545,7 @@ PJ_DEF(pj_status_t) pjsua_im_send( pjsua_acc_id acc_id,
     pjsip_tpselector tp_sel;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
 
     content_in_msg_data = msg_data && (msg_data->msg_body.slen ||
@@ -672,7 +672,7 @@ PJ_DEF(pj_status_t) pjsua_im_typing( pjsua_acc_id acc_id,
     pjsip_tpselector tp_sel;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
 
     acc = &pjsua_var.acc[acc_id];
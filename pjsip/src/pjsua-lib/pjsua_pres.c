@@ -27,13 +27,55 @@ static void subscribe_buddy_presence(pjsua_buddy_id buddy_id);
 static void unsubscribe_buddy_presence(pjsua_buddy_id buddy_id);
 
 
+/*
+ * Get the bucket of user@host in the buddy hash table. The port is not
+ * included, since port zero matches buddies with port 5060.
+ */
+static pjsua_buddy_id *get_buddy_bucket(const pj_str_t *user,
+                                        const pj_str_t *host)
+{
+    const pj_str_t at = { "@", 1 };
+    pj_uint32_t hval;
+
+    hval = pj_hash_calc_tolower(0, NULL, user);
+    hval = pj_hash_calc_tolower(hval, NULL, &at);
+    hval = pj_hash_calc_tolower(hval, NULL, host);
+
+    return &pjsua_var.buddy_hash[hval & (pjsua_var.buddy_hash_size - 1)];
+}
+
+/* Add buddy to the hash table. */
+static void buddy_hash_add(pjsua_buddy *buddy)
+{
+    pjsua_buddy_id *bucket = get_buddy_bucket(&buddy->name, &buddy->host);
+
+    buddy->hash_next = *bucket;
+    *bucket = buddy->index;
+}
+
+/* Remove buddy from the hash table. */
+static void buddy_hash_remove(pjsua_buddy *buddy)
+{
+    pjsua_buddy_id *p = get_buddy_bucket(&buddy->name, &buddy->host);
+
+    while (*p != PJSUA_INVALID_ID) {
+        if (*p == (pjsua_buddy_id)buddy->index) {
+            *p = buddy->hash_next;
+            break;
+        }
+        p = &pjsua_var.buddy[*p].hash_next;
+    }
+    buddy->hash_next = PJSUA_INVALID_ID;
+}
+
 /*
  * Find buddy.
  */
 static pjsua_buddy_id find_buddy(const pjsip_uri *uri)
 {
     const pjsip_sip_uri *sip_uri;
-    unsigned i;
+    pjsua_buddy_id id = PJSUA_INVALID_ID;
+    pjsua_buddy_id i;
 
     uri = (const pjsip_uri*) pjsip_uri_get_uri((pjsip_uri*)uri);
 
@@ -42,22 +84,23 @@ static pjsua_buddy_id find_buddy(const pjsip_uri *uri)
 
     sip_uri = (const pjsip_sip_uri*) uri;
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    /* Return the lowest matching index, as the buddy list is ordered */
+    for (i = *get_buddy_bucket(&sip_uri->user, &sip_uri->host);
+         i != PJSUA_INVALID_ID; i = pjsua_var.buddy[i].hash_next)
+    {
         const pjsua_buddy *b = &pjsua_var.buddy[i];
 
-        if (!pjsua_buddy_is_valid(i))
-            continue;
-
         if (pj_stricmp(&sip_uri->user, &b->name)==0 &&
             pj_stricmp(&sip_uri->host, &b->host)==0 &&
-            (sip_uri->port==(int)b->port || (sip_uri->port==0 && b->port==5060)))
+            (sip_uri->port==(int)b->port || (sip_uri->port==0 && b->port==5060)) &&
+            (id == PJSUA_INVALID_ID || i < id))
         {
             /* Match */
-            return i;
+            id = i;
         }
     }
 
-    return PJSUA_INVALID_ID;
+    return id;
 }
 
 #define LOCK_DIALOG     1
@@ -184,7 +227,7 @@ PJ_DEF(pjsua_buddy_id) pjsua_buddy_find(const pj_str_t *uri_str)
  */
 PJ_DEF(pj_bool_t) pjsua_buddy_is_valid(pjsua_buddy_id buddy_id)
 {
-    return buddy_id>=0 && buddy_id<(int)PJ_ARRAY_SIZE(pjsua_var.buddy) &&
+    return buddy_id>=0 && buddy_id<(int)pjsua_var.ua_cfg.max_buddies &&
            pjsua_var.buddy[buddy_id].uri.slen != 0;
 }
 
@@ -201,7 +244,7 @@ PJ_DEF(pj_status_t) pjsua_enum_buddies( pjsua_buddy_id ids[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    for (i=0, c=0; c<*count && i<pjsua_var.ua_cfg.max_buddies; ++i) {
         if (!pjsua_var.buddy[i].uri.slen)
             continue;
         ids[c] = i;
@@ -373,6 +416,7 @@ static void reset_buddy(pjsua_buddy_id id)
     pj_bzero(&pjsua_var.buddy[id], sizeof(pjsua_var.buddy[id]));
     pjsua_var.buddy[id].pool = pool;
     pjsua_var.buddy[id].index = id;
+    pjsua_var.buddy[id].hash_next = PJSUA_INVALID_ID;
 }
 
 
@@ -389,7 +433,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
     pj_str_t tmp;
 
     PJ_ASSERT_RETURN(pjsua_var.buddy_cnt <= 
-                        PJ_ARRAY_SIZE(pjsua_var.buddy),
+                        pjsua_var.ua_cfg.max_buddies,
                      PJ_ETOOMANY);
 
     PJ_LOG(4,(THIS_FILE, "Adding buddy: %.*s",
@@ -399,16 +443,16 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
     PJSUA_LOCK();
 
     /* Find empty slot */
-    for (index=0; index<(int)PJ_ARRAY_SIZE(pjsua_var.buddy); ++index) {
+    for (index=0; index<(int)pjsua_var.ua_cfg.max_buddies; ++index) {
         if (pjsua_var.buddy[index].uri.slen == 0)
             break;
     }
 
     /* Expect to find an empty slot */
-    if (index == PJ_ARRAY_SIZE(pjsua_var.buddy)) {
+    if (index == pjsua_var.ua_cfg.max_buddies) {
         PJSUA_UNLOCK();
         /* This shouldn't happen */
-        pj_assert(!"index < PJ_ARRAY_SIZE(pjsua_var.buddy)");
+        pj_assert(!"index < pjsua_var.ua_cfg.max_buddies");
         pj_log_pop_indent();
         return PJ_ETOOMANY;
     }
@@ -468,6 +512,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_add( const pjsua_buddy_config *cfg,
     pjsua_var.buddy[index].monitor = cfg->subscribe;
     if (pjsua_var.buddy[index].port == 0)
         pjsua_var.buddy[index].port = 5060;
+    buddy_hash_add(&pjsua_var.buddy[index]);
 
     /* Save user data */
     pjsua_var.buddy[index].user_data = (void*)cfg->user_data;
@@ -497,7 +542,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_del(pjsua_buddy_id buddy_id)
     pj_status_t status;
 
     PJ_ASSERT_RETURN(buddy_id>=0 && 
-                        buddy_id<(int)PJ_ARRAY_SIZE(pjsua_var.buddy),
+                        buddy_id<(int)pjsua_var.ua_cfg.max_buddies,
                      PJ_EINVAL);
 
     if (pjsua_var.buddy[buddy_id].uri.slen == 0) {
@@ -521,6 +566,7 @@ PJ_DEF(pj_status_t) pjsua_buddy_del(pjsua_buddy_id buddy_id)
     }
 
     /* Remove buddy */
+    buddy_hash_remove(&pjsua_var.buddy[buddy_id]);
     pjsua_var.buddy[buddy_id].uri.slen = 0;
     pjsua_var.buddy_cnt--;
 
@@ -626,7 +672,7 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
         
         int count = 0;
 
-        for (acc_id=0; acc_id<PJ_ARRAY_SIZE(pjsua_var.acc); ++acc_id) {
+        for (acc_id=0; acc_id<pjsua_var.ua_cfg.max_acc; ++acc_id) {
 
             if (!pjsua_var.acc[acc_id].valid)
                 continue;
@@ -647,7 +693,7 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
 
         count = 0;
 
-        for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+        for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
             if (pjsua_var.buddy[i].uri.slen == 0)
                 continue;
             if (pjsua_var.buddy[i].sub) {
@@ -667,7 +713,7 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
      */
     PJ_LOG(3,(THIS_FILE, "Dumping pjsua server subscriptions:"));
 
-    for (acc_id=0; acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++acc_id) {
+    for (acc_id=0; acc_id<(int)pjsua_var.ua_cfg.max_acc; ++acc_id) {
 
         if (!pjsua_var.acc[acc_id].valid)
             continue;
@@ -705,7 +751,7 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
         PJ_LOG(3,(THIS_FILE, "  - no buddy list - "));
 
     } else {
-        for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+        for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
 
             if (pjsua_var.buddy[i].uri.slen == 0)
                 continue;
@@ -1075,7 +1121,7 @@ PJ_DEF(pj_status_t) pjsua_pres_notify( pjsua_acc_id acc_id,
     PJ_ASSERT_RETURN(acc_id!=-1 && srv_pres, PJ_EINVAL);
 
     /* Check that account ID is valid */
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc,
                      PJ_EINVAL);
     /* Check that account is valid */
     PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
@@ -1978,7 +2024,7 @@ static pj_status_t refresh_client_subscriptions(void)
     unsigned i;
     pj_status_t status;
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
         struct buddy_lock lck;
 
         if (!pjsua_buddy_is_valid(i))
@@ -2104,7 +2150,7 @@ pj_status_t pjsua_start_mwi(pjsua_acc_id acc_id, pj_bool_t force_renew)
     pjsip_tpselector tp_sel;
     pj_status_t status = PJ_SUCCESS;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc)
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.ua_cfg.max_acc
                      && pjsua_var.acc[acc_id].valid, PJ_EINVAL);
 
     acc = &pjsua_var.acc[acc_id];
@@ -2378,7 +2424,7 @@ static void pres_timer_cb(pj_timer_heap_t *th,
     entry->id = PJ_FALSE;
 
     /* Retry failed PUBLISH and MWI SUBSCRIBE requests */
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (i=0; i<pjsua_var.ua_cfg.max_acc; ++i) {
         pjsua_acc *acc = &pjsua_var.acc[i];
 
         /* Acc may not be ready yet, otherwise assertion will happen */
@@ -2420,7 +2466,7 @@ pj_status_t pjsua_pres_init()
                      status);
     }
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
         reset_buddy(i);
     }
 
@@ -2470,20 +2516,20 @@ void pjsua_pres_shutdown(unsigned flags)
         pjsua_var.pres_timer.id = PJ_FALSE;
     }
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (i=0; i<pjsua_var.ua_cfg.max_acc; ++i) {
         if (!pjsua_var.acc[i].valid)
             continue;
         pjsua_pres_delete_acc(i, flags);
     }
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.buddy); ++i) {
+    for (i=0; i<pjsua_var.ua_cfg.max_buddies; ++i) {
         pjsua_var.buddy[i].monitor = 0;
     }
 
     if ((flags & PJSUA_DESTROY_NO_TX_MSG) == 0) {
         refresh_client_subscriptions();
 
-        for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+        for (i=0; i<pjsua_var.ua_cfg.max_acc; ++i) {
             if (pjsua_var.acc[i].valid)
                 pjsua_pres_update_acc(i, PJ_FALSE);
         }
@@ -232,6 +232,7 @@ void AccountRegConfig::readObject(const ContainerNode &node)
     NODE_READ_UNSIGNED  (this_node, firstRetryIntervalSec);
     NODE_READ_UNSIGNED  (this_node, randomRetryIntervalSec);
     NODE_READ_UNSIGNED  (this_node, delayBeforeRefreshSec);
+    NODE_READ_UNSIGNED  (this_node, refreshJitterSec);
     NODE_READ_BOOL      (this_node, dropCallsOnFail);
     NODE_READ_UNSIGNED  (this_node, unregWaitMsec);
     NODE_READ_UNSIGNED  (this_node, proxyUse);
@@ -252,6 +253,7 @@ void AccountRegConfig::writeObject(ContainerNode &node) const
     NODE_WRITE_UNSIGNED (this_node, firstRetryIntervalSec);
     NODE_WRITE_UNSIGNED (this_node, randomRetryIntervalSec);
     NODE_WRITE_UNSIGNED (this_node, delayBeforeRefreshSec);
+    NODE_WRITE_UNSIGNED (this_node, refreshJitterSec);
     NODE_WRITE_BOOL     (this_node, dropCallsOnFail);
     NODE_WRITE_UNSIGNED (this_node, unregWaitMsec);
     NODE_WRITE_UNSIGNED (this_node, proxyUse);
@@ -581,6 +583,7 @@ void AccountConfig::toPj(pjsua_acc_config &ret) const
     ret.reg_first_retry_interval= regConfig.firstRetryIntervalSec;
     ret.reg_retry_random_interval= regConfig.randomRetryIntervalSec;
     ret.reg_delay_before_refresh= regConfig.delayBeforeRefreshSec;
+    ret.reg_refresh_jitter      = regConfig.refreshJitterSec;
     ret.drop_calls_on_reg_fail  = regConfig.dropCallsOnFail;
     ret.unreg_timeout           = regConfig.unregWaitMsec;
     ret.reg_use_proxy           = regConfig.proxyUse;
@@ -741,6 +744,7 @@ void AccountConfig::fromPj(const pjsua_acc_config &prm,
     regConfig.firstRetryIntervalSec = prm.reg_first_retry_interval;
     regConfig.randomRetryIntervalSec = prm.reg_retry_random_interval;
     regConfig.delayBeforeRefreshSec = prm.reg_delay_before_refresh;
+    regConfig.refreshJitterSec  = prm.reg_refresh_jitter;
     regConfig.dropCallsOnFail   = PJ2BOOL(prm.drop_calls_on_reg_fail);
     regConfig.unregWaitMsec     = prm.unreg_timeout;
     regConfig.proxyUse          = prm.reg_use_proxy;
@@ -1111,10 +1115,10 @@ const BuddyVector& Account::enumBuddies() const PJSUA2_THROW(Error)
 BuddyVector2 Account::enumBuddies2() const PJSUA2_THROW(Error)
 {
     BuddyVector2 bv2;
-    pjsua_buddy_id ids[PJSUA_MAX_BUDDIES];
-    unsigned i, count = PJSUA_MAX_BUDDIES;
+    unsigned i, count = pjsua_get_buddy_count();
+    std::vector<pjsua_buddy_id> ids(count + 1);
 
-    PJSUA2_CHECK_EXPR( pjsua_enum_buddies(ids, &count) );
+    PJSUA2_CHECK_EXPR( pjsua_enum_buddies(&ids[0], &count) );
     for (i = 0; i < count; ++i) {
         bv2.push_back(Buddy(ids[i]));
     }
@@ -258,6 +258,8 @@ void UaConfig::fromPj(const pjsua_config &ua_cfg)
     unsigned i;
 
     this->maxCalls = ua_cfg.max_calls;
+    this->maxAccounts = ua_cfg.max_acc;
+    this->maxBuddies = ua_cfg.max_buddies;
     this->threadCnt = ua_cfg.thread_cnt;
     this->userAgent = pj2Str(ua_cfg.user_agent);
 
@@ -279,6 +281,7 @@ void UaConfig::fromPj(const pjsua_config &ua_cfg)
     this->enableUpnp = PJ2BOOL(ua_cfg.enable_upnp);
     this->upnpIfName = pj2Str(ua_cfg.upnp_if_name);
     this->ignoreUnexpectedInvites = PJ2BOOL(ua_cfg.ignore_unexpected_invites);
+    this->regMaxRate = ua_cfg.reg_max_rate;
 }
 
 pjsua_config UaConfig::toPj() const
@@ -289,6 +292,8 @@ pjsua_config UaConfig::toPj() const
     pjsua_config_default(&pua_cfg);
 
     pua_cfg.max_calls = this->maxCalls;
+    pua_cfg.max_acc = this->maxAccounts;
+    pua_cfg.max_buddies = this->maxBuddies;
     pua_cfg.thread_cnt = this->threadCnt;
     pua_cfg.user_agent = str2Pj(this->userAgent);
 
@@ -320,6 +325,7 @@ pjsua_config UaConfig::toPj() const
     pua_cfg.enable_upnp = this->enableUpnp;
     pua_cfg.upnp_if_name = str2Pj(this->upnpIfName);
     pua_cfg.ignore_unexpected_invites = this->ignoreUnexpectedInvites;
+    pua_cfg.reg_max_rate = this->regMaxRate;
 
     return pua_cfg;
 }
@@ -329,6 +335,8 @@ void UaConfig::readObject(const ContainerNode &node) PJSUA2_THROW(Error)
     ContainerNode this_node = node.readContainer("UaConfig");
 
     NODE_READ_UNSIGNED( this_node, maxCalls);
+    NODE_READ_UNSIGNED( this_node, maxAccounts);
+    NODE_READ_UNSIGNED( this_node, maxBuddies);
     NODE_READ_UNSIGNED( this_node, threadCnt);
     NODE_READ_BOOL    ( this_node, mainThreadOnly);
     NODE_READ_STRINGV ( this_node, nameserver);
@@ -341,6 +349,7 @@ void UaConfig::readObject(const ContainerNode &node) PJSUA2_THROW(Error)
     NODE_READ_BOOL    ( this_node, enableUpnp);
     NODE_READ_STRING  ( this_node, upnpIfName);
     NODE_READ_BOOL    ( this_node, ignoreUnexpectedInvites);
+    NODE_READ_UNSIGNED( this_node, regMaxRate);
 }
 
 void UaConfig::writeObject(ContainerNode &node) const PJSUA2_THROW(Error)
@@ -348,6 +357,8 @@ void UaConfig::writeObject(ContainerNode &node) const PJSUA2_THROW(Error)
     ContainerNode this_node = node.writeNewContainer("UaConfig");
 
     NODE_WRITE_UNSIGNED( this_node, maxCalls);
+    NODE_WRITE_UNSIGNED( this_node, maxAccounts);
+    NODE_WRITE_UNSIGNED( this_node, maxBuddies);
     NODE_WRITE_UNSIGNED( this_node, threadCnt);
     NODE_WRITE_BOOL    ( this_node, mainThreadOnly);
     NODE_WRITE_STRINGV ( this_node, nameserver);
@@ -360,6 +371,7 @@ void UaConfig::writeObject(ContainerNode &node) const PJSUA2_THROW(Error)
     NODE_WRITE_BOOL    ( this_node, enableUpnp);
     NODE_WRITE_STRING  ( this_node, upnpIfName);
     NODE_WRITE_BOOL    ( this_node, ignoreUnexpectedInvites);
+    NODE_WRITE_UNSIGNED( this_node, regMaxRate);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -22,6 +22,9 @@
 
 #define THIS_FILE       "json.cpp"
 
+/* Buffer size to read and write JSON files */
+#define FILE_BUF_SIZE   4000
+
 using namespace pj;
 using namespace std;
 
@@ -113,6 +116,19 @@ void JsonDocument::initRoot() const
     rootNode.data.data2 = root->value.children.next;
 }
 
+static pj_status_t json_file_reader(char *buf,
+                                    unsigned *size,
+                                    void *user_data)
+{
+    pj_oshandle_t fd = (pj_oshandle_t)user_data;
+    pj_ssize_t ssize = (pj_ssize_t)*size;
+    pj_status_t status;
+
+    status = pj_file_read(fd, buf, &ssize);
+    *size = (status == PJ_SUCCESS && ssize > 0) ? (unsigned)ssize : 0;
+    return status;
+}
+
 void JsonDocument::loadFile(const string &filename) PJSUA2_THROW(Error)
 {
     if (root)
@@ -127,9 +143,13 @@ void JsonDocument::loadFile(const string &filename) PJSUA2_THROW(Error)
         PJSUA2_RAISE_ERROR(PJ_ETOOSMALL);
     pj_status_t status;
 
-    char *buffer = (char*)pj_pool_alloc(pool, size+1);
+    /* Parse the file incrementally with a temporary pool, so that only
+     * the elements are kept in the document's pool.
+     */
+    pj_pool_t *tmp_pool = NULL;
     pj_oshandle_t fd = 0;
-    unsigned parse_size;
+    pj_json_pull_parser *parser;
+    pj_json_token token;
     char err_msg[120];
     pj_json_err_info err_info;
 
@@ -139,36 +159,52 @@ void JsonDocument::loadFile(const string &filename) PJSUA2_THROW(Error)
     if (status != PJ_SUCCESS)
         goto on_error;
 
-    status = pj_file_read(fd, buffer, &size);
-    if (status != PJ_SUCCESS)
+    tmp_pool = pj_pool_create(&cp.factory, "jsonload", FILE_BUF_SIZE + 512,
+                              512, NULL);
+    if (!tmp_pool) {
+        status = PJ_ENOMEM;
         goto on_error;
+    }
 
-    pj_file_close(fd);
-    fd = NULL;
-
-    if (size <= 0) {
-        status = PJ_EEOF;
+    status = pj_json_pull_create(tmp_pool, &json_file_reader, fd,
+                                 FILE_BUF_SIZE, &parser);
+    if (status != PJ_SUCCESS)
         goto on_error;
-    }
 
-    parse_size = (unsigned)size;
-    root = pj_json_parse(pool, buffer, &parse_size, &err_info);
-    if (root == NULL) {
-        pj_ansi_snprintf(err_msg, sizeof(err_msg),
-                         "JSON parsing failed: syntax error in file '%s' at "
-                         "line %d column %d",
-                         filename.c_str(), err_info.line, err_info.col);
-        PJ_LOG(1,(THIS_FILE, "%s", err_msg));
+    status = pj_json_pull_next(parser, &token);
+    if (status == PJ_SUCCESS &&
+        token.type != PJ_JSON_TOKEN_OBJ_START &&
+        token.type != PJ_JSON_TOKEN_ARRAY_START)
+    {
         status = PJLIB_UTIL_EINJSON;
+    }
+    if (status == PJ_SUCCESS)
+        status = pj_json_pull_read_elem(parser, pool, &token, &root);
+
+    if (status != PJ_SUCCESS) {
+        root = NULL;
+        if (status == PJLIB_UTIL_EINJSON) {
+            pj_json_pull_get_err_info(parser, &err_info);
+            pj_ansi_snprintf(err_msg, sizeof(err_msg),
+                             "JSON parsing failed: syntax error in file '%s' "
+                             "at line %d column %d",
+                             filename.c_str(), err_info.line, err_info.col);
+            PJ_LOG(1,(THIS_FILE, "%s", err_msg));
+        }
         goto on_error;
     }
 
+    pj_file_close(fd);
+    pj_pool_release(tmp_pool);
+
     initRoot();
     return;
 
 on_error:
     if (fd)
         pj_file_close(fd);
+    if (tmp_pool)
+        pj_pool_release(tmp_pool);
     if (err_msg[0])
         PJSUA2_RAISE_ERROR3(status, "loadFile()", err_msg);
     else
@@ -215,6 +251,33 @@ static pj_status_t json_file_writer(const char *s,
     return pj_file_write(sd->fd, s, &ssize);
 }
 
+/* Write the document with the stream writer, which passes the output to
+ * the writer callback in large chunks instead of token by token.
+ */
+static pj_status_t json_stream_write(pj_pool_factory *pf,
+                                     const pj_json_elem *root,
+                                     pj_json_writer writer,
+                                     void *user_data)
+{
+    pj_pool_t *tmp_pool;
+    pj_json_stream *js;
+    pj_status_t status;
+
+    tmp_pool = pj_pool_create(pf, "jsonsave", FILE_BUF_SIZE + 512, 512, NULL);
+    if (!tmp_pool)
+        return PJ_ENOMEM;
+
+    status = pj_json_stream_create(tmp_pool, writer, user_data,
+                                   FILE_BUF_SIZE, &js);
+    if (status == PJ_SUCCESS)
+        status = pj_json_stream_add_elem(js, root);
+    if (status == PJ_SUCCESS)
+        status = pj_json_stream_flush(js);
+
+    pj_pool_release(tmp_pool);
+    return status;
+}
+
 void JsonDocument::saveFile(const string &filename) PJSUA2_THROW(Error)
 {
     struct save_file_data sd;
@@ -227,7 +290,7 @@ void JsonDocument::saveFile(const string &filename) PJSUA2_THROW(Error)
     if (status != PJ_SUCCESS)
         PJSUA2_RAISE_ERROR(status);
 
-    status = pj_json_writef(root, &json_file_writer, &sd.fd);
+    status = json_stream_write(&cp.factory, root, &json_file_writer, &sd);
     pj_file_close(sd.fd);
 
     if (status != PJ_SUCCESS)
@@ -256,7 +319,7 @@ string JsonDocument::saveString() PJSUA2_THROW(Error)
     /* Make sure root container has been created */
     getRootContainer();
 
-    status = pj_json_writef(root, &json_string_writer, &sd);
+    status = json_stream_write(&cp.factory, root, &json_string_writer, &sd);
     if (status != PJ_SUCCESS)
         PJSUA2_RAISE_ERROR(status);
 
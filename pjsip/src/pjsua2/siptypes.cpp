@@ -208,6 +208,7 @@ pjsip_tls_setting TlsConfig::toPj() const
     ts.qos_params       = this->qosParams;
     ts.qos_ignore_error = this->qosIgnoreError;
     ts.enable_renegotiation = this->enableRenegotiation;
+    ts.enable_ktls = this->enableKtls;
 
     return ts;
 }
@@ -234,6 +235,7 @@ void TlsConfig::fromPj(const pjsip_tls_setting &prm)
     this->qosParams     = prm.qos_params;
     this->qosIgnoreError = PJ2BOOL(prm.qos_ignore_error);
     this->enableRenegotiation = PJ2BOOL(prm.enable_renegotiation);
+    this->enableKtls = PJ2BOOL(prm.enable_ktls);
 }
 
 void TlsConfig::readObject(const ContainerNode &node) PJSUA2_THROW(Error)
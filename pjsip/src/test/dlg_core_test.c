@@ -19,4 +19,177 @@
 
 #include "test.h"
 #include <pjsip.h>
+#include <pjlib.h>
 
+
+#define THIS_FILE   "dlg_core_test.c"
+
+enum
+{
+    DLG_CNT     = 1000,
+    THREAD_CNT  = 4,
+    LOOKUP_CNT  = 100000
+};
+
+static pjsip_dialog *dlgs[DLG_CNT];
+static pj_atomic_t *lookup_err;
+
+
+/* Find all registered dialogs over and over, from several threads. */
+static int lookup_thread(void *arg)
+{
+    unsigned i, idx = (unsigned)(pj_ssize_t)arg;
+
+    for (i = 0; i < LOOKUP_CNT; ++i) {
+        pjsip_dialog *dlg = dlgs[idx];
+
+        if (pjsip_ua_find_dialog(&dlg->call_id->id, &dlg->local.info->tag,
+                                 &dlg->remote.info->tag, PJ_FALSE) != dlg)
+        {
+            pj_atomic_inc(lookup_err);
+        }
+        idx = (idx + 7) % DLG_CNT;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Dialog registration and lookup in the user agent layer.
+ */
+int dlg_core_test(void)
+{
+    const pj_str_t local_uri = { "<sip:alice@example.com>", 23 };
+    const pj_str_t remote_uri = { "<sip:bob@example.com>", 21 };
+    const pj_str_t unknown_tag = { "no-such-tag", 11 };
+    pj_thread_t *threads[THREAD_CNT];
+    pj_pool_t *pool = NULL;
+    pj_timestamp t1, t2;
+    unsigned i, dlg_set_cnt, created = 0;
+    pj_uint32_t usec;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  dialog core test.."));
+
+    /* Init UA layer */
+    if (pjsip_ua_instance()->id == -1) {
+        pjsip_ua_init_param ua_param;
+        pj_bzero(&ua_param, sizeof(ua_param));
+        pjsip_ua_init_module(endpt, &ua_param);
+    }
+
+    dlg_set_cnt = pjsip_ua_get_dlg_set_count();
+
+    for (i = 0; i < DLG_CNT; ++i) {
+        status = pjsip_dlg_create_uac(pjsip_ua_instance(), &local_uri, NULL,
+                                      &remote_uri, NULL, &dlgs[i]);
+        if (status != PJ_SUCCESS) {
+            app_perror("   error: unable to create dialog", status);
+            rc = -10;
+            goto on_return;
+        }
+        ++created;
+    }
+
+    if (pjsip_ua_get_dlg_set_count() != dlg_set_cnt + DLG_CNT) {
+        PJ_LOG(3,(THIS_FILE, "   error: invalid dialog set count %u",
+                  pjsip_ua_get_dlg_set_count()));
+        rc = -20;
+        goto on_return;
+    }
+
+    /* Lookup */
+    for (i = 0; i < DLG_CNT; ++i) {
+        pjsip_dialog *dlg = dlgs[i];
+
+        if (pjsip_ua_find_dialog(&dlg->call_id->id, &dlg->local.info->tag,
+                                 &dlg->remote.info->tag, PJ_FALSE) != dlg)
+        {
+            rc = -30;
+            goto on_return;
+        }
+
+        /* Must not match dialog with different Call-ID */
+        if (pjsip_ua_find_dialog(&dlgs[(i+1) % DLG_CNT]->call_id->id,
+                                 &dlg->local.info->tag,
+                                 &dlg->remote.info->tag, PJ_FALSE) != NULL)
+        {
+            rc = -40;
+            goto on_return;
+        }
+    }
+
+    if (pjsip_ua_find_dialog(&dlgs[0]->call_id->id, &unknown_tag,
+                             &dlgs[0]->remote.info->tag, PJ_FALSE) != NULL)
+    {
+        rc = -50;
+        goto on_return;
+    }
+
+    /* Concurrent lookup */
+    pool = pjsip_endpt_create_pool(endpt, "dlgtest", 512, 512);
+    status = pj_atomic_create(pool, 0, &lookup_err);
+    if (status != PJ_SUCCESS) {
+        rc = -60;
+        goto on_return;
+    }
+
+    pj_get_timestamp(&t1);
+    for (i = 0; i < THREAD_CNT; ++i) {
+        status = pj_thread_create(pool, "dlgtest", &lookup_thread,
+                                  (void*)(pj_ssize_t)(i * DLG_CNT / THREAD_CNT),
+                                  0, 0, &threads[i]);
+        if (status != PJ_SUCCESS) {
+            app_perror("   error: unable to create thread", status);
+            rc = -70;
+            break;
+        }
+    }
+    while (i > 0) {
+        --i;
+        pj_thread_join(threads[i]);
+        pj_thread_destroy(threads[i]);
+    }
+    pj_get_timestamp(&t2);
+
+    if (rc != 0)
+        goto on_return;
+
+    if (pj_atomic_get(lookup_err) != 0) {
+        PJ_LOG(3,(THIS_FILE, "   error: %ld failed lookups",
+                  (long)pj_atomic_get(lookup_err)));
+        rc = -80;
+        goto on_return;
+    }
+
+    usec = pj_elapsed_usec(&t1, &t2);
+    if (usec == 0) usec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "   %d threads, %d lookups in %u usec",
+              THREAD_CNT, THREAD_CNT * LOOKUP_CNT, usec));
+    report_ival("dlg-lookup-per-sec",
+                (int)((pj_uint64_t)THREAD_CNT * LOOKUP_CNT * 1000000 / usec),
+                "lookup/sec",
+                "Number of dialog lookups per second in the user agent "
+                "layer, with several threads looking up concurrently");
+
+on_return:
+    for (i = 0; i < created; ++i)
+        pjsip_dlg_terminate(dlgs[i]);
+
+    if (rc == 0 && pjsip_ua_get_dlg_set_count() != dlg_set_cnt) {
+        PJ_LOG(3,(THIS_FILE, "   error: dialog sets are not unregistered"));
+        rc = -90;
+    }
+
+    if (lookup_err) {
+        pj_atomic_destroy(lookup_err);
+        lookup_err = NULL;
+    }
+    if (pool)
+        pjsip_endpt_release_pool(endpt, pool);
+
+    return rc;
+}
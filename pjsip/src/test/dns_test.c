@@ -529,6 +529,232 @@ static void create_ref(pjsip_server_addresses *r,
 }
 
 
+#if defined(PJ_HAS_IPV6) && PJ_HAS_IPV6 && PJSIP_RESOLVE_FAMILY_DELAY > 0
+/*
+ * Resolve host with both A and AAAA queries and check that the address
+ * families alternate in the result, and that a pending AAAA query does
+ * not hold back the A records for longer than PJSIP_RESOLVE_FAMILY_DELAY.
+ */
+static int dual_family_test(pj_pool_t *pool, pj_dns_resolver *resv)
+{
+    static const char *v4[] = { "8.8.8.1", "8.8.8.2", "8.8.8.3" };
+    static const char *v6[] = { "2001:db8::1", "2001:db8::2" };
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr ans[3];
+    pj_in_addr v4only_addr;
+    pjsip_host_info dest;
+    struct result result;
+    pj_time_val t1, t2;
+    pj_str_t tmp;
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, " dual_family_test()"));
+
+    /* dual.example.com has three A and two AAAA records, and
+     * v4only.example.com has A record but its AAAA query is not cached
+     * (and will not be answered by the nameserver).
+     */
+    pj_bzero(&pkt, sizeof(pkt));
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.q = &q;
+    pkt.ans = ans;
+    q.dnsclass = PJ_DNS_CLASS_IN;
+
+    q.name = pj_str("dual.example.com");
+    q.type = PJ_DNS_TYPE_A;
+    pkt.hdr.anscount = PJ_ARRAY_SIZE(v4);
+    for (i=0; i<PJ_ARRAY_SIZE(v4); ++i) {
+        pj_in_addr addr;
+
+        pj_inet_pton(pj_AF_INET(), pj_cstr(&tmp, v4[i]), &addr);
+        pj_dns_init_a_rr(&ans[i], &q.name, PJ_DNS_CLASS_IN, 3600, &addr);
+    }
+    pj_dns_resolver_add_entry(resv, &pkt, PJ_FALSE);
+
+    q.type = PJ_DNS_TYPE_AAAA;
+    pkt.hdr.anscount = PJ_ARRAY_SIZE(v6);
+    for (i=0; i<PJ_ARRAY_SIZE(v6); ++i) {
+        pj_in6_addr addr;
+
+        pj_inet_pton(pj_AF_INET6(), pj_cstr(&tmp, v6[i]), &addr);
+        pj_dns_init_aaaa_rr(&ans[i], &q.name, PJ_DNS_CLASS_IN, 3600, &addr);
+    }
+    pj_dns_resolver_add_entry(resv, &pkt, PJ_FALSE);
+
+    q.name = pj_str("v4only.example.com");
+    q.type = PJ_DNS_TYPE_A;
+    pkt.hdr.anscount = 1;
+    pj_inet_pton(pj_AF_INET(), pj_cstr(&tmp, "9.9.9.9"), &v4only_addr);
+    pj_dns_init_a_rr(&ans[0], &q.name, PJ_DNS_CLASS_IN, 3600, &v4only_addr);
+    pj_dns_resolver_add_entry(resv, &pkt, PJ_FALSE);
+
+    /* Both families are cached: A answers first, so the result starts
+     * with IPv4 and alternates until the IPv6 addresses run out.
+     */
+    pj_bzero(&dest, sizeof(dest));
+    dest.type = PJSIP_TRANSPORT_UNSPECIFIED;
+    dest.addr.host = pj_str("dual.example.com");
+    dest.addr.port = 5070;
+
+    result.status = 0x12345678;
+    pjsip_endpt_resolve(endpt, pool, &dest, &result, &cb);
+    while (result.status == 0x12345678) {
+        pj_time_val timeout = { 0, 10 };
+        pjsip_endpt_handle_events(endpt, &timeout);
+    }
+
+    if (result.status != PJ_SUCCESS) {
+        app_perror("  dual.example.com resolution error", result.status);
+        return -10;
+    }
+    if (result.servers.count != 5) {
+        PJ_LOG(3,(THIS_FILE, "  error: expecting 5 addresses, got %d",
+                  result.servers.count));
+        return -20;
+    }
+    for (i=0; i<result.servers.count; ++i) {
+        const pjsip_server_address_record *e = &result.servers.entry[i];
+        const char *exp = (i==0 ? v4[0] : i==1 ? v6[0] : i==2 ? v4[1] :
+                           i==3 ? v6[1] : v4[2]);
+        int af = (i==1 || i==3) ? pj_AF_INET6() : pj_AF_INET();
+        pj_sockaddr ref;
+
+        pj_sockaddr_init(af, &ref, pj_cstr(&tmp, exp), 5070);
+        if (pj_sockaddr_cmp(&ref, &e->addr) != 0 ||
+            e->addr_len != (int)pj_sockaddr_get_len(&ref))
+        {
+            PJ_LOG(3,(THIS_FILE, "  error: entry %d is not %s", i, exp));
+            return -30;
+        }
+        if (((e->type & PJSIP_TRANSPORT_IPV6) != 0) !=
+            (af == pj_AF_INET6()))
+        {
+            PJ_LOG(3,(THIS_FILE, "  error: entry %d type mismatch", i));
+            return -40;
+        }
+    }
+
+    /* Only A is cached: the result must come after the resolution delay,
+     * well before the AAAA query times out.
+     */
+    dest.addr.host = pj_str("v4only.example.com");
+
+    result.status = 0x12345678;
+    pj_gettickcount(&t1);
+    pjsip_endpt_resolve(endpt, pool, &dest, &result, &cb);
+    while (result.status == 0x12345678) {
+        pj_time_val timeout = { 0, 10 };
+        pjsip_endpt_handle_events(endpt, &timeout);
+    }
+    pj_gettickcount(&t2);
+    PJ_TIME_VAL_SUB(t2, t1);
+
+    if (result.status != PJ_SUCCESS) {
+        app_perror("  v4only.example.com resolution error", result.status);
+        return -50;
+    }
+    if (result.servers.count != 1 ||
+        result.servers.entry[0].addr.addr.sa_family != pj_AF_INET())
+    {
+        PJ_LOG(3,(THIS_FILE, "  error: expecting single IPv4 address"));
+        return -60;
+    }
+    if (PJ_TIME_VAL_MSEC(t2) > PJSIP_RESOLVE_FAMILY_DELAY + 500) {
+        PJ_LOG(3,(THIS_FILE, "  error: result took %ld ms",
+                  PJ_TIME_VAL_MSEC(t2)));
+        return -70;
+    }
+
+    /* The AAAA query is left to time out in the background, during the
+     * timeout test below.
+     */
+    return 0;
+}
+
+/*
+ * Destroy a SIP resolver while its A and AAAA queries are pending, and
+ * check that the state of the resolution is released.
+ */
+static int dual_family_destroy_test(void)
+{
+    pj_caching_pool cp;
+    pj_pool_t *pool;
+    pj_timer_heap_t *timer_heap = NULL;
+    pj_dns_resolver *dns_res = NULL;
+    pjsip_resolver_t *resolver = NULL;
+    pj_str_t nameserver = pj_str("127.0.0.1");
+    pj_uint16_t port = 5354;
+    pjsip_host_info dest;
+    struct result result;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, " dual_family_destroy_test()"));
+
+    /* Use own pool factory for the SIP resolver, to see that the
+     * resolution releases its pool. The DNS resolver uses the endpoint's
+     * one, since it may release its pools later.
+     */
+    pj_caching_pool_init(&cp, NULL, 0);
+    pool = pj_pool_create(&cp.factory, "dualdestroy", 4000, 4000, NULL);
+
+    if (pj_timer_heap_create(pool, 16, &timer_heap) != PJ_SUCCESS ||
+        pj_dns_resolver_create(&caching_pool.factory, "dualdestroy", 0,
+                               timer_heap, pjsip_endpt_get_ioqueue(endpt),
+                               &dns_res) != PJ_SUCCESS ||
+        pj_dns_resolver_set_ns(dns_res, 1, &nameserver, &port) != PJ_SUCCESS ||
+        pjsip_resolver_create(pool, &resolver) != PJ_SUCCESS)
+    {
+        rc = -200;
+        goto on_return;
+    }
+    pjsip_resolver_set_resolver(resolver, dns_res);
+    dns_res = NULL;
+    pjsip_resolver_set_timer_heap(resolver, timer_heap);
+
+    pj_bzero(&dest, sizeof(dest));
+    dest.type = PJSIP_TRANSPORT_UNSPECIFIED;
+    dest.addr.host = pj_str("pending.example.com");
+    dest.addr.port = 5070;
+
+    result.status = 0x12345678;
+    pjsip_resolve(resolver, pool, &dest, &result, &cb);
+    if (result.status != 0x12345678) {
+        PJ_LOG(3,(THIS_FILE, "  error: resolution is not pending"));
+        rc = -210;
+        goto on_return;
+    }
+
+    pjsip_resolver_destroy(resolver);
+    resolver = NULL;
+
+    if (result.status != 0x12345678) {
+        PJ_LOG(3,(THIS_FILE, "  error: callback called on destroy"));
+        rc = -220;
+        goto on_return;
+    }
+    if (cp.used_count != 1) {
+        PJ_LOG(3,(THIS_FILE, "  error: %d pool(s) still in use",
+                  (int)cp.used_count - 1));
+        rc = -230;
+        goto on_return;
+    }
+
+on_return:
+    if (resolver)
+        pjsip_resolver_destroy(resolver);
+    if (dns_res)
+        pj_dns_resolver_destroy(dns_res, PJ_FALSE);
+    if (timer_heap)
+        pj_timer_heap_destroy(timer_heap);
+    pj_pool_release(pool);
+    pj_caching_pool_destroy(&cp);
+    return rc;
+}
+#endif
+
+
 /*
  * Main test entry.
  */
@@ -633,6 +859,14 @@ int resolve_test(void)
     if (round_robin_test(pool) != 0)
         return -170;
 
+#if defined(PJ_HAS_IPV6) && PJ_HAS_IPV6 && PJSIP_RESOLVE_FAMILY_DELAY > 0
+    /* Dual A/AAAA resolution test */
+    if (dual_family_test(pool, resv) != 0)
+        return -175;
+    if (dual_family_destroy_test() != 0)
+        return -176;
+#endif
+
     /* Timeout test */
     {
         status = test_resolve("timeout test", pool, PJSIP_TRANSPORT_UNSPECIFIED, "an.invalid.address", 0, NULL);
@@ -87,6 +87,7 @@ struct registrar_cfg
     unsigned        expires;        /* non-zero to put in Expires header*/
 
     pj_str_t        more_contacts;  /* Additional Contact headers to put*/
+    pj_bool_t       async_auth;     /* verify with auth_srv asynchronously*/
 };
 
 static struct registrar
@@ -94,6 +95,7 @@ static struct registrar
     pjsip_module            mod;
     struct registrar_cfg    cfg;
     unsigned                response_cnt;
+    pjsip_auth_srv         *auth_srv;
 } registrar = 
 {
     {
@@ -113,6 +115,50 @@ static struct registrar
     }
 };
 
+static void regs_respond_auth(pjsip_transaction *tsx, pjsip_rx_data *rdata,
+                              int code)
+{
+    pjsip_tx_data *tdata;
+
+    if (code == 200)
+        registrar.response_cnt++;
+
+    if (pjsip_endpt_create_response(endpt, rdata, code, NULL,
+                                    &tdata) == PJ_SUCCESS)
+    {
+        pjsip_tsx_send_msg(tsx, tdata);
+    }
+}
+
+static void regs_on_verify(pjsip_rx_data *rdata, pj_status_t status,
+                           int code, void *token)
+{
+    PJ_UNUSED_ARG(status);
+    regs_respond_auth((pjsip_transaction*)token, rdata, code);
+}
+
+/* Create the transaction first, so that retransmissions are absorbed
+ * while the credential lookup is pending.
+ */
+static pj_bool_t regs_verify_async(pjsip_rx_data *rdata)
+{
+    pjsip_transaction *tsx;
+    int code;
+    pj_status_t status;
+
+    status = pjsip_tsx_create_uas2(&registrar.mod, rdata, NULL, &tsx);
+    if (status != PJ_SUCCESS)
+        return PJ_TRUE;
+    pjsip_tsx_recv_msg(tsx, rdata);
+
+    status = pjsip_auth_srv_verify_async(registrar.auth_srv, rdata, tsx,
+                                         &regs_on_verify, &code);
+    if (status != PJ_EPENDING)
+        regs_respond_auth(tsx, rdata, code);
+
+    return PJ_TRUE;
+}
+
 static pj_bool_t regs_rx_request(pjsip_rx_data *rdata)
 {
     pjsip_msg *msg = rdata->msg_info.msg;
@@ -126,6 +172,12 @@ static pj_bool_t regs_rx_request(pjsip_rx_data *rdata)
     if (!registrar.cfg.respond)
         return PJ_TRUE;
 
+    if (registrar.cfg.async_auth &&
+        pjsip_msg_find_hdr(msg, PJSIP_H_AUTHORIZATION, NULL) != NULL)
+    {
+        return regs_verify_async(rdata);
+    }
+
     pj_list_init(&hdr_list);
 
     if (registrar.cfg.authenticate && 
@@ -734,6 +786,330 @@ static int auth_send_error(const pj_str_t *registrar_uri,
 }
 
 
+/* REGISTER requests exceeding the pacer's rate are queued, and sent
+ * one interval apart.
+ */
+static int pacer_test(const pj_str_t *registrar_uri)
+{
+    enum { CNT = 3, RATE = 10 };
+    struct registrar_cfg server_cfg = 
+        /* respond      code    auth      contact  exp_prm expires more_contacts */
+        { PJ_TRUE,      200,    PJ_FALSE, EXACT,   75,     0,       {NULL, 0}};
+    const pj_str_t aor = pj_str("<sip:regc-test@pjsip.org>");
+    pj_str_t contact = pj_str("<sip:c@C>");
+    struct client clients[CNT+1];
+    pjsip_regc *regc[CNT+1];
+    pjsip_regc_pacer *pacer = NULL;
+    pj_pool_t *pool;
+    pjsip_tx_data *tdata;
+    pj_time_val t1, t2;
+    unsigned i, done_cnt;
+    int ret = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  registration pacer"));
+
+    pj_memcpy(&registrar.cfg, &server_cfg, sizeof(server_cfg));
+    registrar.response_cnt = 0;
+    pj_bzero(clients, sizeof(clients));
+    pj_bzero(regc, sizeof(regc));
+
+    pool = pjsip_endpt_create_pool(endpt, "regcpacer", 512, 512);
+    if (pjsip_regc_pacer_create(pool, RATE, &pacer) != PJ_SUCCESS) {
+        ret = -900;
+        goto on_return;
+    }
+
+    pj_gettickcount(&t1);
+    for (i=0; i<=CNT; ++i) {
+        if (pjsip_regc_create(endpt, &clients[i], &client_cb,
+                              &regc[i]) != PJ_SUCCESS ||
+            pjsip_regc_init(regc[i], registrar_uri, &aor, &aor, 1, &contact,
+                            60) != PJ_SUCCESS ||
+            pjsip_regc_set_pacer(regc[i], pacer) != PJ_SUCCESS ||
+            pjsip_regc_register(regc[i], PJ_FALSE, &tdata) != PJ_SUCCESS)
+        {
+            ret = -910;
+            goto on_return;
+        }
+        if (pjsip_regc_send(regc[i], tdata) != PJ_SUCCESS) {
+            ret = -920;
+            goto on_return;
+        }
+    }
+
+    /* Only the first request may go right away */
+    if (pjsip_regc_pacer_get_backlog(pacer) != CNT) {
+        PJ_LOG(3,(THIS_FILE, "    error: expecting backlog=%d, got %d",
+                  CNT, pjsip_regc_pacer_get_backlog(pacer)));
+        ret = -930;
+        goto on_return;
+    }
+
+    /* Destroying a client drops its queued request */
+    pjsip_regc_destroy(regc[CNT]);
+    regc[CNT] = NULL;
+    if (pjsip_regc_pacer_get_backlog(pacer) != CNT-1) {
+        PJ_LOG(3,(THIS_FILE, "    error: queued request is not dropped"));
+        ret = -940;
+        goto on_return;
+    }
+
+    for (i=0; i<100; ++i) {
+        unsigned j;
+
+        for (j=0, done_cnt=0; j<CNT; ++j)
+            done_cnt += clients[j].done;
+        if (done_cnt == CNT)
+            break;
+        flush_events(10);
+    }
+    pj_gettickcount(&t2);
+    PJ_TIME_VAL_SUB(t2, t1);
+
+    if (done_cnt != CNT || registrar.response_cnt != CNT) {
+        PJ_LOG(3,(THIS_FILE, "    error: test has timed out"));
+        ret = -950;
+        goto on_return;
+    }
+    for (i=0; i<CNT; ++i) {
+        if (clients[i].error || clients[i].code != 200) {
+            PJ_LOG(3,(THIS_FILE, "    error: client %d got code=%d",
+                      i, clients[i].code));
+            ret = -960;
+            goto on_return;
+        }
+    }
+
+    /* The last request must have waited (CNT-1) pacer intervals, allow
+     * a few msec for timer granularity.
+     */
+    if (PJ_TIME_VAL_MSEC(t2) < (CNT-1) * 1000 / RATE - 20) {
+        PJ_LOG(3,(THIS_FILE, "    error: requests were not paced (%ld ms)",
+                  (long)PJ_TIME_VAL_MSEC(t2)));
+        ret = -970;
+        goto on_return;
+    }
+    if (pjsip_regc_pacer_get_backlog(pacer) != 0) {
+        ret = -980;
+        goto on_return;
+    }
+
+on_return:
+    for (i=0; i<=CNT; ++i) {
+        if (regc[i])
+            pjsip_regc_destroy(regc[i]);
+    }
+    if (pacer)
+        pjsip_regc_pacer_destroy(pacer);
+    pjsip_endpt_release_pool(endpt, pool);
+    return ret;
+}
+
+
+/* Asynchronous credential lookup of the registrar */
+static struct
+{
+    pjsip_auth_lookup_op *op;
+    unsigned              lookup_cnt;
+    pj_status_t           start_status;  /* returned by lookup_async */
+} async_lookup;
+
+static pj_status_t regs_lookup_async(const pjsip_auth_lookup_cred_param *prm,
+                                     pjsip_auth_lookup_op *op)
+{
+    PJ_UNUSED_ARG(prm);
+
+    async_lookup.lookup_cnt++;
+    if (async_lookup.start_status != PJ_SUCCESS)
+        return async_lookup.start_status;
+
+    async_lookup.op = op;
+    return PJ_SUCCESS;
+}
+
+/* Register once, completing the registrar's credential lookup with the
+ * password, or with lookup_status if it is not PJ_SUCCESS, when one is
+ * started.
+ */
+static int async_auth_register(pjsip_regc *regc, struct client *client,
+                               const char *password,
+                               pj_status_t lookup_status)
+{
+    pjsip_tx_data *tdata;
+    unsigned i;
+
+    pj_bzero(client, sizeof(*client));
+    async_lookup.op = NULL;
+
+    if (pjsip_regc_register(regc, PJ_FALSE, &tdata) != PJ_SUCCESS ||
+        pjsip_regc_send(regc, tdata) != PJ_SUCCESS)
+    {
+        return -1000;
+    }
+
+    for (i=0; i<500; ++i) {
+        if (async_lookup.op) {
+            pjsip_cred_info cred;
+
+            /* The request must still be waiting for the lookup */
+            if (client->done)
+                return -1010;
+
+            pj_bzero(&cred, sizeof(cred));
+            cred.realm = pj_str("test");
+            cred.username = pj_str("user");
+            cred.data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+            cred.data = pj_str((char*)password);
+
+            pjsip_auth_srv_lookup_complete(async_lookup.op, lookup_status,
+                                           (lookup_status == PJ_SUCCESS ?
+                                            &cred : NULL));
+            async_lookup.op = NULL;
+        } else if (client->done) {
+            break;
+        }
+        flush_events(10);
+    }
+
+    return client->done ? 0 : -1020;
+}
+
+/* Check the result of async_auth_register() */
+static int check_async_auth(const struct client *client, int code,
+                            unsigned lookup_cnt, const char *title)
+{
+    if (client->code != code || async_lookup.lookup_cnt != lookup_cnt) {
+        PJ_LOG(3,(THIS_FILE, "    error: %s: expecting code=%d lookups=%d, "
+                  "got code=%d lookups=%d", title, code, lookup_cnt,
+                  client->code, async_lookup.lookup_cnt));
+        return -1;
+    }
+    return 0;
+}
+
+/* Registrar authenticates with asynchronous credential lookup and HA1
+ * cache.
+ */
+static int async_auth_test(const pj_str_t *registrar_uri)
+{
+    struct registrar_cfg server_cfg = 
+        /* respond      code    auth      contact  exp_prm expires more_contacts async */
+        { PJ_TRUE,      200,    PJ_TRUE,  NONE,    0,      0,      {NULL, 0},    PJ_TRUE};
+    const pj_str_t aor = pj_str("<sip:regc-test@pjsip.org>");
+    pj_str_t contact = pj_str("<sip:c@C>");
+    pj_str_t realm = pj_str("test");
+    pj_str_t user = pj_str("user");
+    pjsip_auth_srv_init_param prm;
+    pjsip_auth_srv auth_srv;
+    pjsip_cred_info cred;
+    struct client client;
+    pjsip_regc *regc = NULL;
+    pj_pool_t *pool;
+    int ret;
+
+    PJ_LOG(3,(THIS_FILE, "  asynchronous server authentication"));
+
+    pool = pjsip_endpt_create_pool(endpt, "authsrv", 512, 512);
+
+    pj_bzero(&prm, sizeof(prm));
+    prm.realm = &realm;
+    prm.lookup_async = &regs_lookup_async;
+    prm.cache_ttl = 60;
+    if (pjsip_auth_srv_init2(pool, &auth_srv, &prm) != PJ_SUCCESS) {
+        pjsip_endpt_release_pool(endpt, pool);
+        return -1100;
+    }
+
+    pj_memcpy(&registrar.cfg, &server_cfg, sizeof(server_cfg));
+    registrar.auth_srv = &auth_srv;
+    pj_bzero(&async_lookup, sizeof(async_lookup));
+
+    pj_bzero(&cred, sizeof(cred));
+    cred.realm = pj_str("*");
+    cred.scheme = pj_str("digest");
+    cred.username = user;
+    cred.data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+    cred.data = pj_str("password");
+
+    if (pjsip_regc_create(endpt, &client, &client_cb, &regc) != PJ_SUCCESS ||
+        pjsip_regc_init(regc, registrar_uri, &aor, &aor, 1, &contact,
+                        60) != PJ_SUCCESS ||
+        pjsip_regc_set_credentials(regc, 1, &cred) != PJ_SUCCESS)
+    {
+        ret = -1110;
+        goto on_return;
+    }
+
+    /* First request is verified after the lookup completes */
+    ret = async_auth_register(regc, &client, "password", PJ_SUCCESS);
+    if (ret == 0 && check_async_auth(&client, 200, 1, "after lookup"))
+        ret = -1120;
+    if (ret != 0)
+        goto on_return;
+
+    /* Next request is verified from the cache */
+    ret = async_auth_register(regc, &client, "password", PJ_SUCCESS);
+    if (ret == 0 && check_async_auth(&client, 200, 1, "from cache"))
+        ret = -1130;
+    if (ret != 0)
+        goto on_return;
+
+    /* A request that does not match the cached HA1 is not answered from
+     * the cache, the credential is looked up again.
+     */
+    cred.data = pj_str("changed");
+    if (pjsip_regc_set_credentials(regc, 1, &cred) != PJ_SUCCESS) {
+        ret = -1135;
+        goto on_return;
+    }
+    ret = async_auth_register(regc, &client, "changed", PJ_SUCCESS);
+    if (ret == 0 && check_async_auth(&client, 200, 2, "cache mismatch"))
+        ret = -1136;
+    if (ret != 0)
+        goto on_return;
+
+    /* After flushing, a changed password is looked up again */
+    pjsip_auth_srv_flush_cache(&auth_srv, &user);
+    ret = async_auth_register(regc, &client, "password", PJ_SUCCESS);
+    if (ret == 0 && check_async_auth(&client, PJSIP_SC_FORBIDDEN, 3,
+                                     "after flush"))
+    {
+        ret = -1140;
+    }
+    if (ret != 0)
+        goto on_return;
+
+    /* Failed lookup */
+    ret = async_auth_register(regc, &client, NULL, PJ_ENOTFOUND);
+    if (ret == 0 && check_async_auth(&client, PJSIP_SC_FORBIDDEN, 4,
+                                     "failed lookup"))
+    {
+        ret = -1150;
+    }
+    if (ret != 0)
+        goto on_return;
+
+    /* Lookup that fails to start */
+    async_lookup.start_status = PJ_ENOMEM;
+    ret = async_auth_register(regc, &client, NULL, PJ_SUCCESS);
+    async_lookup.start_status = PJ_SUCCESS;
+    if (ret == 0 && check_async_auth(&client, PJSIP_SC_FORBIDDEN, 5,
+                                     "lookup start error"))
+    {
+        ret = -1160;
+    }
+    if (ret != 0)
+        goto on_return;
+
+on_return:
+    if (regc)
+        pjsip_regc_destroy(regc);
+    registrar.cfg.async_auth = PJ_FALSE;
+    registrar.auth_srv = NULL;
+    pjsip_auth_srv_deinit(&auth_srv);
+    pjsip_endpt_release_pool(endpt, pool);
+    return ret;
+}
 
 
 /************************************************************************/
@@ -1150,6 +1526,16 @@ int regc_test(void)
     if (rc != 0)
         goto on_return;
 
+    /* Rate limited registration */
+    rc = pacer_test(&registrar_uri);
+    if (rc != 0)
+        goto on_return;
+
+    /* Asynchronous server authentication */
+    rc = async_auth_test(&registrar_uri);
+    if (rc != 0)
+        goto on_return;
+
 on_return:
     if (registrar.mod.id != -1) {
         pjsip_endpt_unregister_module(endpt, &registrar.mod);
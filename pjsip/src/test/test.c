@@ -75,6 +75,7 @@ static struct {
     { "tsx_destroy", 0},
     { "inv_oa", 0},
     { "regc", 0},
+    { "dlg_core", 0},
 };
 enum tests_to_run {
     include_uri_test = 0,
@@ -90,6 +91,7 @@ enum tests_to_run {
     include_tsx_destroy_test,
     include_inv_oa_test,
     include_regc_test,
+    include_dlg_core_test,
 };
 static int run_all_tests = 1;
 
@@ -486,6 +488,12 @@ int test_main(char *testlist)
     }
 #endif
 
+#if INCLUDE_DLG_CORE_TEST
+    if (SHOULD_RUN_TEST(include_dlg_core_test)) {
+        DO_TEST(dlg_core_test());
+    }
+#endif
+
     /*
      * Better be last because it recreates the endpt
      */
@@ -71,6 +71,7 @@ extern pj_caching_pool caching_pool;
 #define INCLUDE_TSX_DESTROY_TEST INCLUDE_TSX_GROUP
 #define INCLUDE_INV_OA_TEST     INCLUDE_INV_GROUP
 #define INCLUDE_REGC_TEST       INCLUDE_REGC_GROUP
+#define INCLUDE_DLG_CORE_TEST   INCLUDE_INV_GROUP
 
 
 /* The tests */
@@ -86,6 +87,7 @@ int transport_loop_test(void);
 int transport_tcp_test(void);
 int resolve_test(void);
 int regc_test(void);
+int dlg_core_test(void);
 
 struct tsx_test_param
 {
@@ -147,6 +147,269 @@ static pj_status_t multi_listener_test(pjsip_tpfactory *factory[],
     return PJ_SUCCESS;
 }
 
+/*
+ * Feed a large message to the stream framer in small segments, the way
+ * it arrives over a TCP/TLS connection, and compare rescanning the whole
+ * buffer with pjsip_find_msg() against incremental pjsip_find_msg2().
+ */
+static int framer_bench(void)
+{
+    enum { HDR_CNT = 60, PART_CNT = 60, PART_LEN = 1000, SEGMENT = 64 };
+    pj_pool_t *pool;
+    char *buf, *p, *end, *body;
+    pj_size_t total, len, msg_size;
+    pjsip_find_msg_state state;
+    pj_timestamp t1, t2;
+    pj_uint32_t rescan_usec, incr_usec;
+    pj_status_t status;
+    int i, rc = 0;
+
+    pool = pjsip_endpt_create_pool(endpt, "framer", 4000, 4000);
+    buf = (char*)pj_pool_alloc(pool, HDR_CNT * 80 + PART_CNT * PART_LEN * 2);
+    body = (char*)pj_pool_alloc(pool, PART_CNT * (PART_LEN + 80));
+
+    /* Multipart body */
+    p = body;
+    end = body + PART_CNT * (PART_LEN + 80);
+    for (i = 0; i < PART_CNT; ++i) {
+        p += pj_ansi_snprintf(p, end - p, "--framer-boundary\r\n"
+                              "Content-Type: text/plain\r\n\r\n");
+        pj_memset(p, 'a' + (i % 26), PART_LEN);
+        p += PART_LEN;
+        *p++ = '\r'; *p++ = '\n';
+    }
+    p += pj_ansi_snprintf(p, end - p, "--framer-boundary--\r\n");
+    len = p - body;
+
+    /* Header area, with Content-Length placed last as many UAs do */
+    p = buf;
+    end = buf + HDR_CNT * 80 + PART_CNT * PART_LEN * 2;
+    p += pj_ansi_snprintf(p, end - p,
+                          "INVITE sip:bob@example.com SIP/2.0\r\n"
+                          "Via: SIP/2.0/TCP 192.168.0.1;branch=z9hG4bKframer\r\n"
+                          "From: <sip:alice@example.com>;tag=1234\r\n"
+                          "To: <sip:bob@example.com>\r\n"
+                          "Call-ID: framer-bench@192.168.0.1\r\n"
+                          "CSeq: 1 INVITE\r\n"
+                          "Content-Type: multipart/mixed;"
+                          "boundary=framer-boundary\r\n");
+    for (i = 0; i < HDR_CNT; ++i) {
+        p += pj_ansi_snprintf(p, end - p,
+                              "X-Framer-Header-%02d: some opaque value\r\n",
+                              i);
+    }
+    p += pj_ansi_snprintf(p, end - p, "Content-Length: %d\r\n\r\n",
+                          (int)len);
+    pj_memcpy(p, body, len);
+    p += len;
+    *p = '\0';
+    total = p - buf;
+
+    /* Rescan the whole buffer on every segment */
+    pj_get_timestamp(&t1);
+    for (len = SEGMENT; ; len += SEGMENT) {
+        if (len > total) len = total;
+        status = pjsip_find_msg(buf, len, PJ_FALSE, &msg_size);
+        if (len < total && status != PJSIP_EPARTIALMSG) {
+            rc = -200;
+            goto on_return;
+        }
+        if (len == total)
+            break;
+    }
+    pj_get_timestamp(&t2);
+    if (status != PJ_SUCCESS || msg_size != total) {
+        rc = -210;
+        goto on_return;
+    }
+    rescan_usec = pj_elapsed_usec(&t1, &t2);
+
+    /* Only scan what's new */
+    pj_bzero(&state, sizeof(state));
+    pj_get_timestamp(&t1);
+    for (len = SEGMENT; ; len += SEGMENT) {
+        if (len > total) len = total;
+        status = pjsip_find_msg2(buf, len, &state, &msg_size);
+        if (len < total && status != PJSIP_EPARTIALMSG) {
+            rc = -220;
+            goto on_return;
+        }
+        if (len == total)
+            break;
+    }
+    pj_get_timestamp(&t2);
+    if (status != PJ_SUCCESS || msg_size != total) {
+        rc = -230;
+        goto on_return;
+    }
+    incr_usec = pj_elapsed_usec(&t1, &t2);
+
+    PJ_LOG(3,(THIS_FILE, "   framing %d bytes in %d-byte segments: "
+              "rescan=%u usec, incremental=%u usec",
+              (int)total, SEGMENT, rescan_usec, incr_usec));
+
+    report_ival("tcp-framer-rescan-usec", rescan_usec, "usec",
+                "Time to frame a large SIP message received over a stream "
+                "in 64-byte segments, rescanning the whole buffer on "
+                "every segment");
+    report_ival("tcp-framer-incremental-usec", incr_usec, "usec",
+                "Time to frame a large SIP message received over a stream "
+                "in 64-byte segments, scanning only the new data on "
+                "every segment");
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+/*
+ * Reset the connection from the remote side while messages are queued
+ * for write coalescing. Every queued message must be reported as failed
+ * and the transport must be shut down.
+ */
+static unsigned reset_tx_cnt, reset_tx_err_cnt;
+
+static void reset_send_cb(void *token, pjsip_tx_data *tdata,
+                          pj_ssize_t bytes_sent)
+{
+    PJ_UNUSED_ARG(token);
+    PJ_UNUSED_ARG(tdata);
+
+    ++reset_tx_cnt;
+    if (bytes_sent <= 0)
+        ++reset_tx_err_cnt;
+}
+
+static pj_status_t reset_send_msg(pjsip_transport *tp,
+                                  const pj_sockaddr_in *addr)
+{
+    pj_str_t target, from, contact, call_id;
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    target = pj_str("sip:bob@127.0.0.1;transport=tcp");
+    from = pj_str("Alice <sip:alice@127.0.0.1>");
+    contact = pj_str("Alice <sip:alice@127.0.0.1;transport=tcp>");
+    call_id = pj_str("PeerReset-Test");
+    status = pjsip_endpt_create_request(endpt, &pjsip_options_method,
+                                        &target, &from, &target, &contact,
+                                        &call_id, 1, NULL, &tdata);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    status = pjsip_transport_send(tp, tdata, addr, sizeof(*addr), NULL,
+                                  &reset_send_cb);
+    pjsip_tx_data_dec_ref(tdata);
+
+    return (status == PJ_EPENDING) ? PJ_SUCCESS : status;
+}
+
+static int peer_reset_test(void)
+{
+    enum { MSG_CNT = 8 };
+    pj_sock_t lsock = PJ_INVALID_SOCKET, peer = PJ_INVALID_SOCKET;
+    pj_sockaddr_in addr;
+    int addr_len;
+    pjsip_transport *tp = NULL;
+    pj_str_t s;
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   peer reset with queued messages:"));
+
+    /* The peer is a plain socket that never reads anything */
+    pj_sockaddr_in_init(&addr, pj_cstr(&s, "127.0.0.1"), 0);
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, &lsock);
+    if (status == PJ_SUCCESS)
+        status = pj_sock_bind(lsock, &addr, sizeof(addr));
+    if (status == PJ_SUCCESS) {
+        addr_len = sizeof(addr);
+        status = pj_sock_getsockname(lsock, &addr, &addr_len);
+    }
+    if (status == PJ_SUCCESS)
+        status = pj_sock_listen(lsock, 1);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to create peer socket", status);
+        rc = -300;
+        goto on_return;
+    }
+
+    status = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_TCP,
+                                           &addr, sizeof(addr), NULL, &tp);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to acquire TCP transport", status);
+        rc = -310;
+        goto on_return;
+    }
+
+    status = pj_sock_accept(lsock, &peer, NULL, NULL);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to accept connection", status);
+        rc = -320;
+        goto on_return;
+    }
+    flush_events(100);
+
+    /* Leave unread data at the peer, so that closing the peer socket
+     * resets the connection.
+     */
+    pjsip_cfg()->tcp.coalesce_delay = 0;
+    status = reset_send_msg(tp, &addr);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to send message", status);
+        rc = -330;
+        goto on_return;
+    }
+    flush_events(100);
+
+    /* Queue messages to be coalesced */
+    reset_tx_cnt = reset_tx_err_cnt = 0;
+    pjsip_cfg()->tcp.coalesce_delay = 50;
+    for (i = 0; i < MSG_CNT; ++i) {
+        status = reset_send_msg(tp, &addr);
+        if (status != PJ_SUCCESS) {
+            app_perror("   Error: unable to queue message", status);
+            rc = -340;
+            goto on_return;
+        }
+    }
+
+    /* Reset the connection and let the coalescing delay expire without
+     * polling, so that the queued messages are written to the reset
+     * socket once the events are polled.
+     */
+    pj_sock_close(peer);
+    peer = PJ_INVALID_SOCKET;
+    pj_thread_sleep(200);
+    flush_events(500);
+
+    if (reset_tx_cnt != MSG_CNT || reset_tx_err_cnt != MSG_CNT) {
+        PJ_LOG(3,(THIS_FILE, "   error: %u of %u queued messages completed, "
+                  "%u succeeded", reset_tx_cnt, MSG_CNT,
+                  reset_tx_cnt - reset_tx_err_cnt));
+        rc = -350;
+        goto on_return;
+    }
+
+    if (!tp->is_shutdown && !tp->is_destroying) {
+        PJ_LOG(3,(THIS_FILE, "   error: transport was not shut down"));
+        rc = -360;
+        goto on_return;
+    }
+
+on_return:
+    pjsip_cfg()->tcp.coalesce_delay = PJSIP_TCP_COALESCE_DELAY;
+    if (tp)
+        pjsip_transport_dec_ref(tp);
+    if (peer != PJ_INVALID_SOCKET)
+        pj_sock_close(peer);
+    if (lsock != PJ_INVALID_SOCKET)
+        pj_sock_close(lsock);
+    flush_events(500);
+    return rc;
+}
+
 int transport_tcp_test(void)
 {
     enum { SEND_RECV_LOOP = 8 };
@@ -163,6 +426,14 @@ int transport_tcp_test(void)
     unsigned i;
     unsigned num_listener = NUM_LISTENER;
     unsigned num_tp = NUM_TP;
+    pjsip_transport *load_tp;
+    pjsip_tcp_transport_stat stat;
+    pj_uint32_t tx_msg_cnt, tx_write_cnt;
+
+    /* Stream framer benchmark */
+    status = framer_bench();
+    if (status != 0)
+        return status;
 
     status = multi_listener_test(tpfactory, num_listener, tcp, &num_tp);
     if (status != PJ_SUCCESS)
@@ -218,6 +489,66 @@ int transport_tcp_test(void)
     if (pkt_lost != 0)
         PJ_LOG(3,(THIS_FILE, "   note: %d packet(s) was lost", pkt_lost));
 
+    /* Load test again, with write coalescing enabled */
+    PJ_LOG(3,(THIS_FILE, "   with write coalescing:"));
+    /* The load test sends to the first listener, using the transport
+     * created by the first load test.
+     */
+    status = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_TCP,
+                                           &rem_addr, sizeof(rem_addr),
+                                           NULL, &load_tp);
+    if (status != PJ_SUCCESS) {
+        app_perror("   Error: unable to acquire TCP transport", status);
+        for (i = 0; i < num_tp ; ++i) {
+            pjsip_transport_dec_ref(tcp[i]);
+        }
+        return -74;
+    }
+    pjsip_tcp_transport_get_stat(load_tp, &stat);
+    tx_msg_cnt = stat.tx_msg_cnt;
+    tx_write_cnt = stat.tx_write_cnt;
+
+    pjsip_cfg()->tcp.coalesce_delay = 10;
+    status = transport_load_test(url);
+    if (status == 0) {
+        status = transport_send_recv_test(PJSIP_TRANSPORT_TCP, tcp[0], url,
+                                          &rtt[0]);
+    }
+    pjsip_cfg()->tcp.coalesce_delay = PJSIP_TCP_COALESCE_DELAY;
+    if (status != 0) {
+        for (i = 0; i < num_tp ; ++i) {
+            pjsip_transport_dec_ref(tcp[i]);
+        }
+        pjsip_transport_dec_ref(load_tp);
+        flush_events(500);
+        return -75;
+    }
+
+    /* Check that the messages were actually coalesced */
+    pjsip_tcp_transport_get_stat(load_tp, &stat);
+    pjsip_transport_dec_ref(load_tp);
+    tx_msg_cnt = stat.tx_msg_cnt - tx_msg_cnt;
+    tx_write_cnt = stat.tx_write_cnt - tx_write_cnt;
+    PJ_LOG(3,(THIS_FILE, "   %u messages sent in %u writes",
+              tx_msg_cnt, tx_write_cnt));
+    if (tx_msg_cnt == 0 || tx_write_cnt >= tx_msg_cnt) {
+        PJ_LOG(3,(THIS_FILE, "   error: messages were not coalesced"));
+        for (i = 0; i < num_tp ; ++i) {
+            pjsip_transport_dec_ref(tcp[i]);
+        }
+        flush_events(500);
+        return -76;
+    }
+
+    /* Peer reset while messages are waiting to be coalesced */
+    status = peer_reset_test();
+    if (status != 0) {
+        for (i = 0; i < num_tp ; ++i) {
+            pjsip_transport_dec_ref(tcp[i]);
+        }
+        return status;
+    }
+
     /* Check again that reference counter is still 1. */
     for (i = 0; i < num_tp; ++i) {
         if (pj_atomic_get(tcp[i]->ref_cnt) != 1)
@@ -23,6 +23,9 @@ DECL(int) res_SrcLinear(const RES_HWORD X[], RES_HWORD Y[],
 DECL(int) res_Resample(const RES_HWORD X[], RES_HWORD Y[], double pFactor, 
 		       RES_UHWORD nx, RES_BOOL LargeF, RES_BOOL Interp);
 DECL(int) res_GetXOFF(double pFactor, RES_BOOL LargeF);
+DECL(int) res_GetFilter(RES_BOOL LargeF, const RES_HWORD **pImp,
+			const RES_HWORD **pImpD, RES_UHWORD *pNwing,
+			RES_UHWORD *pLpScl, RES_UHWORD *pNpc);
 
 #ifdef __cplusplus
 }
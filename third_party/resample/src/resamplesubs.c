@@ -38,6 +38,7 @@
  *  - move FilterUp() and FilterUD() from filterkit.c
  *  - move stddefs.h and resample.h to this file.
  *  - const correctness.
+ *  - add res_GetFilter() to export the filter tables.
  */
 
 #include <resamplesubs.h>
@@ -375,3 +376,22 @@ DECL(int) res_GetXOFF(double pFactor, RES_BOOL LargeF)
 		MAX(1.0, 1.0/pFactor);
 }
 
+
+DECL(int) res_GetFilter(RES_BOOL LargeF, const RES_HWORD **pImp,
+			const RES_HWORD **pImpD, RES_UHWORD *pNwing,
+			RES_UHWORD *pLpScl, RES_UHWORD *pNpc)
+{
+    if (LargeF) {
+	*pImp = LARGE_FILTER_IMP;
+	*pImpD = LARGE_FILTER_IMPD;
+	*pNwing = LARGE_FILTER_NWING;
+	*pLpScl = LARGE_FILTER_SCALE;
+    } else {
+	*pImp = SMALL_FILTER_IMP;
+	*pImpD = SMALL_FILTER_IMPD;
+	*pNwing = SMALL_FILTER_NWING;
+	*pLpScl = SMALL_FILTER_SCALE;
+    }
+    *pNpc = Npc;
+    return (*pImp != NULL);
+}